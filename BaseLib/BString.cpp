@@ -14,7 +14,7 @@ BString::BString( bool, const char* _format, ... ) : m_str( NULL ) {
 	Format( _format, args );
 	va_end( args );
 }
-BString::BString( BString& _str ) : m_str( NULL ) {
+BString::BString( const BString& _str ) : m_str( NULL ) {
 	Copy( _str.m_str );
 }
 
@@ -189,6 +189,13 @@ BString&	BString::operator=( const BString& _other ) {
 	Copy( _other.m_str );
 	return *this;
 }
+BString&	BString::operator=( BString&& _other ) {
+	// Swap so the other string releases our former content
+	char*	temp = m_str;
+	m_str = _other.m_str;
+	_other.m_str = temp;
+	return *this;
+}
 
 const char&	BString::operator[]( U32 _index ) const {
 	RELEASE_ASSERT( m_str != NULL, "Invalid string!" );
@@ -220,8 +227,12 @@ U32	BString::Hash() const {
 }
 
 U32	BString::Hash( const BString& _key ) {
+	return BString::Hash( _key.m_str );
+}
+
+U32	BString::Hash( const char* _key ) {
 	// djb2
-	const char*	ptr = _key.m_str;
+	const char*	ptr = _key;
 	if ( ptr == nullptr )
 		return 0;
 
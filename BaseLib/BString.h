@@ -14,7 +14,8 @@ public:
 	BString() : m_str(nullptr) {}
 	BString( const char* _str );
 	BString( bool _dummy, const char* _format, ... );	// _dummy is only there to differentiate variadic constructor from regular copy constructor
-	BString( BString& _str );
+	BString( const BString& _str );
+	BString( BString&& _str ) : m_str( _str.m_str ) { _str.m_str = nullptr; }
 	~BString();
 
 	bool			IsEmpty() const;
@@ -45,12 +46,14 @@ public:
 
 	BString&		operator=( const char* _other );
 	BString&		operator=( const BString& _other );
+	BString&		operator=( BString&& _other );
 
 	bool			operator==( const BString& _other ) const;
 	bool			operator!=( const BString& _other ) const;
 
 	U32				Hash() const;
 	static U32		Hash( const BString& _key );
+	static U32		Hash( const char* _key );
 	static S32		Compare( const BString& _a, const BString& _b );
 	static S32		Compare( const BString& _a, const BString& _b, int _maxLength );
 
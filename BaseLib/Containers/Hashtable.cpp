@@ -1,119 +1,33 @@
-#include "Hashtable.h"
-//#include <string.h>
-
-using namespace BaseLib;
-
-//////////////////////////////////////////////////////////////////////////
-// U32 General version
-//
-#ifdef _DEBUG
-int	DictionaryU32::ms_MaxCollisionsCount = 0;
-#endif
-
-DictionaryU32::DictionaryU32( int _PowerOfTwoSize ) {
-	m_POT = _PowerOfTwoSize;
-	m_SizePOT = 1 << m_POT;
-	m_ppTable = new Node*[m_SizePOT];
-	memset( m_ppTable, 0, m_SizePOT*sizeof(Node*) );
-}
-DictionaryU32::~DictionaryU32()
-{
-	for ( int i=0; i < m_SizePOT; i++ )
-	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
-
-			delete pOld;
-		}
-	}
-
-	delete[] m_ppTable;
-}
-
-void*	DictionaryU32::Get( U32 _Key ) const
-{
-//	U32		idx = _Key & (m_SizePOT-1);
-	U32		idx = Fibonacci( _Key );
-	Node*	pNode = m_ppTable[idx];
-
-#ifdef _DEBUG
-	int		CollisionsCount = 0;
-	while ( pNode != NULL )
-	{
-		if ( _Key == pNode->Key )
-		{
-			if ( CollisionsCount > ms_MaxCollisionsCount )
-				ms_MaxCollisionsCount = CollisionsCount;
-			return pNode->pValue;
-		}
- 
-		pNode = pNode->pNext;
-		CollisionsCount++;
-	}
-#else
-	while ( pNode != NULL )
-	{
-		if ( _Key == pNode->Key )
-			return pNode->pValue;
- 
-		pNode = pNode->pNext;
-	}
-#endif
- 
-	return NULL;
-}
-
-void	DictionaryU32::Add( U32 _Key, void* _pValue )
-{
-//	U32		idx = _Key & (m_SizePOT-1);
-	U32		idx = Fibonacci( _Key );
- 
-	Node*	pNode = new Node();
-	pNode->Key = _Key;
-	pNode->pValue = _pValue;
- 
-	pNode->pNext = m_ppTable[idx];	// Here, we could add a check for m_ppTable[idx] == NULL to ensure no collision...
-	m_ppTable[idx] = pNode;
-}
-
-void	DictionaryU32::Remove( U32 _Key )
-{
-//	U32		idx = _Key & (m_SizePOT-1);
-	U32		idx = Fibonacci( _Key );
- 
-	Node*	pPrevious = NULL;
-	Node*	pCurrent = m_ppTable[idx];
-	while ( pCurrent != NULL )
-	{
-		if ( _Key == pCurrent->Key )
-		{
-			if ( pPrevious != NULL )
-				pPrevious->pNext = pCurrent->pNext;	// Link over...
-			else
-				m_ppTable[idx] = pCurrent->pNext;	// We replaced the root key...
- 
-			delete pCurrent;
- 			return;
-		}
- 
-		pPrevious = pCurrent;
-		pCurrent = pCurrent->pNext;
-	}
-}
-
-void	DictionaryU32::ForEach( VisitorDelegate _pDelegate, void* _pUserData )
-{
-	int	EntryIndex = 0;
-	for ( int i=0; i < m_SizePOT; i++ )
-	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			(*_pDelegate)( EntryIndex++, pNode->pValue, _pUserData );
-			pNode = pNode->pNext;
-		}
-	}
-}
\ No newline at end of file
+#include "Hashtable.h"
+//#include <string.h>
+
+using namespace BaseLib;
+
+//////////////////////////////////////////////////////////////////////////
+// U32 General version
+//
+void*	DictionaryU32::Get( U32 _Key ) const
+{
+	void**	ppValue = HashTable<U32, void*>::Get( _Key );
+	return ppValue != NULL ? *ppValue : NULL;
+}
+
+void	DictionaryU32::Add( U32 _Key, void* _pValue )
+{
+	HashTable<U32, void*>::Add( _Key, _pValue );
+}
+
+void	DictionaryU32::Remove( U32 _Key )
+{
+	HashTable<U32, void*>::Remove( _Key );
+}
+
+void	DictionaryU32::ForEach( VisitorDelegate _pDelegate, void* _pUserData )
+{
+	int	EntryIndex = 0;
+	U32	Size = GetSize();
+	for ( U32 Slot=0; Slot < Size; Slot++ ) {
+		if ( IsOccupied( m_pControls[Slot] ) )
+			(*_pDelegate)( EntryIndex++, m_pEntries[Slot].Value, _pUserData );
+	}
+}
@@ -3,6 +3,17 @@
 #include "../Types.h"
 #include "../ASMHelpers.h"
 #include "../Math/Math.h"
+#include "List.h"
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	#define HT_USE_SSE2
+	#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
 
 namespace BaseLib {
 
@@ -14,214 +25,197 @@ static U32	Fibonacci32( U32 _key, U32 _POT ) {
 	return (_key * 2654435769U) >> (32-_POT);	// 2654435769 = 2^32 / Phi
 }
 
-// Source: http://blog.2of1.org/2011/07/11/simple-c-hashtable-code/
+// Open-addressing hash table in the spirit of Google's SwissTable
+//
+//	. Entries are stored directly in the table's slots, next to an array of 1 control byte per slot
+//	. Slots are grouped by 16, each control byte is either EMPTY, DELETED or contains 7 bits of the key's hash
+//		so a single SSE2 comparison tells which slots of a group may contain the key we're looking for
+//	. The first probed group is given by Fibonacci hashing, then groups are probed in triangular sequence until a group containing an EMPTY slot is found
+//	. The table grows automatically to keep its load factor below 7/8
+//
+// Memory usage is ((1 + sizeof(Entry)) * size) bytes
 //
-// simple hashtable
-// David Kaplan <david[at]2of1.org>, 2011
-// 
-// mem = (16 + 8 * size + 24 * entries) bytes [64-bit]
-// mem = (8 + 4 * size + 12 * entries) bytes [32-bit]
-// 
-// some sizes for reference [64-bit]
-// 2^8  = 16K [probably too small - depending on use]
-// 2^16 = 512K [even bigger would be better]
-// 2^24 = 128MB [probably a bit too much]
-// 2^32 = 32GB [whooooa! watch that heap space!]
-// 
-// the hashtable uses basic linked-lists for handling collisions
-// 
-#define HT_DEFAULT_SIZE_POT	13U	// Default size if 8Kb
+// ForEach() is stable: entries never move during a visit so the visitor can modify values or even remove the visited entry (but not add new entries).
+// WARNING: Adding entries may grow the table and move existing ones so pointers returned by Get() or Add() are only valid until the next Add()!
+//
+#define HT_DEFAULT_SIZE_POT	4U	// Default size is 16 slots (tables grow automatically)
 #define HT_MAX_KEYLEN	1024U
 
-#if defined(_DEBUG) || !defined(GODCOMPLEX)
+// Default key traits, using the GetHash() and Compare() functions declared for the key type
+// Specialize (or provide your own traits class) to support other key types or heterogeneous lookups
+template<typename K> struct	DictionaryKeyTraits {
+	static U32	Hash( const K& _Key )					{ return GetHash( _Key ); }
+	static bool	Equals( const K& _a, const K& _b )		{ return Compare( _a, _b ) == 0; }
+};
 
-// Hashtable of strings, only used to access constants & uniforms by name in the shaders in DEBUG mode
-template<typename T> class	DictionaryString {
-protected:	// NESTED TYPES
+template<> struct	DictionaryKeyTraits<U32> {
+	static U32	Hash( U32 _Key )						{ return _Key; }
+	static bool	Equals( U32 _a, U32 _b )				{ return _a == _b; }
+};
 
-	struct	Node {
-		struct Node*	pNext;
-		BString			key;
-		T				value;
+// String keys can be looked up with a simple const char* without having to construct a BString
+template<> struct	DictionaryKeyTraits<BString> {
+	static U32	Hash( const BString& _Key )				{ return _Key.Hash(); }
+	static U32	Hash( const char* _Key )				{ return BString::Hash( _Key ); }
+	static bool	Equals( const BString& _a, const BString& _b )	{ return strcmp( _a, _b ) == 0; }
+	static bool	Equals( const BString& _a, const char* _b )		{ return strcmp( _a, _b ) == 0; }
+};
+
+template<typename K, typename T, typename TRAITS=DictionaryKeyTraits<K> > class	HashTable {
+public:		// NESTED TYPES
+
+	struct	Entry {
+		U32		Hash;
+		K		Key;
+		T		Value;
 	};
 
-public:
+protected:
 
-	typedef bool	(*VisitorDelegate)( int _EntryIndex, const BString& _key, T& _Value, void* _pUserData );
+	static const U32	GROUP_POT = 4;
+	static const U32	GROUP_SIZE = 1 << GROUP_POT;
+	static const U8		CONTROL_EMPTY = 0x80;
+	static const U8		CONTROL_DELETED = 0xFE;
+	static const U32	INVALID_SLOT = ~0U;
 
 protected:	// FIELDS
 
-	Node**	m_ppTable;
-	int		m_POT;
-	int		m_SizePOT;
-	int		m_EntriesCount;
+	IAllocator&		m_Allocator;
+	U8*				m_pControls;		// 1 control byte per slot
+	Entry*			m_pEntries;			// 1 entry per slot (only constructed for occupied slots)
+	U32				m_POT;				// Size of the table is 2^m_POT slots
+	U32				m_EntriesCount;
+	U32				m_DeletedCount;		// Amount of DELETED slots
+
+#ifdef _DEBUG
+public:
+	static int		ms_MaxCollisionsCount;	// You can examine this to know if one of the dictionaries has too many collisions (i.e. too many groups were probed)
+#endif
+
+public:		// PROPERTIES
+
+	int				GetEntriesCount() const		{ return int( m_EntriesCount ); }	// Amount of entries in the dictionary
+	U32				GetSize() const				{ return m_pControls != NULL ? 1U << m_POT : 0U; }
 
 public:		// METHODS
 
-	DictionaryString( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT );
-	~DictionaryString();
+	HashTable( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT, IAllocator& _Allocator=GetDefaultAllocator() );
+	~HashTable();
 
-	T*		Get( const BString& _key ) const;					// retrieve entry
-	T&		Add( const BString& _key );							// store entry
-	T&		AddUnique( const BString& _key );					// store entry
-	void	Add( const BString& _key, const T& _Value );			// store entry
-	void	AddUnique( const BString& _key, const T& _Value );	// store entry
-	void	Remove( const BString& _key );						// remove entry
-	void	ForEach( VisitorDelegate _pDelegate, void* _pUserData );
+	// Retrieves an entry (the key can be of any type supported by the traits' Hash() and Equals() methods)
+	template<typename KEY>
+	T*				Get( const KEY& _Key ) const;
 
-public:
+	// Stores an entry, replacing the existing value if the key already exists
+	T&				Add( const K& _Key );
+	T&				Add( const K& _Key, const T& _Value );
 
-//	static U32	Hash( const String& _key );
-	static U32	Hash( U32 _Key );
+	// Stores an entry only if the key doesn't already exist, returns the existing value otherwise
+	T&				AddUnique( const K& _Key );
+	T&				AddUnique( const K& _Key, const T& _Value );
 
-private:
-	U32 Fibonacci( U32 _key ) const {
-		return Fibonacci32( _key, m_POT );
-	}
-};
+	// Removes an entry, returns false if it didn't exist
+	template<typename KEY>
+	bool			Remove( const KEY& _Key );
 
-#endif
+	void			Clear();
 
-//////////////////////////////////////////////////////////////////////////
-// Specific dictionary storing explicit typed values
-template<typename T> class	Dictionary {
-protected:	// NESTED TYPES
+	// Makes sure the dictionary can store at least _EntriesCount entries without growing
+	void			Reserve( U32 _EntriesCount );
 
-	struct	Node {
-		struct Node*	pNext;
-		U32				key;
-		T				value;
-	};
+	// Visits all the entries (the visitor can be any class or lambda implementing "void operator()( Entry& _Entry ) const")
+	template<typename VISITOR>
+	void			ForEachEntry( const VISITOR& _Visitor );
 
-public:
+protected:
+	U32				Fibonacci( U32 _key ) const {
+		return Fibonacci32( _key, m_POT );
+	}
 
-	typedef void	(*VisitorDelegate)( int _EntryIndex, T& _Value, void* _pUserData );
+	static U8		GetControlHash( U32 _Hash )	{ return U8( (_Hash ^ (_Hash >> 7) ^ (_Hash >> 14) ^ (_Hash >> 21) ^ (_Hash >> 28)) & 0x7F ); }
 
+	template<typename KEY>
+	U32				FindSlot( const KEY& _Key, U32 _Hash ) const;
+	U32				FindFreeSlot( U32 _Hash ) const;
+	T&				Insert( const K& _Key, U32 _Hash, bool _ResetExisting );
+	void			Rehash( U32 _POT );
+	void			DestroyEntries();
+	static bool		IsOccupied( U8 _Control )	{ return _Control < 0x80; }
 
-protected:	// FIELDS
+private:
+	HashTable( const HashTable& );
+	HashTable&		operator=( const HashTable& );
+};
 
-	Node**	m_ppTable;
-	int		m_POT;
-	int		m_SizePOT;
-	int		m_EntriesCount;
+#if defined(_DEBUG) || !defined(GODCOMPLEX)
 
-#ifdef _DEBUG
+// Hashtable of strings, only used to access constants & uniforms by name in the shaders in DEBUG mode
+template<typename T> class	DictionaryString : public HashTable<BString, T> {
 public:
-	static int	ms_MaxCollisionsCount;	// You can examine this to know if one of the dictionaries has too many collisions (i.e. size too small)
-#endif
 
-public:		// METHODS
+	typedef bool	(*VisitorDelegate)( int _EntryIndex, const BString& _key, T& _Value, void* _pUserData );
 
-	Dictionary( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT );
-	~Dictionary();
+public:		// METHODS
 
-	int		GetEntriesCount() const		{ return m_EntriesCount; }	// Amount of entries in the dictionary
+	DictionaryString( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT ) : HashTable<BString, T>( _PowerOfTwoSize ) {}
 
-	T*		Get( U32 _Key ) const;				// retrieve entry
-	T&		Add( U32 _Key );					// store entry
-	T&		Add( U32 _Key, const T& _Value );	// store entry
-	void	Remove( U32 _Key );					// remove entry
-	void	Clear();
 	void	ForEach( VisitorDelegate _pDelegate, void* _pUserData );
 
-private:
-	U32 Fibonacci( U32 _key ) const {
-		return Fibonacci32( _key, m_POT );
-	}
+public:
+
+//	static U32	Hash( const String& _key );
+	static U32	Hash( U32 _Key );
 };
 
-// General dictionary storing blind values
-class	DictionaryU32 {
-protected:	// NESTED TYPES
+#endif
 
-	struct	Node {
-		struct Node*	pNext;
-		U32				Key;
-		void*			pValue;
-	};
- 
+//////////////////////////////////////////////////////////////////////////
+// Specific dictionary storing explicit typed values
+template<typename T> class	Dictionary : public HashTable<U32, T> {
 public:
 
-	typedef void	(*VisitorDelegate)( int _EntryIndex, void*& _pValue, void* _pUserData );
+	typedef void	(*VisitorDelegate)( int _EntryIndex, T& _Value, void* _pUserData );
 
-protected:	// FIELDS
+public:		// METHODS
 
-	Node**	m_ppTable;
-	int		m_POT;
-	int		m_SizePOT;
+	Dictionary( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT ) : HashTable<U32, T>( _PowerOfTwoSize ) {}
 
-#ifdef _DEBUG
+	void	ForEach( VisitorDelegate _pDelegate, void* _pUserData );
+};
+
+// General dictionary storing blind values
+class	DictionaryU32 : public HashTable<U32, void*> {
 public:
-	static int	ms_MaxCollisionsCount;	// You can examine this to know if one of the dictionaries has too many collisions (i.e. size too small)
-#endif
+
+	typedef void	(*VisitorDelegate)( int _EntryIndex, void*& _pValue, void* _pUserData );
 
 public:		// METHODS
 
-	DictionaryU32( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT );
-	~DictionaryU32();
+	DictionaryU32( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT ) : HashTable<U32, void*>( _PowerOfTwoSize ) {}
 
 	void*	Get( U32 _Key ) const;			// retrieve entry
 	void	Add( U32 _Key, void* _pValue );	// store entry
 	void	Remove( U32 _Key );				// remove entry
 	void	ForEach( VisitorDelegate _pDelegate, void* _pUserData );
-
-private:
-	U32	Fibonacci( U32 _key ) const {
-		return Fibonacci32( _key, m_POT );
-	}
 };
 
 //////////////////////////////////////////////////////////////////////////
 // Generic dictionary storing explicit typed values and using an explicit key class
-template<typename K, typename T> class	DictionaryGeneric {
-protected:		// NESTED TYPES
-
-	struct	Node {
-		struct Node*		pNext;
-		K					key;
-		T					value;
-	};
-
+template<typename K, typename T> class	DictionaryGeneric : public HashTable<K, T> {
 public:
 
 	// Must return true to continue, false to abort visit
 	typedef bool	(*VisitorDelegate)( int _EntryIndex, const K& _key, T& _Value, void* _pUserData );
 
-
-protected:	// FIELDS
-
-	Node**	m_ppTable;
-	int		m_POT;
-	int		m_SizePOT;
-	int		m_EntriesCount;
-
-#ifdef _DEBUG
-public:
-	static int	ms_MaxCollisionsCount;	// You can examine this to know if one of the dictionaries has too many collisions (i.e. size too small)
-#endif
-
 public:		// METHODS
 
-	DictionaryGeneric( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT );
-	~DictionaryGeneric();
+	DictionaryGeneric( int _PowerOfTwoSize=HT_DEFAULT_SIZE_POT ) : HashTable<K, T>( _PowerOfTwoSize ) {}
 
-	int		GetEntriesCount() const		{ return m_EntriesCount; }	// Amount of entries in the dictionary
-
-	T*		Get( const K& _Key ) const;				// retrieve entry
-	T&		Add( const K& _Key );					// store entry
-	T&		Add( const K& _Key, const T& _Value );	// store entry
-	void	Remove( const K& _Key );				// remove entry
-	void	Clear();
 	void	ForEach( VisitorDelegate _pDelegate, void* _pUserData );
-
-private:
-	U32 Fibonacci( U32 _key ) const {
-		return Fibonacci32( _key, m_POT );
-	}
 };
 
 
 //////////////////////////////////////////////////////////////////////////
 #include "Hashtable.inl"
 
-}	// namespace BaseLib
\ No newline at end of file
+}	// namespace BaseLib
@@ -1,412 +1,360 @@
-#if defined(_DEBUG) || !defined(GODCOMPLEX)
-
 //////////////////////////////////////////////////////////////////////////
-// String version
-template<typename T> DictionaryString<T>::DictionaryString( int _PowerOfTwoSize ) : m_EntriesCount( 0 )
-{
-	m_POT = _PowerOfTwoSize;
-	m_SizePOT = 1 << m_POT;
-	m_ppTable = new Node*[m_SizePOT];
-	memset( m_ppTable, 0, m_SizePOT*sizeof(Node*) );
-}
-template<typename T> DictionaryString<T>::~DictionaryString() {
-	for ( int i=0; i < m_SizePOT; i++ ) {
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL ) {
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
-			delete pOld;
-		}
-	}
-
-	delete[] m_ppTable;
-}
+// Group matching helpers
+//
+namespace HashTableInternal {
 
-template<typename T> T*	DictionaryString<T>::Get( const BString& _key ) const {
-	if ( !m_EntriesCount )
-		return NULL;
+	// Returns a bit mask of the group's control bytes equal to _Value
+	inline U32	MatchByte( const U8* _pGroup, U8 _Value ) {
+	#ifdef HT_USE_SSE2
+		__m128i	Group = _mm_load_si128( (const __m128i*) _pGroup );
+		return U32( _mm_movemask_epi8( _mm_cmpeq_epi8( Group, _mm_set1_epi8( char(_Value) ) ) ) );
+	#else
+		U32	Mask = 0;
+		for ( U32 i=0; i < 16; i++ )
+			Mask |= (_pGroup[i] == _Value ? 1U : 0U) << i;
+		return Mask;
+	#endif
+	}
 
-//	U32		idx = _key.Hash() & (m_SizePOT-1);
-	U32		idx = Fibonacci( _key.Hash() );
+	// Returns a bit mask of the group's EMPTY or DELETED control bytes (i.e. those with their high bit set)
+	inline U32	MatchFree( const U8* _pGroup ) {
+	#ifdef HT_USE_SSE2
+		return U32( _mm_movemask_epi8( _mm_load_si128( (const __m128i*) _pGroup ) ) );
+	#else
+		U32	Mask = 0;
+		for ( U32 i=0; i < 16; i++ )
+			Mask |= U32(_pGroup[i] >> 7) << i;
+		return Mask;
+	#endif
+	}
 
-	Node*	pNode = m_ppTable[idx];
-	while ( pNode != NULL ) {
-		if ( !BString::Compare( _key, pNode->key, HT_MAX_KEYLEN ) )
-			return &pNode->value;
- 
-		pNode = pNode->pNext;
+	inline U32	LowestBitIndex( U32 _Mask ) {
+	#ifdef _MSC_VER
+		unsigned long	Index;
+		_BitScanForward( &Index, _Mask );
+		return U32( Index );
+	#else
+		return U32( __builtin_ctz( _Mask ) );
+	#endif
 	}
- 
-	return NULL;
 }
 
-template<typename T> T&	DictionaryString<T>::Add( const BString& _key ) {
-//	U32		idx = _key.Hash() & (m_SizePOT-1);
-	U32		idx = Fibonacci( _key.Hash() );
-
- 	Node*	pNode = new Node();
+//////////////////////////////////////////////////////////////////////////
+// Open-addressing hash table
+//
+#ifdef _DEBUG
+template<typename K, typename T, typename TRAITS>
+int	HashTable<K,T,TRAITS>::ms_MaxCollisionsCount = 0;
+#endif
 
-	int		keyLength = int( MIN( _key.Length(), HT_MAX_KEYLEN ) + 1 );
-	pNode->key = _key;
-	pNode->pNext = m_ppTable[idx];
-	m_ppTable[idx] = pNode;
+template<typename K, typename T, typename TRAITS>
+HashTable<K,T,TRAITS>::HashTable( int _PowerOfTwoSize, IAllocator& _Allocator )
+	: m_Allocator( _Allocator )
+	, m_pControls( NULL )
+	, m_pEntries( NULL )
+	, m_POT( MAX( U32(_PowerOfTwoSize), U32(GROUP_POT) ) )
+	, m_EntriesCount( 0 )
+	, m_DeletedCount( 0 )
+{
+	// The table is only allocated on first insertion
+}
 
-	m_EntriesCount++;
+template<typename K, typename T, typename TRAITS>
+HashTable<K,T,TRAITS>::~HashTable() {
+	if ( m_pControls == NULL )
+		return;
 
-	return pNode->value;
+	DestroyEntries();
+	m_Allocator.Free( m_pEntries, (1U << m_POT) * sizeof(Entry), __alignof(Entry) );
+	m_Allocator.Free( m_pControls, 1U << m_POT, GROUP_SIZE );
 }
 
-template<typename T> T&	DictionaryString<T>::AddUnique( const BString& _key ) {
-	T*	pExisting = Get( _key );
-	if ( pExisting != NULL )
-		return *pExisting;
+template<typename K, typename T, typename TRAITS> template<typename KEY>
+T*	HashTable<K,T,TRAITS>::Get( const KEY& _Key ) const {
+	if ( m_EntriesCount == 0 )
+		return NULL;
 
-	return Add( _pKey );
-}
+	U32	Slot = FindSlot( _Key, TRAITS::Hash( _Key ) );
+	if ( Slot == INVALID_SLOT )
+		return NULL;
 
-template<typename T> void	DictionaryString<T>::Add( const BString& _key, const T& _Value ) {
-	T&	Value = Add( _key );
-		Value = _Value;
+	return &m_pEntries[Slot].Value;
 }
 
-template<typename T> void	DictionaryString<T>::AddUnique( const BString& _key, const T& _Value ) {
-	T&	Value = AddUnique( _key );
-		Value = _Value;
+template<typename K, typename T, typename TRAITS>
+T&	HashTable<K,T,TRAITS>::Add( const K& _Key ) {
+	return Insert( _Key, TRAITS::Hash( _Key ), true );
 }
 
-template<typename T> void	DictionaryString<T>::Remove( const BString& _key ) {
-//	U32		idx = _key.Hash() & (m_SizePOT-1);
-	U32		idx = Fibonacci( _key.Hash() );
- 
-	Node*	pPrevious = NULL;
-	Node*	pCurrent = m_ppTable[idx];
-	while ( pCurrent != NULL ) {
-		if ( !BString::Compare( _key, pCurrent->key, HT_MAX_KEYLEN ) ) {
-			if ( pPrevious != NULL )
-				pPrevious->pNext = pCurrent->pNext;	// Link over...
-			else
-				m_ppTable[idx] = pCurrent->pNext;	// We replaced the root key...
- 
-			delete pCurrent;
- 
-			m_EntriesCount--;
-
-			return;
-		}
- 
-		pPrevious = pCurrent;
-		pCurrent = pCurrent->pNext;
-	}
+template<typename K, typename T, typename TRAITS>
+T&	HashTable<K,T,TRAITS>::Add( const K& _Key, const T& _Value ) {
+	T	NewValue( _Value );	// _Value may be an entry of this table that Insert() moves when growing
+	T&	Value = Insert( _Key, TRAITS::Hash( _Key ), false );
+	Value = NewValue;
+	return Value;
 }
 
-// template<typename T> U32	DictionaryString<T>::Hash( const String& _key )
-// {
-//   /* djb2 */
-//   U32 hash = 5381;
-//   int c;
-//  
-//   while ( c = *_pKey++ )
-//     hash = ((hash << 5) + hash) + c;
-//  
-//   return hash;
-// }
-
-template<typename T> U32	DictionaryString<T>::Hash( U32 _Key )
-{
-	U32	hash = 5381;
-
-	hash = ((hash << 5) + hash) + (_Key & 0xFF);	_Key >>= 8;
-	hash = ((hash << 5) + hash) + (_Key & 0xFF);	_Key >>= 8;
-	hash = ((hash << 5) + hash) + (_Key & 0xFF);	_Key >>= 8;
-	hash = ((hash << 5) + hash) + _Key;
-
-  return hash;
+template<typename K, typename T, typename TRAITS>
+T&	HashTable<K,T,TRAITS>::AddUnique( const K& _Key ) {
+	return Insert( _Key, TRAITS::Hash( _Key ), false );
 }
 
-template<typename T> void	DictionaryString<T>::ForEach( VisitorDelegate _pDelegate, void* _pUserData ) {
-	int	EntryIndex = 0;
-	for ( int i=0; i < m_SizePOT; i++ ) {
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL ) {
-			if ( !(*_pDelegate)( EntryIndex++, pNode->key, pNode->value, _pUserData ) )
-				return;	// Stop!
-			pNode = pNode->pNext;
-		}
-	}
+template<typename K, typename T, typename TRAITS>
+T&	HashTable<K,T,TRAITS>::AddUnique( const K& _Key, const T& _Value ) {
+	T	NewValue( _Value );	// _Value may be an entry of this table that Insert() moves when growing
+	U32	EntriesCount = m_EntriesCount;
+	T&	Value = Insert( _Key, TRAITS::Hash( _Key ), false );
+	if ( m_EntriesCount != EntriesCount )
+		Value = NewValue;	// Only assign new entries
+	return Value;
 }
 
-#endif
-
-//////////////////////////////////////////////////////////////////////////
-// U32 specific version
-//
-#ifdef _DEBUG
-template<typename T> int	Dictionary<T>::ms_MaxCollisionsCount = 0;
-#endif
-
-template<typename T> Dictionary<T>::Dictionary( int _PowerOfTwoSize ) : m_EntriesCount( 0 ) {
-	m_POT = _PowerOfTwoSize;
-	m_SizePOT = 1 << m_POT;
-	m_ppTable = new Node*[m_SizePOT];
-	memset( m_ppTable, 0, m_SizePOT*sizeof(Node*) );
-}
-template<typename T> Dictionary<T>::~Dictionary() {
-	for ( int i=0; i < m_SizePOT; i++ ) {
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL ) {
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
-
-			delete pOld;
-		}
+template<typename K, typename T, typename TRAITS> template<typename KEY>
+bool	HashTable<K,T,TRAITS>::Remove( const KEY& _Key ) {
+	if ( m_EntriesCount == 0 )
+		return false;
+
+	U32	Slot = FindSlot( _Key, TRAITS::Hash( _Key ) );
+	if ( Slot == INVALID_SLOT )
+		return false;
+
+	m_pEntries[Slot].~Entry();
+	m_EntriesCount--;
+
+	// If the group still has an EMPTY slot then no probe sequence ever went past it and we can mark the slot as EMPTY as well
+	const U8*	pGroup = m_pControls + (Slot & ~(GROUP_SIZE-1));
+	if ( HashTableInternal::MatchByte( pGroup, CONTROL_EMPTY ) != 0 ) {
+		m_pControls[Slot] = CONTROL_EMPTY;
+	} else {
+		m_pControls[Slot] = CONTROL_DELETED;
+		m_DeletedCount++;
 	}
 
-	delete[] m_ppTable;
+	return true;
 }
 
-template<typename T> T*	Dictionary<T>::Get( U32 _Key ) const {
-	if ( !m_EntriesCount )
-		return NULL;
-
-//	U32		idx = _Key & (m_SizePOT-1);
-	U32		idx = Fibonacci( _Key );
-	Node*	pNode = m_ppTable[idx];
+template<typename K, typename T, typename TRAITS>
+void	HashTable<K,T,TRAITS>::Clear() {
+	if ( m_pControls == NULL )
+		return;
 
-#ifdef _DEBUG
-	int		CollisionsCount = 0;
-	while ( pNode != NULL ) {
-		if ( _Key == pNode->key ) {
-			ms_MaxCollisionsCount = MAX( ms_MaxCollisionsCount, CollisionsCount );
-			return &pNode->value;
-		}
- 
-		pNode = pNode->pNext;
-		CollisionsCount++;
-	}
-#else
-	while ( pNode != NULL )
-	{
-		if ( _Key == pNode->key )
-			return &pNode->value;
- 
-		pNode = pNode->pNext;
-	}
-#endif
-
-	return NULL;
+	DestroyEntries();
+	memset( m_pControls, CONTROL_EMPTY, 1U << m_POT );
+	m_EntriesCount = 0;
+	m_DeletedCount = 0;
 }
 
-template<typename T> T&	Dictionary<T>::Add( U32 _Key ) {
-//	U32		idx = _Key & (m_SizePOT-1);
-	U32		idx = Fibonacci( _Key );
- 
-	Node*	pNode = new Node();
-	pNode->key = _Key;
-	pNode->pNext = m_ppTable[idx];	// Here, we could add a check for m_ppTable[idx] == NULL to ensure no collision...
-	m_ppTable[idx] = pNode;
-
-	m_EntriesCount++;
+template<typename K, typename T, typename TRAITS>
+void	HashTable<K,T,TRAITS>::Reserve( U32 _EntriesCount ) {
+	U32	POT = m_POT;
+	while ( 8 * U64(_EntriesCount) > 7 * (U64(1) << POT) )
+		POT++;
 
-	return pNode->value;
+	if ( POT != m_POT || m_pControls == NULL )
+		Rehash( POT );
 }
 
-template<typename T> T&	Dictionary<T>::Add( U32 _Key, const T& _Value ) {
-	T&	Value = Add( _Key );
-	memcpy( &Value, &_Value, sizeof(T) );
-
-	return Value;
+template<typename K, typename T, typename TRAITS> template<typename VISITOR>
+void	HashTable<K,T,TRAITS>::ForEachEntry( const VISITOR& _Visitor ) {
+	U32	Size = GetSize();
+	for ( U32 Slot=0; Slot < Size; Slot++ ) {
+		if ( IsOccupied( m_pControls[Slot] ) )
+			_Visitor( m_pEntries[Slot] );
+	}
 }
 
-template<typename T> void	Dictionary<T>::Remove( U32 _Key )
-{
-//	U32		idx = _Key & (m_SizePOT-1);
-	U32		idx = Fibonacci( _Key );
- 
-	Node*	pPrevious = NULL;
-	Node*	pCurrent = m_ppTable[idx];
-	while ( pCurrent != NULL ) {
-		if ( _Key == pCurrent->key ) {
-			if ( pPrevious != NULL )
-				pPrevious->pNext = pCurrent->pNext;	// Link over...
-			else
-				m_ppTable[idx] = pCurrent->pNext;	// We replaced the root key...
-
-			delete pCurrent;
-
-			m_EntriesCount--;
-
- 			return;
+// Returns the slot containing the key, or INVALID_SLOT if not found
+template<typename K, typename T, typename TRAITS> template<typename KEY>
+U32	HashTable<K,T,TRAITS>::FindSlot( const KEY& _Key, U32 _Hash ) const {
+	U8	ControlHash = GetControlHash( _Hash );
+	U32	GroupsMask = (1U << (m_POT - GROUP_POT)) - 1;
+	U32	GroupIndex = Fibonacci( _Hash ) >> GROUP_POT;
+
+	// There's always at least 1 EMPTY slot since the load factor is kept below 7/8 so the loop always terminates
+	for ( U32 Step=1; ; Step++ ) {
+		U32			GroupStart = GroupIndex << GROUP_POT;
+		const U8*	pGroup = m_pControls + GroupStart;
+
+		U32	Mask = HashTableInternal::MatchByte( pGroup, ControlHash );
+		while ( Mask != 0 ) {
+			U32				Slot = GroupStart + HashTableInternal::LowestBitIndex( Mask );
+			const Entry&	E = m_pEntries[Slot];
+			if ( E.Hash == _Hash && TRAITS::Equals( E.Key, _Key ) ) {
+				#ifdef _DEBUG
+					ms_MaxCollisionsCount = MAX( ms_MaxCollisionsCount, int(Step-1) );
+				#endif
+				return Slot;
+			}
+			Mask &= Mask-1;
 		}
- 
-		pPrevious = pCurrent;
-		pCurrent = pCurrent->pNext;
+
+		if ( HashTableInternal::MatchByte( pGroup, CONTROL_EMPTY ) != 0 )
+			return INVALID_SLOT;	// Not found
+
+		GroupIndex = (GroupIndex + Step) & GroupsMask;
 	}
 }
 
-template<typename T> void	Dictionary<T>::Clear() {
-	// Clear all linked lists of nodes from each head
-	for ( int HeadIndex=0; HeadIndex < m_Size; HeadIndex++ ) {
-		Node*	pNode = m_ppTable[HeadIndex];
-		while ( pNode != NULL ) {
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
-			delete pOld;
-		}
+// Returns the first EMPTY or DELETED slot in the probe sequence of the given hash
+template<typename K, typename T, typename TRAITS>
+U32	HashTable<K,T,TRAITS>::FindFreeSlot( U32 _Hash ) const {
+	U32	GroupsMask = (1U << (m_POT - GROUP_POT)) - 1;
+	U32	GroupIndex = Fibonacci( _Hash ) >> GROUP_POT;
+	for ( U32 Step=1; ; Step++ ) {
+		U32	GroupStart = GroupIndex << GROUP_POT;
+		U32	Mask = HashTableInternal::MatchFree( m_pControls + GroupStart );
+		if ( Mask != 0 )
+			return GroupStart + HashTableInternal::LowestBitIndex( Mask );
+
+		GroupIndex = (GroupIndex + Step) & GroupsMask;
 	}
-	// Clear heads
-	memset( m_ppTable, 0, m_Size*sizeof(Node*) );
 }
 
-template<typename T> void	Dictionary<T>::ForEach( VisitorDelegate _pDelegate, void* _pUserData ) {
-	int	EntryIndex = 0;
-	for ( int i=0; i < m_SizePOT; i++ ) {
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL ) {
-			(*_pDelegate)( EntryIndex++, pNode->value, _pUserData );
-			pNode = pNode->pNext;
+template<typename K, typename T, typename TRAITS>
+T&	HashTable<K,T,TRAITS>::Insert( const K& _Key, U32 _Hash, bool _ResetExisting ) {
+	if ( m_pControls == NULL ) {
+		Rehash( m_POT );
+	} else if ( m_EntriesCount > 0 ) {
+		U32	ExistingSlot = FindSlot( _Key, _Hash );
+		if ( ExistingSlot != INVALID_SLOT ) {
+			T&	Value = m_pEntries[ExistingSlot].Value;
+			if ( _ResetExisting )
+				Value = T();
+			return Value;
 		}
 	}
-}
 
-//////////////////////////////////////////////////////////////////////////
-// Generic version
-//
-#ifdef _DEBUG
-template<typename K, typename T>
-int	DictionaryGeneric<K,T>::ms_MaxCollisionsCount = 0;
-#endif
+	// Grow or clean up DELETED slots if necessary (the key is copied first as it may be an entry of this table)
+	K	Key( _Key );
+	U32	Size = 1U << m_POT;
+	if ( 8 * (m_EntriesCount + m_DeletedCount + 1) > 7 * Size ) {
+		if ( 16 * (m_EntriesCount + 1) <= 7 * Size )
+			Rehash( m_POT );		// Mostly DELETED slots, rehash in place
+		else
+			Rehash( m_POT + 1 );
+	}
 
-template<typename K, typename T>
-DictionaryGeneric<K,T>::DictionaryGeneric( int _PowerOfTwoSize ) : m_EntriesCount( 0 )
-{
-	m_POT = _PowerOfTwoSize;
-	m_SizePOT = 1 << m_POT;
-	m_ppTable = new Node*[m_SizePOT];
-	memset( m_ppTable, 0, m_SizePOT*sizeof(Node*) );
+	U32	Slot = FindFreeSlot( _Hash );
+	if ( m_pControls[Slot] == CONTROL_DELETED )
+		m_DeletedCount--;
+	m_pControls[Slot] = GetControlHash( _Hash );
+	m_EntriesCount++;
+
+	Entry*	pEntry = new (m_pEntries + Slot) Entry();
+	pEntry->Hash = _Hash;
+	pEntry->Key = Key;
+
+	return pEntry->Value;
 }
-template<typename K, typename T>
-DictionaryGeneric<K,T>::~DictionaryGeneric()
-{
-	for ( int i=0; i < m_SizePOT; i++ )
-	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
-
-			delete pOld;
+
+// Reallocates the table and moves existing entries into it (hashes are not recomputed)
+template<typename K, typename T, typename TRAITS>
+void	HashTable<K,T,TRAITS>::Rehash( U32 _POT ) {
+	ASSERT( _POT < 32, "Hash table is too large!" );
+
+	U8*		pOldControls = m_pControls;
+	Entry*	pOldEntries = m_pEntries;
+	U32		OldSize = GetSize();
+
+	m_POT = _POT;
+	U32	Size = 1U << m_POT;
+	m_pControls = (U8*) m_Allocator.Allocate( Size, GROUP_SIZE );
+	m_pEntries = (Entry*) m_Allocator.Allocate( Size * sizeof(Entry), __alignof(Entry) );
+	RELEASE_ASSERT( m_pControls != NULL && m_pEntries != NULL, "Failed to allocate hash table!" );
+	memset( m_pControls, CONTROL_EMPTY, Size );
+	m_DeletedCount = 0;
+
+	if ( pOldControls == NULL )
+		return;
+
+	for ( U32 OldSlot=0; OldSlot < OldSize; OldSlot++ ) {
+		if ( !IsOccupied( pOldControls[OldSlot] ) )
+			continue;
+
+		Entry&	OldEntry = pOldEntries[OldSlot];
+		U32		Slot = FindFreeSlot( OldEntry.Hash );
+		m_pControls[Slot] = pOldControls[OldSlot];
+		if ( IsTriviallyCopyable<Entry>::Value ) {
+			memcpy( m_pEntries + Slot, &OldEntry, sizeof(Entry) );
+		} else {
+			new (m_pEntries + Slot) Entry( Move( OldEntry ) );
+			OldEntry.~Entry();
 		}
 	}
 
-	delete[] m_ppTable;
+	m_Allocator.Free( pOldEntries, OldSize * sizeof(Entry), __alignof(Entry) );
+	m_Allocator.Free( pOldControls, OldSize, GROUP_SIZE );
 }
 
-template<typename K, typename T>
-T*	DictionaryGeneric<K,T>::Get( const K& _Key ) const {
-	if ( !m_EntriesCount )
-		return NULL;
-
-//	U32		idx = GetHash( _Key ) & (m_SizePOT-1);
-	U32		idx = Fibonacci( GetHash( _Key ) );
-	Node*	pNode = m_ppTable[idx];
-
-	#ifdef _DEBUG
-		int		CollisionsCount = 0;
-		while ( pNode != NULL ) {
-			if ( Compare( _Key, pNode->key ) == 0 ) {
-				ms_MaxCollisionsCount = MAX( ms_MaxCollisionsCount, CollisionsCount );
-				return &pNode->value;
-			}
- 
-			pNode = pNode->pNext;
-			CollisionsCount++;
-		}
-	#else
-		while ( pNode != NULL ) {
-			if ( Compare( _Key, pNode->key ) == 0 )
-				return &pNode->value;
- 
-			pNode = pNode->pNext;
-		}
-	#endif
+template<typename K, typename T, typename TRAITS>
+void	HashTable<K,T,TRAITS>::DestroyEntries() {
+	if ( IsTriviallyDestructible<Entry>::Value )
+		return;
 
-	return NULL;
+	U32	Size = GetSize();
+	for ( U32 Slot=0; Slot < Size; Slot++ ) {
+		if ( IsOccupied( m_pControls[Slot] ) )
+			m_pEntries[Slot].~Entry();
+	}
 }
 
-template<typename K, typename T>
-T&	DictionaryGeneric<K,T>::Add( const K& _key ) {
-//	U32		idx = GetHash( _key ) & (m_SizePOT-1);
-	U32		idx = Fibonacci( GetHash( _key ) );
- 
-	Node*	pNode = new Node();
-	pNode->key = _key;
-	pNode->pNext = m_ppTable[idx];	// Here, we could add a check for m_ppTable[idx] == NULL to ensure no collision...
-	m_ppTable[idx] = pNode;
 
-	m_EntriesCount++;
+#if defined(_DEBUG) || !defined(GODCOMPLEX)
 
-	return pNode->value;
-}
+//////////////////////////////////////////////////////////////////////////
+// String version
+template<typename T> U32	DictionaryString<T>::Hash( U32 _Key )
+{
+	U32	hash = 5381;
 
-template<typename K, typename T>
-T&	DictionaryGeneric<K,T>::Add( const K& _key, const T& _value ) {
-	T&	value = Add( _key );
-	value = _value;
+	hash = ((hash << 5) + hash) + (_Key & 0xFF);	_Key >>= 8;
+	hash = ((hash << 5) + hash) + (_Key & 0xFF);	_Key >>= 8;
+	hash = ((hash << 5) + hash) + (_Key & 0xFF);	_Key >>= 8;
+	hash = ((hash << 5) + hash) + _Key;
 
-	return value;
+  return hash;
 }
 
-template<typename K, typename T>
-void	DictionaryGeneric<K,T>::Remove( const K& _key ) {
-//	U32		idx = GetHash( _key ) & (m_SizePOT-1);
-	U32		idx = Fibonacci( GetHash( _key ) );
- 
-	Node*	pPrevious = NULL;
-	Node*	pCurrent = m_ppTable[idx];
-	while ( pCurrent != NULL ) {
-		if ( Compare( _key, pCurrent->key ) == 0 ) {
-			if ( pPrevious != NULL )
-				pPrevious->pNext = pCurrent->pNext;	// Link over...
-			else
-				m_ppTable[idx] = pCurrent->pNext;	// We replaced the root key...
-
-			delete pCurrent;
-
-			m_EntriesCount--;
-
- 			return;
-		}
- 
-		pPrevious = pCurrent;
-		pCurrent = pCurrent->pNext;
+template<typename T> void	DictionaryString<T>::ForEach( VisitorDelegate _pDelegate, void* _pUserData ) {
+	int	EntryIndex = 0;
+	U32	Size = this->GetSize();
+	for ( U32 Slot=0; Slot < Size; Slot++ ) {
+		if ( !this->IsOccupied( this->m_pControls[Slot] ) )
+			continue;
+
+		typename HashTable<BString, T>::Entry&	E = this->m_pEntries[Slot];
+		if ( !(*_pDelegate)( EntryIndex++, E.Key, E.Value, _pUserData ) )
+			return;	// Stop!
 	}
 }
 
-template<typename K, typename T>
-void	DictionaryGeneric<K,T>::Clear() {
-	// Clear all linked lists of nodes from each head
-	for ( int HeadIndex=0; HeadIndex < m_Size; HeadIndex++ ) {
-		Node*	pNode = m_ppTable[HeadIndex];
-		while ( pNode != NULL ) {
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
-			delete pOld;
-		}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// U32 specific version
+//
+template<typename T> void	Dictionary<T>::ForEach( VisitorDelegate _pDelegate, void* _pUserData ) {
+	int	EntryIndex = 0;
+	U32	Size = this->GetSize();
+	for ( U32 Slot=0; Slot < Size; Slot++ ) {
+		if ( this->IsOccupied( this->m_pControls[Slot] ) )
+			(*_pDelegate)( EntryIndex++, this->m_pEntries[Slot].Value, _pUserData );
 	}
-	// Clear heads
-	memset( m_ppTable, 0, m_Size*sizeof(Node*) );
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Generic version
+//
 template<typename K, typename T>
 void	DictionaryGeneric<K,T>::ForEach( VisitorDelegate _pDelegate, void* _pUserData ) {
 	int	EntryIndex = 0;
-	for ( int i=0; i < m_SizePOT; i++ ) {
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL ) {
-			if ( !(*_pDelegate)( EntryIndex++, pNode->key, pNode->value, _pUserData ) )
-				return;	// Stop!
-			pNode = pNode->pNext;
-		}
+	U32	Size = this->GetSize();
+	for ( U32 Slot=0; Slot < Size; Slot++ ) {
+		if ( !this->IsOccupied( this->m_pControls[Slot] ) )
+			continue;
+
+		typename HashTable<K, T>::Entry&	E = this->m_pEntries[Slot];
+		if ( !(*_pDelegate)( EntryIndex++, E.Key, E.Value, _pUserData ) )
+			return;	// Stop!
 	}
 }
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "../Types.h"
+#include "../Utility/TypeTraits.h"
+#include "../Utility/Allocator.h"
+#include "Sort.h"
+
+#include <new>	// Placement new
 
 namespace BaseLib {
 
@@ -12,35 +17,61 @@ template<typename T> class	IComparer {
 public:	virtual int		Compare( const T& a, const T& b ) const = 0;
 };
 
-// Simple list class
+// Wraps a comparer into a comparator usable by the sorting algorithms
+template<typename T> class	ComparerLess {
+	const IComparer<T>&	m_Comparer;
+public:
+	ComparerLess( const IComparer<T>& _Comparer ) : m_Comparer( _Comparer ) {}
+	bool	operator()( const T& a, const T& b ) const	{ return m_Comparer.Compare( a, b ) > 0; }
+};
+
+// Growable array
+//	. Storage is raw memory obtained from an IAllocator (the default heap allocator unless specified), elements are constructed in place when they're added
+//		and destroyed when they're removed so T can be any copyable or movable class.
+//	. Trivially copyable types are relocated with memcpy() and grown with IAllocator::Reallocate(), which can often extend the block in place.
+//	. New elements are value-initialized (i.e. zeroed for POD types) unless otherwise specified.
+//
 template<typename T>
 class	List {
 protected:	// FIELDS
 
-	T*		m_pList;	// List of allocated elements
-	U32		m_Size;		// Size of the allocated list
-	U32		m_Count;	// Amount of non empty elements
+	T*			m_pList;		// List of allocated elements
+	U32			m_Size;			// Size of the allocated list
+	U32			m_Count;		// Amount of constructed elements
+	IAllocator*	m_pAllocator;
 
 public:		// PROPERTIES
 
-	U32		Count() const				{ return m_Count; }
-	void	SetCount( U32 _Count );		// Sets the new count, possibility resizing the list
-	U32		GetAllocatedSize() const	{ return m_Size; }
+	U32			Count() const				{ return m_Count; }
+	void		SetCount( U32 _Count );		// Sets the new count, possibility resizing the list
+	U32			GetAllocatedSize() const	{ return m_Size; }
+	IAllocator&	GetAllocator() const		{ return *m_pAllocator; }
 
 
 public:		// METHODS
 
 	List();
 	List( U32 _InitialSize );
+	List( IAllocator& _Allocator, U32 _InitialSize=0 );
+	List( const List& _Other );
+	List( List&& _Other );
 	~List();
 
-	// Resizes the list, preserving the existing list if possible
+	List&		operator=( const List& _Other );
+	List&		operator=( List&& _Other );
+
+	// Resizes the allocated list, preserving the existing elements (elements beyond the new size are destroyed)
 	void		Resize( U32 _Size );
 
+	// Makes sure the list can store at least _Size elements without re-allocating
+	void		Reserve( U32 _Size );
+
 	T&			operator[]( U32 _Index );
 	const T&	operator[]( U32 _Index ) const;
 	T&			Insert( U32 _Index );
 	void		Append( const T& _Value );
+	void		Append( T&& _Value );
+	void		Append( const T* _pValues, U32 _Count );
 	void		AppendUnique( const T& _Value );
 	T&			Append();
 	T*			Ptr() { return m_pList; }
@@ -48,12 +79,32 @@ public:		// METHODS
 	U32			IndexOf( const T& _Value ) const;
 	void		RemoveAt( U32 _Index );
 	bool		Remove( const T& _Value );
-	void		Clear()	{ m_Count = 0; }
-
+	void		Clear();
+
+	// Constructs a new element in place from the provided arguments
+	// NOTE: Arguments must not reference elements of the list as they may be relocated before construction
+	T&			EmplaceBack();
+	template<typename A0>
+	T&			EmplaceBack( A0&& _Arg0 );
+	template<typename A0, typename A1>
+	T&			EmplaceBack( A0&& _Arg0, A1&& _Arg1 );
+	template<typename A0, typename A1, typename A2>
+	T&			EmplaceBack( A0&& _Arg0, A1&& _Arg1, A2&& _Arg2 );
+	template<typename A0, typename A1, typename A2, typename A3>
+	T&			EmplaceBack( A0&& _Arg0, A1&& _Arg1, A2&& _Arg2, A3&& _Arg3 );
+
+	// Sorts the list using a comparer (see Sort.h for faster alternatives)
 	void		Sort( const IComparer<T>& _Comparer );
 
+	// Sorts the list using an inlinable comparator (i.e. any class implementing "bool operator()( const T& a, const T& b ) const" that returns true if a < b)
+	template<typename LESS>
+	void		SortBy( const LESS& _Less )	{ IntroSort( m_pList, m_Count, _Less ); }
+
 private:
-	void		Allocate( U32 _NewCount );
+	T*			Grow( U32 _NewCount );		// Makes sure there's room for _NewCount elements, growing geometrically, and returns the address of the first free element
+	void		Reallocate( U32 _NewSize );
+	void		Destroy( U32 _StartIndex, U32 _EndIndex );
+	void		Release();
 };
 
 #include "List.inl"
@@ -1,8 +1,8 @@
-
 template<typename T> List<T>::List()
 	: m_pList( NULL )
 	, m_Size( 0 )
 	, m_Count( 0 )
+	, m_pAllocator( &GetDefaultAllocator() )
 {
 
 }
@@ -11,37 +11,103 @@ template<typename T> List<T>::List( U32 _InitialSize )
 	: m_pList( NULL )
 	, m_Size( 0 )
 	, m_Count( 0 )
+	, m_pAllocator( &GetDefaultAllocator() )
+{
+	Reserve( _InitialSize );
+}
+
+template<typename T> List<T>::List( IAllocator& _Allocator, U32 _InitialSize )
+	: m_pList( NULL )
+	, m_Size( 0 )
+	, m_Count( 0 )
+	, m_pAllocator( &_Allocator )
+{
+	Reserve( _InitialSize );
+}
+
+// Copies always use the default allocator as the source allocator may not outlive the copy
+template<typename T> List<T>::List( const List& _Other )
+	: m_pList( NULL )
+	, m_Size( 0 )
+	, m_Count( 0 )
+	, m_pAllocator( &GetDefaultAllocator() )
+{
+	Append( _Other.m_pList, _Other.m_Count );
+}
+
+template<typename T> List<T>::List( List&& _Other )
+	: m_pList( _Other.m_pList )
+	, m_Size( _Other.m_Size )
+	, m_Count( _Other.m_Count )
+	, m_pAllocator( _Other.m_pAllocator )
+{
+	_Other.m_pList = NULL;
+	_Other.m_Size = 0;
+	_Other.m_Count = 0;
+}
+
+template<typename T> List<T>::~List()
 {
-	Resize( _InitialSize );
+	Release();
+}
+
+template<typename T> List<T>&	List<T>::operator=( const List& _Other ) {
+	if ( &_Other != this ) {
+		Clear();
+		Append( _Other.m_pList, _Other.m_Count );
+	}
+	return *this;
+}
+
+template<typename T> List<T>&	List<T>::operator=( List&& _Other ) {
+	if ( &_Other == this )
+		return *this;
+
+	if ( _Other.m_pAllocator == m_pAllocator ) {
+		// Steal the other list's storage
+		Release();
+		m_pList = _Other.m_pList;
+		m_Size = _Other.m_Size;
+		m_Count = _Other.m_Count;
+		_Other.m_pList = NULL;
+		_Other.m_Size = 0;
+		_Other.m_Count = 0;
+	} else {
+		// Different allocators, move elements one by one
+		Clear();
+		Reserve( _Other.m_Count );
+		for ( U32 i=0; i < _Other.m_Count; i++ )
+			new (m_pList + i) T( Move( _Other.m_pList[i] ) );
+		m_Count = _Other.m_Count;
+		_Other.Clear();
+	}
+	return *this;
 }
 
 template<typename T> void	List<T>::Resize( U32 _Size ) {
-	if ( _Size > m_Size ) {
-		T*	old = m_pList;
-		m_pList = new T[_Size];
-		if ( old != nullptr ) {
-			// Copy former list and delete
-			memcpy_s( m_pList, _Size*sizeof(T), old, m_Size*sizeof(T) );
-			delete[] old;
-		}
+	if ( _Size < m_Count ) {
+		Destroy( _Size, m_Count );
+		m_Count = _Size;
 	}
+	Reallocate( _Size );
+}
 
-	m_Size = _Size;
-	m_Count = 0;
+template<typename T> void	List<T>::Reserve( U32 _Size ) {
+	if ( _Size > m_Size )
+		Reallocate( _Size );
 }
 
 template<typename T> void	List<T>::SetCount( U32 _Count ) {
-	if ( _Count > m_Size ) {
-		Resize( _Count );
+	if ( _Count > m_Count ) {
+		Reserve( _Count );
+		for ( U32 i=m_Count; i < _Count; i++ )
+			new (m_pList + i) T();
+	} else {
+		Destroy( _Count, m_Count );
 	}
 	m_Count = _Count;
 }
 
-template<typename T> List<T>::~List()
-{
-	delete[] m_pList;
-}
-
 template<typename T> T&			List<T>::operator[]( U32 _Index )
 {
 	ASSERT( _Index < m_Count, "Index out of range!" );
@@ -55,8 +121,46 @@ template<typename T> const T&	List<T>::operator[]( U32 _Index ) const
 }
 
 template<typename T> void		List<T>::Append( const T& _Value ) {
-	Allocate( m_Count+1 );
-	memcpy( &m_pList[m_Count-1], &_Value, sizeof(T) );
+	const T*	pValue = &_Value;
+	if ( m_Count == m_Size && pValue >= m_pList && pValue < m_pList + m_Count ) {
+		// Appending one of our own elements: it will be relocated with the list
+		U32	Index = U32( pValue - m_pList );
+		Grow( m_Count+1 );
+		pValue = m_pList + Index;
+	}
+	new (Grow( m_Count+1 )) T( *pValue );
+	m_Count++;
+}
+
+template<typename T> void		List<T>::Append( T&& _Value ) {
+	T*	pValue = &_Value;
+	if ( m_Count == m_Size && pValue >= m_pList && pValue < m_pList + m_Count ) {
+		U32	Index = U32( pValue - m_pList );
+		Grow( m_Count+1 );
+		pValue = m_pList + Index;
+	}
+	new (Grow( m_Count+1 )) T( Move( *pValue ) );
+	m_Count++;
+}
+
+template<typename T> void		List<T>::Append( const T* _pValues, U32 _Count ) {
+	if ( _Count == 0 )
+		return;
+
+	if ( m_Count + _Count > m_Size && _pValues >= m_pList && _pValues < m_pList + m_Count ) {
+		U32	Index = U32( _pValues - m_pList );
+		Grow( m_Count + _Count );
+		_pValues = m_pList + Index;
+	}
+
+	T*	pTarget = Grow( m_Count + _Count );
+	if ( IsTriviallyCopyable<T>::Value ) {
+		memcpy( pTarget, _pValues, _Count*sizeof(T) );
+	} else {
+		for ( U32 i=0; i < _Count; i++ )
+			new (pTarget + i) T( _pValues[i] );
+	}
+	m_Count += _Count;
 }
 
 template<typename T> void		List<T>::AppendUnique( const T& _Value ) {
@@ -69,18 +173,61 @@ template<typename T> void		List<T>::AppendUnique( const T& _Value ) {
 }
 
 template<typename T> T&			List<T>::Append() {
-	Allocate( m_Count+1 );
-	return m_pList[m_Count-1];
+	return EmplaceBack();
+}
+
+template<typename T> T&			List<T>::EmplaceBack() {
+	T*	pElement = new (Grow( m_Count+1 )) T();
+	m_Count++;
+	return *pElement;
+}
+
+template<typename T> template<typename A0>
+T&			List<T>::EmplaceBack( A0&& _Arg0 ) {
+	T*	pElement = new (Grow( m_Count+1 )) T( Forward<A0>( _Arg0 ) );
+	m_Count++;
+	return *pElement;
+}
+
+template<typename T> template<typename A0, typename A1>
+T&			List<T>::EmplaceBack( A0&& _Arg0, A1&& _Arg1 ) {
+	T*	pElement = new (Grow( m_Count+1 )) T( Forward<A0>( _Arg0 ), Forward<A1>( _Arg1 ) );
+	m_Count++;
+	return *pElement;
+}
+
+template<typename T> template<typename A0, typename A1, typename A2>
+T&			List<T>::EmplaceBack( A0&& _Arg0, A1&& _Arg1, A2&& _Arg2 ) {
+	T*	pElement = new (Grow( m_Count+1 )) T( Forward<A0>( _Arg0 ), Forward<A1>( _Arg1 ), Forward<A2>( _Arg2 ) );
+	m_Count++;
+	return *pElement;
+}
+
+template<typename T> template<typename A0, typename A1, typename A2, typename A3>
+T&			List<T>::EmplaceBack( A0&& _Arg0, A1&& _Arg1, A2&& _Arg2, A3&& _Arg3 ) {
+	T*	pElement = new (Grow( m_Count+1 )) T( Forward<A0>( _Arg0 ), Forward<A1>( _Arg1 ), Forward<A2>( _Arg2 ), Forward<A3>( _Arg3 ) );
+	m_Count++;
+	return *pElement;
 }
 
 template<typename T> T&			List<T>::Insert( U32 _Index ) {
 	if ( _Index == m_Count )
-		return Append( _Index );
+		return EmplaceBack();
 
 	ASSERT( _Index < m_Count, "Index out of range!" );
-	Allocate( m_Count+1 );
+	Grow( m_Count+1 );
+
+	if ( IsTriviallyCopyable<T>::Value ) {
+		memmove( &m_pList[_Index+1], &m_pList[_Index], (m_Count-_Index)*sizeof(T) );
+		new (m_pList + _Index) T();
+	} else {
+		new (m_pList + m_Count) T( Move( m_pList[m_Count-1] ) );
+		for ( U32 i=m_Count-1; i > _Index; i-- )
+			m_pList[i] = Move( m_pList[i-1] );
+		m_pList[_Index] = T();
+	}
+	m_Count++;
 
-	memcpy( &m_pList[_Index+1], &m_pList[_Index], (m_Count-1-_Index)*sizeof(T) );
 	return m_pList[_Index];
 }
 
@@ -95,7 +242,14 @@ template<typename T> U32		List<T>::IndexOf( const T& _Value ) const {
 
 template<typename T> void		List<T>::RemoveAt( U32 _Index ) {
 	ASSERT( _Index < m_Count, "Index out of range!" );
-	memcpy( &m_pList[_Index], &m_pList[_Index+1], (m_Count-_Index-1)*sizeof(T) );
+	if ( IsTriviallyCopyable<T>::Value ) {
+		memmove( &m_pList[_Index], &m_pList[_Index+1], (m_Count-_Index-1)*sizeof(T) );
+	} else {
+		for ( U32 i=_Index+1; i < m_Count; i++ )
+			m_pList[i-1] = Move( m_pList[i] );
+		Destroy( m_Count-1, m_Count );
+	}
+	m_Count--;
 }
 
 template<typename T> bool		List<T>::Remove( const T& _Value ) {
@@ -107,46 +261,63 @@ template<typename T> bool		List<T>::Remove( const T& _Value ) {
 	return true;
 }
 
-template<typename T> void		List<T>::Allocate( U32 _NewCount ) {
-	if ( _NewCount <= m_Size )
-	{	// No need to re-allocate...
-		m_Count = _NewCount;
-		return;
-	}
+template<typename T> void		List<T>::Clear() {
+	Destroy( 0, m_Count );
+	m_Count = 0;
+}
 
-	T*	pOldList = m_pList;
-	int	OldSize = m_Size;
+template<typename T> T*			List<T>::Grow( U32 _NewCount ) {
+	if ( _NewCount > m_Size ) {
+		U32	NewSize = m_Size != 0 ? 2 * m_Size : 8;	// Arbitrary...
+		Reallocate( MAX( NewSize, _NewCount ) );
+	}
+	return m_pList + m_Count;
+}
 
-	if ( m_Size != 0 )
-		m_Size *= 2;
-	else
-		m_Size = 8;	// Arbitrary...
+template<typename T> void		List<T>::Reallocate( U32 _NewSize ) {
+	ASSERT( _NewSize >= m_Count, "Elements must be destroyed before shrinking the list!" );
+	if ( _NewSize == m_Size )
+		return;
 
-	m_pList = new T[m_Size];
-	memset( m_pList, 0, m_Size*sizeof(T) );
-	if ( pOldList != NULL )
-		memcpy( m_pList, pOldList, OldSize*sizeof(T) );
-	m_Count = _NewCount;
+	if ( _NewSize == 0 ) {
+		m_pAllocator->Free( m_pList, m_Size*sizeof(T), __alignof(T) );
+		m_pList = NULL;
+		m_Size = 0;
+		return;
+	}
 
-	delete[] pOldList;
+	if ( IsTriviallyCopyable<T>::Value ) {
+		// Fast path: let the allocator grow the block in place if it can
+		m_pList = (T*) m_pAllocator->Reallocate( m_pList, m_Size*sizeof(T), _NewSize*sizeof(T), __alignof(T) );
+	} else {
+		// Move existing elements to the new block
+		T*	pNewList = (T*) m_pAllocator->Allocate( _NewSize*sizeof(T), __alignof(T) );
+		for ( U32 i=0; i < m_Count; i++ ) {
+			new (pNewList + i) T( Move( m_pList[i] ) );
+			m_pList[i].~T();
+		}
+		m_pAllocator->Free( m_pList, m_Size*sizeof(T), __alignof(T) );
+		m_pList = pNewList;
+	}
+	RELEASE_ASSERT( m_pList != NULL, "Failed to allocate list!" );
+	m_Size = _NewSize;
 }
 
-// Poor man's version: bubble sort!
-template<typename T> void	List<T>::Sort( const IComparer<T>& _Comparer ) {
-	if ( m_Size == 0 )
+template<typename T> void		List<T>::Destroy( U32 _StartIndex, U32 _EndIndex ) {
+	if ( IsTriviallyDestructible<T>::Value )
 		return;
+	for ( U32 i=_StartIndex; i < _EndIndex; i++ )
+		m_pList[i].~T();
+}
 
-	T	temp;
-	for ( U32 i=0; i < m_Size-1; i++ ) {
-		T&	a = m_pList[i];
-		for ( U32 j=i; j < m_Size; j++ ) {
-			T&	b = m_pList[j];
-			if ( _Comparer.Compare( a, b ) < 0 ) {
-				// Swap since a > b and should be placed afterward...
-				memcpy_s( &temp, sizeof(T), &a, sizeof(T) );
-				memcpy_s( &a, sizeof(T), &b, sizeof(T) );
-				memcpy_s( &b, sizeof(T), &temp, sizeof(T) );
-			}
-		}
-	}
+template<typename T> void		List<T>::Release() {
+	Destroy( 0, m_Count );
+	m_pAllocator->Free( m_pList, m_Size*sizeof(T), __alignof(T) );
+	m_pList = NULL;
+	m_Size = 0;
+	m_Count = 0;
+}
+
+template<typename T> void	List<T>::Sort( const IComparer<T>& _Comparer ) {
+	IntroSort( m_pList, m_Count, ComparerLess<T>( _Comparer ) );
 }
@@ -0,0 +1,174 @@
+//////////////////////////////////////////////////////////////////////////
+// Parallel merge sort
+//
+// Sorts large arrays on all the hardware threads:
+//	1] The array is split into chunks that are sorted independently with IntroSort()
+//	2] Sorted runs are merged pairwise, ping-ponging between the array and a temporary buffer, until a single run remains.
+//		Each merge is itself split into independent pieces of equal output size (the split points in both input runs are found
+//		by binary search) so all the threads are kept busy even during the last merges.
+//
+// The sort is stable as long as the chunk sort is, which is not the case for IntroSort(): don't rely on the order of equal elements!
+//
+// Like List, elements are relocated bitwise (merges and copy back use memcpy) so T must be trivially relocatable.
+// This is what allows the temporary buffer to be raw unconstructed storage.
+//
+#pragma once
+
+#include "Sort.h"
+#include "../Utility/Parallel.h"
+
+namespace BaseLib {
+
+static const U32	PARALLEL_SORT_MIN_COUNT = 1 << 16;		// Arrays smaller than this are sorted on the calling thread
+static const U32	PARALLEL_SORT_MIN_CHUNK_SIZE = 1 << 13;
+
+namespace SortInternal {
+
+	template<typename T, typename LESS> struct	ChunkSortJob {
+		T*			pArray;
+		U32			Count;
+		U32			ChunkSize;
+		const LESS*	pLess;
+
+		void	operator()( U32 _ChunkIndex ) {
+			U32	Start = _ChunkIndex * ChunkSize;
+			U32	End = MIN( Start + ChunkSize, Count );
+			IntroSort( pArray + Start, End - Start, *pLess );
+		}
+	};
+
+	// Returns the amount of elements of A among the first _OutputIndex elements of the stable merge of A and B
+	template<typename T, typename LESS> U32	MergeSplit( U32 _OutputIndex, const T* _pA, U32 _CountA, const T* _pB, U32 _CountB, const LESS& _Less ) {
+		U32	Min = _OutputIndex > _CountB ? _OutputIndex - _CountB : 0;
+		U32	Max = MIN( _OutputIndex, _CountA );
+		while ( Min < Max ) {
+			U32	IndexA = (Min + Max) >> 1;
+			U32	IndexB = _OutputIndex - IndexA;
+			if ( _Less( _pB[IndexB-1], _pA[IndexA] ) )
+				Max = IndexA;
+			else
+				Min = IndexA + 1;
+		}
+		return Min;
+	}
+
+	template<typename T, typename LESS> struct	MergeJob {
+		const T*	pSource;
+		T*			pTarget;
+		U32			Count;
+		U32			RunSize;			// Size of the runs to merge
+		U32			PiecesPerMerge;
+		const LESS*	pLess;
+
+		void	operator()( U32 _JobIndex ) {
+			U32			MergeIndex = _JobIndex / PiecesPerMerge;
+			U32			PieceIndex = _JobIndex % PiecesPerMerge;
+
+			U32			Start = MergeIndex * 2 * RunSize;
+			U32			CountA = MIN( RunSize, Count - Start );
+			U32			CountB = MIN( RunSize, Count - Start - CountA );
+			const T*	pA = pSource + Start;
+			const T*	pB = pA + CountA;
+
+			U32			TotalCount = CountA + CountB;
+			U32			OutputStart = U32( (U64(PieceIndex) * TotalCount) / PiecesPerMerge );
+			U32			OutputEnd = U32( (U64(PieceIndex+1) * TotalCount) / PiecesPerMerge );
+
+			U32			IndexA = MergeSplit( OutputStart, pA, CountA, pB, CountB, *pLess );
+			U32			IndexB = OutputStart - IndexA;
+			U32			EndA = MergeSplit( OutputEnd, pA, CountA, pB, CountB, *pLess );
+			U32			EndB = OutputEnd - EndA;
+
+			T*			pOutput = pTarget + Start + OutputStart;
+			while ( IndexA < EndA && IndexB < EndB ) {
+				if ( (*pLess)( pB[IndexB], pA[IndexA] ) )
+					memcpy( pOutput++, &pB[IndexB++], sizeof(T) );
+				else
+					memcpy( pOutput++, &pA[IndexA++], sizeof(T) );
+			}
+			if ( IndexA < EndA ) {
+				memcpy( pOutput, &pA[IndexA], (EndA - IndexA) * sizeof(T) );
+				pOutput += EndA - IndexA;
+			}
+			if ( IndexB < EndB )
+				memcpy( pOutput, &pB[IndexB], (EndB - IndexB) * sizeof(T) );
+		}
+	};
+
+	template<typename T> struct	CopyJob {
+		const T*	pSource;
+		T*			pTarget;
+		U32			Count;
+		U32			ChunkSize;
+
+		void	operator()( U32 _ChunkIndex ) {
+			U32	Start = _ChunkIndex * ChunkSize;
+			U32	End = MIN( Start + ChunkSize, Count );
+			if ( Start < End )
+				memcpy( pTarget + Start, pSource + Start, (End - Start) * sizeof(T) );
+		}
+	};
+}
+
+// Sorts the array in place
+//	_pTemp, an optional temporary buffer of _Count elements, used as raw storage (allocated internally through the default allocator if NULL)
+template<typename T, typename LESS> void	ParallelMergeSort( T* _pArray, U32 _Count, const LESS& _Less, T* _pTemp=NULL ) {
+	U32	ThreadsCount = GetHardwareThreadsCount();
+	if ( _Count < PARALLEL_SORT_MIN_COUNT || ThreadsCount < 2 ) {
+		IntroSort( _pArray, _Count, _Less );
+		return;
+	}
+
+	IAllocator&	Allocator = GetDefaultAllocator();
+	T*	pTemp = _pTemp != NULL ? _pTemp : (T*) Allocator.Allocate( _Count * sizeof(T), __alignof(T) );
+
+	// 1] Sort chunks (use a power of 2 amount of chunks so merges stay balanced)
+	U32	ChunksCount = 1;
+	while ( ChunksCount < 2*ThreadsCount && _Count / (2*ChunksCount) >= PARALLEL_SORT_MIN_CHUNK_SIZE )
+		ChunksCount *= 2;
+	U32	ChunkSize = (_Count + ChunksCount - 1) / ChunksCount;
+
+	SortInternal::ChunkSortJob<T,LESS>	SortJob;
+	SortJob.pArray = _pArray;
+	SortJob.Count = _Count;
+	SortJob.ChunkSize = ChunkSize;
+	SortJob.pLess = &_Less;
+	ParallelFor( ChunksCount, SortJob );
+
+	// 2] Merge runs
+	T*	pSource = _pArray;
+	T*	pTarget = pTemp;
+	for ( U32 RunSize=ChunkSize; RunSize < _Count; RunSize *= 2 ) {
+		U32	MergesCount = (_Count + 2*RunSize - 1) / (2*RunSize);
+
+		SortInternal::MergeJob<T,LESS>	MergeJob;
+		MergeJob.pSource = pSource;
+		MergeJob.pTarget = pTarget;
+		MergeJob.Count = _Count;
+		MergeJob.RunSize = RunSize;
+		MergeJob.PiecesPerMerge = MAX( 1U, (2*ThreadsCount + MergesCount - 1) / MergesCount );
+		MergeJob.pLess = &_Less;
+		ParallelFor( MergesCount * MergeJob.PiecesPerMerge, MergeJob );
+
+		T*	pSwap = pSource;
+		pSource = pTarget;
+		pTarget = pSwap;
+	}
+
+	// 3] Copy back to the array if the last merge ended up in the temporary buffer
+	if ( pSource != _pArray ) {
+		SortInternal::CopyJob<T>	CopyJob;
+		CopyJob.pSource = pSource;
+		CopyJob.pTarget = _pArray;
+		CopyJob.Count = _Count;
+		CopyJob.ChunkSize = ChunkSize;
+		ParallelFor( ChunksCount, CopyJob );
+	}
+
+	if ( pTemp != _pTemp )
+		Allocator.Free( pTemp, _Count * sizeof(T), __alignof(T) );
+}
+
+template<typename T> void	ParallelMergeSort( T* _pArray, U32 _Count )	{ ParallelMergeSort( _pArray, _Count, Less<T>() ); }
+
+}	// namespace BaseLib
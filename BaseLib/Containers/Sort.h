@@ -0,0 +1,48 @@
+//////////////////////////////////////////////////////////////////////////
+// Sorting algorithms
+//
+// . IntroSort() is a pattern-defeating introsort (quick sort + insertion sort for small ranges + heap sort fallback)
+//		taking any comparator functor so the comparisons get inlined.
+//		It's not stable, runs in O(N.log(N)) worst case and in O(N) on already sorted, reversed or equal ranges.
+//
+// . RadixSort32() / RadixSort64() are stable LSD radix sorts with 8-bit digits on integer keys extracted from the elements.
+//		Use SortKey() to convert signed integers or floats into keys that sort the same way as the original values.
+//		Digits shared by all the keys are detected during histogramming and their pass is skipped entirely.
+//
+// A comparator is any class implementing:
+//	bool	operator()( const T& a, const T& b ) const;	// Returns true if a must be placed before b
+//
+// A key provider is any class implementing:
+//	U32	operator()( const T& _Element ) const;	// (or U64 for RadixSort64)
+//
+#pragma once
+
+#include "../Types.h"
+
+namespace BaseLib {
+
+// Default comparator using operator<
+template<typename T> struct	Less {
+	bool	operator()( const T& a, const T& b ) const	{ return a < b; }
+};
+
+// Sorts the array in place
+template<typename T, typename LESS> void	IntroSort( T* _pArray, U32 _Count, const LESS& _Less );
+template<typename T> void					IntroSort( T* _pArray, U32 _Count )	{ IntroSort( _pArray, _Count, Less<T>() ); }
+
+// Sorts the array using the provided temporary array of the same size
+// Returns the pointer to the sorted array, which is either _pArray or _pTemp depending on the amount of passes that were required
+template<typename T, typename KEY_PROVIDER> T*	RadixSort32( T* _pArray, U32 _Count, const KEY_PROVIDER& _GetKey, T* _pTemp );
+template<typename T, typename KEY_PROVIDER> T*	RadixSort64( T* _pArray, U32 _Count, const KEY_PROVIDER& _GetKey, T* _pTemp );
+
+// Converts values into radix-sortable keys
+inline U32	SortKey( U32 _Value )	{ return _Value; }
+inline U32	SortKey( S32 _Value )	{ return U32(_Value) ^ 0x80000000U; }
+inline U32	SortKey( float _Value )	{ U32 Bits = *((U32*) &_Value); return Bits ^ ((Bits & 0x80000000U) ? 0xFFFFFFFFU : 0x80000000U); }
+inline U64	SortKey( U64 _Value )	{ return _Value; }
+inline U64	SortKey( S64 _Value )	{ return U64(_Value) ^ 0x8000000000000000ULL; }
+inline U64	SortKey( double _Value ){ U64 Bits = *((U64*) &_Value); return Bits ^ ((Bits & 0x8000000000000000ULL) ? 0xFFFFFFFFFFFFFFFFULL : 0x8000000000000000ULL); }
+
+#include "Sort.inl"
+
+}	// namespace BaseLib
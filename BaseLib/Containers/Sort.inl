@@ -0,0 +1,314 @@
+namespace SortInternal {
+
+	static const U32	INSERTION_SORT_THRESHOLD = 24;		// Ranges smaller than this are insertion sorted
+	static const U32	NINTHER_THRESHOLD = 128;			// Ranges larger than this use a pseudo-median of 9 as pivot
+	static const U32	PARTIAL_INSERTION_SORT_LIMIT = 8;	// Maximum amount of element moves before giving up a partial insertion sort
+
+	template<typename T> inline void	SwapElements( T& a, T& b ) {
+		T	Temp = a;
+		a = b;
+		b = Temp;
+	}
+
+	template<typename T, typename LESS> inline void	Sort2( T* a, T* b, const LESS& _Less ) {
+		if ( _Less( *b, *a ) )
+			SwapElements( *a, *b );
+	}
+
+	template<typename T, typename LESS> inline void	Sort3( T* a, T* b, T* c, const LESS& _Less ) {
+		Sort2( a, b, _Less );
+		Sort2( b, c, _Less );
+		Sort2( a, b, _Less );
+	}
+
+	template<typename T, typename LESS> void	InsertionSort( T* _pBegin, T* _pEnd, const LESS& _Less ) {
+		if ( _pBegin == _pEnd )
+			return;
+
+		for ( T* pCurrent=_pBegin+1; pCurrent != _pEnd; pCurrent++ ) {
+			T*	pSift = pCurrent;
+			T*	pSift1 = pCurrent - 1;
+			if ( _Less( *pSift, *pSift1 ) ) {
+				T	Temp = *pSift;
+				do {
+					*pSift-- = *pSift1;
+				} while ( pSift != _pBegin && _Less( Temp, *--pSift1 ) );
+				*pSift = Temp;
+			}
+		}
+	}
+
+	// Assumes *(_pBegin-1) is <= to any element of the range, which acts as a sentinel
+	template<typename T, typename LESS> void	UnguardedInsertionSort( T* _pBegin, T* _pEnd, const LESS& _Less ) {
+		if ( _pBegin == _pEnd )
+			return;
+
+		for ( T* pCurrent=_pBegin+1; pCurrent != _pEnd; pCurrent++ ) {
+			T*	pSift = pCurrent;
+			T*	pSift1 = pCurrent - 1;
+			if ( _Less( *pSift, *pSift1 ) ) {
+				T	Temp = *pSift;
+				do {
+					*pSift-- = *pSift1;
+				} while ( _Less( Temp, *--pSift1 ) );
+				*pSift = Temp;
+			}
+		}
+	}
+
+	// Attempts an insertion sort and gives up if too many elements need to be moved
+	// Returns true if the range was successfully sorted
+	template<typename T, typename LESS> bool	PartialInsertionSort( T* _pBegin, T* _pEnd, const LESS& _Less ) {
+		if ( _pBegin == _pEnd )
+			return true;
+
+		U32	MovesCount = 0;
+		for ( T* pCurrent=_pBegin+1; pCurrent != _pEnd; pCurrent++ ) {
+			if ( MovesCount > PARTIAL_INSERTION_SORT_LIMIT )
+				return false;
+
+			T*	pSift = pCurrent;
+			T*	pSift1 = pCurrent - 1;
+			if ( _Less( *pSift, *pSift1 ) ) {
+				T	Temp = *pSift;
+				do {
+					*pSift-- = *pSift1;
+				} while ( pSift != _pBegin && _Less( Temp, *--pSift1 ) );
+				*pSift = Temp;
+				MovesCount += U32(pCurrent - pSift);
+			}
+		}
+
+		return true;
+	}
+
+	template<typename T, typename LESS> void	HeapSiftDown( T* _pArray, U32 _Index, U32 _Count, const LESS& _Less ) {
+		T	Temp = _pArray[_Index];
+		while ( true ) {
+			U32	ChildIndex = 2*_Index + 1;
+			if ( ChildIndex >= _Count )
+				break;
+			if ( ChildIndex+1 < _Count && _Less( _pArray[ChildIndex], _pArray[ChildIndex+1] ) )
+				ChildIndex++;
+			if ( !_Less( Temp, _pArray[ChildIndex] ) )
+				break;
+			_pArray[_Index] = _pArray[ChildIndex];
+			_Index = ChildIndex;
+		}
+		_pArray[_Index] = Temp;
+	}
+
+	template<typename T, typename LESS> void	HeapSort( T* _pBegin, T* _pEnd, const LESS& _Less ) {
+		U32	Count = U32(_pEnd - _pBegin);
+		for ( U32 Index=Count/2; Index > 0; Index-- )
+			HeapSiftDown( _pBegin, Index-1, Count, _Less );
+		for ( U32 Index=Count-1; Index > 0; Index-- ) {
+			SwapElements( _pBegin[0], _pBegin[Index] );
+			HeapSiftDown( _pBegin, 0, Index, _Less );
+		}
+	}
+
+	// Partitions [_pBegin,_pEnd) around the pivot *_pBegin, elements equal to the pivot go to the right
+	// Returns the final position of the pivot and whether the range was already partitioned
+	template<typename T, typename LESS> T*	PartitionRight( T* _pBegin, T* _pEnd, const LESS& _Less, bool& _AlreadyPartitioned ) {
+		T	Pivot = *_pBegin;
+		T*	pFirst = _pBegin;
+		T*	pLast = _pEnd;
+
+		// Find the first element >= pivot (there's always one since the pivot is a median of 3)
+		while ( _Less( *++pFirst, Pivot ) );
+
+		// Find the last element < pivot
+		if ( pFirst - 1 == _pBegin ) {
+			while ( pFirst < pLast && !_Less( *--pLast, Pivot ) );
+		} else {
+			while ( !_Less( *--pLast, Pivot ) );
+		}
+
+		_AlreadyPartitioned = pFirst >= pLast;
+
+		// Swap misplaced pairs
+		while ( pFirst < pLast ) {
+			SwapElements( *pFirst, *pLast );
+			while ( _Less( *++pFirst, Pivot ) );
+			while ( !_Less( *--pLast, Pivot ) );
+		}
+
+		T*	pPivot = pFirst - 1;
+		*_pBegin = *pPivot;
+		*pPivot = Pivot;
+		return pPivot;
+	}
+
+	// Partitions [_pBegin,_pEnd) around the pivot *_pBegin, elements equal to the pivot go to the left
+	// Used when the pivot is equal to the element preceding the range, in which case all the elements equal to the pivot are already in place
+	template<typename T, typename LESS> T*	PartitionLeft( T* _pBegin, T* _pEnd, const LESS& _Less ) {
+		T	Pivot = *_pBegin;
+		T*	pFirst = _pBegin;
+		T*	pLast = _pEnd;
+
+		while ( _Less( Pivot, *--pLast ) );
+
+		if ( pLast + 1 == _pEnd ) {
+			while ( pFirst < pLast && !_Less( Pivot, *++pFirst ) );
+		} else {
+			while ( !_Less( Pivot, *++pFirst ) );
+		}
+
+		while ( pFirst < pLast ) {
+			SwapElements( *pFirst, *pLast );
+			while ( _Less( Pivot, *--pLast ) );
+			while ( !_Less( Pivot, *++pFirst ) );
+		}
+
+		T*	pPivot = pLast;
+		*_pBegin = *pPivot;
+		*pPivot = Pivot;
+		return pPivot;
+	}
+
+	template<typename T, typename LESS> void	IntroSortLoop( T* _pBegin, T* _pEnd, const LESS& _Less, U32 _BadPartitionsAllowed, bool _LeftMost ) {
+		while ( true ) {
+			U32	Size = U32(_pEnd - _pBegin);
+			if ( Size < INSERTION_SORT_THRESHOLD ) {
+				if ( _LeftMost )
+					InsertionSort( _pBegin, _pEnd, _Less );
+				else
+					UnguardedInsertionSort( _pBegin, _pEnd, _Less );
+				return;
+			}
+
+			// Choose the pivot as the median of 3 (or the pseudo-median of 9 for large ranges) and move it to the beginning of the range
+			U32	HalfSize = Size / 2;
+			if ( Size > NINTHER_THRESHOLD ) {
+				Sort3( _pBegin, _pBegin + HalfSize, _pEnd - 1, _Less );
+				Sort3( _pBegin + 1, _pBegin + (HalfSize - 1), _pEnd - 2, _Less );
+				Sort3( _pBegin + 2, _pBegin + (HalfSize + 1), _pEnd - 3, _Less );
+				Sort3( _pBegin + (HalfSize - 1), _pBegin + HalfSize, _pBegin + (HalfSize + 1), _Less );
+				SwapElements( *_pBegin, *(_pBegin + HalfSize) );
+			} else {
+				Sort3( _pBegin + HalfSize, _pBegin, _pEnd - 1, _Less );
+			}
+
+			// If the pivot equals the element preceding the range then there can't be any smaller element in the range:
+			//	put all the elements equal to the pivot on the left and only keep on sorting the right part
+			if ( !_LeftMost && !_Less( *(_pBegin - 1), *_pBegin ) ) {
+				_pBegin = PartitionLeft( _pBegin, _pEnd, _Less ) + 1;
+				continue;
+			}
+
+			bool	AlreadyPartitioned;
+			T*		pPivot = PartitionRight( _pBegin, _pEnd, _Less, AlreadyPartitioned );
+
+			U32		LeftSize = U32(pPivot - _pBegin);
+			U32		RightSize = U32(_pEnd - (pPivot + 1));
+			bool	HighlyUnbalanced = LeftSize < Size / 8 || RightSize < Size / 8;
+			if ( HighlyUnbalanced ) {
+				// Too many bad partitions: fall back to heap sort to guarantee O(N.log(N))
+				if ( --_BadPartitionsAllowed == 0 ) {
+					HeapSort( _pBegin, _pEnd, _Less );
+					return;
+				}
+
+				// Shuffle a few elements around to break the patterns that caused the bad partition
+				if ( LeftSize >= INSERTION_SORT_THRESHOLD ) {
+					SwapElements( _pBegin[0], _pBegin[LeftSize/4] );
+					SwapElements( pPivot[-1], pPivot[-S32(LeftSize/4)] );
+					if ( LeftSize > NINTHER_THRESHOLD ) {
+						SwapElements( _pBegin[1], _pBegin[LeftSize/4 + 1] );
+						SwapElements( _pBegin[2], _pBegin[LeftSize/4 + 2] );
+						SwapElements( pPivot[-2], pPivot[-S32(LeftSize/4 + 1)] );
+						SwapElements( pPivot[-3], pPivot[-S32(LeftSize/4 + 2)] );
+					}
+				}
+				if ( RightSize >= INSERTION_SORT_THRESHOLD ) {
+					SwapElements( pPivot[1], pPivot[1 + RightSize/4] );
+					SwapElements( _pEnd[-1], _pEnd[-S32(RightSize/4)] );
+					if ( RightSize > NINTHER_THRESHOLD ) {
+						SwapElements( pPivot[2], pPivot[2 + RightSize/4] );
+						SwapElements( pPivot[3], pPivot[3 + RightSize/4] );
+						SwapElements( _pEnd[-2], _pEnd[-S32(1 + RightSize/4)] );
+						SwapElements( _pEnd[-3], _pEnd[-S32(2 + RightSize/4)] );
+					}
+				}
+			} else {
+				// Well balanced and no swap was needed: the range is probably already sorted so attempt a cheap insertion sort
+				if (	AlreadyPartitioned
+					&&	PartialInsertionSort( _pBegin, pPivot, _Less )
+					&&	PartialInsertionSort( pPivot + 1, _pEnd, _Less ) )
+					return;
+			}
+
+			// Recurse into the left part and loop on the right part
+			IntroSortLoop( _pBegin, pPivot, _Less, _BadPartitionsAllowed, _LeftMost );
+			_pBegin = pPivot + 1;
+			_LeftMost = false;
+		}
+	}
+
+	template<typename T, typename KEY, typename KEY_PROVIDER> T*	RadixSort( T* _pArray, U32 _Count, const KEY_PROVIDER& _GetKey, T* _pTemp ) {
+		static const U32	DIGITS_COUNT = sizeof(KEY);
+
+		if ( _Count < 2 )
+			return _pArray;
+
+		// Build the histograms of all the digits at once
+		U32	pHistograms[DIGITS_COUNT][256];
+		memset( pHistograms, 0, sizeof(pHistograms) );
+		for ( U32 Index=0; Index < _Count; Index++ ) {
+			KEY	Key = _GetKey( _pArray[Index] );
+			for ( U32 DigitIndex=0; DigitIndex < DIGITS_COUNT; DigitIndex++ )
+				pHistograms[DigitIndex][(Key >> (8*DigitIndex)) & 0xFF]++;
+		}
+
+		// Scatter digit by digit, from least to most significant
+		T*	pSource = _pArray;
+		T*	pTarget = _pTemp;
+		for ( U32 DigitIndex=0; DigitIndex < DIGITS_COUNT; DigitIndex++ ) {
+			U32*	pHistogram = pHistograms[DigitIndex];
+
+			// Skip the pass if all the keys share the same digit
+			U32		FirstDigit = U32( (_GetKey( pSource[0] ) >> (8*DigitIndex)) & 0xFF );
+			if ( pHistogram[FirstDigit] == _Count )
+				continue;
+
+			// Convert counts into offsets
+			U32	Offset = 0;
+			for ( U32 Digit=0; Digit < 256; Digit++ ) {
+				U32	DigitCount = pHistogram[Digit];
+				pHistogram[Digit] = Offset;
+				Offset += DigitCount;
+			}
+
+			for ( U32 Index=0; Index < _Count; Index++ ) {
+				U32	Digit = U32( (_GetKey( pSource[Index] ) >> (8*DigitIndex)) & 0xFF );
+				pTarget[pHistogram[Digit]++] = pSource[Index];
+			}
+
+			T*	pSwap = pSource;
+			pSource = pTarget;
+			pTarget = pSwap;
+		}
+
+		return pSource;
+	}
+}
+
+template<typename T, typename LESS> void	IntroSort( T* _pArray, U32 _Count, const LESS& _Less ) {
+	if ( _Count < 2 )
+		return;
+
+	U32	Log2 = 0;
+	for ( U32 Size=_Count; Size > 1; Size >>= 1 )
+		Log2++;
+
+	SortInternal::IntroSortLoop( _pArray, _pArray + _Count, _Less, Log2, true );
+}
+
+template<typename T, typename KEY_PROVIDER> T*	RadixSort32( T* _pArray, U32 _Count, const KEY_PROVIDER& _GetKey, T* _pTemp ) {
+	return SortInternal::RadixSort<T,U32,KEY_PROVIDER>( _pArray, _Count, _GetKey, _pTemp );
+}
+
+template<typename T, typename KEY_PROVIDER> T*	RadixSort64( T* _pArray, U32 _Count, const KEY_PROVIDER& _GetKey, T* _pTemp ) {
+	return SortInternal::RadixSort<T,U64,KEY_PROVIDER>( _pArray, _Count, _GetKey, _pTemp );
+}
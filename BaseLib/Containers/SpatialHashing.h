@@ -94,14 +94,14 @@ public:
 	// Spatial hashing from http://www.beosil.com/download/CollisionDetectionHashing_VMV03.pdf, section 4.1
 	//
 	static U32	Hash( int X, int Y, int Z ) {
-		const uint64	p1 = 73856093;
-		const uint64	p2 = 19349663;
-		const uint64	p3 = 83492791;
-
-		uint64	HashX = (uint64) X * p1;
-		uint64	HashY = (uint64) Y * p2;
-		uint64	HashZ = (uint64) Z * p3;
-		uint64	Hash = HashX ^ HashY ^ HashZ ;
+		const U64	p1 = 73856093;
+		const U64	p2 = 19349663;
+		const U64	p3 = 83492791;
+
+		U64	HashX = (U64) X * p1;
+		U64	HashY = (U64) Y * p2;
+		U64	HashZ = (U64) Z * p3;
+		U64	Hash = HashX ^ HashY ^ HashZ ;
 		return U32( Hash );
 	}
 	U32	ComputeHash( int X, int Y, int Z ) const {
@@ -364,7 +364,7 @@ _type_* SpatialHashing< _type_ >::Find( const bfloat3& _position, float _epsilon
 
 	keyValue_t*	current = m_table[hash];
 	while ( current != nullptr ) {
-		if ( current->position.Compare( _position, _epsilon ) ) {
+		if ( current->position.Almost( _position, _epsilon ) ) {
 			return &current->value;	// Found it!
 		}
 		current = current->next;
@@ -379,7 +379,7 @@ void	SpatialHashing< _type_ >::FindAll( const bfloat3& _position, List< _type_*
 
 	keyValue_t*	current = m_table[hash];
 	while ( current != nullptr ) {
-		if ( current->position.Compare( _position, _epsilon ) ) {
+		if ( current->position.Almost( _position, _epsilon ) ) {
 			_result.Append( &current->value );	// Another match!
 		}
 		current = current->next;
@@ -390,10 +390,10 @@ template < typename _type_ >
 void	SpatialHashing< _type_ >::FindAllIncludeNeighborCells( const bfloat3& _position, List< _type_* >& _result, float _epsilon ) const {
 
 	int	minCellX, minCellY, minCellZ;
-	GetCellIndices( _position - _epsilon*bfloat3::one, minCellX, minCellY, minCellZ );
+	GetCellIndices( _position - _epsilon*bfloat3::One, minCellX, minCellY, minCellZ );
 
 	int	maxCellX, maxCellY, maxCellZ;
-	GetCellIndices( _position + _epsilon*bfloat3::one, maxCellX, maxCellY, maxCellZ );
+	GetCellIndices( _position + _epsilon*bfloat3::One, maxCellX, maxCellY, maxCellZ );
 
 	for ( int Z=minCellZ; Z <= maxCellZ; Z++ ) {
 		for ( int Y=minCellY; Y <= maxCellY; Y++ ) {
@@ -401,7 +401,7 @@ void	SpatialHashing< _type_ >::FindAllIncludeNeighborCells( const bfloat3& _posi
 				U32		hash = ComputeHash( X, Y, Z );
 				keyValue_t*	current = m_table[hash];
 				while ( current != nullptr ) {
-					if ( current->position.Compare( _position, _epsilon ) ) {
+					if ( current->position.Almost( _position, _epsilon ) ) {
 						_result.Append( &current->value );	// Another match!
 					}
 					current = current->next;
@@ -413,9 +413,9 @@ void	SpatialHashing< _type_ >::FindAllIncludeNeighborCells( const bfloat3& _posi
 
 template < typename _type_ >
 void	SpatialHashing< _type_ >::GetCellIndices( const bfloat3& _position, int& _cellX, int& _cellY, int& _cellZ ) const {
-	_cellX = int( idMath::Floor( _position.x * m_invCellSize.x ) );
-	_cellY = int( idMath::Floor( _position.y * m_invCellSize.y ) );
-	_cellZ = int( idMath::Floor( _position.z * m_invCellSize.z ) );
+	_cellX = int( floorf( _position.x * m_invCellSize.x ) );
+	_cellY = int( floorf( _position.y * m_invCellSize.y ) );
+	_cellZ = int( floorf( _position.z * m_invCellSize.z ) );
 }
 
 template < typename _type_ >
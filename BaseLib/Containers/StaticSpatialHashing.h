@@ -0,0 +1,455 @@
+// ================================================================================================
+// StaticSpatialHashing.h
+//
+// 	Read-only counterpart of SpatialHashing, built in bulk from arrays of positions and values.
+//
+// 	Instead of a linked list per table entry, entries are sorted by cell hash (in parallel) into a compact CSR layout:
+// 		. Positions and values are stored contiguously, grouped by table entry
+// 		. Table entry N spans the entries [m_cellStarts[N], m_cellStarts[N+1])
+// 	A query thus never chases pointers and neighbor entries are most likely in the same cache lines.
+//
+// 	The table can't be modified once built: rebuild it from scratch if positions change.
+// 	Queries are const and can safely be issued from several threads at once (e.g. from a ParallelFor()).
+// ================================================================================================
+//
+#pragma once
+
+#include "../Types.h"
+#include "ParallelSort.h"
+
+namespace BaseLib {
+
+template < typename _type_ >
+class StaticSpatialHashing {
+public:
+
+	StaticSpatialHashing();
+	~StaticSpatialHashing();
+
+	// Builds the table from scratch using the specified grid cell size
+	// Positions and values are copied and reordered so entry indices used by the queries don't match the indices of the source arrays.
+	// Store the source index in the value if you need it!
+	void			Build( const bfloat3* _positions, const _type_* _values, U32 _count, const bfloat3& _cellSize );
+
+	// Clears the entire table
+	void			Clear();
+
+	// Returns the amount of entries in the table
+	U32				Num() const									{ return m_entriesCount; }
+
+	// Gives access to an entry's position and value
+	const bfloat3&	GetPosition( U32 _entryIndex ) const		{ ASSERT( _entryIndex < m_entriesCount, "Index out of range!" ); return m_positions[_entryIndex]; }
+	const _type_&	GetValue( U32 _entryIndex ) const			{ ASSERT( _entryIndex < m_entriesCount, "Index out of range!" ); return m_values[_entryIndex]; }
+	_type_&			GetValue( U32 _entryIndex )					{ ASSERT( _entryIndex < m_entriesCount, "Index out of range!" ); return m_values[_entryIndex]; }
+
+	// Retrieves the the cell for a given position
+	void			GetCellIndices( const bfloat3& _position, int& _cellX, int& _cellY, int& _cellZ ) const {
+		_cellX = FloorToInt( _position.x * m_invCellSize.x );
+		_cellY = FloorToInt( _position.y * m_invCellSize.y );
+		_cellZ = FloorToInt( _position.z * m_invCellSize.z );
+	}
+
+	// Visits all the entries within _radius of _position, only consulting the cells overlapping the query sphere
+	// The visitor can be any class implementing "void operator()( U32 _entryIndex, float _sqDistance )"
+	template< typename VISITOR >
+	void			ForEachInRadius( const bfloat3& _position, float _radius, VISITOR& _visitor ) const;
+
+	// Retrieves the indices of all the entries within _radius of _position (in no particular order)
+	void			FindAllInRadius( const bfloat3& _position, float _radius, List< U32 >& _entryIndices ) const;
+
+	// Retrieves the _K nearest entries to _position within _maxRadius, sorted by increasing distance
+	// Cells are visited in growing shells around the position's cell until no closer entry can be found.
+	// Returns the amount of entries found (can be less than _K if the table doesn't contain enough entries within _maxRadius)
+	U32				FindNearest( const bfloat3& _position, U32 _K, U32* _entryIndices, float* _sqDistances, float _maxRadius=MAX_FLOAT ) const;
+
+private:
+
+	// Collects the K nearest entries in increasing distance order
+	struct	NearestCollector {
+		U32		K;
+		U32		count;
+		U32*	entryIndices;
+		float*	sqDistances;
+		float	sqMaxDistance;		// Entries farther than this are discarded
+
+		void	operator()( U32 _entryIndex, float _sqDistance ) {
+			if ( _sqDistance >= sqMaxDistance && count == K )
+				return;
+
+			// Insertion sort (K is expected to be small)
+			U32	index = count < K ? count++ : K-1;
+			while ( index > 0 && sqDistances[index-1] > _sqDistance ) {
+				entryIndices[index] = entryIndices[index-1];
+				sqDistances[index] = sqDistances[index-1];
+				index--;
+			}
+			entryIndices[index] = _entryIndex;
+			sqDistances[index] = _sqDistance;
+
+			if ( count == K )
+				sqMaxDistance = sqDistances[K-1];
+		}
+	};
+
+	// Build jobs
+	struct	ComputeKeysJob {
+		const StaticSpatialHashing*	owner;
+		const bfloat3*				positions;
+		U64*						keys;
+		U32							count;
+		U32							chunkSize;
+		int*						chunkBounds;	// 6 integers per chunk
+
+		void	operator()( U32 _chunkIndex ) {
+			U32		start = _chunkIndex * chunkSize;
+			U32		end = MIN( start + chunkSize, count );
+			int*	bounds = chunkBounds + 6 * _chunkIndex;
+			bounds[0] = bounds[1] = bounds[2] = 0x7FFFFFFF;
+			bounds[3] = bounds[4] = bounds[5] = -0x7FFFFFFF-1;
+			for ( U32 entryIndex=start; entryIndex < end; entryIndex++ ) {
+				int	cellX, cellY, cellZ;
+				owner->GetCellIndices( positions[entryIndex], cellX, cellY, cellZ );
+				bounds[0] = MIN( bounds[0], cellX );	bounds[3] = MAX( bounds[3], cellX );
+				bounds[1] = MIN( bounds[1], cellY );	bounds[4] = MAX( bounds[4], cellY );
+				bounds[2] = MIN( bounds[2], cellZ );	bounds[5] = MAX( bounds[5], cellZ );
+
+				U32	hash = owner->ComputeHash( cellX, cellY, cellZ );
+				keys[entryIndex] = (U64(hash) << 32) | entryIndex;	// Source index in the low bits makes all keys unique
+			}
+		}
+	};
+
+	struct	HashSortKey {
+		U32	operator()( U64 _key ) const	{ return U32( _key >> 32 ); }
+	};
+
+	struct	BuildCellStartsJob {
+		const U64*	keys;
+		U32*		cellStarts;
+
+		void	operator()( U32 _entryIndex ) {
+			// Each entry starting a new table entry writes the starts of all the (empty) table entries since the previous one
+			U32	hash = U32( keys[_entryIndex] >> 32 );
+			U32	previousHash = _entryIndex > 0 ? U32( keys[_entryIndex-1] >> 32 ) : ~0U;
+			if ( hash == previousHash )
+				return;
+			for ( U32 emptyHash=previousHash+1; emptyHash <= hash; emptyHash++ )
+				cellStarts[emptyHash] = _entryIndex;
+		}
+	};
+
+	struct	GatherJob {
+		const U64*		keys;
+		const bfloat3*	sourcePositions;
+		const _type_*	sourceValues;
+		bfloat3*		positions;
+		_type_*			values;
+
+		void	operator()( U32 _entryIndex ) {
+			U32	sourceIndex = U32( keys[_entryIndex] );
+			positions[_entryIndex] = sourcePositions[sourceIndex];
+			values[_entryIndex] = sourceValues[sourceIndex];
+		}
+	};
+
+	// Much cheaper than a call to floorf() and called for every visited entry
+	static int	FloorToInt( float _value ) {
+		int	result = int( _value );
+		return _value < float( result ) ? result-1 : result;
+	}
+
+	// Only the (Y,Z) row of a cell is hashed, the X coordinate is then used as an offset so consecutive cells of a row are stored contiguously.
+	// Queries thus scan each row of cells in a single pass instead of jumping to a random table entry for every cell.
+	U32	ComputeHash( int X, int Y, int Z ) const {
+		return (SpatialHashing< _type_ >::Hash( 0, Y, Z ) + U32( X )) & m_tableMask;
+	}
+
+	// Returns the square distance from a position to the closest point of a cell
+	float	SqDistanceToCell( const bfloat3& _position, int _cellX, int _cellY, int _cellZ ) const {
+		float	dx = SqDistanceToInterval( _position.x, _cellX, m_cellSize.x );
+		float	dy = SqDistanceToInterval( _position.y, _cellY, m_cellSize.y );
+		float	dz = SqDistanceToInterval( _position.z, _cellZ, m_cellSize.z );
+		return dx + dy + dz;
+	}
+	static float	SqDistanceToInterval( float _x, int _cell, float _cellSize ) {
+		float	min = _cell * _cellSize;
+		float	d = MAX( 0.0f, MAX( min - _x, _x - (min + _cellSize) ) );
+		return d * d;
+	}
+
+	// Returns the cell of a coordinate clamped to [_minCell,_maxCell]
+	// The clamp is done before the conversion to int so coordinates far outside the occupied cells (e.g. huge query radii) can't overflow
+	static int		GetClampedCell( float _x, float _invCellSize, int _minCell, int _maxCell ) {
+		float	cell = floorf( _x * _invCellSize );
+		return int( CLAMP( cell, float( _minCell ), float( _maxCell ) ) );
+	}
+
+	// Visits the entries of the cells [_minCellX,_maxCellX] of a row within the given square radius
+	// Entries of other rows sharing the same table entries are skipped so each entry is visited at most once per query
+	template< typename VISITOR >
+	void	VisitRow( int _minCellX, int _maxCellX, int _cellY, int _cellZ, const bfloat3& _position, const float& _sqRadius, VISITOR& _visitor ) const {
+		// Split the row so it never wraps around the table
+		U32	tableSize = m_tableMask + 1;
+		while ( _minCellX <= _maxCellX ) {
+			U32	startHash = ComputeHash( _minCellX, _cellY, _cellZ );
+			U32	cellsCount = MIN( U32( _maxCellX - _minCellX ) + 1, tableSize - startHash );
+			int	endCellX = _minCellX + int(cellsCount) - 1;
+
+			U32	end = m_cellStarts[startHash + cellsCount];
+			for ( U32 entryIndex=m_cellStarts[startHash]; entryIndex < end; entryIndex++ ) {
+				const bfloat3&	entryPosition = m_positions[entryIndex];
+				float	sqDistance = (entryPosition - _position).LengthSq();
+				if ( sqDistance > _sqRadius )
+					continue;
+
+				int	entryCellX, entryCellY, entryCellZ;
+				GetCellIndices( entryPosition, entryCellX, entryCellY, entryCellZ );
+				if ( entryCellY == _cellY && entryCellZ == _cellZ && entryCellX >= _minCellX && entryCellX <= endCellX )
+					_visitor( entryIndex, sqDistance );
+			}
+
+			_minCellX = endCellX + 1;
+		}
+	}
+
+	void	VisitShellCell( int _cellX, int _cellY, int _cellZ, const bfloat3& _position, NearestCollector& _collector ) const {
+		// The collector's max distance shrinks as closer entries are found
+		if ( SqDistanceToCell( _position, _cellX, _cellY, _cellZ ) <= _collector.sqMaxDistance )
+			VisitRow( _cellX, _cellX, _cellY, _cellZ, _position, _collector.sqMaxDistance, _collector );
+	}
+
+	struct	RadiusCollector {
+		List< U32 >*	entryIndices;
+		void	operator()( U32 _entryIndex, float _sqDistance )	{ entryIndices->Append( _entryIndex ); }
+	};
+
+private:
+
+	static const U32	MIN_TABLE_POT = 4;
+	static const U32	MAX_TABLE_POT = 30;
+	static const U32	BUILD_CHUNK_SIZE = 1 << 14;
+	static const U32	BUILD_GRAIN_SIZE = 1 << 12;
+	static const U32	MIN_MERGE_SORT_THREADS = 4;
+
+	U32				m_entriesCount;
+	bfloat3*		m_positions;
+	_type_*			m_values;
+
+	U32				m_tableMask;		// Table size is a power of two
+	U32*			m_cellStarts;		// Start of each table entry in the entries arrays (table size + 1 elements)
+
+	bfloat3			m_cellSize;
+	bfloat3			m_invCellSize;
+
+	int				m_minCell[3];		// Bounds of the occupied cells
+	int				m_maxCell[3];
+};
+
+template < typename _type_ >
+StaticSpatialHashing< _type_ >::StaticSpatialHashing()
+	: m_entriesCount( 0 )
+	, m_positions( NULL )
+	, m_values( NULL )
+	, m_tableMask( 0 )
+	, m_cellStarts( NULL ) {
+
+	m_cellSize = bfloat3::One;
+	m_invCellSize = bfloat3::One;
+}
+
+template < typename _type_ >
+StaticSpatialHashing< _type_ >::~StaticSpatialHashing() {
+	Clear();
+}
+
+template < typename _type_ >
+void StaticSpatialHashing< _type_ >::Clear() {
+	SAFE_DELETE_ARRAY( m_positions );
+	SAFE_DELETE_ARRAY( m_values );
+	SAFE_DELETE_ARRAY( m_cellStarts );
+	m_entriesCount = 0;
+	m_tableMask = 0;
+}
+
+template < typename _type_ >
+void StaticSpatialHashing< _type_ >::Build( const bfloat3* _positions, const _type_* _values, U32 _count, const bfloat3& _cellSize ) {
+	ASSERT( _cellSize.x > 1e-6f && _cellSize.y > 1e-6f && _cellSize.z > 1e-6f, "Cell size is too small!" );
+
+	Clear();
+	m_cellSize = _cellSize;
+	m_invCellSize.Set( 1.0f / _cellSize.x, 1.0f / _cellSize.y, 1.0f / _cellSize.z );
+	if ( _count == 0 )
+		return;
+
+	// Table size is the next power of two above the amount of entries
+	U32	POT = MIN_TABLE_POT;
+	while ( (1U << POT) < _count && POT < MAX_TABLE_POT )
+		POT++;
+	m_tableMask = (1U << POT) - 1;
+	m_entriesCount = _count;
+
+	// 1] Compute the (table entry, source index) sort keys and the bounds of the occupied cells
+	U64*	keys = new U64[_count];
+	U32		chunksCount = (_count + BUILD_CHUNK_SIZE - 1) / BUILD_CHUNK_SIZE;
+	int*	chunkBounds = new int[6 * chunksCount];
+
+	ComputeKeysJob	keysJob;
+	keysJob.owner = this;
+	keysJob.positions = _positions;
+	keysJob.keys = keys;
+	keysJob.count = _count;
+	keysJob.chunkSize = BUILD_CHUNK_SIZE;
+	keysJob.chunkBounds = chunkBounds;
+	ParallelFor( chunksCount, keysJob );
+
+	for ( int i=0; i < 3; i++ ) {
+		m_minCell[i] = chunkBounds[i];
+		m_maxCell[i] = chunkBounds[3+i];
+	}
+	for ( U32 chunkIndex=1; chunkIndex < chunksCount; chunkIndex++ ) {
+		const int*	bounds = chunkBounds + 6 * chunkIndex;
+		for ( int i=0; i < 3; i++ ) {
+			m_minCell[i] = MIN( m_minCell[i], bounds[i] );
+			m_maxCell[i] = MAX( m_maxCell[i], bounds[3+i] );
+		}
+	}
+	delete[] chunkBounds;
+
+	// 2] Sort entries by table entry
+	// Keys are unique so both sorts give the same result, but a single-threaded radix sort beats the merge sort with only a few cores
+	if ( GetHardwareThreadsCount() >= MIN_MERGE_SORT_THREADS ) {
+		ParallelMergeSort( keys, _count, Less< U64 >() );
+	} else {
+		U64*	temp = new U64[_count];
+		U64*	sortedKeys = RadixSort32( keys, _count, HashSortKey(), temp );
+		if ( sortedKeys != keys )
+			Swap( keys, temp );
+		delete[] temp;
+	}
+
+	// 3] Build the start of each table entry
+	m_cellStarts = new U32[m_tableMask+2];
+
+	BuildCellStartsJob	startsJob;
+	startsJob.keys = keys;
+	startsJob.cellStarts = m_cellStarts;
+	ParallelFor( _count, startsJob, BUILD_GRAIN_SIZE );
+
+	U32	lastHash = U32( keys[_count-1] >> 32 );
+	for ( U32 hash=lastHash+1; hash <= m_tableMask+1; hash++ )
+		m_cellStarts[hash] = _count;
+
+	// 4] Gather positions and values in sorted order
+	m_positions = new bfloat3[_count];
+	m_values = new _type_[_count];
+
+	GatherJob	gatherJob;
+	gatherJob.keys = keys;
+	gatherJob.sourcePositions = _positions;
+	gatherJob.sourceValues = _values;
+	gatherJob.positions = m_positions;
+	gatherJob.values = m_values;
+	ParallelFor( _count, gatherJob, BUILD_GRAIN_SIZE );
+
+	delete[] keys;
+}
+
+template < typename _type_ > template< typename VISITOR >
+void	StaticSpatialHashing< _type_ >::ForEachInRadius( const bfloat3& _position, float _radius, VISITOR& _visitor ) const {
+	if ( m_entriesCount == 0 )
+		return;
+
+	// An empty range (min > max) is kept empty by the clamps when the query doesn't overlap the occupied cells
+	int	minCellX = GetClampedCell( _position.x - _radius, m_invCellSize.x, m_minCell[0], m_maxCell[0] + 1 );
+	int	minCellY = GetClampedCell( _position.y - _radius, m_invCellSize.y, m_minCell[1], m_maxCell[1] + 1 );
+	int	minCellZ = GetClampedCell( _position.z - _radius, m_invCellSize.z, m_minCell[2], m_maxCell[2] + 1 );
+
+	int	maxCellX = GetClampedCell( _position.x + _radius, m_invCellSize.x, m_minCell[0] - 1, m_maxCell[0] );
+	int	maxCellY = GetClampedCell( _position.y + _radius, m_invCellSize.y, m_minCell[1] - 1, m_maxCell[1] );
+	int	maxCellZ = GetClampedCell( _position.z + _radius, m_invCellSize.z, m_minCell[2] - 1, m_maxCell[2] );
+
+	float	sqRadius = _radius * _radius;
+	for ( int Z=minCellZ; Z <= maxCellZ; Z++ ) {
+		float	sqDistanceZ = SqDistanceToInterval( _position.z, Z, m_cellSize.z );
+		for ( int Y=minCellY; Y <= maxCellY; Y++ ) {
+			float	sqDistanceYZ = sqDistanceZ + SqDistanceToInterval( _position.y, Y, m_cellSize.y );
+			if ( sqDistanceYZ > sqRadius )
+				continue;
+
+			// Restrict the row to the cells overlapping the sphere
+			float	halfWidth = sqrtf( sqRadius - sqDistanceYZ );
+			int		rowMinX = GetClampedCell( _position.x - halfWidth, m_invCellSize.x, minCellX, maxCellX + 1 );
+			int		rowMaxX = GetClampedCell( _position.x + halfWidth, m_invCellSize.x, minCellX - 1, maxCellX );
+			VisitRow( rowMinX, rowMaxX, Y, Z, _position, sqRadius, _visitor );
+		}
+	}
+}
+
+template < typename _type_ >
+void	StaticSpatialHashing< _type_ >::FindAllInRadius( const bfloat3& _position, float _radius, List< U32 >& _entryIndices ) const {
+	RadiusCollector	collector;
+	collector.entryIndices = &_entryIndices;
+	ForEachInRadius( _position, _radius, collector );
+}
+
+template < typename _type_ >
+U32	StaticSpatialHashing< _type_ >::FindNearest( const bfloat3& _position, U32 _K, U32* _entryIndices, float* _sqDistances, float _maxRadius ) const {
+	if ( m_entriesCount == 0 || _K == 0 )
+		return 0;
+
+	NearestCollector	collector;
+	collector.K = _K;
+	collector.count = 0;
+	collector.entryIndices = _entryIndices;
+	collector.sqDistances = _sqDistances;
+	collector.sqMaxDistance = _maxRadius < MAX_FLOAT ? _maxRadius * _maxRadius : MAX_FLOAT;
+
+	int	center[3];
+	GetCellIndices( _position, center[0], center[1], center[2] );
+
+	// Shells closer than the occupied cells are empty anyway so start at the first shell touching them
+	int	firstShell = 0;
+	int	lastShell = 0;
+	for ( int i=0; i < 3; i++ ) {
+		firstShell = MAX( firstShell, MAX( m_minCell[i] - center[i], center[i] - m_maxCell[i] ) );
+		lastShell = MAX( lastShell, MAX( m_maxCell[i] - center[i], center[i] - m_minCell[i] ) );
+	}
+
+	for ( int shell=firstShell; shell <= lastShell; shell++ ) {
+		// Visit all the cells at Chebyshev distance "shell" from the center cell, clipped to the occupied cells
+		int	minZ = MAX( center[2] - shell, m_minCell[2] ), maxZ = MIN( center[2] + shell, m_maxCell[2] );
+		int	minY = MAX( center[1] - shell, m_minCell[1] ), maxY = MIN( center[1] + shell, m_maxCell[1] );
+		int	minX = MAX( center[0] - shell, m_minCell[0] ), maxX = MIN( center[0] + shell, m_maxCell[0] );
+		for ( int Z=minZ; Z <= maxZ; Z++ ) {
+			bool	isShellZ = Z == center[2] - shell || Z == center[2] + shell;
+			for ( int Y=minY; Y <= maxY; Y++ ) {
+				bool	isShellY = Y == center[1] - shell || Y == center[1] + shell;
+				if ( isShellZ || isShellY ) {
+					float	sqDistanceYZ = SqDistanceToInterval( _position.y, Y, m_cellSize.y ) + SqDistanceToInterval( _position.z, Z, m_cellSize.z );
+					if ( sqDistanceYZ <= collector.sqMaxDistance )
+						VisitRow( minX, maxX, Y, Z, _position, collector.sqMaxDistance, collector );
+				} else {
+					// Inside the shell, only the 2 extreme X cells belong to it
+					if ( center[0] - shell >= minX )
+						VisitShellCell( center[0] - shell, Y, Z, _position, collector );
+					if ( center[0] + shell <= maxX && shell > 0 )
+						VisitShellCell( center[0] + shell, Y, Z, _position, collector );
+				}
+			}
+		}
+
+		// Stop as soon as the next shell can't contain anything closer than what we already have
+		float	margin = MAX_FLOAT;
+		for ( int i=0; i < 3; i++ ) {
+			float	cellMin = (center[i] - shell) * m_cellSize[i];
+			float	cellMax = (center[i] + shell + 1) * m_cellSize[i];
+			margin = MIN( margin, MIN( _position[i] - cellMin, cellMax - _position[i] ) );
+		}
+		if ( margin * margin >= collector.sqMaxDistance )
+			break;
+	}
+
+	return collector.count;
+}
+
+}	// namespace BaseLib
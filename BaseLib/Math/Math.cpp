@@ -226,6 +226,72 @@ float&	float3x3::operator()( int _row, int _column ) {
 const float4x4	float4x4::Zero( 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
 const float4x4	float4x4::Identity( 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 );
 
+#ifdef MATH_USE_SSE
+
+// Shuffles used to compute 3D cross products as a.yzx * b.zxy - a.zxy * b.yzx
+#define SSE_YZX( v )	_mm_shuffle_ps( v, v, _MM_SHUFFLE( 3, 0, 2, 1 ) )
+#define SSE_ZXY( v )	_mm_shuffle_ps( v, v, _MM_SHUFFLE( 3, 1, 0, 2 ) )
+#define SSE_SPLAT( v, i )	_mm_shuffle_ps( v, v, _MM_SHUFFLE( i, i, i, i ) )
+
+static inline __m128	SSECross( __m128 a, __m128 b ) {
+	return _mm_sub_ps( _mm_mul_ps( SSE_YZX( a ), SSE_ZXY( b ) ), _mm_mul_ps( SSE_ZXY( a ), SSE_YZX( b ) ) );
+}
+
+// Computes the terms of the inverse as described by E. Lengyel in "Foundations of Game Engine Development, Volume 1"
+// The rows of our matrix are treated as the columns a, b, c, d of Lengyel's matrix (whose bottom row is x, y, z, w), which gives us the transpose of the inverse
+//	s = a x b, t = c x d, u = y*a - x*b, v = w*c - z*d and the determinant is s.v + t.u
+struct	SSEInverseTerms {
+	__m128	a, b, c, d;
+	__m128	s, t, u, v;
+	float	Determinant;
+
+	SSEInverseTerms( const float4x4& _M ) {
+		a = _M.r[0].Load();
+		b = _M.r[1].Load();
+		c = _M.r[2].Load();
+		d = _M.r[3].Load();
+
+		s = SSECross( a, b );
+		t = SSECross( c, d );
+		u = _mm_sub_ps( _mm_mul_ps( a, SSE_SPLAT( b, 3 ) ), _mm_mul_ps( b, SSE_SPLAT( a, 3 ) ) );	// w component is 0
+		v = _mm_sub_ps( _mm_mul_ps( c, SSE_SPLAT( d, 3 ) ), _mm_mul_ps( d, SSE_SPLAT( c, 3 ) ) );	// w component is 0
+		Determinant = SSEHorizontalSum( _mm_add_ps( _mm_mul_ps( s, v ), _mm_mul_ps( t, u ) ) );
+	}
+};
+
+float4x4 float4x4::Inverse() const {
+	SSEInverseTerms	T( *this );
+	ASSERT( fabs(T.Determinant) > 1e-6f, "Matrix is not inversible!" );
+	__m128	InvDet = _mm_set1_ps( 1.0f / T.Determinant );
+	__m128	s = _mm_mul_ps( T.s, InvDet );
+	__m128	t = _mm_mul_ps( T.t, InvDet );
+	__m128	u = _mm_mul_ps( T.u, InvDet );
+	__m128	v = _mm_mul_ps( T.v, InvDet );
+
+	// Rows of the transposed inverse (the w components are all 0 since s, t, u and v have w=0)
+	__m128	r0 = _mm_add_ps( SSECross( T.b, v ), _mm_mul_ps( t, SSE_SPLAT( T.b, 3 ) ) );
+	__m128	r1 = _mm_sub_ps( SSECross( v, T.a ), _mm_mul_ps( t, SSE_SPLAT( T.a, 3 ) ) );
+	__m128	r2 = _mm_add_ps( SSECross( T.d, u ), _mm_mul_ps( s, SSE_SPLAT( T.d, 3 ) ) );
+	__m128	r3 = _mm_sub_ps( SSECross( u, T.c ), _mm_mul_ps( s, SSE_SPLAT( T.c, 3 ) ) );
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+
+	float4x4	R;
+	R.r[0] = bfloat4::Store( r0 );
+	R.r[1] = bfloat4::Store( r1 );
+	R.r[2] = bfloat4::Store( r2 );
+	R.r[3].Set(	-SSEHorizontalSum( _mm_mul_ps( T.b, t ) ),
+				 SSEHorizontalSum( _mm_mul_ps( T.a, t ) ),
+				-SSEHorizontalSum( _mm_mul_ps( T.d, s ) ),
+				 SSEHorizontalSum( _mm_mul_ps( T.c, s ) ) );
+	return R;
+}
+
+float	float4x4::Determinant() const {
+	return SSEInverseTerms( *this ).Determinant;
+}
+
+#else
+
 float4x4 float4x4::Inverse() const {
 	float	det = Determinant();
 	ASSERT( fabs(det) > 1e-6f, "Matrix is not inversible!" );
@@ -244,11 +310,13 @@ float	float4x4::Determinant() const {
 	return r[0].x * CoFactor( 0, 0 ) + r[0].y * CoFactor( 0, 1 ) + r[0].z * CoFactor( 0, 2 ) + r[0].w * CoFactor( 0, 3 ); 
 }
 
+#endif
+
 float	float4x4::CoFactor( int _row, int _col ) const {
 	int		row1 = (_row+1) & 3;
 	int		row2 = (_row+2) & 3;
 	int		row3 = (_row+3) & 3;
-	float	sign = float( (((_row + _col) & 1) << 1) - 1 );
+	float	sign = float( 1 - (((_row + _col) & 1) << 1) );
 	return	((	r[row1][_col+1] * r[row2][_col+2] * r[row3][_col+3] +
 				r[row1][_col+2] * r[row2][_col+3] * r[row3][_col+1] +
 				r[row1][_col+3] * r[row2][_col+1] * r[row3][_col+2] )
@@ -273,6 +341,27 @@ float4x4&	float4x4::Scale( const bfloat3& _scale ) {
 	return *this;
 }
 
+#ifdef MATH_USE_SSE
+
+bfloat4   operator*( const bfloat4& a, const float4x4& b ) {
+	__m128	v = a.Load();
+	__m128	R = _mm_add_ps(	_mm_add_ps( _mm_mul_ps( SSE_SPLAT( v, 0 ), b.r[0].Load() ), _mm_mul_ps( SSE_SPLAT( v, 1 ), b.r[1].Load() ) ),
+							_mm_add_ps( _mm_mul_ps( SSE_SPLAT( v, 2 ), b.r[2].Load() ), _mm_mul_ps( SSE_SPLAT( v, 3 ), b.r[3].Load() ) ) );
+	return bfloat4::Store( R );
+}
+
+bfloat4   operator*( const float4x4& b, const bfloat4& a ) {
+	__m128	v = a.Load();
+	__m128	p0 = _mm_mul_ps( b.r[0].Load(), v );
+	__m128	p1 = _mm_mul_ps( b.r[1].Load(), v );
+	__m128	p2 = _mm_mul_ps( b.r[2].Load(), v );
+	__m128	p3 = _mm_mul_ps( b.r[3].Load(), v );
+	_MM_TRANSPOSE4_PS( p0, p1, p2, p3 );
+	return bfloat4::Store( _mm_add_ps( _mm_add_ps( p0, p1 ), _mm_add_ps( p2, p3 ) ) );
+}
+
+#else
+
 bfloat4   operator*( const bfloat4& a, const float4x4& b ) {
 	bfloat4	R;
 	R.x = a.x * b.r[0].x + a.y * b.r[1].x + a.z * b.r[2].x + a.w * b.r[3].x;
@@ -292,6 +381,8 @@ bfloat4   operator*( const float4x4& b, const bfloat4& a ) {
 	return R;
 }
 
+#endif
+
 float4x4&	float4x4::BuildFromQuat( const bfloat4& _Quat ) {
 	bfloat4	q = _Quat;
 	q.Normalize();
@@ -444,6 +535,44 @@ float4x4	operator*( float a, const float4x4& b ) {
 	return R;
 }
 
+#if defined(MATH_USE_AVX)
+
+// Computes 2 rows of the result at once
+float4x4  float4x4::operator*( const float4x4& b ) const {
+	__m256	b0 = _mm256_insertf128_ps( _mm256_castps128_ps256( b.r[0].Load() ), b.r[0].Load(), 1 );
+	__m256	b1 = _mm256_insertf128_ps( _mm256_castps128_ps256( b.r[1].Load() ), b.r[1].Load(), 1 );
+	__m256	b2 = _mm256_insertf128_ps( _mm256_castps128_ps256( b.r[2].Load() ), b.r[2].Load(), 1 );
+	__m256	b3 = _mm256_insertf128_ps( _mm256_castps128_ps256( b.r[3].Load() ), b.r[3].Load(), 1 );
+
+	float4x4  R;
+	for ( int i=0; i < 4; i+=2 ) {
+		__m256	a = _mm256_loadu_ps( &r[i].x );
+		__m256	Row = _mm256_add_ps(	_mm256_add_ps( _mm256_mul_ps( _mm256_shuffle_ps( a, a, 0x00 ), b0 ), _mm256_mul_ps( _mm256_shuffle_ps( a, a, 0x55 ), b1 ) ),
+										_mm256_add_ps( _mm256_mul_ps( _mm256_shuffle_ps( a, a, 0xAA ), b2 ), _mm256_mul_ps( _mm256_shuffle_ps( a, a, 0xFF ), b3 ) ) );
+		_mm256_storeu_ps( &R.r[i].x, Row );
+	}
+	return R;
+}
+
+#elif defined(MATH_USE_SSE)
+
+float4x4  float4x4::operator*( const float4x4& b ) const {
+	__m128	b0 = b.r[0].Load();
+	__m128	b1 = b.r[1].Load();
+	__m128	b2 = b.r[2].Load();
+	__m128	b3 = b.r[3].Load();
+
+	float4x4  R;
+	for ( int i=0; i < 4; i++ ) {
+		__m128	a = r[i].Load();
+		R.r[i] = bfloat4::Store( _mm_add_ps(	_mm_add_ps( _mm_mul_ps( SSE_SPLAT( a, 0 ), b0 ), _mm_mul_ps( SSE_SPLAT( a, 1 ), b1 ) ),
+												_mm_add_ps( _mm_mul_ps( SSE_SPLAT( a, 2 ), b2 ), _mm_mul_ps( SSE_SPLAT( a, 3 ), b3 ) ) ) );
+	}
+	return R;
+}
+
+#else
+
 float4x4  float4x4::operator*( const float4x4& b ) const {
 	float4x4  R;
 
@@ -470,6 +599,8 @@ float4x4  float4x4::operator*( const float4x4& b ) const {
 	return R;
 }
 
+#endif
+
 float&	float4x4::operator()( int _row, int _column ) {
 	bfloat4&	row = r[_row&3];
 	switch ( _column&3 ) {
@@ -490,73 +621,322 @@ float4x4::operator float3x3() const {
 }
 
 
+//////////////////////////////////////////////////////////////////////////
+// Batched transforms
+#define NEXT( p, _Stride )	p = (decltype(p)) ((const U8*) p + _Stride)
+
+#ifdef MATH_USE_SSE
+
+// Stores 3 floats without writing past the end of the vector
+static inline void		SSEStore3( bfloat3* p, __m128 v ) {
+	_mm_storel_pi( (__m64*) &p->x, v );
+	_mm_store_ss( &p->z, _mm_movehl_ps( v, v ) );
+}
+static inline __m128	SSENormalize3( __m128 v ) {
+	__m128	Sq = _mm_mul_ps( v, v );
+	__m128	LengthSq = _mm_add_ss( _mm_add_ss( Sq, SSE_SPLAT( Sq, 1 ) ), SSE_SPLAT( Sq, 2 ) );
+	__m128	InvLength = _mm_div_ss( _mm_set_ss( 1.0f ), _mm_sqrt_ss( LengthSq ) );
+	return _mm_mul_ps( v, SSE_SPLAT( InvLength, 0 ) );
+}
+
+void	TransformPositions( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	__m128	r0 = _Transform.r[0].Load(), r1 = _Transform.r[1].Load(), r2 = _Transform.r[2].Load(), r3 = _Transform.r[3].Load();
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) ) {
+		__m128	P = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_load1_ps( &_pSource->x ), r0 ), _mm_mul_ps( _mm_load1_ps( &_pSource->y ), r1 ) ), _mm_add_ps( _mm_mul_ps( _mm_load1_ps( &_pSource->z ), r2 ), r3 ) );
+		SSEStore3( _pTarget, P );
+	}
+}
+
+void	TransformPositions( const float4x4& _Transform, const bfloat3* _pSource, bfloat4* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	__m128	r0 = _Transform.r[0].Load(), r1 = _Transform.r[1].Load(), r2 = _Transform.r[2].Load(), r3 = _Transform.r[3].Load();
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) ) {
+		__m128	P = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_load1_ps( &_pSource->x ), r0 ), _mm_mul_ps( _mm_load1_ps( &_pSource->y ), r1 ) ), _mm_add_ps( _mm_mul_ps( _mm_load1_ps( &_pSource->z ), r2 ), r3 ) );
+		_mm_storeu_ps( &_pTarget->x, P );
+	}
+}
+
+void	TransformVectors( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	__m128	r0 = _Transform.r[0].Load(), r1 = _Transform.r[1].Load(), r2 = _Transform.r[2].Load();
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) ) {
+		__m128	V = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_load1_ps( &_pSource->x ), r0 ), _mm_mul_ps( _mm_load1_ps( &_pSource->y ), r1 ) ), _mm_mul_ps( _mm_load1_ps( &_pSource->z ), r2 ) );
+		SSEStore3( _pTarget, V );
+	}
+}
+
+void	TransformNormals( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	__m128	r0 = _Transform.r[0].Load(), r1 = _Transform.r[1].Load(), r2 = _Transform.r[2].Load();
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) ) {
+		__m128	N = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_load1_ps( &_pSource->x ), r0 ), _mm_mul_ps( _mm_load1_ps( &_pSource->y ), r1 ) ), _mm_mul_ps( _mm_load1_ps( &_pSource->z ), r2 ) );
+		SSEStore3( _pTarget, SSENormalize3( N ) );
+	}
+}
+
+void	TransformTangents( const float4x4& _Transform, const bfloat4* _pSource, bfloat4* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	__m128	r0 = _Transform.r[0].Load(), r1 = _Transform.r[1].Load(), r2 = _Transform.r[2].Load();
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) ) {
+		__m128	S = _pSource->Load();
+		__m128	T = SSENormalize3( _mm_add_ps( _mm_add_ps( _mm_mul_ps( SSE_SPLAT( S, 0 ), r0 ), _mm_mul_ps( SSE_SPLAT( S, 1 ), r1 ) ), _mm_mul_ps( SSE_SPLAT( S, 2 ), r2 ) ) );
+		__m128	ZW = _mm_shuffle_ps( T, S, _MM_SHUFFLE( 3, 3, 2, 2 ) );					// (T.z, T.z, S.w, S.w)
+		_mm_storeu_ps( &_pTarget->x, _mm_shuffle_ps( T, ZW, _MM_SHUFFLE( 2, 0, 1, 0 ) ) );	// (T.x, T.y, T.z, S.w)
+	}
+}
+
+void	Transform( const float4x4& _Transform, const bfloat4* _pSource, bfloat4* _pTarget, U32 _Count ) {
+	__m128	r0 = _Transform.r[0].Load(), r1 = _Transform.r[1].Load(), r2 = _Transform.r[2].Load(), r3 = _Transform.r[3].Load();
+	for ( U32 i=0; i < _Count; i++ ) {
+		__m128	S = _pSource[i].Load();
+		__m128	P = _mm_add_ps( _mm_add_ps( _mm_mul_ps( SSE_SPLAT( S, 0 ), r0 ), _mm_mul_ps( SSE_SPLAT( S, 1 ), r1 ) ), _mm_add_ps( _mm_mul_ps( SSE_SPLAT( S, 2 ), r2 ), _mm_mul_ps( SSE_SPLAT( S, 3 ), r3 ) ) );
+		_mm_storeu_ps( &_pTarget[i].x, P );
+	}
+}
+
+#else
+
+void	TransformPositions( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) )
+		*_pTarget = bfloat3( bfloat4( *_pSource, 1.0f ) * _Transform );
+}
+
+void	TransformPositions( const float4x4& _Transform, const bfloat3* _pSource, bfloat4* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) )
+		*_pTarget = bfloat4( *_pSource, 1.0f ) * _Transform;
+}
+
+void	TransformVectors( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) )
+		*_pTarget = bfloat3( bfloat4( *_pSource, 0.0f ) * _Transform );
+}
+
+void	TransformNormals( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) ) {
+		bfloat3	N = bfloat4( *_pSource, 0.0f ) * _Transform;
+		*_pTarget = N.Normalize();
+	}
+}
+
+void	TransformTangents( const float4x4& _Transform, const bfloat4* _pSource, bfloat4* _pTarget, U32 _Count, U32 _SourceStride, U32 _TargetStride ) {
+	for ( U32 i=0; i < _Count; i++, NEXT( _pSource, _SourceStride ), NEXT( _pTarget, _TargetStride ) ) {
+		bfloat3	T = bfloat4( _pSource->x, _pSource->y, _pSource->z, 0.0f ) * _Transform;
+		_pTarget->Set( T.Normalize(), _pSource->w );
+	}
+}
+
+void	Transform( const float4x4& _Transform, const bfloat4* _pSource, bfloat4* _pTarget, U32 _Count ) {
+	for ( U32 i=0; i < _Count; i++ )
+		_pTarget[i] = _pSource[i] * _Transform;
+}
+
+#endif
+#undef NEXT
+
+
 //////////////////////////////////////////////////////////////////////////
 // Half floats encoding
 const float	half::SMALLEST = 6.1035156e-005f;	// The smallest encodable half float
 
-#define F16_EXPONENT_BITS 0x1F
-#define F16_EXPONENT_SHIFT 10
-#define F16_EXPONENT_BIAS 15
-#define F16_MANTISSA_BITS 0x03ff
-#define F16_MANTISSA_SHIFT (23 - F16_EXPONENT_SHIFT)
-#define F16_MAX_EXPONENT (F16_EXPONENT_BITS << F16_EXPONENT_SHIFT)
+// Floats whose absolute value is above F16_OVERFLOW are either infinities, NaNs or overflow to infinity
+// Floats whose absolute value is below F16_DENORMAL are encoded as denormalized half floats (or zero)
+#define F16_OVERFLOW		0x47800000U		// (127+16) << 23 = 65536.0
+#define F16_DENORMAL		0x38800000U		// (127-14) << 23 = 2^-14
+#define F16_DENORMAL_MAGIC	0x3F000000U		// ((127-15) + (23-10) + 1) << 23 = 0.5, adding this to a denormal aligns its mantissa so the FPU does the rounding for us
+#define F16_REBIAS			0x38000000U		// (127-15) << 23
+#define F16_ROUND			0xC8000FFFU		// ((15-127) << 23) + 0xFFF, rebiases the exponent and rounds to nearest (the odd bit of the mantissa is added to break ties to even)
 
 half::half( float value ) {
-	U32 f32 = *((U32*) &value);
-	raw = 0;
-
-	// Decode IEEE 754 little-endian 32-bit floating-point value
-	int sign = (f32 >> 16) & 0x8000;
-	// Map exponent to the range [-127,128]
-	int exponent = ((f32 >> 23) & 0xff) - 127;
-	int mantissa = f32 & 0x007fffff;
-	if ( exponent == 128 ) {
-		// Infinity or NaN
-		raw = U16( sign | F16_MAX_EXPONENT );
-		if ( mantissa != 0 ) raw |= (mantissa & F16_MANTISSA_BITS);
-	} else if ( exponent > 15 ) {
-		// Overflow - flush to Infinity
-		raw = U16( sign | F16_MAX_EXPONENT );
-	} else if ( exponent > -15 ) {
-		// Representable value
-		exponent += F16_EXPONENT_BIAS;
-		mantissa >>= F16_MANTISSA_SHIFT;
-		raw = U16( sign | exponent << F16_EXPONENT_SHIFT | mantissa );
+	union {
+		float	f;
+		U32		ui;
+	} f32;
+	f32.f = value;
+
+	U32	sign = (f32.ui >> 16) & 0x8000U;
+	f32.ui &= 0x7FFFFFFFU;
+	if ( f32.ui >= F16_OVERFLOW ) {
+		// Infinity, NaN (quieted, keeping the upper bits of the payload) or overflow
+		raw = U16( sign | (f32.ui > 0x7F800000U ? 0x7E00U | ((f32.ui >> 13) & 0x03FFU) : 0x7C00U) );
+	} else if ( f32.ui < F16_DENORMAL ) {
+		// Denormal or zero
+		f32.f += 0.5f;
+		raw = U16( sign | (f32.ui - F16_DENORMAL_MAGIC) );
 	} else {
-		raw = U16(sign);
+		// Representable value (may still round up to infinity)
+		U32	mantissaOdd = (f32.ui >> 13) & 1;
+		f32.ui += F16_ROUND + mantissaOdd;
+		raw = U16( sign | (f32.ui >> 13) );
 	}
 }
 
 half::operator float() const {
 	union {
-		float   f;
-		U32	 ui;
+		float	f;
+		U32		ui;
 	} f32;
 
-	int sign = (raw & 0x8000) << 15;
-	int exponent = (raw & 0x7c00) >> 10;
-	int mantissa = (raw & 0x03ff);
-
-	f32.f = 0.0f;
-	if ( exponent == 0 ) {
-		if ( mantissa != 0 ) 
-			f32.f = mantissa / float(1 << 24);
-	} else if ( exponent == 31 ) {
-		f32.ui = sign | 0x7f800000 | mantissa;
-	} else {
-		float scale, decimal;
-		exponent -= 15;
-		if ( exponent < 0 ) {
-			scale = float( 1.0 / (1 << -exponent) );
-		} else {
-			scale = float( 1 << exponent );
-		}
-		decimal = 1.0f + (float) mantissa / (1 << 10);
-		f32.f = scale * decimal;
+	U32	sign = (raw & 0x8000U) << 16;
+	f32.ui = (raw & 0x7FFFU) << 13;
+	U32	exponent = f32.ui & 0x0F800000U;
+	f32.ui += F16_REBIAS;
+	if ( exponent == 0x0F800000U ) {
+		// Infinity or NaN (NaNs are quieted)
+		f32.ui += F16_REBIAS;
+		if ( (f32.ui & 0x007FFFFFU) != 0 )
+			f32.ui |= 0x00400000U;
+	} else if ( exponent == 0 ) {
+		// Denormal or zero: renormalize using the FPU
+		f32.ui += 0x00800000U;
+		f32.f -= 6.10351563e-05f;	// 2^-14
 	}
-	
-	if ( sign != 0 )
-		f32.f = -f32.f;
+	f32.ui |= sign;
 
 	return f32.f;
 }
+
+//////////////////////////////////////////////////////////////////////////
+// Batched half floats conversions
+//
+#if defined(MATH_USE_SSE) && (defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__)))	// MSVC's /arch:AVX2 implies F16C
+	#define MATH_USE_F16C			// The F16C instructions are always available
+	#include <immintrin.h>
+#elif defined(MATH_USE_SSE) && defined(_MSC_VER) && _MSC_VER >= 1700
+	#define MATH_USE_F16C
+	#define MATH_DETECT_F16C		// The compiler accepts the F16C intrinsics but the CPU support must be checked at runtime
+	#include <immintrin.h>
+	#include <intrin.h>
+#endif
+
+#ifdef MATH_USE_F16C
+
+static void	HalfToFloatF16C( const half* _pSource, float* _pTarget, U32 _Count ) {
+	for ( ; _Count >= 8; _Count-=8, _pSource+=8, _pTarget+=8 ) {
+		__m128i	H = _mm_loadu_si128( (const __m128i*) _pSource );
+		_mm_storeu_ps( _pTarget, _mm_cvtph_ps( H ) );
+		_mm_storeu_ps( _pTarget+4, _mm_cvtph_ps( _mm_unpackhi_epi64( H, H ) ) );
+	}
+	for ( ; _Count > 0; _Count--, _pSource++, _pTarget++ )
+		*_pTarget = *_pSource;
+}
+
+static void	FloatToHalfF16C( const float* _pSource, half* _pTarget, U32 _Count ) {
+	for ( ; _Count >= 8; _Count-=8, _pSource+=8, _pTarget+=8 ) {
+		__m128i	H0 = _mm_cvtps_ph( _mm_loadu_ps( _pSource ), 0 );	// 0 = Round to nearest even
+		__m128i	H1 = _mm_cvtps_ph( _mm_loadu_ps( _pSource+4 ), 0 );
+		_mm_storeu_si128( (__m128i*) _pTarget, _mm_unpacklo_epi64( H0, H1 ) );
+	}
+	for ( ; _Count > 0; _Count--, _pSource++, _pTarget++ )
+		*_pTarget = *_pSource;
+}
+
+#endif
+
+#ifdef MATH_DETECT_F16C
+
+static bool	SupportsF16C() {
+	static int	ms_Supported = -1;
+	if ( ms_Supported < 0 ) {
+		int	pInfos[4];
+		__cpuid( pInfos, 1 );
+		const int	OSXSAVE_AVX_F16C = (1 << 27) | (1 << 28) | (1 << 29);
+		ms_Supported = (pInfos[2] & OSXSAVE_AVX_F16C) == OSXSAVE_AVX_F16C && (_xgetbv( 0 ) & 6) == 6 ? 1 : 0;	// The OS must also save the YMM registers
+	}
+	return ms_Supported != 0;
+}
+
+#endif
+
+#ifdef MATH_USE_SSE
+
+// Same as half::operator float() on 4 values stored in the low 16 bits of each 32-bits lane
+static inline __m128	SSEHalfToFloat( __m128i _H ) {
+	const __m128i	EXPONENT_MASK = _mm_set1_epi32( 0x0F800000 );
+	const __m128i	REBIAS = _mm_set1_epi32( F16_REBIAS );
+
+	__m128i	sign = _mm_slli_epi32( _mm_and_si128( _H, _mm_set1_epi32( 0x8000 ) ), 16 );
+	__m128i	bits = _mm_slli_epi32( _mm_and_si128( _H, _mm_set1_epi32( 0x7FFF ) ), 13 );
+	__m128i	exponent = _mm_and_si128( bits, EXPONENT_MASK );
+	bits = _mm_add_epi32( bits, REBIAS );
+
+	// Infinity or NaN
+	__m128i	infNaN = _mm_cmpeq_epi32( exponent, EXPONENT_MASK );
+	__m128i	NaN = _mm_cmpgt_epi32( _mm_and_si128( _H, _mm_set1_epi32( 0x7FFF ) ), _mm_set1_epi32( 0x7C00 ) );
+	bits = _mm_add_epi32( bits, _mm_and_si128( infNaN, REBIAS ) );
+	bits = _mm_or_si128( bits, _mm_and_si128( NaN, _mm_set1_epi32( 0x00400000 ) ) );
+
+	// Denormal or zero
+	__m128i	denormal = _mm_cmpeq_epi32( exponent, _mm_setzero_si128() );
+	__m128	renormalized = _mm_sub_ps( _mm_castsi128_ps( _mm_add_epi32( bits, _mm_set1_epi32( 0x00800000 ) ) ), _mm_set1_ps( 6.10351563e-05f ) );
+	bits = _mm_or_si128( _mm_andnot_si128( denormal, bits ), _mm_and_si128( denormal, _mm_castps_si128( renormalized ) ) );
+
+	return _mm_castsi128_ps( _mm_or_si128( bits, sign ) );
+}
+
+// Same as half::half( float ) on 4 values, the result is stored in the low 16 bits of each 32-bits lane (sign-extended so it can be packed with _mm_packs_epi32)
+static inline __m128i	SSEFloatToHalf( __m128 _F ) {
+	__m128i	bits = _mm_castps_si128( _F );
+	__m128i	sign = _mm_and_si128( _mm_srli_epi32( bits, 16 ), _mm_set1_epi32( 0x8000 ) );
+	bits = _mm_and_si128( bits, _mm_set1_epi32( 0x7FFFFFFF ) );
+
+	// Infinity, NaN or overflow
+	__m128i	overflow = _mm_cmpgt_epi32( bits, _mm_set1_epi32( F16_OVERFLOW-1 ) );
+	__m128i	NaN = _mm_cmpgt_epi32( bits, _mm_set1_epi32( 0x7F800000 ) );
+	__m128i	resultOverflow = _mm_or_si128( _mm_set1_epi32( 0x7C00 ), _mm_and_si128( NaN, _mm_or_si128( _mm_set1_epi32( 0x0200 ), _mm_and_si128( _mm_srli_epi32( bits, 13 ), _mm_set1_epi32( 0x03FF ) ) ) ) );
+
+	// Denormal or zero
+	__m128i	denormal = _mm_cmplt_epi32( bits, _mm_set1_epi32( F16_DENORMAL ) );
+	__m128i	resultDenormal = _mm_sub_epi32( _mm_castps_si128( _mm_add_ps( _mm_castsi128_ps( bits ), _mm_set1_ps( 0.5f ) ) ), _mm_set1_epi32( F16_DENORMAL_MAGIC ) );
+
+	// Representable value
+	__m128i	mantissaOdd = _mm_and_si128( _mm_srli_epi32( bits, 13 ), _mm_set1_epi32( 1 ) );
+	__m128i	resultNormal = _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( bits, _mm_set1_epi32( int(F16_ROUND) ) ), mantissaOdd ), 13 );
+
+	__m128i	result = _mm_or_si128( _mm_andnot_si128( denormal, resultNormal ), _mm_and_si128( denormal, resultDenormal ) );
+			result = _mm_or_si128( _mm_andnot_si128( overflow, result ), _mm_and_si128( overflow, resultOverflow ) );
+			result = _mm_or_si128( result, sign );
+
+	return _mm_srai_epi32( _mm_slli_epi32( result, 16 ), 16 );
+}
+
+#endif
+
+void	HalfToFloat( const half* _pSource, float* _pTarget, U32 _Count ) {
+#ifdef MATH_USE_F16C
+	#ifdef MATH_DETECT_F16C
+	if ( SupportsF16C() )
+	#endif
+	{
+		HalfToFloatF16C( _pSource, _pTarget, _Count );
+		return;
+	}
+#endif
+
+#ifdef MATH_USE_SSE
+	for ( ; _Count >= 8; _Count-=8, _pSource+=8, _pTarget+=8 ) {
+		__m128i	H = _mm_loadu_si128( (const __m128i*) _pSource );
+		_mm_storeu_ps( _pTarget, SSEHalfToFloat( _mm_unpacklo_epi16( H, _mm_setzero_si128() ) ) );
+		_mm_storeu_ps( _pTarget+4, SSEHalfToFloat( _mm_unpackhi_epi16( H, _mm_setzero_si128() ) ) );
+	}
+#endif
+	for ( ; _Count > 0; _Count--, _pSource++, _pTarget++ )
+		*_pTarget = *_pSource;
+}
+
+void	FloatToHalf( const float* _pSource, half* _pTarget, U32 _Count ) {
+#ifdef MATH_USE_F16C
+	#ifdef MATH_DETECT_F16C
+	if ( SupportsF16C() )
+	#endif
+	{
+		FloatToHalfF16C( _pSource, _pTarget, _Count );
+		return;
+	}
+#endif
+
+#ifdef MATH_USE_SSE
+	for ( ; _Count >= 8; _Count-=8, _pSource+=8, _pTarget+=8 ) {
+		__m128i	H0 = SSEFloatToHalf( _mm_loadu_ps( _pSource ) );
+		__m128i	H1 = SSEFloatToHalf( _mm_loadu_ps( _pSource+4 ) );
+		_mm_storeu_si128( (__m128i*) _pTarget, _mm_packs_epi32( H0, H1 ) );
+	}
+#endif
+	for ( ; _Count > 0; _Count--, _pSource++, _pTarget++ )
+		*_pTarget = *_pSource;
+}
@@ -6,6 +6,18 @@
 
 #include <math.h>
 
+// Hot bfloat4/float4x4 operations and the batched transforms use SSE (and AVX when compiling with /arch:AVX)
+// Define MATH_SCALAR to fall back to the plain scalar implementations (e.g. to validate the SIMD code paths)
+//#define MATH_SCALAR
+#if !defined(MATH_SCALAR) && (defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__))
+	#define MATH_USE_SSE
+	#include <emmintrin.h>
+	#if defined(__AVX__)
+		#define MATH_USE_AVX
+		#include <immintrin.h>
+	#endif
+#endif
+
 //namespace BaseLib {
 
 static const float			PI = 3.1415926535897932384626433832795f;			// ??
@@ -34,6 +46,10 @@ template<class T> inline T	SQR( const T& a )								{ return a * a;  }
 static bool					ALMOST( float a, float b, float _eps=ALMOST_EPSILON )		{ return fabs( a - b ) < _eps; }
 static bool					ALMOST( double a, double b, double _eps=ALMOST_EPSILON )	{ return fabs( a - b ) < _eps; }
 
+#ifdef MATH_USE_SSE
+static inline float			SSEHorizontalSum( __m128 v )					{ __m128 s = _mm_add_ps( v, _mm_movehl_ps( v, v ) ); return _mm_cvtss_f32( _mm_add_ss( s, _mm_shuffle_ps( s, s, _MM_SHUFFLE( 1, 1, 1, 1 ) ) ) ); }
+#endif
+
 //static inline bool		ISINFINITE( float a )							{ return _finitef( a ) != 0; }
 //static inline bool		ISNAN( float a )								{ return _isnanf( a ) != 0; }
 //static inline bool		ISVALID( float a )								{ return !ISNAN( a ) && !ISINFINITE( a ); }
@@ -175,19 +191,31 @@ public:
 	void		Set( const bfloat2& _xy, float _z, float _w )	{ x = _xy.x; y = _xy.y; z = _z; w = _w; }
 	void		Set( const bfloat3& _xyz, float _w )			{ x = _xyz.x; y = _xyz.y; z = _xyz.z; w = _w; }
 
-	float		LengthSq() const						{ return x*x + y*y + z*z + w*w; }
-	float		Length() const							{ return sqrtf( x*x + y*y + z*z + w*w ); }
-	bfloat4&	Normalize()								{ float InvL = 1.0f / Length(); x *= InvL; y *= InvL; z *= InvL; w *= InvL; return *this; }
+	float		Length() const							{ return sqrtf( LengthSq() ); }
+	bfloat4&	Normalize()								{ *this *= 1.0f / Length(); return *this; }
 
-	bfloat4		Lerp( const bfloat4& b, float t ) const	{ float r = 1.0f - t; return bfloat4( x * r + b.x * t, y * r + b.y * t, z * r + b.z * t, w * r + b.w * t ); }
-	bfloat4		Min( const bfloat4& b ) const			{ return bfloat4( MIN( x, b.x ), MIN( y, b.y ), MIN( z, b.z ), MIN( w, b.w ) ); }
-	bfloat4		Max( const bfloat4& b ) const			{ return bfloat4( MAX( x, b.x ), MAX( y, b.y ), MAX( z, b.z ), MAX( w, b.w ) ); }
 	float		Min() const								{ return MIN( MIN( MIN( x, y ), z), w ); }
 	float		Max() const								{ return MAX( MAX( MAX( x, y ), z), w ); }
 	bool		Almost( const bfloat4& b ) const		{ return ALMOST( x, b.x ) && ALMOST( y, b.y ) && ALMOST( z, b.z ) && ALMOST( w, b.w ); }
 	bool		Almost( const bfloat4& b, float _eps ) const	{ return ALMOST( x, b.x, _eps ) && ALMOST( y, b.y, _eps ) && ALMOST( z, b.z, _eps ) && ALMOST( w, b.w, _eps ); }
 
+#ifdef MATH_USE_SSE
+	__m128		Load() const							{ return _mm_loadu_ps( &x ); }
+	static bfloat4	Store( __m128 v )					{ bfloat4 R; _mm_storeu_ps( &R.x, v ); return R; }
+
+	float		LengthSq() const						{ __m128 v = Load(); return SSEHorizontalSum( _mm_mul_ps( v, v ) ); }
+	float		Dot( const bfloat4& b ) const			{ return SSEHorizontalSum( _mm_mul_ps( Load(), b.Load() ) ); }
+	bfloat4		Lerp( const bfloat4& b, float t ) const	{ __m128 a = Load(); return Store( _mm_add_ps( a, _mm_mul_ps( _mm_sub_ps( b.Load(), a ), _mm_set1_ps( t ) ) ) ); }
+	bfloat4		Min( const bfloat4& b ) const			{ return Store( _mm_min_ps( Load(), b.Load() ) ); }
+	bfloat4		Max( const bfloat4& b ) const			{ return Store( _mm_max_ps( Load(), b.Load() ) ); }
+#else
+	float		LengthSq() const						{ return x*x + y*y + z*z + w*w; }
 	float		Dot( const bfloat4& b ) const			{ return x*b.x + y*b.y + z*b.z + w*b.w; }
+	bfloat4		Lerp( const bfloat4& b, float t ) const	{ float r = 1.0f - t; return bfloat4( x * r + b.x * t, y * r + b.y * t, z * r + b.z * t, w * r + b.w * t ); }
+	bfloat4		Min( const bfloat4& b ) const			{ return bfloat4( MIN( x, b.x ), MIN( y, b.y ), MIN( z, b.z ), MIN( w, b.w ) ); }
+	bfloat4		Max( const bfloat4& b ) const			{ return bfloat4( MAX( x, b.x ), MAX( y, b.y ), MAX( z, b.z ), MAX( w, b.w ) ); }
+#endif
+	bfloat4		Cross( const bfloat4& v ) const			{ return bfloat4( y*v.z - z*v.y, v.x*z - v.z*x, x*v.y - y*v.x, 0.0f ); }	// 3D cross product of the xyz components, w is 0
 
 	float&		operator[]( int _index )				{ return (&x)[_index&3]; }
 	const float&operator[]( int _index ) const			{ return (&x)[_index&3]; }
@@ -195,12 +223,21 @@ public:
 				operator bfloat2() const				{ return bfloat2( x, y ); }
 				operator bfloat3() const				{ return bfloat3( x, y, z ); }
 	bfloat4		operator-()								{ return bfloat4( -x, -y, -z, -w ); }
+#ifdef MATH_USE_SSE
+	bfloat4		operator-( const bfloat4& v ) const		{ return Store( _mm_sub_ps( Load(), v.Load() ) ); }
+	bfloat4		operator+( const bfloat4& v ) const		{ return Store( _mm_add_ps( Load(), v.Load() ) ); }
+	bfloat4		operator*( const bfloat4& v ) const		{ return Store( _mm_mul_ps( Load(), v.Load() ) ); }
+	bfloat4		operator*( float v ) const				{ return Store( _mm_mul_ps( Load(), _mm_set1_ps( v ) ) ); }
+	bfloat4		operator/( float v ) const				{ return Store( _mm_div_ps( Load(), _mm_set1_ps( v ) ) ); }
+	bfloat4		operator/( const bfloat4& v ) const		{ return Store( _mm_div_ps( Load(), v.Load() ) ); }
+#else
 	bfloat4		operator-( const bfloat4& v ) const		{ return bfloat4( x-v.x, y-v.y, z-v.z, w-v.w ); }
 	bfloat4		operator+( const bfloat4& v ) const		{ return bfloat4( x+v.x, y+v.y, z+v.z, w+v.w ); }
 	bfloat4		operator*( const bfloat4& v ) const		{ return bfloat4( x*v.x, y*v.y, z*v.z, w*v.w ); }
 	bfloat4		operator*( float v ) const				{ return bfloat4( x * v, y * v, z * v, w * v ); }
 	bfloat4		operator/( float v ) const				{ return bfloat4( x / v, y / v, z / v, w / v ); }
 	bfloat4		operator/( const bfloat4& v ) const		{ return bfloat4( x / v.x, y / v.y, z / v.z, w / v.w ); }
+#endif
 
 	bfloat4&	operator-=( const bfloat4& v )			{ *this = *this - v; return *this; }
 	bfloat4&	operator+=( const bfloat4& v )			{ *this = *this + v; return *this; }
@@ -219,7 +256,7 @@ public:
 	static const bfloat4	UnitW;
 };
 
-static bfloat4   operator*( float a, const bfloat4& b )	{ return bfloat4( a*b.x, a*b.y, a*b.z, a*b.w ); }
+static bfloat4   operator*( float a, const bfloat4& b )	{ return b * a; }
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -393,9 +430,21 @@ float4x4	operator*( float a, const float4x4& b );
 bfloat4		operator*( const bfloat4& a, const float4x4& b );
 bfloat4		operator*( const float4x4& b, const bfloat4& a );
 
+// Batched transforms of arrays using the row-vector convention (i.e. v * M, as bfloat4 * float4x4)
+//	. Positions are transformed as points (w=1), vectors only use the upper 3x3 part of the matrix (w=0)
+//	. Normals and tangents are transformed as vectors and renormalized (normals should be transformed by the inverse transpose if the matrix contains non-uniform scaling)
+//	. Strides are in bytes so the arrays can be fields of interleaved vertices, source and target arrays can be the same
+void		TransformPositions( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride=sizeof(bfloat3), U32 _TargetStride=sizeof(bfloat3) );
+void		TransformPositions( const float4x4& _Transform, const bfloat3* _pSource, bfloat4* _pTarget, U32 _Count, U32 _SourceStride=sizeof(bfloat3), U32 _TargetStride=sizeof(bfloat4) );	// Outputs homogeneous positions (e.g. for projection matrices)
+void		TransformVectors( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride=sizeof(bfloat3), U32 _TargetStride=sizeof(bfloat3) );
+void		TransformNormals( const float4x4& _Transform, const bfloat3* _pSource, bfloat3* _pTarget, U32 _Count, U32 _SourceStride=sizeof(bfloat3), U32 _TargetStride=sizeof(bfloat3) );
+void		TransformTangents( const float4x4& _Transform, const bfloat4* _pSource, bfloat4* _pTarget, U32 _Count, U32 _SourceStride=sizeof(bfloat4), U32 _TargetStride=sizeof(bfloat4) );	// The w component (bitangent sign) is copied as is
+void		Transform( const float4x4& _Transform, const bfloat4* _pSource, bfloat4* _pTarget, U32 _Count );
+
 
 //////////////////////////////////////////////////////////////////////////
 // Float16
+// Conversions round to nearest even and support denormals, NaNs and infinities, so they yield the exact same results as the F16C instructions
 class   half {
 public:
 	static const U16	SMALLEST_UINT = 0x0400;
@@ -470,4 +519,9 @@ public:
 	operator bfloat4()	{ return bfloat4( x, y, z, w ); }
 };
 
+// Batched conversions, use these when converting entire scanlines or images
+// They use the F16C instructions when available (either compiling with /arch:AVX2 or, with MSVC, if the CPU supports them) and SSE2 otherwise
+void		HalfToFloat( const half* _pSource, float* _pTarget, U32 _Count );
+void		FloatToHalf( const float* _pSource, half* _pTarget, U32 _Count );
+
 //}	// namespace BaseLib
\ No newline at end of file
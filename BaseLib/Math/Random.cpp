@@ -1,22 +1,36 @@
-#include "../Types.h"
+#include "../Types.h"
+
+#if defined(_MSC_VER)
+	#define RAND_THREAD_LOCAL	__declspec(thread)
+#else
+	#define RAND_THREAD_LOCAL	__thread
+#endif
 
 // These values are not magical, just the default values Marsaglia used.
 // Any pair of unsigned integers should be fine.
-static U32	gs_w = RAND_DEFAULT_SEED_U;
-static U32	gs_z = RAND_DEFAULT_SEED_V;
+// The state is local to each thread so concurrent calls don't corrupt each other
+static RAND_THREAD_LOCAL U32	gs_w = RAND_DEFAULT_SEED_U;
+static RAND_THREAD_LOCAL U32	gs_z = RAND_DEFAULT_SEED_V;
+
+#define RAND_SEED_STACK_SIZE	8
 
-static U32	gs_SeedPushW = 0;
-static U32	gs_SeedPushZ = 0;
+static RAND_THREAD_LOCAL U32	gs_SeedStackW[RAND_SEED_STACK_SIZE];
+static RAND_THREAD_LOCAL U32	gs_SeedStackZ[RAND_SEED_STACK_SIZE];
+static RAND_THREAD_LOCAL U32	gs_SeedStackSize = 0;
 
 void	_randpushseed()
 {
-	gs_SeedPushW = gs_w;
-	gs_SeedPushZ = gs_z;
+	ASSERT( gs_SeedStackSize < RAND_SEED_STACK_SIZE, "Seed stack overflow!" );
+	gs_SeedStackW[gs_SeedStackSize] = gs_w;
+	gs_SeedStackZ[gs_SeedStackSize] = gs_z;
+	gs_SeedStackSize++;
 }
 void	_randpopseed()
 {
-	gs_w = gs_SeedPushW;
-	gs_z = gs_SeedPushZ;
+	ASSERT( gs_SeedStackSize > 0, "Seed stack underflow!" );
+	gs_SeedStackSize--;
+	gs_w = gs_SeedStackW[gs_SeedStackSize];
+	gs_z = gs_SeedStackZ[gs_SeedStackSize];
 }
 
 // This is the heart of the generator.
@@ -84,3 +98,141 @@ float	_randGauss()
 	float	theta = 2.0f * PI * u2;
 	return r * sinf(theta);
 }
+
+
+//////////////////////////////////////////////////////////////////////////
+// PCG32
+//
+using namespace BaseLib;
+
+void	PCG32::Seed( U64 _seed, U64 _stream ) {
+	m_state = 0;
+	m_increment = (_stream << 1) | 1;
+	Next();
+	m_state += _seed;
+	Next();
+}
+
+// From "Random Number Generation with Arbitrary Strides", F. Brown, Transactions of the American Nuclear Society (1994)
+void	PCG32::Advance( U64 _delta ) {
+	U64	multiplier = 6364136223846793005ULL;
+	U64	increment = m_increment;
+	U64	accumulatedMultiplier = 1;
+	U64	accumulatedIncrement = 0;
+	while ( _delta > 0 ) {
+		if ( _delta & 1 ) {
+			accumulatedMultiplier *= multiplier;
+			accumulatedIncrement = accumulatedIncrement * multiplier + increment;
+		}
+		increment *= multiplier + 1;
+		multiplier *= multiplier;
+		_delta >>= 1;
+	}
+	m_state = accumulatedMultiplier * m_state + accumulatedIncrement;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Xoshiro128**
+//
+void	Xoshiro128::Seed( U64 _seed ) {
+	// SplitMix64 makes sure the state is never all zeroes and that close seeds give very different states
+	for ( U32 i=0; i < 2; i++ ) {
+		U64	z = (_seed += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		z ^= z >> 31;
+		m_state[2*i+0] = U32( z );
+		m_state[2*i+1] = U32( z >> 32 );
+	}
+}
+
+void	Xoshiro128::Jump() {
+	static const U32	JUMP[4] = { 0x8764000B, 0xF542D2D3, 0x6FA035C3, 0x77F2DB5B };
+
+	U32	s[4] = { 0, 0, 0, 0 };
+	for ( U32 i=0; i < 4; i++ ) {
+		for ( U32 b=0; b < 32; b++ ) {
+			if ( JUMP[i] & (1U << b) ) {
+				s[0] ^= m_state[0];
+				s[1] ^= m_state[1];
+				s[2] ^= m_state[2];
+				s[3] ^= m_state[3];
+			}
+			Next();
+		}
+	}
+	m_state[0] = s[0];
+	m_state[1] = s[1];
+	m_state[2] = s[2];
+	m_state[3] = s[3];
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Sobol
+//
+// Direction numbers of the first 5 dimensions, from Joe & Kuo (http://web.maths.unsw.edu.au/~fkuo/sobol/)
+static const U32	gs_SobolDirections[Sobol::DIMENSIONS_COUNT][32] = {
+	{	0x80000000, 0x40000000, 0x20000000, 0x10000000, 0x08000000, 0x04000000, 0x02000000, 0x01000000, 0x00800000, 0x00400000, 0x00200000, 0x00100000, 0x00080000, 0x00040000, 0x00020000, 0x00010000,
+		0x00008000, 0x00004000, 0x00002000, 0x00001000, 0x00000800, 0x00000400, 0x00000200, 0x00000100, 0x00000080, 0x00000040, 0x00000020, 0x00000010, 0x00000008, 0x00000004, 0x00000002, 0x00000001 },
+	{	0x80000000, 0xC0000000, 0xA0000000, 0xF0000000, 0x88000000, 0xCC000000, 0xAA000000, 0xFF000000, 0x80800000, 0xC0C00000, 0xA0A00000, 0xF0F00000, 0x88880000, 0xCCCC0000, 0xAAAA0000, 0xFFFF0000,
+		0x80008000, 0xC000C000, 0xA000A000, 0xF000F000, 0x88008800, 0xCC00CC00, 0xAA00AA00, 0xFF00FF00, 0x80808080, 0xC0C0C0C0, 0xA0A0A0A0, 0xF0F0F0F0, 0x88888888, 0xCCCCCCCC, 0xAAAAAAAA, 0xFFFFFFFF },
+	{	0x80000000, 0xC0000000, 0x60000000, 0x90000000, 0xE8000000, 0x5C000000, 0x8E000000, 0xC5000000, 0x68800000, 0x9CC00000, 0xEE600000, 0x55900000, 0x80680000, 0xC09C0000, 0x60EE0000, 0x90550000,
+		0xE8808000, 0x5CC0C000, 0x8E606000, 0xC5909000, 0x6868E800, 0x9C9C5C00, 0xEEEE8E00, 0x5555C500, 0x8000E880, 0xC0005CC0, 0x60008E60, 0x9000C590, 0xE8006868, 0x5C009C9C, 0x8E00EEEE, 0xC5005555 },
+	{	0x80000000, 0xC0000000, 0x20000000, 0x50000000, 0xF8000000, 0x74000000, 0xA2000000, 0x93000000, 0xD8800000, 0x25400000, 0x59E00000, 0xE6D00000, 0x78080000, 0xB40C0000, 0x82020000, 0xC3050000,
+		0x208F8000, 0x51474000, 0xFBEA2000, 0x75D93000, 0xA0858800, 0x914E5400, 0xDBE79E00, 0x25DB6D00, 0x58800080, 0xE54000C0, 0x79E00020, 0xB6D00050, 0x800800F8, 0xC00C0074, 0x200200A2, 0x50050093 },
+	{	0x80000000, 0x40000000, 0x20000000, 0xB0000000, 0xF8000000, 0xDC000000, 0x7A000000, 0x9D000000, 0x5A800000, 0x2FC00000, 0xA1600000, 0xF0B00000, 0xDA880000, 0x6FC40000, 0x81620000, 0x40BB0000,
+		0x22878000, 0xB3C9C000, 0xFB65A000, 0xDDB2D000, 0x78022800, 0x9C0B3C00, 0x5A0FB600, 0x2D0DDB00, 0xA2878080, 0xF3C9C040, 0xDB65A020, 0x6DB2D0B0, 0x800228F8, 0x400B3CDC, 0x200FB67A, 0xB00DDB9D },
+};
+
+U32	Sobol::SampleU32( U32 _index, U32 _dimension ) {
+	ASSERT( _dimension < DIMENSIONS_COUNT, "Sobol dimension out of range!" );
+	if ( _dimension == 0 )
+		return ReverseBits( _index );	// Van der Corput
+
+	const U32*	directions = gs_SobolDirections[_dimension];
+	U32	result = 0;
+	for ( ; _index != 0; _index >>= 1, directions++ )
+		result ^= *directions & (0U - (_index & 1));	// Branchless since scrambled indices have random bits
+	return result;
+}
+
+U32	Sobol::OwenScrambledU32( U32 _index, U32 _dimension, U32 _seed ) {
+	U32	shuffledIndex = NestedUniformScramble( _index, Hash( _seed ) );
+	return NestedUniformScramble( SampleU32( shuffledIndex, _dimension ), HashCombine( _seed, Hash( _dimension ) ) );
+}
+
+bfloat2	Sobol::OwenScrambled2D( U32 _index, U32 _seed ) {
+	U32	shuffledIndex = NestedUniformScramble( _index, Hash( _seed ) );
+	U32	x = NestedUniformScramble( SampleU32( shuffledIndex, 0 ), HashCombine( _seed, Hash( 0 ) ) );
+	U32	y = NestedUniformScramble( SampleU32( shuffledIndex, 1 ), HashCombine( _seed, Hash( 1 ) ) );
+	return bfloat2( ToFloat( x ), ToFloat( y ) );
+}
+
+// Scrambling the reversed bits with a Laine-Karras style permutation flips each bit depending on all the bits above it
+U32	Sobol::NestedUniformScramble( U32 _value, U32 _seed ) {
+	U32	x = ReverseBits( _value );
+	x += _seed;
+	x ^= x * 0x6C50B47C;
+	x ^= x * 0xB82F1E52;
+	x ^= x * 0xC7AFE638;
+	x ^= x * 0x8D22F6E6;
+	return ReverseBits( x );
+}
+
+U32	Sobol::Hash( U32 _value ) {
+	_value ^= _value >> 16;
+	_value *= 0x21F0AAAD;
+	_value ^= _value >> 15;
+	_value *= 0x735A2D97;
+	_value ^= _value >> 15;
+	return _value;
+}
+
+U32	Sobol::ReverseBits( U32 _value ) {
+	_value = (_value << 16) | (_value >> 16);
+	_value = ((_value & 0x00FF00FFU) << 8) | ((_value & 0xFF00FF00U) >> 8);
+	_value = ((_value & 0x0F0F0F0FU) << 4) | ((_value & 0xF0F0F0F0U) >> 4);
+	_value = ((_value & 0x33333333U) << 2) | ((_value & 0xCCCCCCCCU) >> 2);
+	_value = ((_value & 0x55555555U) << 1) | ((_value & 0xAAAAAAAAU) >> 1);
+	return _value;
+}
@@ -14,6 +14,8 @@
 #define RAND_DEFAULT_SEED_U	521288629
 #define RAND_DEFAULT_SEED_V	362436069
 
+// NOTE: The state of these functions is local to each thread and every thread starts with the default seed.
+// Prefer the generator objects below when the results must not depend on the amount of threads.
 void	_srand( U32 u, U32 v );
 void	_randpushseed();
 void	_randpopseed();
@@ -26,15 +28,149 @@ U32		_rand( U32 size );				// [0,size[
 float	_randGauss();
 
 
-//////////////////////////////////////////////////////////////////////////
-// bmayaux (2015-02-24) Hammersley sequence generator
-//
 namespace BaseLib {
+
+	//////////////////////////////////////////////////////////////////////////
+	// Random number generator objects
+	//
+	// Each generator owns its state so several threads can draw numbers from their own generator at the same time.
+	// To keep a parallel computation deterministic whatever the amount of threads, give each work item its own
+	//	independent stream (e.g. PCG32( seed, itemIndex )) or jump the generator ahead to the item's first number
+	//	instead of sharing a generator between the work items of a thread.
+	//
+	// Common methods, ENGINE only needs to implement "U32 Next()"
+	template< typename ENGINE > class RandomGenerator {
+	public:
+		// [0,1[ with 24 bits of precision
+		float	NextFloat()										{ return (Engine().Next() >> 8) * (1.0f / 16777216.0f); }
+		// [min,max[
+		float	NextFloat( float _min, float _max )				{ return _min + (_max - _min) * NextFloat(); }
+		// [0,bound[ without the bias of a modulo (Lemire's method)
+		U32		NextBounded( U32 _bound ) {
+			U64	m = U64( Engine().Next() ) * _bound;
+			if ( U32(m) < _bound ) {
+				U32	threshold = (0U - _bound) % _bound;
+				while ( U32(m) < threshold )
+					m = U64( Engine().Next() ) * _bound;
+			}
+			return U32( m >> 32 );
+		}
+		// Normal (Gaussian) distribution with mean 0 and standard deviation 1 (Box-Muller)
+		float	NextGauss() {
+			float	u1 = 1.0f - NextFloat();	// ]0,1]
+			float	u2 = NextFloat();
+			return sqrtf( -2.0f * logf( u1 ) ) * sinf( TWOPI * u2 );
+		}
+
+		// Batch fills
+		void	Fill( U32* _values, U32 _count )				{ ENGINE& E = Engine(); for ( ; _count > 0; _count--, _values++ ) *_values = E.Next(); }
+		void	Fill( float* _values, U32 _count )				{ for ( ; _count > 0; _count--, _values++ ) *_values = NextFloat(); }
+		void	Fill( float* _values, U32 _count, float _min, float _max )	{ for ( ; _count > 0; _count--, _values++ ) *_values = NextFloat( _min, _max ); }
+		void	Fill( bfloat2* _values, U32 _count )			{ for ( ; _count > 0; _count--, _values++ ) { _values->x = NextFloat(); _values->y = NextFloat(); } }
+
+	private:
+		ENGINE&	Engine()	{ return *static_cast< ENGINE* >( this ); }
+	};
+
+	// PCG32 (XSH RR variant) by Melissa O'Neill, see http://www.pcg-random.org
+	// 2^63 independent streams of period 2^64, with fast jump-ahead
+	class PCG32 : public RandomGenerator< PCG32 > {
+	private:
+		U64		m_state;
+		U64		m_increment;	// Selects the stream, always odd
+
+	public:
+		PCG32( U64 _seed=0x853C49E6748FEA9BULL, U64 _stream=0xDA3E39CB94B95BDBULL )	{ Seed( _seed, _stream ); }
+
+		void	Seed( U64 _seed, U64 _stream=0xDA3E39CB94B95BDBULL );
+
+		U32		Next() {
+			U64	old = m_state;
+			m_state = old * 6364136223846793005ULL + m_increment;
+			U32	xorShifted = U32( ((old >> 18) ^ old) >> 27 );
+			U32	rotation = U32( old >> 59 );
+			return (xorShifted >> rotation) | (xorShifted << ((0U - rotation) & 31));
+		}
+
+		// Skips _delta numbers in O(log(_delta))
+		void	Advance( U64 _delta );
+	};
+
+	// Xoshiro128** by David Blackman and Sebastiano Vigna, see http://prng.di.unimi.it
+	// Period 2^128-1, Jump() is equivalent to 2^64 calls to Next() so it can be used to generate 2^64 non-overlapping sub-sequences
+	class Xoshiro128 : public RandomGenerator< Xoshiro128 > {
+	private:
+		U32		m_state[4];
+
+	public:
+		Xoshiro128( U64 _seed=0x853C49E6748FEA9BULL )	{ Seed( _seed ); }
+
+		void	Seed( U64 _seed );		// The 128-bits state is initialized from the seed using SplitMix64
+
+		U32		Next() {
+			U32	result = Rotate( m_state[1] * 5, 7 ) * 9;
+			U32	t = m_state[1] << 9;
+			m_state[2] ^= m_state[0];
+			m_state[3] ^= m_state[1];
+			m_state[1] ^= m_state[2];
+			m_state[0] ^= m_state[3];
+			m_state[2] ^= t;
+			m_state[3] = Rotate( m_state[3], 11 );
+			return result;
+		}
+
+		void	Jump();
+
+	private:
+		static U32	Rotate( U32 _x, int _k )	{ return (_x << _k) | (_x >> (32 - _k)); }
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// Sobol low-discrepancy sequence, evaluated on the fly for any sample index (no precomputed sequence needed)
+	//
+	// The Owen-scrambled version uses the hash-based nested uniform scrambling and shuffling from Burley 2020 "Practical Hash-based Owen Scrambling"
+	//	(http://www.jcgt.org/published/0009/04/01/): each seed gives a different, well stratified sequence and any prefix of the sequence is well distributed,
+	//	which makes it a good fit for progressive or per-pixel sampling where each pixel uses its own seed.
+	//
+	class Sobol {
+	public:
+		static const U32	DIMENSIONS_COUNT = 5;	// Use different seeds to get more dimensions (i.e. padding with independent 4D sequences)
+
+	public:
+		// Unscrambled sample
+		static U32		SampleU32( U32 _index, U32 _dimension );
+		static float	Sample( U32 _index, U32 _dimension )							{ return ToFloat( SampleU32( _index, _dimension ) ); }
+
+		// Shuffled and Owen-scrambled sample (the shuffle only depends on the seed so all the dimensions of a sample stay consistent)
+		static U32		OwenScrambledU32( U32 _index, U32 _dimension, U32 _seed );
+		static float	OwenScrambled( U32 _index, U32 _dimension, U32 _seed )			{ return ToFloat( OwenScrambledU32( _index, _dimension, _seed ) ); }
+		static bfloat2	OwenScrambled2D( U32 _index, U32 _seed );
+
+		// Base-2 nested uniform scrambling of a [0,2^32[ value
+		static U32		NestedUniformScramble( U32 _value, U32 _seed );
+
+		static U32		Hash( U32 _value );
+		static U32		HashCombine( U32 _seed, U32 _value )							{ return _seed ^ (_value + (_seed << 6) + (_seed >> 2)); }
+		static U32		ReverseBits( U32 _value );
+
+	private:
+		static float	ToFloat( U32 _value )											{ return (_value >> 8) * (1.0f / 16777216.0f); }	// [0,1[
+	};
+
+
+	//////////////////////////////////////////////////////////////////////////
+	// bmayaux (2015-02-24) Hammersley sequence generator
+	//
 	class Hammersley {
 	public:
 
 		Hammersley() : m_step( 1 ) {}
 
+		// Returns the point _index of a 2D sequence of _count points, without building the sequence
+		static bfloat2	Sample( U32 _index, U32 _count ) {
+			return bfloat2( (0.5f + _index) / _count, ReverseBits( _index ) );
+		}
+
 		// Fast build a 2D sequence of points
 		static void	BuildSequence( U32 _count, List< bfloat2 >& _sequence ) {
 			float	rcpCount = 1.0f / _count;
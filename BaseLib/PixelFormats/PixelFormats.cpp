@@ -33,6 +33,50 @@ PF_D16::desc_t			PF_D16::Descriptor;
 PF_D24S8::desc_t		PF_D24S8::Descriptor;
 PF_D32::desc_t			PF_D32::Descriptor;
 
+//////////////////////////////////////////////////////////////////////////
+// Half floats scanlines are converted by chunks through a small buffer so the batched half <=> float conversions can be used
+//
+static const U32	HALF_CHUNK_SIZE = 256;	// Amount of pixels converted at once
+
+void	IPixelAccessor::HalfToRGBA( const half* _source, U32 _componentsCount, bfloat4* _colors, U32 _count ) {
+	float	temp[4*HALF_CHUNK_SIZE];
+	while ( _count > 0 ) {
+		U32	count = MIN( _count, U32(HALF_CHUNK_SIZE) );
+		HalfToFloat( _source, temp, _componentsCount * count );
+
+		const float*	value = temp;
+		switch ( _componentsCount ) {
+		case 1: for ( U32 i=0; i < count; i++, value++ )	_colors[i].Set( value[0], value[0], value[0], 1 ); break;	// Grayscale, like PF_R16F::RGBA()
+		case 2: for ( U32 i=0; i < count; i++, value+=2 )	_colors[i].Set( value[0], value[1], 0, 1 ); break;
+		case 3: for ( U32 i=0; i < count; i++, value+=3 )	_colors[i].Set( value[0], value[1], value[2], 1 ); break;
+		case 4: for ( U32 i=0; i < count; i++, value+=4 )	_colors[i].Set( value[0], value[1], value[2], value[3] ); break;
+		}
+
+		_source += _componentsCount * count;
+		_colors += count;
+		_count -= count;
+	}
+}
+
+void	IPixelAccessor::RGBAToHalf( const bfloat4* _colors, half* _target, U32 _componentsCount, U32 _count ) {
+	float	temp[4*HALF_CHUNK_SIZE];
+	while ( _count > 0 ) {
+		U32	count = MIN( _count, U32(HALF_CHUNK_SIZE) );
+
+		float*	value = temp;
+		for ( U32 i=0; i < count; i++ ) {
+			const float*	color = &_colors[i].x;
+			for ( U32 c=0; c < _componentsCount; c++ )
+				*value++ = color[c];
+		}
+		FloatToHalf( temp, _target, _componentsCount * count );
+
+		_target += _componentsCount * count;
+		_colors += count;
+		_count -= count;
+	}
+}
+
 const IPixelAccessor&	BaseLib::PixelFormat2PixelAccessor( PIXEL_FORMAT _pixelFormat ) {
 	switch ( _pixelFormat ) {
 		// 8-bits
@@ -135,8 +135,27 @@ namespace BaseLib {
 		virtual float	Alpha( const void* _pixel ) const abstract;
 		virtual void	RGBA( const void* _pixel, bfloat4& _color ) const abstract;
 
+		// Scanline readers/writers, converting _count contiguous pixels at once
+		// The default implementations simply call RGBA() and Write() for each pixel, formats that can convert faster in batches override them
+		virtual void	ReadScanline( const void* _pixels, bfloat4* _colors, U32 _count ) const {
+			U32			pixelSize = Size();
+			const U8*	pixel = (const U8*) _pixels;
+			for ( ; _count > 0; _count--, pixel += pixelSize, _colors++ )
+				RGBA( pixel, *_colors );
+		}
+		virtual void	WriteScanline( void* _pixels, const bfloat4* _colors, U32 _count ) const {
+			U32			pixelSize = Size();
+			U8*			pixel = (U8*) _pixels;
+			for ( ; _count > 0; _count--, pixel += pixelSize, _colors++ )
+				Write( pixel, *_colors );
+		}
+
 	protected:	// HELPERS
 
+		// Batched conversions of pixels made of _componentsCount half floats to and from colors (a single component is read as grayscale)
+		static void		HalfToRGBA( const half* _source, U32 _componentsCount, bfloat4* _colors, U32 _count );
+		static void		RGBAToHalf( const bfloat4* _colors, half* _target, U32 _componentsCount, U32 _count );
+
 		// Converts a U8 component to a [0,1] float component
 		inline static float		U8toF32( U32 _Component ) {
 			return _Component / 255.0f;
@@ -920,6 +939,9 @@ throw "Decoding is wrong! FIX! Be careful about compiler failing to recompile ch
 			// Here I'm taking the risk of returning a grayscale image... :/
 			void	RGBA( const void* _pixel, bfloat4& _color ) const override	{ float	v = ((PF_R16F*) _pixel)->R; _color.Set( v, v, v, 1 ); }
 
+			void	ReadScanline( const void* _pixels, bfloat4* _colors, U32 _count ) const override	{ HalfToRGBA( (const half*) _pixels, 1, _colors, _count ); }
+			void	WriteScanline( void* _pixels, const bfloat4* _colors, U32 _count ) const override	{ RGBAToHalf( _colors, (half*) _pixels, 1, _count ); }
+
 		} Descriptor;
 		#pragma endregion
 	};
@@ -961,6 +983,9 @@ throw "Decoding is wrong! FIX! Be careful about compiler failing to recompile ch
 			float	Alpha( const void* _pixel ) const override					{ return 1; }
 			void	RGBA( const void* _pixel, bfloat4& _color ) const override	{ _color.Set( ((PF_RG16F*) _pixel)->R, ((PF_RG16F*) _pixel)->G, 0, 1 ); }
 
+			void	ReadScanline( const void* _pixels, bfloat4* _colors, U32 _count ) const override	{ HalfToRGBA( (const half*) _pixels, 2, _colors, _count ); }
+			void	WriteScanline( void* _pixels, const bfloat4* _colors, U32 _count ) const override	{ RGBAToHalf( _colors, (half*) _pixels, 2, _count ); }
+
 		} Descriptor;
 		#pragma endregion
 	};
@@ -1005,6 +1030,9 @@ throw "Decoding is wrong! FIX! Be careful about compiler failing to recompile ch
 			float	Alpha( const void* _pixel ) const override					{ return 1; }
 			void	RGBA( const void* _pixel, bfloat4& _color ) const override	{ _color.Set( ((PF_RGB16F*) _pixel)->R, ((PF_RGB16F*) _pixel)->G, ((PF_RGB16F*) _pixel)->B, 1 ); }
 
+			void	ReadScanline( const void* _pixels, bfloat4* _colors, U32 _count ) const override	{ HalfToRGBA( (const half*) _pixels, 3, _colors, _count ); }
+			void	WriteScanline( void* _pixels, const bfloat4* _colors, U32 _count ) const override	{ RGBAToHalf( _colors, (half*) _pixels, 3, _count ); }
+
 		} Descriptor;
 		#pragma endregion
 	};
@@ -1054,6 +1082,9 @@ throw "Decoding is wrong! FIX! Be careful about compiler failing to recompile ch
 			float	Alpha( const void* _pixel ) const override					{ return ((PF_RGBA16F*) _pixel)->A; }
 			void	RGBA( const void* _pixel, bfloat4& _color ) const override	{ _color.Set( ((PF_RGBA16F*) _pixel)->R, ((PF_RGBA16F*) _pixel)->G, ((PF_RGBA16F*) _pixel)->B, ((PF_RGBA16F*) _pixel)->A ); }
 
+			void	ReadScanline( const void* _pixels, bfloat4* _colors, U32 _count ) const override	{ HalfToFloat( (const half*) _pixels, &_colors->x, 4 * _count ); }
+			void	WriteScanline( void* _pixels, const bfloat4* _colors, U32 _count ) const override	{ FloatToHalf( &_colors->x, (half*) _pixels, 4 * _count ); }
+
 		} Descriptor;
 		#pragma endregion
 	};
@@ -0,0 +1,465 @@
+#include "../Types.h"
+#include "Allocator.h"
+
+#ifndef _WINDOWS_
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif
+
+#if defined(_MSC_VER)
+	#define ALLOCATOR_THREAD_LOCAL	__declspec(thread)
+#else
+	#define ALLOCATOR_THREAD_LOCAL	__thread
+#endif
+
+using namespace BaseLib;
+
+static size_t	AlignUp( size_t _Value, size_t _Alignment )	{ return (_Value + _Alignment-1) & ~(_Alignment-1); }
+
+// Returns the new value
+static size_t	AtomicAdd( size_t& _Value, size_t _Delta ) {
+#ifdef _WIN64
+	return size_t( InterlockedExchangeAdd64( (volatile LONGLONG*) &_Value, LONGLONG(_Delta) ) ) + _Delta;
+#else
+	return size_t( InterlockedExchangeAdd( (volatile LONG*) &_Value, LONG(_Delta) ) ) + _Delta;
+#endif
+}
+
+static void		AtomicMax( size_t& _Value, size_t _Candidate ) {
+	size_t	Current = _Value;
+	while ( _Candidate > Current ) {
+		size_t	Previous = size_t( InterlockedCompareExchangePointer( (void* volatile*) &_Value, (void*) _Candidate, (void*) Current ) );
+		if ( Previous == Current )
+			break;
+		Current = Previous;
+	}
+}
+
+IAllocator&	BaseLib::GetDefaultAllocator() {
+	static HeapAllocator	DefaultAllocator;
+	return DefaultAllocator;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Heap allocator
+//
+// Blocks requiring a larger alignment than the heap's natural alignment are over-allocated and store the original pointer just before the aligned block
+//
+void*	HeapAllocator::Allocate( size_t _Size, size_t _Alignment ) {
+	if ( _Alignment <= MEMORY_ALLOCATION_ALIGNMENT )
+		return HeapAlloc( GetProcessHeap(), 0, _Size );
+
+	U8*	pRawBlock = (U8*) HeapAlloc( GetProcessHeap(), 0, _Size + _Alignment );
+	if ( pRawBlock == NULL )
+		return NULL;
+
+	U8*	pBlock = (U8*) AlignUp( size_t(pRawBlock) + 1, _Alignment );	// Always leaves enough room for the original pointer since _Alignment > MEMORY_ALLOCATION_ALIGNMENT >= sizeof(void*)
+	((void**) pBlock)[-1] = pRawBlock;
+	return pBlock;
+}
+
+void*	HeapAllocator::Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment ) {
+	if ( _pBlock == NULL )
+		return Allocate( _NewSize, _Alignment );
+
+	if ( _Alignment <= MEMORY_ALLOCATION_ALIGNMENT )
+		return HeapReAlloc( GetProcessHeap(), 0, _pBlock, _NewSize );	// The heap can grow the block in place
+
+	void*	pNewBlock = Allocate( _NewSize, _Alignment );
+	if ( pNewBlock == NULL )
+		return NULL;
+	memcpy( pNewBlock, _pBlock, MIN( _OldSize, _NewSize ) );
+	Free( _pBlock, _OldSize, _Alignment );
+	return pNewBlock;
+}
+
+void	HeapAllocator::Free( void* _pBlock, size_t _Size, size_t _Alignment ) {
+	if ( _pBlock == NULL )
+		return;
+
+	if ( _Alignment > MEMORY_ALLOCATION_ALIGNMENT )
+		_pBlock = ((void**) _pBlock)[-1];
+	HeapFree( GetProcessHeap(), 0, _pBlock );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Arena allocator
+//
+ArenaAllocator::ArenaAllocator( size_t _PageSize, IAllocator& _Parent )
+	: m_Parent( _Parent )
+	, m_PageSize( _PageSize )
+	, m_pCurrentPage( NULL )
+	, m_pSparePage( NULL )
+	, m_pLastBlock( NULL )
+	, m_AllocatedSize( 0 )
+{
+}
+
+ArenaAllocator::~ArenaAllocator() {
+	Reset();
+}
+
+void	ArenaAllocator::Reset() {
+	while ( m_pCurrentPage != NULL ) {
+		Page*	pPrevious = m_pCurrentPage->pPrevious;
+		m_Parent.Free( m_pCurrentPage, sizeof(Page) + m_pCurrentPage->Size, sizeof(void*) );
+		m_pCurrentPage = pPrevious;
+	}
+	if ( m_pSparePage != NULL ) {
+		m_Parent.Free( m_pSparePage, sizeof(Page) + m_pSparePage->Size, sizeof(void*) );
+		m_pSparePage = NULL;
+	}
+	m_pLastBlock = NULL;
+	m_AllocatedSize = 0;
+}
+
+ArenaAllocator::Marker	ArenaAllocator::GetMarker() const {
+	Marker	Result;
+	Result.pPage = m_pCurrentPage;
+	Result.Offset = m_pCurrentPage != NULL ? m_pCurrentPage->Offset : 0;
+	Result.AllocatedSize = m_AllocatedSize;
+	return Result;
+}
+
+void	ArenaAllocator::Rewind( const Marker& _Marker ) {
+	while ( m_pCurrentPage != _Marker.pPage ) {
+		ASSERT( m_pCurrentPage != NULL, "Invalid marker! Markers must be rewound in reverse order and can't be used after a Reset()" );
+		Page*	pPrevious = m_pCurrentPage->pPrevious;
+		if ( m_pSparePage == NULL && m_pCurrentPage->Size == m_PageSize ) {
+			m_pSparePage = m_pCurrentPage;
+		} else {
+			m_Parent.Free( m_pCurrentPage, sizeof(Page) + m_pCurrentPage->Size, sizeof(void*) );
+		}
+		m_pCurrentPage = pPrevious;
+	}
+	if ( m_pCurrentPage != NULL ) {
+		ASSERT( _Marker.Offset <= m_pCurrentPage->Offset, "Invalid marker! Markers must be rewound in reverse order" );
+		m_pCurrentPage->Offset = _Marker.Offset;
+	}
+	m_pLastBlock = NULL;
+	m_AllocatedSize = _Marker.AllocatedSize;
+}
+
+void*	ArenaAllocator::Allocate( size_t _Size, size_t _Alignment ) {
+	size_t	Offset = 0;
+	if ( m_pCurrentPage != NULL ) {
+		size_t	PageStart = size_t( m_pCurrentPage + 1 );
+		Offset = AlignUp( PageStart + m_pCurrentPage->Offset, _Alignment ) - PageStart;
+	}
+
+	if ( m_pCurrentPage == NULL || Offset + _Size > m_pCurrentPage->Size ) {
+		// Start a new page (large blocks get their own page)
+		size_t	PageSize = MAX( m_PageSize, _Size + _Alignment );
+		Page*	pPage = NULL;
+		if ( m_pSparePage != NULL && m_pSparePage->Size >= PageSize ) {
+			pPage = m_pSparePage;
+			PageSize = pPage->Size;
+			m_pSparePage = NULL;
+		} else {
+			pPage = (Page*) m_Parent.Allocate( sizeof(Page) + PageSize, sizeof(void*) );
+			if ( pPage == NULL )
+				return NULL;
+		}
+
+		pPage->pPrevious = m_pCurrentPage;
+		pPage->Size = PageSize;
+		pPage->Offset = 0;
+		m_pCurrentPage = pPage;
+
+		size_t	PageStart = size_t( pPage + 1 );
+		Offset = AlignUp( PageStart, _Alignment ) - PageStart;
+	}
+
+	m_pLastBlock = (U8*) (m_pCurrentPage + 1) + Offset;
+	m_pCurrentPage->Offset = Offset + _Size;
+	m_AllocatedSize += _Size;
+
+	return m_pLastBlock;
+}
+
+void*	ArenaAllocator::Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment ) {
+	if ( _pBlock == NULL )
+		return Allocate( _NewSize, _Alignment );
+
+	if ( _pBlock == m_pLastBlock ) {
+		// Try and grow the last block in place
+		size_t	Offset = (U8*) _pBlock - (U8*) (m_pCurrentPage + 1);
+		if ( Offset + _NewSize <= m_pCurrentPage->Size ) {
+			m_pCurrentPage->Offset = Offset + _NewSize;
+			m_AllocatedSize += _NewSize - _OldSize;
+			return _pBlock;
+		}
+	}
+
+	void*	pNewBlock = Allocate( _NewSize, _Alignment );
+	if ( pNewBlock == NULL )
+		return NULL;
+	memcpy( pNewBlock, _pBlock, MIN( _OldSize, _NewSize ) );
+	return pNewBlock;
+}
+
+void	ArenaAllocator::Free( void* _pBlock, size_t _Size, size_t _Alignment ) {
+	if ( _pBlock == NULL || _pBlock != m_pLastBlock )
+		return;	// Memory is only reclaimed on Reset()
+
+	m_pCurrentPage->Offset = (U8*) _pBlock - (U8*) (m_pCurrentPage + 1);
+	m_pLastBlock = NULL;
+	m_AllocatedSize -= _Size;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Pool allocator
+//
+PoolAllocator::PoolAllocator( size_t _BlockSize, U32 _BlocksPerPage, IAllocator& _Parent )
+	: m_Parent( _Parent )
+	, m_BlockSize( AlignUp( MAX( _BlockSize, sizeof(FreeBlock) ), BLOCK_ALIGNMENT ) )
+	, m_BlocksPerPage( MAX( 1U, _BlocksPerPage ) )
+	, m_pPages( NULL )
+	, m_pFreeBlocks( NULL )
+{
+}
+
+PoolAllocator::~PoolAllocator() {
+	size_t	PageSize = BLOCK_ALIGNMENT + m_BlocksPerPage * m_BlockSize;
+	while ( m_pPages != NULL ) {
+		Page*	pNext = m_pPages->pNext;
+		m_Parent.Free( m_pPages, PageSize, BLOCK_ALIGNMENT );
+		m_pPages = pNext;
+	}
+}
+
+void*	PoolAllocator::Allocate( size_t _Size, size_t _Alignment ) {
+	if ( !IsPoolBlock( _Size, _Alignment ) )
+		return m_Parent.Allocate( _Size, _Alignment );
+
+	if ( m_pFreeBlocks == NULL ) {
+		// Allocate a new page and push all its blocks to the free list
+		Page*	pPage = (Page*) m_Parent.Allocate( BLOCK_ALIGNMENT + m_BlocksPerPage * m_BlockSize, BLOCK_ALIGNMENT );
+		if ( pPage == NULL )
+			return NULL;
+		pPage->pNext = m_pPages;
+		m_pPages = pPage;
+
+		U8*	pBlock = (U8*) pPage + BLOCK_ALIGNMENT + (m_BlocksPerPage-1) * m_BlockSize;
+		for ( U32 BlockIndex=0; BlockIndex < m_BlocksPerPage; BlockIndex++, pBlock -= m_BlockSize ) {
+			FreeBlock*	pFreeBlock = (FreeBlock*) pBlock;
+			pFreeBlock->pNext = m_pFreeBlocks;
+			m_pFreeBlocks = pFreeBlock;
+		}
+	}
+
+	FreeBlock*	pBlock = m_pFreeBlocks;
+	m_pFreeBlocks = pBlock->pNext;
+	return pBlock;
+}
+
+void*	PoolAllocator::Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment ) {
+	if ( _pBlock == NULL )
+		return Allocate( _NewSize, _Alignment );
+
+	bool	OldIsPoolBlock = IsPoolBlock( _OldSize, _Alignment );
+	bool	NewIsPoolBlock = IsPoolBlock( _NewSize, _Alignment );
+	if ( OldIsPoolBlock && NewIsPoolBlock )
+		return _pBlock;	// Still fits
+	if ( !OldIsPoolBlock && !NewIsPoolBlock )
+		return m_Parent.Reallocate( _pBlock, _OldSize, _NewSize, _Alignment );
+
+	void*	pNewBlock = Allocate( _NewSize, _Alignment );
+	if ( pNewBlock == NULL )
+		return NULL;
+	memcpy( pNewBlock, _pBlock, MIN( _OldSize, _NewSize ) );
+	Free( _pBlock, _OldSize, _Alignment );
+	return pNewBlock;
+}
+
+void	PoolAllocator::Free( void* _pBlock, size_t _Size, size_t _Alignment ) {
+	if ( _pBlock == NULL )
+		return;
+	if ( !IsPoolBlock( _Size, _Alignment ) ) {
+		m_Parent.Free( _pBlock, _Size, _Alignment );
+		return;
+	}
+
+	FreeBlock*	pFreeBlock = (FreeBlock*) _pBlock;
+	pFreeBlock->pNext = m_pFreeBlocks;
+	m_pFreeBlocks = pFreeBlock;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Large blocks allocator
+//
+static const SYSTEM_INFO&	GetCachedSystemInfo() {
+	static SYSTEM_INFO	Info;
+	static bool			Initialized = false;
+	if ( !Initialized ) {
+		GetSystemInfo( &Info );
+		Initialized = true;
+	}
+	return Info;
+}
+
+size_t	LargeBlockAllocator::GetPageSize() {
+	return GetCachedSystemInfo().dwPageSize;
+}
+
+size_t	LargeBlockAllocator::GetAllocationGranularity() {
+	return GetCachedSystemInfo().dwAllocationGranularity;
+}
+
+IAllocator&	BaseLib::GetLargeBlockAllocator() {
+	static LargeBlockAllocator	DefaultAllocator;
+	return DefaultAllocator;
+}
+
+void*	LargeBlockAllocator::Allocate( size_t _Size, size_t _Alignment ) {
+	if ( _Alignment <= GetAllocationGranularity() )
+		return VirtualAlloc( NULL, _Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+
+	// Find an aligned address by reserving a larger range, then allocate exactly at that address
+	// Another thread may grab the range in the meantime so we may have to try again
+	for ( U32 Attempt=0; Attempt < 16; Attempt++ ) {
+		U8*	pRange = (U8*) VirtualAlloc( NULL, _Size + _Alignment, MEM_RESERVE, PAGE_NOACCESS );
+		if ( pRange == NULL )
+			return NULL;
+		VirtualFree( pRange, 0, MEM_RELEASE );
+
+		void*	pBlock = VirtualAlloc( (void*) AlignUp( size_t(pRange), _Alignment ), _Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+		if ( pBlock != NULL )
+			return pBlock;
+	}
+	return NULL;
+}
+
+void*	LargeBlockAllocator::Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment ) {
+	if ( _pBlock == NULL )
+		return Allocate( _NewSize, _Alignment );
+	if ( _NewSize <= AlignUp( _OldSize, GetPageSize() ) )
+		return _pBlock;	// Still fits in the committed pages
+
+	void*	pNewBlock = Allocate( _NewSize, _Alignment );
+	if ( pNewBlock == NULL )
+		return NULL;
+	memcpy( pNewBlock, _pBlock, _OldSize );
+	Free( _pBlock, _OldSize, _Alignment );
+	return pNewBlock;
+}
+
+void	LargeBlockAllocator::Free( void* _pBlock, size_t _Size, size_t _Alignment ) {
+	if ( _pBlock != NULL )
+		VirtualFree( _pBlock, 0, MEM_RELEASE );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Thread arenas
+//
+static const size_t						THREAD_ARENA_PAGE_SIZE = 256 * 1024;
+static ALLOCATOR_THREAD_LOCAL ArenaAllocator*	gs_pThreadArena = NULL;
+
+ArenaAllocator&	BaseLib::GetThreadArena() {
+	if ( gs_pThreadArena == NULL )
+		gs_pThreadArena = new ArenaAllocator( THREAD_ARENA_PAGE_SIZE );
+	return *gs_pThreadArena;
+}
+
+void	BaseLib::ReleaseThreadArena() {
+	delete gs_pThreadArena;
+	gs_pThreadArena = NULL;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Tracking allocator
+//
+static TrackingAllocator*	gs_pTrackingAllocators = NULL;		// Registered subsystems
+static volatile LONG		gs_TrackingAllocatorsLock = 0;
+
+// Spin lock protecting the list of registered subsystems
+struct	TrackingAllocatorsLock {
+	TrackingAllocatorsLock()	{ while ( InterlockedCompareExchange( &gs_TrackingAllocatorsLock, 1, 0 ) != 0 ) Sleep( 0 ); }
+	~TrackingAllocatorsLock()	{ InterlockedExchange( &gs_TrackingAllocatorsLock, 0 ); }
+};
+
+TrackingAllocator::TrackingAllocator( const char* _Name, IAllocator& _Parent )
+	: m_Name( _Name )
+	, m_Parent( _Parent )
+	, m_pPrevious( NULL )
+{
+	memset( &m_Statistics, 0, sizeof(AllocationStatistics) );
+
+	TrackingAllocatorsLock	Lock;
+	m_pNext = gs_pTrackingAllocators;
+	if ( m_pNext != NULL )
+		m_pNext->m_pPrevious = this;
+	gs_pTrackingAllocators = this;
+}
+
+TrackingAllocator::~TrackingAllocator() {
+	ASSERT( m_Statistics.CurrentBlocksCount == 0, "Subsystem is leaking memory!" );
+
+	TrackingAllocatorsLock	Lock;
+	if ( m_pPrevious != NULL )
+		m_pPrevious->m_pNext = m_pNext;
+	else
+		gs_pTrackingAllocators = m_pNext;
+	if ( m_pNext != NULL )
+		m_pNext->m_pPrevious = m_pPrevious;
+}
+
+void	TrackingAllocator::OnAllocate( size_t _Size ) {
+	AtomicMax( m_Statistics.PeakSize, AtomicAdd( m_Statistics.CurrentSize, _Size ) );
+	AtomicAdd( m_Statistics.CurrentBlocksCount, 1 );
+	AtomicAdd( m_Statistics.TotalBlocksCount, 1 );
+}
+
+void	TrackingAllocator::OnFree( size_t _Size ) {
+	AtomicAdd( m_Statistics.CurrentSize, size_t(0) - _Size );
+	AtomicAdd( m_Statistics.CurrentBlocksCount, size_t(0) - 1 );
+}
+
+void*	TrackingAllocator::Allocate( size_t _Size, size_t _Alignment ) {
+	void*	pBlock = m_Parent.Allocate( _Size, _Alignment );
+	if ( pBlock != NULL )
+		OnAllocate( _Size );
+	return pBlock;
+}
+
+void*	TrackingAllocator::Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment ) {
+	if ( _pBlock == NULL )
+		return Allocate( _NewSize, _Alignment );
+
+	void*	pNewBlock = m_Parent.Reallocate( _pBlock, _OldSize, _NewSize, _Alignment );
+	if ( pNewBlock != NULL )
+		AtomicMax( m_Statistics.PeakSize, AtomicAdd( m_Statistics.CurrentSize, _NewSize - _OldSize ) );
+	return pNewBlock;
+}
+
+void	TrackingAllocator::Free( void* _pBlock, size_t _Size, size_t _Alignment ) {
+	if ( _pBlock == NULL )
+		return;
+	m_Parent.Free( _pBlock, _Size, _Alignment );
+	OnFree( _Size );
+}
+
+void	TrackingAllocator::ReportStatistics( ReportDelegate _pDelegate, void* _pUserData ) {
+	TrackingAllocatorsLock	Lock;
+	for ( TrackingAllocator* pAllocator=gs_pTrackingAllocators; pAllocator != NULL; pAllocator=pAllocator->m_pNext )
+		(*_pDelegate)( pAllocator->m_Name, pAllocator->m_Statistics, _pUserData );
+}
+
+U32		TrackingAllocator::ReportLeaks( ReportDelegate _pDelegate, void* _pUserData ) {
+	TrackingAllocatorsLock	Lock;
+	U32	LeaksCount = 0;
+	for ( TrackingAllocator* pAllocator=gs_pTrackingAllocators; pAllocator != NULL; pAllocator=pAllocator->m_pNext ) {
+		if ( pAllocator->m_Statistics.CurrentBlocksCount == 0 )
+			continue;
+		if ( _pDelegate != NULL )
+			(*_pDelegate)( pAllocator->m_Name, pAllocator->m_Statistics, _pUserData );
+		LeaksCount++;
+	}
+	return LeaksCount;
+}
@@ -0,0 +1,239 @@
+//////////////////////////////////////////////////////////////////////////
+// Memory allocators
+//
+// Containers allocate their storage through an IAllocator so hot code can route allocations to a cheaper allocator:
+//	. HeapAllocator is the default general-purpose allocator, thread-safe, and can grow blocks in place
+//	. ArenaAllocator carves blocks linearly out of large pages and frees everything at once, the last block can grow in place
+//	. PoolAllocator serves fixed-size blocks from a free list, larger requests are forwarded to its parent allocator
+//	. LargeBlockAllocator gets page-aligned blocks directly from the virtual memory, for big buffers with large alignments
+//	. TrackingAllocator forwards to another allocator and keeps allocation statistics for a subsystem, to find out who uses memory and who leaks
+//
+// Arena and pool allocators are NOT thread-safe and must outlive the containers using them!
+// Each thread has its own temporary arena though (see GetThreadArena()) that can be used without locking.
+//
+#pragma once
+
+#include "../Types.h"
+
+#include <new>	// Placement new
+
+namespace BaseLib {
+
+class	IAllocator {
+public:
+	// Allocates a block of memory of the given size and alignment (which must be a power of 2)
+	virtual void*	Allocate( size_t _Size, size_t _Alignment ) = 0;
+
+	// Resizes a block, preserving its content up to the smallest of the 2 sizes
+	// The block may be moved, in which case the former pointer becomes invalid
+	virtual void*	Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment ) = 0;
+
+	// Frees a block previously allocated with the given size and alignment (_pBlock can be NULL)
+	virtual void	Free( void* _pBlock, size_t _Size, size_t _Alignment ) = 0;
+};
+
+// Returns the default heap allocator
+IAllocator&	GetDefaultAllocator();
+
+// General-purpose allocator using the process heap
+class	HeapAllocator : public IAllocator {
+public:
+	virtual void*	Allocate( size_t _Size, size_t _Alignment );
+	virtual void*	Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment );
+	virtual void	Free( void* _pBlock, size_t _Size, size_t _Alignment );
+};
+
+// Linear allocator
+class	ArenaAllocator : public IAllocator {
+protected:
+	struct	Page {
+		Page*	pPrevious;
+		size_t	Size;		// Size of the usable memory following the header
+		size_t	Offset;		// Offset of the first free byte
+	};
+
+public:
+	// Position in the arena that can be rewound to, freeing all the blocks allocated since then
+	struct	Marker {
+		Page*	pPage;
+		size_t	Offset;
+		size_t	AllocatedSize;
+	};
+
+protected:
+	IAllocator&	m_Parent;
+	size_t		m_PageSize;
+	Page*		m_pCurrentPage;
+	Page*		m_pSparePage;	// Last page released by Rewind(), kept to avoid reallocating a page each frame
+	void*		m_pLastBlock;	// Last allocated block, the only one that can grow in place or really be freed
+	size_t		m_AllocatedSize;
+
+public:
+	ArenaAllocator( size_t _PageSize=1024*1024, IAllocator& _Parent=GetDefaultAllocator() );
+	~ArenaAllocator();
+
+	// Frees all the blocks at once
+	void			Reset();
+
+	// Frees all the blocks allocated since the marker was taken (markers must be rewound in reverse order)
+	Marker			GetMarker() const;
+	void			Rewind( const Marker& _Marker );
+
+	size_t			GetAllocatedSize() const	{ return m_AllocatedSize; }
+
+	virtual void*	Allocate( size_t _Size, size_t _Alignment );
+	virtual void*	Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment );
+	virtual void	Free( void* _pBlock, size_t _Size, size_t _Alignment );
+
+private:
+	ArenaAllocator( const ArenaAllocator& );
+	ArenaAllocator&	operator=( const ArenaAllocator& );
+};
+
+// Fixed-size blocks allocator
+class	PoolAllocator : public IAllocator {
+protected:
+	static const size_t	BLOCK_ALIGNMENT = 16;
+
+	struct	FreeBlock {
+		FreeBlock*	pNext;
+	};
+	struct	Page {
+		Page*		pNext;
+	};
+
+	IAllocator&	m_Parent;
+	size_t		m_BlockSize;
+	U32			m_BlocksPerPage;
+	Page*		m_pPages;
+	FreeBlock*	m_pFreeBlocks;
+
+public:
+	PoolAllocator( size_t _BlockSize, U32 _BlocksPerPage=256, IAllocator& _Parent=GetDefaultAllocator() );
+	~PoolAllocator();
+
+	size_t			GetBlockSize() const	{ return m_BlockSize; }
+
+	virtual void*	Allocate( size_t _Size, size_t _Alignment );
+	virtual void*	Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment );
+	virtual void	Free( void* _pBlock, size_t _Size, size_t _Alignment );
+
+private:
+	bool			IsPoolBlock( size_t _Size, size_t _Alignment ) const	{ return _Size <= m_BlockSize && _Alignment <= BLOCK_ALIGNMENT; }
+
+	PoolAllocator( const PoolAllocator& );
+	PoolAllocator&	operator=( const PoolAllocator& );
+};
+
+// Typed pool of objects, constructed and destroyed in place
+template< typename T > class	ObjectPool {
+	PoolAllocator	m_Pool;
+
+public:
+	ObjectPool( U32 _ObjectsPerPage=256, IAllocator& _Parent=GetDefaultAllocator() ) : m_Pool( sizeof(T), _ObjectsPerPage, _Parent ) {}
+
+	T*		New()						{ return new( m_Pool.Allocate( sizeof(T), __alignof(T) ) ) T(); }
+	T*		New( const T& _Source )		{ return new( m_Pool.Allocate( sizeof(T), __alignof(T) ) ) T( _Source ); }
+	void	Delete( T* _pObject ) {
+		if ( _pObject == NULL )
+			return;
+		_pObject->~T();
+		m_Pool.Free( _pObject, sizeof(T), __alignof(T) );
+	}
+};
+
+// Virtual memory allocator for large blocks
+// Blocks are aligned on the allocation granularity of the system (64KB) and larger alignments are supported too,
+//	memory is committed on allocation and comes zeroed by the system
+class	LargeBlockAllocator : public IAllocator {
+public:
+	virtual void*	Allocate( size_t _Size, size_t _Alignment );
+	virtual void*	Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment );
+	virtual void	Free( void* _pBlock, size_t _Size, size_t _Alignment );
+
+	static size_t	GetPageSize();
+	static size_t	GetAllocationGranularity();
+};
+
+// Returns the default large blocks allocator
+IAllocator&	GetLargeBlockAllocator();
+
+
+//////////////////////////////////////////////////////////////////////////
+// Thread arenas
+//
+// Each thread lazily creates its own arena for short-lived temporary allocations, use an ArenaScope to free them automatically:
+//
+//	{
+//		ArenaScope	Scope( GetThreadArena() );
+//		List<U32>	Temp( GetThreadArena() );
+//		...
+//	}	// All the blocks allocated by the thread arena since the scope was opened are freed here
+//
+// Threads other than the main thread must call ReleaseThreadArena() before they exit (ParallelFor() workers do).
+ArenaAllocator&	GetThreadArena();
+void			ReleaseThreadArena();
+
+class	ArenaScope {
+	ArenaAllocator&			m_Arena;
+	ArenaAllocator::Marker	m_Marker;
+
+public:
+	ArenaScope( ArenaAllocator& _Arena ) : m_Arena( _Arena ), m_Marker( _Arena.GetMarker() ) {}
+	~ArenaScope()	{ m_Arena.Rewind( m_Marker ); }
+
+private:
+	ArenaScope( const ArenaScope& );
+	ArenaScope&	operator=( const ArenaScope& );
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Allocation statistics
+//
+struct	AllocationStatistics {
+	size_t	CurrentSize;		// Size of the blocks currently allocated
+	size_t	PeakSize;			// Largest value CurrentSize ever reached
+	size_t	CurrentBlocksCount;	// Amount of blocks currently allocated (i.e. leaks if not 0 on exit)
+	size_t	TotalBlocksCount;	// Amount of blocks allocated since the beginning
+};
+
+// Forwards all the calls to a parent allocator and tracks the allocations of a named subsystem (thread-safe if the parent is)
+// Tracking allocators register themselves in a global list so the statistics of all the subsystems can be reported at once
+class	TrackingAllocator : public IAllocator {
+public:
+	typedef void	(*ReportDelegate)( const char* _Name, const AllocationStatistics& _Statistics, void* _pUserData );
+
+protected:
+	const char*				m_Name;
+	IAllocator&				m_Parent;
+	AllocationStatistics	m_Statistics;
+	TrackingAllocator*		m_pNext;
+	TrackingAllocator*		m_pPrevious;
+
+public:
+	TrackingAllocator( const char* _Name, IAllocator& _Parent=GetDefaultAllocator() );
+	~TrackingAllocator();
+
+	const char*						GetName() const			{ return m_Name; }
+	const AllocationStatistics&		GetStatistics() const	{ return m_Statistics; }
+
+	virtual void*	Allocate( size_t _Size, size_t _Alignment );
+	virtual void*	Reallocate( void* _pBlock, size_t _OldSize, size_t _NewSize, size_t _Alignment );
+	virtual void	Free( void* _pBlock, size_t _Size, size_t _Alignment );
+
+	// Calls the delegate for each registered subsystem
+	static void		ReportStatistics( ReportDelegate _pDelegate, void* _pUserData );
+
+	// Calls the delegate for each registered subsystem that still has allocated blocks, returns the amount of leaking subsystems
+	static U32		ReportLeaks( ReportDelegate _pDelegate, void* _pUserData );
+
+private:
+	void			OnAllocate( size_t _Size );
+	void			OnFree( size_t _Size );
+
+	TrackingAllocator( const TrackingAllocator& );
+	TrackingAllocator&	operator=( const TrackingAllocator& );
+};
+
+}	// namespace BaseLib
@@ -0,0 +1,174 @@
+#include "../Types.h"
+#include "Compression.h"
+
+#include <string.h>
+
+using namespace BaseLib;
+
+static const U32	LZ4_MIN_MATCH = 4;
+static const U32	LZ4_LAST_LITERALS = 5;			// The last 5 bytes of a block are always literals
+static const U32	LZ4_MATCH_SEARCH_LIMIT = 12;	// The last match must start at least 12 bytes before the end of the block
+static const U32	LZ4_MAX_OFFSET = 65535;
+static const U32	LZ4_HASH_POT = 12;				// 16KB hash table, fits in L1
+
+static U32	Read32( const U8* _p )	{ U32 Value; memcpy( &Value, _p, 4 ); return Value; }
+static U32	LZ4Hash( U32 _Sequence )	{ return (_Sequence * 2654435761U) >> (32 - LZ4_HASH_POT); }
+
+// Writes the bytes extending a length that didn't fit in the 4 bits of the token
+static U8*	WriteLength( U8* _pTarget, U32 _Length ) {
+	while ( _Length >= 255 ) {
+		*_pTarget++ = 255;
+		_Length -= 255;
+	}
+	*_pTarget++ = U8( _Length );
+	return _pTarget;
+}
+
+// Reads the bytes extending a length, returns false if the source is exhausted
+static bool	ReadLength( const U8*& _pSource, const U8* _pSourceEnd, U32& _Length ) {
+	U32	Byte;
+	do {
+		if ( _pSource >= _pSourceEnd )
+			return false;
+		Byte = *_pSource++;
+		_Length += Byte;
+	} while ( Byte == 255 );
+	return true;
+}
+
+// Writes a sequence of literals followed by a match (no match if _MatchLength is 0)
+static U8*	WriteSequence( U8* _pTarget, const U8* _pLiterals, U32 _LiteralsCount, U32 _Offset, U32 _MatchLength ) {
+	U8*	pToken = _pTarget++;
+	if ( _LiteralsCount >= 15 ) {
+		*pToken = 15 << 4;
+		_pTarget = WriteLength( _pTarget, _LiteralsCount - 15 );
+	} else {
+		*pToken = U8( _LiteralsCount << 4 );
+	}
+	memcpy( _pTarget, _pLiterals, _LiteralsCount );
+	_pTarget += _LiteralsCount;
+	if ( _MatchLength == 0 )
+		return _pTarget;
+
+	*_pTarget++ = U8( _Offset );
+	*_pTarget++ = U8( _Offset >> 8 );
+
+	U32	Length = _MatchLength - LZ4_MIN_MATCH;
+	if ( Length >= 15 ) {
+		*pToken |= 15;
+		_pTarget = WriteLength( _pTarget, Length - 15 );
+	} else {
+		*pToken |= U8( Length );
+	}
+	return _pTarget;
+}
+
+U32		BaseLib::LZ4Compress( const void* _pSource, U32 _size, void* _pTarget, U32 _capacity ) {
+	const U8*	pSource = (const U8*) _pSource;
+	U8*			pTarget = (U8*) _pTarget;
+	U8*			pTargetEnd = pTarget + _capacity;
+
+	U32	Anchor = 0;	// Start of the pending literals
+	if ( _size > LZ4_MATCH_SEARCH_LIMIT ) {
+		U32	pHashTable[1 << LZ4_HASH_POT];
+		memset( pHashTable, 0, sizeof(pHashTable) );
+
+		U32	SearchEnd = _size - LZ4_MATCH_SEARCH_LIMIT;
+		U32	MatchEnd = _size - LZ4_LAST_LITERALS;
+		U32	Position = 0;
+		while ( Position < SearchEnd ) {
+			U32		Sequence = Read32( pSource + Position );
+			U32&	Entry = pHashTable[LZ4Hash( Sequence )];
+			U32		Reference = Entry;
+			Entry = Position;
+			if ( Reference >= Position || Position - Reference > LZ4_MAX_OFFSET || Read32( pSource + Reference ) != Sequence ) {
+				Position += 1 + ((Position - Anchor) >> 6);	// Accelerate through incompressible data
+				continue;
+			}
+
+			// Extend the match in both directions
+			while ( Position > Anchor && Reference > 0 && pSource[Position-1] == pSource[Reference-1] ) {
+				Position--;
+				Reference--;
+			}
+			U32	Length = LZ4_MIN_MATCH;
+			while ( Position + Length < MatchEnd && pSource[Position+Length] == pSource[Reference+Length] )
+				Length++;
+
+			U32	LiteralsCount = Position - Anchor;
+			if ( size_t(pTargetEnd - pTarget) < 1 + LiteralsCount + LiteralsCount / 255 + 1 + 2 + Length / 255 + 1 )
+				return 0;
+			pTarget = WriteSequence( pTarget, pSource + Anchor, LiteralsCount, Position - Reference, Length );
+
+			Position += Length;
+			Anchor = Position;
+			if ( Position < SearchEnd )
+				pHashTable[LZ4Hash( Read32( pSource + Position - 2 ) )] = Position - 2;
+		}
+	}
+
+	// Last literals
+	U32	LiteralsCount = _size - Anchor;
+	if ( size_t(pTargetEnd - pTarget) < 1 + LiteralsCount + LiteralsCount / 255 + 1 )
+		return 0;
+	pTarget = WriteSequence( pTarget, pSource + Anchor, LiteralsCount, 0, 0 );
+
+	return U32( pTarget - (U8*) _pTarget );
+}
+
+U32		BaseLib::LZ4Decompress( const void* _pSource, U32 _size, void* _pTarget, U32 _capacity ) {
+	const U8*	pSource = (const U8*) _pSource;
+	const U8*	pSourceEnd = pSource + _size;
+	U8*			pTargetStart = (U8*) _pTarget;
+	U8*			pTarget = pTargetStart;
+	U8*			pTargetEnd = pTarget + _capacity;
+
+	while ( pSource < pSourceEnd ) {
+		U32	Token = *pSource++;
+
+		// Literals
+		U32	LiteralsCount = Token >> 4;
+		if ( LiteralsCount == 15 && !ReadLength( pSource, pSourceEnd, LiteralsCount ) )
+			return ~0U;
+		if ( LiteralsCount > size_t(pSourceEnd - pSource) || LiteralsCount > size_t(pTargetEnd - pTarget) )
+			return ~0U;
+		memcpy( pTarget, pSource, LiteralsCount );
+		pSource += LiteralsCount;
+		pTarget += LiteralsCount;
+		if ( pSource == pSourceEnd )
+			break;	// The last sequence has no match
+
+		// Match
+		if ( pSourceEnd - pSource < 2 )
+			return ~0U;
+		U32	Offset = pSource[0] | (pSource[1] << 8);
+		pSource += 2;
+		if ( Offset == 0 || Offset > size_t(pTarget - pTargetStart) )
+			return ~0U;
+
+		U32	Length = Token & 15;
+		if ( Length == 15 && !ReadLength( pSource, pSourceEnd, Length ) )
+			return ~0U;
+		Length += LZ4_MIN_MATCH;
+		if ( Length > size_t(pTargetEnd - pTarget) )
+			return ~0U;
+
+		const U8*	pMatch = pTarget - Offset;
+		if ( Offset >= Length ) {
+			memcpy( pTarget, pMatch, Length );
+		} else if ( Offset >= 8 ) {
+			// Overlapping copy, but each 8 bytes chunk reads bytes that have already been written
+			U32	i = 0;
+			for ( ; i+8 <= Length; i+=8 )
+				memcpy( pTarget + i, pMatch + i, 8 );
+			for ( ; i < Length; i++ )
+				pTarget[i] = pMatch[i];
+		} else {
+			for ( U32 i=0; i < Length; i++ )
+				pTarget[i] = pMatch[i];
+		}
+		pTarget += Length;
+	}
+
+	return U32( pTarget - pTargetStart );
+}
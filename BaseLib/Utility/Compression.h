@@ -0,0 +1,22 @@
+//////////////////////////////////////////////////////////////////////////
+// Block compression
+//
+// Self-contained LZ4 block codec (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), the output is compatible with the reference implementation.
+// Compression uses a single hash table probe per position so it trades some ratio for speed, decompression checks all its bounds.
+//
+#pragma once
+
+#include "../Types.h"
+
+namespace BaseLib {
+
+// Returns the maximum size of the compressed data for _size bytes of raw data
+inline U32	LZ4CompressBound( U32 _size )	{ return _size + _size / 255 + 16; }
+
+// Compresses a block, returns the size of the compressed data or 0 if it doesn't fit in _capacity bytes
+U32			LZ4Compress( const void* _pSource, U32 _size, void* _pTarget, U32 _capacity );
+
+// Decompresses a block, returns the size of the decompressed data or ~0U if the compressed data is corrupted or doesn't fit in _capacity bytes
+U32			LZ4Decompress( const void* _pSource, U32 _size, void* _pTarget, U32 _capacity );
+
+}	// namespace BaseLib
@@ -0,0 +1,485 @@
+#include "../Types.h"
+#include "MeshOptimizer.h"
+
+#include <string.h>
+
+using namespace BaseLib;
+
+static const bfloat3&	Position( const void* _pPositions, U32 _PositionStride, U32 _Index ) {
+	return *((const bfloat3*) ((const U8*) _pPositions + size_t(_Index) * _PositionStride));
+}
+
+U32		BaseLib::ConvertStripToList( const U32* _pStrip, U32 _IndicesCount, U32* _pTarget ) {
+	U32	Count = 0;
+	for ( U32 i=2; i < _IndicesCount; i++ ) {
+		U32	A = _pStrip[i-2];
+		U32	B = _pStrip[i-1];
+		U32	C = _pStrip[i];
+		if ( A == B || B == C || A == C )
+			continue;	// Degenerate
+
+		// Every odd triangle of a strip has its winding reversed
+		if ( i & 1 ) {
+			U32	Temp = A;
+			A = B;
+			B = Temp;
+		}
+		_pTarget[Count++] = A;
+		_pTarget[Count++] = B;
+		_pTarget[Count++] = C;
+	}
+	return Count;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Vertex cache
+//
+// The FIFO cache is simulated with a time stamp per vertex incremented on each cache miss:
+//	a vertex is in the cache if less than _CacheSize vertices were inserted since its own insertion
+//
+VertexCacheStatistics	BaseLib::AnalyzeVertexCache( const U32* _pIndices, U32 _IndicesCount, U32 _VerticesCount, U32 _CacheSize ) {
+	VertexCacheStatistics	Result;
+	Result.VerticesTransformed = 0;
+	Result.ACMR = 0.0f;
+	Result.ATVR = 0.0f;
+
+	List<U32>	TimeStamps( _VerticesCount );
+	TimeStamps.SetCount( _VerticesCount );
+	memset( TimeStamps.Ptr(), 0, _VerticesCount * sizeof(U32) );
+
+	U32	Time = _CacheSize + 1;
+	for ( U32 i=0; i < _IndicesCount; i++ ) {
+		U32	Index = _pIndices[i];
+		ASSERT( Index < _VerticesCount, "Index out of range!" );
+		if ( Time - TimeStamps[Index] > _CacheSize ) {
+			TimeStamps[Index] = Time++;
+			Result.VerticesTransformed++;
+		}
+	}
+
+	U32	ReferencedCount = 0;
+	for ( U32 i=0; i < _VerticesCount; i++ )
+		if ( TimeStamps[i] != 0 )
+			ReferencedCount++;
+
+	if ( _IndicesCount >= 3 )
+		Result.ACMR = float(Result.VerticesTransformed) / (_IndicesCount / 3);
+	if ( ReferencedCount > 0 )
+		Result.ATVR = float(Result.VerticesTransformed) / ReferencedCount;
+
+	return Result;
+}
+
+// Tipsify: fans around the vertices in the cache, choosing the next fanning vertex among the vertices of the current fan
+//	that will still be in the cache after its own fan is emitted. When no such vertex remains, we backtrack on the
+//	recently emitted vertices (the "dead-end stack") or fall back to the next vertex that still has triangles, which starts a new cluster.
+U32		BaseLib::OptimizeVertexCache( U32* _pIndices, U32 _IndicesCount, U32 _VerticesCount, U32 _CacheSize, U32* _pClusters, IAllocator& _Allocator ) {
+	U32	TrianglesCount = _IndicesCount / 3;
+	if ( TrianglesCount == 0 )
+		return 0;
+
+	// Build the vertex => triangles adjacency
+	List<U32>	LiveCounts( _Allocator, _VerticesCount );
+	List<U32>	Offsets( _Allocator, _VerticesCount+1 );
+	List<U32>	Adjacency( _Allocator, 3*TrianglesCount );
+	LiveCounts.SetCount( _VerticesCount );
+	Offsets.SetCount( _VerticesCount+1 );
+	Adjacency.SetCount( 3*TrianglesCount );
+	memset( LiveCounts.Ptr(), 0, _VerticesCount * sizeof(U32) );
+
+	for ( U32 i=0; i < 3*TrianglesCount; i++ ) {
+		ASSERT( _pIndices[i] < _VerticesCount, "Index out of range!" );
+		LiveCounts[_pIndices[i]]++;
+	}
+	U32	Offset = 0;
+	for ( U32 i=0; i < _VerticesCount; i++ ) {
+		Offsets[i] = Offset;
+		Offset += LiveCounts[i];
+	}
+	Offsets[_VerticesCount] = Offset;
+	for ( U32 i=0; i < 3*TrianglesCount; i++ )
+		Adjacency[Offsets[_pIndices[i]]++] = i / 3;
+	for ( U32 i=0; i < _VerticesCount; i++ )
+		Offsets[i] -= LiveCounts[i];	// Restore the offsets we just advanced
+
+	List<U32>	TimeStamps( _Allocator, _VerticesCount );
+	List<U8>	Emitted( _Allocator, TrianglesCount );
+	List<U32>	DeadEnds( _Allocator, 3*TrianglesCount );
+	List<U32>	Candidates( _Allocator, 64 );
+	List<U32>	Output( _Allocator, 3*TrianglesCount );
+	TimeStamps.SetCount( _VerticesCount );
+	Emitted.SetCount( TrianglesCount );
+	Output.SetCount( 3*TrianglesCount );
+	memset( TimeStamps.Ptr(), 0, _VerticesCount * sizeof(U32) );
+	memset( Emitted.Ptr(), 0, TrianglesCount );
+
+	U32		Time = _CacheSize + 1;
+	U32		Cursor = 0;
+	U32		OutputCount = 0;
+	U32		ClustersCount = 0;
+	U32		Fanning = ~0U;
+	bool	NewCluster = true;
+	while ( true ) {
+		if ( Fanning == ~0U ) {
+			// Dead end: backtrack on the recent vertices first, then scan for any vertex with remaining triangles
+			while ( DeadEnds.Count() > 0 && Fanning == ~0U ) {
+				U32	Vertex = DeadEnds[DeadEnds.Count()-1];
+				DeadEnds.SetCount( DeadEnds.Count()-1 );
+				if ( LiveCounts[Vertex] > 0 )
+					Fanning = Vertex;
+			}
+			while ( Cursor < _VerticesCount && Fanning == ~0U ) {
+				if ( LiveCounts[Cursor] > 0 )
+					Fanning = Cursor;
+				else
+					Cursor++;
+			}
+			if ( Fanning == ~0U )
+				break;	// All triangles emitted
+			NewCluster = true;
+		}
+
+		if ( NewCluster && _pClusters != NULL )
+			_pClusters[ClustersCount] = OutputCount / 3;
+		ClustersCount += NewCluster ? 1 : 0;
+		NewCluster = false;
+
+		// Emit the fan
+		Candidates.Clear();
+		for ( U32 i=Offsets[Fanning]; i < Offsets[Fanning+1]; i++ ) {
+			U32	Triangle = Adjacency[i];
+			if ( Emitted[Triangle] )
+				continue;
+			Emitted[Triangle] = 1;
+
+			for ( U32 Corner=0; Corner < 3; Corner++ ) {
+				U32	Vertex = _pIndices[3*Triangle+Corner];
+				Output[OutputCount++] = Vertex;
+				DeadEnds.Append( Vertex );
+				Candidates.Append( Vertex );
+				LiveCounts[Vertex]--;
+				if ( Time - TimeStamps[Vertex] > _CacheSize )
+					TimeStamps[Vertex] = Time++;
+			}
+		}
+
+		// Choose the next fanning vertex: the oldest one in the cache that will still be there once its remaining triangles are emitted
+		U32	Next = ~0U;
+		int	BestPriority = -1;
+		for ( U32 i=0; i < Candidates.Count(); i++ ) {
+			U32	Vertex = Candidates[i];
+			if ( LiveCounts[Vertex] == 0 )
+				continue;
+
+			int	Priority = 0;
+			if ( Time - TimeStamps[Vertex] + 2 * LiveCounts[Vertex] <= _CacheSize )
+				Priority = int(Time - TimeStamps[Vertex]);
+			if ( Priority > BestPriority ) {
+				BestPriority = Priority;
+				Next = Vertex;
+			}
+		}
+		Fanning = Next;
+	}
+	ASSERT( OutputCount == 3*TrianglesCount, "Some triangles were not emitted!" );
+
+	memcpy( _pIndices, Output.Ptr(), OutputCount * sizeof(U32) );
+
+	return ClustersCount;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Overdraw
+//
+// Clusters are split further where the local cache efficiency is as good as the whole cluster's ("soft boundaries"), so they can
+//	be reordered without degrading the ACMR by more than the threshold, then they're sorted so the clusters facing away from the
+//	center of the mesh are drawn first: they're the most likely to occlude the others.
+//
+void	BaseLib::OptimizeOverdraw( U32* _pIndices, U32 _IndicesCount, const void* _pPositions, U32 _VerticesCount, U32 _PositionStride, float _Threshold, U32 _CacheSize, IAllocator& _Allocator ) {
+	U32	TrianglesCount = _IndicesCount / 3;
+	if ( TrianglesCount == 0 )
+		return;
+
+	List<U32>	TimeStamps( _Allocator, _VerticesCount );
+	TimeStamps.SetCount( _VerticesCount );
+	memset( TimeStamps.Ptr(), 0, _VerticesCount * sizeof(U32) );
+	U32	Time = _CacheSize + 1;
+
+	// Hard boundaries: triangles whose 3 vertices all miss the cache are where Tipsify flushed it
+	List<U32>	HardClusters( _Allocator, 64 );
+	for ( U32 Triangle=0; Triangle < TrianglesCount; Triangle++ ) {
+		U32	Misses = 0;
+		for ( U32 Corner=0; Corner < 3; Corner++ ) {
+			U32	Vertex = _pIndices[3*Triangle+Corner];
+			if ( Time - TimeStamps[Vertex] > _CacheSize ) {
+				TimeStamps[Vertex] = Time++;
+				Misses++;
+			}
+		}
+		if ( Triangle == 0 || Misses == 3 )
+			HardClusters.Append( Triangle );
+	}
+	HardClusters.Append( TrianglesCount );
+
+	// Soft boundaries
+	List<U32>	Clusters( _Allocator, HardClusters.Count() );
+	for ( U32 ClusterIndex=0; ClusterIndex < HardClusters.Count()-1; ClusterIndex++ ) {
+		U32	Start = HardClusters[ClusterIndex];
+		U32	End = HardClusters[ClusterIndex+1];
+
+		// Measure the cluster with a cold cache
+		Time += _CacheSize + 1;
+		U32	ClusterMisses = 0;
+		for ( U32 i=3*Start; i < 3*End; i++ ) {
+			U32	Vertex = _pIndices[i];
+			if ( Time - TimeStamps[Vertex] > _CacheSize ) {
+				TimeStamps[Vertex] = Time++;
+				ClusterMisses++;
+			}
+		}
+		float	MaxACMR = _Threshold * ClusterMisses / (End - Start);
+
+		// Split wherever the ACMR since the last split is good enough
+		Time += _CacheSize + 1;
+		Clusters.Append( Start );
+		U32	SubStart = Start;
+		U32	SubMisses = 0;
+		for ( U32 Triangle=Start; Triangle < End; Triangle++ ) {
+			for ( U32 Corner=0; Corner < 3; Corner++ ) {
+				U32	Vertex = _pIndices[3*Triangle+Corner];
+				if ( Time - TimeStamps[Vertex] > _CacheSize ) {
+					TimeStamps[Vertex] = Time++;
+					SubMisses++;
+				}
+			}
+			if ( Triangle+1 < End && SubMisses <= MaxACMR * (Triangle+1 - SubStart) ) {
+				Clusters.Append( Triangle+1 );
+				SubStart = Triangle+1;
+				SubMisses = 0;
+				Time += _CacheSize + 1;
+			}
+		}
+	}
+	U32	ClustersCount = Clusters.Count();
+	Clusters.Append( TrianglesCount );
+
+	// Compute the area-weighted centroid and normal of each cluster
+	struct	SortKey {
+		float	Key;
+		U32		Cluster;
+	};
+	List<SortKey>	Keys( _Allocator, ClustersCount );
+	List<bfloat3>	Centroids( _Allocator, ClustersCount );
+	List<bfloat3>	Normals( _Allocator, ClustersCount );
+	bfloat3	MeshCentroid( 0, 0, 0 );
+	float	MeshArea = 0.0f;
+	for ( U32 ClusterIndex=0; ClusterIndex < ClustersCount; ClusterIndex++ ) {
+		bfloat3	Centroid( 0, 0, 0 );
+		bfloat3	Normal( 0, 0, 0 );
+		float	Area = 0.0f;
+		for ( U32 Triangle=Clusters[ClusterIndex]; Triangle < Clusters[ClusterIndex+1]; Triangle++ ) {
+			const bfloat3&	P0 = Position( _pPositions, _PositionStride, _pIndices[3*Triangle+0] );
+			const bfloat3&	P1 = Position( _pPositions, _PositionStride, _pIndices[3*Triangle+1] );
+			const bfloat3&	P2 = Position( _pPositions, _PositionStride, _pIndices[3*Triangle+2] );
+			bfloat3	TriangleNormal = (P1 - P0).Cross( P2 - P0 );
+			float	TriangleArea = TriangleNormal.Length();
+			Centroid += (P0 + P1 + P2) * (TriangleArea / 3.0f);
+			Normal += TriangleNormal;
+			Area += TriangleArea;
+		}
+		MeshCentroid += Centroid;
+		MeshArea += Area;
+		if ( Area > 0.0f )
+			Centroid /= Area;
+		float	NormalLength = Normal.Length();
+		if ( NormalLength > 0.0f )
+			Normal /= NormalLength;
+
+		Centroids.Append( Centroid );
+		Normals.Append( Normal );
+	}
+	if ( MeshArea > 0.0f )
+		MeshCentroid /= MeshArea;
+
+	for ( U32 ClusterIndex=0; ClusterIndex < ClustersCount; ClusterIndex++ ) {
+		SortKey&	Key = Keys.Append();
+		Key.Key = (Centroids[ClusterIndex] - MeshCentroid).Dot( Normals[ClusterIndex] );
+		Key.Cluster = ClusterIndex;
+	}
+	Keys.SortBy( []( const SortKey& a, const SortKey& b ) { return a.Key > b.Key || (a.Key == b.Key && a.Cluster < b.Cluster); } );
+
+	// Write the sorted clusters
+	List<U32>	Output( _Allocator, 3*TrianglesCount );
+	for ( U32 i=0; i < ClustersCount; i++ ) {
+		U32	ClusterIndex = Keys[i].Cluster;
+		U32	Start = Clusters[ClusterIndex];
+		U32	End = Clusters[ClusterIndex+1];
+		Output.Append( _pIndices + 3*Start, 3*(End - Start) );
+	}
+	memcpy( _pIndices, Output.Ptr(), 3*TrianglesCount * sizeof(U32) );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Vertex fetch
+//
+U32		BaseLib::OptimizeVertexFetch( U32* _pIndices, U32 _IndicesCount, void* _pVertices, U32 _VerticesCount, U32 _VertexSize, IAllocator& _Allocator ) {
+	List<U32>	Remap( _Allocator, _VerticesCount );
+	Remap.SetCount( _VerticesCount );
+	memset( Remap.Ptr(), 0xFF, _VerticesCount * sizeof(U32) );
+
+	U32	NewVerticesCount = 0;
+	for ( U32 i=0; i < _IndicesCount; i++ ) {
+		U32&	NewIndex = Remap[_pIndices[i]];
+		if ( NewIndex == ~0U )
+			NewIndex = NewVerticesCount++;
+		_pIndices[i] = NewIndex;
+	}
+
+	size_t	Size = size_t(_VerticesCount) * _VertexSize;
+	U8*		pTemp = (U8*) _Allocator.Allocate( Size, 16 );
+	memcpy( pTemp, _pVertices, Size );
+	for ( U32 i=0; i < _VerticesCount; i++ )
+		if ( Remap[i] != ~0U )
+			memcpy( (U8*) _pVertices + size_t(Remap[i]) * _VertexSize, pTemp + size_t(i) * _VertexSize, _VertexSize );
+	_Allocator.Free( pTemp, Size, 16 );
+
+	return NewVerticesCount;
+}
+
+U32		BaseLib::OptimizeMesh( U32* _pIndices, U32 _IndicesCount, void* _pVertices, U32 _VerticesCount, U32 _VertexSize, U32 _PositionOffset, VertexCacheStatistics* _pBefore, VertexCacheStatistics* _pAfter, IAllocator& _Allocator ) {
+	if ( _pBefore != NULL )
+		*_pBefore = AnalyzeVertexCache( _pIndices, _IndicesCount, _VerticesCount );
+
+	OptimizeVertexCache( _pIndices, _IndicesCount, _VerticesCount, VERTEX_CACHE_SIZE, NULL, _Allocator );
+	OptimizeOverdraw( _pIndices, _IndicesCount, (const U8*) _pVertices + _PositionOffset, _VerticesCount, _VertexSize, 1.05f, VERTEX_CACHE_SIZE, _Allocator );
+	U32	NewVerticesCount = OptimizeVertexFetch( _pIndices, _IndicesCount, _pVertices, _VerticesCount, _VertexSize, _Allocator );
+
+	if ( _pAfter != NULL )
+		*_pAfter = AnalyzeVertexCache( _pIndices, _IndicesCount, NewVerticesCount );
+
+	return NewVerticesCount;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Meshlets
+//
+static void	ComputeMeshletBounds( Meshlet& _Meshlet, const U32* _pMeshletVertices, const U8* _pMeshletTriangles, const void* _pPositions, U32 _PositionStride ) {
+	// Bounding sphere centered on the bounding box
+	bfloat3	Min = Position( _pPositions, _PositionStride, _pMeshletVertices[0] );
+	bfloat3	Max = Min;
+	for ( U32 i=1; i < _Meshlet.VerticesCount; i++ ) {
+		const bfloat3&	P = Position( _pPositions, _PositionStride, _pMeshletVertices[i] );
+		Min = Min.Min( P );
+		Max = Max.Max( P );
+	}
+	_Meshlet.Center = 0.5f * (Min + Max);
+	float	MaxSqDistance = 0.0f;
+	for ( U32 i=0; i < _Meshlet.VerticesCount; i++ )
+		MaxSqDistance = MAX( MaxSqDistance, (Position( _pPositions, _PositionStride, _pMeshletVertices[i] ) - _Meshlet.Center).LengthSq() );
+	_Meshlet.Radius = sqrtf( MaxSqDistance );
+
+	// Normal cone axis is the average of the triangle normals
+	bfloat3	Axis( 0, 0, 0 );
+	for ( U32 i=0; i < _Meshlet.TrianglesCount; i++ ) {
+		const bfloat3&	P0 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+0]] );
+		const bfloat3&	P1 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+1]] );
+		const bfloat3&	P2 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+2]] );
+		bfloat3	Normal = (P1 - P0).Cross( P2 - P0 );
+		float	Length = Normal.Length();
+		if ( Length > 0.0f )
+			Axis += Normal / Length;
+	}
+
+	_Meshlet.ConeApex = _Meshlet.Center;
+	_Meshlet.ConeAxis.Set( 0, 0, 1 );
+	_Meshlet.ConeCutoff = 1.0f;
+	float	AxisLength = Axis.Length();
+	if ( AxisLength < 1e-6f )
+		return;	// Normals cancel out
+	Axis /= AxisLength;
+	_Meshlet.ConeAxis = Axis;
+
+	// The cone aperture is given by the normal furthest from the axis
+	float	MinDot = 1.0f;
+	for ( U32 i=0; i < _Meshlet.TrianglesCount; i++ ) {
+		const bfloat3&	P0 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+0]] );
+		const bfloat3&	P1 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+1]] );
+		const bfloat3&	P2 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+2]] );
+		bfloat3	Normal = (P1 - P0).Cross( P2 - P0 );
+		float	Length = Normal.Length();
+		if ( Length > 0.0f )
+			MinDot = MIN( MinDot, Axis.Dot( Normal ) / Length );
+	}
+	if ( MinDot <= 0.1f )
+		return;	// Wider than about 84°, the culling test would almost never succeed
+
+	// Move the apex back along the axis until it's behind the planes of all the triangles
+	float	MaxT = 0.0f;
+	for ( U32 i=0; i < _Meshlet.TrianglesCount; i++ ) {
+		const bfloat3&	P0 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+0]] );
+		const bfloat3&	P1 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+1]] );
+		const bfloat3&	P2 = Position( _pPositions, _PositionStride, _pMeshletVertices[_pMeshletTriangles[3*i+2]] );
+		bfloat3	Normal = (P1 - P0).Cross( P2 - P0 );
+		float	Length = Normal.Length();
+		if ( Length == 0.0f )
+			continue;
+		Normal /= Length;
+		float	T = (_Meshlet.Center - P0).Dot( Normal ) / Axis.Dot( Normal );
+		MaxT = MAX( MaxT, T );
+	}
+	_Meshlet.ConeApex = _Meshlet.Center - MaxT * Axis;
+	_Meshlet.ConeCutoff = sqrtf( 1.0f - MinDot * MinDot );
+}
+
+void	BaseLib::BuildMeshlets( const U32* _pIndices, U32 _IndicesCount, const void* _pPositions, U32 _VerticesCount, U32 _PositionStride, List<Meshlet>& _Meshlets, List<U32>& _MeshletVertices, List<U8>& _MeshletTriangles, U32 _MaxVertices, U32 _MaxTriangles ) {
+	ASSERT( _MaxVertices >= 3 && _MaxVertices <= 255, "Meshlet vertices must be addressable with a U8!" );
+	ASSERT( _MaxTriangles >= 1, "Invalid meshlet triangles count!" );
+
+	List<U8>	LocalIndices( _VerticesCount );
+	LocalIndices.SetCount( _VerticesCount );
+	memset( LocalIndices.Ptr(), 0xFF, _VerticesCount );
+
+	Meshlet	Current;
+	memset( &Current, 0, sizeof(Meshlet) );
+	Current.VerticesOffset = _MeshletVertices.Count();
+	Current.TrianglesOffset = _MeshletTriangles.Count();
+
+	U32	TrianglesCount = _IndicesCount / 3;
+	for ( U32 Triangle=0; Triangle <= TrianglesCount; Triangle++ ) {
+		const U32*	pTriangle = _pIndices + 3*Triangle;
+		bool		Flush = Triangle == TrianglesCount;
+		if ( !Flush ) {
+			U32	NewVertices = (LocalIndices[pTriangle[0]] == 0xFF) + (LocalIndices[pTriangle[1]] == 0xFF) + (LocalIndices[pTriangle[2]] == 0xFF);
+			Flush = Current.VerticesCount + NewVertices > _MaxVertices || Current.TrianglesCount == _MaxTriangles;
+		}
+
+		if ( Flush && Current.TrianglesCount > 0 ) {
+			const U32*	pMeshletVertices = _MeshletVertices.Ptr() + Current.VerticesOffset;
+			ComputeMeshletBounds( Current, pMeshletVertices, _MeshletTriangles.Ptr() + Current.TrianglesOffset, _pPositions, _PositionStride );
+			for ( U32 i=0; i < Current.VerticesCount; i++ )
+				LocalIndices[pMeshletVertices[i]] = 0xFF;
+			_Meshlets.Append( Current );
+
+			memset( &Current, 0, sizeof(Meshlet) );
+			Current.VerticesOffset = _MeshletVertices.Count();
+			Current.TrianglesOffset = _MeshletTriangles.Count();
+		}
+		if ( Triangle == TrianglesCount )
+			break;
+
+		for ( U32 Corner=0; Corner < 3; Corner++ ) {
+			U32	Vertex = pTriangle[Corner];
+			ASSERT( Vertex < _VerticesCount, "Index out of range!" );
+			if ( LocalIndices[Vertex] == 0xFF ) {
+				LocalIndices[Vertex] = U8( Current.VerticesCount++ );
+				_MeshletVertices.Append( Vertex );
+			}
+			_MeshletTriangles.Append( LocalIndices[Vertex] );
+		}
+		Current.TrianglesCount++;
+	}
+}
@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////////
+// Offline mesh optimization
+//
+// Reorders indexed triangle lists for the GPU pipeline, meant to be run once when cooking or loading meshes:
+//	. OptimizeVertexCache() reorders triangles for the post-transform vertex cache using Tipsify (Sander et al. 2007, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+//	. OptimizeOverdraw() then sorts the clusters of triangles output by Tipsify so the outward-facing ones come first, as long as the cache efficiency stays within a threshold
+//	. OptimizeVertexFetch() finally renumbers the vertices in the order they're first referenced so the vertex fetch reads memory linearly
+//	. BuildMeshlets() splits a mesh into small clusters of vertices and triangles with their bounding sphere and normal cone, for cluster culling
+//
+// AnalyzeVertexCache() simulates a FIFO cache to measure the ACMR (Average Cache Miss Ratio, transformed vertices per triangle, 0.5 at best for large regular grids)
+//	and the ATVR (Average Transformed Vertices Ratio, transformed vertices per referenced vertex, 1.0 at best).
+//
+// All the routines work on triangle lists: convert strips with ConvertStripToList() first.
+//
+#pragma once
+
+#include "../Types.h"
+#include "Allocator.h"
+#include "../Containers/List.h"
+
+namespace BaseLib {
+
+struct	VertexCacheStatistics {
+	U32		VerticesTransformed;
+	float	ACMR;
+	float	ATVR;
+};
+
+struct	Meshlet {
+	U32		VerticesOffset;		// Offset of the first vertex in the meshlet vertices list
+	U32		TrianglesOffset;	// Offset of the first local index in the meshlet triangles list (3 U8 local indices per triangle)
+	U32		VerticesCount;
+	U32		TrianglesCount;
+
+	bfloat3	Center;				// Bounding sphere
+	float	Radius;
+
+	bfloat3	ConeApex;			// Normal cone, the whole meshlet is back-facing if dot( normalize( ConeApex - CameraPosition ), ConeAxis ) >= ConeCutoff
+	bfloat3	ConeAxis;
+	float	ConeCutoff;			// 1 if the cone is too wide to ever cull the meshlet
+};
+
+// Vertex cache size assumed by the optimizer, post-transform caches of current GPUs behave like a FIFO of about that size
+static const U32	VERTEX_CACHE_SIZE = 16;
+
+// Meshlet limits matching the common mesh shader limits (124 triangles keep the local indices of a meshlet a multiple of 4 bytes)
+static const U32	MESHLET_MAX_VERTICES = 64;
+static const U32	MESHLET_MAX_TRIANGLES = 124;
+
+
+//////////////////////////////////////////////////////////////////////////
+// Converts a triangle strip into a list, the degenerate triangles used to join strips (as written by GeometryBuilder) are dropped
+// _pTarget must have room for 3 * (_IndicesCount - 2) indices, returns the amount of list indices
+U32		ConvertStripToList( const U32* _pStrip, U32 _IndicesCount, U32* _pTarget );
+
+// Simulates a FIFO vertex cache over a triangle list
+VertexCacheStatistics	AnalyzeVertexCache( const U32* _pIndices, U32 _IndicesCount, U32 _VerticesCount, U32 _CacheSize=VERTEX_CACHE_SIZE );
+
+// Reorders the triangles for the vertex cache, in place
+// _pClusters optionally receives the index of the first triangle of each cluster (i.e. where the cache was flushed), it must have room for _IndicesCount/3 entries
+// Returns the amount of clusters
+U32		OptimizeVertexCache( U32* _pIndices, U32 _IndicesCount, U32 _VerticesCount, U32 _CacheSize=VERTEX_CACHE_SIZE, U32* _pClusters=NULL, IAllocator& _Allocator=GetDefaultAllocator() );
+
+// Reorders the triangles to reduce overdraw, in place. The indices must have gone through OptimizeVertexCache() first
+// _Threshold is the maximum ACMR degradation allowed (e.g. 1.05 allows 5% more vertices transformed)
+// Positions are read as 3 floats every _PositionStride bytes
+void	OptimizeOverdraw( U32* _pIndices, U32 _IndicesCount, const void* _pPositions, U32 _VerticesCount, U32 _PositionStride, float _Threshold=1.05f, U32 _CacheSize=VERTEX_CACHE_SIZE, IAllocator& _Allocator=GetDefaultAllocator() );
+
+// Renumbers the vertices in order of first use and reorders the vertex buffer accordingly, in place
+// Unreferenced vertices are dropped, returns the new amount of vertices
+U32		OptimizeVertexFetch( U32* _pIndices, U32 _IndicesCount, void* _pVertices, U32 _VerticesCount, U32 _VertexSize, IAllocator& _Allocator=GetDefaultAllocator() );
+
+// Runs the 3 passes above in sequence and optionally returns the cache statistics before and after
+// The position must be 3 floats at offset _PositionOffset in the vertex, returns the new amount of vertices
+U32		OptimizeMesh( U32* _pIndices, U32 _IndicesCount, void* _pVertices, U32 _VerticesCount, U32 _VertexSize, U32 _PositionOffset=0, VertexCacheStatistics* _pBefore=NULL, VertexCacheStatistics* _pAfter=NULL, IAllocator& _Allocator=GetDefaultAllocator() );
+
+// Splits a triangle list into meshlets, greedily in triangle order so the mesh should be optimized for the vertex cache first
+//	_Meshlets, receives the meshlets
+//	_MeshletVertices, receives the mesh vertex index of each meshlet vertex
+//	_MeshletTriangles, receives 3 meshlet-local vertex indices per triangle
+void	BuildMeshlets( const U32* _pIndices, U32 _IndicesCount, const void* _pPositions, U32 _VerticesCount, U32 _PositionStride, List<Meshlet>& _Meshlets, List<U32>& _MeshletVertices, List<U8>& _MeshletTriangles, U32 _MaxVertices=MESHLET_MAX_VERTICES, U32 _MaxTriangles=MESHLET_MAX_TRIANGLES );
+
+}	// namespace BaseLib
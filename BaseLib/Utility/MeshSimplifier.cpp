@@ -0,0 +1,588 @@
+#include "../Types.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "../Containers/Sort.h"
+
+#include <string.h>
+#include <float.h>
+
+using namespace BaseLib;
+
+static const float	EDGE_QUADRIC_WEIGHT = 10.0f;	// Weight of the quadrics holding borders and seams in place, relative to the triangles' area
+static const U32	MAX_VALENCE = 256;				// Collapses involving vertices with more neighbors are rejected
+static const float	MAX_NORMAL_DEVIATION = 0.25f;	// Collapses can't rotate a triangle by more than acos( 0.25 ) ~ 75 degrees
+
+enum	VERTEX_KIND {
+	KIND_MANIFOLD,
+	KIND_BORDER,
+	KIND_SEAM,
+	KIND_LOCKED,
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Quadrics
+//
+// The quadric of a plane gives the squared distance of a point to that plane, the sum of the quadrics of several planes gives
+//	the sum of the squared distances. Quadrics are weighted by the area of the triangles they come from and the error is normalized
+//	by the total weight so it stays a squared distance.
+//
+struct	Quadric {
+	float	a00, a11, a22;
+	float	a10, a20, a21;
+	float	b0, b1, b2;
+	float	c;
+	float	w;
+};
+
+static void	QuadricFromPlane( Quadric& _Q, const bfloat3& _Normal, float _Distance, float _Weight ) {
+	_Q.a00 = _Weight * _Normal.x * _Normal.x;
+	_Q.a11 = _Weight * _Normal.y * _Normal.y;
+	_Q.a22 = _Weight * _Normal.z * _Normal.z;
+	_Q.a10 = _Weight * _Normal.y * _Normal.x;
+	_Q.a20 = _Weight * _Normal.z * _Normal.x;
+	_Q.a21 = _Weight * _Normal.z * _Normal.y;
+	_Q.b0 = _Weight * _Normal.x * _Distance;
+	_Q.b1 = _Weight * _Normal.y * _Distance;
+	_Q.b2 = _Weight * _Normal.z * _Distance;
+	_Q.c = _Weight * _Distance * _Distance;
+	_Q.w = _Weight;
+}
+
+static void	QuadricAdd( Quadric& _Q, const Quadric& _R ) {
+	_Q.a00 += _R.a00;	_Q.a11 += _R.a11;	_Q.a22 += _R.a22;
+	_Q.a10 += _R.a10;	_Q.a20 += _R.a20;	_Q.a21 += _R.a21;
+	_Q.b0 += _R.b0;		_Q.b1 += _R.b1;		_Q.b2 += _R.b2;
+	_Q.c += _R.c;
+	_Q.w += _R.w;
+}
+
+static float	QuadricError( const Quadric& _Q, const bfloat3& _P ) {
+	float	Ax = _Q.a00 * _P.x + _Q.a10 * _P.y + _Q.a20 * _P.z;
+	float	Ay = _Q.a10 * _P.x + _Q.a11 * _P.y + _Q.a21 * _P.z;
+	float	Az = _Q.a20 * _P.x + _Q.a21 * _P.y + _Q.a22 * _P.z;
+	float	Error = _P.x * Ax + _P.y * Ay + _P.z * Az + 2.0f * (_Q.b0 * _P.x + _Q.b1 * _P.y + _Q.b2 * _P.z) + _Q.c;
+	return _Q.w > 0.0f ? fabsf( Error ) / _Q.w : 0.0f;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Adjacency
+//
+// Lists the half-edges leaving each vertex (as the vertex they lead to) or the triangles using each vertex
+struct	Adjacency {
+	List<U32>	Offsets;
+	List<U32>	Counts;
+	List<U32>	Data;
+
+	Adjacency( IAllocator& _Allocator ) : Offsets( _Allocator ), Counts( _Allocator ), Data( _Allocator ) {}
+
+	//	_pRemap, optional remapping of the vertices (e.g. to build the adjacency of positions rather than vertices)
+	//	_Triangles, true to list triangles, false to list half-edges
+	void	Build( const U32* _pIndices, U32 _IndicesCount, const U32* _pRemap, U32 _VerticesCount, bool _Triangles ) {
+		Offsets.SetCount( _VerticesCount );
+		Counts.SetCount( _VerticesCount );
+		Data.SetCount( _IndicesCount );
+		memset( Counts.Ptr(), 0, _VerticesCount * sizeof(U32) );
+
+		for ( U32 i=0; i < _IndicesCount; i++ )
+			Counts[Vertex( _pIndices[i], _pRemap )]++;
+		U32	Offset = 0;
+		for ( U32 i=0; i < _VerticesCount; i++ ) {
+			Offsets[i] = Offset;
+			Offset += Counts[i];
+			Counts[i] = 0;
+		}
+
+		for ( U32 i=0; i < _IndicesCount; i++ ) {
+			U32	V = Vertex( _pIndices[i], _pRemap );
+			U32	Next = i - i % 3 + (i % 3 + 1) % 3;
+			Data[Offsets[V] + Counts[V]++] = _Triangles ? i / 3 : Vertex( _pIndices[Next], _pRemap );
+		}
+	}
+
+	bool	HasEdge( U32 _From, U32 _To ) const {
+		const U32*	pTargets = Data.Ptr() + Offsets[_From];
+		for ( U32 i=0; i < Counts[_From]; i++ )
+			if ( pTargets[i] == _To )
+				return true;
+		return false;
+	}
+
+private:
+	static U32	Vertex( U32 _Index, const U32* _pRemap )	{ return _pRemap != NULL ? _pRemap[_Index] : _Index; }
+};
+
+// Finds the vertices sharing the same position: _Remap receives the lowest vertex index at each position and
+//	_Wedges links the vertices sharing a position into a circular list
+static void	BuildPositionRemap( const bfloat3* _pPositions, U32 _VerticesCount, List<U32>& _Remap, List<U32>& _Wedges, IAllocator& _Allocator ) {
+	List<U32>	Sorted( _Allocator, _VerticesCount );
+	Sorted.SetCount( _VerticesCount );
+	for ( U32 i=0; i < _VerticesCount; i++ )
+		Sorted[i] = i;
+	Sorted.SortBy( [_pPositions]( U32 a, U32 b ) {
+		const bfloat3&	A = _pPositions[a];
+		const bfloat3&	B = _pPositions[b];
+		if ( A.x != B.x ) return A.x < B.x;
+		if ( A.y != B.y ) return A.y < B.y;
+		if ( A.z != B.z ) return A.z < B.z;
+		return a < b;
+	} );
+
+	_Remap.SetCount( _VerticesCount );
+	_Wedges.SetCount( _VerticesCount );
+	for ( U32 Start=0; Start < _VerticesCount; ) {
+		U32				End = Start+1;
+		const bfloat3&	P = _pPositions[Sorted[Start]];
+		while ( End < _VerticesCount && _pPositions[Sorted[End]].x == P.x && _pPositions[Sorted[End]].y == P.y && _pPositions[Sorted[End]].z == P.z )
+			End++;
+
+		for ( U32 i=Start; i < End; i++ ) {
+			_Remap[Sorted[i]] = Sorted[Start];
+			_Wedges[Sorted[i]] = Sorted[i+1 < End ? i+1 : Start];
+		}
+		Start = End;
+	}
+}
+
+// Classifies the positions from the topology of the original mesh
+static void	ClassifyVertices( U32 _VerticesCount, const U32* _pRemap, const U32* _pWedges, const Adjacency& _VertexEdges, const Adjacency& _PositionEdges, U8* _pKinds, IAllocator& _Allocator ) {
+	List<U32>	OpenOut( _Allocator, _VerticesCount );
+	List<U32>	OpenIn( _Allocator, _VerticesCount );
+	List<U32>	SeamOut( _Allocator, _VerticesCount );
+	OpenOut.SetCount( _VerticesCount );
+	OpenIn.SetCount( _VerticesCount );
+	SeamOut.SetCount( _VerticesCount );
+	memset( OpenOut.Ptr(), 0, _VerticesCount * sizeof(U32) );
+	memset( OpenIn.Ptr(), 0, _VerticesCount * sizeof(U32) );
+	memset( SeamOut.Ptr(), 0, _VerticesCount * sizeof(U32) );
+
+	for ( U32 V=0; V < _VerticesCount; V++ ) {
+		U32			P = _pRemap[V];
+		const U32*	pTargets = _VertexEdges.Data.Ptr() + _VertexEdges.Offsets[V];
+		for ( U32 i=0; i < _VertexEdges.Counts[V]; i++ ) {
+			U32	W = pTargets[i];
+			U32	Q = _pRemap[W];
+			if ( !_PositionEdges.HasEdge( Q, P ) ) {
+				OpenOut[P]++;	// No triangle on the other side
+				OpenIn[Q]++;
+			} else if ( !_VertexEdges.HasEdge( W, V ) ) {
+				SeamOut[P]++;	// The triangle on the other side uses other vertices
+			}
+		}
+	}
+
+	for ( U32 V=0; V < _VerticesCount; V++ ) {
+		_pKinds[V] = KIND_LOCKED;
+		if ( _pRemap[V] != V )
+			continue;
+
+		U32	WedgesCount = 1;
+		for ( U32 W=_pWedges[V]; W != V; W=_pWedges[W] )
+			WedgesCount++;
+
+		// Several half-edges between the same positions means a non-manifold edge
+		bool		NonManifold = false;
+		const U32*	pTargets = _PositionEdges.Data.Ptr() + _PositionEdges.Offsets[V];
+		for ( U32 i=0; i < _PositionEdges.Counts[V]; i++ )
+			for ( U32 j=0; j < i; j++ )
+				NonManifold |= pTargets[i] == pTargets[j];
+		if ( NonManifold )
+			continue;
+
+		if ( WedgesCount == 1 && SeamOut[V] == 0 ) {
+			if ( OpenOut[V] == 0 && OpenIn[V] == 0 )
+				_pKinds[V] = KIND_MANIFOLD;
+			else if ( OpenOut[V] == 1 && OpenIn[V] == 1 )
+				_pKinds[V] = KIND_BORDER;
+		} else if ( WedgesCount == 2 && OpenOut[V] == 0 && OpenIn[V] == 0 && SeamOut[V] == 2 ) {
+			_pKinds[V] = KIND_SEAM;
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Simplification
+//
+// Each pass gathers the allowed collapses of all the edges, sorts them by error then performs as many as possible.
+// A collapse locks the vertices whose triangles it modifies so the following collapses of the pass only see up-to-date triangles.
+//
+struct	Collapse {
+	U32		Source;
+	U32		Target;
+	float	Error;
+};
+
+// Returns the copy of _Target connected to _Source by an edge, ~0U if none
+static U32	FindConnectedWedge( const Adjacency& _VertexEdges, const U32* _pWedges, U32 _Source, U32 _Target ) {
+	U32	Wedge = _Target;
+	do {
+		if ( _VertexEdges.HasEdge( _Source, Wedge ) || _VertexEdges.HasEdge( Wedge, _Source ) )
+			return Wedge;
+		Wedge = _pWedges[Wedge];
+	} while ( Wedge != _Target );
+	return ~0U;
+}
+
+// Gathers the positions sharing a triangle with a vertex or any of its copies, returns false if there are too many
+static bool	GatherNeighbors( const U32* _pIndices, const Adjacency& _Triangles, const U32* _pRemap, const U32* _pWedges, U32 _Vertex, U32* _pNeighbors, U32& _NeighborsCount ) {
+	U32	Position = _pRemap[_Vertex];
+	U32	Wedge = _Vertex;
+	_NeighborsCount = 0;
+	do {
+		for ( U32 i=0; i < _Triangles.Counts[Wedge]; i++ ) {
+			const U32*	pTriangle = _pIndices + 3 * _Triangles.Data[_Triangles.Offsets[Wedge]+i];
+			for ( U32 Corner=0; Corner < 3; Corner++ ) {
+				U32	Neighbor = _pRemap[pTriangle[Corner]];
+				U32	j = 0;
+				while ( j < _NeighborsCount && _pNeighbors[j] != Neighbor )
+					j++;
+				if ( Neighbor == Position || j < _NeighborsCount )
+					continue;
+				if ( _NeighborsCount == MAX_VALENCE )
+					return false;
+				_pNeighbors[_NeighborsCount++] = Neighbor;
+			}
+		}
+		Wedge = _pWedges[Wedge];
+	} while ( Wedge != _Vertex );
+	return true;
+}
+
+// Checks the surface stays valid after moving _Source onto _Target:
+//	. No triangle must flip
+//	. The only positions adjacent to both ends must be the third vertices of the triangles removed by the collapse
+//		(the "link condition"), otherwise the collapse would fold the surface onto itself and create non-manifold edges
+static bool	IsCollapseValid( const U32* _pIndices, const Adjacency& _Triangles, const U32* _pRemap, const U32* _pWedges, const bfloat3* _pPositions, U32 _Source, U32 _Target ) {
+	U32				SourcePosition = _pRemap[_Source];
+	U32				TargetPosition = _pRemap[_Target];
+	const bfloat3&	S = _pPositions[SourcePosition];
+	const bfloat3&	T = _pPositions[TargetPosition];
+
+	U32	RemovedTrianglesCount = 0;
+	U32	Wedge = _Source;
+	do {
+		for ( U32 i=0; i < _Triangles.Counts[Wedge]; i++ ) {
+			const U32*	pTriangle = _pIndices + 3 * _Triangles.Data[_Triangles.Offsets[Wedge]+i];
+			U32			Corner = pTriangle[0] == Wedge ? 0 : (pTriangle[1] == Wedge ? 1 : 2);
+			U32			P1 = _pRemap[pTriangle[(Corner+1)%3]];
+			U32			P2 = _pRemap[pTriangle[(Corner+2)%3]];
+			if ( P1 == TargetPosition || P2 == TargetPosition ) {
+				RemovedTrianglesCount++;
+				continue;
+			}
+
+			bfloat3	OldNormal = (_pPositions[P1] - S).Cross( _pPositions[P2] - S );
+			bfloat3	NewNormal = (_pPositions[P1] - T).Cross( _pPositions[P2] - T );
+			if ( OldNormal.Dot( NewNormal ) <= MAX_NORMAL_DEVIATION * OldNormal.Length() * NewNormal.Length() && OldNormal.LengthSq() > 0.0f )
+				return false;
+		}
+		Wedge = _pWedges[Wedge];
+	} while ( Wedge != _Source );
+
+	U32	pSourceNeighbors[MAX_VALENCE], pTargetNeighbors[MAX_VALENCE];
+	U32	SourceNeighborsCount, TargetNeighborsCount;
+	if ( !GatherNeighbors( _pIndices, _Triangles, _pRemap, _pWedges, _Source, pSourceNeighbors, SourceNeighborsCount )
+		|| !GatherNeighbors( _pIndices, _Triangles, _pRemap, _pWedges, _Target, pTargetNeighbors, TargetNeighborsCount ) )
+		return false;
+
+	U32	CommonNeighborsCount = 0;
+	for ( U32 i=0; i < SourceNeighborsCount; i++ )
+		for ( U32 j=0; j < TargetNeighborsCount; j++ )
+			if ( pSourceNeighbors[i] == pTargetNeighbors[j] )
+				CommonNeighborsCount++;
+
+	return CommonNeighborsCount <= RemovedTrianglesCount;
+}
+
+static bool	IsCollapseAllowed( U8 _SourceKind, U8 _TargetKind, bool _OpenEdge, bool _SeamEdge ) {
+	switch ( _SourceKind ) {
+	case KIND_MANIFOLD:	return true;
+	case KIND_BORDER:	return _OpenEdge && (_TargetKind == KIND_BORDER || _TargetKind == KIND_LOCKED);
+	case KIND_SEAM:		return _SeamEdge && (_TargetKind == KIND_SEAM || _TargetKind == KIND_LOCKED);
+	default:			return false;
+	}
+}
+
+U32		BaseLib::SimplifyMesh( const U32* _pIndices, U32 _IndicesCount, const void* _pPositions, U32 _VerticesCount, U32 _PositionStride, U32 _TargetIndicesCount, float _TargetError, U32* _pTarget, float* _pResultError, float* _pResultDistanceBound, IAllocator& _Allocator ) {
+	if ( _pTarget != _pIndices )
+		memcpy( _pTarget, _pIndices, _IndicesCount * sizeof(U32) );
+	if ( _pResultError != NULL )
+		*_pResultError = 0.0f;
+	if ( _pResultDistanceBound != NULL )
+		*_pResultDistanceBound = 0.0f;
+
+	U32*	pIndices = _pTarget;
+	U32		IndicesCount = _IndicesCount - _IndicesCount % 3;
+	if ( IndicesCount <= _TargetIndicesCount )
+		return IndicesCount;
+
+	// Normalize the positions in the unit cube so the quadrics keep their precision
+	bfloat3	Min( FLT_MAX, FLT_MAX, FLT_MAX ), Max( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+	for ( U32 i=0; i < IndicesCount; i++ ) {
+		ASSERT( pIndices[i] < _VerticesCount, "Index out of range!" );
+		const bfloat3&	P = *((const bfloat3*) ((const U8*) _pPositions + size_t(pIndices[i]) * _PositionStride));
+		Min = Min.Min( P );
+		Max = Max.Max( P );
+	}
+	float	Scale = MAX( MAX( Max.x - Min.x, Max.y - Min.y ), Max.z - Min.z );
+	float	InvScale = Scale > 0.0f ? 1.0f / Scale : 0.0f;
+
+	List<bfloat3>	Positions( _Allocator, _VerticesCount );
+	Positions.SetCount( _VerticesCount );
+	for ( U32 i=0; i < _VerticesCount; i++ )
+		Positions[i] = (*((const bfloat3*) ((const U8*) _pPositions + size_t(i) * _PositionStride)) - Min) * InvScale;
+
+	List<U32>	Remap( _Allocator );
+	List<U32>	Wedges( _Allocator );
+	BuildPositionRemap( Positions.Ptr(), _VerticesCount, Remap, Wedges, _Allocator );
+
+	Adjacency	VertexEdges( _Allocator );
+	Adjacency	PositionEdges( _Allocator );
+	Adjacency	Triangles( _Allocator );
+	VertexEdges.Build( pIndices, IndicesCount, NULL, _VerticesCount, false );
+	PositionEdges.Build( pIndices, IndicesCount, Remap.Ptr(), _VerticesCount, false );
+
+	List<U8>	Kinds( _Allocator, _VerticesCount );
+	Kinds.SetCount( _VerticesCount );
+	ClassifyVertices( _VerticesCount, Remap.Ptr(), Wedges.Ptr(), VertexEdges, PositionEdges, Kinds.Ptr(), _Allocator );
+
+	// Accumulate the quadrics of the triangles and of the border and seam edges at each position
+	List<Quadric>	Quadrics( _Allocator, _VerticesCount );
+	Quadrics.SetCount( _VerticesCount );
+	memset( Quadrics.Ptr(), 0, _VerticesCount * sizeof(Quadric) );
+	for ( U32 i=0; i < IndicesCount; i+=3 ) {
+		U32				P0 = Remap[pIndices[i+0]], P1 = Remap[pIndices[i+1]], P2 = Remap[pIndices[i+2]];
+		bfloat3			Normal = (Positions[P1] - Positions[P0]).Cross( Positions[P2] - Positions[P0] );
+		float			Length = Normal.Length();
+		if ( Length == 0.0f )
+			continue;
+		Normal /= Length;
+
+		Quadric	Q;
+		QuadricFromPlane( Q, Normal, -Normal.Dot( Positions[P0] ), 0.5f * Length );
+		QuadricAdd( Quadrics[P0], Q );
+		QuadricAdd( Quadrics[P1], Q );
+		QuadricAdd( Quadrics[P2], Q );
+
+		for ( U32 Corner=0; Corner < 3; Corner++ ) {
+			U32	V0 = pIndices[i+Corner];
+			U32	V1 = pIndices[i+(Corner+1)%3];
+			U32	PA = Remap[V0], PB = Remap[V1];
+			if ( PositionEdges.HasEdge( PB, PA ) && VertexEdges.HasEdge( V1, V0 ) )
+				continue;	// Neither a border nor a seam
+
+			bfloat3	Edge = Positions[PB] - Positions[PA];
+			float	EdgeLength = Edge.Length();
+			bfloat3	EdgeNormal = Edge.Cross( Normal );
+			float	EdgeNormalLength = EdgeNormal.Length();
+			if ( EdgeNormalLength == 0.0f )
+				continue;
+			EdgeNormal /= EdgeNormalLength;
+
+			QuadricFromPlane( Q, EdgeNormal, -EdgeNormal.Dot( Positions[PA] ), EDGE_QUADRIC_WEIGHT * EdgeLength * EdgeLength );
+			QuadricAdd( Quadrics[PA], Q );
+			QuadricAdd( Quadrics[PB], Q );
+		}
+	}
+
+	float	ScaledTargetError = _TargetError * InvScale;
+	float	ErrorLimit = ScaledTargetError < 1e18f ? ScaledTargetError * ScaledTargetError : FLT_MAX;
+	float	MaxError = 0.0f;
+
+	// Bound of the distance between the original and the simplified surfaces
+	// A collapse moves the points of the triangles around the source by at most the length of the collapsed edge so,
+	//	defining the bound of a triangle as the largest bound of its positions, the triangles around the target after
+	//	the collapse get the largest bound of the source triangles plus that length.
+	List<float>		Displacements( _Allocator, _VerticesCount );
+	Displacements.SetCount( _VerticesCount );
+	memset( Displacements.Ptr(), 0, _VerticesCount * sizeof(float) );
+	float	MaxDisplacement = 0.0f;
+
+	List<Collapse>	Collapses( _Allocator, IndicesCount );
+	List<Collapse>	SortedCollapses( _Allocator, IndicesCount );
+	List<U32>		CollapseRemap( _Allocator, _VerticesCount );
+	List<U8>		Locked( _Allocator, _VerticesCount );
+	CollapseRemap.SetCount( _VerticesCount );
+	Locked.SetCount( _VerticesCount );
+
+	while ( IndicesCount > _TargetIndicesCount ) {
+		VertexEdges.Build( pIndices, IndicesCount, NULL, _VerticesCount, false );
+		PositionEdges.Build( pIndices, IndicesCount, Remap.Ptr(), _VerticesCount, false );
+		Triangles.Build( pIndices, IndicesCount, NULL, _VerticesCount, true );
+
+		// Gather the cheapest allowed collapse of every edge (edges shared by 2 triangles are only visited from their lowest position)
+		Collapses.Clear();
+		for ( U32 i=0; i < IndicesCount; i++ ) {
+			U32	V0 = pIndices[i];
+			U32	V1 = pIndices[i - i % 3 + (i % 3 + 1) % 3];
+			U32	P0 = Remap[V0], P1 = Remap[V1];
+			if ( P0 == P1 )
+				continue;
+
+			bool	OpenEdge = !PositionEdges.HasEdge( P1, P0 );
+			if ( !OpenEdge && P0 > P1 )
+				continue;
+			bool	SeamEdge = !OpenEdge && !VertexEdges.HasEdge( V1, V0 );
+
+			Quadric	Q = Quadrics[P0];
+			QuadricAdd( Q, Quadrics[P1] );
+			float	Error01 = IsCollapseAllowed( Kinds[P0], Kinds[P1], OpenEdge, SeamEdge ) ? QuadricError( Q, Positions[P1] ) : FLT_MAX;
+			float	Error10 = IsCollapseAllowed( Kinds[P1], Kinds[P0], OpenEdge, SeamEdge ) ? QuadricError( Q, Positions[P0] ) : FLT_MAX;
+			if ( Error01 == FLT_MAX && Error10 == FLT_MAX )
+				continue;
+
+			Collapse&	C = Collapses.Append();
+			C.Source = Error01 <= Error10 ? V0 : V1;
+			C.Target = Error01 <= Error10 ? V1 : V0;
+			C.Error = MIN( Error01, Error10 );
+		}
+		if ( Collapses.Count() == 0 )
+			break;
+
+		SortedCollapses.SetCount( Collapses.Count() );
+		const Collapse*	pSortedCollapses = RadixSort32( Collapses.Ptr(), Collapses.Count(), []( const Collapse& _C ) { return SortKey( _C.Error ); }, SortedCollapses.Ptr() );
+		if ( pSortedCollapses != Collapses.Ptr() )
+			memcpy( Collapses.Ptr(), pSortedCollapses, Collapses.Count() * sizeof(Collapse) );
+
+		// Don't let a pass reach for expensive collapses while cheaper ones may appear in the next pass
+		U32		TrianglesToRemove = (IndicesCount - _TargetIndicesCount + 2) / 3;
+		float	PassLimit = MIN( ErrorLimit, 1.5f * Collapses[MIN( Collapses.Count()-1, TrianglesToRemove )].Error );
+
+		U32	CollapsesCount = 0;
+		for ( U32 Attempt=0; Attempt < 2 && CollapsesCount == 0; Attempt++ ) {
+			if ( Attempt == 1 ) {
+				if ( PassLimit >= ErrorLimit )
+					break;
+				PassLimit = ErrorLimit;	// Nothing could collapse under the pass limit, allow everything
+			}
+
+			for ( U32 i=0; i < _VerticesCount; i++ )
+				CollapseRemap[i] = i;
+			memset( Locked.Ptr(), 0, _VerticesCount );
+
+			U32	RemovedTrianglesCount = 0;
+			for ( U32 CollapseIndex=0; CollapseIndex < Collapses.Count() && RemovedTrianglesCount < TrianglesToRemove; CollapseIndex++ ) {
+				const Collapse&	C = Collapses[CollapseIndex];
+				if ( C.Error > PassLimit )
+					break;
+
+				U32	SourcePosition = Remap[C.Source];
+				U32	TargetPosition = Remap[C.Target];
+				if ( Locked[SourcePosition] || Locked[TargetPosition] )
+					continue;
+
+				if ( !IsCollapseValid( pIndices, Triangles, Remap.Ptr(), Wedges.Ptr(), Positions.Ptr(), C.Source, C.Target ) )
+					continue;
+
+				// Collapse both copies of a seam vertex onto the copies of the target on the same side of the seam
+				if ( Kinds[SourcePosition] == KIND_SEAM ) {
+					U32	OtherSource = Wedges[C.Source];
+					U32	OtherTarget = FindConnectedWedge( VertexEdges, Wedges.Ptr(), OtherSource, C.Target );
+					if ( OtherTarget == ~0U )
+						continue;
+					CollapseRemap[C.Source] = C.Target;
+					CollapseRemap[OtherSource] = OtherTarget;
+				} else {
+					CollapseRemap[C.Source] = C.Target;
+				}
+
+				QuadricAdd( Quadrics[TargetPosition], Quadrics[SourcePosition] );
+				MaxError = MAX( MaxError, C.Error );
+				RemovedTrianglesCount += Kinds[SourcePosition] == KIND_BORDER ? 1 : 2;
+				CollapsesCount++;
+
+				// Lock all the positions of the modified triangles and grow the distance bound of the target
+				float	Displacement = 0.0f;
+				U32		Wedge = C.Source;
+				do {
+					for ( U32 j=0; j < Triangles.Counts[Wedge]; j++ ) {
+						const U32*	pTriangle = pIndices + 3 * Triangles.Data[Triangles.Offsets[Wedge]+j];
+						for ( U32 Corner=0; Corner < 3; Corner++ ) {
+							Locked[Remap[pTriangle[Corner]]] = 1;
+							Displacement = MAX( Displacement, Displacements[Remap[pTriangle[Corner]]] );
+						}
+					}
+					Wedge = Wedges[Wedge];
+				} while ( Wedge != C.Source );
+				Locked[TargetPosition] = 1;
+
+				Displacement += (Positions[TargetPosition] - Positions[SourcePosition]).Length();
+				Displacements[TargetPosition] = MAX( Displacements[TargetPosition], Displacement );
+				MaxDisplacement = MAX( MaxDisplacement, Displacement );
+			}
+		}
+		if ( CollapsesCount == 0 )
+			break;	// Can't simplify any further within the error limit
+
+		// Apply the collapses and remove the degenerate triangles
+		U32	NewIndicesCount = 0;
+		for ( U32 i=0; i < IndicesCount; i+=3 ) {
+			U32	V0 = CollapseRemap[pIndices[i+0]];
+			U32	V1 = CollapseRemap[pIndices[i+1]];
+			U32	V2 = CollapseRemap[pIndices[i+2]];
+			if ( Remap[V0] == Remap[V1] || Remap[V1] == Remap[V2] || Remap[V2] == Remap[V0] )
+				continue;
+			pIndices[NewIndicesCount++] = V0;
+			pIndices[NewIndicesCount++] = V1;
+			pIndices[NewIndicesCount++] = V2;
+		}
+		IndicesCount = NewIndicesCount;
+	}
+
+	if ( _pResultError != NULL )
+		*_pResultError = sqrtf( MaxError ) * Scale;
+	if ( _pResultDistanceBound != NULL )
+		*_pResultDistanceBound = MaxDisplacement * Scale;
+
+	return IndicesCount;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// LOD chains
+//
+U32		BaseLib::BuildLODChain( const U32* _pIndices, U32 _IndicesCount, const void* _pPositions, U32 _VerticesCount, U32 _PositionStride, List<U32>& _LODIndices, List<MeshLOD>& _LODs, U32 _MaxLODsCount, float _Reduction, IAllocator& _Allocator ) {
+	List<U32>	Simplified( _Allocator, _IndicesCount );
+	U32			FirstLOD = _LODs.Count();
+	U32			SourceOffset = ~0U;
+	U32			SourceCount = _IndicesCount;
+	float		Error = 0.0f;
+	for ( U32 LODIndex=0; LODIndex < _MaxLODsCount; LODIndex++ ) {
+		U32	TargetCount = 3 * U32( _Reduction * (SourceCount / 3) );
+		if ( TargetCount < 3 * MIN_LOD_TRIANGLES )
+			break;
+
+		const U32*	pSource = SourceOffset != ~0U ? _LODIndices.Ptr() + SourceOffset : _pIndices;
+		float		LODDistanceBound = 0.0f;
+		Simplified.SetCount( SourceCount );
+		U32			SimplifiedCount = SimplifyMesh( pSource, SourceCount, _pPositions, _VerticesCount, _PositionStride, TargetCount, FLT_MAX, Simplified.Ptr(), NULL, &LODDistanceBound, _Allocator );
+		if ( 10 * U64(SimplifiedCount) > 9 * U64(SourceCount) )
+			break;	// Stalled on locked vertices
+
+		OptimizeVertexCache( Simplified.Ptr(), SimplifiedCount, _VerticesCount, VERTEX_CACHE_SIZE, NULL, _Allocator );
+
+		// The distance bounds of successive simplifications add up (triangle inequality)
+		Error += LODDistanceBound;
+
+		MeshLOD&	LOD = _LODs.Append();
+		LOD.IndicesOffset = _LODIndices.Count();
+		LOD.IndicesCount = SimplifiedCount;
+		LOD.Error = Error;
+		_LODIndices.Append( Simplified.Ptr(), SimplifiedCount );
+
+		SourceOffset = LOD.IndicesOffset;
+		SourceCount = SimplifiedCount;
+	}
+
+	return _LODs.Count() - FirstLOD;
+}
+
+U32		BaseLib::SelectLOD( const MeshLOD* _pLODs, U32 _LODsCount, float _Distance, float _ProjectionScale, float _MaxPixelError ) {
+	float	MaxError = _MaxPixelError * MAX( 0.0f, _Distance ) / _ProjectionScale;	// Largest error allowed at that distance
+	U32		Selected = 0;
+	for ( U32 i=0; i < _LODsCount && _pLODs[i].Error <= MaxError; i++ )
+		Selected = i+1;
+	return Selected;
+}
@@ -0,0 +1,63 @@
+//////////////////////////////////////////////////////////////////////////
+// Mesh simplification and LOD chains
+//
+// SimplifyMesh() collapses edges in order of increasing quadric error (Garland & Heckbert 1997, "Surface Simplification Using Quadric Error Metrics").
+// Collapses are restricted to existing vertices so the vertex buffer is shared by all the LODs and only new index buffers are produced.
+//
+// Vertices sharing a position but not their attributes (i.e. normal or UV seams) are recognized and kept consistent:
+//	. A vertex inside a smooth region can collapse onto any neighbor
+//	. A vertex on an open border can only slide along the border
+//	. A vertex on a seam can only slide along the seam, all its copies collapsing together
+//	. Seam ends, seam crossings and non-manifold vertices never move
+// Borders and seams are also weighted in the quadrics so the simplified mesh follows them closely.
+//
+// Errors are distances in the units of the positions:
+//	. The quadric error driving the simplification is the RMS distance to the planes of the original triangles around the worst vertex.
+//		The largest deviation from the original surface is usually 2 to 4 times that.
+//	. The distance bound is a conservative bound of the largest distance between the original and the simplified surfaces,
+//		accumulated from the lengths of the collapsed edges. LODs store it so SelectLOD() never underestimates the screen error.
+// SelectLOD() converts LOD errors into pixels to find the coarsest LOD that stays under a given screen error.
+//
+#pragma once
+
+#include "../Types.h"
+#include "Allocator.h"
+#include "../Containers/List.h"
+
+namespace BaseLib {
+
+struct	MeshLOD {
+	U32		IndicesOffset;		// Offset of the first index in the LOD indices list
+	U32		IndicesCount;
+	float	Error;				// Bound of the largest distance to the full detail mesh (not the quadric error, see above)
+};
+
+static const U32	MAX_MESH_LODS = 8;
+static const U32	MIN_LOD_TRIANGLES = 32;	// LOD chains stop before going below that amount of triangles
+
+
+//////////////////////////////////////////////////////////////////////////
+// Simplifies a triangle list down to _TargetIndicesCount indices, or less if the error would exceed _TargetError
+//	_pTarget must have room for _IndicesCount indices (it can be _pIndices)
+//	_TargetError is compared to the quadric error
+//	_pResultError optionally receives the quadric error of the simplified mesh
+//	_pResultDistanceBound optionally receives the distance bound of the simplified mesh
+// Positions are read as 3 floats every _PositionStride bytes, returns the amount of indices written to _pTarget
+U32		SimplifyMesh( const U32* _pIndices, U32 _IndicesCount, const void* _pPositions, U32 _VerticesCount, U32 _PositionStride, U32 _TargetIndicesCount, float _TargetError, U32* _pTarget, float* _pResultError=NULL, float* _pResultDistanceBound=NULL, IAllocator& _Allocator=GetDefaultAllocator() );
+
+// Builds a chain of up to _MaxLODsCount LODs, each one having about _Reduction times the triangles of the previous one
+// Each LOD is simplified from the previous one and its indices are optimized for the vertex cache (the full detail mesh should be optimized first)
+// The error of each LOD is the sum of the distance bounds of the simplifications leading to it
+// The chain stops early when a LOD would have less than MIN_LOD_TRIANGLES triangles or can't be simplified further
+// Returns the amount of LODs appended to _LODs, the full detail mesh is not part of the chain
+U32		BuildLODChain( const U32* _pIndices, U32 _IndicesCount, const void* _pPositions, U32 _VerticesCount, U32 _PositionStride, List<U32>& _LODIndices, List<MeshLOD>& _LODs, U32 _MaxLODsCount=MAX_MESH_LODS, float _Reduction=0.5f, IAllocator& _Allocator=GetDefaultAllocator() );
+
+// Returns the factor converting an error at a distance of 1 into pixels, for a perspective projection
+inline float	ComputeLODProjectionScale( float _ViewportHeight, float _FOVY )	{ return 0.5f * _ViewportHeight / tanf( 0.5f * _FOVY ); }
+
+// Selects the coarsest LOD whose projected error stays below _MaxPixelError
+//	_Distance, the distance from the camera to the mesh (use the distance to the bounding sphere to be conservative), in the units of the LOD errors
+// Returns 0 for the full detail mesh or i+1 for _pLODs[i]
+U32		SelectLOD( const MeshLOD* _pLODs, U32 _LODsCount, float _Distance, float _ProjectionScale, float _MaxPixelError );
+
+}	// namespace BaseLib
@@ -0,0 +1,104 @@
+//////////////////////////////////////////////////////////////////////////
+// Parallel helpers
+//
+// Simple fork/join helpers running a functor over a range of indices on all the hardware threads.
+// The calling thread takes part in the work and the call only returns once all indices have been processed.
+//
+// The functor can be any class implementing:
+//	void	operator()( U32 _Index );
+//
+// Indices are handed out in batches of _GrainSize through an atomic counter, so work is dynamically balanced across threads.
+// The functor is shared by all threads and must be thread-safe!
+//
+#pragma once
+
+#include "../Types.h"
+#include "Allocator.h"
+
+#ifndef _WINDOWS_
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif
+
+namespace BaseLib {
+
+static const U32	MAX_PARALLEL_THREADS = 64;	// Limited by WaitForMultipleObjects()
+
+// Returns the amount of hardware threads available
+inline U32	GetHardwareThreadsCount() {
+	static U32	ThreadsCount = 0;
+	if ( ThreadsCount == 0 ) {
+		SYSTEM_INFO	Info;
+		GetSystemInfo( &Info );
+		ThreadsCount = Info.dwNumberOfProcessors > 0 ? Info.dwNumberOfProcessors : 1;
+		if ( ThreadsCount > MAX_PARALLEL_THREADS )
+			ThreadsCount = MAX_PARALLEL_THREADS;
+	}
+	return ThreadsCount;
+}
+
+template< typename F > struct	ParallelForJob {
+	F*				pFunctor;
+	U32				Count;
+	U32				GrainSize;
+	volatile LONG	NextIndex;
+
+	void	Run() {
+		while ( true ) {
+			U32	StartIndex = U32( InterlockedExchangeAdd( &NextIndex, LONG(GrainSize) ) );
+			if ( StartIndex >= Count )
+				break;
+			U32	EndIndex = StartIndex + GrainSize < Count ? StartIndex + GrainSize : Count;
+			for ( U32 Index=StartIndex; Index < EndIndex; Index++ )
+				(*pFunctor)( Index );
+		}
+	}
+
+	static DWORD WINAPI	ThreadProc( LPVOID _pJob ) {
+		((ParallelForJob<F>*) _pJob)->Run();
+		ReleaseThreadArena();
+		return 0;
+	}
+};
+
+// Calls _Functor( Index ) for every Index in [0,_Count)
+//	_GrainSize, the amount of consecutive indices processed by a thread each time it fetches work
+//	_MaxThreadsCount, the maximum amount of threads to use (0 to use all hardware threads)
+template< typename F > void	ParallelFor( U32 _Count, F& _Functor, U32 _GrainSize=1, U32 _MaxThreadsCount=0 ) {
+	if ( _Count == 0 )
+		return;
+	if ( _GrainSize == 0 )
+		_GrainSize = 1;
+
+	ParallelForJob<F>	Job;
+	Job.pFunctor = &_Functor;
+	Job.Count = _Count;
+	Job.GrainSize = _GrainSize;
+	Job.NextIndex = 0;
+
+	U32	ThreadsCount = GetHardwareThreadsCount();
+	if ( _MaxThreadsCount > 0 && _MaxThreadsCount < ThreadsCount )
+		ThreadsCount = _MaxThreadsCount;
+	U32	BatchesCount = (_Count + _GrainSize - 1) / _GrainSize;
+	if ( BatchesCount < ThreadsCount )
+		ThreadsCount = BatchesCount;
+
+	// Spawn additional threads (the calling thread is the first worker)
+	HANDLE	pThreads[MAX_PARALLEL_THREADS];
+	U32		SpawnedThreadsCount = 0;
+	for ( U32 ThreadIndex=1; ThreadIndex < ThreadsCount; ThreadIndex++ ) {
+		HANDLE	hThread = CreateThread( NULL, 0, ParallelForJob<F>::ThreadProc, &Job, 0, NULL );
+		if ( hThread != NULL )
+			pThreads[SpawnedThreadsCount++] = hThread;
+	}
+
+	Job.Run();
+
+	if ( SpawnedThreadsCount > 0 ) {
+		WaitForMultipleObjects( SpawnedThreadsCount, pThreads, TRUE, INFINITE );
+		for ( U32 ThreadIndex=0; ThreadIndex < SpawnedThreadsCount; ThreadIndex++ )
+			CloseHandle( pThreads[ThreadIndex] );
+	}
+}
+
+}	// namespace BaseLib
@@ -1,45 +1,608 @@
 #include "../Types.h"
+#include "Compression.h"
 
+#include <stddef.h>	// offsetof
+
+#ifndef _WINDOWS_
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif
+
+using namespace BaseLib;
+
+//////////////////////////////////////////////////////////////////////////
+// Buffered file stream
+//
+FileStream::FileStream( const char* _fileName, MODE _mode, U32 _bufferSize )
+	: m_hFile( NULL )
+	, m_mode( _mode )
+	, m_pBuffer( NULL )
+	, m_bufferSize( _bufferSize )
+	, m_bufferPosition( 0 )
+	, m_bufferOffset( 0 )
+	, m_bufferCount( 0 )
+	, m_filePosition( 0 )
+	, m_length( 0 )
+{
+	HANDLE	hFile = _mode == READ	? CreateFileA( _fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL )
+									: CreateFileA( _fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return;
+
+	m_hFile = hFile;
+	if ( _mode == READ ) {
+		LARGE_INTEGER	Size;
+		if ( GetFileSizeEx( hFile, &Size ) )
+			m_length = Size.QuadPart;
+	}
+	m_pBuffer = new U8[m_bufferSize];
+}
+
+FileStream::~FileStream() {
+	if ( m_hFile == NULL )
+		return;
+
+	Flush();
+	CloseHandle( m_hFile );
+	delete[] m_pBuffer;
+}
+
+void	FileStream::Flush() {
+	if ( m_mode != WRITE || m_bufferOffset == 0 )
+		return;
+
+	WriteAt( m_bufferPosition, m_bufferOffset, m_pBuffer );
+	m_bufferPosition += m_bufferOffset;
+	m_bufferOffset = 0;
+}
+
+void	FileStream::SetPosition( U64 _position ) {
+	if ( m_mode == READ && _position >= m_bufferPosition && _position <= m_bufferPosition + m_bufferCount ) {
+		m_bufferOffset = U32( _position - m_bufferPosition );	// Still in the buffer
+		return;
+	}
+
+	Flush();
+	m_bufferPosition = _position;
+	m_bufferOffset = 0;
+	m_bufferCount = 0;
+}
+
+U64		FileStream::Length() const {
+	return m_mode == READ ? m_length : MAX( m_length, Position() );
+}
+
+U32		FileStream::Read( U32 _count, void* _container ) {
+	ASSERT( m_mode == READ, "Stream is write-only!" );
+	if ( m_hFile == NULL )
+		return 0;
+
+	// Read what's left in the buffer
+	U8*	pTarget = (U8*) _container;
+	U32	Available = m_bufferCount - m_bufferOffset;
+	U32	Count = MIN( Available, _count );
+	memcpy( pTarget, m_pBuffer + m_bufferOffset, Count );
+	m_bufferOffset += Count;
+	if ( Count == _count )
+		return Count;
+
+	pTarget += Count;
+	_count -= Count;
+	m_bufferPosition += m_bufferOffset;
+	m_bufferOffset = 0;
+	m_bufferCount = 0;
+
+	if ( _count >= m_bufferSize ) {
+		// Large reads go straight to the container
+		U32	ReadCount = ReadAt( m_bufferPosition, _count, pTarget );
+		m_bufferPosition += ReadCount;
+		return Count + ReadCount;
+	}
+
+	// Refill the buffer
+	m_bufferCount = ReadAt( m_bufferPosition, m_bufferSize, m_pBuffer );
+	m_bufferOffset = MIN( m_bufferCount, _count );
+	memcpy( pTarget, m_pBuffer, m_bufferOffset );
+	return Count + m_bufferOffset;
+}
+
+void	FileStream::Write( U32 _count, const void* _container ) {
+	ASSERT( m_mode == WRITE, "Stream is read-only!" );
+	if ( m_hFile == NULL )
+		return;
+
+	if ( m_bufferOffset + _count <= m_bufferSize ) {
+		memcpy( m_pBuffer + m_bufferOffset, _container, _count );
+		m_bufferOffset += _count;
+		return;
+	}
+
+	Flush();
+	if ( _count >= m_bufferSize ) {
+		// Large writes go straight to the file
+		WriteAt( m_bufferPosition, _count, _container );
+		m_bufferPosition += _count;
+		return;
+	}
+
+	memcpy( m_pBuffer, _container, _count );
+	m_bufferOffset = _count;
+}
+
+U32		FileStream::ReadAt( U64 _position, U32 _count, void* _container ) {
+	if ( _position != m_filePosition ) {
+		LARGE_INTEGER	Distance;
+		Distance.QuadPart = _position;
+		SetFilePointerEx( m_hFile, Distance, NULL, FILE_BEGIN );
+		m_filePosition = _position;
+	}
+
+	DWORD	ReadCount = 0;
+	::ReadFile( m_hFile, _container, _count, &ReadCount, NULL );
+	m_filePosition += ReadCount;
+	return ReadCount;
+}
+
+void	FileStream::WriteAt( U64 _position, U32 _count, const void* _container ) {
+	if ( _position != m_filePosition ) {
+		LARGE_INTEGER	Distance;
+		Distance.QuadPart = _position;
+		SetFilePointerEx( m_hFile, Distance, NULL, FILE_BEGIN );
+		m_filePosition = _position;
+	}
+
+	DWORD	WrittenCount = 0;
+	::WriteFile( m_hFile, _container, _count, &WrittenCount, NULL );
+	ASSERT( WrittenCount == _count, "Failed to write to file!" );
+	m_filePosition += WrittenCount;
+	m_length = MAX( m_length, m_filePosition );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Memory-mapped file stream
+//
+MappedFileStream::MappedFileStream( const char* _fileName )
+	: m_hFile( NULL )
+	, m_hMapping( NULL )
+	, m_pData( NULL )
+	, m_length( 0 )
+	, m_position( 0 )
+{
+	HANDLE	hFile = CreateFileA( _fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return;
+
+	LARGE_INTEGER	Size;
+	if ( !GetFileSizeEx( hFile, &Size ) ) {
+		CloseHandle( hFile );
+		return;
+	}
+	m_hFile = hFile;
+	if ( Size.QuadPart == 0 )
+		return;	// Empty files can't be mapped
+
+	m_hMapping = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( m_hMapping != NULL )
+		m_pData = (const U8*) MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( m_pData == NULL ) {
+		// Mapping failed (e.g. the file doesn't fit in the address space)
+		if ( m_hMapping != NULL )
+			CloseHandle( m_hMapping );
+		CloseHandle( hFile );
+		m_hMapping = NULL;
+		m_hFile = NULL;
+		return;
+	}
+	m_length = Size.QuadPart;
+}
+
+MappedFileStream::~MappedFileStream() {
+	if ( m_pData != NULL )
+		UnmapViewOfFile( m_pData );
+	if ( m_hMapping != NULL )
+		CloseHandle( m_hMapping );
+	if ( m_hFile != NULL )
+		CloseHandle( m_hFile );
+}
+
+const void*	MappedFileStream::Map( U32 _count ) {
+	if ( m_position + _count > m_length ) {
+		ASSERT( false, "Mapping past the end of the file!" );
+		return NULL;
+	}
+
+	const void*	pResult = m_pData + m_position;
+	m_position += _count;
+	return pResult;
+}
+
+void	MappedFileStream::SetPosition( U64 _position ) {
+	m_position = MIN( _position, m_length );
+}
+
+U32		MappedFileStream::Read( U32 _count, void* _container ) {
+	U32	Count = U32( MIN( U64(_count), m_length - m_position ) );
+	memcpy( _container, m_pData + m_position, Count );
+	m_position += Count;
+	return Count;
+}
+
+void	MappedFileStream::Write( U32 _count, const void* _container ) {
+	ASSERT( false, "Mapped file streams are read-only!" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Memory stream
+//
+MemoryStream::MemoryStream( IAllocator& _allocator )
+	: m_allocator( _allocator )
+	, m_pData( NULL )
+	, m_length( 0 )
+	, m_capacity( 0 )
+	, m_position( 0 )
+	, m_ownsData( true )
+{
+}
+
+MemoryStream::MemoryStream( const void* _pData, U64 _length )
+	: m_allocator( GetDefaultAllocator() )
+	, m_pData( (U8*) _pData )
+	, m_length( _length )
+	, m_capacity( _length )
+	, m_position( 0 )
+	, m_ownsData( false )
+{
+}
+
+MemoryStream::~MemoryStream() {
+	if ( m_ownsData )
+		m_allocator.Free( m_pData, size_t(m_capacity), 16 );
+}
+
+void	MemoryStream::Reserve( U64 _capacity ) {
+	ASSERT( m_ownsData, "Memory stream is read-only!" );
+	if ( _capacity <= m_capacity )
+		return;
+
+	m_pData = (U8*) m_allocator.Reallocate( m_pData, size_t(m_capacity), size_t(_capacity), 16 );
+	m_capacity = _capacity;
+}
+
+const void*	MemoryStream::Map( U32 _count ) {
+	if ( m_position + _count > m_length ) {
+		ASSERT( false, "Mapping past the end of the stream!" );
+		return NULL;
+	}
+
+	const void*	pResult = m_pData + m_position;
+	m_position += _count;
+	return pResult;
+}
+
+void	MemoryStream::SetPosition( U64 _position ) {
+	m_position = m_ownsData ? _position : MIN( _position, m_length );	// Writable streams can seek past the end, the gap is zeroed on next write
+}
+
+U32		MemoryStream::Read( U32 _count, void* _container ) {
+	if ( m_position >= m_length )
+		return 0;
+
+	U32	Count = U32( MIN( U64(_count), m_length - m_position ) );
+	memcpy( _container, m_pData + m_position, Count );
+	m_position += Count;
+	return Count;
+}
+
+void	MemoryStream::Write( U32 _count, const void* _container ) {
+	if ( !m_ownsData ) {
+		ASSERT( false, "Memory stream is read-only!" );
+		return;
+	}
+
+	U64	End = m_position + _count;
+	if ( End > m_capacity )
+		Reserve( MAX( End, MAX( 2 * m_capacity, U64(256) ) ) );
+	if ( m_position > m_length )
+		memset( m_pData + m_length, 0, size_t(m_position - m_length) );
+
+	memcpy( m_pData + m_position, _container, _count );
+	m_position = End;
+	m_length = MAX( m_length, End );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// LZ4-compressed stream
+//
+static const U32	COMPRESSED_STREAM_MAGIC = 0x42345A4C;	// "LZ4B"
+
+struct	CompressedStreamHeader {
+	U32		Magic;
+	U32		BlockSize;
+	U64		Length;			// Total uncompressed size
+};
+
+struct	CompressedBlockHeader {
+	U32		Size;			// Uncompressed size
+	U32		StoredSize;		// Compressed size, equal to Size if the block is stored raw
+};
+
+CompressedStream::CompressedStream( Stream& _base, MODE _mode, U32 _blockSize )
+	: m_base( _base )
+	, m_mode( _mode )
+	, m_basePosition( _base.Position() )
+	, m_blockSize( _blockSize )
+	, m_pBlock( NULL )
+	, m_pCompressedBlock( NULL )
+	, m_blockOffset( 0 )
+	, m_blockCount( 0 )
+	, m_blockPosition( 0 )
+	, m_length( 0 )
+{
+	CompressedStreamHeader	Header;
+	if ( _mode == READ ) {
+		if ( m_base.Read( sizeof(Header), &Header ) != sizeof(Header) || Header.Magic != COMPRESSED_STREAM_MAGIC ) {
+			ASSERT( false, "Not a compressed stream!" );
+			return;
+		}
+		m_blockSize = Header.BlockSize;
+		m_length = Header.Length;
+	} else {
+		Header.Magic = COMPRESSED_STREAM_MAGIC;
+		Header.BlockSize = m_blockSize;
+		Header.Length = 0;	// Patched by Close()
+		m_base.Write( sizeof(Header), &Header );
+	}
+
+	m_pBlock = new U8[m_blockSize];
+	m_pCompressedBlock = new U8[LZ4CompressBound( m_blockSize )];
+}
+
+CompressedStream::~CompressedStream() {
+	Close();
+}
+
+void	CompressedStream::Close() {
+	if ( m_pBlock == NULL )
+		return;
+
+	if ( m_mode == WRITE ) {
+		WriteBlock();
+
+		U64	End = m_base.Position();
+		m_base.SetPosition( m_basePosition + offsetof( CompressedStreamHeader, Length ) );
+		m_base.Write( sizeof(U64), &m_blockPosition );
+		m_base.SetPosition( End );
+	}
+
+	SAFE_DELETE_ARRAY( m_pBlock );
+	SAFE_DELETE_ARRAY( m_pCompressedBlock );
+}
+
+void	CompressedStream::SetPosition( U64 _position ) {
+	if ( m_mode == WRITE ) {
+		ASSERT( _position == Position(), "Compressed streams can't seek in write mode!" );
+		return;
+	}
+	if ( m_pBlock == NULL )
+		return;
+
+	if ( _position < m_blockPosition ) {
+		// Restart from the first block
+		m_base.SetPosition( m_basePosition + sizeof(CompressedStreamHeader) );
+		m_blockPosition = 0;
+		m_blockOffset = 0;
+		m_blockCount = 0;
+	}
+	while ( _position >= m_blockPosition + m_blockCount && ReadBlock() );
+
+	m_blockOffset = U32( MIN( _position - m_blockPosition, U64(m_blockCount) ) );
+}
+
+U32		CompressedStream::Read( U32 _count, void* _container ) {
+	ASSERT( m_mode == READ, "Stream is write-only!" );
+	if ( m_pBlock == NULL )
+		return 0;
+
+	U8*	pTarget = (U8*) _container;
+	U32	Total = 0;
+	while ( _count > 0 ) {
+		if ( m_blockOffset == m_blockCount && !ReadBlock() )
+			break;
+
+		U32	Count = MIN( m_blockCount - m_blockOffset, _count );
+		memcpy( pTarget, m_pBlock + m_blockOffset, Count );
+		m_blockOffset += Count;
+		pTarget += Count;
+		_count -= Count;
+		Total += Count;
+	}
+	return Total;
+}
+
+void	CompressedStream::Write( U32 _count, const void* _container ) {
+	ASSERT( m_mode == WRITE, "Stream is read-only!" );
+	if ( m_pBlock == NULL )
+		return;
+
+	const U8*	pSource = (const U8*) _container;
+	while ( _count > 0 ) {
+		U32	Count = MIN( m_blockSize - m_blockOffset, _count );
+		memcpy( m_pBlock + m_blockOffset, pSource, Count );
+		m_blockOffset += Count;
+		pSource += Count;
+		_count -= Count;
+		if ( m_blockOffset == m_blockSize )
+			WriteBlock();
+	}
+}
+
+bool	CompressedStream::ReadBlock() {
+	m_blockPosition += m_blockCount;
+	m_blockOffset = 0;
+	m_blockCount = 0;
+
+	CompressedBlockHeader	Header;
+	if ( m_base.Read( sizeof(Header), &Header ) != sizeof(Header) )
+		return false;	// End of stream
+	if ( Header.Size > m_blockSize || Header.StoredSize > LZ4CompressBound( m_blockSize ) ) {
+		ASSERT( false, "Corrupted compressed stream!" );
+		return false;
+	}
+
+	if ( Header.StoredSize == Header.Size ) {
+		if ( m_base.Read( Header.Size, m_pBlock ) != Header.Size )
+			return false;
+	} else {
+		if ( m_base.Read( Header.StoredSize, m_pCompressedBlock ) != Header.StoredSize )
+			return false;
+		if ( LZ4Decompress( m_pCompressedBlock, Header.StoredSize, m_pBlock, m_blockSize ) != Header.Size ) {
+			ASSERT( false, "Corrupted compressed stream!" );
+			return false;
+		}
+	}
+	m_blockCount = Header.Size;
+	return m_blockCount > 0;
+}
+
+void	CompressedStream::WriteBlock() {
+	if ( m_blockOffset == 0 )
+		return;
+
+	CompressedBlockHeader	Header;
+	Header.Size = m_blockOffset;
+	Header.StoredSize = LZ4Compress( m_pBlock, m_blockOffset, m_pCompressedBlock, m_blockOffset - 1 );	// Only keep the compressed data if it's smaller
+	if ( Header.StoredSize == 0 ) {
+		Header.StoredSize = Header.Size;
+		m_base.Write( sizeof(Header), &Header );
+		m_base.Write( Header.Size, m_pBlock );
+	} else {
+		m_base.Write( sizeof(Header), &Header );
+		m_base.Write( Header.StoredSize, m_pCompressedBlock );
+	}
+
+	m_blockPosition += m_blockOffset;
+	m_blockOffset = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Endianness
+//
+void	ByteSwap( void* _pArray, U32 _count, U32 _elementSize ) {
+	switch ( _elementSize ) {
+	case 2: {
+		U16*	p = (U16*) _pArray;
+		for ( U32 i=0; i < _count; i++ )
+			p[i] = ByteSwap( p[i] );
+		break;
+	}
+	case 4: {
+		U32*	p = (U32*) _pArray;
+		for ( U32 i=0; i < _count; i++ )
+			p[i] = ByteSwap( p[i] );
+		break;
+	}
+	case 8: {
+		U64*	p = (U64*) _pArray;
+		for ( U32 i=0; i < _count; i++ )
+			p[i] = ByteSwap( p[i] );
+		break;
+	}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////
 // Read Functions
 U8			BinaryReader::ReadByte() const {
-	U8	temp;
-	m_stream.Read( sizeof(temp), &temp );
+	U8	temp = 0;
+	ReadScalar( sizeof(temp), &temp );
 	return temp;
 }
 U16			BinaryReader::ReadUInt16() const {
-	U16	temp;
-	m_stream.Read( sizeof(temp), &temp );
+	U16	temp = 0;
+	ReadScalar( sizeof(temp), &temp );
 	return temp;
 }
 U32			BinaryReader::ReadUInt32() const {
-	U32	temp;
-	m_stream.Read( sizeof(temp), &temp );
+	U32	temp = 0;
+	ReadScalar( sizeof(temp), &temp );
+	return temp;
+}
+U64			BinaryReader::ReadUInt64() const {
+	U64	temp = 0;
+	ReadScalar( sizeof(temp), &temp );
 	return temp;
 }
 float		BinaryReader::ReadSingle() const {
-	float	temp;
-	m_stream.Read( sizeof(temp), &temp );
+	float	temp = 0.0f;
+	ReadScalar( sizeof(temp), &temp );
 	return temp;
 }
 double		BinaryReader::ReadDouble() const {
-	double	temp;
-	m_stream.Read( sizeof(temp), &temp );
+	double	temp = 0.0;
+	ReadScalar( sizeof(temp), &temp );
 	return temp;
 }
 
+void		BinaryReader::ReadScalar( U32 _size, void* _pValue ) const {
+	U32	count = m_stream.Read( _size, _pValue );
+	ASSERT( count == _size, "Unexpected end of stream!" );
+	if ( m_swapBytes )
+		ByteSwap( _pValue, 1, _size );
+}
+
 // Write Functions
 void	BinaryWriter::Write( const U8& _value ) const {
-
+	WriteScalar( sizeof(_value), &_value );
 }
 void	BinaryWriter::Write( const U16& _value ) const {
-
+	WriteScalar( sizeof(_value), &_value );
 }
 void	BinaryWriter::Write( const U32& _value ) const {
-
+	WriteScalar( sizeof(_value), &_value );
+}
+void	BinaryWriter::Write( const U64& _value ) const {
+	WriteScalar( sizeof(_value), &_value );
 }
 void	BinaryWriter::Write( const float& _value ) const {
-
+	WriteScalar( sizeof(_value), &_value );
 }
 void	BinaryWriter::Write( const double& _value ) const {
+	WriteScalar( sizeof(_value), &_value );
+}
+
+void	BinaryWriter::WriteScalar( U32 _size, const void* _pValue ) const {
+	if ( !m_swapBytes ) {
+		m_stream.Write( _size, _pValue );
+		return;
+	}
+
+	U64	temp;
+	memcpy( &temp, _pValue, _size );
+	ByteSwap( &temp, 1, _size );
+	m_stream.Write( _size, &temp );
+}
+
+void	BinaryWriter::WriteArray( const void* _pArray, U32 _count, U32 _scalarSize ) const {
+	if ( !m_swapBytes || _scalarSize == 1 ) {
+		m_stream.Write( _count * _scalarSize, _pArray );
+		return;
+	}
 
+	// Swap bytes in chunks
+	U64			pChunk[512];
+	const U8*	pSource = (const U8*) _pArray;
+	U32			chunkCount = sizeof(pChunk) / _scalarSize;
+	while ( _count > 0 ) {
+		U32	count = MIN( chunkCount, _count );
+		memcpy( pChunk, pSource, count * _scalarSize );
+		ByteSwap( pChunk, count, _scalarSize );
+		m_stream.Write( count * _scalarSize, pChunk );
+		pSource += count * _scalarSize;
+		_count -= count;
+	}
 }
@@ -1,44 +1,286 @@
 //////////////////////////////////////////////////////////////////////////
 // Stream Abstraction
 //
+// Concrete streams:
+//	. FileStream buffers reads and writes to a file, large requests bypass the buffer and go straight to the disk
+//	. MappedFileStream maps a whole file in memory for reading, its content can be accessed in place without any copy
+//	. MemoryStream reads from a memory block or writes to a growable buffer
+//	. CompressedStream compresses/decompresses blocks of another stream with LZ4 (see Compression.h)
+//
+// Binary readers and writers transfer whole arrays in a single call and can swap the bytes of big-endian data.
+//
 #pragma once
 
 #include "../Types.h"
+#include "Allocator.h"
 
 // Abstract Stream Class
 class	Stream {
 public:
+	virtual ~Stream() {}
+
 	virtual U64		Position() const abstract;
 	virtual void	SetPosition( U64 _position ) abstract;
 	virtual U64		Length() const abstract;
-	virtual void	Read( U32 _count, void* _container ) const abstract;
-	virtual void	Write( U32 _count, const void* _container ) const abstract;
+
+	// Returns the amount of bytes actually read (less than _count when the end of the stream is reached)
+	virtual U32		Read( U32 _count, void* _container ) abstract;
+	virtual void	Write( U32 _count, const void* _container ) abstract;
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Buffered file stream
+//
+class	FileStream : public Stream {
+public:
+	enum MODE {
+		READ,
+		WRITE,		// Creates or truncates the file
+	};
+
+protected:
+	void*		m_hFile;
+	MODE		m_mode;
+	U8*			m_pBuffer;
+	U32			m_bufferSize;
+	U64			m_bufferPosition;	// Position of the buffer's first byte in the file
+	U32			m_bufferOffset;		// Position of the stream in the buffer
+	U32			m_bufferCount;		// Amount of valid bytes in the buffer (read mode)
+	U64			m_filePosition;		// Current position of the file pointer
+	U64			m_length;
+
+public:
+	FileStream( const char* _fileName, MODE _mode, U32 _bufferSize=64*1024 );
+	~FileStream();
+
+	bool			IsOpen() const		{ return m_hFile != NULL; }
+	void			Flush();
+
+	virtual U64		Position() const	{ return m_bufferPosition + m_bufferOffset; }
+	virtual void	SetPosition( U64 _position );
+	virtual U64		Length() const;
+	virtual U32		Read( U32 _count, void* _container );
+	virtual void	Write( U32 _count, const void* _container );
+
+private:
+	U32				ReadAt( U64 _position, U32 _count, void* _container );
+	void			WriteAt( U64 _position, U32 _count, const void* _container );
+
+	FileStream( const FileStream& );
+	FileStream&		operator=( const FileStream& );
 };
 
+
+//////////////////////////////////////////////////////////////////////////
+// Read-only memory-mapped file stream
+//
+class	MappedFileStream : public Stream {
+protected:
+	void*		m_hFile;
+	void*		m_hMapping;
+	const U8*	m_pData;
+	U64			m_length;
+	U64			m_position;
+
+public:
+	MappedFileStream( const char* _fileName );
+	~MappedFileStream();
+
+	bool			IsOpen() const		{ return m_hFile != NULL; }
+
+	// Zero-copy access: returns the file's content at the current position and advances the position by _count bytes
+	// The pointer remains valid as long as the stream exists
+	const void*		Map( U32 _count );
+	const U8*		GetData() const		{ return m_pData; }
+
+	virtual U64		Position() const	{ return m_position; }
+	virtual void	SetPosition( U64 _position );
+	virtual U64		Length() const		{ return m_length; }
+	virtual U32		Read( U32 _count, void* _container );
+	virtual void	Write( U32 _count, const void* _container );
+
+private:
+	MappedFileStream( const MappedFileStream& );
+	MappedFileStream&	operator=( const MappedFileStream& );
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Memory stream
+//	. Either reads from an existing memory block (that must outlive the stream)
+//	. Or reads and writes a buffer growing as needed
+//
+class	MemoryStream : public Stream {
+protected:
+	BaseLib::IAllocator&	m_allocator;
+	U8*			m_pData;
+	U64			m_length;
+	U64			m_capacity;
+	U64			m_position;
+	bool		m_ownsData;
+
+public:
+	MemoryStream( BaseLib::IAllocator& _allocator=BaseLib::GetDefaultAllocator() );
+	MemoryStream( const void* _pData, U64 _length );
+	~MemoryStream();
+
+	// Makes sure the buffer can hold _capacity bytes without growing
+	void			Reserve( U64 _capacity );
+
+	// Zero-copy access: returns the data at the current position and advances the position by _count bytes
+	const void*		Map( U32 _count );
+	const U8*		GetData() const		{ return m_pData; }
+
+	virtual U64		Position() const	{ return m_position; }
+	virtual void	SetPosition( U64 _position );
+	virtual U64		Length() const		{ return m_length; }
+	virtual U32		Read( U32 _count, void* _container );
+	virtual void	Write( U32 _count, const void* _container );
+
+private:
+	MemoryStream( const MemoryStream& );
+	MemoryStream&	operator=( const MemoryStream& );
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// LZ4-compressed stream
+//
+// Data is compressed in independent blocks stored in the base stream, each block is prefixed by its raw and compressed sizes
+//	(blocks that don't compress are stored raw).
+// The stream is either read or written sequentially: in read mode, seeking forward decompresses and skips the data in between
+//	while seeking backward restarts decompression from the start of the stream.
+// In write mode, the base stream must support seeking as the total size is patched in the header by Close().
+//
+class	CompressedStream : public Stream {
+public:
+	enum MODE {
+		READ,
+		WRITE,
+	};
+
+	static const U32	DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+protected:
+	Stream&		m_base;
+	MODE		m_mode;
+	U64			m_basePosition;		// Position of the header in the base stream
+	U32			m_blockSize;
+	U8*			m_pBlock;			// Uncompressed block
+	U8*			m_pCompressedBlock;
+	U32			m_blockOffset;		// Position of the stream in the current block
+	U32			m_blockCount;		// Amount of valid bytes in the current block
+	U64			m_blockPosition;	// Position of the current block's first byte in the uncompressed stream
+	U64			m_length;
+
+public:
+	// The base stream must outlive the compressed stream
+	CompressedStream( Stream& _base, MODE _mode, U32 _blockSize=DEFAULT_BLOCK_SIZE );
+	~CompressedStream();
+
+	// Flushes the pending block and writes the total size in the header (automatically called by the destructor)
+	void			Close();
+
+	virtual U64		Position() const	{ return m_blockPosition + m_blockOffset; }
+	virtual void	SetPosition( U64 _position );
+	virtual U64		Length() const		{ return m_mode == READ ? m_length : Position(); }
+	virtual U32		Read( U32 _count, void* _container );
+	virtual void	Write( U32 _count, const void* _container );
+
+private:
+	bool			ReadBlock();
+	void			WriteBlock();
+
+	CompressedStream( const CompressedStream& );
+	CompressedStream&	operator=( const CompressedStream& );
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Endianness helpers
+inline U16	ByteSwap( U16 _value )	{ return U16( (_value >> 8) | (_value << 8) ); }
+inline U32	ByteSwap( U32 _value )	{ return (_value >> 24) | ((_value >> 8) & 0xFF00U) | ((_value << 8) & 0xFF0000U) | (_value << 24); }
+inline U64	ByteSwap( U64 _value )	{ return (U64( ByteSwap( U32( _value ) ) ) << 32) | ByteSwap( U32( _value >> 32 ) ); }
+
+// Swaps the bytes of an array of _count elements of _elementSize bytes each (1, 2, 4 or 8)
+void		ByteSwap( void* _pArray, U32 _count, U32 _elementSize );
+
+// Size of the scalars composing a type, which is the unit of byte swapping
+// Aggregates default to 4 bytes (i.e. vectors, matrices and other types made of floats or 32-bits integers), specialize for other aggregate types
+template<typename T> struct	StreamScalarSize	{ static const U32 SIZE = 4; };
+template<> struct	StreamScalarSize<char>		{ static const U32 SIZE = 1; };
+template<> struct	StreamScalarSize<bool>		{ static const U32 SIZE = 1; };
+template<> struct	StreamScalarSize<S8>		{ static const U32 SIZE = 1; };
+template<> struct	StreamScalarSize<U8>		{ static const U32 SIZE = 1; };
+template<> struct	StreamScalarSize<S16>		{ static const U32 SIZE = 2; };
+template<> struct	StreamScalarSize<U16>		{ static const U32 SIZE = 2; };
+template<> struct	StreamScalarSize<half>		{ static const U32 SIZE = 2; };
+template<> struct	StreamScalarSize<S64>		{ static const U32 SIZE = 8; };
+template<> struct	StreamScalarSize<U64>		{ static const U32 SIZE = 8; };
+template<> struct	StreamScalarSize<double>	{ static const U32 SIZE = 8; };
+
+// Compile-time validation of a type's scalar size against what ByteSwap() supports
+template<typename T> struct	StreamScalarSizeCheck {
+	static_assert( StreamScalarSize<T>::SIZE == 1 || StreamScalarSize<T>::SIZE == 2 || StreamScalarSize<T>::SIZE == 4 || StreamScalarSize<T>::SIZE == 8, "ByteSwap() only supports scalars of 1, 2, 4 or 8 bytes!" );
+	static_assert( sizeof(T) % StreamScalarSize<T>::SIZE == 0, "The size of the type isn't a multiple of its scalar size, specialize StreamScalarSize<T>!" );
+	static const U32 SIZE = StreamScalarSize<T>::SIZE;
+};
+
+
+//////////////////////////////////////////////////////////////////////////
 // Binary Reader from an abstract stream
 class	BinaryReader {
 	Stream&		m_stream;
+	bool		m_swapBytes;
 public:
-	BinaryReader( Stream& _stream ) : m_stream( _stream ) {}
+	// Set _bigEndian to read data written by a big-endian machine
+	BinaryReader( Stream& _stream, bool _bigEndian=false ) : m_stream( _stream ), m_swapBytes( _bigEndian ) {}
 	Stream&		BaseStream() const	{ return m_stream; }
 
 	U8			ReadByte() const;
 	U16			ReadUInt16() const;
 	U32			ReadUInt32() const;
+	U64			ReadUInt64() const;
 	float		ReadSingle() const;
 	double		ReadDouble() const;
+
+	// Reads an array of _count elements in a single call, returns the amount of elements actually read
+	template<typename T>
+	U32			ReadArray( T* _pArray, U32 _count ) const {
+		U32	count = m_stream.Read( _count * U32(sizeof(T)), _pArray ) / U32(sizeof(T));
+		if ( m_swapBytes )
+			ByteSwap( _pArray, count * U32(sizeof(T) / StreamScalarSizeCheck<T>::SIZE), StreamScalarSizeCheck<T>::SIZE );
+		return count;
+	}
+
+private:
+	void		ReadScalar( U32 _size, void* _pValue ) const;
 };
 
 // Binary Writer to an abstract stream
 class	BinaryWriter {
 	Stream&		m_stream;
+	bool		m_swapBytes;
 public:
-	BinaryWriter( Stream& _stream ) : m_stream( _stream ) {}
+	// Set _bigEndian to write data for a big-endian machine
+	BinaryWriter( Stream& _stream, bool _bigEndian=false ) : m_stream( _stream ), m_swapBytes( _bigEndian ) {}
 	Stream&		BaseStream() const	{ return m_stream; }
 
 	void		Write( const U8& _value ) const;
 	void		Write( const U16& _value ) const;
 	void		Write( const U32& _value ) const;
+	void		Write( const U64& _value ) const;
 	void		Write( const float& _value ) const;
 	void		Write( const double& _value ) const;
+
+	// Writes an array of _count elements in a single call (or in a few chunks when bytes must be swapped)
+	template<typename T>
+	void		WriteArray( const T* _pArray, U32 _count ) const {
+		WriteArray( _pArray, _count * U32(sizeof(T) / StreamScalarSizeCheck<T>::SIZE), StreamScalarSizeCheck<T>::SIZE );
+	}
+
+private:
+	void		WriteScalar( U32 _size, const void* _pValue ) const;
+	void		WriteArray( const void* _pArray, U32 _count, U32 _scalarSize ) const;
 };
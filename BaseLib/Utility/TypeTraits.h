@@ -0,0 +1,33 @@
+//////////////////////////////////////////////////////////////////////////
+// Type traits & move helpers
+//
+// Minimal replacements for std::move(), std::forward() and the type traits used by the containers, so we don't need the STL.
+// Triviality is queried with compiler intrinsics (supported by MSVC, GCC and clang).
+//
+#pragma once
+
+#include "../Types.h"
+
+namespace BaseLib {
+
+template<typename T> struct	RemoveReference			{ typedef T	Type; };
+template<typename T> struct	RemoveReference<T&>		{ typedef T	Type; };
+template<typename T> struct	RemoveReference<T&&>	{ typedef T	Type; };
+
+// Casts a value into an rvalue reference so it can be moved from (i.e. std::move())
+template<typename T> typename RemoveReference<T>::Type&&	Move( T&& _Value )	{ return static_cast< typename RemoveReference<T>::Type&& >( _Value ); }
+
+// Forwards an argument while preserving its value category (i.e. std::forward())
+template<typename T> T&&	Forward( typename RemoveReference<T>::Type& _Value )	{ return static_cast< T&& >( _Value ); }
+
+// True if the type can be copied or relocated with a simple memcpy()
+template<typename T> struct	IsTriviallyCopyable {
+	enum { Value = __has_trivial_copy( T ) && __has_trivial_assign( T ) && __has_trivial_destructor( T ) };
+};
+
+// True if the type doesn't need its destructor to be called
+template<typename T> struct	IsTriviallyDestructible {
+	enum { Value = __has_trivial_destructor( T ) };
+};
+
+}	// namespace BaseLib
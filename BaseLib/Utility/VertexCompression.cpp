@@ -0,0 +1,356 @@
+#include "../Types.h"
+#include "VertexCompression.h"
+#include "Compression.h"
+
+using namespace BaseLib;
+
+static const U32	CODEC_BLOCK_SIZE = 256;		// Elements are transposed by blocks so the byte planes stay in cache
+static const float	QUATERNION_SCALE = 32767.0f;
+
+
+//////////////////////////////////////////////////////////////////////////
+// Quantization
+//
+static S16	QuantizeSNorm16( float _Value ) {
+	float	Scaled = CLAMP( _Value, -1.0f, 1.0f ) * QUATERNION_SCALE;
+	return S16( Scaled >= 0.0f ? Scaled + 0.5f : Scaled - 0.5f );
+}
+
+void	BaseLib::EncodeTangentFrame( const bfloat3& _Normal, const bfloat3& _Tangent, const bfloat3& _BiTangent, S16 _pQuaternion[4] ) {
+	// Orthonormalize the frame
+	bfloat3	N = _Normal;
+	if ( N.LengthSq() < 1e-12f )
+		N.Set( 0, 0, 1 );
+	N.Normalize();
+
+	bfloat3	T = _Tangent - N.Dot( _Tangent ) * N;
+	if ( T.LengthSq() < 1e-12f )
+		T = fabs( N.x ) < 0.9f ? bfloat3( 1, 0, 0 ) - N.x * N : bfloat3( 0, 1, 0 ) - N.y * N;	// Degenerate tangent, use any vector orthogonal to the normal
+	T.Normalize();
+
+	bfloat3	B = N.Cross( T );
+	bool	LeftHanded = B.Dot( _BiTangent ) < 0.0f;
+
+	// Convert the rotation matrix whose columns are (T, B, N) into a quaternion
+	float	x, y, z, w;
+	float	Trace = T.x + B.y + N.z;
+	if ( Trace > 0.0f ) {
+		float	s = 0.5f / sqrtf( Trace + 1.0f );
+		w = 0.25f / s;
+		x = (B.z - N.y) * s;
+		y = (N.x - T.z) * s;
+		z = (T.y - B.x) * s;
+	} else if ( T.x > B.y && T.x > N.z ) {
+		float	s = 2.0f * sqrtf( 1.0f + T.x - B.y - N.z );
+		w = (B.z - N.y) / s;
+		x = 0.25f * s;
+		y = (B.x + T.y) / s;
+		z = (N.x + T.z) / s;
+	} else if ( B.y > N.z ) {
+		float	s = 2.0f * sqrtf( 1.0f + B.y - T.x - N.z );
+		w = (N.x - T.z) / s;
+		x = (B.x + T.y) / s;
+		y = 0.25f * s;
+		z = (N.y + B.z) / s;
+	} else {
+		float	s = 2.0f * sqrtf( 1.0f + N.z - T.x - B.y );
+		w = (T.y - B.x) / s;
+		x = (N.x + T.z) / s;
+		y = (N.y + B.z) / s;
+		z = 0.25f * s;
+	}
+
+	// q and -q encode the same rotation so we're free to make w positive, and store the handedness in its sign instead
+	// w must not quantize to 0 though, otherwise the sign is lost
+	float	InvLength = 1.0f / sqrtf( x*x + y*y + z*z + w*w );
+	if ( w < 0.0f )
+		InvLength = -InvLength;
+	x *= InvLength; y *= InvLength; z *= InvLength; w *= InvLength;
+
+	const float	MinW = 1.0f / QUATERNION_SCALE;
+	if ( w < MinW ) {
+		float	Scale = sqrtf( 1.0f - MinW*MinW );
+		x *= Scale; y *= Scale; z *= Scale;
+		w = MinW;
+	}
+	if ( LeftHanded ) {
+		x = -x; y = -y; z = -z; w = -w;
+	}
+
+	_pQuaternion[0] = QuantizeSNorm16( x );
+	_pQuaternion[1] = QuantizeSNorm16( y );
+	_pQuaternion[2] = QuantizeSNorm16( z );
+	_pQuaternion[3] = QuantizeSNorm16( w );
+}
+
+void	BaseLib::DecodeTangentFrame( const S16 _pQuaternion[4], bfloat3& _Normal, bfloat3& _Tangent, bfloat3& _BiTangent ) {
+	float	x = _pQuaternion[0], y = _pQuaternion[1], z = _pQuaternion[2], w = _pQuaternion[3];
+	float	InvLength = 1.0f / sqrtf( x*x + y*y + z*z + w*w );
+	x *= InvLength; y *= InvLength; z *= InvLength;
+	float	Handedness = w < 0.0f ? -1.0f : 1.0f;
+	w *= InvLength;
+
+	_Tangent.Set( 1.0f - 2.0f * (y*y + z*z), 2.0f * (x*y + w*z), 2.0f * (x*z - w*y) );
+	_BiTangent.Set( Handedness * 2.0f * (x*y - w*z), Handedness * (1.0f - 2.0f * (x*x + z*z)), Handedness * 2.0f * (y*z + w*x) );
+	_Normal.Set( 2.0f * (x*z + w*y), 2.0f * (y*z - w*x), 1.0f - 2.0f * (x*x + y*y) );
+}
+
+void	BaseLib::QuantizeVertices( const VertexP3N3G3B3T2* _pSource, U32 _Count, const bfloat3& _BBoxMin, const bfloat3& _BBoxMax, QuantizedVertex* _pTarget ) {
+	bfloat3	Extent = _BBoxMax - _BBoxMin;
+	bfloat3	Scale( Extent.x > 0.0f ? 65535.0f / Extent.x : 0.0f, Extent.y > 0.0f ? 65535.0f / Extent.y : 0.0f, Extent.z > 0.0f ? 65535.0f / Extent.z : 0.0f );
+	for ( U32 VertexIndex=0; VertexIndex < _Count; VertexIndex++ ) {
+		const VertexP3N3G3B3T2&	S = _pSource[VertexIndex];
+		QuantizedVertex&		T = _pTarget[VertexIndex];
+
+		bfloat3	P = (S.Position - _BBoxMin) * Scale;
+		T.Position[0] = U16( CLAMP( P.x + 0.5f, 0.0f, 65535.0f ) );
+		T.Position[1] = U16( CLAMP( P.y + 0.5f, 0.0f, 65535.0f ) );
+		T.Position[2] = U16( CLAMP( P.z + 0.5f, 0.0f, 65535.0f ) );
+		T.Position[3] = 0;
+
+		EncodeTangentFrame( S.Normal, S.Tangent, S.BiTangent, T.TangentFrame );
+
+		T.UV[0] = half( S.UV.x );
+		T.UV[1] = half( S.UV.y );
+	}
+}
+
+#ifdef MATH_USE_SSE
+
+// Stores 3 floats without writing past the end of the vector
+static inline void	SSEStore3( bfloat3& p, __m128 v ) {
+	_mm_storel_pi( (__m64*) &p.x, v );
+	_mm_store_ss( &p.z, _mm_movehl_ps( v, v ) );
+}
+
+// Converts the 4 S16 of a quaternion into floats
+static inline __m128	SSELoadQuaternion( const S16 _pQuaternion[4] ) {
+	__m128i	Q = _mm_loadl_epi64( (const __m128i*) _pQuaternion );
+	return _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( Q, Q ), 16 ) );
+}
+
+void	BaseLib::DequantizeVertices( const QuantizedVertex* _pSource, U32 _Count, const bfloat3& _BBoxMin, const bfloat3& _BBoxMax, VertexP3N3G3B3T2* _pTarget ) {
+	bfloat3	Extent = (_BBoxMax - _BBoxMin) / 65535.0f;
+	__m128	PositionScale = _mm_setr_ps( Extent.x, Extent.y, Extent.z, 0.0f );
+	__m128	PositionBias = _mm_setr_ps( _BBoxMin.x, _BBoxMin.y, _BBoxMin.z, 0.0f );
+	__m128i	Zero = _mm_setzero_si128();
+	__m128	One = _mm_set1_ps( 1.0f );
+	__m128	Two = _mm_set1_ps( 2.0f );
+	__m128	SignMask = _mm_castsi128_ps( _mm_set1_epi32( 0x80000000 ) );
+
+	// Tangent frames are decoded 4 at a time in SoA form
+	U32	VertexIndex = 0;
+	for ( ; VertexIndex+4 <= _Count; VertexIndex+=4 ) {
+		const QuantizedVertex*	S = _pSource + VertexIndex;
+		VertexP3N3G3B3T2*		T = _pTarget + VertexIndex;
+
+		// Positions
+		for ( U32 i=0; i < 4; i++ ) {
+			__m128i	P = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i*) S[i].Position ), Zero );
+			SSEStore3( T[i].Position, _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps( P ), PositionScale ), PositionBias ) );
+		}
+
+		// Tangent frames
+		__m128	x = SSELoadQuaternion( S[0].TangentFrame );
+		__m128	y = SSELoadQuaternion( S[1].TangentFrame );
+		__m128	z = SSELoadQuaternion( S[2].TangentFrame );
+		__m128	w = SSELoadQuaternion( S[3].TangentFrame );
+		_MM_TRANSPOSE4_PS( x, y, z, w );
+
+		__m128	InvLength = _mm_div_ps( One, _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ), _mm_add_ps( _mm_mul_ps( z, z ), _mm_mul_ps( w, w ) ) ) ) );
+		__m128	Handedness = _mm_or_ps( _mm_and_ps( w, SignMask ), One );
+		x = _mm_mul_ps( x, InvLength );
+		y = _mm_mul_ps( y, InvLength );
+		z = _mm_mul_ps( z, InvLength );
+		w = _mm_mul_ps( w, InvLength );
+
+		__m128	xx = _mm_mul_ps( x, x ), yy = _mm_mul_ps( y, y ), zz = _mm_mul_ps( z, z );
+		__m128	xy = _mm_mul_ps( x, y ), xz = _mm_mul_ps( x, z ), yz = _mm_mul_ps( y, z );
+		__m128	wx = _mm_mul_ps( w, x ), wy = _mm_mul_ps( w, y ), wz = _mm_mul_ps( w, z );
+
+		__m128	Tx = _mm_sub_ps( One, _mm_mul_ps( Two, _mm_add_ps( yy, zz ) ) );
+		__m128	Ty = _mm_mul_ps( Two, _mm_add_ps( xy, wz ) );
+		__m128	Tz = _mm_mul_ps( Two, _mm_sub_ps( xz, wy ) );
+		__m128	Bx = _mm_mul_ps( Handedness, _mm_mul_ps( Two, _mm_sub_ps( xy, wz ) ) );
+		__m128	By = _mm_mul_ps( Handedness, _mm_sub_ps( One, _mm_mul_ps( Two, _mm_add_ps( xx, zz ) ) ) );
+		__m128	Bz = _mm_mul_ps( Handedness, _mm_mul_ps( Two, _mm_add_ps( yz, wx ) ) );
+		__m128	Nx = _mm_mul_ps( Two, _mm_add_ps( xz, wy ) );
+		__m128	Ny = _mm_mul_ps( Two, _mm_sub_ps( yz, wx ) );
+		__m128	Nz = _mm_sub_ps( One, _mm_mul_ps( Two, _mm_add_ps( xx, yy ) ) );
+
+		__m128	Pad = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS( Tx, Ty, Tz, Pad );
+		SSEStore3( T[0].Tangent, Tx );	SSEStore3( T[1].Tangent, Ty );	SSEStore3( T[2].Tangent, Tz );	SSEStore3( T[3].Tangent, Pad );
+		Pad = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS( Bx, By, Bz, Pad );
+		SSEStore3( T[0].BiTangent, Bx );	SSEStore3( T[1].BiTangent, By );	SSEStore3( T[2].BiTangent, Bz );	SSEStore3( T[3].BiTangent, Pad );
+		Pad = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS( Nx, Ny, Nz, Pad );
+		SSEStore3( T[0].Normal, Nx );	SSEStore3( T[1].Normal, Ny );	SSEStore3( T[2].Normal, Nz );	SSEStore3( T[3].Normal, Pad );
+
+		// UVs
+		half	pUVs[8];
+		float	pDecodedUVs[8];
+		for ( U32 i=0; i < 4; i++ ) {
+			pUVs[2*i+0] = S[i].UV[0];
+			pUVs[2*i+1] = S[i].UV[1];
+		}
+		HalfToFloat( pUVs, pDecodedUVs, 8 );
+		for ( U32 i=0; i < 4; i++ )
+			T[i].UV.Set( pDecodedUVs[2*i+0], pDecodedUVs[2*i+1] );
+	}
+
+	// Remaining vertices
+	for ( ; VertexIndex < _Count; VertexIndex++ ) {
+		const QuantizedVertex&	S = _pSource[VertexIndex];
+		VertexP3N3G3B3T2&		T = _pTarget[VertexIndex];
+
+		__m128i	P = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i*) S.Position ), Zero );
+		SSEStore3( T.Position, _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps( P ), PositionScale ), PositionBias ) );
+		DecodeTangentFrame( S.TangentFrame, T.Normal, T.Tangent, T.BiTangent );
+		T.UV.Set( S.UV[0], S.UV[1] );
+	}
+}
+
+#else
+
+void	BaseLib::DequantizeVertices( const QuantizedVertex* _pSource, U32 _Count, const bfloat3& _BBoxMin, const bfloat3& _BBoxMax, VertexP3N3G3B3T2* _pTarget ) {
+	bfloat3	Extent = (_BBoxMax - _BBoxMin) / 65535.0f;
+	for ( U32 VertexIndex=0; VertexIndex < _Count; VertexIndex++ ) {
+		const QuantizedVertex&	S = _pSource[VertexIndex];
+		VertexP3N3G3B3T2&		T = _pTarget[VertexIndex];
+
+		T.Position = _BBoxMin + Extent * bfloat3( S.Position[0], S.Position[1], S.Position[2] );
+		DecodeTangentFrame( S.TangentFrame, T.Normal, T.Tangent, T.BiTangent );
+		T.UV.Set( S.UV[0], S.UV[1] );
+	}
+}
+
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////
+// Codecs
+// Elements are split into blocks of CODEC_BLOCK_SIZE, each block stores all the first bytes of its elements, then all the second bytes, etc.
+// Bytes of equal significance are much more alike than consecutive bytes of an element, which LZ4 then compresses a lot better.
+//
+static void	TransposeBytes( const U8* _pSource, U32 _Count, U32 _ElementSize, U8* _pTarget ) {
+	for ( U32 BlockStart=0; BlockStart < _Count; BlockStart+=CODEC_BLOCK_SIZE ) {
+		U32			BlockCount = MIN( CODEC_BLOCK_SIZE, _Count - BlockStart );
+		const U8*	pBlock = _pSource + BlockStart * _ElementSize;
+		for ( U32 ByteIndex=0; ByteIndex < _ElementSize; ByteIndex++ ) {
+			const U8*	pByte = pBlock + ByteIndex;
+			for ( U32 i=0; i < BlockCount; i++, pByte+=_ElementSize )
+				*_pTarget++ = *pByte;
+		}
+	}
+}
+
+static void	UntransposeBytes( const U8* _pSource, U32 _Count, U32 _ElementSize, U8* _pTarget ) {
+	for ( U32 BlockStart=0; BlockStart < _Count; BlockStart+=CODEC_BLOCK_SIZE ) {
+		U32		BlockCount = MIN( CODEC_BLOCK_SIZE, _Count - BlockStart );
+		U8*		pBlock = _pTarget + BlockStart * _ElementSize;
+		for ( U32 ByteIndex=0; ByteIndex < _ElementSize; ByteIndex++ ) {
+			U8*	pByte = pBlock + ByteIndex;
+			for ( U32 i=0; i < BlockCount; i++, pByte+=_ElementSize )
+				*pByte = *_pSource++;
+		}
+	}
+}
+
+// Compresses the transposed elements, the temporary buffer is freed by the caller
+static U32	CompressTransposed( const U8* _pElements, U32 _Count, U32 _ElementSize, void* _pTarget, U32 _Capacity, U8* _pTemp ) {
+	TransposeBytes( _pElements, _Count, _ElementSize, _pTemp );
+	return LZ4Compress( _pTemp, _Count * _ElementSize, _pTarget, _Capacity );
+}
+
+static bool	DecompressTransposed( const void* _pSource, U32 _Size, U32 _Count, U32 _ElementSize, U8* _pTarget, U8* _pTemp ) {
+	U32	RawSize = _Count * _ElementSize;
+	if ( LZ4Decompress( _pSource, _Size, _pTemp, RawSize ) != RawSize )
+		return false;
+	UntransposeBytes( _pTemp, _Count, _ElementSize, _pTarget );
+	return true;
+}
+
+U32		BaseLib::EncodeIndexBufferBound( U32 _IndicesCount ) {
+	return LZ4CompressBound( _IndicesCount * 4 );
+}
+
+U32		BaseLib::EncodeIndexBuffer( const U32* _pIndices, U32 _IndicesCount, void* _pTarget, U32 _Capacity, IAllocator& _Allocator ) {
+	// Consecutive indices of an optimized mesh are close to each other, store the zigzag-encoded deltas so the high bytes are mostly 0
+	U32		BufferSize = 2 * _IndicesCount * 4;
+	U32*	pDeltas = (U32*) _Allocator.Allocate( BufferSize, 16 );
+	U32		Previous = 0;
+	for ( U32 i=0; i < _IndicesCount; i++ ) {
+		U32	Delta = _pIndices[i] - Previous;
+		pDeltas[i] = (Delta << 1) ^ U32( S32( Delta ) >> 31 );
+		Previous = _pIndices[i];
+	}
+
+	U32	Size = CompressTransposed( (const U8*) pDeltas, _IndicesCount, 4, _pTarget, _Capacity, (U8*) (pDeltas + _IndicesCount) );
+	_Allocator.Free( pDeltas, BufferSize, 16 );
+	return Size;
+}
+
+bool	BaseLib::DecodeIndexBuffer( const void* _pSource, U32 _Size, U32* _pIndices, U32 _IndicesCount, IAllocator& _Allocator ) {
+	U32		BufferSize = _IndicesCount * 4;
+	U8*		pTemp = (U8*) _Allocator.Allocate( BufferSize, 16 );
+	bool	Succeeded = DecompressTransposed( _pSource, _Size, _IndicesCount, 4, (U8*) _pIndices, pTemp );
+	_Allocator.Free( pTemp, BufferSize, 16 );
+	if ( !Succeeded )
+		return false;
+
+	U32	Previous = 0;
+	for ( U32 i=0; i < _IndicesCount; i++ ) {
+		U32	ZigZag = _pIndices[i];
+		Previous += (ZigZag >> 1) ^ (0U - (ZigZag & 1));
+		_pIndices[i] = Previous;
+	}
+	return true;
+}
+
+U32		BaseLib::EncodeVertexBufferBound( U32 _VerticesCount, U32 _VertexSize ) {
+	return LZ4CompressBound( _VerticesCount * _VertexSize );
+}
+
+U32		BaseLib::EncodeVertexBuffer( const void* _pVertices, U32 _VerticesCount, U32 _VertexSize, void* _pTarget, U32 _Capacity, IAllocator& _Allocator ) {
+	// Neighbor vertices are usually close to each other, store the bytewise difference with the previous vertex
+	U32		RawSize = _VerticesCount * _VertexSize;
+	U8*		pDeltas = (U8*) _Allocator.Allocate( 2 * RawSize, 16 );
+	const U8*	pSource = (const U8*) _pVertices;
+	for ( U32 i=0; i < _VertexSize; i++ )
+		pDeltas[i] = pSource[i];
+	for ( U32 i=_VertexSize; i < RawSize; i++ )
+		pDeltas[i] = U8( pSource[i] - pSource[i - _VertexSize] );
+
+	U32	Size = CompressTransposed( pDeltas, _VerticesCount, _VertexSize, _pTarget, _Capacity, pDeltas + RawSize );
+	_Allocator.Free( pDeltas, 2 * RawSize, 16 );
+	return Size;
+}
+
+bool	BaseLib::DecodeVertexBuffer( const void* _pSource, U32 _Size, void* _pVertices, U32 _VerticesCount, U32 _VertexSize, IAllocator& _Allocator ) {
+	U32		RawSize = _VerticesCount * _VertexSize;
+	U8*		pTemp = (U8*) _Allocator.Allocate( RawSize, 16 );
+	U8*		pTarget = (U8*) _pVertices;
+	bool	Succeeded = DecompressTransposed( _pSource, _Size, _VerticesCount, _VertexSize, pTarget, pTemp );
+	_Allocator.Free( pTemp, RawSize, 16 );
+	if ( !Succeeded )
+		return false;
+
+	// Accumulate the deltas
+	U32	i = _VertexSize;
+#ifdef MATH_USE_SSE
+	if ( _VertexSize >= 16 ) {
+		// Each 16 bytes chunk only depends on bytes at least 16 bytes before it, which are already decoded
+		for ( ; i+16 <= RawSize; i+=16 ) {
+			__m128i	Previous = _mm_loadu_si128( (const __m128i*) (pTarget + i - _VertexSize) );
+			__m128i	Delta = _mm_loadu_si128( (const __m128i*) (pTarget + i) );
+			_mm_storeu_si128( (__m128i*) (pTarget + i), _mm_add_epi8( Previous, Delta ) );
+		}
+	}
+#endif
+	for ( ; i < RawSize; i++ )
+		pTarget[i] = U8( pTarget[i] + pTarget[i - _VertexSize] );
+
+	return true;
+}
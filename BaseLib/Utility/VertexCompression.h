@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////////
+// Vertex quantization and compression
+//
+// Quantized vertices pack the 56 bytes of a P3N3G3B3T2 vertex into 20 bytes:
+//	. Position as 3 U16 relative to the bounding box of the primitive, the error is about half a step (i.e. extent / 131070 along each axis)
+//	. Tangent frame as a quaternion of 4 S16 (a.k.a. QTangent) whose w sign gives the handedness of the bitangent, the angular error is below 1e-4 radians
+//		The frame is orthonormalized by the encoding: the decoded bitangent is always cross( normal, tangent ) times the handedness
+//	. UV as 2 half floats (relative error 2^-11)
+//
+// The index and vertex buffer codecs are lossless and meant for storage: indices are delta-encoded, vertices are delta-encoded byte per byte
+//	with the previous vertex, then the bytes are grouped by significance and compressed with LZ4 (see Compression.h).
+//
+#pragma once
+
+#include "../Types.h"
+#include "Allocator.h"
+
+namespace BaseLib {
+
+// Full precision vertex
+struct	VertexP3N3G3B3T2 {
+	bfloat3		Position;
+	bfloat3		Normal;
+	bfloat3		Tangent;
+	bfloat3		BiTangent;
+	bfloat2		UV;
+};
+
+// Quantized vertex
+struct	QuantizedVertex {
+	U16			Position[4];		// XYZ quantized over the bounding box, W is unused
+	S16			TangentFrame[4];	// XYZW quaternion, W < 0 for a left-handed frame
+	half		UV[2];
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Quantization
+// The bounding box must contain all the positions, decoding is SSE-accelerated
+void	QuantizeVertices( const VertexP3N3G3B3T2* _pSource, U32 _Count, const bfloat3& _BBoxMin, const bfloat3& _BBoxMax, QuantizedVertex* _pTarget );
+void	DequantizeVertices( const QuantizedVertex* _pSource, U32 _Count, const bfloat3& _BBoxMin, const bfloat3& _BBoxMax, VertexP3N3G3B3T2* _pTarget );
+
+// Encodes a tangent frame as a unit quaternion, _BiTangent only gives the handedness
+void	EncodeTangentFrame( const bfloat3& _Normal, const bfloat3& _Tangent, const bfloat3& _BiTangent, S16 _pQuaternion[4] );
+void	DecodeTangentFrame( const S16 _pQuaternion[4], bfloat3& _Normal, bfloat3& _Tangent, bfloat3& _BiTangent );
+
+
+//////////////////////////////////////////////////////////////////////////
+// Index and vertex buffer codecs
+// Encoders return the size of the encoded data or 0 if it doesn't fit in _Capacity bytes
+// Decoders return false if the encoded data is corrupted, the caller must know the amount of indices or vertices to decode
+U32		EncodeIndexBufferBound( U32 _IndicesCount );
+U32		EncodeIndexBuffer( const U32* _pIndices, U32 _IndicesCount, void* _pTarget, U32 _Capacity, IAllocator& _Allocator=GetDefaultAllocator() );
+bool	DecodeIndexBuffer( const void* _pSource, U32 _Size, U32* _pIndices, U32 _IndicesCount, IAllocator& _Allocator=GetDefaultAllocator() );
+
+U32		EncodeVertexBufferBound( U32 _VerticesCount, U32 _VertexSize );
+U32		EncodeVertexBuffer( const void* _pVertices, U32 _VerticesCount, U32 _VertexSize, void* _pTarget, U32 _Capacity, IAllocator& _Allocator=GetDefaultAllocator() );
+bool	DecodeVertexBuffer( const void* _pSource, U32 _Size, void* _pVertices, U32 _VerticesCount, U32 _VertexSize, IAllocator& _Allocator=GetDefaultAllocator() );
+
+}	// namespace BaseLib
@@ -16,6 +16,9 @@
 //		=> Taking example on the SCENE_SPONZA define, create the same pattern for your scene (i.e. create PROBES_PATH, TEXTURES_PATH, etc.)
 //		=> Create a disk folder where probe infos will be stored, make PROBES_PATH point to it (usually, a "Probes" sub-directory in the scene's directory)
 //		=> Text-edit the GodComplex.rc resource file, locate the line where IDR_SCENE_GI is defined, copy/paste/comment and patch with your scene's path
+//	_ Optionally, bake the optimized primitives and their LODs so they're not rebuilt at every load
+//		=> Uncomment BAKE_SCENE and run once: this writes SCENE_PATH "SceneBaked.gcx"
+//		=> Comment BAKE_SCENE again and patch the IDR_SCENE_GI line of the resource file to point to the baked scene
 //
 // 2) Converting textures
 //	_ Place any textures for your scene anywhere you like (preferably in a "Textures" folder in the scene's directory)
@@ -54,6 +57,7 @@
 #include "../../GodComplex.h"
 #include "EffectGlobalIllum2.h"
 #include "../../Utility/SHProbeEncoder/SHProbe.h"
+#include "../../BaseLib/Utility/VertexCompression.h"
 
 //#define SCENE 0	// Simple corridor
 //#define SCENE 1	// City
@@ -61,8 +65,11 @@
 #define SCENE 3	// Test
 
 //#define	LOAD_PROBES				// Define this to simply load probes without computing them
+//#define	BAKE_SCENE				// Define this to optimize the scene, build its LODs and save it as a GCX2 scene with the LODs baked in
+//#define	CPU_PROBES_UPDATE		// Define this to update the probes on the CPU instead of using the compute shaders (no shadows!)
 #define USE_WHITE_TEXTURES		// Define this to use a single white texture for the entire scene (low patate machines)
 #define	USE_NORMAL_MAPS			// Define this to use normal maps
+#define	USE_QUANTIZED_VERTICES	// Define this to keep the scene vertices quantized on the GPU (20 bytes instead of 56) and decode them in the vertex shaders
 
 // Scene selection (also think about changing the scene in the .RC!)
 #if SCENE==0
@@ -93,37 +100,52 @@
 
 #define CHECK_MATERIAL( pMaterial, ErrorCode )		if ( (pMaterial)->HasErrors() ) m_ErrorCode = ErrorCode;
 
+// Vertex format of the scene primitives and the shader macro to prepend to the macros of the materials rendering them
+#ifdef USE_QUANTIZED_VERTICES
+	#define SCENE_VERTEX_FORMAT		VertexFormatQuantized
+	#define SCENE_VERTEX_MACRO		{ "QUANTIZED_VERTICES", "1" },
+#else
+	#define SCENE_VERTEX_FORMAT		VertexFormatP3N3G3B3T2
+	#define SCENE_VERTEX_MACRO
+#endif
+
+static const float	MAX_LOD_PIXEL_ERROR = 1.0f;	// Primitives are rendered with the coarsest LOD whose error stays below a pixel
+
 EffectGlobalIllum2::EffectGlobalIllum2( Device& _Device, Texture2D& _RTHDR, Primitive& _ScreenQuad, FPSCamera& _Camera )
 	: m_ErrorCode( 0 )
 	, m_Device( _Device )
 	, m_RTTarget( _RTHDR )
 	, m_ScreenQuad( _ScreenQuad )
+	, m_Camera( _Camera.m_Camera )
 	, m_DebugVoronoiCellIndex( ~0U )
 	, m_pPrimVoronoiCellPlanes( NULL )
-	, m_pPrimVoronoiCellEdges( NULL ) {
+	, m_pPrimVoronoiCellEdges( NULL )
+	, m_pSB_LODFaceRemap( NULL ) {
 
 	//////////////////////////////////////////////////////////////////////////
 	// Create the materials
-	m_SceneVertexFormatDesc.AggregateVertexFormat( VertexFormatP3N3G3B3T2::DESCRIPTOR );
+	m_SceneVertexFormatDesc.AggregateVertexFormat( SCENE_VERTEX_FORMAT::DESCRIPTOR );
+	D3D_SHADER_MACRO	pSceneMacros[] = { SCENE_VERTEX_MACRO { NULL, NULL } };
 
 	{
 // Main scene rendering is quite heavy so we prefer to reload it from binary instead
 //ScopedForceMaterialsLoadFromBinary		bisou;
 
-		D3D_SHADER_MACRO	pMacros[] = { { "USE_SHADOW_MAP", "1" }, { "PER_VERTEX_PROBE_ID", "1" }, { NULL, NULL } };
+		D3D_SHADER_MACRO	pMacros[] = { SCENE_VERTEX_MACRO { "USE_SHADOW_MAP", "1" }, { "PER_VERTEX_PROBE_ID", "1" }, { NULL, NULL } };
 		m_SceneVertexFormatDesc.AggregateVertexFormat( VertexFormatU32::DESCRIPTOR );
  		CHECK_MATERIAL( m_pMatRender = CreateMaterial( IDR_SHADER_GI_RENDER_SCENE, "./Resources/Shaders/GIRenderScene2.hlsl", m_SceneVertexFormatDesc, "VS", NULL, "PS", pMacros ), 1 );
 
-		D3D_SHADER_MACRO	pMacros2[] = { { "EMISSIVE", "1" }, { NULL, NULL } };
-		CHECK_MATERIAL( m_pMatRenderEmissive = CreateMaterial( IDR_SHADER_GI_RENDER_SCENE, "./Resources/Shaders/GIRenderScene2.hlsl", VertexFormatP3N3G3B3T2::DESCRIPTOR, "VS", NULL, "PS", pMacros2 ), 2 );
+		D3D_SHADER_MACRO	pMacros2[] = { SCENE_VERTEX_MACRO { "EMISSIVE", "1" }, { NULL, NULL } };
+		CHECK_MATERIAL( m_pMatRenderEmissive = CreateMaterial( IDR_SHADER_GI_RENDER_SCENE, "./Resources/Shaders/GIRenderScene2.hlsl", SCENE_VERTEX_FORMAT::DESCRIPTOR, "VS", NULL, "PS", pMacros2 ), 2 );
+
+		// Shadow maps depend on the scene vertex format so they're not reloaded from binary either
+ 		CHECK_MATERIAL( m_pMatRenderShadowMap = CreateMaterial( IDR_SHADER_GI_RENDER_SHADOW_MAP, "./Resources/Shaders/GIRenderShadowMap.hlsl", SCENE_VERTEX_FORMAT::DESCRIPTOR, "VS", NULL, NULL, pSceneMacros ), 4 );
+ 		CHECK_MATERIAL( m_pMatRenderShadowMapPoint = CreateMaterial( IDR_SHADER_GI_RENDER_SHADOW_MAP, "./Resources/Shaders/GIRenderShadowMap.hlsl", SCENE_VERTEX_FORMAT::DESCRIPTOR, "VS2", "GS", NULL, pSceneMacros ), 5 );
 	}
 
 	{
 ScopedForceMaterialsLoadFromBinary		bisou;
 
- 		CHECK_MATERIAL( m_pMatRenderShadowMap = CreateMaterial( IDR_SHADER_GI_RENDER_SHADOW_MAP, "./Resources/Shaders/GIRenderShadowMap.hlsl", VertexFormatP3::DESCRIPTOR, "VS", NULL, NULL ), 4 );
- 		CHECK_MATERIAL( m_pMatRenderShadowMapPoint = CreateMaterial( IDR_SHADER_GI_RENDER_SHADOW_MAP, "./Resources/Shaders/GIRenderShadowMap.hlsl", VertexFormatP3::DESCRIPTOR, "VS2", "GS", NULL ), 5 );
-
  		CHECK_MATERIAL( m_pMatPostProcess = CreateMaterial( IDR_SHADER_GI_POST_PROCESS, "./Resources/Shaders/GIPostProcess.hlsl", VertexFormatPt4::DESCRIPTOR, "VS", NULL, "PS" ), 6 );
  		CHECK_MATERIAL( m_pMatRenderLights = CreateMaterial( IDR_SHADER_GI_RENDER_LIGHTS, "./Resources/Shaders/GIRenderLights.hlsl", VertexFormatP3N3::DESCRIPTOR, "VS", NULL, "PS" ), 7 );
  		CHECK_MATERIAL( m_pMatRenderDynamic = CreateMaterial( IDR_SHADER_GI_RENDER_DYNAMIC, "./Resources/Shaders/GIRenderDynamic.hlsl", VertexFormatP3N3G3T2::DESCRIPTOR, "VS", NULL, "PS" ), 8 );
@@ -366,12 +388,19 @@ m_pCSComputeShadowMapBounds = NULL;	// TODO!
 
 	//////////////////////////////////////////////////////////////////////////
 	// Initialize the probes network
-	m_ProbesNetwork.Init( m_Device, m_ScreenQuad );
+	m_ProbesNetwork.Init( m_Device, m_ScreenQuad, SCENE_VERTEX_FORMAT::DESCRIPTOR, pSceneMacros );
 
 
 	//////////////////////////////////////////////////////////////////////////
 	// Load and init the scene
 	m_Scene.Load( IDR_SCENE_GI );
+#ifdef BAKE_SCENE
+	m_Scene.OptimizePrimitives();
+	m_Scene.BuildLODs();
+	m_Scene.SaveGCX2( SCENE_PATH "SceneBaked.gcx" );
+#else
+	m_Scene.BuildLODs();	// Only builds the LODs missing from the scene
+#endif
 
 	// Cache meshes & probes since my ForEach function is slow as hell!! ^^
 	{
@@ -452,8 +481,15 @@ m_pCSComputeShadowMapBounds = NULL;	// TODO!
 		m_TotalVerticesCount = 0;
 		m_TotalPrimitivesCount = 0;
 		m_EmissiveMaterialsCount = 0;
+		m_LODFaceRemap.Clear();
 		m_Scene.PlaceTags( *this );
 
+		// Upload the LOD face remap used by the probes' cube map rendering
+		m_pSB_LODFaceRemap = new SB<U32>( m_Device, MAX( 1U, m_LODFaceRemap.Count() ), false );
+		memcpy( m_pSB_LODFaceRemap->m, m_LODFaceRemap.Ptr(), m_LODFaceRemap.Count()*sizeof(U32) );
+		m_pSB_LODFaceRemap->Write();
+		m_pSB_LODFaceRemap->SetInput( 14 );
+
 		// Precompute probes and store result to disk
 		RenderScene		functor( *this );
 		m_ProbesNetwork.PreComputeProbes( PROBES_PATH, functor, m_Scene, m_TotalFacesCount );
@@ -476,6 +512,7 @@ m_pCSComputeShadowMapBounds = NULL;	// TODO!
 	m_TotalVerticesCount = 0;
 	m_TotalPrimitivesCount = 0;
 	m_EmissiveMaterialsCount = 0;
+	m_LODFaceRemap.Clear();
 
 	m_Scene.PlaceTags( *this );
 
@@ -645,6 +682,7 @@ EffectGlobalIllum2::~EffectGlobalIllum2()
 	if ( m_pPrimVoronoiCellEdges != NULL )
 		delete m_pPrimVoronoiCellEdges;
 
+	delete m_pSB_LODFaceRemap;
 	delete m_pSB_LightsDynamic;
 	delete m_pSB_LightsStatic;
 
@@ -859,6 +897,15 @@ void	EffectGlobalIllum2::Render( float _Time, float _DeltaTime )
 	SHProbeNetwork::DynamicUpdateParms	Parms;
 	Parms.MaxProbeUpdatesPerFrame = m_CachedCopy.MaxProbeUpdatesPerFrame;
 	Parms.pQueryMaterial = this;
+	Parms.wsCameraPosition = m_Camera.GetCB().Camera2World.GetRow( 3 );
+	Parms.World2Proj = m_Camera.GetCB().World2Proj;
+	Parms.DynamicLightsCount = m_pCB_Scene->m.DynamicLightsCount;
+	Parms.pDynamicLights = m_pSB_LightsDynamic->m;
+#ifdef CPU_PROBES_UPDATE
+	Parms.UseCPUUpdate = true;
+#else
+	Parms.UseCPUUpdate = false;
+#endif
 	Parms.BounceFactorSun = 0.01f * m_CachedCopy.BounceFactorSun * float3::One;
 	Parms.BounceFactorSky = 0.01f * m_CachedCopy.BounceFactorSky * SkyColor;
 	Parms.BounceFactorDynamic = 0.01f * m_CachedCopy.BounceFactorPoint * float3::One;
@@ -909,13 +956,21 @@ void	EffectGlobalIllum2::Render( float _Time, float _DeltaTime )
 
 		m_pTexDynamicNormalMap->SetPS( 11 );
 
-		for ( U32 DynamicObjectIndex=0; DynamicObjectIndex < m_CachedCopy.DynamicObjectsCount; DynamicObjectIndex++ )
+		// Update objects' positions & fetch the probe IDs to use for dynamic indirect lighting, all at once
+		U32		DynamicObjectsCount = MIN( m_CachedCopy.DynamicObjectsCount, MAX_DYNAMIC_OBJECTS );
+		float3	pDynamicObjectPositions[MAX_DYNAMIC_OBJECTS];
+		U32		pDynamicObjectProbeIDs[MAX_DYNAMIC_OBJECTS];
+		for ( U32 DynamicObjectIndex=0; DynamicObjectIndex < DynamicObjectsCount; DynamicObjectIndex++ )
 		{
 			DynamicObject&	DynObj = m_pDynamicObjects[DynamicObjectIndex];
+			pDynamicObjectPositions[DynamicObjectIndex] = DynObj.PositionStart + (DynObj.PositionEnd - DynObj.PositionStart) * t;
+		}
+		m_ProbesNetwork.GetNearestProbes( DynamicObjectsCount, pDynamicObjectPositions, pDynamicObjectProbeIDs );
 
-			// Update object's position & probe ID to use for dynamic indirect lighting
-			m_pCB_DynamicObject->m.Position = DynObj.PositionStart + (DynObj.PositionEnd - DynObj.PositionStart) * t;
-			m_pCB_DynamicObject->m.ProbeID = m_ProbesNetwork.GetNearestProbe( m_pCB_DynamicObject->m.Position );
+		for ( U32 DynamicObjectIndex=0; DynamicObjectIndex < DynamicObjectsCount; DynamicObjectIndex++ )
+		{
+			m_pCB_DynamicObject->m.Position = pDynamicObjectPositions[DynamicObjectIndex];
+			m_pCB_DynamicObject->m.ProbeID = pDynamicObjectProbeIDs[DynamicObjectIndex];
 			m_pCB_DynamicObject->UpdateData();
 
 			m_pPrimSphere->Render( M );
@@ -1093,8 +1148,9 @@ void	EffectGlobalIllum2::RenderShadowMap( const float3& _SunDirection )
 	m_Device.ClearDepthStencil( *m_pRTShadowMap, 1.0f, 0, true, false );
 	m_Device.SetRenderTargets( m_pRTShadowMap->GetWidth(), m_pRTShadowMap->GetHeight(), 0, NULL, m_pRTShadowMap->GetDSV() );
 
+	float	LODProjectionScale = SHADOW_MAP_SIZE / MAX( Delta.x, Delta.y );	// Orthographic projection: shadow map pixels per world unit
 	for ( int MeshIndex=0; MeshIndex < m_Scene.m_MeshesCount; MeshIndex++ )
-		RenderMesh( *m_ppCachedMeshes[MeshIndex], &M, false );
+		RenderMeshLOD( *m_ppCachedMeshes[MeshIndex], &M, false, NULL, LODProjectionScale );
 
 	USING_MATERIAL_END
 
@@ -1119,8 +1175,9 @@ void	EffectGlobalIllum2::RenderShadowMapPoint( const float3& _Position, float _F
 	m_Device.ClearDepthStencil( *m_pRTShadowMapPoint, 1.0f, 0, true, false );
 	m_Device.SetRenderTargets( m_pRTShadowMapPoint->GetWidth(), m_pRTShadowMapPoint->GetHeight(), 0, NULL, m_pRTShadowMapPoint->GetDSV() );
 
+	float	LODProjectionScale = BaseLib::ComputeLODProjectionScale( float(SHADOW_MAP_POINT_SIZE), HALFPI );	// Cube map faces have a 90 degrees FOV
 	for ( int MeshIndex=0; MeshIndex < m_Scene.m_MeshesCount; MeshIndex++ )
-		RenderMesh( *m_ppCachedMeshes[MeshIndex], &M, false );
+		RenderMeshLOD( *m_ppCachedMeshes[MeshIndex], &M, false, &_Position, LODProjectionScale );
 
 	USING_MATERIAL_END
 
@@ -1198,19 +1255,41 @@ void*	EffectGlobalIllum2::TagPrimitive( const Scene& _Owner, Scene::Mesh& _Mesh,
 	if ( m_bDeleteSceneTags )
 	{	// Delete the primitive
 		Primitive*	pPrim = (Primitive*) _Primitive.m_pTag;	// We need to cast it as a primitive first so the destructor gets called
+		if ( pPrim != NULL )
+			delete (PrimitiveTag*) pPrim->m_pTag;
 		delete pPrim;
 		return NULL;
 	}
 
 	// Create an actual rendering primitive
-	IVertexFormatDescriptor*	pVertexFormat = NULL;
-	switch ( _Primitive.m_VertexFormat )
-	{
-	case Scene::Mesh::Primitive::P3N3G3B3T2:	pVertexFormat = &VertexFormatP3N3G3B3T2::DESCRIPTOR;
+	ASSERT( _Primitive.m_VertexFormat == Scene::Mesh::Primitive::P3N3G3B3T2, "Unsupported vertex format!" );
+#ifdef USE_QUANTIZED_VERTICES
+	// Upload the quantized vertices of the scene as is, or quantize them if the scene wasn't saved with quantized vertices
+	const void*					pVertices = _Primitive.m_pQuantizedVertices;
+	BaseLib::QuantizedVertex*	pQuantizedVertices = NULL;
+	if ( pVertices == NULL ) {
+		pQuantizedVertices = new BaseLib::QuantizedVertex[_Primitive.m_VerticesCount];
+		BaseLib::QuantizeVertices( (const BaseLib::VertexP3N3G3B3T2*) _Primitive.m_pVertices, _Primitive.m_VerticesCount, (const bfloat3&) _Primitive.m_LocalBBoxMin, (const bfloat3&) _Primitive.m_LocalBBoxMax, pQuantizedVertices );
+		pVertices = pQuantizedVertices;
+	}
+#else
+	const void*					pVertices = _Primitive.m_pVertices;
+#endif
+
+	// Gather the LODs that share the primitive's vertices
+	U32			LODsCount = MIN( _Primitive.m_LODsCount, U32(Primitive::MAX_LODS) );
+	const U32*	ppLODIndices[Primitive::MAX_LODS];
+	U32			pLODIndicesCounts[Primitive::MAX_LODS];
+	for ( U32 LODIndex=0; LODIndex < LODsCount; LODIndex++ ) {
+		U32	LODFacesCount;
+		ppLODIndices[LODIndex] = _Primitive.GetFaces( 1+LODIndex, LODFacesCount );
+		pLODIndicesCounts[LODIndex] = 3*LODFacesCount;
 	}
-	ASSERT( pVertexFormat != NULL, "Unsupported vertex format!" );
 
-	Primitive*	pPrim = new Primitive( m_Device, _Primitive.m_VerticesCount, _Primitive.m_pVertices, 3*_Primitive.m_FacesCount, _Primitive.m_pFaces, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, *pVertexFormat );
+	Primitive*	pPrim = new Primitive( m_Device, _Primitive.m_VerticesCount, pVertices, 3*_Primitive.m_FacesCount, _Primitive.m_pFaces, LODsCount, ppLODIndices, pLODIndicesCounts, SCENE_VERTEX_FORMAT::DESCRIPTOR );
+#ifdef USE_QUANTIZED_VERTICES
+	delete[] pQuantizedVertices;
+#endif
 
 	// Bind additional buffer infos if they're available
 	Primitive*	pAdditionalVertexStream = m_ProbesNetwork.GetProbeIDVertexStream();
@@ -1218,8 +1297,29 @@ void*	EffectGlobalIllum2::TagPrimitive( const Scene& _Owner, Scene::Mesh& _Mesh,
 		pPrim->BindVertexStream( 1, *pAdditionalVertexStream, m_TotalVerticesCount );	// We access a small portion of the buffer that only concerns this primitive's vertices
 	}
 
-	// Tag the primitive with the face offset
-	pPrim->m_pTag = (void*) m_TotalFacesCount;
+	// Tag the primitive with the face offset and its LOD face remaps
+	PrimitiveTag*	pTag = new PrimitiveTag;
+	pTag->FaceOffset = m_TotalFacesCount;
+	if ( LODsCount > 0 ) {
+		// Each LOD face is mapped to the first full detail face using its first vertex
+		U32*	pVertexFace = new U32[_Primitive.m_VerticesCount];
+		memset( pVertexFace, 0, _Primitive.m_VerticesCount*sizeof(U32) );
+		for ( int FaceIndex=_Primitive.m_FacesCount-1; FaceIndex >= 0; FaceIndex-- ) {
+			pVertexFace[_Primitive.m_pFaces[3*FaceIndex+0]] = FaceIndex;
+			pVertexFace[_Primitive.m_pFaces[3*FaceIndex+1]] = FaceIndex;
+			pVertexFace[_Primitive.m_pFaces[3*FaceIndex+2]] = FaceIndex;
+		}
+
+		for ( U32 LODIndex=0; LODIndex < LODsCount; LODIndex++ ) {
+			pTag->pLODFaceRemapOffsets[LODIndex] = m_LODFaceRemap.Count();
+			const U32*	pLODIndices = ppLODIndices[LODIndex];
+			for ( U32 FaceIndex=0; FaceIndex < pLODIndicesCounts[LODIndex] / 3; FaceIndex++ )
+				m_LODFaceRemap.Append( pVertexFace[pLODIndices[3*FaceIndex]] );
+		}
+
+		delete[] pVertexFace;
+	}
+	pPrim->m_pTag = pTag;
 	m_pPrimitiveFaceOffset[m_TotalPrimitivesCount] = m_TotalFacesCount;		// Store face offset for each primitive
 	m_pPrimitiveVertexOffset[m_TotalPrimitivesCount] = m_TotalVerticesCount;// Store vertex offset also
 	m_TotalVerticesCount += pPrim->GetVerticesCount();						// Increase total amount of vertices
@@ -1244,9 +1344,29 @@ void*	EffectGlobalIllum2::TagPrimitive( const Scene& _Owner, Scene::Mesh& _Mesh,
 // Mesh rendering: we render each of the mesh's primitive in turn
 void	EffectGlobalIllum2::RenderMesh( const Scene::Mesh& _Mesh, Shader* _pMaterialOverride, bool _SetMaterial )
 {
+	RenderMeshLOD( _Mesh, _pMaterialOverride, _SetMaterial, NULL, 0.0f );
+}
+
+// Returns the distance from a position to a bounding box, 0 if the position is inside the box
+static float	DistanceToBBox( const float3& _Position, const float3& _BBoxMin, const float3& _BBoxMax )
+{
+	float3	Delta = (_BBoxMin - _Position).Max( _Position - _BBoxMax ).Max( float3::Zero );
+	return Delta.Length();
+}
+
+void	EffectGlobalIllum2::RenderMeshLOD( const Scene::Mesh& _Mesh, Shader* _pMaterialOverride, bool _SetMaterial, const float3* _pwsCameraPosition, float _LODProjectionScale )
+{
+	// LOD errors are expressed in local space so we need the mesh's scale
+	float3	X = _Mesh.m_Local2World.GetRow( 0 );
+	float3	Y = _Mesh.m_Local2World.GetRow( 1 );
+	float3	Z = _Mesh.m_Local2World.GetRow( 2 );
+	float	MeshScale = MAX( MAX( X.Length(), Y.Length() ), Z.Length() );
+
 	// Upload the object's CB
 	memcpy( &m_pCB_Object->m.Local2World, &_Mesh.m_Local2World, sizeof(float4x4) );
+#ifndef USE_QUANTIZED_VERTICES
 	m_pCB_Object->UpdateData();
+#endif
 
 	for ( int PrimitiveIndex=0; PrimitiveIndex < _Mesh.m_PrimitivesCount; PrimitiveIndex++ )
 	{
@@ -1259,6 +1379,21 @@ void	EffectGlobalIllum2::RenderMesh( const Scene::Mesh& _Mesh, Shader* _pMateria
 		Primitive*	pPrim = (Primitive*) ScenePrimitive.m_pTag;
 		if ( pPrim == NULL )
 			continue;	// Unsupported primitive!
+		const PrimitiveTag&	Tag = *((PrimitiveTag*) pPrim->m_pTag);
+
+		// Select the LOD
+		U32	LOD = 0;
+		if ( _LODProjectionScale > 0.0f && pPrim->GetLODsCount() > 0 ) {
+			float	Distance = _pwsCameraPosition != NULL ? DistanceToBBox( *_pwsCameraPosition, ScenePrimitive.m_GlobalBBoxMin, ScenePrimitive.m_GlobalBBoxMax ) : 1.0f;
+			LOD = MIN( ScenePrimitive.SelectLOD( Distance, MeshScale * _LODProjectionScale, MAX_LOD_PIXEL_ERROR ), pPrim->GetLODsCount() );
+		}
+
+#ifdef USE_QUANTIZED_VERTICES
+		// Upload the bounding box the primitive's positions are quantized in
+		m_pCB_Object->m.PositionMin = ScenePrimitive.m_LocalBBoxMin;
+		m_pCB_Object->m.PositionExtent = ScenePrimitive.m_LocalBBoxMax - ScenePrimitive.m_LocalBBoxMin;
+		m_pCB_Object->UpdateData();
+#endif
 
 		// Upload textures
 		if ( _SetMaterial )
@@ -1296,15 +1431,16 @@ void	EffectGlobalIllum2::RenderMesh( const Scene::Mesh& _Mesh, Shader* _pMateria
 			m_pCB_Material->m.HasSpecularTexture = pTexSpecularAlbedo != NULL;
 			m_pCB_Material->m.EmissiveColor = SceneMaterial.m_EmissiveColor;
 			m_pCB_Material->m.SpecularExponent = SceneMaterial.m_SpecularExponent.x;
-			m_pCB_Material->m.FaceOffset = U32(pPrim->m_pTag);
+			m_pCB_Material->m.FaceOffset = Tag.FaceOffset;
 			m_pCB_Material->m.HasNormalTexture = pTexNormal != NULL;
+			m_pCB_Material->m.LODFaceRemapOffset = LOD > 0 ? Tag.pLODFaceRemapOffsets[LOD-1] : ~0U;
 			m_pCB_Material->UpdateData();
 
 			pMat->Use();
 		}
 
 		// Render
-		pPrim->Render( *pMat );
+		pPrim->RenderLOD( *pMat, LOD );
 	}
 }
 
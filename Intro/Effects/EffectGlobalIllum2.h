@@ -39,6 +39,9 @@ protected:	// NESTED TYPES
 
 	struct CBObject {
 		float4x4	Local2World;	// Local=>World transform to rotate the object
+		float3		PositionMin;	// Bounding box of the primitive's quantized positions (cf. USE_QUANTIZED_VERTICES)
+		float		__PAD0;
+		float3		PositionExtent;
  	};
 
 	struct CBObjectVoronoi {
@@ -67,6 +70,7 @@ protected:	// NESTED TYPES
 		float		SpecularExponent;
 		U32			FaceOffset;		// The offset to apply to the object's face index to obtain an absolute face index
 		U32			HasNormalTexture;
+		U32			LODFaceRemapOffset;	// The offset of the rendered LOD's face remap, or ~0 when rendering full detail faces
 	};
 
 	struct CBShadowMap {
@@ -83,15 +87,8 @@ protected:	// NESTED TYPES
 	};
 
 	// Structured Buffers
-	// Light buffer
-	struct	LightStruct
-	{
-		Scene::Light::LIGHT_TYPE	Type;
-		float3		Position;
-		float3		Direction;
-		float3		Color;
-		float4		Parms;						// X=Falloff radius, Y=Cutoff radius, Z=Cos(Falloff angle), W=Cos(Cutoff angle)
-	};
+	// Light buffer (shared with the probe network so it can schedule probe updates depending on lights and light probes on the CPU)
+	typedef SHProbeNetwork::DynamicUpdateParms::DynamicLight	LightStruct;
 
 #pragma pack( pop )
 
@@ -99,15 +96,22 @@ protected:	// NESTED TYPES
 	class	RenderScene : public SHProbeNetwork::IRenderSceneDelegate {
 	public:	EffectGlobalIllum2&	m_this;
 		RenderScene( EffectGlobalIllum2& _this ) : m_this( _this ) {}
-		void	operator()( Shader& _Material ) {
+		void	operator()( Shader& _Material, const float3& _wsCameraPosition, float _LODProjectionScale ) {
 			for ( int MeshIndex=0; MeshIndex < m_this.m_Scene.m_MeshesCount; MeshIndex++ )
-				m_this.RenderMesh( *m_this.m_ppCachedMeshes[MeshIndex], &_Material, true );
+				m_this.RenderMeshLOD( *m_this.m_ppCachedMeshes[MeshIndex], &_Material, true, &_wsCameraPosition, _LODProjectionScale );
 		}
 	};
 
 
 protected:
 
+	// Tag of the rendering primitives
+	struct	PrimitiveTag
+	{
+		U32			FaceOffset;									// The offset to apply to the primitive's face indices to obtain an absolute face index
+		U32			pLODFaceRemapOffsets[Primitive::MAX_LODS];	// The offset of each LOD's face remap in m_LODFaceRemap
+	};
+
 	struct	DynamicObject
 	{
 		float3		PositionStart;
@@ -122,6 +126,7 @@ private:	// FIELDS
 	Device&				m_Device;
 	Texture2D&			m_RTTarget;
 	Primitive&			m_ScreenQuad;
+	Camera&				m_Camera;
 
 	Shader*			m_pMatRender;					// Displays the scene
 	Shader*			m_pMatRenderEmissive;			// Displays the scene's emissive objects (area lights)
@@ -162,6 +167,10 @@ private:	// FIELDS
 	U32					m_pPrimitiveFaceOffset[MAX_SCENE_PRIMITIVES];
 	U32					m_pPrimitiveVertexOffset[MAX_SCENE_PRIMITIVES];
 
+		// Full detail face index of each LOD face, so the probes see the same face IDs whatever the LOD they're rendered with
+	List<U32>			m_LODFaceRemap;
+	SB<U32>*			m_pSB_LODFaceRemap;
+
 		// Dynamic objects
 	DynamicObject		m_pDynamicObjects[MAX_DYNAMIC_OBJECTS];
 
@@ -288,6 +297,11 @@ public:		// METHODS
 
 private:
 
+	// Renders a mesh selecting the LOD of each primitive
+	//	_pwsCameraPosition, the camera position or NULL for an orthographic projection
+	//	_LODProjectionScale, the factor converting an error at a distance of 1 into pixels (or pixels per world unit for an orthographic projection), 0 renders full detail
+	void			RenderMeshLOD( const Scene::Mesh& _Mesh, Shader* _pMaterialOverride, bool _SetMaterial, const float3* _pwsCameraPosition, float _LODProjectionScale );
+
 	void			RenderShadowMap( const float3& _SunDirection );
 	void			RenderShadowMapPoint( const float3& _Position, float _FarClipDistance );
 
@@ -125,8 +125,19 @@ EffectVolumetric::EffectVolumetric( Device& _Device, Texture2D& _RTHDR, Primitiv
 
 #ifdef SHOW_TERRAIN
 	{
-		m_pPrimTerrain = new Primitive( m_Device, VertexFormatP3::DESCRIPTOR );
-		GeometryBuilder::BuildPlane( 200, 200, float3::UnitX, -float3::UnitZ, *m_pPrimTerrain );
+		// Dense enough for the bands to be generated in parallel, straight into the final vertex format
+		int	VerticesCount, IndicesCount;
+		GeometryBuilder::GetPlaneSize( 200, 200, VerticesCount, IndicesCount );
+
+		VertexFormatP3*	pVertices = new VertexFormatP3[VerticesCount];
+		U32*			pIndices = new U32[IndicesCount];
+		GeometryBuilder::LayoutInterleaved<VertexFormatP3>	Layout( pVertices, pIndices );
+		GeometryBuilder::GeneratePlane( 200, 200, float3::UnitX, -float3::UnitZ, Layout, GeometryBuilder::NoMapper(), GeometryBuilder::NoTweak() );
+
+		m_pPrimTerrain = new Primitive( m_Device, VerticesCount, pVertices, IndicesCount, pIndices, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, VertexFormatP3::DESCRIPTOR );
+
+		delete[] pVertices;
+		delete[] pIndices;
 	}
 #endif
 
@@ -145,6 +145,20 @@ int	IntroInit( IntroProgressDelegate& _Delegate )
 		gs_pPrimQuad = new Primitive( gs_Device, 4, pVertices, 0, NULL, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, VertexFormatPt4::DESCRIPTOR );
 	}
 
+#ifdef _DEBUG
+	//////////////////////////////////////////////////////////////////////////
+	// Make sure the templated geometry path used by the effects still builds the same primitives as the virtual one
+	{
+		double	BuildTime, GenerateTime;
+		if ( !GeometryBuilder::CheckGeneratePath( BuildTime, GenerateTime ) )
+			return ERR_EFFECT_INTRO+2;
+
+		char	pTemp[256];
+		sprintf_s( pTemp, "GeometryBuilder check: Build() %.3f ms, Generate() %.3f ms\n", BuildTime, GenerateTime );
+		OutputDebugString( pTemp );
+	}
+#endif
+
 	//////////////////////////////////////////////////////////////////////////
 	// Create materials
 	{
@@ -369,9 +369,6 @@ void	Bitmap::LDR2HDR( U32 _imagesCount, const ImageFile** _images, const float*
 #endif
 }
 
-void svdcmp( int m, int n, float** a, float w[], float** v );
-void svdcmp_ORIGINAL( int m, int n, float** a, float w[], float** v );
-
 //#define DEBUG_LINEAR_SIGNAL	// Define this to inject a linear sensor response for debugging purpose
 
 void	Bitmap::ComputeCameraResponseCurve( U32 _imagesCount, const ImageFile** _images, const float* _imageShutterSpeeds, U32 _inputBitsPerComponent, float _curveSmoothnessConstraint, float _quality, bool _luminanceOnly, List< bfloat3 >& _responseCurve ) {
@@ -512,7 +509,6 @@ pixelValue = SATURATE( float(1+pixelIndex) / sequence.Count() * powf( 2.0f, -flo
 	// 2] Apply SVD 
 	const float	lambda = _curveSmoothnessConstraint;
 
-#if 1
 	U32	equationsCount  = totalPixelsCount		// Pixels
 						+ responseCurveSize		// Used to enforce the smoothness of the g curve
 						+ 1;					// Constraint that g(Zmid) = 0 (with Zmid = (Zmax+Zmin)/2)
@@ -611,444 +607,6 @@ imageEV = -float(imageIndex);
 		}
 	}
 
-#else
-
-#if 0
-	U32	equationsCount  = 3;
-	U32	unknownsCount	= 3;
-
-	float*	Aterms = new float[equationsCount*unknownsCount];	// M*N matrix with M rows = #equations and N columns = #unknowns
-	float**	A = new float*[equationsCount];
-	for ( U32 rowIndex=0; rowIndex < equationsCount; rowIndex++ ) A[rowIndex] = &Aterms[unknownsCount*rowIndex];	// Initialize each row pointer
-
-	float*	Vterms = new float[unknownsCount*unknownsCount];	// N*N matrix
-	float**	V = new float*[unknownsCount];
-	for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) V[rowIndex] = &Vterms[unknownsCount*rowIndex];		// Initialize each row pointer
-
-	float*	w = new float[unknownsCount];
-
-	float*	b = new float[equationsCount];
-
-	float*	x = new float[unknownsCount];	// Our result vector
-	float*	tempX = new float[unknownsCount];
-
-A[0][0] = 1;
-A[0][1] = 2;
-A[0][2] = 3;
-A[1][0] = 0;
-A[1][1] = 1;
-A[1][2] = 4;
-A[2][0] = 5;
-A[2][1] = 6;
-A[2][2] = 0;
-
-	U32*	pixelPtr = pixels;
-	for ( U32 componentIndex=0; componentIndex < componentsCount; componentIndex++ ) {	// Because R, G, B
-
-
-#else
-	U32	equationsCount  = totalPixelsCount		// Pixels
-						+ responseCurveSize		// Used to enforce the smoothness of the g curve
-						+ 1;					// Constraint that g(Zmid) = 0 (with Zmid = (Zmax+Zmin)/2)
-	U32	unknownsCount	= responseCurveSize		// g(Z) = curve solution
-						+ pixelsCountPerImage;	// log(E) for each pixel
-
-	float*	Aterms = new float[equationsCount*unknownsCount];	// M*N matrix with M rows = #equations and N columns = #unknowns
-	float**	A = new float*[equationsCount];
-	for ( U32 rowIndex=0; rowIndex < equationsCount; rowIndex++ ) A[rowIndex] = &Aterms[unknownsCount*rowIndex];	// Initialize each row pointer
-
-	float*	Vterms = new float[unknownsCount*unknownsCount];	// N*N matrix
-	float**	V = new float*[unknownsCount];
-	for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) V[rowIndex] = &Vterms[unknownsCount*rowIndex];		// Initialize each row pointer
-// 
-// 	float*	w = new float[unknownsCount];
-// 
- 	float*	b = new float[equationsCount];
-// 
-// 	float*	x = new float[unknownsCount];	// Our result vector
-// 	float*	tempX = new float[unknownsCount];
-
-	MathSolvers::MatrixF	A_( equationsCount, unknownsCount );
-	MathSolvers::MatrixF	V_( unknownsCount, unknownsCount );
-	MathSolvers::VectorF	w( unknownsCount );
-	MathSolvers::VectorF	b_( equationsCount );
-	MathSolvers::VectorF	tempX( unknownsCount );
-	MathSolvers::VectorF	x( unknownsCount );
-
-
-	float**	Arows = new float*[equationsCount];
-	for ( U32 rowIndex=0; rowIndex < equationsCount; rowIndex++ ) Arows[rowIndex] = A_[rowIndex].m;	// Initialize each row pointer
-	float**	Vrows = new float*[unknownsCount];
-	for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) Vrows[rowIndex] = V_[rowIndex].m;	// Initialize each row pointer
-
-
-
-	U32*	pixelPtr = pixels;
-	for ( U32 componentIndex=0; componentIndex < componentsCount; componentIndex++ ) {	// Because R, G, B
-
-		// ===================================================================
-		// 2.1] Build the "A" matrix and target vector "b"
-		memset( Aterms, 0, equationsCount*unknownsCount*sizeof(float) );
-		memset( b, 0, equationsCount*sizeof(float) );
-		A_.Clear();
-		b_.Clear();
-
-		// 2.1.1) Fill the first part of the equations containing our data
-		float**		A1 = &A[0];	// A1 starts at A
-		MathSolvers::VectorF*	A1_ = &A_[0];	// A1 starts at A
-		for ( U32 imageIndex=0; imageIndex < _imagesCount; imageIndex++ ) {
-
-			// Compute image EV = log2(shutterSpeed)
-			// (e.g. taking 3 shots in bracket mode with shutter speeds [1/4s, 1s, 4s] will yield EV array [-2, 0, +2] respectively)
-			//
-			float	imageShutterSpeed = _imageShutterSpeeds[imageIndex];
-			float	imageEV = log2f( imageShutterSpeed );
-
-#ifdef DEBUG_LINEAR_SIGNAL
-imageEV = -float(imageIndex);
-#endif
-
-			for ( int pixelIndex=0; pixelIndex < pixelsCountPerImage; pixelIndex++, A1_++ ) {
-				float*	columns = *A1++;
-
-				// Zij = pixel value for selected pixel i in image j
-				U32		Z = *pixelPtr++;
-
-				// Weight based on Z position within the range [Zmin,Zmax]
-				float	Wij = ComputeWeight( Z, responseCurveSize );
-
-				// First weight g(Zi)
-				columns[Z] = Wij;
-				(*A1_)[Z] = Wij;
-
-				// Next, weight ln(Ei)
- 				columns[responseCurveSize + pixelIndex] = -Wij;
-				(*A1_)[responseCurveSize + pixelIndex] = -Wij;
-
-				// And subtract weighted EV = log2(DeltaT)
-				b[pixelsCountPerImage*imageIndex + pixelIndex] = Wij * imageEV;
-				b_[pixelsCountPerImage*imageIndex + pixelIndex] = Wij * imageEV;
-			}
-		}
-
-		// 2.1.2) Fill the second part of the equations containing weighted smoothing coefficients
-		// This part will ensure the g() curve's smoothness
-		float**	A2 = &A[totalPixelsCount];	// A2 starts at the end of A's first part, A1
-		MathSolvers::VectorF*	A2_ = &A_[totalPixelsCount];	// A2 starts at the end of A's first part, A1
-
-		A2[0][0] = lambda * ComputeWeight( 0, responseCurveSize );	// First element can't reach neighbors
-		A2_[0][0] = lambda * ComputeWeight( 0, responseCurveSize );	// First element can't reach neighbors
-		U32		Z = 1;
-		for ( ; Z < responseCurveSize-1; Z++ ) {
-			float	Weight = lambda * ComputeWeight( Z, responseCurveSize );
-			A2[Z][Z-1] = Weight;
-			A2[Z][Z+0] = -2.0f * Weight;
-			A2[Z][Z+1] = Weight;
-			A2_[Z][Z-1] = Weight;
-			A2_[Z][Z+0] = -2.0f * Weight;
-			A2_[Z][Z+1] = Weight;
-		}
-		A2[Z][Z] = lambda * ComputeWeight( Z, responseCurveSize );	// Last element can't reach neighbors either
-		A2_[Z][Z] = lambda * ComputeWeight( Z, responseCurveSize );	// Last element can't reach neighbors either
-
-		// 2.1.3) Fill the last equation used to ensure the Zmid value transforms into g(Zmid) = 0
-		float**	A3 = &A[totalPixelsCount+responseCurveSize];	// A3 starts at the end of A's second part and should actually be the last row of A
-		MathSolvers::VectorF*	A3_ = &A_[totalPixelsCount+responseCurveSize];	// A3 starts at the end of A's second part and should actually be the last row of A
-
-		A3[0][responseCurveSize>>1] = 1;	// Make sure g(Zmid) maps to 0
-		A3_[0][responseCurveSize>>1] = 1;	// Make sure g(Zmid) maps to 0
-
-		ASSERT( memcmp( Aterms, A_.m_raw, equationsCount*unknownsCount*sizeof(float) ) == 0, "RHA!" );
-		ASSERT( memcmp( b, b_.m, equationsCount*sizeof(float) ) == 0, "RHA!" );
-#endif
-
-		// ===================================================================
-		// 2.2] Apply SVD
-#if 0
-float*	Abackup = new float[equationsCount*unknownsCount];
-memcpy_s( Abackup, equationsCount*unknownsCount*sizeof(float), Aterms, equationsCount*unknownsCount*sizeof(float) );
-
-// Fill up the debug bitmap with the matrix's coefficients
-ms_DEBUG->Init( unknownsCount, equationsCount, ImageFile::PIXEL_FORMAT::R16, ColorProfile( ColorProfile::STANDARD_PROFILE::sRGB ) );
-for ( U32 i=0; i < equationsCount; i++ ) {
-	for ( U32 j=0; j < unknownsCount; j++ ) {
-		float	value = 0.0078125f * A[i][j];
-		ms_DEBUG->Set( j, i, bfloat4( value, value, value, 1.0f ) );
-	}
-}
-
-#endif
-
-		svdcmp( equationsCount, unknownsCount, Arows, w.m, Vrows );
-
-#if 0	// Check against the original routine
-float*	resultA = new float[equationsCount*unknownsCount];
-float*	resultW = new float[unknownsCount];
-float*	resultV = new float[unknownsCount*unknownsCount];
-memcpy( resultA, Aterms, equationsCount*unknownsCount*sizeof(float) );
-memcpy( resultW, w, unknownsCount*sizeof(float) );
-memcpy( resultV, Vterms, unknownsCount*unknownsCount*sizeof(float) );
-
-
-// Copy back and call again using original routine this time
-memcpy_s( Aterms, equationsCount*unknownsCount*sizeof(float), Abackup, equationsCount*unknownsCount*sizeof(float) );
-float**	A_index1 = new float*[1+equationsCount];
-for ( int rowIndex=0; rowIndex < equationsCount; rowIndex++ ) A_index1[1+rowIndex] = &Aterms[unknownsCount*rowIndex] - 1;	// Initialize each row pointer
-float**	V_index1 = new float*[1+unknownsCount];
-for ( int rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) V_index1[1+rowIndex] = &Vterms[unknownsCount*rowIndex] - 1;		// Initialize each row pointer
-
-svdcmp_ORIGINAL( equationsCount, unknownsCount, A_index1, w-1, V_index1 );
-
-float	sumDiffA = 0.0f;
-float	sumDiffV = 0.0f;
-float	sumDiffW = 0.0f;
-for ( U32 j=0; j < unknownsCount; j++ ) {
-	for ( U32 i=0; i < equationsCount; i++ ) {
-		if ( i < unknownsCount )
-			sumDiffV += fabs(resultV[unknownsCount*i+j] - V[i][j] );
-		sumDiffA += fabs(resultA[unknownsCount*i+j] - A[i][j] );
-	}
-	sumDiffW += fabs( resultW[j] - w[j] );
-}
-#endif
-
-#if 0
-// Check U and V are orthonormal
-float	minDot = FLT_MAX;
-float	maxDot = -FLT_MAX;
-float	avgDot = 0.0f;
-float	sameColumn_minDot = FLT_MAX;
-float	sameColumn_maxDot = -FLT_MAX;
-float	sameColumn_avgDot = 0.0f;
-// Check U
-for ( U32 col0=0; col0 < unknownsCount-1; col0++ ) {
-	for ( U32 col1=col0+1; col1 < unknownsCount; col1++ ) {
-		float	dot = 0.0f;
-		for ( U32 i=0; i < equationsCount; i++ ) {
-			const float	c0 = A[i][col0];
-			const float	c1 = A[i][col1];
-			dot += c0*c1;
-		}
-		minDot = MIN( minDot, dot );
-		maxDot = MAX( maxDot, dot );
-		avgDot += dot;
-	}
-
-	// Check column norm
-	float	dot = 0.0f;
-	for ( U32 i=0; i < equationsCount; i++ ) {
-		const float	c0 = A[i][col0];
-		dot += c0*c0;
-	}
-	sameColumn_minDot = MIN( sameColumn_minDot, dot );
-	sameColumn_maxDot = MAX( sameColumn_maxDot, dot );
-	sameColumn_avgDot += dot;
-}
-avgDot /= unknownsCount-1;
-sameColumn_avgDot /= unknownsCount;
-
-// Check V
-minDot = FLT_MAX;
-maxDot = -FLT_MAX;
-avgDot = 0.0f;
-sameColumn_minDot = FLT_MAX;
-sameColumn_maxDot = -FLT_MAX;
-sameColumn_avgDot = 0.0f;
-for ( U32 col0=0; col0 < unknownsCount-1; col0++ ) {
-	for ( U32 col1=col0+1; col1 < unknownsCount; col1++ ) {
-		float	dot = 0.0f;
-		for ( U32 i=0; i < unknownsCount; i++ ) {
-			const float	c0 = V[i][col0];
-			const float	c1 = V[i][col1];
-			dot += c0*c1;
-		}
-		minDot = MIN( minDot, dot );
-		maxDot = MAX( maxDot, dot );
-		avgDot += dot;
-	}
-
-	// Check column norm
-	float	dot = 0.0f;
-	for ( U32 i=0; i < unknownsCount; i++ ) {
-		const float	c0 = V[i][col0];
-		dot += c0*c0;
-	}
-	sameColumn_minDot = MIN( sameColumn_minDot, dot );
-	sameColumn_maxDot = MAX( sameColumn_maxDot, dot );
-	sameColumn_avgDot += dot;
-}
-avgDot /= unknownsCount-1;
-sameColumn_avgDot /= unknownsCount;
-#endif
-
-#if 0	// Debug visually by transforming matrices into a bitmap
-// Fill up the debug bitmap with the matrix's coefficients
-ms_DEBUG->Init( unknownsCount, equationsCount, ImageFile::PIXEL_FORMAT::R16, ColorProfile( ColorProfile::STANDARD_PROFILE::sRGB ) );
-for ( U32 i=0; i < equationsCount; i++ ) {
-	for ( U32 j=0; j < unknownsCount; j++ ) {
-		float	value = 1000.0f * 0.0078125f * A[i][j];
-		ms_DEBUG->Set( j, i, bfloat4( value, value, value, 1.0f ) );
-	}
-}
-// ms_DEBUG->Init( unknownsCount, unknownsCount, ImageFile::PIXEL_FORMAT::R16, ColorProfile( ColorProfile::STANDARD_PROFILE::sRGB ) );
-// for ( U32 i=0; i < unknownsCount; i++ ) {
-// 	for ( U32 j=0; j < unknownsCount; j++ ) {
-// 		float	value = 1000.0f * 0.0078125f * V[i][j];
-// 		ms_DEBUG->Set( j, i, bfloat4( value, value, value, 1.0f ) );
-// 	}
-// }
-// ms_DEBUG->Init( unknownsCount, unknownsCount, ImageFile::PIXEL_FORMAT::R16, ColorProfile( ColorProfile::STANDARD_PROFILE::sRGB ) );
-// for ( U32 i=0; i < unknownsCount; i++ ) {
-// 	float	value = 0.001f * fabs(w[i]);
-// 	for ( U32 j=0; j < unknownsCount; j++ ) {
-// 		ms_DEBUG->Set( j, i, bfloat4( value, value, value, 1.0f ) );
-// 	}
-// }
-
-//throw "PIPO!";
-#endif
-
-#if 0
-// Ensure the product of A.A^-1 = (U.w.V^T) * (V.1/w.U^T) = I
-
-// Recompose A from U, w and V
-float*	Arecomposed = new float[equationsCount*unknownsCount];
-for ( U32 rowIndex=0; rowIndex < equationsCount; rowIndex++ ) {
-	for ( U32 columnIndex=0; columnIndex < unknownsCount; columnIndex++ ) {
-		float	r = 0.0f;
-		for ( U32 i=0; i < unknownsCount; i++ ) {
-			const float	VTterm = V[columnIndex][i];	// V was returned, we need V^T
-			const float	Wterm = w[i];
-			const float	Uterm = A[rowIndex][i];
-			r += Uterm * Wterm * VTterm;
-		}
-		Arecomposed[rowIndex*unknownsCount + columnIndex] = r;
-	}
-}
-
-// Ensure recomposition yields original A
-float	sumSqDiff = 0.0f;
-for ( int i=equationsCount*unknownsCount-1; i >= 0; i-- ) {
-	float	originalTerm = Abackup[i];
-	float	recomposedTerm = Arecomposed[i];
-	float	diff = originalTerm - recomposedTerm;
-	sumSqDiff += diff * diff;
-}
-sumSqDiff /= equationsCount*unknownsCount;
-ASSERT( sumSqDiff < 1e-4f, "Singular Value Decomposition is wrong!" );
-
-// Recompose A^-1
-float*	Ainverse = new float[unknownsCount*equationsCount];
-for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) {
-	for ( U32 columnIndex=0; columnIndex < equationsCount; columnIndex++ ) {
-		float	r = 0.0f;
-		for ( U32 i=0; i < unknownsCount; i++ ) {
-			const float	Vterm = V[rowIndex][i];
-			const float	recWterm = w[i] != 0.0f ? 1.0f / w[i] : 0.0f;
-			const float	UTterm = A[columnIndex][i];
-			r += Vterm * recWterm * UTterm;
-		}
-		Ainverse[rowIndex*equationsCount + columnIndex] = r;
-	}
-}
-
-// Apply product of matrices
-float*	Aproduct = new float[equationsCount*equationsCount];
-for ( U32 rowIndex=0; rowIndex < equationsCount; rowIndex++ ) {
-	for ( U32 columnIndex=0; columnIndex < equationsCount; columnIndex++ ) {
-		float	r = 0.0f;
-		for ( U32 i=0; i < unknownsCount; i++ ) {
-			const float	a = Arecomposed[unknownsCount*rowIndex+i];
-			const float	aI = Ainverse[equationsCount*i+columnIndex];
-			r += a * aI;
-		}
-		Aproduct[rowIndex*equationsCount + columnIndex] = r;
-	}
-}
-
-// Ensure product yields identity
-float	sumDiagonal = 0.0f;
-float	sumOffDiagonal = 0.0f;
-for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) {
-	for ( U32 columnIndex=0; columnIndex < unknownsCount; columnIndex++ ) {
-		float	absTerm = fabs( Aproduct[unknownsCount*rowIndex+columnIndex] );
-		if ( rowIndex == columnIndex )
-			sumDiagonal += absTerm;
-		else
-			sumOffDiagonal += absTerm;
-	}
-}
-sumDiagonal /= unknownsCount;
-sumOffDiagonal /= unknownsCount * (unknownsCount-1);
-ASSERT( sumOffDiagonal < 1e-4f, "Singular Value Decomposition is wrong!" );
-ASSERT( fabs( sumDiagonal - 1.0f) < 1e-4f, "Singular Value Decomposition is wrong!" );
-
-delete[] Aproduct;
-delete[] Arecomposed;
-delete[] Ainverse;
-delete[] Abackup;
-#endif
-
-
-		// ===================================================================
-		// 2.3] Solve for x
-		// We know that A was decomposed into U.w.V^T where U and V are orthonormal matrices and w a diagonal matrix with (theoretically) non null components
-		//	so A^-1 = V.1/w.U^T
-		// Since A.x = b it ensues that x = A^-1.b
-		//
-		
-		// 2.3.1) Perform 1/w * U^T * b
-		for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) {
-			float	r = 0.0f;
-			for ( U32 i=0; i < equationsCount; i++ ) {
-				const float	Uterm = A[i][rowIndex];	// The svdcmp() routine used A to store the U matrix in place
-				const float	bterm = b[i];
-				r += Uterm * bterm;
-			}
-
-			// Multiply by 1/w
-			const float	wterm = w[rowIndex];
-			float		recW = fabs( wterm ) > 1e-6f ? 1.0f / wterm : 0.0f;	// We shouldn't ever have 0 values because of the overdetermined system of equations but let's be careful anyway!
-			tempX[rowIndex] = r * recW;
-		}
-
-		// 2.3.2) Perform V * (1/w * U^T * b)
-		for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) {
-			float	r = 0.0f;
-			for ( U32 i=0; i < unknownsCount; i++ ) {
-				const float	Vterm = V[rowIndex][i];
-				const float	tempXterm = tempX[i];
-				r += Vterm * tempXterm;
-			}
-			x[rowIndex] = r;	// This is our final results!
-		}
-
-
-		// ===================================================================
-		// 2.4] Recover curve values
-		// At this point, we recovered the g(Z) for Z[Zmin,Zmax], followed by the log2(Ei) for the N selected pixels
-		// Let's just store the g(Z) into our target array
-		if ( _luminanceOnly ) {
-			for ( U32 Z=0; Z < responseCurveSize; Z++ ) {
-				_responseCurve[Z].Set( x[Z], x[Z], x[Z] );
-			}
-		} else {
-			for ( U32 Z=0; Z < responseCurveSize; Z++ ) {
-				((float*) &_responseCurve[Z].x)[componentIndex] = x[Z];
-			}
-		}
-	}
-
-// 	delete[] tempX;
-// 	delete[] x;
-// 	delete[] b;
-// 	delete[] w;
-// 	delete[] V;
-// 	delete[] Vterms;
-// 	delete[] A;
-// 	delete[] Aterms;
-#endif
-
 	delete[] pixels;
 }
 
@@ -1090,7 +648,21 @@ public:
 		}
 		return sumSqDiff / (m_curve.Count()*m_curve.Count());
 	}
+	virtual bool		EvalGradient( const VectorD& _parameters, VectorD& _gradient ) override {
+		_gradient.Clear();
+		for ( U32 i=0; i < m_curve.Count(); i++ ) {
+			double	weight = TentFilter( i );
+			double	diff = weight * weight * (EvalModel( i, _parameters ) - m_curve[i]);
+			double	x = 2.0 * diff;	// d((w.(model - curve))^2)/dp_k = 2.w^2.(model - curve).x^k
+			for ( U32 k=0; k < 4; k++, x *= i )
+				_gradient[k] += x;
+		}
+		for ( U32 k=0; k < 4; k++ )
+			_gradient[k] /= m_curve.Count()*m_curve.Count();
+		return true;
+	}
 	virtual void		Constrain( VectorD& _parameters ) override {}
+	virtual bool		IsThreadSafe() const override	{ return true; }
 
 private:
 	double TentFilter( double x ) {
@@ -1256,490 +828,6 @@ void	Bitmap::FilterCameraResponseCurve( const BaseLib::List< bfloat3 >& _rawResp
 	}
 }
 
-#pragma region SVD Decomposition
-
-float pythag(float a, float b);
-template<class T>
-inline T SIGN(const T &a, const T &b) { return b >= 0 ? (a >= 0 ? a : -a) : (a >= 0 ? -a : a); }
-
-static float maxarg1,maxarg2;
-#define FMAX(a,b) (maxarg1=(a),maxarg2=(b),(maxarg1) > (maxarg2) ?\
-        (maxarg1) : (maxarg2))
-
-static int iminarg1,iminarg2;
-#define IMIN(a,b) (iminarg1=(a),iminarg2=(b),(iminarg1) < (iminarg2) ?\
-        (iminarg1) : (iminarg2))
-
-//char	debugString[4096];
-
-// From numerical recipes, chapter 2.6 (NOTE: I rewrote the code so it uses 0-based vectors and matrices!)
-// (itself stolen from http://people.duke.edu/~hpgavin/SystemID/References/Golub+Reinsch-NM-1970.pdf)
-//
-// Given a matrix a[1..m][1..n], this routine computes its singular value decomposition, A = U  W  V^T
-//	The matrix U replaces a on output.
-//	The diagonal matrix of singular values W is output as a vector w[1..n].
-//	The matrix V (not the transpose V^T) is output as v[1..n][1..n].
-//
-void svdcmp( int m, int n, float** a, float w[], float** v ) {
-	float*	residualValues = new float[n];
-	memset( residualValues, 0, n*sizeof(float) );
-
-	float	f = 0.0f, g = 0.0f, h = 0.0f;
- 	float	scale = 0.0f;
- 	float	anorm = 0.0f;
-
-	// Householder reduction to bidiagonal form
-	for ( int i=0; i < n; i++ ) {
-		int	l = i+1;
-		residualValues[i] = scale * g;
-
-		g = 0.0f;
-		float	s = 0.0f;
-		scale = 0.0f;
-		if ( i < m ) {
-			for ( int k=i; k < m; k++ )
-				scale += fabs( a[k][i] );
-
-			if ( scale != 0.0f ) {
-				for ( int k=i; k < m; k++ ) {
-					a[k][i] /= scale;
-					s += a[k][i] * a[k][i];
-				}
-				f = a[i][i];
-				g = -SIGN( sqrt(s), f );
-				h = f*g - s;
-				a[i][i] = f-g;
-				for ( int j=l; j < n; j++ ) {
-					s = 0.0f;
-					for ( int k = i; k < m; k++)
-						s += a[k][i] * a[k][j];
-
-					f = s/h;
-					for ( int k=i; k < m; k++ )
-						a[k][j] += f*a[k][i];
-				}
-				for ( int k=i; k < m; k++ )
-					a[k][i] *= scale;
-			}
-		}
-		w[i] = scale * g;
-
-		g = 0.0f;
-		s = 0.0f;
-		scale = 0.0f;
-		if ( i < m && l < n ) {
-			for ( int k=l; k < n; k++ )
-				scale += fabs( a[i][k] );
-
-			if ( scale != 0.0f ) {
-				for ( int k=l; k < n; k++ ) {
-					a[i][k] /= scale;
-					s += a[i][k] * a[i][k];
-				}
-				f = a[i][l];
-				g = -SIGN( sqrt(s), f );
-				h = f * g - s;
-				a[i][l] = f - g;
-				for ( int k=l; k < n; k++ )
-					residualValues[k] = a[i][k] / h;
-
-				for ( int j=l; j < m; j++ ) {
-					s = 0.0f;
-					for ( int k=l; k < n; k++ )
-						s += a[j][k] * a[i][k];
-
-					for ( int k=l; k < n; k++ )
-						a[j][k] += s * residualValues[k];
-				}
-				for ( int k=l; k < n; k++ )
-					a[i][k] *= scale;
-			}
-		}
-		anorm = FMAX( anorm, (fabs(w[i])+fabs(residualValues[i])) );
-	}
-
-	// Accumulation of right-hand transformations
-	v[n-1][n-1] = 1.0f;
-	g = residualValues[n-1];
-
-	for ( int i=n-2; i >= 0; i-- ) {
-		int	l = i+1;
-		if ( g != 0.0f ) {
-			for ( int j=l; j < n; j++ )
-				v[j][i] = (a[i][j] / a[i][l]) / g;	// Double division to avoid possible underflow
-
-			for ( int j=l; j < n; j++) {
-				float	s = 0.0f;
-				for ( int k=l; k < n; k++ )
-					s += a[i][k] * v[k][j];
-				for ( int k=l; k < n; k++ )
-					v[k][j] += s * v[k][i];
-			}
-		}
-		for ( int j=l; j < n; j++ )
-			v[i][j] = v[j][i] = 0.0f;
-
-		v[i][i] = 1.0f;
-		g = residualValues[i];
-	}
-
-	// Accumulation of left-hand transformations
-	for ( int i=IMIN(m,n)-1; i >= 0; i-- ) {
-		int	l = i+1;
-		g = w[i];
-		for ( int j=l; j < n; j++ )
-			a[i][j] = 0.0f;
-		if ( g != 0.0f ) {
-			g = 1.0f / g;
-			for ( int j=l; j < n; j++ ) {
-				float	s = 0.0f;
-				for ( int k=l; k < m; k++ )
-					s += a[k][i] * a[k][j];
-
-				f = (s / a[i][i]) * g;
-				for ( int k=i; k < m; k++ )
-					a[k][j] += f * a[k][i];
-			}
-		}
-		for ( int j=i; j < m; j++ )
-			a[j][i] *= g;
-
-		++a[i][i];
-	}
-
-//return;
-
-	// Diagonalization of the bidiagonal form: Loop over singular values, and over allowed iterations
-	const int	MAX_ITERATIONS = 30;
-//	const int	MAX_ITERATIONS = 1000;
-
-	for ( int k=n-1; k >= 0; k-- ) {
-		int	iterationsCount = 1;
-		for ( ; iterationsCount <= MAX_ITERATIONS; iterationsCount++ ) {
-			int	nm;
-			// Test for splitting
-			bool	flag = true;
-			int		l = k;
-			for ( ; l >= 0; l-- ) {
-				nm = l-1;
-				// Note that rv1[0] is always zero so we eventually break at the very end
-				if ( float( fabs(residualValues[l]) + anorm ) == anorm ) {
-					flag = false;
-					break;
-				}
-				ASSERT( nm >= 0, "nm in negative range!" );
-				if ( float( fabs(w[nm]) + anorm ) == anorm )
-					break;
-			}
-			if ( flag ) {
-				// Cancellation of rv1[l], if l > 0.
-				float	c = 0.0f;
-				float	s = 1.0f;
-				for ( int i=l; i < k; i++ ) {
-					f = s * residualValues[i];
-					residualValues[i] = c * residualValues[i];
-					if ( float( fabs(f) + anorm ) == anorm )
-						break;
-
-					g = w[i];
-					h = pythag( f, g );
-					w[i] = h;
-					h = 1.0f / h;
-					c = g * h;
-					s = -f * h;
-					for ( int j=0; j < m; j++ ) {
-						float	y = a[j][nm];
-						float	z = a[j][i];
-						a[j][nm] = y*c + z*s;
-						a[j][i]  = z*c - y*s;
-					}
-				}
-			}
-			float	z = w[k];
-			if ( l == k ) {
-				// Convergence
-				if ( z < 0.0f ) {
-					// Singular value is made nonnegative
-					w[k] = -z;
-					for ( int j=0; j < n; j++ )
-						v[j][k] = -v[j][k];
-				}
-				break;
-			}
-			if ( iterationsCount >= MAX_ITERATIONS )
-				throw "No convergence in svdcmp iterations";
-
-			nm = k-1;
-			ASSERT( nm >= 0, "nm in negative range!" );
-
-			float	x = w[l];	// Shift from bottom 2-by-2 minor
-			float	y = w[nm];
-			g = residualValues[nm];
-			h = residualValues[k];
-			f = ((y-z)*(y+z)+(g-h)*(g+h)) / (2.0f*h*y);
-			g = pythag( f, 1.0f );
-			f = ((x-z)*(x+z)+h*((y/(f+SIGN(g,f)))-h))/x;
-
-// sprintf( debugString, "ITERATION %d = f = %f - g = %f - h = %f\r\n", iterationsCount, f, g, h );
-// OutputDebugStringA( debugString );
-
-			// Next QR transformation
-			float	c = 1.0f;
-			float	s = 1.0f;
-			for ( int j=l; j <= nm; j++ ) {
-				int	i = j+1;
-				g = residualValues[i];
-				y = w[i];
-				h = s*g;
-				g = c*g;
-				z = pythag( f, h );
-				residualValues[j] = z;
-				c = f/z;
-				s = h/z;
-				f = x*c + g*s;	// Rotation with sine/cosine?
-				g = g*c - x*s;
-				h = y*s;
-				y *= c;
-				for ( int jj=0; jj < n; jj++ ) {
-					x = v[jj][j];
-					z = v[jj][i];
-					v[jj][j] = x*c + z*s;
-					v[jj][i] = z*c - x*s;
-				}
-				z = pythag( f, h );
-				w[j] = z;
-				if ( z != 0.0f ) {
-					z = 1.0f / z;
-					c = f*z;
-					s = h*z;
-				}
-				f = c*g + s*y;
-				x = c*y - s*g;
-				for ( int jj=0; jj < m; jj++ ) {
-					y = a[jj][j];
-					z = a[jj][i];
-					a[jj][j] = y*c + z*s;
-					a[jj][i] = z*c - y*s;
-				}
-
-// sprintf( debugString, "j = %d -> z = %f - f = %f - x = %f\r\n", j, z, f, x );
-// OutputDebugStringA( debugString );
-			}
-			residualValues[l] = 0.0f;
-			residualValues[k] = f;
-			w[k] = x;
-		}	// for ( ; iterationsCount <= 30; iterationsCount++ ) 
-	}	// for ( int k=n-1; k >= 0; k-- ) 
-
-	delete[] residualValues;
-}
-
-
-void svdcmp_ORIGINAL(int m, int n, float **a, float w[], float **v) {
-	int flag,i,its,j,jj,k,l,nm;
-	float anorm,c,f,g,h,s,scale,x,y,z,*rv1;
-
-	rv1 = new float[1+n];
-	memset( rv1, 0, (1+n) * sizeof(float) );
-
-	g=scale=anorm=0.0;
-	for (i=1;i<=n;i++) {
-		l=i+1;
-		rv1[i]=scale*g;
-		g=s=scale=0.0;
-		if (i <= m) {
-			for (k=i;k<=m;k++) scale += fabs(a[k][i]);
-			if (scale) {
-				for (k=i;k<=m;k++) {
-					a[k][i] /= scale;
-					s += a[k][i]*a[k][i];
-				}
-				f=a[i][i];
-				g = -SIGN(sqrt(s),f);
-				h=f*g-s;
-				a[i][i]=f-g;
-				for (j=l;j<=n;j++) {
-					for (s=0.0,k=i;k<=m;k++) s += a[k][i]*a[k][j];
-					f=s/h;
-					for (k=i;k<=m;k++) a[k][j] += f*a[k][i];
-				}
-				for (k=i;k<=m;k++) a[k][i] *= scale;
-			}
-		}
-		w[i]=scale *g;
-		g=s=scale=0.0;
-		if (i <= m && i != n) {
-			for (k=l;k<=n;k++) scale += fabs(a[i][k]);
-			if (scale) {
-				for (k=l;k<=n;k++) {
-					a[i][k] /= scale;
-					s += a[i][k]*a[i][k];
-				}
-				f=a[i][l];
-				g = -SIGN(sqrt(s),f);
-				h=f*g-s;
-				a[i][l]=f-g;
-				for (k=l;k<=n;k++) rv1[k]=a[i][k]/h;
-				for (j=l;j<=m;j++) {
-					for (s=0.0,k=l;k<=n;k++) s += a[j][k]*a[i][k];
-					for (k=l;k<=n;k++) a[j][k] += s*rv1[k];
-				}
-				for (k=l;k<=n;k++) a[i][k] *= scale;
-			}
-		}
-		anorm=FMAX(anorm,(fabs(w[i])+fabs(rv1[i])));
-	}
-
-	for (i=n;i>=1;i--) {
-		if (i < n) {
-			if (g) {
-				for (j=l;j<=n;j++)
-					v[j][i]=(a[i][j]/a[i][l])/g;
-				for (j=l;j<=n;j++) {
-					for (s=0.0,k=l;k<=n;k++) s += a[i][k]*v[k][j];
-					for (k=l;k<=n;k++) v[k][j] += s*v[k][i];
-				}
-			}
-			for (j=l;j<=n;j++) v[i][j]=v[j][i]=0.0;
-		}
-		v[i][i]=1.0;
-		g=rv1[i];
-		l=i;
-	}
-
-	for (i=IMIN(m,n);i>=1;i--) {
-		l=i+1;
-		g=w[i];
-		for (j=l;j<=n;j++) a[i][j]=0.0;
-		if (g) {
-			g=1.0f/g;
-			for (j=l;j<=n;j++) {
-				for (s=0.0,k=l;k<=m;k++) s += a[k][i]*a[k][j];
-				f=(s/a[i][i])*g;
-				for (k=i;k<=m;k++) a[k][j] += f*a[k][i];
-			}
-			for (j=i;j<=m;j++) a[j][i] *= g;
-		} else for (j=i;j<=m;j++) a[j][i]=0.0;
-		++a[i][i];
-	}
-
-	for (k=n;k>=1;k--) {
-		for (its=1;its<=30;its++) {
-			flag=1;
-			for (l=k;l>=1;l--) {
-				nm=l-1;
-				if ((float)(fabs(rv1[l])+anorm) == anorm) {
-					flag=0;
-					break;
-				}
-				if ((float)(fabs(w[nm])+anorm) == anorm) break;
-			}
-			if (flag) {
-				c=0.0;
-				s=1.0;
-				for (i=l;i<=k;i++) {
-					f=s*rv1[i];
-					rv1[i]=c*rv1[i];
-					if ((float)(fabs(f)+anorm) == anorm) break;
-					g=w[i];
-					h=pythag(f,g);
-					w[i]=h;
-					h=1.0f/h;
-					c=g*h;
-					s = -f*h;
-					for (j=1;j<=m;j++) {
-						y=a[j][nm];
-						z=a[j][i];
-						a[j][nm]=y*c+z*s;
-						a[j][i]=z*c-y*s;
-					}
-				}
-			}
-			z=w[k];
-			if (l == k) {
-				if (z < 0.0) {
-					w[k] = -z;
-					for (j=1;j<=n;j++) v[j][k] = -v[j][k];
-				}
-				break;
-			}
-			if (its == 30) throw "no convergence in 30 svdcmp iterations";
-			x=w[l];
-			nm=k-1;
-			y=w[nm];
-			g=rv1[nm];
-			h=rv1[k];
-			f=((y-z)*(y+z)+(g-h)*(g+h))/(2.0f*h*y);
-			g=pythag(f,1.0);
-			f=((x-z)*(x+z)+h*((y/(f+SIGN(g,f)))-h))/x;
-
-
-// sprintf( debugString, "ITERATION %d = f = %f - g = %f - h = %f\r\n", its, f, g, h );
-// OutputDebugStringA( debugString );
-
-
-			c=s=1.0;
-			for (j=l;j<=nm;j++) {
-				i=j+1;
-				g=rv1[i];
-				y=w[i];
-				h=s*g;
-				g=c*g;
-				z=pythag(f,h);
-				rv1[j]=z;
-				c=f/z;
-				s=h/z;
-				f=x*c+g*s;
-				g = g*c-x*s;
-				h=y*s;
-				y *= c;
-				for (jj=1;jj<=n;jj++) {
-					x=v[jj][j];
-					z=v[jj][i];
-					v[jj][j]=x*c+z*s;
-					v[jj][i]=z*c-x*s;
-				}
-				z=pythag(f,h);
-				w[j]=z;
-				if (z) {
-					z=1.0f/z;
-					c=f*z;
-					s=h*z;
-				}
-				f=c*g+s*y;
-				x=c*y-s*g;
-				for (jj=1;jj<=m;jj++) {
-					y=a[jj][j];
-					z=a[jj][i];
-					a[jj][j]=y*c+z*s;
-					a[jj][i]=z*c-y*s;
-				}
-
-
-// sprintf( debugString, "j = %d -> z = %f - f = %f - x = %f\r\n", j-1, z, f, x );
-// OutputDebugStringA( debugString );
-			}
-			rv1[l]=0.0;
-			rv1[k]=f;
-			w[k]=x;
-		}
-	}
-
-	delete[] rv1;
-}
-
-// Computes (a2 + b2)^1/2 without destructive underflow or overflow.
-float pythag(float a, float b) {
-	float	absa = fabs(a);
-	float	absb = fabs(b);
-	if ( absa > absb )
-		return absa*sqrt( 1.0f + SQR(absb/absa) );
-	else
-		return absb == 0.0f ? 0.0f : absb*sqrt( 1.0f + SQR(absa/absb) );
-}
-
-#pragma endregion
-
 /* MATLAB CODE
 	%
 	% gsolve.m - Solve for imaging system response function
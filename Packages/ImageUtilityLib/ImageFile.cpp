@@ -341,20 +341,16 @@ void	ImageFile::ConvertFrom_NoSupport( const ImageFile& _source, PIXEL_FORMAT _t
 
 	const U8*	sourceBits = _source.GetBits();
 	U8*			targetBits = GetBits();
-	U32			sourcePixelSize = sourceAccessor.Size();
 	U32			sourcePitch = _source.Pitch();
-	U32			targetPixelSize = targetAccessor.Size();
 	U32			targetPitch = Pitch();
 
-	bfloat4	temp;
+	// Convert whole scanlines at once so formats like half floats can use batched conversions
+	bfloat4*	tempScanline = new bfloat4[W];
 	for ( U32 Y=0; Y < H; Y++ ) {
-		const U8*	scanlineSource = sourceBits + Y * sourcePitch;
-		U8*			scanlineTarget = targetBits + Y * targetPitch;
-		for ( U32 X=0; X < W; X++, scanlineSource += sourcePixelSize, scanlineTarget += targetPixelSize ) {
-			sourceAccessor.RGBA( scanlineSource, temp );
-			targetAccessor.Write( scanlineTarget, temp );
-		}
+		sourceAccessor.ReadScanline( sourceBits + Y * sourcePitch, tempScanline, W );
+		targetAccessor.WriteScanline( targetBits + Y * targetPitch, tempScanline, W );
 	}
+	delete[] tempScanline;
 }
 
 void	ImageFile::ToneMapFrom( const ImageFile& _source, toneMapper_t _toneMapper ) {
@@ -780,9 +776,7 @@ void	ImageFile::ReadScanline( U32 _Y, bfloat4* _color, U32 _startX, U32 _count )
 	bits += pitch * _Y + _startX * pixelSize;
 
 	_count = MIN( _count, W-_startX );
-	for ( U32 i=_count; i > 0; i--, bits += pixelSize, _color++ ) {
-		m_pixelAccessor->RGBA( bits, *_color );
-	}
+	m_pixelAccessor->ReadScanline( bits, _color, _count );
 }
 void	ImageFile::WriteScanline( U32 _Y, const bfloat4* _color, U32 _startX, U32 _count ) {
 	U32	W = Width();
@@ -793,9 +787,7 @@ void	ImageFile::WriteScanline( U32 _Y, const bfloat4* _color, U32 _startX, U32 _
 	bits += pitch * _Y + _startX * pixelSize;
 
 	_count = MIN( _count, W-_startX );
-	for ( U32 i=_count; i > 0; i--, bits += pixelSize, _color++ ) {
-		m_pixelAccessor->Write( bits, *_color );
-	}
+	m_pixelAccessor->WriteScanline( bits, _color, _count );
 }
 
 void	ImageFile::ReadPixels( pixelReaderWriter_t _reader, U32 _startX, U32 _startY, U32 _width, U32 _height ) const {
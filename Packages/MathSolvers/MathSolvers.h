@@ -3,5 +3,8 @@
 #pragma once
 
 #include "Matrix.h"
+#include "MatrixKernels.h"
 #include "MinimizeBFGS.h"
+#include "MinimizeLBFGS.h"
+#include "MinimizeLevenbergMarquardt.h"
 #include "SVD.h"
@@ -1,5 +1,7 @@
 //////////////////////////////////////////////////////////////////////////
 // Defines generic, arbitrary-sized vectors and matrices
+// Matrices are stored contiguously, row after row, in a cache-line aligned buffer so the kernels in MatrixKernels.h
+//	can stream rows with SIMD instructions. Each row is also exposed as a Vector (not owning its pointer) for convenience.
 //
 #pragma once
 
@@ -31,6 +33,8 @@ namespace MathSolvers {
 
 	template< typename T >class Matrix {
 	public:
+		static const U32	ALIGNMENT = 64;		// Alignment of the raw storage
+
 		U32			rows, columns;
 		T*			m_raw;
 		Vector<T>*	m;
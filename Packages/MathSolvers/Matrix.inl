@@ -54,7 +54,7 @@ void	Matrix<T>::Init( U32 _rows, U32 _columns ) {
 
 	rows = _rows;
 	columns = _columns;
-	m_raw = new T[rows * columns];
+	m_raw = (T*) BaseLib::GetDefaultAllocator().Allocate( rows*columns*sizeof(T), ALIGNMENT );
 	m = new Vector<T>[rows];
 	for ( U32 rowIndex=0; rowIndex < rows; rowIndex++ ) {
 		m[rowIndex].Init( _columns, &m_raw[columns * rowIndex] );
@@ -62,7 +62,8 @@ void	Matrix<T>::Init( U32 _rows, U32 _columns ) {
 }
 template< typename T >
 void	Matrix<T>::Exit() {
-	SAFE_DELETE_ARRAY( m_raw );
+	BaseLib::GetDefaultAllocator().Free( m_raw, rows*columns*sizeof(T), ALIGNMENT );
+	m_raw = nullptr;
 	SAFE_DELETE_ARRAY( m );
 	rows = columns = 0;
 }
@@ -0,0 +1,349 @@
+#include "stdafx.h"
+#include "MatrixKernels.h"
+#include "..\..\BaseLib\Utility\Parallel.h"
+
+#include <emmintrin.h>
+
+using namespace MathSolvers;
+
+namespace {
+
+	// SSE wrappers so the same kernels can be instantiated for floats and doubles
+	struct	SSE_float {
+		typedef float	T;
+		typedef __m128	V;
+		enum { WIDTH = 4 };
+
+		static V	Zero()				{ return _mm_setzero_ps(); }
+		static V	Set( T x )			{ return _mm_set1_ps( x ); }
+		static V	Load( const T* p )	{ return _mm_loadu_ps( p ); }
+		static void	Store( T* p, V v )	{ _mm_storeu_ps( p, v ); }
+		static V	Add( V a, V b )		{ return _mm_add_ps( a, b ); }
+		static V	Sub( V a, V b )		{ return _mm_sub_ps( a, b ); }
+		static V	Mul( V a, V b )		{ return _mm_mul_ps( a, b ); }
+		static T	Sum( V v ) {
+			V	h = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+			return _mm_cvtss_f32( _mm_add_ss( h, _mm_shuffle_ps( h, h, 1 ) ) );
+		}
+	};
+	struct	SSE_double {
+		typedef double	T;
+		typedef __m128d	V;
+		enum { WIDTH = 2 };
+
+		static V	Zero()				{ return _mm_setzero_pd(); }
+		static V	Set( T x )			{ return _mm_set1_pd( x ); }
+		static V	Load( const T* p )	{ return _mm_loadu_pd( p ); }
+		static void	Store( T* p, V v )	{ _mm_storeu_pd( p, v ); }
+		static V	Add( V a, V b )		{ return _mm_add_pd( a, b ); }
+		static V	Sub( V a, V b )		{ return _mm_sub_pd( a, b ); }
+		static V	Mul( V a, V b )		{ return _mm_mul_pd( a, b ); }
+		static T	Sum( V v )			{ return _mm_cvtsd_f64( _mm_add_sd( v, _mm_unpackhi_pd( v, v ) ) ); }
+	};
+
+	// Products below this amount of multiply-adds are computed on the calling thread only
+	const U32	PARALLEL_WORK_THRESHOLD = 1 << 20;
+
+	// Blocking sizes, in bytes so float and double kernels touch the same amount of memory
+	const U32	ROWS_PER_JOB = 16;			// Rows of the output matrix computed by each parallel job
+	const U32	BLOCK_DEPTH = 64;			// Rows of B (for A.B) or elements of the rows (for A.B^T) processed at once
+	const U32	BLOCK_BYTES = 1024;			// Width of the panel of B processed at once (A.B), or of the output vector (A^T.x)
+
+	//////////////////////////////////////////////////////////////////////////
+	// Vector kernels
+	template< typename S > typename S::T	DotKernel( const typename S::T* a, const typename S::T* b, U32 count ) {
+		typename S::V	sum0 = S::Zero(), sum1 = S::Zero(), sum2 = S::Zero(), sum3 = S::Zero();
+		U32	i = 0;
+		for ( ; i + 4*S::WIDTH <= count; i += 4*S::WIDTH ) {
+			sum0 = S::Add( sum0, S::Mul( S::Load( a+i ), S::Load( b+i ) ) );
+			sum1 = S::Add( sum1, S::Mul( S::Load( a+i+S::WIDTH ), S::Load( b+i+S::WIDTH ) ) );
+			sum2 = S::Add( sum2, S::Mul( S::Load( a+i+2*S::WIDTH ), S::Load( b+i+2*S::WIDTH ) ) );
+			sum3 = S::Add( sum3, S::Mul( S::Load( a+i+3*S::WIDTH ), S::Load( b+i+3*S::WIDTH ) ) );
+		}
+		for ( ; i + S::WIDTH <= count; i += S::WIDTH )
+			sum0 = S::Add( sum0, S::Mul( S::Load( a+i ), S::Load( b+i ) ) );
+
+		typename S::T	result = S::Sum( S::Add( S::Add( sum0, sum1 ), S::Add( sum2, sum3 ) ) );
+		for ( ; i < count; i++ )
+			result += a[i] * b[i];
+		return result;
+	}
+
+	// Computes the dot products of a with 4 vectors at once so a is only loaded once
+	template< typename S > void	Dot4Kernel( const typename S::T* a, const typename S::T* const* b, U32 count, typename S::T* result ) {
+		typename S::V	sum0 = S::Zero(), sum1 = S::Zero(), sum2 = S::Zero(), sum3 = S::Zero();
+		U32	i = 0;
+		for ( ; i + S::WIDTH <= count; i += S::WIDTH ) {
+			typename S::V	va = S::Load( a+i );
+			sum0 = S::Add( sum0, S::Mul( va, S::Load( b[0]+i ) ) );
+			sum1 = S::Add( sum1, S::Mul( va, S::Load( b[1]+i ) ) );
+			sum2 = S::Add( sum2, S::Mul( va, S::Load( b[2]+i ) ) );
+			sum3 = S::Add( sum3, S::Mul( va, S::Load( b[3]+i ) ) );
+		}
+		result[0] = S::Sum( sum0 );
+		result[1] = S::Sum( sum1 );
+		result[2] = S::Sum( sum2 );
+		result[3] = S::Sum( sum3 );
+		for ( ; i < count; i++ ) {
+			result[0] += a[i] * b[0][i];
+			result[1] += a[i] * b[1][i];
+			result[2] += a[i] * b[2][i];
+			result[3] += a[i] * b[3][i];
+		}
+	}
+
+	template< typename S > void	MultiplyAddKernel( typename S::T* y, const typename S::T* x, typename S::T alpha, U32 count ) {
+		typename S::V	valpha = S::Set( alpha );
+		U32	i = 0;
+		for ( ; i + 2*S::WIDTH <= count; i += 2*S::WIDTH ) {
+			S::Store( y+i, S::Add( S::Load( y+i ), S::Mul( valpha, S::Load( x+i ) ) ) );
+			S::Store( y+i+S::WIDTH, S::Add( S::Load( y+i+S::WIDTH ), S::Mul( valpha, S::Load( x+i+S::WIDTH ) ) ) );
+		}
+		for ( ; i < count; i++ )
+			y[i] += alpha * x[i];
+	}
+
+	// Computes y += alpha[0].x[0] + ... + alpha[3].x[3] so y is only loaded and stored once
+	template< typename S > void	MultiplyAdd4Kernel( typename S::T* y, const typename S::T* const* x, const typename S::T* alpha, U32 count ) {
+		typename S::V	valpha0 = S::Set( alpha[0] ), valpha1 = S::Set( alpha[1] ), valpha2 = S::Set( alpha[2] ), valpha3 = S::Set( alpha[3] );
+		U32	i = 0;
+		for ( ; i + S::WIDTH <= count; i += S::WIDTH ) {
+			typename S::V	sum01 = S::Add( S::Mul( valpha0, S::Load( x[0]+i ) ), S::Mul( valpha1, S::Load( x[1]+i ) ) );
+			typename S::V	sum23 = S::Add( S::Mul( valpha2, S::Load( x[2]+i ) ), S::Mul( valpha3, S::Load( x[3]+i ) ) );
+			S::Store( y+i, S::Add( S::Load( y+i ), S::Add( sum01, sum23 ) ) );
+		}
+		for ( ; i < count; i++ )
+			y[i] += alpha[0] * x[0][i] + alpha[1] * x[1][i] + alpha[2] * x[2][i] + alpha[3] * x[3][i];
+	}
+
+	template< typename S > void	RotateKernel( typename S::T* a, typename S::T* b, typename S::T c, typename S::T s, U32 count ) {
+		typename S::V	vc = S::Set( c );
+		typename S::V	vs = S::Set( s );
+		U32	i = 0;
+		for ( ; i + S::WIDTH <= count; i += S::WIDTH ) {
+			typename S::V	va = S::Load( a+i );
+			typename S::V	vb = S::Load( b+i );
+			S::Store( a+i, S::Sub( S::Mul( vc, va ), S::Mul( vs, vb ) ) );
+			S::Store( b+i, S::Add( S::Mul( vs, va ), S::Mul( vc, vb ) ) );
+		}
+		for ( ; i < count; i++ ) {
+			typename S::T	va = a[i];
+			typename S::T	vb = b[i];
+			a[i] = c * va - s * vb;
+			b[i] = s * va + c * vb;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Matrix kernels
+	template< typename T > void	TransposeKernel( const Matrix<T>& _A, Matrix<T>& _B ) {
+		ASSERT( &_A != &_B, "Can't transpose in place!" );
+		_B.Init( _A.columns, _A.rows );
+
+		// Transpose by tiles so both the source and target rows stay in cache
+		const U32	TILE_SIZE = 32;
+		for ( U32 row0=0; row0 < _A.rows; row0+=TILE_SIZE ) {
+			U32	row1 = MIN( row0+TILE_SIZE, _A.rows );
+			for ( U32 column0=0; column0 < _A.columns; column0+=TILE_SIZE ) {
+				U32	column1 = MIN( column0+TILE_SIZE, _A.columns );
+				for ( U32 row=row0; row < row1; row++ ) {
+					const T*	source = _A.m_raw + _A.columns * row;
+					for ( U32 column=column0; column < column1; column++ )
+						_B.m_raw[_B.columns * column + row] = source[column];
+				}
+			}
+		}
+	}
+
+	// Computes a block of rows of y = A.x
+	template< typename S > struct	GEMVJob {
+		typedef typename S::T	T;
+		const Matrix<T>*	A;
+		const T*			x;
+		T*					y;
+
+		void	operator()( U32 _jobIndex ) {
+			U32	row1 = MIN( (_jobIndex+1) * ROWS_PER_JOB, A->rows );
+			for ( U32 row=_jobIndex * ROWS_PER_JOB; row < row1; row++ )
+				y[row] = DotKernel<S>( A->m_raw + A->columns * row, x, A->columns );
+		}
+	};
+
+	// Computes a block of elements of y = A^T.x
+	template< typename S > struct	GEMVTransposedJob {
+		typedef typename S::T	T;
+		const Matrix<T>*	A;
+		const T*			x;
+		T*					y;
+
+		void	operator()( U32 _jobIndex ) {
+			const U32	BLOCK_SIZE = BLOCK_BYTES / sizeof(T);
+			U32	column0 = _jobIndex * BLOCK_SIZE;
+			U32	count = MIN( column0 + BLOCK_SIZE, A->columns ) - column0;
+
+			T*	target = y + column0;
+			memset( target, 0, count * sizeof(T) );
+
+			U32	row = 0;
+			for ( ; row + 4 <= A->rows; row += 4 ) {
+				const T*	sources[4] = {
+					A->m_raw + A->columns * (row+0) + column0,
+					A->m_raw + A->columns * (row+1) + column0,
+					A->m_raw + A->columns * (row+2) + column0,
+					A->m_raw + A->columns * (row+3) + column0,
+				};
+				MultiplyAdd4Kernel<S>( target, sources, x + row, count );
+			}
+			for ( ; row < A->rows; row++ )
+				MultiplyAddKernel<S>( target, A->m_raw + A->columns * row + column0, x[row], count );
+		}
+	};
+
+	// Computes a block of rows of C = A.B
+	// B is processed by panels of BLOCK_DEPTH rows and BLOCK_BYTES columns that stay in cache while they're accumulated into the rows of C
+	template< typename S > struct	GEMMJob {
+		typedef typename S::T	T;
+		const Matrix<T>*	A;
+		const Matrix<T>*	B;
+		Matrix<T>*			C;
+
+		void	operator()( U32 _jobIndex ) {
+			const U32	BLOCK_SIZE = BLOCK_BYTES / sizeof(T);
+			U32	row0 = _jobIndex * ROWS_PER_JOB;
+			U32	row1 = MIN( row0 + ROWS_PER_JOB, C->rows );
+			U32	K = A->columns;
+			U32	N = C->columns;
+
+			memset( C->m_raw + N * row0, 0, N * (row1 - row0) * sizeof(T) );
+
+			for ( U32 depth0=0; depth0 < K; depth0+=BLOCK_DEPTH ) {
+				U32	depth1 = MIN( depth0 + BLOCK_DEPTH, K );
+				for ( U32 column0=0; column0 < N; column0+=BLOCK_SIZE ) {
+					U32	count = MIN( column0 + BLOCK_SIZE, N ) - column0;
+					for ( U32 row=row0; row < row1; row++ ) {
+						const T*	a = A->m_raw + K * row;
+						T*			c = C->m_raw + N * row + column0;
+						U32			depth = depth0;
+						for ( ; depth + 4 <= depth1; depth += 4 ) {
+							const T*	sources[4] = {
+								B->m_raw + N * (depth+0) + column0,
+								B->m_raw + N * (depth+1) + column0,
+								B->m_raw + N * (depth+2) + column0,
+								B->m_raw + N * (depth+3) + column0,
+							};
+							MultiplyAdd4Kernel<S>( c, sources, a + depth, count );
+						}
+						for ( ; depth < depth1; depth++ )
+							MultiplyAddKernel<S>( c, B->m_raw + N * depth + column0, a[depth], count );
+					}
+				}
+			}
+		}
+	};
+
+	// Computes a block of rows of C = A.B^T
+	// Rows of A are dotted with 4 rows of B at a time, and if B is A only the upper triangle is computed
+	template< typename S > struct	GEMMTransposedJob {
+		typedef typename S::T	T;
+		const Matrix<T>*	A;
+		const Matrix<T>*	B;
+		Matrix<T>*			C;
+		bool				symmetric;
+
+		void	operator()( U32 _jobIndex ) {
+			U32	row0 = _jobIndex * ROWS_PER_JOB;
+			U32	row1 = MIN( row0 + ROWS_PER_JOB, C->rows );
+			U32	K = A->columns;
+			U32	N = C->columns;
+
+			for ( U32 row=row0; row < row1; row++ ) {
+				const T*	a = A->m_raw + K * row;
+				T*			c = C->m_raw + N * row;
+				U32			column = symmetric ? row : 0;
+				for ( ; column + 4 <= N; column += 4 ) {
+					const T*	b[4] = {
+						B->m_raw + K * (column+0),
+						B->m_raw + K * (column+1),
+						B->m_raw + K * (column+2),
+						B->m_raw + K * (column+3),
+					};
+					Dot4Kernel<S>( a, b, K, c + column );
+				}
+				for ( ; column < N; column++ )
+					c[column] = DotKernel<S>( a, B->m_raw + K * column, K );
+			}
+		}
+	};
+
+	template< typename F > void	Run( U32 _jobsCount, F& _job, double _work ) {
+		if ( _jobsCount > 1 && _work >= PARALLEL_WORK_THRESHOLD ) {
+			BaseLib::ParallelFor( _jobsCount, _job );
+		} else {
+			for ( U32 jobIndex=0; jobIndex < _jobsCount; jobIndex++ )
+				_job( jobIndex );
+		}
+	}
+
+	template< typename S > void	GEMV( const Matrix<typename S::T>& _A, const Vector<typename S::T>& _x, Vector<typename S::T>& _y ) {
+		ASSERT( _x.length == _A.columns, "Vector x length and matrix A's columns count mismatch!" );
+		ASSERT( _x.m != _y.m, "Vector y can't be vector x!" );
+		_y.Init( _A.rows );
+
+		GEMVJob<S>	job = { &_A, _x.m, _y.m };
+		Run( (_A.rows + ROWS_PER_JOB-1) / ROWS_PER_JOB, job, double(_A.rows) * _A.columns );
+	}
+
+	template< typename S > void	GEMVTransposed( const Matrix<typename S::T>& _A, const Vector<typename S::T>& _x, Vector<typename S::T>& _y ) {
+		ASSERT( _x.length == _A.rows, "Vector x length and matrix A's rows count mismatch!" );
+		ASSERT( _x.m != _y.m, "Vector y can't be vector x!" );
+		_y.Init( _A.columns );
+
+		const U32	BLOCK_SIZE = BLOCK_BYTES / sizeof(typename S::T);
+		GEMVTransposedJob<S>	job = { &_A, _x.m, _y.m };
+		Run( (_A.columns + BLOCK_SIZE-1) / BLOCK_SIZE, job, double(_A.rows) * _A.columns );
+	}
+
+	template< typename S > void	GEMM( const Matrix<typename S::T>& _A, const Matrix<typename S::T>& _B, Matrix<typename S::T>& _C ) {
+		ASSERT( _A.columns == _B.rows, "Matrix A's columns count and matrix B's rows count mismatch!" );
+		ASSERT( &_C != &_A && &_C != &_B, "Matrix C can't be an operand!" );
+		_C.Init( _A.rows, _B.columns );
+
+		GEMMJob<S>	job = { &_A, &_B, &_C };
+		Run( (_C.rows + ROWS_PER_JOB-1) / ROWS_PER_JOB, job, double(_A.rows) * _A.columns * _B.columns );
+	}
+
+	template< typename S > void	GEMMTransposed( const Matrix<typename S::T>& _A, const Matrix<typename S::T>& _B, Matrix<typename S::T>& _C ) {
+		ASSERT( _A.columns == _B.columns, "Matrix A's and matrix B's columns count mismatch!" );
+		ASSERT( &_C != &_A && &_C != &_B, "Matrix C can't be an operand!" );
+		_C.Init( _A.rows, _B.rows );
+
+		bool	symmetric = &_A == &_B;
+		GEMMTransposedJob<S>	job = { &_A, &_B, &_C, symmetric };
+		Run( (_C.rows + ROWS_PER_JOB-1) / ROWS_PER_JOB, job, double(_A.rows) * _A.columns * _B.rows );
+
+		// Mirror the upper triangle
+		if ( symmetric ) {
+			for ( U32 row=1; row < _C.rows; row++ )
+				for ( U32 column=0; column < row; column++ )
+					_C.m_raw[_C.columns * row + column] = _C.m_raw[_C.columns * column + row];
+		}
+	}
+}
+
+float	MathSolvers::Dot( const float* _a, const float* _b, U32 _count )						{ return DotKernel<SSE_float>( _a, _b, _count ); }
+double	MathSolvers::Dot( const double* _a, const double* _b, U32 _count )						{ return DotKernel<SSE_double>( _a, _b, _count ); }
+void	MathSolvers::MultiplyAdd( float* _y, const float* _x, float _alpha, U32 _count )		{ MultiplyAddKernel<SSE_float>( _y, _x, _alpha, _count ); }
+void	MathSolvers::MultiplyAdd( double* _y, const double* _x, double _alpha, U32 _count )		{ MultiplyAddKernel<SSE_double>( _y, _x, _alpha, _count ); }
+void	MathSolvers::Rotate( float* _a, float* _b, float _c, float _s, U32 _count )				{ RotateKernel<SSE_float>( _a, _b, _c, _s, _count ); }
+void	MathSolvers::Rotate( double* _a, double* _b, double _c, double _s, U32 _count )			{ RotateKernel<SSE_double>( _a, _b, _c, _s, _count ); }
+
+void	MathSolvers::Transpose( const MatrixF& _A, MatrixF& _B )								{ TransposeKernel( _A, _B ); }
+void	MathSolvers::Transpose( const MatrixD& _A, MatrixD& _B )								{ TransposeKernel( _A, _B ); }
+void	MathSolvers::Multiply( const MatrixF& _A, const VectorF& _x, VectorF& _y )				{ GEMV<SSE_float>( _A, _x, _y ); }
+void	MathSolvers::Multiply( const MatrixD& _A, const VectorD& _x, VectorD& _y )				{ GEMV<SSE_double>( _A, _x, _y ); }
+void	MathSolvers::MultiplyTransposed( const MatrixF& _A, const VectorF& _x, VectorF& _y )	{ GEMVTransposed<SSE_float>( _A, _x, _y ); }
+void	MathSolvers::MultiplyTransposed( const MatrixD& _A, const VectorD& _x, VectorD& _y )	{ GEMVTransposed<SSE_double>( _A, _x, _y ); }
+void	MathSolvers::Multiply( const MatrixF& _A, const MatrixF& _B, MatrixF& _C )				{ GEMM<SSE_float>( _A, _B, _C ); }
+void	MathSolvers::Multiply( const MatrixD& _A, const MatrixD& _B, MatrixD& _C )				{ GEMM<SSE_double>( _A, _B, _C ); }
+void	MathSolvers::MultiplyTransposed( const MatrixF& _A, const MatrixF& _B, MatrixF& _C )	{ GEMMTransposed<SSE_float>( _A, _B, _C ); }
+void	MathSolvers::MultiplyTransposed( const MatrixD& _A, const MatrixD& _B, MatrixD& _C )	{ GEMMTransposed<SSE_double>( _A, _B, _C ); }
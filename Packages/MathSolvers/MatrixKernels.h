@@ -0,0 +1,46 @@
+//////////////////////////////////////////////////////////////////////////
+// Dense linear algebra kernels on vectors and matrices
+// The kernels work on the contiguous storage of the matrices with SSE instructions (4 floats or 2 doubles at a time),
+//	large products are blocked so the panels of the right-hand matrix stay in cache and are split across threads.
+//
+// Output matrices and vectors are resized as needed and must not alias the inputs.
+//
+#pragma once
+
+#include "Matrix.h"
+
+namespace MathSolvers {
+
+	// Returns a.b
+	float	Dot( const float* _a, const float* _b, U32 _count );
+	double	Dot( const double* _a, const double* _b, U32 _count );
+
+	// Computes y += alpha.x
+	void	MultiplyAdd( float* _y, const float* _x, float _alpha, U32 _count );
+	void	MultiplyAdd( double* _y, const double* _x, double _alpha, U32 _count );
+
+	// Applies a plane rotation to a pair of vectors: a' = c.a - s.b and b' = s.a + c.b
+	void	Rotate( float* _a, float* _b, float _c, float _s, U32 _count );
+	void	Rotate( double* _a, double* _b, double _c, double _s, U32 _count );
+
+	// Computes B = A^T
+	void	Transpose( const MatrixF& _A, MatrixF& _B );
+	void	Transpose( const MatrixD& _A, MatrixD& _B );
+
+	// Computes y = A.x
+	void	Multiply( const MatrixF& _A, const VectorF& _x, VectorF& _y );
+	void	Multiply( const MatrixD& _A, const VectorD& _x, VectorD& _y );
+
+	// Computes y = A^T.x
+	void	MultiplyTransposed( const MatrixF& _A, const VectorF& _x, VectorF& _y );
+	void	MultiplyTransposed( const MatrixD& _A, const VectorD& _x, VectorD& _y );
+
+	// Computes C = A.B
+	void	Multiply( const MatrixF& _A, const MatrixF& _B, MatrixF& _C );
+	void	Multiply( const MatrixD& _A, const MatrixD& _B, MatrixD& _C );
+
+	// Computes C = A.B^T (i.e. the dot products of all the rows of A with all the rows of B, A.A^T gives the normal equations of a transposed Jacobian)
+	void	MultiplyTransposed( const MatrixF& _A, const MatrixF& _B, MatrixF& _C );
+	void	MultiplyTransposed( const MatrixD& _A, const MatrixD& _B, MatrixD& _C );
+
+}	// namespace MathSolvers
@@ -1,8 +1,30 @@
 #include "stdafx.h"
 #include "MinimizeBFGS.h"
+#include "..\..\BaseLib\Utility\Parallel.h"
 
 using namespace MathSolvers;
 
+namespace {
+	// Evaluates the perturbed parameters of the finite differences, one per index
+	struct	FiniteDifferencesJob {
+		BFGS::IModel*	model;
+		MatrixD*		parameters;
+		VectorD*		values;
+		U32				firstIndex;		// Offset added to the job indices
+
+		void	operator()( U32 _index ) {
+			_index += firstIndex;
+			VectorD&	params = (*parameters)[_index];
+			model->Constrain( params );		// Pom: constrain!
+			(*values)[_index] = model->Eval( params );
+		}
+	};
+
+	// Below this estimated total cost (in seconds) for the 2N evaluations, the gradient is computed on the calling thread
+	// (spawning the threads costs a few tens of microseconds each, which dwarfs cheap models with few parameters)
+	const double	PARALLEL_GRADIENT_MIN_TIME = 1e-3;
+}
+
 BFGS::BFGS()
 	: m_coefficientsCount( 0 )
 	, m_model( nullptr )
@@ -171,23 +193,68 @@ void	BFGS::Minimize( IModel& _model ) {
 }
 
 // ===========================================
-// Compute the gradient using finite differences
+// Compute the gradient analytically if the model supports it, or using finite differences
 void	BFGS::EvalGradient( VectorD& _params, VectorD& _gradient ) {
+	m_evalCallsCount += ComputeGradient( *m_model, _params, _gradient, m_gradientParameters, m_gradientValues );
+	m_evalGradientCallsCount++;
+}
+
+int		BFGS::ComputeGradient( IModel& _model, VectorD& _params, VectorD& _gradient, MatrixD& _tempParameters, VectorD& _tempValues ) {
+	if ( _model.EvalGradient( _params, _gradient ) )
+		return 0;
+
+	int		coefficientsCount = _params.length;
 	double	EPS = 1e-6;
-	for ( int i=0; i < m_coefficientsCount; i++ ) {
+
+	if ( _model.IsThreadSafe() ) {
+		// Evaluate all the perturbed parameters, in parallel if they're expensive enough
+		_tempParameters.Init( 2*coefficientsCount, coefficientsCount );
+		_tempValues.Init( 2*coefficientsCount );
+		for ( int i=0; i < coefficientsCount; i++ ) {
+			_params.CopyTo( _tempParameters[2*i+0] );
+			_params.CopyTo( _tempParameters[2*i+1] );
+			_tempParameters[2*i+0][i] -= EPS;
+			_tempParameters[2*i+1][i] += EPS;
+		}
+
+		// Time the first evaluation to estimate the total cost and only go parallel if it's worth the threads
+		FiniteDifferencesJob	job = { &_model, &_tempParameters, &_tempValues, 0 };
+		LARGE_INTEGER	frequency, startTime, endTime;
+		QueryPerformanceFrequency( &frequency );
+		QueryPerformanceCounter( &startTime );
+		job( 0 );
+		QueryPerformanceCounter( &endTime );
+		double	estimatedTime = 2*coefficientsCount * double(endTime.QuadPart - startTime.QuadPart) / frequency.QuadPart;
+
+		if ( estimatedTime < PARALLEL_GRADIENT_MIN_TIME ) {
+			for ( int i=1; i < 2*coefficientsCount; i++ )
+				job( i );
+		} else {
+			job.firstIndex = 1;
+			BaseLib::ParallelFor( U32(2*coefficientsCount-1), job );
+		}
+
+		for ( int i=0; i < coefficientsCount; i++ ) {
+			double	delta = _tempParameters[2*i+1][i] - _tempParameters[2*i+0][i];
+			_gradient[i] = delta > 0.0 ? (_tempValues[2*i+1] - _tempValues[2*i+0]) / delta : 0.0;
+		}
+		return 2*coefficientsCount;
+	}
+
+	for ( int i=0; i < coefficientsCount; i++ ) {
 		double	oldCoeff = _params[i];
 
 		_params[i] -= EPS;
-		m_model->Constrain( _params );		// Pom: constrain!
+		_model.Constrain( _params );		// Pom: constrain!
 		double	parmMin = _params[i];
 
-		double	offsetValueNeg = m_model->Eval( _params );
+		double	offsetValueNeg = _model.Eval( _params );
 
 		_params[i] = oldCoeff + EPS;
-		m_model->Constrain( _params );		// Pom: constrain!
+		_model.Constrain( _params );		// Pom: constrain!
 		double	parmMax = _params[i];
 
-		double	offsetValuePos = m_model->Eval( _params );
+		double	offsetValuePos = _model.Eval( _params );
 
 		_params[i] = oldCoeff;
 
@@ -197,8 +264,7 @@ void	BFGS::EvalGradient( VectorD& _params, VectorD& _gradient ) {
 		_gradient[i] = derivative;
 	}
 
-	m_evalCallsCount += 2*m_coefficientsCount;
-	m_evalGradientCallsCount++;
+	return 2*coefficientsCount;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -243,6 +309,7 @@ double	BFGS::LinearSearch( double _functionMinimum, VectorD& _gradient, VectorD&
 		m_model->Constrain( _xout );
 
 		double	fx_alpha = m_model->Eval( _xout );
+		m_evalCallsCount++;
 		if ( _isnan( fx_alpha ) )
 			throw "Linear search eval returned NaN!";
 
@@ -24,6 +24,14 @@ namespace MathSolvers {
 			// Applies constraints to the array of parameters
 			// <param name="_Parameters"></param>
 			virtual void		Constrain( VectorD& _parameters ) abstract;
+
+			// Optionally computes the analytic gradient of Eval() with respect to each parameter
+			// <returns>False if the model has no analytic gradient, the gradient is then estimated with central finite differences</returns>
+			virtual bool		EvalGradient( const VectorD& _parameters, VectorD& _gradient )	{ return false; }
+
+			// Tells if Eval() and Constrain() can be called concurrently on different parameters (i.e. they don't modify the model)
+			// The 2N evaluations of the finite differences gradient are then performed in parallel
+			virtual bool		IsThreadSafe() const	{ return false; }
 		};
 
 	private:	// FIELDS
@@ -43,6 +51,9 @@ namespace MathSolvers {
 		int					m_evalCallsCount;			// (STATS) Amount of model evaluations called to reach minimum
 		int					m_evalGradientCallsCount;	// (STATS) Amount of gradient evaluations called to reach minimum
 
+		MatrixD				m_gradientParameters;		// The 2N perturbed copies of the parameters used by the finite differences
+		VectorD				m_gradientValues;			// The 2N model evaluations of the finite differences
+
 
 	public:	// PROPERTIES
 		// Gets or sets the maximum amount of iterations performed by the algorithm
@@ -63,6 +74,12 @@ namespace MathSolvers {
 		// Gets the minimum reached by the minimization
 		double	getFunctionMinimum() const			{ return m_functionMinimum; }
 
+		// Gets the amount of model evaluations performed by the algorithm, including the ones of the finite differences gradients
+		int		getEvalCallsCount() const			{ return m_evalCallsCount; }
+
+		// Gets the amount of gradients evaluated by the algorithm, either analytic or with finite differences
+		int		getEvalGradientCallsCount() const	{ return m_evalGradientCallsCount; }
+
 	public:	// METHODS
 
 		BFGS();
@@ -72,10 +89,16 @@ namespace MathSolvers {
 		// <param name="_model"></param>
 		void	Minimize( IModel& _model );
 
+		// Computes the gradient of a model analytically if it supports it, or using central finite differences (in parallel if the model is thread-safe and its evaluations are expensive enough to be worth the threads)
+		// <param name="_tempParameters">Temporary storage for the 2N perturbed parameters of the parallel finite differences</param>
+		// <param name="_tempValues">Temporary storage for the 2N model evaluations of the parallel finite differences</param>
+		// <returns>The amount of model evaluations performed</returns>
+		static int	ComputeGradient( IModel& _model, VectorD& _params, VectorD& _gradient, MatrixD& _tempParameters, VectorD& _tempValues );
+
 	private:
 
 		// ===========================================
-		// Compute the gradient using finite differences
+		// Compute the gradient analytically if the model supports it, or using finite differences
 		void	EvalGradient( VectorD& _params, VectorD& _gradient );
 
 		//////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,184 @@
+#include "stdafx.h"
+#include "MinimizeLBFGS.h"
+
+using namespace MathSolvers;
+
+namespace {
+	double	Dot( const VectorD& a, const VectorD& b ) {
+		double	result = 0.0;
+		for ( U32 i=0; i < a.length; i++ )
+			result += a[i] * b[i];
+		return result;
+	}
+}
+
+LBFGS::LBFGS()
+	: m_coefficientsCount( 0 )
+	, m_model( nullptr )
+	, m_historySize( 8 )
+	, m_maxIterations( 200 )
+	, m_tolX( 1.0e-8 )
+	, m_tolGradient( 1.0e-8 )
+	, m_functionMinimum( DBL_MAX )
+	, m_iterationsCount( 0 )
+	, m_evalCallsCount( 0 )
+	, m_evalGradientCallsCount( 0 ) {
+}
+LBFGS::~LBFGS() {
+}
+
+void	LBFGS::Minimize( BFGS::IModel& _model ) {
+	m_model = &_model;
+	m_coefficientsCount = m_model->getParameters().length;
+	int		historySize = MAX( 1, m_historySize );
+
+	VectorD	x( m_coefficientsCount );
+	VectorD	newX( m_coefficientsCount );
+	VectorD	gradient( m_coefficientsCount );
+	VectorD	newGradient( m_coefficientsCount );
+	VectorD	direction( m_coefficientsCount );
+	VectorD	stepS( m_coefficientsCount );	// Candidate history pair, only copied into the history once accepted
+	VectorD	stepY( m_coefficientsCount );
+
+	// Circular history of s_k = x_k+1 - x_k and y_k = Gradient_k+1 - Gradient_k
+	MatrixD	s( historySize, m_coefficientsCount );
+	MatrixD	y( historySize, m_coefficientsCount );
+	VectorD	rho( historySize );		// 1 / (y_k.s_k)
+	VectorD	alpha( historySize );
+	int		historyCount = 0;
+	int		newestIndex = -1;
+	int		smallShiftsCount = 0;
+
+	// Start from model's initial parameters
+	m_model->getParameters().CopyTo( x );
+
+	m_evalCallsCount = m_evalGradientCallsCount = 0;
+
+	// Perform initial evaluation
+	m_functionMinimum = m_model->Eval( x );
+	m_evalCallsCount++;
+	EvalGradient( x, gradient );
+
+	m_iterationsCount = 0;
+	while ( ++m_iterationsCount < m_maxIterations ) {
+		// Compute direction = -|H|.Gradient with the two-loop recursion
+		gradient.CopyTo( direction );
+		for ( int k=0; k < historyCount; k++ ) {
+			int	i = (newestIndex - k + historySize) % historySize;
+			alpha[i] = rho[i] * Dot( s[i], direction );
+			for ( int d=0; d < m_coefficientsCount; d++ )
+				direction[d] -= alpha[i] * y[i][d];
+		}
+
+		// Scale by an estimate of the Hessian's eigen value along the last step (first step gets a unit length instead)
+		double	scale = historyCount > 0 ? 1.0 / (rho[newestIndex] * Dot( y[newestIndex], y[newestIndex] )) : 1.0 / MAX( 1e-300, sqrt( Dot( gradient, gradient ) ) );
+		for ( int d=0; d < m_coefficientsCount; d++ )
+			direction[d] *= scale;
+
+		for ( int k=historyCount-1; k >= 0; k-- ) {
+			int		i = (newestIndex - k + historySize) % historySize;
+			double	beta = rho[i] * Dot( y[i], direction );
+			for ( int d=0; d < m_coefficientsCount; d++ )
+				direction[d] += (alpha[i] - beta) * s[i][d];
+		}
+		for ( int d=0; d < m_coefficientsCount; d++ )
+			direction[d] = -direction[d];
+
+		// Restart from the steepest descent if the history gives a bad direction
+		if ( Dot( gradient, direction ) >= 0.0 ) {
+			historyCount = 0;
+			double	gradientNorm = sqrt( Dot( gradient, gradient ) );
+			if ( gradientNorm == 0.0 )
+				break;
+			for ( int d=0; d < m_coefficientsCount; d++ )
+				direction[d] = -gradient[d] / gradientNorm;
+		}
+
+		double	newMinimum = LinearSearch( m_functionMinimum, gradient, x, direction, newX );
+		bool	stalled = newMinimum >= m_functionMinimum;
+		m_functionMinimum = newMinimum;
+
+		// Notify of new optimal values
+		m_model->setParameters( newX );
+
+		// if the current point shift (relative to current position) stays below tolerance, we're done:
+		// (ill-conditioned models make a few tiny steps while the history adapts to a new curvature so a single one isn't enough)
+		double	delta = 0.0;
+		for ( int d=0; d < m_coefficientsCount; d++ )
+			delta = MAX( delta, abs( newX[d] - x[d] ) / MAX( abs( newX[d] ), 1.0 ) );
+		smallShiftsCount = delta < m_tolX ? smallShiftsCount+1 : 0;
+		if ( stalled || smallShiftsCount > 2 ) {
+			newX.Swap( x );
+			break;
+		}
+
+		EvalGradient( newX, newGradient );
+
+		// if the current gradient (normalized by the current x and function minimum) is below tolerance, we're done:
+		delta = 0.0;
+		double	normalizer = MAX( m_functionMinimum, 1.0 );
+		for ( int d=0; d < m_coefficientsCount; d++ )
+			delta = MAX( delta, abs( newGradient[d] ) * MAX( abs( newX[d] ), 1.0 ) / normalizer );
+		if ( delta < m_tolGradient ) {
+			newX.Swap( x );
+			break;
+		}
+
+		// Push the new changes in the history, unless they're almost linearly dependent which would break the positive definiteness of the Hessian approximation
+		// (a rejected pair must not touch the history: when it's full, the next slot still holds the oldest valid pair)
+		for ( int d=0; d < m_coefficientsCount; d++ ) {
+			stepS[d] = newX[d] - x[d];
+			stepY[d] = newGradient[d] - gradient[d];
+		}
+		double	sy = Dot( stepS, stepY );
+		if ( sy > 1.0e-8 * sqrt( Dot( stepS, stepS ) * Dot( stepY, stepY ) ) ) {
+			int		nextIndex = (newestIndex + 1) % historySize;
+			stepS.CopyTo( s[nextIndex] );
+			stepY.CopyTo( y[nextIndex] );
+			rho[nextIndex] = 1.0 / sy;
+			newestIndex = nextIndex;
+			historyCount = MIN( historyCount+1, historySize );
+		}
+
+		newX.Swap( x );
+		newGradient.Swap( gradient );
+	}
+
+	// Copy final parameters
+	m_model->setParameters( x );
+}
+
+void	LBFGS::EvalGradient( VectorD& _params, VectorD& _gradient ) {
+	m_evalCallsCount += BFGS::ComputeGradient( *m_model, _params, _gradient, m_gradientParameters, m_gradientValues );
+	m_evalGradientCallsCount++;
+}
+
+double	LBFGS::LinearSearch( double _functionValue, const VectorD& _gradient, const VectorD& x, const VectorD& _direction, VectorD& _xout ) {
+	const double	ZERO = 1.0E-10;
+	const double	SIGMA = 1.0E-4;
+
+	double	p = Dot( _gradient, _direction );	// Directional derivative, negative for a descent direction
+	double	alpha = 1.0;						// The direction is already scaled so a unit step is usually accepted
+	while ( alpha >= ZERO ) {
+		for ( int d=0; d < m_coefficientsCount; d++ )
+			_xout[d] = x[d] + alpha * _direction[d];
+
+		// Pom: constrain!
+		m_model->Constrain( _xout );
+
+		double	fx_alpha = m_model->Eval( _xout );
+		m_evalCallsCount++;
+		if ( _isnan( fx_alpha ) )
+			throw "Linear search eval returned NaN!";
+
+		if ( fx_alpha <= _functionValue + SIGMA * alpha * p )
+			return fx_alpha;
+
+		// Step to the minimum of the quadratic interpolation along the direction, without shrinking too much at once
+		double	quadraticAlpha = -0.5 * p * alpha * alpha / (fx_alpha - _functionValue - p * alpha);
+		alpha = CLAMP( quadraticAlpha, 0.1 * alpha, 0.5 * alpha );
+	}
+
+	x.CopyTo( _xout );
+	return _functionValue;
+}
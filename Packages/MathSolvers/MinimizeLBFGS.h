@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////
+// Helper fitting class implementing limited-memory BFGS optimization (http://en.wikipedia.org/wiki/Limited-memory_BFGS)
+// Instead of the dense NxN inverse Hessian of BFGS, only the last few changes of parameters and gradients are kept and the search
+//	direction is computed from them with the "two-loop recursion" in O(HistorySize.N), so models with thousands of parameters can be fit.
+// Models are the same as for BFGS, with an analytic gradient or parallel finite differences (cf. BFGS::IModel)
+//
+#pragma once
+
+#include "MinimizeBFGS.h"
+
+namespace MathSolvers {
+
+	class LBFGS {
+	private:	// FIELDS
+
+		int					m_coefficientsCount;		// Cached amount of coefficients used by the model
+		BFGS::IModel*		m_model;					// Pointer to the model to minimize
+
+		int					m_historySize;				// User-specified amount of parameter and gradient changes kept to approximate the Hessian
+		int					m_maxIterations;			// User-specified maximum amount of iterations of the algorithm
+		double				m_tolX;						// User-specified tolerance for target minimum
+		double				m_tolGradient;				// User-specified tolerance for gradient progression
+
+		double				m_functionMinimum;			// Current function minimum
+		int					m_iterationsCount;			// Current amount of iterations performed by the algorithm
+		int					m_evalCallsCount;			// (STATS) Amount of model evaluations called to reach minimum
+		int					m_evalGradientCallsCount;	// (STATS) Amount of gradient evaluations called to reach minimum
+
+		MatrixD				m_gradientParameters;		// The 2N perturbed copies of the parameters used by the finite differences
+		VectorD				m_gradientValues;			// The 2N model evaluations of the finite differences
+
+	public:	// PROPERTIES
+		// Gets or sets the amount of parameter and gradient changes used to approximate the Hessian (usually between 3 and 20)
+		int		getHistorySize() const				{ return m_historySize; }
+		void	setHistorySize( int value )			{ m_historySize = value; }
+
+		// Gets or sets the maximum amount of iterations performed by the algorithm
+		int		getMaxIterations() const			{ return m_maxIterations; }
+		void	setMaxIterations( int value )		{ m_maxIterations = value; }
+
+		// Gets or sets the tolerance below which the algorithm succeeds
+		double	getSuccessTolerance() const			{ return m_tolX; }
+		void	setSuccessTolerance( double value ) { m_tolX = value; }
+
+		// Gets or sets the tolerance of gradient magnitude below which the algorithm succeeds
+		double	getGradientSuccessTolerance() const			{ return m_tolGradient; }
+		void	setGradientSuccessTolerance( double value )	{ m_tolGradient = value; }
+
+		// Gets the amount of iterations performed by the algorithm
+		int		getIterationsCount() const			{ return m_iterationsCount; }
+
+		// Gets the minimum reached by the minimization
+		double	getFunctionMinimum() const			{ return m_functionMinimum; }
+
+		// Gets the amount of model evaluations performed by the algorithm, including the ones of the finite differences gradients
+		int		getEvalCallsCount() const			{ return m_evalCallsCount; }
+
+		// Gets the amount of gradients evaluated by the algorithm, either analytic or with finite differences
+		int		getEvalGradientCallsCount() const	{ return m_evalGradientCallsCount; }
+
+	public:	// METHODS
+
+		LBFGS();
+		~LBFGS();
+
+		// Performs minimization
+		// <param name="_model"></param>
+		void	Minimize( BFGS::IModel& _model );
+
+	private:
+
+		void	EvalGradient( VectorD& _params, VectorD& _gradient );
+
+		// Backtracking line search along _direction satisfying the Armijo condition
+		// <returns>The new function value, or _functionValue if no step could decrease it (_xout is then a copy of x)</returns>
+		double	LinearSearch( double _functionValue, const VectorD& _gradient, const VectorD& x, const VectorD& _direction, VectorD& _xout );
+	};
+
+}	// namespace MathSolvers
@@ -0,0 +1,225 @@
+#include "stdafx.h"
+#include "MinimizeLevenbergMarquardt.h"
+#include "MatrixKernels.h"
+#include "..\..\BaseLib\Utility\Parallel.h"
+
+using namespace MathSolvers;
+
+namespace {
+	double	SumSquares( const VectorD& a ) {
+		return Dot( a.m, a.m, a.length );
+	}
+
+	// Solves A.x = b for a symmetric positive definite A using a Cholesky decomposition
+	// <param name="_L">Temporary storage for the lower triangular factor</param>
+	// <returns>False if A is not positive definite</returns>
+	bool	SolveCholesky( const MatrixD& A, const VectorD& b, MatrixD& _L, VectorD& x ) {
+		U32	N = b.length;
+		_L.Init( N, N );
+		for ( U32 j=0; j < N; j++ ) {
+			double	sum = A[j][j];
+			for ( U32 k=0; k < j; k++ )
+				sum -= _L[j][k] * _L[j][k];
+			if ( sum <= 0.0 )
+				return false;
+			_L[j][j] = sqrt( sum );
+
+			double	invDiagonal = 1.0 / _L[j][j];
+			for ( U32 i=j+1; i < N; i++ ) {
+				sum = A[i][j];
+				for ( U32 k=0; k < j; k++ )
+					sum -= _L[i][k] * _L[j][k];
+				_L[i][j] = sum * invDiagonal;
+			}
+		}
+
+		// Solve L.z = b then L^T.x = z
+		for ( U32 i=0; i < N; i++ ) {
+			double	sum = b[i];
+			for ( U32 k=0; k < i; k++ )
+				sum -= _L[i][k] * x[k];
+			x[i] = sum / _L[i][i];
+		}
+		for ( int i=N-1; i >= 0; i-- ) {
+			double	sum = x[i];
+			for ( U32 k=i+1; k < N; k++ )
+				sum -= _L[k][i] * x[k];
+			x[i] = sum / _L[i][i];
+		}
+		return true;
+	}
+
+	// Evaluates the finite differences of the residuals for one parameter per index
+	struct	JacobianJob {
+		LevenbergMarquardt::IModel*	model;
+		const VectorD*				params;
+		const VectorD*				residuals;
+		MatrixD*					perturbedParameters;
+		MatrixD*					jacobianT;
+
+		void	operator()( U32 _index ) {
+			VectorD&	perturbed = (*perturbedParameters)[_index];
+			VectorD&	derivatives = (*jacobianT)[_index];
+			params->CopyTo( perturbed );
+
+			// Step proportional to the parameter, try the other side if constraints prevent the parameter from moving
+			double	h = 1.0e-7 * MAX( abs( perturbed[_index] ), 1.0 );
+			perturbed[_index] += h;
+			model->Constrain( perturbed );		// Pom: constrain!
+			double	delta = perturbed[_index] - (*params)[_index];
+			if ( delta == 0.0 ) {
+				params->CopyTo( perturbed );
+				perturbed[_index] -= h;
+				model->Constrain( perturbed );
+				delta = perturbed[_index] - (*params)[_index];
+			}
+			if ( delta == 0.0 ) {
+				derivatives.Clear();
+				return;
+			}
+
+			model->EvalResiduals( perturbed, derivatives );
+			double	invDelta = 1.0 / delta;
+			for ( U32 i=0; i < derivatives.length; i++ )
+				derivatives[i] = (derivatives[i] - (*residuals)[i]) * invDelta;
+		}
+	};
+}
+
+LevenbergMarquardt::LevenbergMarquardt()
+	: m_coefficientsCount( 0 )
+	, m_residualsCount( 0 )
+	, m_model( nullptr )
+	, m_maxIterations( 200 )
+	, m_tolX( 1.0e-8 )
+	, m_tolGradient( 1.0e-8 )
+	, m_initialLambda( 1.0e-3 )
+	, m_functionMinimum( DBL_MAX )
+	, m_iterationsCount( 0 )
+	, m_evalCallsCount( 0 )
+	, m_evalJacobianCallsCount( 0 ) {
+}
+LevenbergMarquardt::~LevenbergMarquardt() {
+}
+
+void	LevenbergMarquardt::Minimize( IModel& _model ) {
+	const double	MAX_LAMBDA = 1.0e16;
+
+	m_model = &_model;
+	m_coefficientsCount = m_model->getParameters().length;
+	m_residualsCount = m_model->getResidualsCount();
+
+	VectorD	x( m_coefficientsCount );
+	VectorD	newX( m_coefficientsCount );
+	VectorD	residuals( m_residualsCount );
+	VectorD	newResiduals( m_residualsCount );
+	MatrixD	jacobianT( m_coefficientsCount, m_residualsCount );
+
+	MatrixD	JTJ;													// Approximation of the Hessian
+	MatrixD	dampedJTJ( m_coefficientsCount, m_coefficientsCount );
+	MatrixD	L;
+	VectorD	gradient;												// J^T.r, half the gradient of the sum of squares
+	VectorD	negGradient( m_coefficientsCount );
+	VectorD	delta( m_coefficientsCount );
+
+	// Start from model's initial parameters
+	m_model->getParameters().CopyTo( x );
+
+	m_evalCallsCount = m_evalJacobianCallsCount = 0;
+
+	// Perform initial evaluation
+	m_model->EvalResiduals( x, residuals );
+	m_evalCallsCount++;
+	m_functionMinimum = SumSquares( residuals );
+
+	double	lambda = m_initialLambda;
+
+	m_iterationsCount = 0;
+	while ( ++m_iterationsCount < m_maxIterations ) {
+		EvalJacobian( x, residuals, jacobianT );
+
+		// Build the normal equations J^T.J and J^T.r (the Jacobian is stored transposed so these are the products of its rows)
+		MultiplyTransposed( jacobianT, jacobianT, JTJ );
+		Multiply( jacobianT, residuals, gradient );
+		for ( int d=0; d < m_coefficientsCount; d++ )
+			negGradient[d] = -gradient[d];
+
+		// if the current gradient (normalized by the current x and function minimum) is below tolerance, we're done:
+		double	maxGradient = 0.0;
+		double	normalizer = MAX( m_functionMinimum, 1.0 );
+		for ( int d=0; d < m_coefficientsCount; d++ )
+			maxGradient = MAX( maxGradient, 2.0 * abs( gradient[d] ) * MAX( abs( x[d] ), 1.0 ) / normalizer );
+		if ( maxGradient < m_tolGradient )
+			break;
+
+		// Increase the damping until a step decreases the error
+		bool	improved = false;
+		while ( !improved && lambda < MAX_LAMBDA ) {
+			JTJ.CopyTo( dampedJTJ );
+			for ( int d=0; d < m_coefficientsCount; d++ )
+				dampedJTJ[d][d] += lambda * MAX( JTJ[d][d], 1.0e-12 );
+
+			if ( !SolveCholesky( dampedJTJ, negGradient, L, delta ) ) {
+				lambda *= 10.0;
+				continue;
+			}
+
+			for ( int d=0; d < m_coefficientsCount; d++ )
+				newX[d] = x[d] + delta[d];
+
+			// Pom: constrain!
+			m_model->Constrain( newX );
+
+			m_model->EvalResiduals( newX, newResiduals );
+			m_evalCallsCount++;
+			double	newMinimum = SumSquares( newResiduals );
+			if ( _isnan( newMinimum ) )
+				throw "Residuals eval returned NaN!";
+
+			if ( newMinimum < m_functionMinimum ) {
+				improved = true;
+				m_functionMinimum = newMinimum;
+				lambda = MAX( 0.1 * lambda, 1.0e-12 );
+			} else {
+				lambda *= 10.0;
+			}
+		}
+		if ( !improved )
+			break;	// Can't make any progress anymore
+
+		// Notify of new optimal values
+		m_model->setParameters( newX );
+
+		// if the current point shift (relative to current position) is below tolerance, we're done:
+		double	maxShift = 0.0;
+		for ( int d=0; d < m_coefficientsCount; d++ )
+			maxShift = MAX( maxShift, abs( newX[d] - x[d] ) / MAX( abs( newX[d] ), 1.0 ) );
+
+		newX.Swap( x );
+		newResiduals.Swap( residuals );
+
+		if ( maxShift < m_tolX )
+			break;
+	}
+
+	// Copy final parameters
+	m_model->setParameters( x );
+}
+
+void	LevenbergMarquardt::EvalJacobian( const VectorD& _params, const VectorD& _residuals, MatrixD& _jacobianT ) {
+	m_evalJacobianCallsCount++;
+	if ( m_model->EvalJacobian( _params, _jacobianT ) )
+		return;
+
+	m_jacobianParameters.Init( m_coefficientsCount, m_coefficientsCount );
+
+	JacobianJob	job = { m_model, &_params, &_residuals, &m_jacobianParameters, &_jacobianT };
+	if ( m_model->IsThreadSafe() ) {
+		BaseLib::ParallelFor( U32(m_coefficientsCount), job );
+	} else {
+		for ( int i=0; i < m_coefficientsCount; i++ )
+			job( i );
+	}
+
+	m_evalCallsCount += m_coefficientsCount;
+}
@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////
+// Helper fitting class implementing Levenberg-Marquardt least-squares minimization (http://en.wikipedia.org/wiki/Levenberg%E2%80%93Marquardt_algorithm)
+// Minimizes the sum of the squared residuals of a model by solving (J^T.J + lambda.diag(J^T.J)).delta = -J^T.r at each iteration,
+//	which goes from a gradient descent (large lambda) to Gauss-Newton steps (small lambda) as the fit converges.
+// The Jacobian J is either analytic or estimated with forward finite differences, evaluated in parallel if the model is thread-safe.
+// Each iteration solves an NxN linear system so this is meant for up to a few hundred parameters, use LBFGS for larger problems.
+//
+#pragma once
+
+#include "Matrix.h"
+
+namespace MathSolvers {
+
+	class LevenbergMarquardt {
+	public:
+		// Interface to the least-squares model to minimize
+		class IModel abstract {
+		public:
+			// Gets or sets the free parameters used by the model
+			virtual VectorD&	getParameters() abstract;
+			virtual void		setParameters( const VectorD& value ) abstract;
+
+			// Gets the amount of residuals returned by EvalResiduals()
+			virtual U32			getResidualsCount() abstract;
+
+			// Evaluates the residuals given a set of parameters
+			// <param name="_residuals">Receives the (possibly weighted) differences between the model's estimates and the measured data</param>
+			virtual void		EvalResiduals( const VectorD& _newParameters, VectorD& _residuals ) abstract;
+
+			// Applies constraints to the array of parameters
+			// <param name="_Parameters"></param>
+			virtual void		Constrain( VectorD& _parameters ) abstract;
+
+			// Optionally computes the analytic Jacobian of the residuals, stored transposed so each parameter has its own row
+			// <param name="_jacobianT">Receives d(residual i)/d(parameter k) in _jacobianT[k][i]</param>
+			// <returns>False if the model has no analytic Jacobian, it is then estimated with forward finite differences</returns>
+			virtual bool		EvalJacobian( const VectorD& _parameters, MatrixD& _jacobianT )	{ return false; }
+
+			// Tells if EvalResiduals() and Constrain() can be called concurrently on different parameters (i.e. they don't modify the model)
+			// The N evaluations of the finite differences Jacobian are then performed in parallel
+			virtual bool		IsThreadSafe() const	{ return false; }
+		};
+
+	private:	// FIELDS
+
+		int					m_coefficientsCount;		// Cached amount of coefficients used by the model
+		int					m_residualsCount;			// Cached amount of residuals returned by the model
+		IModel*				m_model;					// Pointer to the model to minimize
+
+		int					m_maxIterations;			// User-specified maximum amount of iterations of the algorithm
+		double				m_tolX;						// User-specified tolerance for target minimum
+		double				m_tolGradient;				// User-specified tolerance for gradient progression
+		double				m_initialLambda;			// User-specified initial damping factor
+
+		double				m_functionMinimum;			// Current sum of squared residuals
+		int					m_iterationsCount;			// Current amount of iterations performed by the algorithm
+		int					m_evalCallsCount;			// (STATS) Amount of residuals evaluations called to reach minimum
+		int					m_evalJacobianCallsCount;	// (STATS) Amount of Jacobian evaluations called to reach minimum
+
+		MatrixD				m_jacobianParameters;		// The N perturbed copies of the parameters used by the finite differences
+
+	public:	// PROPERTIES
+		// Gets or sets the maximum amount of iterations performed by the algorithm
+		int		getMaxIterations() const			{ return m_maxIterations; }
+		void	setMaxIterations( int value )		{ m_maxIterations = value; }
+
+		// Gets or sets the tolerance below which the algorithm succeeds
+		double	getSuccessTolerance() const			{ return m_tolX; }
+		void	setSuccessTolerance( double value ) { m_tolX = value; }
+
+		// Gets or sets the tolerance of gradient magnitude below which the algorithm succeeds
+		double	getGradientSuccessTolerance() const			{ return m_tolGradient; }
+		void	setGradientSuccessTolerance( double value )	{ m_tolGradient = value; }
+
+		// Gets or sets the initial damping factor (larger values start closer to a gradient descent)
+		double	getInitialLambda() const			{ return m_initialLambda; }
+		void	setInitialLambda( double value )	{ m_initialLambda = value; }
+
+		// Gets the amount of iterations performed by the algorithm
+		int		getIterationsCount() const			{ return m_iterationsCount; }
+
+		// Gets the minimum sum of squared residuals reached by the minimization
+		double	getFunctionMinimum() const			{ return m_functionMinimum; }
+
+		// Gets the amount of residuals evaluations performed by the algorithm, including the ones of the finite differences Jacobians
+		int		getEvalCallsCount() const			{ return m_evalCallsCount; }
+
+		// Gets the amount of Jacobians evaluated by the algorithm, either analytic or with finite differences
+		int		getEvalJacobianCallsCount() const	{ return m_evalJacobianCallsCount; }
+
+	public:	// METHODS
+
+		LevenbergMarquardt();
+		~LevenbergMarquardt();
+
+		// Performs minimization
+		// <param name="_model"></param>
+		void	Minimize( IModel& _model );
+
+	private:
+
+		// Computes the transposed Jacobian at _params whose residuals are _residuals
+		void	EvalJacobian( const VectorD& _params, const VectorD& _residuals, MatrixD& _jacobianT );
+	};
+
+}	// namespace MathSolvers
@@ -1,8 +1,75 @@
 #include "stdafx.h"
 #include "SVD.h"
+#include "MatrixKernels.h"
+#include "..\..\BaseLib\Utility\Parallel.h"
 
 using namespace MathSolvers;
 
+namespace {
+	// Decompositions below this amount of multiply-adds per sweep are computed on the calling thread only
+	const double	PARALLEL_WORK_THRESHOLD = 1 << 22;
+
+	// Orthogonalizes all the pairs of columns within a block, or across 2 blocks
+	// The columns of A are stored as rows of Ut so each rotation streams through 2 contiguous rows.
+	//	Different blocks own different rows, so all the jobs of a round can run concurrently
+	struct	JacobiJob {
+		MatrixF*	Ut;
+		MatrixF*	Vt;
+		float*		norms;				// Squared norms of the rows of Ut
+		U32*		rotationsCounts;	// Rotations performed by each job during the sweep
+		U32			blockSize;
+		U32			blocksCount;		// Always even
+		int			round;				// Round of the tournament between blocks, or -1 to process the pairs within each block
+		float		tolerance;
+
+		U32		BlockStart( U32 _blockIndex ) const	{ return MIN( _blockIndex * blockSize, Ut->rows ); }
+
+		// Rotates columns p and q so they become orthogonal
+		bool	RotatePair( U32 p, U32 q ) {
+			float*	up = Ut->m_raw + Ut->columns * p;
+			float*	uq = Ut->m_raw + Ut->columns * q;
+			float	alpha = norms[p];
+			float	beta = norms[q];
+			float	gamma = Dot( up, uq, Ut->columns );
+			if ( fabs( gamma ) <= tolerance * sqrt( alpha * beta ) )
+				return false;	// Already orthogonal (or null)
+
+			// Compute the Jacobi rotation that zeroes the off-diagonal term of the 2x2 Gram matrix | alpha gamma ; gamma beta |
+			float	zeta = (beta - alpha) / (2.0f * gamma);
+			float	t = (zeta >= 0.0f ? 1.0f : -1.0f) / (fabs( zeta ) + sqrt( 1.0f + zeta * zeta ));
+			float	c = 1.0f / sqrt( 1.0f + t * t );
+			float	s = c * t;
+
+			Rotate( up, uq, c, s, Ut->columns );
+			Rotate( Vt->m_raw + Vt->columns * p, Vt->m_raw + Vt->columns * q, c, s, Vt->columns );
+			norms[p] = MAX( 0.0f, alpha - t * gamma );
+			norms[q] = MAX( 0.0f, beta + t * gamma );
+			return true;
+		}
+
+		void	operator()( U32 _jobIndex ) {
+			U32	rotationsCount = 0;
+			if ( round < 0 ) {
+				U32	p0 = BlockStart( _jobIndex ), p1 = BlockStart( _jobIndex+1 );
+				for ( U32 p=p0; p < p1; p++ )
+					for ( U32 q=p+1; q < p1; q++ )
+						rotationsCount += RotatePair( p, q ) ? 1 : 0;
+			} else {
+				// Round-robin pairing of the blocks: the last block stays in place while the others rotate around it
+				U32	lastBlock = blocksCount-1;
+				U32	blockP = _jobIndex == 0 ? lastBlock : (round + _jobIndex) % lastBlock;
+				U32	blockQ = (round + lastBlock - _jobIndex) % lastBlock;
+				U32	p0 = BlockStart( blockP ), p1 = BlockStart( blockP+1 );
+				U32	q0 = BlockStart( blockQ ), q1 = BlockStart( blockQ+1 );
+				for ( U32 p=p0; p < p1; p++ )
+					for ( U32 q=q0; q < q1; q++ )
+						rotationsCount += RotatePair( p, q ) ? 1 : 0;
+			}
+			rotationsCounts[_jobIndex] += rotationsCount;
+		}
+	};
+}
+
 void	SVD::Init( U32 _rows, U32 _columns ) {
 	A.Init( _rows, _columns );
 	U.Init( _rows, _columns );
@@ -25,305 +92,91 @@ void	SVD::Solve( const VectorF& b, VectorF& x ) {
 	if ( b.length != A.rows )
 		throw "Vector b length and matrix A's rows count mismatch!";
 
-	U32	unknownsCount = A.columns;
-	U32	equationsCount = A.rows;
-
-	VectorF	tempX( x.length );
-
 	// 1) Perform 1/w * U^T * b
-	for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) {
-		float	r = 0.0f;
-		for ( U32 i=0; i < equationsCount; i++ ) {
-			const float	Uterm = U[i][rowIndex];
-			const float	bterm = b[i];
-			r += Uterm * bterm;
-		}
-
-		// Multiply by 1/w
-		const float	wterm = w[rowIndex];
+	MultiplyTransposed( U, b, m_tempX );
+	for ( U32 i=0; i < m_tempX.length; i++ ) {
+		const float	wterm = w[i];
 		float		recW = fabs( wterm ) > 1e-6f ? 1.0f / wterm : 0.0f;	// We shouldn't ever have 0 values because of the overdetermined system of equations but let's be careful anyway!
-		tempX[rowIndex] = r * recW;
+		m_tempX[i] *= recW;
 	}
 
 	// 2) Perform V * (1/w * U^T * b)
-	for ( U32 rowIndex=0; rowIndex < unknownsCount; rowIndex++ ) {
-		float	r = 0.0f;
-		for ( U32 i=0; i < unknownsCount; i++ ) {
-			const float	Vterm = V[rowIndex][i];
-			const float	tempXterm = tempX[i];
-			r += Vterm * tempXterm;
-		}
-		x[rowIndex] = r;	// This is our final results!
-	}
+	Multiply( V, m_tempX, x );	// This is our final results!
 }
 
 //////////////////////////////////////////////////////////////////////////
 // Performs the actual Singular Value Decomposition
-float pythag(float a, float b);
-template<class T>
-inline T SIGN(const T &a, const T &b) { return b >= 0 ? (a >= 0 ? a : -a) : (a >= 0 ? -a : a); }
-
-static float maxarg1,maxarg2;
-#define FMAX(a,b) (maxarg1=(a),maxarg2=(b),(maxarg1) > (maxarg2) ?\
-        (maxarg1) : (maxarg2))
-
-static int iminarg1,iminarg2;
-#define IMIN(a,b) (iminarg1=(a),iminarg2=(b),(iminarg1) < (iminarg2) ?\
-        (iminarg1) : (iminarg2))
-
+//
 void	SVD::Decompose() {
-	// Copy A to U as SVD works in place
-	A.CopyTo( U );
-
-	int		m = U.rows;
-	int		n = U.columns;
-
-	VectorF	residualValues( n );
-	residualValues.Clear();
-
-	float	f = 0.0f, g = 0.0f, h = 0.0f;
- 	float	scale = 0.0f;
- 	float	anorm = 0.0f;
-
-	// Householder reduction to bidiagonal form
-	for ( int i=0; i < n; i++ ) {
-		int	l = i+1;
-		residualValues[i] = scale * g;
-
-		g = 0.0f;
-		float	s = 0.0f;
-		scale = 0.0f;
-		if ( i < m ) {
-			for ( int k=i; k < m; k++ )
-				scale += fabs( U[k][i] );
-
-			if ( scale != 0.0f ) {
-				for ( int k=i; k < m; k++ ) {
-					U[k][i] /= scale;
-					s += U[k][i] * U[k][i];
-				}
-				f = U[i][i];
-				g = -SIGN( sqrt(s), f );
-				h = f*g - s;
-				U[i][i] = f-g;
-				for ( int j=l; j < n; j++ ) {
-					s = 0.0f;
-					for ( int k = i; k < m; k++)
-						s += U[k][i] * U[k][j];
-
-					f = s/h;
-					for ( int k=i; k < m; k++ )
-						U[k][j] += f*U[k][i];
-				}
-				for ( int k=i; k < m; k++ )
-					U[k][i] *= scale;
+	const int	MAX_SWEEPS = 30;
+
+	U32	m = A.rows;
+	U32	n = A.columns;
+
+	// Work on the columns of A stored as rows, and accumulate the rotations into V^T
+	Transpose( A, m_Ut );
+	m_Vt.Init( n, n );
+	m_Vt.Clear();
+	for ( U32 i=0; i < n; i++ )
+		m_Vt[i][i] = 1.0f;
+
+	m_norms.Init( n );
+
+	// Split the columns into an even amount of blocks, 2 per thread for large matrices
+	bool	parallel = double(m) * n * n >= PARALLEL_WORK_THRESHOLD;
+	U32		threadsCount = parallel ? BaseLib::GetHardwareThreadsCount() : 1;
+	U32		blockSize = MAX( 16U, (n + 2*threadsCount-1) / (2*threadsCount) );
+	U32		blocksCount = (n + blockSize-1) / blockSize;
+			blocksCount += blocksCount & 1;
+
+	U32*	rotationsCounts = new U32[blocksCount];
+
+	JacobiJob	job;
+	job.Ut = &m_Ut;
+	job.Vt = &m_Vt;
+	job.norms = m_norms.m;
+	job.rotationsCounts = rotationsCounts;
+	job.blockSize = blockSize;
+	job.blocksCount = blocksCount;
+	job.tolerance = 8.0f * FLT_EPSILON * sqrtf( float(m) );	// Dot products can't be more accurate than that
+
+	int	sweepIndex = 0;
+	for ( ; sweepIndex < MAX_SWEEPS; sweepIndex++ ) {
+		// Refresh the norms that were updated incrementally during the previous sweep
+		for ( U32 i=0; i < n; i++ )
+			m_norms[i] = Dot( m_Ut[i].m, m_Ut[i].m, m );
+		memset( rotationsCounts, 0, blocksCount * sizeof(U32) );
+
+		// Process the pairs within each block, then the pairs across all the blocks
+		for ( job.round=-1; job.round < int(blocksCount-1); job.round++ ) {
+			U32	jobsCount = job.round < 0 ? blocksCount : blocksCount / 2;
+			if ( parallel ) {
+				BaseLib::ParallelFor( jobsCount, job );
+			} else {
+				for ( U32 jobIndex=0; jobIndex < jobsCount; jobIndex++ )
+					job( jobIndex );
 			}
 		}
-		w[i] = scale * g;
-
-		g = 0.0f;
-		s = 0.0f;
-		scale = 0.0f;
-		if ( i < m && l < n ) {
-			for ( int k=l; k < n; k++ )
-				scale += fabs( U[i][k] );
 
-			if ( scale != 0.0f ) {
-				for ( int k=l; k < n; k++ ) {
-					U[i][k] /= scale;
-					s += U[i][k] * U[i][k];
-				}
-				f = U[i][l];
-				g = -SIGN( sqrt(s), f );
-				h = f * g - s;
-				U[i][l] = f - g;
-				for ( int k=l; k < n; k++ )
-					residualValues[k] = U[i][k] / h;
-
-				for ( int j=l; j < m; j++ ) {
-					s = 0.0f;
-					for ( int k=l; k < n; k++ )
-						s += U[j][k] * U[i][k];
-
-					for ( int k=l; k < n; k++ )
-						U[j][k] += s * residualValues[k];
-				}
-				for ( int k=l; k < n; k++ )
-					U[i][k] *= scale;
-			}
-		}
-		anorm = FMAX( anorm, (fabs(w[i])+fabs(residualValues[i])) );
+		U32	rotationsCount = 0;
+		for ( U32 i=0; i < blocksCount; i++ )
+			rotationsCount += rotationsCounts[i];
+		if ( rotationsCount == 0 )
+			break;	// All the columns are orthogonal
 	}
-
-	// Accumulation of right-hand transformations
-	V[n-1][n-1] = 1.0f;
-	g = residualValues[n-1];
-
-	for ( int i=n-2; i >= 0; i-- ) {
-		int	l = i+1;
-		if ( g != 0.0f ) {
-			for ( int j=l; j < n; j++ )
-				V[j][i] = (U[i][j] / U[i][l]) / g;	// Double division to avoid possible underflow
-
-			for ( int j=l; j < n; j++) {
-				float	s = 0.0f;
-				for ( int k=l; k < n; k++ )
-					s += U[i][k] * V[k][j];
-				for ( int k=l; k < n; k++ )
-					V[k][j] += s * V[k][i];
-			}
-		}
-		for ( int j=l; j < n; j++ )
-			V[i][j] = V[j][i] = 0.0f;
-
-		V[i][i] = 1.0f;
-		g = residualValues[i];
-	}
-
-	// Accumulation of left-hand transformations
-	for ( int i=IMIN(m,n)-1; i >= 0; i-- ) {
-		int	l = i+1;
-		g = w[i];
-		for ( int j=l; j < n; j++ )
-			U[i][j] = 0.0f;
-		if ( g != 0.0f ) {
-			g = 1.0f / g;
-			for ( int j=l; j < n; j++ ) {
-				float	s = 0.0f;
-				for ( int k=l; k < m; k++ )
-					s += U[k][i] * U[k][j];
-
-				f = (s / U[i][i]) * g;
-				for ( int k=i; k < m; k++ )
-					U[k][j] += f * U[k][i];
-			}
-		}
-		for ( int j=i; j < m; j++ )
-			U[j][i] *= g;
-
-		++U[i][i];
+	m_sweepsCount = MIN( sweepIndex+1, MAX_SWEEPS );
+	delete[] rotationsCounts;
+
+	// The singular values are the norms of the orthogonalized columns, and normalizing them gives U
+	for ( U32 i=0; i < n; i++ ) {
+		float	norm = sqrtf( Dot( m_Ut[i].m, m_Ut[i].m, m ) );
+		w[i] = norm;
+
+		float	invNorm = norm > 0.0f ? 1.0f / norm : 0.0f;
+		float*	row = m_Ut[i].m;
+		for ( U32 j=0; j < m; j++ )
+			row[j] *= invNorm;
 	}
-
-	// Diagonalization of the bidiagonal form: Loop over singular values, and over allowed iterations
-	const int	MAX_ITERATIONS = 30;
-//	const int	MAX_ITERATIONS = 1000;
-
-	for ( int k=n-1; k >= 0; k-- ) {
-		int	iterationsCount = 1;
-		for ( ; iterationsCount <= MAX_ITERATIONS; iterationsCount++ ) {
-			int	nm;
-			// Test for splitting
-			bool	flag = true;
-			int		l = k;
-			for ( ; l >= 0; l-- ) {
-				nm = l-1;
-				// Note that rv1[0] is always zero so we eventually break at the very end
-				if ( float( fabs(residualValues[l]) + anorm ) == anorm ) {
-					flag = false;
-					break;
-				}
-				ASSERT( nm >= 0, "nm in negative range!" );
-				if ( float( fabs(w[nm]) + anorm ) == anorm )
-					break;
-			}
-			if ( flag ) {
-				// Cancellation of rv1[l], if l > 0.
-				float	c = 0.0f;
-				float	s = 1.0f;
-				for ( int i=l; i < k; i++ ) {
-					f = s * residualValues[i];
-					residualValues[i] = c * residualValues[i];
-					if ( float( fabs(f) + anorm ) == anorm )
-						break;
-
-					g = w[i];
-					h = pythag( f, g );
-					w[i] = h;
-					h = 1.0f / h;
-					c = g * h;
-					s = -f * h;
-					for ( int j=0; j < m; j++ ) {
-						float	y = U[j][nm];
-						float	z = U[j][i];
-						U[j][nm] = y*c + z*s;
-						U[j][i]  = z*c - y*s;
-					}
-				}
-			}
-			float	z = w[k];
-			if ( l == k ) {
-				// Convergence
-				if ( z < 0.0f ) {
-					// Singular value is made nonnegative
-					w[k] = -z;
-					for ( int j=0; j < n; j++ )
-						V[j][k] = -V[j][k];
-				}
-				break;
-			}
-			if ( iterationsCount >= MAX_ITERATIONS )
-				throw "No convergence in svdcmp iterations";
-
-			nm = k-1;
-			ASSERT( nm >= 0, "nm in negative range!" );
-
-			float	x = w[l];	// Shift from bottom 2-by-2 minor
-			float	y = w[nm];
-			g = residualValues[nm];
-			h = residualValues[k];
-			f = ((y-z)*(y+z)+(g-h)*(g+h)) / (2.0f*h*y);
-			g = pythag( f, 1.0f );
-			f = ((x-z)*(x+z)+h*((y/(f+SIGN(g,f)))-h))/x;
-
-// sprintf( debugString, "ITERATION %d = f = %f - g = %f - h = %f\r\n", iterationsCount, f, g, h );
-// OutputDebugStringA( debugString );
-
-			// Next QR transformation
-			float	c = 1.0f;
-			float	s = 1.0f;
-			for ( int j=l; j <= nm; j++ ) {
-				int	i = j+1;
-				g = residualValues[i];
-				y = w[i];
-				h = s*g;
-				g = c*g;
-				z = pythag( f, h );
-				residualValues[j] = z;
-				c = f/z;
-				s = h/z;
-				f = x*c + g*s;	// Rotation with sine/cosine?
-				g = g*c - x*s;
-				h = y*s;
-				y *= c;
-				for ( int jj=0; jj < n; jj++ ) {
-					x = V[jj][j];
-					z = V[jj][i];
-					V[jj][j] = x*c + z*s;
-					V[jj][i] = z*c - x*s;
-				}
-				z = pythag( f, h );
-				w[j] = z;
-				if ( z != 0.0f ) {
-					z = 1.0f / z;
-					c = f*z;
-					s = h*z;
-				}
-				f = c*g + s*y;
-				x = c*y - s*g;
-				for ( int jj=0; jj < m; jj++ ) {
-					y = U[jj][j];
-					z = U[jj][i];
-					U[jj][j] = y*c + z*s;
-					U[jj][i] = z*c - y*s;
-				}
-
-// sprintf( debugString, "j = %d -> z = %f - f = %f - x = %f\r\n", j, z, f, x );
-// OutputDebugStringA( debugString );
-			}
-			residualValues[l] = 0.0f;
-			residualValues[k] = f;
-			w[k] = x;
-		}	// for ( ; iterationsCount <= 30; iterationsCount++ ) 
-	}	// for ( int k=n-1; k >= 0; k-- ) 
+	Transpose( m_Ut, U );
+	Transpose( m_Vt, V );
 }
-
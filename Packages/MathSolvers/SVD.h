@@ -1,8 +1,10 @@
 ﻿//////////////////////////////////////////////////////////////////////////
 // Implementation of Singular Value Decomposition
 // SVD is generally used to solve large systems of equations, possibly over-determined (i.e. more equations than unknowns)
-// From Numerical Recipes, chapter 2.6 (NOTE: I rewrote the code so it uses 0-based vectors and matrices!)
-// (NR stole it themselves from Golub: http://people.duke.edu/~hpgavin/SystemID/References/Golub+Reinsch-NM-1970.pdf)
+// Uses the one-sided Jacobi method (Hestenes): pairs of columns of A are rotated until they're all orthogonal, the norms of
+//	the columns are then the singular values and the normalized columns are U, while V accumulates the rotations.
+// Columns are split into blocks and the pairs of blocks are processed in a round-robin tournament so large matrices
+//	are decomposed by all the hardware threads (cf. http://www.netlib.org/lapack/lawnspdf/lawn169.pdf)
 //
 // The Singular Value Decomposition decomposes a matrix A into a product of 3 matrices U, w and V such as:
 //	A = U.W.V^T
@@ -64,23 +66,36 @@ namespace MathSolvers {
 		VectorF		w;	// Singular-values of diagonal matrix W
 		MatrixF		V;	// Matrix of right-singular vectors (WARNING! NOT the transpose V^T)
 
+	private:
+
+		MatrixF		m_Ut;			// Columns of A being orthogonalized, stored as rows
+		MatrixF		m_Vt;			// Accumulated rotations, stored as rows
+		VectorF		m_norms;		// Squared norms of the columns
+		VectorF		m_tempX;		// 1/w * U^T * b computed by Solve()
+		int			m_sweepsCount;	// (STATS) Amount of sweeps over all the pairs of columns performed by the last decomposition
+
+	public:		// PROPERTIES
+
+		// Gets the amount of sweeps over all the pairs of columns performed by the last decomposition (usually between 5 and 10)
+		int		getSweepsCount() const	{ return m_sweepsCount; }
+
 	public:		// METHODS
 
-		SVD();
-		SVD( U32 _rows, U32 _columns ) {
+		SVD() : m_sweepsCount( 0 ) {}
+		SVD( U32 _rows, U32 _columns ) : m_sweepsCount( 0 ) {
 			Init( _rows, _columns );
 		}
-		SVD( const MatrixF& _A ) {
+		SVD( const MatrixF& _A ) : m_sweepsCount( 0 ) {
 			Init( _A );
 		}
 
 		void	Init( U32 _rows, U32 _columns );
 		void	Init( const MatrixF& _A );
 
-		// Given a matrix a[1..m][1..n], this routine computes its singular value decomposition, A = U · W · V^T
-		//	The matrix U replaces A on output.
-		//	The diagonal matrix of singular values W is output as a vector w[1..n].
-		//	The matrix V (not the transpose V^T) is output as v[1..n][1..n].
+		// Given the matrix A[m][n], this routine computes its singular value decomposition, A = U · W · V^T
+		//	The matrix U is output as U[m][n] (A is left untouched).
+		//	The diagonal matrix of singular values W is output as a vector w[n] (unsorted).
+		//	The matrix V (not the transpose V^T) is output as V[n][n].
 		//
 		void	Decompose();
 
@@ -1,594 +1,160 @@
 #include "../GodComplex.h"
-
-#define VWRITE( pVertex, P, N, T, B, UV )	AppendVertex( _Writer, pVertex, P, N, T, B, UV, _TweakVertex, _pUserData );	VerticesCount--
-#define IWRITE( pIndex, i )					_Writer.AppendIndex( pIndex, i );	IndicesCount--
-
+#include "../BaseLib/Utility/MeshOptimizer.h"
 
 //////////////////////////////////////////////////////////////////////////
+// Forwards the templated build path to an IGeometryWriter
+// The writer expects the vertices and indices in order through its own cursors so this layout isn't thread-safe
 //
-void	GeometryBuilder::BuildSphere( int _PhiSubdivisions, int _ThetaSubdivisions, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+class	GeometryBuilder::WriterLayout
 {
-	int	BandLength = _PhiSubdivisions;
-	int	VerticesCount = (BandLength+1) * (1 + _ThetaSubdivisions + 1);	// 1 band at the top and bottom of the sphere + as many subdivisions as required
-
-	int	BandsCount = 1 + _ThetaSubdivisions;
-	int	IndicesCount = (2*(BandLength+1+1)) * BandsCount - 2;
-
-	// Create the buffers
-	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
-	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
-	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
-	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
-
-	void*		pVertex = pVerticesArray;
-	void*		pIndex = pIndicesArray;
-
-	//////////////////////////////////////////////////////////////////////////
-	// Build vertices
-	float3	Position, Normal, Tangent, BiTangent;
-	float2	UV;
-
-	// Top band
+public:
+	static const bool	IS_THREAD_SAFE = false;
+
+	IGeometryWriter&	m_Writer;
+	void*				m_pVerticesArray;
+	void*				m_pIndicesArray;
+	void*				m_pVertex;
+	void*				m_pIndex;
+	int					m_VerticesCount;
+	int					m_IndicesCount;
+
+public:
+	WriterLayout( IGeometryWriter& _Writer, int _VerticesCount, int _IndicesCount )
+		: m_Writer( _Writer )
+		, m_pVerticesArray( NULL )
+		, m_pIndicesArray( NULL )
+		, m_VerticesCount( 0 )
+		, m_IndicesCount( 0 )
 	{
-		for ( int i=0; i <= BandLength; i++ )
-		{
-			float	Phi = TWOPI * i / BandLength;
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
-
-			// Create a dummy position that is slightly offseted from the top of the sphere so UVs are not all identical
-			Position.y = 1.0f;
-			Position.x = -0.001f * Tangent.z;
-			Position.z = 0.001f * Tangent.x;
-//			Position.Normalize();
-			Normal = Position;	Normal.Normalize();
-
-			BiTangent = Normal.Cross( Tangent );
-
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == BandLength );
-			else
-				UV.Set( 2.0f * float(i) / BandLength, 0.0f );
-
-			Position.x = Position.z = 0.0f;
-
-			// Write vertex
-			VWRITE( pVertex, float3::UnitY, float3::UnitY, Tangent, BiTangent, UV );
-		}
+		m_Writer.CreateBuffers( _VerticesCount, _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, m_pVerticesArray, m_pIndicesArray );
+		ASSERT( m_pVerticesArray != NULL, "Invalid vertex buffer !" );
+		ASSERT( m_pIndicesArray != NULL, "Invalid index buffer !" );
+		m_pVertex = m_pVerticesArray;
+		m_pIndex = m_pIndicesArray;
 	}
 
-	// Generic bands
-	for ( int j=0; j < _ThetaSubdivisions; j++ )
+	void	WriteVertex( int _VertexIndex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV )
 	{
-		float	Theta = PI * (1+j) / (1 + _ThetaSubdivisions);
-		for ( int i=0; i <= BandLength; i++ )
-		{
-			float	Phi = TWOPI * i / BandLength;
-
-			Position.x = sinf( Phi ) * sinf( Theta );
-			Position.y = cosf( Theta );
-			Position.z = cosf( Phi ) * sinf( Theta );
-
-			Normal = Position;
-
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
-
-			BiTangent = Normal.Cross( Tangent );
-
-			// Ask for UVs
-			if (_pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == BandLength );
-			else
-				UV.Set( 2.0f * float(i) / BandLength, float(j) / _ThetaSubdivisions );
-
-			// Write vertex
-			VWRITE( pVertex, Position, Normal, Tangent, BiTangent, UV );
-		}
+		ASSERT( _VertexIndex == m_VerticesCount++, "Vertices must be written in order!" );
+		m_Writer.AppendVertex( m_pVertex, _Position, _Normal, _Tangent, _BiTangent, _UV );
 	}
-
-	// Bottom band
+	void	WriteIndex( int _Index, int _VertexIndex )
 	{
-		for ( int i=0; i <= BandLength; i++ )
-		{
-			float	Phi = TWOPI * i / BandLength;
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
-
-			// Create a dummy position that is slightly offseted from the bottom of the sphere so UVs are not all identical
-			Position.y = -1.0f;
-			Position.x = -0.001f * Tangent.z;
-			Position.z = 0.001f * Tangent.x;
-//			Position.Normalize();
-			Normal = Position;	Normal.Normalize();
-
-			BiTangent = Normal.Cross( Tangent );
-
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == BandLength );
-			else
-				UV.Set( 2.0f * float(i) / BandLength, 1.0f );
-
-			Position.x = Position.z = 0.0f;
-
-			// Write vertex
-			VWRITE( pVertex, -float3::UnitY, -float3::UnitY, Tangent, BiTangent, UV );
-		}
+		ASSERT( _Index == m_IndicesCount++, "Indices must be written in order!" );
+		m_Writer.AppendIndex( m_pIndex, _VertexIndex );
 	}
-	ASSERT( VerticesCount == 0, "Wrong contruction!" );
-
 
-	//////////////////////////////////////////////////////////////////////////
-	// Build indices
-	for ( int j=0; j < BandsCount; j++ )
+	void	Finalize()
 	{
-		int	CurrentBandOffset = j * (BandLength+1);
-		int	NextBandOffset = (j+1) * (BandLength+1);
-
-		for ( int i=0; i <= BandLength; i++ )
-		{
-			IWRITE( pIndex, CurrentBandOffset + i );
-			IWRITE( pIndex, NextBandOffset + i );
-		}
-
-		if ( j == BandsCount-1 )
-			continue;	// Not for the last band...
-
-		// Write 2 last degenerate indices so we smoothly transition to next band
-		IWRITE( pIndex, NextBandOffset + BandLength );
-		IWRITE( pIndex, NextBandOffset + BandLength+1 );
+		m_Writer.Finalize( m_pVerticesArray, m_pIndicesArray );
 	}
-	ASSERT( IndicesCount == 0, "Wrong contruction!" );
+};
 
-	//////////////////////////////////////////////////////////////////////////
-	// Finalize
-	_Writer.Finalize( pVerticesArray, pIndicesArray );
-}
 
-void	GeometryBuilder::BuildCylinder( int _RadialSubdivisions, int _VerticalSubdivisions, bool _bIncludeCaps, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+//////////////////////////////////////////////////////////////////////////
+// Sizes of the primitives
+//
+void	GeometryBuilder::GetSphereSize( int _PhiSubdivisions, int _ThetaSubdivisions, int& _VerticesCount, int& _IndicesCount )
 {
-	ASSERT( _RadialSubdivisions > 1, "Can't create a cylinder with less than 2 radial subdivisions!" );
-	ASSERT( _VerticalSubdivisions > 0, "Can't create a cylinder with 0 vertical subdivisions!" );
+	int	BandLength = _PhiSubdivisions;
+	int	BandsCount = 1 + _ThetaSubdivisions;
+	_VerticesCount = (BandLength+1) * (1 + _ThetaSubdivisions + 1);	// 1 band at the top and bottom of the sphere + as many subdivisions as required
+	_IndicesCount = (2*(BandLength+1+1)) * BandsCount - 2;
+}
 
+void	GeometryBuilder::GetCylinderSize( int _RadialSubdivisions, int _VerticalSubdivisions, bool _bIncludeCaps, int& _VerticesCount, int& _IndicesCount )
+{
 	int	BandLength = 1+_RadialSubdivisions;
 	int	BandsCount = _bIncludeCaps ? 1 + (1+_VerticalSubdivisions) + 1 : 1+_VerticalSubdivisions;	// 1 band at the top and bottom for the optional caps + as many subdivisions as required
-	int	VerticesCount = BandLength * BandsCount;
-
-	int	IndicesCount = 2 * (BandLength+1) * (BandsCount-1) - 2;
-
-	// Create the buffers
-	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
-	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
-	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
-	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
-
-	void*		pVertex = pVerticesArray;
-	void*		pIndex = pIndicesArray;
-
-	//////////////////////////////////////////////////////////////////////////
-	// Build vertices
-	float3	Position, Normal, Tangent, BiTangent;
-	float2	UV;
-
-	// Top vertices
-	if ( _bIncludeCaps )
-	{
-		for ( int i=0; i <= _RadialSubdivisions; i++ )
-		{
-			float	Phi = TWOPI * i / _RadialSubdivisions;
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
-
-			// Create a dummy position that is slightly offseted from the top of the sphere so UVs are not all identical
-			Position.y = 1.0f;
-			Position.x = -0.001f * Tangent.z;
-			Position.z = 0.001f * Tangent.x;
-			Normal = float3::UnitY;
-
-			BiTangent = Normal.Cross( Tangent );
-
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == _RadialSubdivisions );
-			else
-				UV.Set( 2.0f * float(i) / _RadialSubdivisions, 0.0f );
-
-			Position.x = Position.z = 0.0f;
-
-			// Write vertex
-			VWRITE( pVertex, float3::UnitY, float3::UnitY, Tangent, BiTangent, UV );
-		}
-	}
-
-	// Generic bands
-	for ( int j=0; j <= _VerticalSubdivisions; j++ )
-	{
-		float	Y = 1.0f - 2.0f * j / _VerticalSubdivisions;
-		for ( int i=0; i <= _RadialSubdivisions; i++ )
-		{
-			float	Phi = TWOPI * i / _RadialSubdivisions;
-
-			Position.x = sinf( Phi );
-			Position.y = Y;
-			Position.z = cosf( Phi );
-
-			Normal.x = sinf( Phi );
-			Normal.y = 0;
-			Normal.z = cosf( Phi );
-
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
-
-			BiTangent = Normal.Cross( Tangent );
-
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == _RadialSubdivisions );
-			else
-				UV.Set( 2.0f * float(i) / _RadialSubdivisions, float(j) / _VerticalSubdivisions );
-
-			// Write vertex
-			VWRITE( pVertex, Position, Normal, Tangent, BiTangent, UV );
-		}
-	}
-
-	// Bottom band
-	if ( _bIncludeCaps )
-	{
-		for ( int i=0; i <= _RadialSubdivisions; i++ )
-		{
-			float	Phi = TWOPI * i / _RadialSubdivisions;
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
-
-			// Create a dummy position that is slightly offseted from the bottom of the sphere so UVs are not all identical
-			Position.y = -1.0f;
-			Position.x = -0.001f * Tangent.z;
-			Position.z = 0.001f * Tangent.x;
-			Normal = -float3::UnitY;
-
-			BiTangent = Normal.Cross( Tangent );
-
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == _RadialSubdivisions );
-			else
-				UV.Set( 2.0f * float(i) / _RadialSubdivisions, 1.0f );
-
-			Position.x = Position.z = 0.0f;
-
-			// Write vertex
-			VWRITE( pVertex, -float3::UnitY, -float3::UnitY, Tangent, BiTangent, UV );
-		}
-	}
-	ASSERT( VerticesCount == 0, "Wrong contruction!" );
-
-
-	//////////////////////////////////////////////////////////////////////////
-	// Build indices
-	for ( int j=0; j < BandsCount-1; j++ )
-	{
-		int	CurrentBandOffset = j * BandLength;
-		int	NextBandOffset = (j+1) * BandLength;
-
-		for ( int i=0; i < BandLength; i++ )
-		{
-			IWRITE( pIndex, CurrentBandOffset + i );
-			IWRITE( pIndex, NextBandOffset + i );
-		}
-
-		if ( j == BandsCount-2 )
-			continue;	// Not for the last band...
-
-		// Write 2 last degenerate indices so we smoothly transition to next band
-		IWRITE( pIndex, NextBandOffset + BandLength-1 );
-		IWRITE( pIndex, NextBandOffset + BandLength );
-	}
-	ASSERT( IndicesCount == 0, "Wrong contruction!" );
-
-	//////////////////////////////////////////////////////////////////////////
-	// Finalize
-	_Writer.Finalize( pVerticesArray, pIndicesArray );
+	_VerticesCount = BandLength * BandsCount;
+	_IndicesCount = 2 * (BandLength+1) * (BandsCount-1) - 2;
 }
 
-void	GeometryBuilder::BuildTorus( int _PhiSubdivisions, int _ThetaSubdivisions, float _LargeRadius, float _SmallRadius, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+void	GeometryBuilder::GetTorusSize( int _PhiSubdivisions, int _ThetaSubdivisions, int& _VerticesCount, int& _IndicesCount )
 {
 	int	BandLength = _ThetaSubdivisions;
 	int	BandsCount = _PhiSubdivisions;
-
-	int	VerticesCount = BandsCount * (BandLength+1);
-	int	IndicesCount = 2*(BandLength+1+1) * BandsCount - 2;
-
-	// Create the buffers
-	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
-	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
-	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
-	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
-
-	void*		pVertex = pVerticesArray;
-	void*		pIndex = pIndicesArray;
-
-	//////////////////////////////////////////////////////////////////////////
-	// Build vertices
-	float3	Position, Normal, Tangent, BiTangent;
-	float2	UV;
-
-	for ( int j=0; j < BandsCount; j++ )
-	{
-		float		Phi = TWOPI * j / BandsCount;
-
-		float3	X( cosf(Phi), sinf(Phi), 0.0f );	// Radial branch in X^Y plane at this angle
-		float3	Center = _LargeRadius * X;			// Center of the small ring
-
-		Tangent.x = -sinf(Phi);
-		Tangent.y = cosf(Phi);
-		Tangent.z = 0.0f;
-
-		for ( int i=0; i <= BandLength; i++ )
-		{
-			float	Theta = TWOPI * i / BandLength;
-
-			Normal = cosf(Theta) * X + sinf(Theta) * float3::UnitZ;
-			Position = Center + _SmallRadius * Normal;
-
-			BiTangent = Normal.Cross( Tangent );
-
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == BandLength );
-			else
-				UV.Set( 4.0f * float(j) / BandsCount, float(j) / BandLength );
-
-			VWRITE( pVertex, Position, Normal, Tangent, BiTangent, UV );
-		}
-	}
-	ASSERT( VerticesCount == 0, "Wrong contruction!" );
-
-	//////////////////////////////////////////////////////////////////////////
-	// Build indices
-	for ( int j=0; j < BandsCount; j++ )
-	{
-		int	CurrentBandOffset = j * (BandLength+1);
-		int	NextBandOffset = ((j+1) % _PhiSubdivisions) * (BandLength+1);
-		int	NextNextBandOffset = ((j+2) % _PhiSubdivisions) * (BandLength+1);
-
-		for ( int i=0; i <= BandLength; i++ )
-		{
-			IWRITE( pIndex, CurrentBandOffset + i );
-			IWRITE( pIndex, NextBandOffset + i );
-		}
-
-		if ( j == BandsCount-1 )
-			continue;	// Not for the last band...
-
-		// Write 2 last degenerate indices so we smoothly transition to next band
-		IWRITE( pIndex, NextBandOffset + BandLength );
-		IWRITE( pIndex, NextNextBandOffset );
-	}
-	ASSERT( IndicesCount == 0, "Wrong contruction!" );
-
-	//////////////////////////////////////////////////////////////////////////
-	// Finalize
-	_Writer.Finalize( pVerticesArray, pIndicesArray );
+	_VerticesCount = BandsCount * (BandLength+1);
+	_IndicesCount = 2*(BandLength+1+1) * BandsCount - 2;
 }
 
-void	GeometryBuilder::BuildPlane( int _SubdivisionsX, int _SubdivisionsY, const float3& _X, const float3& _Y, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+void	GeometryBuilder::GetPlaneSize( int _SubdivisionsX, int _SubdivisionsY, int& _VerticesCount, int& _IndicesCount )
 {
-	ASSERT( _SubdivisionsX > 0 && _SubdivisionsY > 0, "Can't create a plane with 0 subdivision!" );
-
-	int	VerticesCount = (_SubdivisionsX+1) * (_SubdivisionsY+1);
-	int	IndicesCount = 2*(_SubdivisionsX+1+1) * _SubdivisionsY - 2;
-
-	// Create the buffers
-	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
-	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
-	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
-	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
-
-	void*		pVertex = pVerticesArray;
-	void*		pIndex = pIndicesArray;
-
-	//////////////////////////////////////////////////////////////////////////
-	// Build vertices
-	float3	Tangent = _X;							Tangent.Normalize();
-	float3	BiTangent = _Y;							BiTangent.Normalize();
-	float3	Normal = Tangent.Cross( BiTangent );	Normal.Normalize();
-
-	float3	Position;
-	float2	UV;
-
-	for ( int j=0; j <= _SubdivisionsY; j++ )
-	{
-		float	Y = 1.0f - 2.0f * j / _SubdivisionsY;
-		for ( int i=0; i <= _SubdivisionsX; i++ )
-		{
-			float	X = 2.0f * i / _SubdivisionsX - 1.0f;
-
-			Position = X * _X + Y * _Y;
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, false );
-			else
-				UV.Set( float(i) / _SubdivisionsX, float(j) / _SubdivisionsY );
-
-			VWRITE( pVertex, Position, Normal, Tangent, BiTangent, UV );
-		}
-	}
-	ASSERT( VerticesCount == 0, "Wrong contruction!" );
-
-	//////////////////////////////////////////////////////////////////////////
-	// Build indices
-	for ( int j=0; j < _SubdivisionsY; j++ )
-	{
-		int	CurrentBandOffset = j * (_SubdivisionsX+1);
-		int	NextBandOffset = (j+1) * (_SubdivisionsX+1);
-
-		for ( int i=0; i <= _SubdivisionsX; i++ )
-		{
-			IWRITE( pIndex, CurrentBandOffset + i );
-			IWRITE( pIndex, NextBandOffset + i );
-		}
-
-		if ( j == _SubdivisionsY-1 )
-			continue;	// Not for the last band...
-
-		// Write 2 last degenerate indices so we smoothly transition to next band
-		IWRITE( pIndex, NextBandOffset+_SubdivisionsX );
-		IWRITE( pIndex, NextBandOffset );
-	}
-	ASSERT( IndicesCount == 0, "Wrong contruction!" );
-
-	//////////////////////////////////////////////////////////////////////////
-	// Finalize
-	_Writer.Finalize( pVerticesArray, pIndicesArray );
+	_VerticesCount = (_SubdivisionsX+1) * (_SubdivisionsY+1);
+	_IndicesCount = 2*(_SubdivisionsX+1+1) * _SubdivisionsY - 2;
 }
 
-void	GeometryBuilder::BuildCube( int _SubdivisionsX, int _SubdivisionsY, int _SubdivisionsZ, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+void	GeometryBuilder::GetCubeSize( int _SubdivisionsX, int _SubdivisionsY, int _SubdivisionsZ, int& _VerticesCount, int& _IndicesCount )
 {
-	ASSERT( _SubdivisionsX > 0 && _SubdivisionsY > 0 && _SubdivisionsZ > 0, "Can't create a cube with 0 subdivision!" );
-
 	int	SizeX = _SubdivisionsX+1;
 	int	SizeY = _SubdivisionsY+1;
 	int	SizeZ = _SubdivisionsZ+1;
+	_VerticesCount = 2*(SizeX*SizeY + SizeX*SizeZ + SizeY*SizeZ);
+	_IndicesCount = 2*( (2*(SizeZ+1) * _SubdivisionsY - 2) + (2*(SizeX+1) * _SubdivisionsZ - 2) + (2*(SizeX+1) * _SubdivisionsY - 2) ) + 2*5;	// Strips of the X, Y and Z faces + 2 degenerate indices between faces
+}
 
-	int	VerticesCount = 2*(SizeX*SizeY + SizeX*SizeZ + SizeY*SizeZ);
-	int	IndicesCount = 2*( (2*(SizeZ+1) * _SubdivisionsY - 2) + (2*(SizeX+1) * _SubdivisionsZ - 2) + (2*(SizeX+1) * _SubdivisionsZ - 2) ) + 2*5;
-
-	// Create the buffers
-	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
-	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
-	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
-	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
-
-	void*	pVertex = pVerticesArray;
-	void*	pIndex = pIndicesArray;
-
-	//////////////////////////////////////////////////////////////////////////
-	// Build vertices
-	float3	pNormals[6] = {
-		-float3::UnitX,
-		 float3::UnitX,
-		-float3::UnitY,
-		 float3::UnitY,
-		-float3::UnitZ,
-		 float3::UnitZ,
-	};
-	float3	pTangents[6] = {
-		 float3::UnitZ,
-		-float3::UnitZ,
-		 float3::UnitX,
-		 float3::UnitX,
-		-float3::UnitX,
-		 float3::UnitX,
-	};
-
-	int			pSizesX[6] = { SizeZ, SizeZ, SizeX, SizeX, SizeX, SizeX };
-	int			pSizesY[6] = { SizeY, SizeY, SizeZ, SizeZ, SizeZ, SizeZ };
-
-	float3	Position, Normal, X, Y;
-	float2	UV;
-
-	for ( int FaceIndex=0; FaceIndex < 6; FaceIndex++ )
-	{
-		int		Sx = pSizesX[FaceIndex];
-		int		Sy = pSizesY[FaceIndex];
-		Normal = pNormals[FaceIndex];
-		X = pTangents[FaceIndex];
-		Y = Normal.Cross( X );
-
-		for ( int j=0; j < Sy; j++ )
-		{
-			float	y = 1.0f - 2.0f * float(j) / (Sy-1);
-			for ( int i=0; i < Sx; i++ )
-			{
-				float	x = 2.0f * float(i) / (Sx-1) - 1.0f;
-
-				Position = Normal + x * X + y * Y;
-
-				if ( _pMapper )
-					_pMapper->Map( Position, Normal, X, UV, false );
-				else
-					UV.Set( 0.5f * (1.0f + x), 0.5f * (1.0f + y) );
-
-				VWRITE( pVertex, Position, Normal, X, Y, UV );
-			}
-		}
-	}
-	ASSERT( VerticesCount == 0, "Wrong contruction!" );
 
-	//////////////////////////////////////////////////////////////////////////
-	// Build indices
-	int		FaceOffset = 0;
-	for ( int FaceIndex=0; FaceIndex < 6; FaceIndex++ )
-	{
-		int		Sx = pSizesX[FaceIndex];
-		int		Sy = pSizesY[FaceIndex];
+//////////////////////////////////////////////////////////////////////////
+// Virtual API
+// Forwards to the templated build path with virtual mappers and writers
+//
+void	GeometryBuilder::BuildSphere( int _PhiSubdivisions, int _ThetaSubdivisions, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+{
+	int	VerticesCount, IndicesCount;
+	GetSphereSize( _PhiSubdivisions, _ThetaSubdivisions, VerticesCount, IndicesCount );
 
-		if ( FaceIndex > 0 )
-		{	// Write a first degenerate vertex for that face to make a clean junction with previous face...
- 			IWRITE( pIndex, FaceOffset+0 );
-		}
+	WriterLayout	Layout( _Writer, VerticesCount, IndicesCount );
+	GenerateSphere( _PhiSubdivisions, _ThetaSubdivisions, Layout, VirtualMapper( _pMapper ), TweakDelegate( _TweakVertex, _pUserData ) );
+	Layout.Finalize();
+}
 
-		for ( int j=0; j < Sy-1; j++ )
-		{
-			int	CurrentBandOffset = FaceOffset + j * Sx;
-			int	NextBandOffset = FaceOffset + (j+1) * Sx;
+void	GeometryBuilder::BuildCylinder( int _RadialSubdivisions, int _VerticalSubdivisions, bool _bIncludeCaps, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+{
+	int	VerticesCount, IndicesCount;
+	GetCylinderSize( _RadialSubdivisions, _VerticalSubdivisions, _bIncludeCaps, VerticesCount, IndicesCount );
 
-			for ( int i=0; i < Sx; i++ )
-			{
-				IWRITE( pIndex, CurrentBandOffset + i );
-				IWRITE( pIndex, NextBandOffset + i );
-			}
+	WriterLayout	Layout( _Writer, VerticesCount, IndicesCount );
+	GenerateCylinder( _RadialSubdivisions, _VerticalSubdivisions, _bIncludeCaps, Layout, VirtualMapper( _pMapper ), TweakDelegate( _TweakVertex, _pUserData ) );
+	Layout.Finalize();
+}
 
-			if ( j == _SubdivisionsY-1 )
-				continue;	// Not for the last band...
+void	GeometryBuilder::BuildTorus( int _PhiSubdivisions, int _ThetaSubdivisions, float _LargeRadius, float _SmallRadius, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+{
+	int	VerticesCount, IndicesCount;
+	GetTorusSize( _PhiSubdivisions, _ThetaSubdivisions, VerticesCount, IndicesCount );
 
-			// Write 2 last degenerate indices so we smoothly transition to next band
-			IWRITE( pIndex, NextBandOffset+Sx-1 );
-			IWRITE( pIndex, NextBandOffset );
-		}
+	WriterLayout	Layout( _Writer, VerticesCount, IndicesCount );
+	GenerateTorus( _PhiSubdivisions, _ThetaSubdivisions, _LargeRadius, _SmallRadius, Layout, VirtualMapper( _pMapper ), TweakDelegate( _TweakVertex, _pUserData ) );
+	Layout.Finalize();
+}
 
-		FaceOffset += Sx*Sy;
+void	GeometryBuilder::BuildPlane( int _SubdivisionsX, int _SubdivisionsY, const float3& _X, const float3& _Y, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+{
+	int	VerticesCount, IndicesCount;
+	GetPlaneSize( _SubdivisionsX, _SubdivisionsY, VerticesCount, IndicesCount );
 
- 		if ( FaceIndex < 5 )
- 		{	// Write one last degenerate vertex for that face to make a clean junction with next face...
-			IWRITE( pIndex, FaceOffset-1 );
-		}
-	}
-	ASSERT( IndicesCount == 0, "Wrong contruction!" );
+	WriterLayout	Layout( _Writer, VerticesCount, IndicesCount );
+	GeneratePlane( _SubdivisionsX, _SubdivisionsY, _X, _Y, Layout, VirtualMapper( _pMapper ), TweakDelegate( _TweakVertex, _pUserData ) );
+	Layout.Finalize();
+}
+
+void	GeometryBuilder::BuildCube( int _SubdivisionsX, int _SubdivisionsY, int _SubdivisionsZ, IGeometryWriter& _Writer, const MapperBase* _pMapper, TweakVertexDelegate _TweakVertex, void* _pUserData )
+{
+	int	VerticesCount, IndicesCount;
+	GetCubeSize( _SubdivisionsX, _SubdivisionsY, _SubdivisionsZ, VerticesCount, IndicesCount );
 
-	//////////////////////////////////////////////////////////////////////////
-	// Finalize
-	_Writer.Finalize( pVerticesArray, pIndicesArray );
+	WriterLayout	Layout( _Writer, VerticesCount, IndicesCount );
+	GenerateCube( _SubdivisionsX, _SubdivisionsY, _SubdivisionsZ, Layout, VirtualMapper( _pMapper ), TweakDelegate( _TweakVertex, _pUserData ) );
+	Layout.Finalize();
 }
 
-void	GeometryBuilder::AppendVertex( IGeometryWriter& _Writer, void*& _pVertex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV, TweakVertexDelegate _TweakVertex, void* _pUserData )
+U32*	GeometryBuilder::OptimizeStrip( void* _pVertices, int& _VerticesCount, int _VertexSize, int _PositionOffset, const U32* _pIndices, int& _IndicesCount )
 {
-	if ( _TweakVertex == NULL )
-	{
-		_Writer.AppendVertex( _pVertex, _Position, _Normal, _Tangent, _BiTangent, _UV );
-		return;
-	}
+	U32*	pListIndices = new U32[3 * MAX( 1, _IndicesCount - 2 )];
+	_IndicesCount = BaseLib::ConvertStripToList( _pIndices, _IndicesCount, pListIndices );
+	_VerticesCount = BaseLib::OptimizeMesh( pListIndices, _IndicesCount, _pVertices, _VerticesCount, _VertexSize, _PositionOffset );
 
-	// Ask the user to tweak the vertices first !
-	float3	P = _Position;
-	float3	N = _Normal;
-	float3	T = _Tangent;
-	float3	B = _BiTangent;
-	float2	UV = _UV;
-	(*_TweakVertex)( P, N, T, B, UV, _pUserData );
-	_Writer.AppendVertex( _pVertex, P, N, T, B, UV );
+	return pListIndices;
 }
 
 
@@ -749,3 +315,159 @@ void	GeometryBuilder::MapperCube::Map( const float3& _Position, const float3& _N
 	_UV.x *= m_WrapU;
 	_UV.y *= m_WrapV;
 }
+
+
+#ifdef _DEBUG
+
+//////////////////////////////////////////////////////////////////////////
+// Check of the templated path against the virtual one
+//
+typedef VertexFormatP3N3G3B3T2	CheckVertex;	// Stores every vertex attribute so any difference is caught
+
+// Keeps the output of the BuildXXX() methods in memory
+class	CheckWriter : public GeometryBuilder::IGeometryWriter
+{
+public:
+	U8*		m_pVertices;
+	U32*	m_pIndices;
+	int		m_VerticesCount;
+	int		m_IndicesCount;
+
+public:
+	CheckWriter() : m_pVertices( NULL ), m_pIndices( NULL ), m_VerticesCount( 0 ), m_IndicesCount( 0 )	{}
+	~CheckWriter()	{ delete[] m_pVertices; delete[] m_pIndices; }
+
+	virtual void	CreateBuffers( int _VerticesCount, int _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, void*& _pVertices, void*& _pIndices )
+	{
+		m_VerticesCount = _VerticesCount;
+		m_IndicesCount = _IndicesCount;
+		_pVertices = new U8[_VerticesCount * sizeof(CheckVertex)];
+		_pIndices = new U32[_IndicesCount];
+	}
+	virtual void	AppendVertex( void*& _pVertex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV )
+	{
+		CheckVertex::DESCRIPTOR.Write( _pVertex, _Position, _Normal, _Tangent, _BiTangent, _UV );
+		_pVertex = (void*) ((U8*) _pVertex + sizeof(CheckVertex));
+	}
+	virtual void	AppendIndex( void*& _pIndex, int _Index )
+	{
+		*((U32*) _pIndex) = _Index;
+		_pIndex = (void*) ((U32*) _pIndex + 1);
+	}
+	virtual void	Finalize( void* _pVertices, void* _pIndices )
+	{
+		m_pVertices = (U8*) _pVertices;
+		m_pIndices = (U32*) _pIndices;
+	}
+};
+
+// Receives both paths, the GenerateXXX() one through m_Layout and the BuildXXX() one through m_Writer
+class	CheckBuffers
+{
+public:
+	CheckWriter							m_Writer;
+	CheckVertex*						m_pVertices;
+	U32*								m_pIndices;
+	int									m_VerticesCount;
+	int									m_IndicesCount;
+	GeometryBuilder::LayoutInterleaved<CheckVertex>	m_Layout;
+
+public:
+	CheckBuffers( int _VerticesCount, int _IndicesCount )
+		: m_pVertices( new CheckVertex[_VerticesCount] )
+		, m_pIndices( new U32[_IndicesCount] )
+		, m_VerticesCount( _VerticesCount )
+		, m_IndicesCount( _IndicesCount )
+		, m_Layout( m_pVertices, m_pIndices )	{}
+	~CheckBuffers()	{ delete[] m_pVertices; delete[] m_pIndices; }
+
+	bool	AreIdentical() const
+	{
+		return	m_Writer.m_VerticesCount == m_VerticesCount && m_Writer.m_IndicesCount == m_IndicesCount
+			&&	memcmp( m_Writer.m_pVertices, m_pVertices, m_VerticesCount * sizeof(CheckVertex) ) == 0
+			&&	memcmp( m_Writer.m_pIndices, m_pIndices, m_IndicesCount * sizeof(U32) ) == 0;
+	}
+};
+
+// Same tweak given as a functor to GenerateXXX() and as a delegate to BuildXXX()
+class	CheckTweak
+{
+public:
+	void	operator()( float3& _Position, float3& _Normal, float3& _Tangent, const float3& _BiTangent, float2& _UV ) const
+	{
+		_Position = _Position + (0.1f * sinf( 8.0f * _UV.x )) * _Normal;
+		_UV.y += 0.25f * _Position.y;
+	}
+};
+static void	CheckTweakDelegate( float3& _Position, float3& _Normal, float3& _Tangent, const float3& _BiTangent, float2& _UV, void* _pUserData )
+{
+	CheckTweak()( _Position, _Normal, _Tangent, _BiTangent, _UV );
+}
+
+// All primitives are large enough for GenerateXXX() to generate their bands in parallel
+bool	GeometryBuilder::CheckGeneratePath( double& _BuildTime, double& _GenerateTime )
+{
+	_BuildTime = 0.0;
+	_GenerateTime = 0.0;
+
+	double	Time;
+	int		VerticesCount, IndicesCount;
+
+	// Sphere with a spherical mapping
+	{
+		MapperSpherical	Mapper;
+		GetSphereSize( 256, 128, VerticesCount, IndicesCount );
+		CheckBuffers	Buffers( VerticesCount, IndicesCount );
+		{ TimeProfile	Profile( Time ); BuildSphere( 256, 128, Buffers.m_Writer, &Mapper ); }			_BuildTime += Time;
+		{ TimeProfile	Profile( Time ); GenerateSphere( 256, 128, Buffers.m_Layout, Mapper, NoTweak() ); }	_GenerateTime += Time;
+		if ( !Buffers.AreIdentical() )
+			return false;
+	}
+
+	// Capped cylinder with a cylindrical mapping and a tweak
+	{
+		MapperCylindrical	Mapper;
+		GetCylinderSize( 256, 128, true, VerticesCount, IndicesCount );
+		CheckBuffers	Buffers( VerticesCount, IndicesCount );
+		{ TimeProfile	Profile( Time ); BuildCylinder( 256, 128, true, Buffers.m_Writer, &Mapper, CheckTweakDelegate ); }		_BuildTime += Time;
+		{ TimeProfile	Profile( Time ); GenerateCylinder( 256, 128, true, Buffers.m_Layout, Mapper, CheckTweak() ); }		_GenerateTime += Time;
+		if ( !Buffers.AreIdentical() )
+			return false;
+	}
+
+	// Torus with default UVs and a tweak
+	{
+		GetTorusSize( 256, 128, VerticesCount, IndicesCount );
+		CheckBuffers	Buffers( VerticesCount, IndicesCount );
+		{ TimeProfile	Profile( Time ); BuildTorus( 256, 128, 1.0f, 0.3f, Buffers.m_Writer, NULL, CheckTweakDelegate ); }	_BuildTime += Time;
+		{ TimeProfile	Profile( Time ); GenerateTorus( 256, 128, 1.0f, 0.3f, Buffers.m_Layout, NoMapper(), CheckTweak() ); }	_GenerateTime += Time;
+		if ( !Buffers.AreIdentical() )
+			return false;
+	}
+
+	// Plane with a planar mapping
+	{
+		MapperPlanar	Mapper;
+		GetPlaneSize( 200, 200, VerticesCount, IndicesCount );
+		CheckBuffers	Buffers( VerticesCount, IndicesCount );
+		{ TimeProfile	Profile( Time ); BuildPlane( 200, 200, float3::UnitX, -float3::UnitZ, Buffers.m_Writer, &Mapper ); }				_BuildTime += Time;
+		{ TimeProfile	Profile( Time ); GeneratePlane( 200, 200, float3::UnitX, -float3::UnitZ, Buffers.m_Layout, Mapper, NoTweak() ); }	_GenerateTime += Time;
+		if ( !Buffers.AreIdentical() )
+			return false;
+	}
+
+	// Cube with different subdivisions on each axis and a cube mapping
+	{
+		MapperCube	Mapper;
+		GetCubeSize( 96, 64, 32, VerticesCount, IndicesCount );
+		CheckBuffers	Buffers( VerticesCount, IndicesCount );
+		{ TimeProfile	Profile( Time ); BuildCube( 96, 64, 32, Buffers.m_Writer, &Mapper ); }				_BuildTime += Time;
+		{ TimeProfile	Profile( Time ); GenerateCube( 96, 64, 32, Buffers.m_Layout, Mapper, NoTweak() ); }	_GenerateTime += Time;
+		if ( !Buffers.AreIdentical() )
+			return false;
+	}
+
+	return true;
+}
+
+#endif
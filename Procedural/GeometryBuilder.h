@@ -3,10 +3,14 @@
 //
 #pragma once
 
+#include "../BaseLib/Utility/Parallel.h"
+
 class	GeometryBuilder
 {
 protected:	// CONSTANTS
 
+	static const int	PARALLEL_VERTICES_THRESHOLD = 16384;	// Below this amount of vertices, the bands are generated on the calling thread only
+
 public:		// NESTED TYPES
 
 	class	MapperBase
@@ -83,6 +87,110 @@ public:		// NESTED TYPES
 
 	typedef void	(*TweakVertexDelegate)( float3& _Position, float3& _Normal, float3& _Tangent, const float3& _BiTangent, float2& _UV, void* _pUserData );
 
+	//////////////////////////////////////////////////////////////////////////
+	// Types used by the templated GenerateXXX() methods
+	//
+	// A LAYOUT receives the vertices and indices in pre-sized buffers and must implement:
+	//	static const bool	IS_THREAD_SAFE;	// True if WriteVertex() can be called concurrently for different vertices (the bands are then generated in parallel)
+	//	void	WriteVertex( int _VertexIndex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV );
+	//	void	WriteIndex( int _Index, int _VertexIndex );
+	//
+	// A MAPPER is any class with the same Map() method as MapperBase, its Map() is called non-virtually (e.g. MapperSpherical), or NoMapper to use the default UVs of the primitive
+	//
+	// A TWEAK is any class implementing the following method (thread-safe if the layout is), or NoTweak:
+	//	void	operator()( float3& _Position, float3& _Normal, float3& _Tangent, const float3& _BiTangent, float2& _UV ) const;
+	//
+
+	// Uses the default UVs of the primitive
+	class	NoMapper {};
+
+	// Leaves the vertices untouched
+	class	NoTweak
+	{
+	public:
+		void	operator()( float3& _Position, float3& _Normal, float3& _Tangent, const float3& _BiTangent, float2& _UV ) const	{}
+	};
+
+	// Writes the vertices into separate arrays (any of them can be NULL if not needed) and the indices into a U32 array
+	class	LayoutSoA
+	{
+	public:
+		static const bool	IS_THREAD_SAFE = true;
+
+		float3*	m_pPositions;
+		float3*	m_pNormals;
+		float3*	m_pTangents;
+		float3*	m_pBiTangents;
+		float2*	m_pUVs;
+		U32*	m_pIndices;
+
+	public:
+		LayoutSoA( float3* _pPositions, float3* _pNormals, float3* _pTangents, float3* _pBiTangents, float2* _pUVs, U32* _pIndices )
+			: m_pPositions( _pPositions ), m_pNormals( _pNormals ), m_pTangents( _pTangents ), m_pBiTangents( _pBiTangents ), m_pUVs( _pUVs ), m_pIndices( _pIndices )	{}
+
+		void	WriteVertex( int _VertexIndex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV )
+		{
+			if ( m_pPositions )		m_pPositions[_VertexIndex] = _Position;
+			if ( m_pNormals )		m_pNormals[_VertexIndex] = _Normal;
+			if ( m_pTangents )		m_pTangents[_VertexIndex] = _Tangent;
+			if ( m_pBiTangents )	m_pBiTangents[_VertexIndex] = _BiTangent;
+			if ( m_pUVs )			m_pUVs[_VertexIndex] = _UV;
+		}
+		void	WriteIndex( int _Index, int _VertexIndex )	{ m_pIndices[_Index] = _VertexIndex; }
+	};
+
+	// Writes the vertices into an array of VERTEX, one of the VertexFormatXXX structures of the renderer, and the indices into a U32 array
+	template< typename VERTEX > class	LayoutInterleaved
+	{
+	public:
+		static const bool	IS_THREAD_SAFE = true;
+
+		VERTEX*	m_pVertices;
+		U32*	m_pIndices;
+
+	public:
+		LayoutInterleaved( VERTEX* _pVertices, U32* _pIndices ) : m_pVertices( _pVertices ), m_pIndices( _pIndices )	{}
+
+		void	WriteVertex( int _VertexIndex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV )
+		{
+			VERTEX::DESCRIPTOR.VERTEX::Desc::Write( m_pVertices + _VertexIndex, _Position, _Normal, _Tangent, _BiTangent, _UV );
+		}
+		void	WriteIndex( int _Index, int _VertexIndex )	{ m_pIndices[_Index] = _VertexIndex; }
+	};
+
+private:	// NESTED TYPES
+
+	// Adapters used by the BuildXXX() methods to forward the virtual API to the templated one
+	class	VirtualMapper
+	{
+	public:
+		const MapperBase*	m_pMapper;
+		VirtualMapper( const MapperBase* _pMapper ) : m_pMapper( _pMapper )	{}
+	};
+
+	class	TweakDelegate
+	{
+	public:
+		TweakVertexDelegate	m_pTweak;
+		void*				m_pUserData;
+		TweakDelegate( TweakVertexDelegate _pTweak, void* _pUserData ) : m_pTweak( _pTweak ), m_pUserData( _pUserData )	{}
+
+		void	operator()( float3& _Position, float3& _Normal, float3& _Tangent, const float3& _BiTangent, float2& _UV ) const
+		{
+			if ( m_pTweak != NULL )
+				(*m_pTweak)( _Position, _Normal, _Tangent, _BiTangent, _UV, m_pUserData );
+		}
+	};
+
+	class	WriterLayout;
+
+	// Generate the vertices of a single band
+	template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	SphereBandJob;
+	template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	CylinderBandJob;
+	template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	TorusBandJob;
+	template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	PlaneBandJob;
+	template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	CubeBandJob;
+
 public:		// METHODS
 
 	// Builds a uniformly subdivided sphere of radius 1 centered in 0
@@ -100,7 +208,58 @@ public:		// METHODS
 	// Builds a subdivided cube centered in 0 of size 2 (extents go from (-1,-1,-1) to (+1,+1,+1))
 	static void		BuildCube( int _SubdivisionsX, int _SubdivisionsY, int _SubdivisionsZ, IGeometryWriter& _Writer, const MapperBase* _pMapper=NULL, TweakVertexDelegate _TweakVertex=NULL, void* _pUserData=NULL );
 
+	// Converts the triangle strip given to IGeometryWriter::Finalize() into a triangle list reordered for the vertex cache, overdraw and vertex fetch (cf. BaseLib/Utility/MeshOptimizer.h)
+	// Writers can call it to store optimized static geometry: the vertices are reordered in place and the position must be 3 floats at offset _PositionOffset in the vertex
+	// Returns the new index buffer that the caller must delete[], _VerticesCount and _IndicesCount are updated
+	static U32*		OptimizeStrip( void* _pVertices, int& _VerticesCount, int _VertexSize, int _PositionOffset, const U32* _pIndices, int& _IndicesCount );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Templated build path
+	// Same primitives as the BuildXXX() methods, written as a triangle strip directly into the buffers of the layout
+	//	that must be sized with GetXXXSize() beforehand. The mapper, tweak and layout calls are resolved at compile time.
+	//
+	static void		GetSphereSize( int _PhiSubdivisions, int _ThetaSubdivisions, int& _VerticesCount, int& _IndicesCount );
+	static void		GetCylinderSize( int _RadialSubdivisions, int _VerticalSubdivisions, bool _bIncludeCaps, int& _VerticesCount, int& _IndicesCount );
+	static void		GetTorusSize( int _PhiSubdivisions, int _ThetaSubdivisions, int& _VerticesCount, int& _IndicesCount );
+	static void		GetPlaneSize( int _SubdivisionsX, int _SubdivisionsY, int& _VerticesCount, int& _IndicesCount );
+	static void		GetCubeSize( int _SubdivisionsX, int _SubdivisionsY, int _SubdivisionsZ, int& _VerticesCount, int& _IndicesCount );
+
+	template< typename LAYOUT, typename MAPPER, typename TWEAK >
+	static void		GenerateSphere( int _PhiSubdivisions, int _ThetaSubdivisions, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak );
+	template< typename LAYOUT, typename MAPPER, typename TWEAK >
+	static void		GenerateCylinder( int _RadialSubdivisions, int _VerticalSubdivisions, bool _bIncludeCaps, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak );
+	template< typename LAYOUT, typename MAPPER, typename TWEAK >
+	static void		GenerateTorus( int _PhiSubdivisions, int _ThetaSubdivisions, float _LargeRadius, float _SmallRadius, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak );
+	template< typename LAYOUT, typename MAPPER, typename TWEAK >
+	static void		GeneratePlane( int _SubdivisionsX, int _SubdivisionsY, const float3& _X, const float3& _Y, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak );
+	template< typename LAYOUT, typename MAPPER, typename TWEAK >
+	static void		GenerateCube( int _SubdivisionsX, int _SubdivisionsY, int _SubdivisionsZ, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak );
+
+#ifdef _DEBUG
+	// Builds dense primitives with both BuildXXX() and GenerateXXX() into a LayoutInterleaved and returns false if their vertices or indices differ by a single byte
+	//	_BuildTime, _GenerateTime, the total time spent in each path (in milliseconds)
+	static bool		CheckGeneratePath( double& _BuildTime, double& _GenerateTime );
+#endif
+
 private:
 
-	static void		AppendVertex( IGeometryWriter& _Writer, void*& _pVertex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV, TweakVertexDelegate _TweakVertex=NULL, void* _pUserData=NULL );
+	// Computes the UVs with the mapper, returns false to use the default UVs of the primitive
+	template< typename MAPPER >
+	static bool		MapUV( const MAPPER& _Mapper, const float3& _Position, const float3& _Normal, const float3& _Tangent, float2& _UV, bool _bIsBandEndVertex )	{ _Mapper.MAPPER::Map( _Position, _Normal, _Tangent, _UV, _bIsBandEndVertex ); return true; }
+	static bool		MapUV( const NoMapper& _Mapper, const float3& _Position, const float3& _Normal, const float3& _Tangent, float2& _UV, bool _bIsBandEndVertex )		{ return false; }
+	static bool		MapUV( const VirtualMapper& _Mapper, const float3& _Position, const float3& _Normal, const float3& _Tangent, float2& _UV, bool _bIsBandEndVertex )	{ if ( _Mapper.m_pMapper == NULL ) return false; _Mapper.m_pMapper->Map( _Position, _Normal, _Tangent, _UV, _bIsBandEndVertex ); return true; }
+
+	// Tweaks a copy of the vertex and writes it
+	template< typename LAYOUT, typename TWEAK >
+	static void		WriteVertex( LAYOUT& _Layout, const TWEAK& _Tweak, int _VertexIndex, float3 _Position, float3 _Normal, float3 _Tangent, const float3& _BiTangent, float2 _UV )
+	{
+		_Tweak( _Position, _Normal, _Tangent, _BiTangent, _UV );
+		_Layout.WriteVertex( _VertexIndex, _Position, _Normal, _Tangent, _BiTangent, _UV );
+	}
+
+	// Runs the job for all the bands, in parallel if the layout allows it and there are enough vertices
+	template< typename LAYOUT, typename JOB >
+	static void		GenerateBands( JOB& _Job, int _BandsCount, int _VerticesCount );
 };
+
+#include "GeometryBuilder.inl"
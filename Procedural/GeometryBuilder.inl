@@ -0,0 +1,604 @@
+//////////////////////////////////////////////////////////////////////////
+// Band jobs
+// Each band is a row of vertices written at a known offset, so bands can be generated concurrently
+//
+template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	GeometryBuilder::SphereBandJob
+{
+	LAYOUT*			pLayout;
+	const MAPPER*	pMapper;
+	const TWEAK*	pTweak;
+	int				BandLength;
+	int				ThetaSubdivisions;
+
+	void	operator()( U32 _BandIndex )
+	{
+		int		VertexIndex = _BandIndex * (BandLength+1);
+
+		float3	Position, Normal, Tangent, BiTangent;
+		float2	UV;
+
+		if ( _BandIndex == 0 )
+		{	// Top band
+			for ( int i=0; i <= BandLength; i++ )
+			{
+				float	Phi = TWOPI * i / BandLength;
+				Tangent.x = cosf( Phi );
+				Tangent.y = 0.0f;
+				Tangent.z = -sinf( Phi );
+
+				// Create a dummy position that is slightly offseted from the top of the sphere so UVs are not all identical
+				Position.y = 1.0f;
+				Position.x = -0.001f * Tangent.z;
+				Position.z = 0.001f * Tangent.x;
+				Normal = Position;	Normal.Normalize();
+
+				BiTangent = Normal.Cross( Tangent );
+
+				// Ask for UVs
+				if ( !MapUV( *pMapper, Position, Normal, Tangent, UV, i == BandLength ) )
+					UV.Set( 2.0f * float(i) / BandLength, 0.0f );
+
+				WriteVertex( *pLayout, *pTweak, VertexIndex++, float3::UnitY, float3::UnitY, Tangent, BiTangent, UV );
+			}
+		}
+		else if ( int(_BandIndex) == 1 + ThetaSubdivisions )
+		{	// Bottom band
+			for ( int i=0; i <= BandLength; i++ )
+			{
+				float	Phi = TWOPI * i / BandLength;
+				Tangent.x = cosf( Phi );
+				Tangent.y = 0.0f;
+				Tangent.z = -sinf( Phi );
+
+				// Create a dummy position that is slightly offseted from the bottom of the sphere so UVs are not all identical
+				Position.y = -1.0f;
+				Position.x = -0.001f * Tangent.z;
+				Position.z = 0.001f * Tangent.x;
+				Normal = Position;	Normal.Normalize();
+
+				BiTangent = Normal.Cross( Tangent );
+
+				// Ask for UVs
+				if ( !MapUV( *pMapper, Position, Normal, Tangent, UV, i == BandLength ) )
+					UV.Set( 2.0f * float(i) / BandLength, 1.0f );
+
+				WriteVertex( *pLayout, *pTweak, VertexIndex++, -float3::UnitY, -float3::UnitY, Tangent, BiTangent, UV );
+			}
+		}
+		else
+		{	// Generic band
+			int		j = _BandIndex - 1;
+			float	Theta = PI * (1+j) / (1 + ThetaSubdivisions);
+			for ( int i=0; i <= BandLength; i++ )
+			{
+				float	Phi = TWOPI * i / BandLength;
+
+				Position.x = sinf( Phi ) * sinf( Theta );
+				Position.y = cosf( Theta );
+				Position.z = cosf( Phi ) * sinf( Theta );
+
+				Normal = Position;
+
+				Tangent.x = cosf( Phi );
+				Tangent.y = 0.0f;
+				Tangent.z = -sinf( Phi );
+
+				BiTangent = Normal.Cross( Tangent );
+
+				// Ask for UVs
+				if ( !MapUV( *pMapper, Position, Normal, Tangent, UV, i == BandLength ) )
+					UV.Set( 2.0f * float(i) / BandLength, float(j) / ThetaSubdivisions );
+
+				WriteVertex( *pLayout, *pTweak, VertexIndex++, Position, Normal, Tangent, BiTangent, UV );
+			}
+		}
+	}
+};
+
+template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	GeometryBuilder::CylinderBandJob
+{
+	LAYOUT*			pLayout;
+	const MAPPER*	pMapper;
+	const TWEAK*	pTweak;
+	int				RadialSubdivisions;
+	int				VerticalSubdivisions;
+	bool			bIncludeCaps;
+
+	void	operator()( U32 _BandIndex )
+	{
+		int		VertexIndex = _BandIndex * (RadialSubdivisions+1);
+		int		j = bIncludeCaps ? int(_BandIndex) - 1 : int(_BandIndex);
+
+		float3	Position, Normal, Tangent, BiTangent;
+		float2	UV;
+
+		if ( j < 0 )
+		{	// Top vertices
+			for ( int i=0; i <= RadialSubdivisions; i++ )
+			{
+				float	Phi = TWOPI * i / RadialSubdivisions;
+				Tangent.x = cosf( Phi );
+				Tangent.y = 0.0f;
+				Tangent.z = -sinf( Phi );
+
+				// Create a dummy position that is slightly offseted from the top of the sphere so UVs are not all identical
+				Position.y = 1.0f;
+				Position.x = -0.001f * Tangent.z;
+				Position.z = 0.001f * Tangent.x;
+				Normal = float3::UnitY;
+
+				BiTangent = Normal.Cross( Tangent );
+
+				// Ask for UVs
+				if ( !MapUV( *pMapper, Position, Normal, Tangent, UV, i == RadialSubdivisions ) )
+					UV.Set( 2.0f * float(i) / RadialSubdivisions, 0.0f );
+
+				WriteVertex( *pLayout, *pTweak, VertexIndex++, float3::UnitY, float3::UnitY, Tangent, BiTangent, UV );
+			}
+		}
+		else if ( j > VerticalSubdivisions )
+		{	// Bottom band
+			for ( int i=0; i <= RadialSubdivisions; i++ )
+			{
+				float	Phi = TWOPI * i / RadialSubdivisions;
+				Tangent.x = cosf( Phi );
+				Tangent.y = 0.0f;
+				Tangent.z = -sinf( Phi );
+
+				// Create a dummy position that is slightly offseted from the bottom of the sphere so UVs are not all identical
+				Position.y = -1.0f;
+				Position.x = -0.001f * Tangent.z;
+				Position.z = 0.001f * Tangent.x;
+				Normal = -float3::UnitY;
+
+				BiTangent = Normal.Cross( Tangent );
+
+				// Ask for UVs
+				if ( !MapUV( *pMapper, Position, Normal, Tangent, UV, i == RadialSubdivisions ) )
+					UV.Set( 2.0f * float(i) / RadialSubdivisions, 1.0f );
+
+				WriteVertex( *pLayout, *pTweak, VertexIndex++, -float3::UnitY, -float3::UnitY, Tangent, BiTangent, UV );
+			}
+		}
+		else
+		{	// Generic band
+			float	Y = 1.0f - 2.0f * j / VerticalSubdivisions;
+			for ( int i=0; i <= RadialSubdivisions; i++ )
+			{
+				float	Phi = TWOPI * i / RadialSubdivisions;
+
+				Position.x = sinf( Phi );
+				Position.y = Y;
+				Position.z = cosf( Phi );
+
+				Normal.x = sinf( Phi );
+				Normal.y = 0;
+				Normal.z = cosf( Phi );
+
+				Tangent.x = cosf( Phi );
+				Tangent.y = 0.0f;
+				Tangent.z = -sinf( Phi );
+
+				BiTangent = Normal.Cross( Tangent );
+
+				// Ask for UVs
+				if ( !MapUV( *pMapper, Position, Normal, Tangent, UV, i == RadialSubdivisions ) )
+					UV.Set( 2.0f * float(i) / RadialSubdivisions, float(j) / VerticalSubdivisions );
+
+				WriteVertex( *pLayout, *pTweak, VertexIndex++, Position, Normal, Tangent, BiTangent, UV );
+			}
+		}
+	}
+};
+
+template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	GeometryBuilder::TorusBandJob
+{
+	LAYOUT*			pLayout;
+	const MAPPER*	pMapper;
+	const TWEAK*	pTweak;
+	int				BandLength;
+	int				BandsCount;
+	float			LargeRadius;
+	float			SmallRadius;
+
+	void	operator()( U32 _BandIndex )
+	{
+		int		j = _BandIndex;
+		int		VertexIndex = j * (BandLength+1);
+
+		float3	Position, Normal, Tangent, BiTangent;
+		float2	UV;
+
+		float	Phi = TWOPI * j / BandsCount;
+
+		float3	X( cosf(Phi), sinf(Phi), 0.0f );	// Radial branch in X^Y plane at this angle
+		float3	Center = LargeRadius * X;			// Center of the small ring
+
+		Tangent.x = -sinf(Phi);
+		Tangent.y = cosf(Phi);
+		Tangent.z = 0.0f;
+
+		for ( int i=0; i <= BandLength; i++ )
+		{
+			float	Theta = TWOPI * i / BandLength;
+
+			Normal = cosf(Theta) * X + sinf(Theta) * float3::UnitZ;
+			Position = Center + SmallRadius * Normal;
+
+			BiTangent = Normal.Cross( Tangent );
+
+			if ( !MapUV( *pMapper, Position, Normal, Tangent, UV, i == BandLength ) )
+				UV.Set( 4.0f * float(j) / BandsCount, float(j) / BandLength );
+
+			WriteVertex( *pLayout, *pTweak, VertexIndex++, Position, Normal, Tangent, BiTangent, UV );
+		}
+	}
+};
+
+template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	GeometryBuilder::PlaneBandJob
+{
+	LAYOUT*			pLayout;
+	const MAPPER*	pMapper;
+	const TWEAK*	pTweak;
+	int				SubdivisionsX;
+	int				SubdivisionsY;
+	float3			AxisX;
+	float3			AxisY;
+	float3			Normal, Tangent, BiTangent;
+
+	void	operator()( U32 _BandIndex )
+	{
+		int		j = _BandIndex;
+		int		VertexIndex = j * (SubdivisionsX+1);
+
+		float3	Position;
+		float2	UV;
+
+		float	Y = 1.0f - 2.0f * j / SubdivisionsY;
+		for ( int i=0; i <= SubdivisionsX; i++ )
+		{
+			float	X = 2.0f * i / SubdivisionsX - 1.0f;
+
+			Position = X * AxisX + Y * AxisY;
+			if ( !MapUV( *pMapper, Position, Normal, Tangent, UV, false ) )
+				UV.Set( float(i) / SubdivisionsX, float(j) / SubdivisionsY );
+
+			WriteVertex( *pLayout, *pTweak, VertexIndex++, Position, Normal, Tangent, BiTangent, UV );
+		}
+	}
+};
+
+template< typename LAYOUT, typename MAPPER, typename TWEAK > struct	GeometryBuilder::CubeBandJob
+{
+	LAYOUT*			pLayout;
+	const MAPPER*	pMapper;
+	const TWEAK*	pTweak;
+	const float3*	pNormals;
+	const float3*	pTangents;
+	const int*		pSizesX;
+	const int*		pSizesY;
+
+	void	operator()( U32 _BandIndex )
+	{
+		// Find the face of the band
+		int		FaceIndex = 0;
+		int		VertexIndex = 0;
+		int		j = _BandIndex;
+		while ( j >= pSizesY[FaceIndex] )
+		{
+			j -= pSizesY[FaceIndex];
+			VertexIndex += pSizesX[FaceIndex] * pSizesY[FaceIndex];
+			FaceIndex++;
+		}
+
+		int		Sx = pSizesX[FaceIndex];
+		int		Sy = pSizesY[FaceIndex];
+		float3	Normal = pNormals[FaceIndex];
+		float3	X = pTangents[FaceIndex];
+		float3	Y = Normal.Cross( X );
+
+		VertexIndex += j * Sx;
+
+		float3	Position;
+		float2	UV;
+
+		float	y = 1.0f - 2.0f * float(j) / (Sy-1);
+		for ( int i=0; i < Sx; i++ )
+		{
+			float	x = 2.0f * float(i) / (Sx-1) - 1.0f;
+
+			Position = Normal + x * X + y * Y;
+
+			if ( !MapUV( *pMapper, Position, Normal, X, UV, false ) )
+				UV.Set( 0.5f * (1.0f + x), 0.5f * (1.0f + y) );
+
+			WriteVertex( *pLayout, *pTweak, VertexIndex++, Position, Normal, X, Y, UV );
+		}
+	}
+};
+
+template< typename LAYOUT, typename JOB >
+void	GeometryBuilder::GenerateBands( JOB& _Job, int _BandsCount, int _VerticesCount )
+{
+	if ( LAYOUT::IS_THREAD_SAFE && _BandsCount > 1 && _VerticesCount >= PARALLEL_VERTICES_THRESHOLD )
+	{
+		BaseLib::ParallelFor( U32(_BandsCount), _Job );
+		return;
+	}
+
+	for ( int BandIndex=0; BandIndex < _BandsCount; BandIndex++ )
+		_Job( BandIndex );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Primitives
+//
+template< typename LAYOUT, typename MAPPER, typename TWEAK >
+void	GeometryBuilder::GenerateSphere( int _PhiSubdivisions, int _ThetaSubdivisions, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak )
+{
+	int	VerticesCount, IndicesCount;
+	GetSphereSize( _PhiSubdivisions, _ThetaSubdivisions, VerticesCount, IndicesCount );
+
+	int	BandLength = _PhiSubdivisions;
+	int	BandsCount = 1 + _ThetaSubdivisions;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build vertices: 1 band at the top and bottom of the sphere + as many subdivisions as required
+	SphereBandJob<LAYOUT, MAPPER, TWEAK>	Job;
+	Job.pLayout = &_Layout;
+	Job.pMapper = &_Mapper;
+	Job.pTweak = &_Tweak;
+	Job.BandLength = BandLength;
+	Job.ThetaSubdivisions = _ThetaSubdivisions;
+	GenerateBands<LAYOUT>( Job, 1 + _ThetaSubdivisions + 1, VerticesCount );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build indices
+	int	Index = 0;
+	for ( int j=0; j < BandsCount; j++ )
+	{
+		int	CurrentBandOffset = j * (BandLength+1);
+		int	NextBandOffset = (j+1) * (BandLength+1);
+
+		for ( int i=0; i <= BandLength; i++ )
+		{
+			_Layout.WriteIndex( Index++, CurrentBandOffset + i );
+			_Layout.WriteIndex( Index++, NextBandOffset + i );
+		}
+
+		if ( j == BandsCount-1 )
+			continue;	// Not for the last band...
+
+		// Write 2 last degenerate indices so we smoothly transition to next band
+		_Layout.WriteIndex( Index++, NextBandOffset + BandLength );
+		_Layout.WriteIndex( Index++, NextBandOffset + BandLength+1 );
+	}
+	ASSERT( Index == IndicesCount, "Wrong contruction!" );
+}
+
+template< typename LAYOUT, typename MAPPER, typename TWEAK >
+void	GeometryBuilder::GenerateCylinder( int _RadialSubdivisions, int _VerticalSubdivisions, bool _bIncludeCaps, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak )
+{
+	ASSERT( _RadialSubdivisions > 1, "Can't create a cylinder with less than 2 radial subdivisions!" );
+	ASSERT( _VerticalSubdivisions > 0, "Can't create a cylinder with 0 vertical subdivisions!" );
+
+	int	VerticesCount, IndicesCount;
+	GetCylinderSize( _RadialSubdivisions, _VerticalSubdivisions, _bIncludeCaps, VerticesCount, IndicesCount );
+
+	int	BandLength = 1+_RadialSubdivisions;
+	int	BandsCount = _bIncludeCaps ? 1 + (1+_VerticalSubdivisions) + 1 : 1+_VerticalSubdivisions;	// 1 band at the top and bottom for the optional caps + as many subdivisions as required
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build vertices
+	CylinderBandJob<LAYOUT, MAPPER, TWEAK>	Job;
+	Job.pLayout = &_Layout;
+	Job.pMapper = &_Mapper;
+	Job.pTweak = &_Tweak;
+	Job.RadialSubdivisions = _RadialSubdivisions;
+	Job.VerticalSubdivisions = _VerticalSubdivisions;
+	Job.bIncludeCaps = _bIncludeCaps;
+	GenerateBands<LAYOUT>( Job, BandsCount, VerticesCount );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build indices
+	int	Index = 0;
+	for ( int j=0; j < BandsCount-1; j++ )
+	{
+		int	CurrentBandOffset = j * BandLength;
+		int	NextBandOffset = (j+1) * BandLength;
+
+		for ( int i=0; i < BandLength; i++ )
+		{
+			_Layout.WriteIndex( Index++, CurrentBandOffset + i );
+			_Layout.WriteIndex( Index++, NextBandOffset + i );
+		}
+
+		if ( j == BandsCount-2 )
+			continue;	// Not for the last band...
+
+		// Write 2 last degenerate indices so we smoothly transition to next band
+		_Layout.WriteIndex( Index++, NextBandOffset + BandLength-1 );
+		_Layout.WriteIndex( Index++, NextBandOffset + BandLength );
+	}
+	ASSERT( Index == IndicesCount, "Wrong contruction!" );
+}
+
+template< typename LAYOUT, typename MAPPER, typename TWEAK >
+void	GeometryBuilder::GenerateTorus( int _PhiSubdivisions, int _ThetaSubdivisions, float _LargeRadius, float _SmallRadius, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak )
+{
+	int	VerticesCount, IndicesCount;
+	GetTorusSize( _PhiSubdivisions, _ThetaSubdivisions, VerticesCount, IndicesCount );
+
+	int	BandLength = _ThetaSubdivisions;
+	int	BandsCount = _PhiSubdivisions;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build vertices
+	TorusBandJob<LAYOUT, MAPPER, TWEAK>	Job;
+	Job.pLayout = &_Layout;
+	Job.pMapper = &_Mapper;
+	Job.pTweak = &_Tweak;
+	Job.BandLength = BandLength;
+	Job.BandsCount = BandsCount;
+	Job.LargeRadius = _LargeRadius;
+	Job.SmallRadius = _SmallRadius;
+	GenerateBands<LAYOUT>( Job, BandsCount, VerticesCount );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build indices
+	int	Index = 0;
+	for ( int j=0; j < BandsCount; j++ )
+	{
+		int	CurrentBandOffset = j * (BandLength+1);
+		int	NextBandOffset = ((j+1) % _PhiSubdivisions) * (BandLength+1);
+		int	NextNextBandOffset = ((j+2) % _PhiSubdivisions) * (BandLength+1);
+
+		for ( int i=0; i <= BandLength; i++ )
+		{
+			_Layout.WriteIndex( Index++, CurrentBandOffset + i );
+			_Layout.WriteIndex( Index++, NextBandOffset + i );
+		}
+
+		if ( j == BandsCount-1 )
+			continue;	// Not for the last band...
+
+		// Write 2 last degenerate indices so we smoothly transition to next band
+		_Layout.WriteIndex( Index++, NextBandOffset + BandLength );
+		_Layout.WriteIndex( Index++, NextNextBandOffset );
+	}
+	ASSERT( Index == IndicesCount, "Wrong contruction!" );
+}
+
+template< typename LAYOUT, typename MAPPER, typename TWEAK >
+void	GeometryBuilder::GeneratePlane( int _SubdivisionsX, int _SubdivisionsY, const float3& _X, const float3& _Y, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak )
+{
+	ASSERT( _SubdivisionsX > 0 && _SubdivisionsY > 0, "Can't create a plane with 0 subdivision!" );
+
+	int	VerticesCount, IndicesCount;
+	GetPlaneSize( _SubdivisionsX, _SubdivisionsY, VerticesCount, IndicesCount );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build vertices
+	PlaneBandJob<LAYOUT, MAPPER, TWEAK>	Job;
+	Job.pLayout = &_Layout;
+	Job.pMapper = &_Mapper;
+	Job.pTweak = &_Tweak;
+	Job.SubdivisionsX = _SubdivisionsX;
+	Job.SubdivisionsY = _SubdivisionsY;
+	Job.AxisX = _X;
+	Job.AxisY = _Y;
+	Job.Tangent = _X;								Job.Tangent.Normalize();
+	Job.BiTangent = _Y;								Job.BiTangent.Normalize();
+	Job.Normal = Job.Tangent.Cross( Job.BiTangent );	Job.Normal.Normalize();
+	GenerateBands<LAYOUT>( Job, _SubdivisionsY+1, VerticesCount );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build indices
+	int	Index = 0;
+	for ( int j=0; j < _SubdivisionsY; j++ )
+	{
+		int	CurrentBandOffset = j * (_SubdivisionsX+1);
+		int	NextBandOffset = (j+1) * (_SubdivisionsX+1);
+
+		for ( int i=0; i <= _SubdivisionsX; i++ )
+		{
+			_Layout.WriteIndex( Index++, CurrentBandOffset + i );
+			_Layout.WriteIndex( Index++, NextBandOffset + i );
+		}
+
+		if ( j == _SubdivisionsY-1 )
+			continue;	// Not for the last band...
+
+		// Write 2 last degenerate indices so we smoothly transition to next band
+		_Layout.WriteIndex( Index++, NextBandOffset+_SubdivisionsX );
+		_Layout.WriteIndex( Index++, NextBandOffset );
+	}
+	ASSERT( Index == IndicesCount, "Wrong contruction!" );
+}
+
+template< typename LAYOUT, typename MAPPER, typename TWEAK >
+void	GeometryBuilder::GenerateCube( int _SubdivisionsX, int _SubdivisionsY, int _SubdivisionsZ, LAYOUT& _Layout, const MAPPER& _Mapper, const TWEAK& _Tweak )
+{
+	ASSERT( _SubdivisionsX > 0 && _SubdivisionsY > 0 && _SubdivisionsZ > 0, "Can't create a cube with 0 subdivision!" );
+
+	int	VerticesCount, IndicesCount;
+	GetCubeSize( _SubdivisionsX, _SubdivisionsY, _SubdivisionsZ, VerticesCount, IndicesCount );
+
+	int	SizeX = _SubdivisionsX+1;
+	int	SizeY = _SubdivisionsY+1;
+	int	SizeZ = _SubdivisionsZ+1;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build vertices
+	float3	pNormals[6] = {
+		-float3::UnitX,
+		 float3::UnitX,
+		-float3::UnitY,
+		 float3::UnitY,
+		-float3::UnitZ,
+		 float3::UnitZ,
+	};
+	float3	pTangents[6] = {
+		 float3::UnitZ,
+		-float3::UnitZ,
+		 float3::UnitX,
+		 float3::UnitX,
+		-float3::UnitX,
+		 float3::UnitX,
+	};
+
+	int			pSizesX[6] = { SizeZ, SizeZ, SizeX, SizeX, SizeX, SizeX };
+	int			pSizesY[6] = { SizeY, SizeY, SizeZ, SizeZ, SizeY, SizeY };
+
+	CubeBandJob<LAYOUT, MAPPER, TWEAK>	Job;
+	Job.pLayout = &_Layout;
+	Job.pMapper = &_Mapper;
+	Job.pTweak = &_Tweak;
+	Job.pNormals = pNormals;
+	Job.pTangents = pTangents;
+	Job.pSizesX = pSizesX;
+	Job.pSizesY = pSizesY;
+	GenerateBands<LAYOUT>( Job, 2*(SizeY + SizeZ + SizeY), VerticesCount );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build indices
+	int		Index = 0;
+	int		FaceOffset = 0;
+	for ( int FaceIndex=0; FaceIndex < 6; FaceIndex++ )
+	{
+		int		Sx = pSizesX[FaceIndex];
+		int		Sy = pSizesY[FaceIndex];
+
+		if ( FaceIndex > 0 )
+		{	// Write a first degenerate vertex for that face to make a clean junction with previous face...
+ 			_Layout.WriteIndex( Index++, FaceOffset+0 );
+		}
+
+		for ( int j=0; j < Sy-1; j++ )
+		{
+			int	CurrentBandOffset = FaceOffset + j * Sx;
+			int	NextBandOffset = FaceOffset + (j+1) * Sx;
+
+			for ( int i=0; i < Sx; i++ )
+			{
+				_Layout.WriteIndex( Index++, CurrentBandOffset + i );
+				_Layout.WriteIndex( Index++, NextBandOffset + i );
+			}
+
+			if ( j == Sy-2 )
+				continue;	// Not for the last band...
+
+			// Write 2 last degenerate indices so we smoothly transition to next band
+			_Layout.WriteIndex( Index++, NextBandOffset+Sx-1 );
+			_Layout.WriteIndex( Index++, NextBandOffset );
+		}
+
+		FaceOffset += Sx*Sy;
+
+ 		if ( FaceIndex < 5 )
+ 		{	// Write one last degenerate vertex for that face to make a clean junction with next face...
+			_Layout.WriteIndex( Index++, FaceOffset-1 );
+		}
+	}
+	ASSERT( Index == IndicesCount, "Wrong contruction!" );
+}
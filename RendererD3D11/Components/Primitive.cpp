@@ -9,28 +9,36 @@ Primitive::Primitive( Device& _device, U32 _verticesCount, const void* _vertices
 	, m_topology( _topology )
 	, m_VB( NULL )
 	, m_IB( NULL )
+	, m_LODsCount( 0 )
 	, m_boundVertexStreamsCount( 0 )
 	, m_cachedVB_SRV( NULL )
 	, m_cachedVB_UAV( NULL )
 	, m_cachedIB_SRV( NULL )
 	, m_cachedIB_UAV( NULL )
+#ifdef SUPPORT_GEO_BUILDERS
+	, m_optimizeGeometry( false )
+#endif
 {
 	m_stride = _format.Size();
 	Build( _vertices, _indices, false, _allowSRV, _allowUAV, _makeStructuredBuffer );
 }
 
-Primitive::Primitive( Device& _device, const IVertexFormatDescriptor& _format ) : Component( _device )
+Primitive::Primitive( Device& _device, const IVertexFormatDescriptor& _format, bool _optimizeGeometry ) : Component( _device )
 	, m_format( _format )
 	, m_verticesCount( 0 )
 	, m_indicesCount( 0 )
 	, m_topology( D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED )
 	, m_VB( NULL )
 	, m_IB( NULL )
+	, m_LODsCount( 0 )
 	, m_boundVertexStreamsCount( 0 )
 	, m_cachedVB_SRV( NULL )
 	, m_cachedVB_UAV( NULL )
 	, m_cachedIB_SRV( NULL )
 	, m_cachedIB_UAV( NULL )
+#ifdef SUPPORT_GEO_BUILDERS
+	, m_optimizeGeometry( _optimizeGeometry )
+#endif
 {
 	m_stride = _format.Size();
 	// Deferred construction...
@@ -43,16 +51,58 @@ Primitive::Primitive( Device& _device, U32 _verticesCount, U32 _indicesCount, D3
 	, m_topology( _topology )
 	, m_VB( NULL )
 	, m_IB( NULL )
+	, m_LODsCount( 0 )
 	, m_boundVertexStreamsCount( 0 )
 	, m_cachedVB_SRV( NULL )
 	, m_cachedVB_UAV( NULL )
 	, m_cachedIB_SRV( NULL )
 	, m_cachedIB_UAV( NULL )
+#ifdef SUPPORT_GEO_BUILDERS
+	, m_optimizeGeometry( false )
+#endif
 {
 	m_stride = _format.Size();
 	Build( NULL, NULL, true, _allowSRV, _allowUAV, _makeStructuredBuffer );
 }
 
+Primitive::Primitive( Device& _device, U32 _verticesCount, const void* _vertices, U32 _indicesCount, const U32* _indices, U32 _LODsCount, const U32* const* _ppLODIndices, const U32* _pLODIndicesCounts, const IVertexFormatDescriptor& _format ) : Component( _device )
+	, m_verticesCount( _verticesCount )
+	, m_indicesCount( _indicesCount )
+	, m_format( _format )
+	, m_topology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST )
+	, m_VB( NULL )
+	, m_IB( NULL )
+	, m_LODsCount( _LODsCount )
+	, m_boundVertexStreamsCount( 0 )
+	, m_cachedVB_SRV( NULL )
+	, m_cachedVB_UAV( NULL )
+	, m_cachedIB_SRV( NULL )
+	, m_cachedIB_UAV( NULL )
+#ifdef SUPPORT_GEO_BUILDERS
+	, m_optimizeGeometry( false )
+#endif
+{
+	ASSERT( _LODsCount <= MAX_LODS, "Too many LODs!" );
+	m_stride = _format.Size();
+
+	// Append the LOD indices after the full detail indices
+	U32	totalIndicesCount = m_indicesCount;
+	for ( U32 LODIndex=0; LODIndex < m_LODsCount; LODIndex++ ) {
+		m_LODStartIndices[LODIndex] = totalIndicesCount;
+		m_LODIndicesCounts[LODIndex] = _pLODIndicesCounts[LODIndex];
+		totalIndicesCount += _pLODIndicesCounts[LODIndex];
+	}
+
+	U32*	indices = new U32[totalIndicesCount];
+	memcpy( indices, _indices, m_indicesCount*sizeof(U32) );
+	for ( U32 LODIndex=0; LODIndex < m_LODsCount; LODIndex++ )
+		memcpy( indices + m_LODStartIndices[LODIndex], _ppLODIndices[LODIndex], m_LODIndicesCounts[LODIndex]*sizeof(U32) );
+
+	Build( _vertices, indices, false, false, false, false );
+
+	delete[] indices;
+}
+
 Primitive::~Primitive() {
 	ASSERT( m_VB != NULL, "Invalid vertex buffer to destroy !" );
 
@@ -96,6 +146,16 @@ void	Primitive::Render( Shader& _material, int _startVertex, int _verticesCount,
 	}
 }
 
+void	Primitive::RenderLOD( Shader& _material, U32 _LOD ) {
+	if ( _LOD == 0 ) {
+		Render( _material );
+		return;
+	}
+
+	ASSERT( _LOD <= m_LODsCount, "LOD index out of range!" );
+	Render( _material, 0, m_verticesCount, m_LODStartIndices[_LOD-1], m_LODIndicesCounts[_LOD-1], 0 );
+}
+
 void	Primitive::RenderInstanced( Shader& _material, U32 _instancesCount ) {
 	RenderInstanced( _material, _instancesCount, 0, m_verticesCount, 0, m_indicesCount, 0 );
 }
@@ -165,9 +225,13 @@ void	Primitive::Build( const void* _vertices, const U32* _indices, bool _dynamic
 
 	if ( _indices != NULL ) {
 		// Create the index buffer
+		U32	totalIndicesCount = m_indicesCount;
+		for ( U32 LODIndex=0; LODIndex < m_LODsCount; LODIndex++ )
+			totalIndicesCount += m_LODIndicesCounts[LODIndex];
+
 		D3D11_BUFFER_DESC   desc;
 //		desc.ByteWidth = m_IndicesCount * sizeof(U16);		 // For now, we only support U16 primitives
-		desc.ByteWidth = m_indicesCount * sizeof(U32);
+		desc.ByteWidth = totalIndicesCount * sizeof(U32);
 		desc.Usage = _dynamic ? D3D11_USAGE_DYNAMIC : (_allowUAV ? D3D11_USAGE_DEFAULT : D3D11_USAGE_IMMUTABLE);
 		desc.BindFlags = D3D11_BIND_INDEX_BUFFER | (_allowSRV ? D3D11_BIND_SHADER_RESOURCE : 0) | (_allowUAV ? D3D11_BIND_UNORDERED_ACCESS : 0);
 		desc.CPUAccessFlags = _dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
@@ -324,6 +388,18 @@ void	Primitive::AppendIndex( void*& _pIndex, int _Index ) {
 }
 
 void	Primitive::Finalize( void* _vertices, void* _indices ) {
+	if ( m_optimizeGeometry && m_topology == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP ) {
+		int	verticesCount = m_verticesCount;
+		int	indicesCount = m_indicesCount;
+		U32*	listIndices = GeometryBuilder::OptimizeStrip( _vertices, verticesCount, m_stride, 0, (U32*) _indices, indicesCount );
+		delete[] (U32*) _indices;
+		_indices = listIndices;
+
+		m_verticesCount = verticesCount;
+		m_indicesCount = indicesCount;
+		m_topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	}
+
 	Build( _vertices, (U32*) _indices, false );
 
 	delete[] _vertices;
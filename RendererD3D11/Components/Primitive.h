@@ -19,6 +19,12 @@ private:	// NESTED TYPES
 
 	static const int		MAX_BOUND_VERTEX_STREAMS = 8;
 
+public:
+
+	static const int		MAX_LODS = 8;
+
+private:
+
 private:	// FIELDS
 
 	const IVertexFormatDescriptor&	m_format;
@@ -31,6 +37,11 @@ private:	// FIELDS
 	U32								m_facesCount;
 	U32								m_stride;
 
+	// Levels of detail, stored as index ranges following the full detail indices in the same index buffer
+	U32								m_LODsCount;
+	U32								m_LODStartIndices[MAX_LODS];
+	U32								m_LODIndicesCounts[MAX_LODS];
+
 	// Render parameters
 	U32								m_boundVertexStreamsCount;
 	U32								m_strides[MAX_BOUND_VERTEX_STREAMS];
@@ -47,22 +58,30 @@ private:	// FIELDS
 	mutable ID3D11ShaderResourceView*	m_cachedIB_SRV;
 	mutable ID3D11UnorderedAccessView*	m_cachedIB_UAV;
 
+#ifdef SUPPORT_GEO_BUILDERS
+	bool							m_optimizeGeometry;	// If true, the triangle strips given by geometry builders are turned into optimized triangle lists
+#endif
+
 public:	 // PROPERTIES
 
 	U32				GetVerticesCount() const	{ return m_verticesCount; }
 	U32				GetIndicesCount() const		{ return m_indicesCount; }
 	U32				GetFacesCount() const		{ return m_facesCount; }
+	U32				GetLODsCount() const		{ return m_LODsCount; }
+	U32				GetLODFacesCount( U32 _LOD ) const	{ return _LOD == 0 ? m_facesCount : m_LODIndicesCounts[_LOD-1] / 3; }
 
 public:	 // METHODS
 
 	// _allowSRV, _allowUAV, if true then the bind flags allow the VB and IB to be used as SRV or UAV by a compute shader (see VBSetCS and IBSetCS)
 	Primitive( Device& _device, U32 _verticesCount, const void* _vertices, U32 _indicesCount, const U32* _indices, D3D11_PRIMITIVE_TOPOLOGY _topology, const IVertexFormatDescriptor& _format, bool _allowSRV=false, bool _allowUAV=false, bool _makeStructuredBuffer=false );
 	Primitive( Device& _device, U32 _verticesCount, U32 _indicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, const IVertexFormatDescriptor& _format, bool _allowSRV=false, bool _allowUAV=false, bool _makeStructuredBuffer=false );	// Used to build dynamic buffers
-	Primitive( Device& _device, const IVertexFormatDescriptor& _Format );	// Used by geometry builders
+	Primitive( Device& _device, const IVertexFormatDescriptor& _Format, bool _optimizeGeometry=false );	// Used by geometry builders (_optimizeGeometry requires the vertex format to start with a float3 position)
+	Primitive( Device& _device, U32 _verticesCount, const void* _vertices, U32 _indicesCount, const U32* _indices, U32 _LODsCount, const U32* const* _ppLODIndices, const U32* _pLODIndicesCounts, const IVertexFormatDescriptor& _format );	// Used to build a triangle list with levels of detail (LOD #i+1 uses the _pLODIndicesCounts[i] indices of _ppLODIndices[i])
 	~Primitive();
 
 	void			Render( Shader& _material );
 	void			Render( Shader& _material, int _startVertex, int _verticesCount, int _startIndex, int _indicesCount, int _baseVertexOffset );
+	void			RenderLOD( Shader& _material, U32 _LOD );	// LOD 0 is the full detail primitive, LOD #i is the i-th LOD given at construction
 	void			RenderInstanced( Shader& _material, U32 _InstancesCount );
 	void			RenderInstanced( Shader& _material, U32 _InstancesCount, U32 _startVertex, U32 _verticesCount, U32 _startIndex, U32 _indicesCount, U32 _baseVertexOffset );
 
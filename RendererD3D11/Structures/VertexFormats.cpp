@@ -1,6 +1,7 @@
 #include "stdafx.h"
 
 #include "VertexFormats.h"
+#include "../../BaseLib/Utility/VertexCompression.h"
 
 static const char*	POSITION = "POSITION";
 static const char*	POSITION_TRANSFORMED = "SV_POSITION";
@@ -93,6 +94,14 @@ D3D11_INPUT_ELEMENT_DESC	VertexFormatP3N3G3B3T2::Desc::ms_pInputElements[] =
 	{ TEXCOORD, 0, DXGI_FORMAT_R32G32_FLOAT, 0, 48, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 };
 
+VertexFormatQuantized::Desc	VertexFormatQuantized::DESCRIPTOR;
+D3D11_INPUT_ELEMENT_DESC	VertexFormatQuantized::Desc::ms_pInputElements[] =
+{
+	{ POSITION, 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ TANGENT, 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ TEXCOORD, 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
 VertexFormatP3N3G3B3T3C4C4::Desc	VertexFormatP3N3G3B3T3C4C4::DESCRIPTOR;
 D3D11_INPUT_ELEMENT_DESC	VertexFormatP3N3G3B3T3C4C4::Desc::ms_pInputElements[] =
 {
@@ -190,6 +199,18 @@ void	VertexFormatP3N3G3B3T2::Desc::Write( void* _pVertex, const bfloat3& _Positi
 	V.UV = _UV;
 }
 
+void	VertexFormatQuantized::Desc::Write( void* _pVertex, const bfloat3& _Position, const bfloat3& _Normal, const bfloat3& _Tangent, const bfloat3& _BiTangent, const bfloat2& _UV ) const
+{
+	VertexFormatQuantized&	V = *((VertexFormatQuantized*) _pVertex);
+	V.Position[0] = U16( CLAMP( 65535.0f * _Position.x + 0.5f, 0.0f, 65535.0f ) );
+	V.Position[1] = U16( CLAMP( 65535.0f * _Position.y + 0.5f, 0.0f, 65535.0f ) );
+	V.Position[2] = U16( CLAMP( 65535.0f * _Position.z + 0.5f, 0.0f, 65535.0f ) );
+	V.Position[3] = 0;
+	BaseLib::EncodeTangentFrame( _Normal, _Tangent, _BiTangent, V.TangentFrame );
+	V.UV[0] = half( _UV.x );
+	V.UV[1] = half( _UV.y );
+}
+
 void	VertexFormatP3N3G3B3T3C4C4::Desc::Write( void* _pVertex, const bfloat3& _Position, const bfloat3& _Normal, const bfloat3& _Tangent, const bfloat3& _BiTangent, const bfloat2& _UV ) const
 {
 	VertexFormatP3N3G3B3T3C4C4&	V = *((VertexFormatP3N3G3B3T3C4C4*) _pVertex);
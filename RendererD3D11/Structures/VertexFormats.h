@@ -344,6 +344,34 @@ public:
 
 };
 
+// Quantized version of P3N3G3B3T2 using 20 bytes instead of 56 (same layout as BaseLib::QuantizedVertex, cf. BaseLib/Utility/VertexCompression.h)
+// Position as U16 relative to the bounding box of the primitive (the shader must rescale it)
+// Tangent frame as a quaternion of 4 S16 (a.k.a. QTangent) whose W sign gives the handedness of the bitangent
+// UV as half floats
+struct VertexFormatQuantized
+{
+public:
+
+	static class Desc : public IVertexFormatDescriptor
+	{
+		static D3D11_INPUT_ELEMENT_DESC	ms_pInputElements[3];
+
+	public:
+
+		virtual int			Size() const							{ return sizeof(VertexFormatQuantized); }
+		virtual const D3D11_INPUT_ELEMENT_DESC*  GetInputElements() const	{ return ms_pInputElements; }
+		virtual int			GetInputElementsCount() const			{ return 3; }
+		virtual void		Write( void* _pVertex, const bfloat3& _Position, const bfloat3& _Normal, const bfloat3& _Tangent, const bfloat3& _BiTangent, const bfloat2& _UV ) const;	// _Position must be normalized in [0,1] over the bounding box of the primitive
+	} DESCRIPTOR;
+
+public:
+
+	U16		Position[4];		// XYZ quantized over the bounding box, W is unused
+	S16		TangentFrame[4];	// XYZW quaternion, W < 0 for a left-handed frame
+	half	UV[2];
+
+};
+
 // Position
 // Normal
 // Tangent
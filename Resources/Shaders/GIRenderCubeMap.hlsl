@@ -11,6 +11,8 @@
 
 static const float	FORCE_MIP_BIAS = 2.0;	// Add a mip bias to avoid too much detail in textures
 
+StructuredBuffer<uint>	_SBLODFaceRemap : register( t14 );	// Maps the faces of the LODs to a full detail face of their primitive so face IDs stay consistent whatever the LOD
+
 
 cbuffer	cbCubeMapCamera	: register( b8 )
 {
@@ -37,15 +39,16 @@ struct	PS_OUT
 
 PS_IN	VS( SCENE_VS_IN _In )
 {
-	float4	WorldPosition = mul( float4( _In.Position, 1.0 ), _Local2World );
+	SCENE_VERTEX	V = DecodeSceneVertex( _In );
+	float4	WorldPosition = mul( float4( V.Position, 1.0 ), _Local2World );
 
 	PS_IN	Out;
 	Out.__Position = mul( WorldPosition, _CubeMapWorld2Proj );
 	Out.Position = WorldPosition.xyz;
-	Out.Normal = mul( float4( _In.Normal, 0.0 ), _Local2World ).xyz;
-	Out.Tangent = mul( float4( _In.Tangent, 0.0 ), _Local2World ).xyz;
-	Out.BiTangent = mul( float4( _In.BiTangent, 0.0 ), _Local2World ).xyz;
-	Out.UV = _In.UV;
+	Out.Normal = mul( float4( V.Normal, 0.0 ), _Local2World ).xyz;
+	Out.Tangent = mul( float4( V.Tangent, 0.0 ), _Local2World ).xyz;
+	Out.BiTangent = mul( float4( V.BiTangent, 0.0 ), _Local2World ).xyz;
+	Out.UV = V.UV;
 
 	return Out;
 }
@@ -67,7 +70,8 @@ PS_OUT	PS( PS_IN _In, uint	_FaceIndex : SV_PRIMITIVEID )
 
 //	Out.DiffuseAlbedo.xyz *= INVPI;
 
-	Out.DiffuseAlbedo.w = asfloat( _FaceOffset + _FaceIndex );
+	uint	FaceIndex = _LODFaceRemapOffset != ~0U ? _SBLODFaceRemap[_LODFaceRemapOffset + _FaceIndex] : _FaceIndex;
+	Out.DiffuseAlbedo.w = asfloat( _FaceOffset + FaceIndex );
 
 
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -125,15 +125,16 @@ void	TEMPGatherProbeSH( float3 _Position, float3 _Normal, uint _ProbeID, inout S
 
 PS_IN	VS( SCENE_VS_IN _In )
 {
-	float4	WorldPosition = mul( float4( _In.Position, 1.0 ), _Local2World );
+	SCENE_VERTEX	V = DecodeSceneVertex( _In );
+	float4	WorldPosition = mul( float4( V.Position, 1.0 ), _Local2World );
 
 	PS_IN	Out;
 	Out.__Position = mul( WorldPosition, _World2Proj );
 	Out.Position = WorldPosition.xyz;
-	Out.Normal = mul( float4( _In.Normal, 0.0 ), _Local2World ).xyz;
-	Out.Tangent = mul( float4( _In.Tangent, 0.0 ), _Local2World ).xyz;
-	Out.BiTangent = mul( float4( -_In.BiTangent, 0.0 ), _Local2World ).xyz;
-	Out.UV = _In.UV;
+	Out.Normal = mul( float4( V.Normal, 0.0 ), _Local2World ).xyz;
+	Out.Tangent = mul( float4( V.Tangent, 0.0 ), _Local2World ).xyz;
+	Out.BiTangent = mul( float4( -V.BiTangent, 0.0 ), _Local2World ).xyz;
+	Out.UV = V.UV;
 
 	float3	Normal = normalize( Out.Normal );
 
@@ -7,12 +7,18 @@
 cbuffer	cbObject	: register( b10 )
 {
 	float4x4	_Local2World;
+	float3		_PositionMin;		// Bounding box of the primitive's quantized positions (only used with QUANTIZED_VERTICES)
+	float3		_PositionExtent;
 };
 
 // Scene vertex format
 struct	VS_IN
 {
+#ifdef QUANTIZED_VERTICES
+	float4	Position	: POSITION;	// XYZ normalized over the bounding box of the primitive
+#else
 	float3	Position	: POSITION;
+#endif
 // 	float3	Normal		: NORMAL;
 // 	float3	Tangent		: TANGENT;
 // 	float3	BiTangent	: BITANGENT;
@@ -36,12 +42,21 @@ struct	PS_IN2
 	uint	CubeFaceIndex	: SV_RENDERTARGETARRAYINDEX;
 };
 
+float3	LocalPosition( VS_IN _In )
+{
+#ifdef QUANTIZED_VERTICES
+	return _PositionMin + _In.Position.xyz * _PositionExtent;
+#else
+	return _In.Position;
+#endif
+}
+
 
 ///////////////////////////////////////////////////////////
 // Directional Shadow Map rendering
 PS_IN	VS( VS_IN _In )
 {
-	float4	WorldPosition = mul( float4( _In.Position, 1.0 ), _Local2World );
+	float4	WorldPosition = mul( float4( LocalPosition( _In ), 1.0 ), _Local2World );
 
 	PS_IN	Out;
 	Out.__Position = World2ShadowMapProj( WorldPosition.xyz );
@@ -54,7 +69,7 @@ PS_IN	VS( VS_IN _In )
 // Point-Light Shadow Map rendering
 GS_IN	VS2( VS_IN _In )
 {
-	float4	WorldPosition = mul( float4( _In.Position, 1.0 ), _Local2World );
+	float4	WorldPosition = mul( float4( LocalPosition( _In ), 1.0 ), _Local2World );
 
 	GS_IN	Out;
 	Out.Position = WorldPosition.xyz - _ShadowPointLightPosition;
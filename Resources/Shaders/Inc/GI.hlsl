@@ -20,6 +20,20 @@ static const float	SHADOW_PCF_DISC_RADIUS = 0.01;
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // Scene vertex format
+// Vertex shaders should always go through DecodeSceneVertex() to read the vertex
+#ifdef QUANTIZED_VERTICES
+// Quantized vertices (cf. VertexFormatQuantized)
+struct	SCENE_VS_IN
+{
+	float4	Position		: POSITION;		// XYZ normalized over the bounding box of the primitive (cf. _PositionMin, _PositionExtent)
+	float4	TangentFrame	: TANGENT;		// QTangent quaternion, W < 0 for a left-handed frame
+	float2	UV				: TEXCOORD0;
+
+#ifdef PER_VERTEX_PROBE_ID
+	uint	ProbeID			: INFO;
+#endif
+};
+#else
 struct	SCENE_VS_IN
 {
 	float3	Position	: POSITION;
@@ -32,6 +46,17 @@ struct	SCENE_VS_IN
 	uint	ProbeID		: INFO;
 #endif
 };
+#endif
+
+// Decoded scene vertex, in local space
+struct	SCENE_VERTEX
+{
+	float3	Position;
+	float3	Normal;
+	float3	Tangent;
+	float3	BiTangent;
+	float2	UV;
+};
 
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -49,6 +74,8 @@ cbuffer	cbScene	: register( b9 )
 cbuffer	cbObject	: register( b10 )
 {
 	float4x4	_Local2World;
+	float3		_PositionMin;		// Bounding box of the primitive's quantized positions (only used with QUANTIZED_VERTICES)
+	float3		_PositionExtent;
 };
 
 // Material descriptor
@@ -66,8 +93,35 @@ cbuffer	cbMaterial	: register( b11 )
 	float		_SpecularExponent;
 	uint		_FaceOffset;	// The offset to apply to the object's face index
 	bool		_HasNormalTexture;
+	uint		_LODFaceRemapOffset;	// The offset of the LOD's face remap in _SBLODFaceRemap, or ~0 when rendering full detail faces (cf. GIRenderCubeMap.hlsl)
 };
 
+////////////////////////////////////////////////////////////////////////////////////////
+// Scene vertex decoding
+SCENE_VERTEX	DecodeSceneVertex( SCENE_VS_IN _In )
+{
+	SCENE_VERTEX	Out;
+#ifdef QUANTIZED_VERTICES
+	Out.Position = _PositionMin + _In.Position.xyz * _PositionExtent;
+
+	// Rebuild the tangent frame from the quaternion (same as BaseLib::DecodeTangentFrame())
+	float4	q = normalize( _In.TangentFrame );
+	float	Handedness = q.w < 0.0 ? -1.0 : 1.0;
+	Out.Tangent = float3( 1.0 - 2.0 * (q.y*q.y + q.z*q.z), 2.0 * (q.x*q.y + q.w*q.z), 2.0 * (q.x*q.z - q.w*q.y) );
+	Out.BiTangent = Handedness * float3( 2.0 * (q.x*q.y - q.w*q.z), 1.0 - 2.0 * (q.x*q.x + q.z*q.z), 2.0 * (q.y*q.z + q.w*q.x) );
+	Out.Normal = float3( 2.0 * (q.x*q.z + q.w*q.y), 2.0 * (q.y*q.z - q.w*q.x), 1.0 - 2.0 * (q.x*q.x + q.y*q.y) );
+#else
+	Out.Position = _In.Position;
+	Out.Normal = _In.Normal;
+	Out.Tangent = _In.Tangent;
+	Out.BiTangent = _In.BiTangent;
+#endif
+	Out.UV = _In.UV;
+
+	return Out;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // Structured Buffers
 struct	LightStruct {
@@ -1,11 +1,17 @@
 #include "../GodComplex.h"
 #include "Scene.h"
+#include "../BaseLib/Utility/VertexCompression.h"
+#include "../BaseLib/Utility/MeshOptimizer.h"
+#include "../BaseLib/Utility/MeshSimplifier.h"
+#include "../BaseLib/Utility/Parallel.h"
 
 
 Scene::Scene()
 	: m_pROOT( NULL )
 	, m_MaterialsCount( 0 )
 	, m_ppMaterials( NULL )
+	, m_pData( NULL )
+	, m_pOwnedData( NULL )
 {
 }
 Scene::~Scene()
@@ -17,38 +23,441 @@ Scene::~Scene()
 	delete[] m_ppMaterials;
 	m_ppMaterials = NULL;
 	m_MaterialsCount = 0;
+
+	delete[] m_pOwnedData;
 }
 
-void	Scene::Load( U16 _SceneResourceID ) {
+bool	Scene::Load( U16 _SceneResourceID ) {
 	U32			SceneSize = 0;
 	const U8*	pData = LoadResourceBinary( _SceneResourceID, "SCENE", &SceneSize );
 
-	U32		Version = ReadU32( pData );	// Should be "GCX1"
-	ASSERT( Version == 0x31584347L, "Unsupported scene version!" );
+	return Load( pData, SceneSize );
+}
+
+bool	Scene::Load( const U8* _pData, U32 _Size ) {
+	m_NodesCount = 0;
+	m_MeshesCount = 0;
+	m_LightsCount = 0;
+	m_CamerasCount = 0;
+	m_ProbesCount = 0;
+
+	if ( _pData == NULL || _Size < sizeof(U32) )
+		return false;
+
+	U32		Version = *((const U32*) _pData);
+	if ( Version == GCX1_MAGIC ) {
+		LoadGCX1( _pData );
+		return true;
+	}
+
+	if ( !IsValidGCX2( _pData, _Size ) ) {
+		ASSERT( false, "Invalid GCX2 scene!" );
+		return false;
+	}
+
+	// The scene is used in place but resources returned by LockResource() are only 4 or 8-bytes aligned, so copy it if needed
+	if ( (size_t(_pData) & 15) != 0 ) {
+		U32		SceneSize = ((const FileHeader*) _pData)->Size;
+		delete[] m_pOwnedData;
+		m_pOwnedData = new U8[SceneSize + 15];
+		U8*		pAlignedData = (U8*) ((size_t(m_pOwnedData) + 15) & ~size_t(15));
+		memcpy( pAlignedData, _pData, SceneSize );
+		_pData = pAlignedData;
+	}
+
+	LoadGCX2( _pData );
+	return true;
+}
+
+void	Scene::LoadGCX1( const U8* _pData ) {
+	U32		Version = ReadU32( _pData );
+	ASSERT( Version == GCX1_MAGIC, "Unsupported scene version!" );
 
 	// ==== Read Materials ====
 	//
-	m_MaterialsCount = ReadU16( pData );
+	m_MaterialsCount = ReadU16( _pData );
 	m_ppMaterials = new Material*[m_MaterialsCount];
 	for ( int MaterialIndex=0; MaterialIndex < m_MaterialsCount; MaterialIndex++ ) {
 		Material*	pMaterial = new Material( *this );
 		m_ppMaterials[MaterialIndex] = pMaterial;
 
-		pMaterial->Init( pData );
+		pMaterial->Init( _pData );
 	}
 
 	// ==== Read Node Hierarchy ====
 	//
-	m_NodesCount = 0;
-	m_MeshesCount = 0;
-	m_LightsCount = 0;
-	m_CamerasCount = 0;
-	m_ProbesCount = 0;
+	m_pROOT = CreateNode( NULL, _pData );
+}
+
+void	Scene::LoadGCX2( const U8* _pData ) {
+	const FileHeader&	Header = *((const FileHeader*) _pData);
+	ASSERT( (size_t(_pData) & 15) == 0, "GCX2 scenes must be 16-bytes aligned in memory!" );
+	m_pData = _pData;
+
+	// ==== Read Materials ====
+	//
+	const FileMaterial*	pMaterials = (const FileMaterial*) (_pData + Header.MaterialsOffset);
+	m_MaterialsCount = Header.MaterialsCount;
+	m_ppMaterials = new Material*[m_MaterialsCount];
+	for ( int MaterialIndex=0; MaterialIndex < m_MaterialsCount; MaterialIndex++ ) {
+		Material*	pMaterial = new Material( *this );
+		m_ppMaterials[MaterialIndex] = pMaterial;
+
+		pMaterial->Init( pMaterials[MaterialIndex] );
+	}
+
+	// ==== Read Node Hierarchy ====
+	//
+	m_pROOT = CreateNode( NULL, (const FileNode*) (_pData + Header.NodesOffset), 0 );
+}
+
+// Tells if an array of _Count elements starting at _Offset fits in the scene data
+static bool	IsValidRange( U32 _Offset, U64 _Count, U64 _ElementSize, U32 _Size, U32 _Alignment ) {
+	return (_Offset & (_Alignment-1)) == 0 && U64(_Offset) + _Count * _ElementSize <= U64(_Size);
+}
+
+static bool	AreValidFaces( const U32* _pFaces, U32 _FacesCount, U32 _VerticesCount ) {
+	for ( U32 i=0; i < 3*_FacesCount; i++ )
+		if ( _pFaces[i] >= _VerticesCount )
+			return false;
+	return true;
+}
 
-	m_pROOT = CreateNode( NULL, pData );
+// Checks all the counts, indices and offsets of the GCX2 scene data so no corrupted or truncated scene can be read out of bounds
+bool	Scene::IsValidGCX2( const U8* _pData, U32 _Size ) {
+	if ( _Size < sizeof(FileHeader) )
+		return false;
+
+	const FileHeader&	Header = *((const FileHeader*) _pData);
+	if ( Header.Magic != GCX2_MAGIC || Header.Version != GCX2_VERSION || Header.Size < sizeof(FileHeader) || Header.Size > _Size )
+		return false;
+
+	U32		Size = Header.Size;
+	if (	!IsValidRange( Header.MaterialsOffset, Header.MaterialsCount, sizeof(FileMaterial), Size, 16 )
+		||	!IsValidRange( Header.NodesOffset, Header.NodesCount, sizeof(FileNode), Size, 16 )
+		||	!IsValidRange( Header.PrimitivesOffset, Header.PrimitivesCount, sizeof(FilePrimitive), Size, 16 ) )
+		return false;
+	if ( Header.NodesCount == 0 )
+		return false;	// No root
+
+	// Children must come after their parent so the hierarchy can't loop, and must point back at it so no node is shared by 2 parents
+	const FileNode*	pNodes = (const FileNode*) (_pData + Header.NodesOffset);
+	if ( pNodes[0].ParentIndex != ~0U )
+		return false;
+	for ( U32 NodeIndex=0; NodeIndex < Header.NodesCount; NodeIndex++ ) {
+		const FileNode&	N = pNodes[NodeIndex];
+		if ( N.Type > Node::PROBE )
+			return false;
+		if ( N.ChildrenCount > 0 && (N.FirstChildIndex <= NodeIndex || U64(N.FirstChildIndex) + N.ChildrenCount > Header.NodesCount) )
+			return false;
+		for ( U32 ChildIndex=0; ChildIndex < N.ChildrenCount; ChildIndex++ )
+			if ( pNodes[N.FirstChildIndex + ChildIndex].ParentIndex != NodeIndex )
+				return false;
+		if ( N.Type == Node::MESH && U64(N.AsMesh.FirstPrimitiveIndex) + N.AsMesh.PrimitivesCount > Header.PrimitivesCount )
+			return false;
+	}
+
+	const FilePrimitive*	pPrimitives = (const FilePrimitive*) (_pData + Header.PrimitivesOffset);
+	for ( U32 PrimitiveIndex=0; PrimitiveIndex < Header.PrimitivesCount; PrimitiveIndex++ ) {
+		const FilePrimitive&	P = pPrimitives[PrimitiveIndex];
+		if ( P.MaterialIndex >= Header.MaterialsCount )
+			return false;	// Every primitive needs a material, like in the GCX format
+		if ( P.VertexFormat > Mesh::Primitive::QUANTIZED )
+			return false;
+
+		// Compressed arrays are decoded so they can be anywhere, raw arrays are used in place
+		U32		StoredVertexSize = P.VertexFormat == Mesh::Primitive::QUANTIZED ? sizeof(BaseLib::QuantizedVertex) : sizeof(BaseLib::VertexP3N3G3B3T2);
+		if ( P.IndicesSize != 0 ? !IsValidRange( P.IndicesOffset, P.IndicesSize, 1, Size, 1 ) : !IsValidRange( P.IndicesOffset, 3*U64(P.FacesCount), sizeof(U32), Size, 16 ) )
+			return false;
+		if ( P.IndicesSize == 0 && !AreValidFaces( (const U32*) (_pData + P.IndicesOffset), P.FacesCount, P.VerticesCount ) )
+			return false;	// (compressed indices are checked once decoded)
+		if ( P.VerticesSize != 0 ? !IsValidRange( P.VerticesOffset, P.VerticesSize, 1, Size, 1 ) : !IsValidRange( P.VerticesOffset, P.VerticesCount, StoredVertexSize, Size, 16 ) )
+			return false;
+
+		if ( P.LODsCount > Mesh::Primitive::MAX_LODS || !IsValidRange( P.LODsOffset, P.LODsCount, sizeof(FileLOD), Size, 16 ) )
+			return false;
+		const FileLOD*	pLODs = (const FileLOD*) (_pData + P.LODsOffset);
+		for ( U32 LODIndex=0; LODIndex < P.LODsCount; LODIndex++ )
+			if (	!IsValidRange( pLODs[LODIndex].IndicesOffset, 3*U64(pLODs[LODIndex].FacesCount), sizeof(U32), Size, 16 )
+				||	!AreValidFaces( (const U32*) (_pData + pLODs[LODIndex].IndicesOffset), pLODs[LODIndex].FacesCount, P.VerticesCount ) )
+				return false;
+	}
+
+	return true;
+}
+
+void	Scene::OptimizePrimitives( BaseLib::VertexCacheStatistics* _pBefore, BaseLib::VertexCacheStatistics* _pAfter ) {
+	class	Optimizer : public IVisitor {
+	public:
+		U32		m_FacesCount;
+		U32		m_VerticesCountBefore;
+		U32		m_VerticesCountAfter;
+		BaseLib::VertexCacheStatistics	m_Before;
+		BaseLib::VertexCacheStatistics	m_After;
+
+		Optimizer() : m_FacesCount( 0 ), m_VerticesCountBefore( 0 ), m_VerticesCountAfter( 0 ) {
+			m_Before.VerticesTransformed = m_After.VerticesTransformed = 0;
+		}
+
+		virtual void	HandleNode( Node& _Node ) override {
+			if ( _Node.m_Type != Node::MESH )
+				return;
+
+			Mesh&	M = (Mesh&) _Node;
+			for ( int PrimitiveIndex=0; PrimitiveIndex < M.m_PrimitivesCount; PrimitiveIndex++ ) {
+				Mesh::Primitive&	P = M.m_pPrimitives[PrimitiveIndex];
+				if ( P.m_LODsCount > 0 )
+					continue;	// Baked primitives were optimized before their LODs were built
+
+				m_FacesCount += P.m_FacesCount;
+				m_VerticesCountBefore += P.m_VerticesCount;
+
+				BaseLib::VertexCacheStatistics	Before, After;
+				P.Optimize( &Before, &After );
+				m_Before.VerticesTransformed += Before.VerticesTransformed;
+				m_After.VerticesTransformed += After.VerticesTransformed;
+				m_VerticesCountAfter += P.m_VerticesCount;
+			}
+		}
+
+		// Average the statistics over the whole scene
+		static void	Resolve( BaseLib::VertexCacheStatistics& _Statistics, U32 _FacesCount, U32 _VerticesCount ) {
+			_Statistics.ACMR = _FacesCount > 0 ? float(_Statistics.VerticesTransformed) / _FacesCount : 0.0f;
+			_Statistics.ATVR = _VerticesCount > 0 ? float(_Statistics.VerticesTransformed) / _VerticesCount : 0.0f;
+		}
+	}	Visitor;
+	ForEach( Visitor );
+
+	if ( _pBefore != NULL ) {
+		*_pBefore = Visitor.m_Before;
+		Optimizer::Resolve( *_pBefore, Visitor.m_FacesCount, Visitor.m_VerticesCountBefore );
+	}
+	if ( _pAfter != NULL ) {
+		*_pAfter = Visitor.m_After;
+		Optimizer::Resolve( *_pAfter, Visitor.m_FacesCount, Visitor.m_VerticesCountAfter );
+	}
+}
+
+void	Scene::BuildLODs( U32 _MaxLODsCount, float _Reduction ) {
+	// Gather the primitives first so they can be simplified in parallel
+	class	Gatherer : public IVisitor {
+	public:
+		BaseLib::List< Mesh::Primitive* >	m_Primitives;
+
+		virtual void	HandleNode( Node& _Node ) override {
+			if ( _Node.m_Type != Node::MESH )
+				return;
+
+			Mesh&	M = (Mesh&) _Node;
+			for ( int PrimitiveIndex=0; PrimitiveIndex < M.m_PrimitivesCount; PrimitiveIndex++ )
+				if ( M.m_pPrimitives[PrimitiveIndex].m_LODsCount == 0 )
+					m_Primitives.Append( &M.m_pPrimitives[PrimitiveIndex] );
+		}
+	}	Visitor;
+	ForEach( Visitor );
+
+	struct	Builder {
+		Mesh::Primitive**	m_ppPrimitives;
+		U32					m_MaxLODsCount;
+		float				m_Reduction;
+
+		void	operator()( U32 _Index ) {
+			m_ppPrimitives[_Index]->BuildLODs( m_MaxLODsCount, m_Reduction );
+		}
+	}	Functor = { Visitor.m_Primitives.Ptr(), _MaxLODsCount, _Reduction };
+	BaseLib::ParallelFor( Visitor.m_Primitives.Count(), Functor );
+}
+
+static U32	Align16( U32 _Offset )	{ return (_Offset + 15) & ~15U; }
+
+// Appends a 16-bytes aligned block (zeroed if _pBlock is NULL) to the scene data and returns its offset
+static U32	AppendBlock( BaseLib::List< U8 >& _Data, const void* _pBlock, U32 _Size ) {
+	U32	Offset = Align16( _Data.Count() );
+	if ( Offset + _Size > _Data.GetAllocatedSize() )
+		_Data.Reserve( MAX( Offset + _Size, 2 * _Data.GetAllocatedSize() ) );	// Grow geometrically, scenes are made of many blocks
+	_Data.SetCount( Offset + _Size );	// Zeroes the padding
+	if ( _pBlock != NULL && _Size > 0 )
+		memcpy( _Data.Ptr() + Offset, _pBlock, _Size );
+	return Offset;
+}
+
+bool	Scene::SaveGCX2( const char* _pFileName, U32 _Flags ) const {
+	if ( m_pROOT == NULL )
+		return false;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Flatten nodes in breadth-first order so the children of any node are contiguous in the table, and so are the primitives of any mesh
+	BaseLib::List< const Node* >			Nodes;
+	BaseLib::List< FileNode >				FileNodes;
+	BaseLib::List< const Mesh::Primitive* >	Primitives;
+	Nodes.Append( m_pROOT );
+	for ( U32 NodeIndex=0; NodeIndex < Nodes.Count(); NodeIndex++ ) {
+		const Node*	pNode = Nodes[NodeIndex];
+
+		FileNode&	FN = FileNodes.Append();
+		memset( &FN, 0, sizeof(FileNode) );
+		FN.Local2Parent = pNode->m_Local2Parent;
+		FN.Type = pNode->m_Type;
+		FN.ParentIndex = ~0U;	// Patched below, except for the root
+		FN.FirstChildIndex = Nodes.Count();
+		FN.ChildrenCount = pNode->m_ChildrenCount;
+		for ( int ChildIndex=0; ChildIndex < pNode->m_ChildrenCount; ChildIndex++ )
+			Nodes.Append( pNode->m_ppChildren[ChildIndex] );
+
+		switch ( pNode->m_Type ) {
+		case Node::MESH: {
+			const Mesh&	M = (const Mesh&) *pNode;
+			FN.AsMesh.FirstPrimitiveIndex = Primitives.Count();
+			FN.AsMesh.PrimitivesCount = M.m_PrimitivesCount;
+			for ( int PrimitiveIndex=0; PrimitiveIndex < M.m_PrimitivesCount; PrimitiveIndex++ )
+				Primitives.Append( &M.m_pPrimitives[PrimitiveIndex] );
+			break;
+		}
+		case Node::LIGHT: {
+			const Light&	L = (const Light&) *pNode;
+			FN.AsLight.LightType = L.m_LightType;
+			FN.AsLight.Color[0] = L.m_Color.x;
+			FN.AsLight.Color[1] = L.m_Color.y;
+			FN.AsLight.Color[2] = L.m_Color.z;
+			FN.AsLight.Intensity = L.m_Intensity;
+			FN.AsLight.HotSpot = L.m_HotSpot;
+			FN.AsLight.Falloff = L.m_Falloff;
+			break;
+		}
+		case Node::CAMERA:
+			FN.AsCamera.FOV = ((const Camera*) pNode)->m_FOV;
+			break;
+		}
+	}
+	for ( U32 NodeIndex=0; NodeIndex < FileNodes.Count(); NodeIndex++ )
+		for ( U32 ChildIndex=0; ChildIndex < FileNodes[NodeIndex].ChildrenCount; ChildIndex++ )
+			FileNodes[FileNodes[NodeIndex].FirstChildIndex + ChildIndex].ParentIndex = NodeIndex;
+
+	BaseLib::List< FileMaterial >	FileMaterials;
+	for ( int MaterialIndex=0; MaterialIndex < m_MaterialsCount; MaterialIndex++ ) {
+		const Material&	M = *m_ppMaterials[MaterialIndex];
+		FileMaterial&	FM = FileMaterials.Append();
+		FM.ID = M.m_ID;
+		FM.DiffuseAlbedo = M.m_DiffuseAlbedo;
+		FM.TexDiffuseAlbedoID = M.m_TexDiffuseAlbedo.m_ID;
+		FM.SpecularAlbedo = M.m_SpecularAlbedo;
+		FM.TexSpecularAlbedoID = M.m_TexSpecularAlbedo.m_ID;
+		FM.SpecularExponent = M.m_SpecularExponent;
+		FM.TexNormalID = M.m_TexNormal.m_ID;
+		FM.EmissiveColor = M.m_EmissiveColor;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build the entire scene in memory: header and tables first, then the indices, vertices and LODs of each primitive
+	BaseLib::List< U8 >	Data;
+
+	FileHeader	H;
+	memset( &H, 0, sizeof(FileHeader) );
+	H.Magic = GCX2_MAGIC;
+	H.Version = GCX2_VERSION;
+	AppendBlock( Data, NULL, sizeof(FileHeader) );
+	H.MaterialsCount = FileMaterials.Count();
+	H.MaterialsOffset = AppendBlock( Data, FileMaterials.Ptr(), FileMaterials.Count() * sizeof(FileMaterial) );
+	H.NodesCount = FileNodes.Count();
+	H.NodesOffset = AppendBlock( Data, FileNodes.Ptr(), FileNodes.Count() * sizeof(FileNode) );
+	H.PrimitivesCount = Primitives.Count();
+	H.PrimitivesOffset = AppendBlock( Data, NULL, Primitives.Count() * sizeof(FilePrimitive) );	// Filled once all the offsets are known
+
+	BaseLib::List< FilePrimitive >				FilePrimitives;
+	BaseLib::List< BaseLib::QuantizedVertex >	QuantizedVertices;
+	BaseLib::List< U8 >							Encoded;
+	for ( U32 PrimitiveIndex=0; PrimitiveIndex < Primitives.Count(); PrimitiveIndex++ ) {
+		const Mesh::Primitive&	P = *Primitives[PrimitiveIndex];
+		ASSERT( P.m_VertexFormat == Mesh::Primitive::P3N3G3B3T2, "Unsupported vertex format!" );
+
+		FilePrimitive&	FP = FilePrimitives.Append();
+		memset( &FP, 0, sizeof(FilePrimitive) );
+		FP.MaterialIndex = ~0U;
+		for ( int MaterialIndex=0; MaterialIndex < m_MaterialsCount; MaterialIndex++ )
+			if ( m_ppMaterials[MaterialIndex] == P.m_pMaterial )
+				FP.MaterialIndex = MaterialIndex;
+		ASSERT( FP.MaterialIndex != ~0U, "Primitive material isn't part of the scene!" );
+		FP.FacesCount = P.m_FacesCount;
+		FP.VerticesCount = P.m_VerticesCount;
+		FP.VertexFormat = P.m_VertexFormat;
+		FP.LocalBBoxMin = P.m_LocalBBoxMin;
+		FP.LocalBBoxMax = P.m_LocalBBoxMax;
+		FP.GlobalBBoxMin = P.m_GlobalBBoxMin;
+		FP.GlobalBBoxMax = P.m_GlobalBBoxMax;
+
+		// Indices, compressed only if it makes them smaller
+		U32	IndicesSize = 3*P.m_FacesCount*sizeof(U32);
+		if ( (_Flags & SAVE_COMPRESS) && P.m_FacesCount > 0 ) {
+			Encoded.SetCount( BaseLib::EncodeIndexBufferBound( 3*P.m_FacesCount ) );
+			FP.IndicesSize = BaseLib::EncodeIndexBuffer( P.m_pFaces, 3*P.m_FacesCount, Encoded.Ptr(), Encoded.Count() );
+			if ( FP.IndicesSize >= IndicesSize )
+				FP.IndicesSize = 0;
+		}
+		FP.IndicesOffset = FP.IndicesSize != 0 ? AppendBlock( Data, Encoded.Ptr(), FP.IndicesSize ) : AppendBlock( Data, P.m_pFaces, IndicesSize );
+
+		// Vertices, quantized over their exact bounding box then compressed only if it makes them smaller
+		const void*	pVertices = P.m_pVertices;
+		U32			VertexSize = sizeof(Mesh::Primitive::VF_P3N3G3B3T2);
+		if ( (_Flags & SAVE_QUANTIZE_VERTICES) && P.m_VerticesCount > 0 ) {
+			const Mesh::Primitive::VF_P3N3G3B3T2*	pSource = (const Mesh::Primitive::VF_P3N3G3B3T2*) P.m_pVertices;
+			FP.LocalBBoxMin = float3::MaxFlt;
+			FP.LocalBBoxMax = -float3::MaxFlt;
+			for ( U32 VertexIndex=0; VertexIndex < P.m_VerticesCount; VertexIndex++ ) {
+				FP.LocalBBoxMin = FP.LocalBBoxMin.Min( pSource[VertexIndex].P );
+				FP.LocalBBoxMax = FP.LocalBBoxMax.Max( pSource[VertexIndex].P );
+			}
+
+			QuantizedVertices.SetCount( P.m_VerticesCount );
+			BaseLib::QuantizeVertices( (const BaseLib::VertexP3N3G3B3T2*) P.m_pVertices, P.m_VerticesCount, (const bfloat3&) FP.LocalBBoxMin, (const bfloat3&) FP.LocalBBoxMax, QuantizedVertices.Ptr() );
+			FP.VertexFormat = Mesh::Primitive::QUANTIZED;
+			pVertices = QuantizedVertices.Ptr();
+			VertexSize = sizeof(BaseLib::QuantizedVertex);
+		}
+		U32	VerticesSize = P.m_VerticesCount * VertexSize;
+		if ( (_Flags & SAVE_COMPRESS) && P.m_VerticesCount > 0 ) {
+			Encoded.SetCount( BaseLib::EncodeVertexBufferBound( P.m_VerticesCount, VertexSize ) );
+			FP.VerticesSize = BaseLib::EncodeVertexBuffer( pVertices, P.m_VerticesCount, VertexSize, Encoded.Ptr(), Encoded.Count() );
+			if ( FP.VerticesSize >= VerticesSize )
+				FP.VerticesSize = 0;
+		}
+		FP.VerticesOffset = FP.VerticesSize != 0 ? AppendBlock( Data, Encoded.Ptr(), FP.VerticesSize ) : AppendBlock( Data, pVertices, VerticesSize );
+
+		FileLOD	pLODs[Mesh::Primitive::MAX_LODS];
+		memset( pLODs, 0, sizeof(pLODs) );
+		for ( U32 LODIndex=0; LODIndex < P.m_LODsCount; LODIndex++ ) {
+			const BaseLib::MeshLOD&	LOD = P.m_pLODs[LODIndex];
+			pLODs[LODIndex].FacesCount = LOD.IndicesCount / 3;
+			pLODs[LODIndex].IndicesOffset = AppendBlock( Data, P.m_pLODIndices + LOD.IndicesOffset, LOD.IndicesCount * sizeof(U32) );
+			pLODs[LODIndex].Error = LOD.Error;
+		}
+		FP.LODsCount = P.m_LODsCount;
+		FP.LODsOffset = AppendBlock( Data, pLODs, P.m_LODsCount * sizeof(FileLOD) );
+	}
+
+	H.Size = AppendBlock( Data, NULL, 0 );
+	memcpy( Data.Ptr(), &H, sizeof(FileHeader) );
+	if ( FilePrimitives.Count() > 0 )
+		memcpy( Data.Ptr() + H.PrimitivesOffset, FilePrimitives.Ptr(), FilePrimitives.Count() * sizeof(FilePrimitive) );
+
+	ASSERT( IsValidGCX2( Data.Ptr(), H.Size ), "Wrote an invalid GCX2 scene!" );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Write
+	FILE*	pFile = NULL;
+	fopen_s( &pFile, _pFileName, "wb" );
+	if ( pFile == NULL )
+		return false;
+
+	size_t	WrittenSize = fwrite( Data.Ptr(), 1, H.Size, pFile );
+	fclose( pFile );
+
+	return WrittenSize == H.Size;
 }
 
 void	Scene::PlaceTags( ISceneTagger& _SceneTagger ) {
+	if ( m_pROOT == NULL )
+		return;	// Failed to load
+
 	// Tag materials
 	for ( int MaterialIndex=0; MaterialIndex < m_MaterialsCount; MaterialIndex++ ) {
 		m_ppMaterials[MaterialIndex]->PlaceTag( _SceneTagger );
@@ -62,11 +471,13 @@ void	Scene::Exit() {
 	for ( int MaterialIndex=0; MaterialIndex < m_MaterialsCount; MaterialIndex++ )
 		m_ppMaterials[MaterialIndex]->Exit();
 
-	m_pROOT->Exit();
+	if ( m_pROOT != NULL )
+		m_pROOT->Exit();
 }
 
 void	Scene::Render( ISceneRenderer& _SceneRenderer, bool _SetMaterial ) const {
-	Render( m_pROOT, _SceneRenderer, _SetMaterial );
+	if ( m_pROOT != NULL )
+		Render( m_pROOT, _SceneRenderer, _SetMaterial );
 }
 
 void	Scene::Render( const Node* _pNode, ISceneRenderer& _SceneRenderer, bool _SetMaterial ) const {
@@ -82,7 +493,8 @@ void	Scene::Render( const Node* _pNode, ISceneRenderer& _SceneRenderer, bool _Se
 
 void	Scene::ForEach( IVisitor& _Visitor )
 {
-	ForEach( _Visitor, m_pROOT );
+	if ( m_pROOT != NULL )
+		ForEach( _Visitor, m_pROOT );
 }
 void	Scene::ForEach( IVisitor& _Visitor, Node* _pNode )
 {
@@ -142,33 +554,58 @@ Scene::Node*	Scene::ForEach( Node::TYPE _Type, Node* _pPrevious, int _StartAtChi
 }
 
 
-Scene::Node*	Scene::CreateNode( Node* _pParent, const U8*& _pData ) {
+Scene::Node*	Scene::CreateNode( Scene& _Owner, Node* _pParent, Node::TYPE _Type ) {
 	Node*		pResult = NULL;
-	Node::TYPE	NodeType = (Node::TYPE) *_pData;
-	switch ( NodeType )
+	switch ( _Type )
 	{
 	case Node::GENERIC:
-		pResult = new Node( *this, _pParent );
+		pResult = new Node( _Owner, _pParent );
 		break;
 	case Node::LIGHT:
-		pResult = new Light( *this, _pParent );
+		pResult = new Light( _Owner, _pParent );
 		break;
 	case Node::CAMERA:
-		pResult = new Camera( *this, _pParent );
+		pResult = new Camera( _Owner, _pParent );
 		break;
 	case Node::MESH:
-		pResult = new Mesh( *this, _pParent );
+		pResult = new Mesh( _Owner, _pParent );
 		break;
 
 		// Special nodes
 	case Node::PROBE:
-		pResult = new Probe( *this, _pParent );
+		pResult = new Probe( _Owner, _pParent );
 		break;
 
 	default:
 		ASSERT( false, "Unsupported node type!" );
 	}
 
+	return pResult;
+}
+
+Scene::Node*	Scene::CreateNode( Node* _pParent, const FileNode* _pNodes, U32 _NodeIndex ) {
+	const FileNode&	SourceNode = _pNodes[_NodeIndex];
+	Node*	pResult = CreateNode( *this, _pParent, (Node::TYPE) SourceNode.Type );
+
+	// Init the node
+	pResult->Init( SourceNode );
+
+	// Process children
+	pResult->m_ChildrenCount = SourceNode.ChildrenCount;
+	if ( pResult->m_ChildrenCount > 0 ) {
+		pResult->m_ppChildren = new Node*[pResult->m_ChildrenCount];
+		for ( int ChildIndex=0; ChildIndex < pResult->m_ChildrenCount; ChildIndex++ ) {
+			Node*	pChild = CreateNode( pResult, _pNodes, SourceNode.FirstChildIndex + ChildIndex );
+			pResult->m_ppChildren[ChildIndex] = pChild;
+		}
+	}
+
+	return pResult;
+}
+
+Scene::Node*	Scene::CreateNode( Node* _pParent, const U8*& _pData ) {
+	Node*	pResult = CreateNode( *this, _pParent, (Node::TYPE) *_pData );
+
 	// Init the node
 	pResult->Init( _pData );
 
@@ -268,6 +705,17 @@ void	Scene::Node::Init( const U8*& _pData ) {
 	ReadEndNodeMarker( _pData );
 }
 
+void	Scene::Node::Init( const FileNode& _Node ) {
+	m_Type = (TYPE) _Node.Type;
+	m_Local2Parent = _Node.Local2Parent;
+
+	// Retrieve LOCAL => WORLD
+	const float4x4&	Parent2World = m_pParent != NULL ? m_pParent->m_Local2World : float4x4::Identity;
+	m_Local2World = m_Local2Parent * Parent2World;
+
+	InitSpecific( _Node );
+}
+
 void	Scene::Node::Exit() {
 	ExitSpecific();
 
@@ -319,6 +767,14 @@ void	Scene::Light::InitSpecific( const U8*& _pData ) {
 	m_Falloff = ReadF32( _pData );
 }
 
+void	Scene::Light::InitSpecific( const FileNode& _Node ) {
+	m_LightType = (LIGHT_TYPE) _Node.AsLight.LightType;
+	m_Color.Set( _Node.AsLight.Color[0], _Node.AsLight.Color[1], _Node.AsLight.Color[2] );
+	m_Intensity = _Node.AsLight.Intensity;
+	m_HotSpot = _Node.AsLight.HotSpot;
+	m_Falloff = _Node.AsLight.Falloff;
+}
+
 
 // ==== Camera ====
 Scene::Camera::Camera( Scene& _Owner, Node* _pParent )
@@ -331,6 +787,10 @@ void	Scene::Camera::InitSpecific( const U8*& _pData ) {
 	m_FOV = ReadF32( _pData );
 }
 
+void	Scene::Camera::InitSpecific( const FileNode& _Node ) {
+	m_FOV = _Node.AsCamera.FOV;
+}
+
 
 // ==== Mesh ====
 Scene::Mesh::Mesh( Scene& _Owner, Node* _pParent )
@@ -365,6 +825,29 @@ void	Scene::Mesh::InitSpecific( const U8*& _pData ) {
 	}
 }
 
+void	Scene::Mesh::InitSpecific( const FileNode& _Node ) {
+	m_LocalBBoxMin = float3::MaxFlt;
+	m_LocalBBoxMax = -float3::MaxFlt;
+	m_GlobalBBoxMin = float3::MaxFlt;
+	m_GlobalBBoxMax = -float3::MaxFlt;
+
+	const FileHeader&		Header = *((const FileHeader*) m_Owner.m_pData);
+	const FilePrimitive*	pPrimitives = (const FilePrimitive*) (m_Owner.m_pData + Header.PrimitivesOffset) + _Node.AsMesh.FirstPrimitiveIndex;
+
+	m_PrimitivesCount = _Node.AsMesh.PrimitivesCount;
+	m_pPrimitives = new Primitive[m_PrimitivesCount];
+	for ( int PrimitiveIndex=0; PrimitiveIndex < m_PrimitivesCount; PrimitiveIndex++ ) {
+		Primitive&	P = m_pPrimitives[PrimitiveIndex];
+		P.Init( *this, pPrimitives[PrimitiveIndex] );
+
+		// Expand our own BBox
+		m_LocalBBoxMin = m_LocalBBoxMin.Min( P.m_LocalBBoxMin );
+		m_LocalBBoxMax = m_LocalBBoxMax.Max( P.m_LocalBBoxMax );
+		m_GlobalBBoxMin = m_GlobalBBoxMin.Min( P.m_GlobalBBoxMin );
+		m_GlobalBBoxMax = m_GlobalBBoxMax.Max( P.m_GlobalBBoxMax );
+	}
+}
+
 void	Scene::Mesh::PlaceTagSpecific( ISceneTagger& _SceneTagger ) {
 	for ( int PrimitiveIndex=0; PrimitiveIndex < m_PrimitivesCount; PrimitiveIndex++ ) {
 		Primitive&	P = m_pPrimitives[PrimitiveIndex];
@@ -376,12 +859,25 @@ Scene::Mesh::Primitive::Primitive()
 	: m_pMaterial( NULL )
 	, m_FacesCount( 0 )
 	, m_pFaces( NULL )
+	, m_LODsCount( 0 )
+	, m_pLODIndices( NULL )
+	, m_pLODFaces( NULL )
 	, m_VerticesCount( 0 )
-	, m_pVertices( NULL ) {
+	, m_pVertices( NULL )
+	, m_pQuantizedVertices( NULL )
+	, m_OwnsFaces( false )
+	, m_OwnsVertices( false )
+	, m_OwnsQuantizedVertices( false )
+	, m_pTag( NULL ) {
 }
 Scene::Mesh::Primitive::~Primitive() {
-	delete[] m_pFaces;
-	delete[] m_pVertices;
+	if ( m_OwnsFaces )
+		delete[] (U32*) m_pFaces;
+	delete[] m_pLODFaces;
+	if ( m_OwnsVertices )
+		delete[] (U8*) m_pVertices;
+	if ( m_OwnsQuantizedVertices )
+		delete[] (U8*) m_pQuantizedVertices;
 }
 
 void	Scene::Mesh::Primitive::Init( Mesh& _Owner, const U8*& _pData ) {
@@ -401,22 +897,24 @@ void	Scene::Mesh::Primitive::Init( Mesh& _Owner, const U8*& _pData ) {
 	m_LocalBBoxMax.z = ReadF32( _pData );
 
 	// Read indices
-	m_pFaces = new U32[3*m_FacesCount];
+	U32*	pFaces = new U32[3*m_FacesCount];
 	if ( m_VerticesCount <= 65536 )
 	{
 		for ( U32 FaceIndex=0; FaceIndex < m_FacesCount; FaceIndex++ )
 		{
-			m_pFaces[3*FaceIndex+0] = ReadU16( _pData );
-			m_pFaces[3*FaceIndex+1] = ReadU16( _pData );
-			m_pFaces[3*FaceIndex+2] = ReadU16( _pData );
+			pFaces[3*FaceIndex+0] = ReadU16( _pData );
+			pFaces[3*FaceIndex+1] = ReadU16( _pData );
+			pFaces[3*FaceIndex+2] = ReadU16( _pData );
 		}
 	}
 	else
 	{
 		int	IndexBufferSize = 3*m_FacesCount*sizeof(U32);
-		memcpy( m_pFaces, _pData, IndexBufferSize );
+		memcpy( pFaces, _pData, IndexBufferSize );
 		_pData += IndexBufferSize;
 	}
+	m_pFaces = pFaces;
+	m_OwnsFaces = true;
 
 	// Read vertices
 	m_VertexFormat = (VERTEX_FORMAT) *_pData++;
@@ -427,22 +925,151 @@ void	Scene::Mesh::Primitive::Init( Mesh& _Owner, const U8*& _pData ) {
 	}
 
 	int		VertexBufferSize = m_VerticesCount * VertexSize;
-	m_pVertices = new U8[VertexBufferSize];
-	memcpy( m_pVertices, _pData, VertexBufferSize );
+	U8*		pVertices = new U8[VertexBufferSize];
+	memcpy( pVertices, _pData, VertexBufferSize );
 	_pData += VertexBufferSize;
+	m_pVertices = pVertices;
+	m_OwnsVertices = true;
 
 	// Compute global bounding box
 	m_GlobalBBoxMin = float3::MaxFlt;
 	m_GlobalBBoxMax = -float3::MaxFlt;
 	for ( U32 VertexIndex=0; VertexIndex < m_VerticesCount; VertexIndex++ )
 	{
-		float3	LocalPosition = *((float3*) ((U8*) m_pVertices + VertexIndex * VertexSize));
+		float3	LocalPosition = *((const float3*) ((const U8*) m_pVertices + VertexIndex * VertexSize));
 		float3	WorldPosition = float4( LocalPosition, 1 ) * _Owner.m_Local2World;
 		m_GlobalBBoxMin = m_GlobalBBoxMin.Min( WorldPosition );
 		m_GlobalBBoxMax = m_GlobalBBoxMax.Max( WorldPosition );
 	}
 }
 
+void	Scene::Mesh::Primitive::Init( Mesh& _Owner, const FilePrimitive& _Primitive ) {
+	const Scene&	Owner = _Owner.m_Owner;
+	ASSERT( _Primitive.MaterialIndex < U32(Owner.m_MaterialsCount), "Material index out of range!" );
+	m_pMaterial = Owner.m_ppMaterials[_Primitive.MaterialIndex];
+
+	m_FacesCount = _Primitive.FacesCount;
+	m_VerticesCount = _Primitive.VerticesCount;
+	m_VertexFormat = (VERTEX_FORMAT) _Primitive.VertexFormat;
+
+	m_LocalBBoxMin = _Primitive.LocalBBoxMin;
+	m_LocalBBoxMax = _Primitive.LocalBBoxMax;
+	m_GlobalBBoxMin = _Primitive.GlobalBBoxMin;
+	m_GlobalBBoxMax = _Primitive.GlobalBBoxMax;
+
+	// Point straight into the scene data unless it's compressed
+	const U8*	pFaces = Owner.m_pData + _Primitive.IndicesOffset;
+	m_pFaces = (const U32*) pFaces;
+	m_OwnsFaces = false;
+	if ( _Primitive.IndicesSize != 0 ) {
+		U32*	pDecodedFaces = new U32[3*m_FacesCount];
+		bool	Succeeded = BaseLib::DecodeIndexBuffer( pFaces, _Primitive.IndicesSize, pDecodedFaces, 3*m_FacesCount ) && AreValidFaces( pDecodedFaces, m_FacesCount, m_VerticesCount );
+		ASSERT( Succeeded, "Corrupted primitive indices!" );
+		m_pFaces = pDecodedFaces;
+		m_OwnsFaces = true;
+		if ( !Succeeded )
+			m_FacesCount = 0;	// Don't render garbage
+	}
+
+	// LODs are always stored raw, their byte offsets in the scene data become index offsets from its start
+	ASSERT( _Primitive.LODsCount <= MAX_LODS, "Too many LODs!" );
+	const FileLOD*	pLODs = (const FileLOD*) (Owner.m_pData + _Primitive.LODsOffset);
+	m_LODsCount = _Primitive.LODsCount;
+	m_pLODIndices = (const U32*) Owner.m_pData;
+	for ( U32 LODIndex=0; LODIndex < m_LODsCount; LODIndex++ ) {
+		m_pLODs[LODIndex].IndicesOffset = U32( pLODs[LODIndex].IndicesOffset / sizeof(U32) );
+		m_pLODs[LODIndex].IndicesCount = 3*pLODs[LODIndex].FacesCount;
+		m_pLODs[LODIndex].Error = pLODs[LODIndex].Error;
+	}
+
+	U32			StoredVertexSize = m_VertexFormat == QUANTIZED ? sizeof(BaseLib::QuantizedVertex) : sizeof(BaseLib::VertexP3N3G3B3T2);
+	const U8*	pVertices = Owner.m_pData + _Primitive.VerticesOffset;
+	m_pVertices = pVertices;
+	m_OwnsVertices = false;
+	if ( _Primitive.VerticesSize != 0 ) {
+		U8*		pDecodedVertices = new U8[m_VerticesCount * StoredVertexSize];
+		bool	Succeeded = BaseLib::DecodeVertexBuffer( pVertices, _Primitive.VerticesSize, pDecodedVertices, m_VerticesCount, StoredVertexSize );
+		ASSERT( Succeeded, "Corrupted primitive vertices!" );
+		m_pVertices = pDecodedVertices;
+		m_OwnsVertices = true;
+		if ( !Succeeded ) {
+			m_FacesCount = 0;	// Don't render garbage
+			m_LODsCount = 0;
+		}
+	}
+
+	if ( m_VertexFormat == QUANTIZED ) {
+		// Dequantize for the CPU (optimization, LODs, probes) but keep the quantized vertices for the GPU vertex buffers
+		U8*		pDequantizedVertices = new U8[m_VerticesCount * sizeof(BaseLib::VertexP3N3G3B3T2)];
+		BaseLib::DequantizeVertices( (const BaseLib::QuantizedVertex*) m_pVertices, m_VerticesCount, (const bfloat3&) m_LocalBBoxMin, (const bfloat3&) m_LocalBBoxMax, (BaseLib::VertexP3N3G3B3T2*) pDequantizedVertices );
+
+		m_pQuantizedVertices = (const BaseLib::QuantizedVertex*) m_pVertices;
+		m_OwnsQuantizedVertices = m_OwnsVertices;
+		m_pVertices = pDequantizedVertices;
+		m_OwnsVertices = true;
+		m_VertexFormat = P3N3G3B3T2;
+	}
+}
+
+void	Scene::Mesh::Primitive::Optimize( BaseLib::VertexCacheStatistics* _pBefore, BaseLib::VertexCacheStatistics* _pAfter ) {
+	ASSERT( m_VertexFormat == P3N3G3B3T2, "Unsupported vertex format!" );
+	ASSERT( m_pTag == NULL, "Primitives must be optimized before placing tags!" );
+	ASSERT( m_LODsCount == 0, "Primitives must be optimized before building LODs!" );
+
+	if ( !m_OwnsFaces ) {
+		U32*	pFaces = new U32[3*m_FacesCount];
+		memcpy( pFaces, m_pFaces, 3*m_FacesCount*sizeof(U32) );
+		m_pFaces = pFaces;
+		m_OwnsFaces = true;
+	}
+	if ( !m_OwnsVertices ) {
+		U8*		pVertices = new U8[m_VerticesCount * sizeof(VF_P3N3G3B3T2)];
+		memcpy( pVertices, m_pVertices, m_VerticesCount * sizeof(VF_P3N3G3B3T2) );
+		m_pVertices = pVertices;
+		m_OwnsVertices = true;
+	}
+
+	// The vertices get reordered so the quantized vertices become stale
+	if ( m_OwnsQuantizedVertices )
+		delete[] (U8*) m_pQuantizedVertices;
+	m_pQuantizedVertices = NULL;
+	m_OwnsQuantizedVertices = false;
+
+	m_VerticesCount = BaseLib::OptimizeMesh( (U32*) m_pFaces, 3*m_FacesCount, (void*) m_pVertices, m_VerticesCount, sizeof(VF_P3N3G3B3T2), 0, _pBefore, _pAfter );
+}
+
+void	Scene::Mesh::Primitive::BuildLODs( U32 _MaxLODsCount, float _Reduction ) {
+	ASSERT( m_VertexFormat == P3N3G3B3T2, "Unsupported vertex format!" );
+	ASSERT( m_pTag == NULL, "LODs must be built before placing tags!" );
+
+	BaseLib::List<U32>				Indices;
+	BaseLib::List<BaseLib::MeshLOD>	LODs;
+	BaseLib::BuildLODChain( m_pFaces, 3*m_FacesCount, m_pVertices, m_VerticesCount, sizeof(VF_P3N3G3B3T2), Indices, LODs, MIN( _MaxLODsCount, U32(MAX_LODS) ), _Reduction );
+
+	delete[] m_pLODFaces;
+	m_pLODFaces = new U32[MAX( 1U, Indices.Count() )];
+	memcpy( m_pLODFaces, Indices.Ptr(), Indices.Count() * sizeof(U32) );
+
+	m_pLODIndices = m_pLODFaces;
+	m_LODsCount = LODs.Count();
+	for ( U32 LODIndex=0; LODIndex < m_LODsCount; LODIndex++ )
+		m_pLODs[LODIndex] = LODs[LODIndex];
+}
+
+U32		Scene::Mesh::Primitive::SelectLOD( float _Distance, float _ProjectionScale, float _MaxPixelError ) const {
+	return BaseLib::SelectLOD( m_pLODs, m_LODsCount, _Distance, _ProjectionScale, _MaxPixelError );
+}
+
+const U32*	Scene::Mesh::Primitive::GetFaces( U32 _LOD, U32& _FacesCount ) const {
+	ASSERT( _LOD <= m_LODsCount, "LOD index out of range!" );
+	if ( _LOD == 0 ) {
+		_FacesCount = m_FacesCount;
+		return m_pFaces;
+	}
+	_FacesCount = m_pLODs[_LOD-1].IndicesCount / 3;
+	return m_pLODIndices + m_pLODs[_LOD-1].IndicesOffset;
+}
+
 
 // ==== Probe ====
 Scene::Probe::Probe( Scene& _Owner, Node* _pParent )
@@ -455,6 +1082,7 @@ Scene::Probe::Probe( Scene& _Owner, Node* _pParent )
 Scene::Material::Material( Scene& _Owner )
 	: m_Owner( _Owner )
 	, m_ID( ~0 )
+	, m_Ambient( float3::Zero )
 	, m_pTag( NULL ) {
 }
 
@@ -484,6 +1112,17 @@ void	Scene::Material::Init( const U8*& _pData ) {
 	ReadEndMaterialMarker( _pData );
 }
 
+void	Scene::Material::Init( const FileMaterial& _Material ) {
+	m_ID = _Material.ID;
+	m_DiffuseAlbedo = _Material.DiffuseAlbedo;
+	m_TexDiffuseAlbedo.m_ID = _Material.TexDiffuseAlbedoID;
+	m_SpecularAlbedo = _Material.SpecularAlbedo;
+	m_TexSpecularAlbedo.m_ID = _Material.TexSpecularAlbedoID;
+	m_SpecularExponent = _Material.SpecularExponent;
+	m_TexNormal.m_ID = _Material.TexNormalID;
+	m_EmissiveColor = _Material.EmissiveColor;
+}
+
 void	Scene::Material::Exit() {
 }
 
@@ -1,17 +1,127 @@
 //////////////////////////////////////////////////////////////////////////
 // Loads a binary GCX scene generated by the FBXTestConverter tool
 //
+// Two versions of the format are supported:
+//	. GCX1 is a stream of variable-size records that must be parsed field by field, indices and vertices are copied into new buffers
+//	. GCX2 stores fixed-size tables of materials, nodes and primitives followed by the index and vertex arrays, all 16-bytes aligned
+//		and addressed by their offset from the start of the scene. Primitives point straight into the scene data without any copy.
+//		All the counts and offsets are checked against the size of the data at load time, invalid scenes are rejected.
+//		The header carries a version that must match GCX2_VERSION exactly: bump it whenever one of the File* structures changes.
+//		Use GCXFormat.Scene.ConvertGCX1ToGCX2() to convert existing scenes.
+//		Primitives can also store a chain of LODs sharing their vertices, with the error bound of each LOD.
+//		QUANTIZED vertices are decoded into 56-bytes P3N3G3B3T2 vertices at load time for the CPU, but the 20-bytes quantized vertices
+//		are kept along (cf. Mesh::Primitive::m_pQuantizedVertices) so renderers can upload them as is and decode them in the vertex shader
+//		(cf. VertexFormatQuantized and QUANTIZED_VERTICES in GI.hlsl). Compressed index/vertex arrays are decoded at load time.
+//		Such primitives aren't used in place. Use SaveGCX2() with SAVE_QUANTIZE_VERTICES and/or SAVE_COMPRESS to produce them.
+//
+// LODs are meant to be baked offline: load the scene, call OptimizePrimitives() then BuildLODs() and write it back with SaveGCX2()
+//	(cf. BAKE_SCENE in EffectGlobalIllum2.cpp). LODs missing from the scene data can still be built at load time with BuildLODs().
+//	Mesh::Primitive::SelectLOD() then picks the LOD to render from the projected error (cf. BaseLib/Utility/MeshSimplifier.h).
+//
 #pragma once
 
+#include "../BaseLib/Utility/MeshSimplifier.h"
+
+namespace BaseLib { struct VertexCacheStatistics; struct QuantizedVertex; }
+
 class	Scene
 {
 protected:	// CONSTANTS
 
+	static const U32	GCX1_MAGIC = 0x31584347;	// "GCX1"
+	static const U32	GCX2_MAGIC = 0x32584347;	// "GCX2"
+	static const U32	GCX2_VERSION = 3;			// Version 1 had no version field and 80-bytes primitives without compression nor LODs, version 2 stored RMS quadric errors in the LODs
+
 public:		// NESTED TYPES
 
 	class ISceneTagger;
 	class Material;
 
+	enum	SAVE_FLAGS {
+		SAVE_QUANTIZE_VERTICES = 1,	// Store QUANTIZED vertices (cf. above)
+		SAVE_COMPRESS = 2,			// Compress the indices and vertices of each primitive (LODs are always stored raw)
+	};
+
+	// ==== GCX2 binary layout ====
+	// All offsets are in bytes from the start of the scene data, all IDs and indices are ~0U when invalid
+	struct	FileHeader
+	{
+		U32			Magic;				// "GCX2"
+		U32			Version;			// GCX2_VERSION, scenes of any other version are rejected
+		U32			Size;				// Total size of the scene data
+		U32			MaterialsCount;
+		U32			MaterialsOffset;	// Offset to an array of FileMaterial
+		U32			NodesCount;
+		U32			NodesOffset;		// Offset to an array of FileNode, root is node 0
+		U32			PrimitivesCount;
+		U32			PrimitivesOffset;	// Offset to an array of FilePrimitive
+	};
+
+	struct	FileMaterial
+	{
+		U32			ID;
+		float3		DiffuseAlbedo;
+		U32			TexDiffuseAlbedoID;
+		float3		SpecularAlbedo;
+		U32			TexSpecularAlbedoID;
+		float3		SpecularExponent;
+		U32			TexNormalID;
+		float3		EmissiveColor;
+	};
+
+	struct	FileNode
+	{
+		float4x4	Local2Parent;
+		U32			Type;				// One of Node::TYPE
+		U32			ParentIndex;
+		U32			FirstChildIndex;	// The children of a node are contiguous in the table
+		U32			ChildrenCount;
+		union {
+			struct {
+				U32		FirstPrimitiveIndex;	// The primitives of a mesh are contiguous in the table
+				U32		PrimitivesCount;
+			}		AsMesh;
+			struct {
+				U32		LightType;
+				float	Color[3];
+				float	Intensity;
+				float	HotSpot;
+				float	Falloff;
+			}		AsLight;
+			struct {
+				float	FOV;
+			}		AsCamera;
+			U32		pPadding[8];
+		};
+	};
+
+	struct	FilePrimitive
+	{
+		U32			MaterialIndex;		// Index in the materials table (mandatory)
+		U32			FacesCount;
+		U32			VerticesCount;
+		U32			VertexFormat;		// One of Mesh::Primitive::VERTEX_FORMAT
+		U32			IndicesOffset;		// Offset to 3*FacesCount U32 indices
+		U32			VerticesOffset;		// Offset to VerticesCount vertices
+		U32			IndicesSize;		// Size of the indices compressed by BaseLib::EncodeIndexBuffer(), 0 if stored raw
+		U32			VerticesSize;		// Size of the vertices compressed by BaseLib::EncodeVertexBuffer(), 0 if stored raw
+		float3		LocalBBoxMin;
+		float3		LocalBBoxMax;
+		float3		GlobalBBoxMin;		// Precomputed from the transformed vertices
+		float3		GlobalBBoxMax;
+		U32			LODsCount;			// 0 if the primitive has no LODs
+		U32			LODsOffset;			// Offset to LODsCount FileLOD, from the finest to the coarsest
+		U32			pPadding[2];
+	};
+
+	struct	FileLOD
+	{
+		U32			FacesCount;
+		U32			IndicesOffset;		// Offset to 3*FacesCount raw U32 indices into the vertices of the primitive
+		float		Error;				// Error bound relative to the full detail primitive, in local space
+		U32			Padding;
+	};
+
 	class	Node
 	{
 	public:
@@ -43,12 +153,14 @@ public:		// NESTED TYPES
 		~Node();
 
 		void			Init( const U8*& _pData );
+		void			Init( const FileNode& _Node );
 		void			Exit();
 
 		void			PlaceTag( ISceneTagger& _SceneTagger );
 
 		// Override this in your inherited classes to init/exit specific details of the node
 		virtual void	InitSpecific( const U8*& _pData )				{}
+		virtual void	InitSpecific( const FileNode& _Node )			{}
 		virtual void	ExitSpecific()									{}
 		virtual void	PlaceTagSpecific( ISceneTagger& _SceneTagger )	{}
 
@@ -75,6 +187,7 @@ public:		// NESTED TYPES
 		~Light();
 
 		virtual void	InitSpecific( const U8*& _pData ) override;
+		virtual void	InitSpecific( const FileNode& _Node ) override;
 
 		friend class Scene;
 	};
@@ -91,6 +204,7 @@ public:		// NESTED TYPES
 		~Camera();
 
 		virtual void	InitSpecific( const U8*& _pData ) override;
+		virtual void	InitSpecific( const FileNode& _Node ) override;
 
 		friend class Scene;
 	};
@@ -110,15 +224,27 @@ public:		// NESTED TYPES
 			float3				m_GlobalBBoxMax;
 
 			U32					m_FacesCount;
-			U32*				m_pFaces;
+			const U32*			m_pFaces;
+
+			static const U32	MAX_LODS = BaseLib::MAX_MESH_LODS;
+			U32					m_LODsCount;
+			BaseLib::MeshLOD	m_pLODs[MAX_LODS];	// Errors are relative to the full detail faces, in local space
+			const U32*			m_pLODIndices;	// The indices of m_pLODs[i] start at m_pLODIndices + m_pLODs[i].IndicesOffset
+			U32*				m_pLODFaces;	// Faces of the LODs built at runtime, NULL when the LODs point into GCX2 scene data
 
 			enum	VERTEX_FORMAT
 			{
 				P3N3G3B3T2,		// Position3, Normal3, Tangent3, BiTangent3, UV2
+				QUANTIZED,		// BaseLib::QuantizedVertex, storage only: decoded into P3N3G3B3T2 at load time (cf. m_pQuantizedVertices)
 
 			}					m_VertexFormat;
 			U32					m_VerticesCount;
-			void*				m_pVertices;
+			const void*			m_pVertices;
+			const BaseLib::QuantizedVertex*	m_pQuantizedVertices;	// The QUANTIZED vertices m_pVertices were decoded from, relative to the local bounding box. NULL if the primitive wasn't quantized
+
+			bool				m_OwnsFaces;	// False when the faces point into GCX2 scene data
+			bool				m_OwnsVertices;	// False when the vertices point into GCX2 scene data
+			bool				m_OwnsQuantizedVertices;	// False when the quantized vertices point into GCX2 scene data
 
 			void*				m_pTag;	// Custom user tag filled with anything the user needs to render the node
 
@@ -130,11 +256,29 @@ public:		// NESTED TYPES
 				float2	T;
 			};
 
+			// Reorders the faces and vertices for the vertex cache, overdraw and vertex fetch (cf. BaseLib/Utility/MeshOptimizer.h)
+			// GCX2 data are copied first since the scene data are read-only. Must be called before placing tags!
+			void			Optimize( BaseLib::VertexCacheStatistics* _pBefore=NULL, BaseLib::VertexCacheStatistics* _pAfter=NULL );
+
+			// Builds a chain of simplified LODs sharing the vertices of the primitive, each one having about _Reduction times the faces of the previous one
+			// Must be called after Optimize() and before placing tags!
+			void			BuildLODs( U32 _MaxLODsCount=MAX_LODS, float _Reduction=0.5f );
+
+			// Selects the coarsest LOD whose projected error stays below _MaxPixelError (cf. BaseLib::SelectLOD())
+			//	_Distance, the distance from the camera to the primitive in local space
+			//	_ProjectionScale, cf. BaseLib::ComputeLODProjectionScale()
+			// Returns 0 for the full detail faces or i+1 for m_pLODs[i]
+			U32				SelectLOD( float _Distance, float _ProjectionScale, float _MaxPixelError ) const;
+
+			// Returns the faces of a LOD as returned by SelectLOD()
+			const U32*		GetFaces( U32 _LOD, U32& _FacesCount ) const;
+
 		private:
 			Primitive();
 			~Primitive();
 
 			void			Init( Mesh& _Owner, const U8*& _pData );
+			void			Init( Mesh& _Owner, const FilePrimitive& _Primitive );
 
 			friend class Mesh;
 		};
@@ -155,6 +299,7 @@ public:		// NESTED TYPES
 		~Mesh();
 
 		virtual void	InitSpecific( const U8*& _pData ) override;
+		virtual void	InitSpecific( const FileNode& _Node ) override;
 		virtual void	PlaceTagSpecific( ISceneTagger& _SceneTagger ) override;
 
 		friend class Scene;
@@ -204,6 +349,7 @@ public:		// NESTED TYPES
 		Material( Scene& _Owner );
 
 		void	Init( const U8*& _pData );
+		void	Init( const FileMaterial& _Material );
 		void	Exit();
 
 		void	PlaceTag( ISceneTagger& _SceneTagger );
@@ -261,6 +407,9 @@ public:		// FIELDS
 
 	const ISceneTagger*	m_pSceneTagger;
 
+	const U8*			m_pData;	// GCX2 scene data the primitives point into (NULL for GCX1 scenes)
+	U8*					m_pOwnedData;	// Allocated copy of GCX2 scene data that wasn't 16-bytes aligned in memory (m_pData points into it)
+
 
 public:		// METHODS
 
@@ -268,7 +417,21 @@ public:		// METHODS
 	~Scene();	// WARNING: Call "ClearTags" to dispose of your tags prior destruction!
 
 
-	void			Load( U16 _SceneResourceID );
+	// Both return false if the scene data are invalid, in which case the scene is left empty
+	bool			Load( U16 _SceneResourceID );
+
+	// Loads a scene from memory (e.g. a memory-mapped file)
+	// WARNING: GCX2 scenes are used in place so the data must outlive the scene! (unless they're not 16-bytes aligned, in which case they're copied)
+	bool			Load( const U8* _pData, U32 _Size );
+	// Optimizes all the mesh primitives, optionally returns the vertex cache statistics of the whole scene before and after
+	// Must be called before placing tags!
+	void			OptimizePrimitives( BaseLib::VertexCacheStatistics* _pBefore=NULL, BaseLib::VertexCacheStatistics* _pAfter=NULL );
+	// Builds the LODs of all the primitives that don't have any yet, primitives are processed in parallel
+	// Must be called after OptimizePrimitives() and before placing tags!
+	void			BuildLODs( U32 _MaxLODsCount=Mesh::Primitive::MAX_LODS, float _Reduction=0.5f );
+	// Writes the scene as GCX2 with its current primitives and their LODs, so a scene optimized and simplified once can be loaded as is
+	//	_Flags, a combination of SAVE_FLAGS
+	bool			SaveGCX2( const char* _pFileName, U32 _Flags=0 ) const;
 	void			PlaceTags( ISceneTagger& _SceneTagger );
 	void			Render( ISceneRenderer& _SceneRenderer, bool _SetMaterial=true ) const;
 	void			Exit();
@@ -288,7 +451,12 @@ private:
 	void			ForEach( IVisitor& _Visitor, Node* _pParent );
 
 	// Helpers
+	void			LoadGCX1( const U8* _pData );
+	void			LoadGCX2( const U8* _pData );
+	static bool		IsValidGCX2( const U8* _pData, U32 _Size );
 	Node*			CreateNode( Node* _pParent, const U8*& _pData );
+	Node*			CreateNode( Node* _pParent, const FileNode* _pNodes, U32 _NodeIndex );
+	static Node*	CreateNode( Scene& _Owner, Node* _pParent, Node::TYPE _Type );
 	static U32		ReadU16( const U8*& _pData, bool _IsID=false );
 	static U32		ReadU32( const U8*& _pData );
 	static float	ReadF32( const U8*& _pData );
@@ -0,0 +1,1963 @@
+// TestBaseLibBenchmarks.cpp : Measures the performance of BaseLib's containers and algorithms
+//
+
+#include "stdafx.h"
+#include "../../BaseLib/Containers/ParallelSort.h"
+#include "../../BaseLib/Containers/StaticSpatialHashing.h"
+#include "../../BaseLib/Utility/Compression.h"
+#include "../../BaseLib/Utility/VertexCompression.h"
+#include "../../BaseLib/Utility/MeshOptimizer.h"
+#include "../../BaseLib/Utility/MeshSimplifier.h"
+#include "../../Packages/MathSolvers/MathSolvers.h"
+
+// The framework's octree names the BaseLib vector types without their prefix
+typedef bfloat3	float3;
+typedef bfloat4	float4;
+#include "../../Utility/Octree.h"
+
+#include <float.h>
+
+using namespace BaseLib;
+using namespace MathSolvers;
+
+// Simple high-resolution timer
+class	Timer {
+	LARGE_INTEGER	m_Frequency;
+	LARGE_INTEGER	m_Start;
+
+public:
+	Timer()							{ QueryPerformanceFrequency( &m_Frequency ); Start(); }
+	void	Start()					{ QueryPerformanceCounter( &m_Start ); }
+	double	GetElapsedMilliseconds() const {
+		LARGE_INTEGER	Now;
+		QueryPerformanceCounter( &Now );
+		return 1000.0 * double(Now.QuadPart - m_Start.QuadPart) / double(m_Frequency.QuadPart);
+	}
+};
+
+static volatile U32	gs_BenchmarkSink = 0;
+
+// Correctness checks performed next to the timings, unlike ASSERT() they're also active in the release builds we measure
+static U32	gs_FailedChecksCount = 0;
+#define CHECK( condition, text )	if ( !(condition) ) { printf( "CHECK FAILED: %s (line %d)\n", text, __LINE__ ); gs_FailedChecksCount++; }
+
+// Deterministic pseudo-random numbers so all the benchmarks process the same data
+class	BenchmarkRandom {
+	U32		m_State;
+public:
+	BenchmarkRandom( U32 _Seed ) : m_State( _Seed ) {}
+	U32		Next()	{ m_State = 1664525U * m_State + 1013904223U; return m_State ^ (m_State >> 16); }
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// 1] Sorting
+//
+struct	SortElement {
+	U32		Key;
+	U32		Value;
+};
+
+class	SortElementComparer : public IComparer<SortElement> {
+public:	virtual int		Compare( const SortElement& a, const SortElement& b ) const	{ return a.Key < b.Key ? +1 : (a.Key > b.Key ? -1 : 0); }
+};
+
+struct	SortElementLess {
+	bool	operator()( const SortElement& a, const SortElement& b ) const	{ return a.Key < b.Key; }
+};
+
+struct	SortElementKey {
+	U32		operator()( const SortElement& _Element ) const	{ return _Element.Key; }
+};
+
+static int	CompareSortElements( const void* _pA, const void* _pB ) {
+	U32	A = ((const SortElement*) _pA)->Key;
+	U32	B = ((const SortElement*) _pB)->Key;
+	return A < B ? -1 : (A > B ? 1 : 0);
+}
+
+// The bubble sort List<T>::Sort() used to implement, kept as a reference
+static void	LegacyBubbleSort( SortElement* _pArray, U32 _Count, const IComparer<SortElement>& _Comparer ) {
+	for ( U32 i=0; i+1 < _Count; i++ ) {
+		SortElement&	a = _pArray[i];
+		for ( U32 j=i; j < _Count; j++ ) {
+			SortElement&	b = _pArray[j];
+			if ( _Comparer.Compare( a, b ) < 0 ) {
+				SortElement	Temp = a;
+				a = b;
+				b = Temp;
+			}
+		}
+	}
+}
+
+static bool	IsSorted( const SortElement* _pArray, U32 _Count ) {
+	for ( U32 i=1; i < _Count; i++ )
+		if ( _pArray[i].Key < _pArray[i-1].Key )
+			return false;
+	return true;
+}
+
+// Sorted and still holding each of the original values exactly once
+static bool	IsSortedPermutation( const SortElement* _pArray, U32 _Count ) {
+	if ( !IsSorted( _pArray, _Count ) )
+		return false;
+	List<bool>	Seen;
+	Seen.SetCount( _Count );
+	memset( Seen.Ptr(), 0, _Count * sizeof(bool) );
+	for ( U32 i=0; i < _Count; i++ ) {
+		U32	Value = _pArray[i].Value;
+		if ( Value >= _Count || Seen[Value] )
+			return false;
+		Seen[Value] = true;
+	}
+	return true;
+}
+
+static void	BenchmarkSort() {
+	static const U32	MAX_BUBBLE_SORT_COUNT = 10000;	// Don't wait forever...
+	static const U32	pCounts[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+	printf( "Sorting (milliseconds)\n" );
+	printf( "%10s %12s %12s %12s %12s %12s %12s\n", "Count", "Bubble", "List::Sort", "qsort", "IntroSort", "RadixSort32", "ParallelMerge" );
+
+	for ( U32 CountIndex=0; CountIndex < sizeof(pCounts)/sizeof(pCounts[0]); CountIndex++ ) {
+		U32	Count = pCounts[CountIndex];
+
+		SortElement*	pSource = new SortElement[Count];
+		SortElement*	pArray = new SortElement[Count];
+		SortElement*	pTemp = new SortElement[Count];
+
+		BenchmarkRandom	RNG( 1 );
+		for ( U32 i=0; i < Count; i++ ) {
+			pSource[i].Key = RNG.Next();
+			pSource[i].Value = i;
+		}
+
+		Timer	T;
+		double	pTimings[6] = { -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 };
+
+		// Legacy bubble sort
+		if ( Count <= MAX_BUBBLE_SORT_COUNT ) {
+			memcpy( pArray, pSource, Count*sizeof(SortElement) );
+			T.Start();
+			LegacyBubbleSort( pArray, Count, SortElementComparer() );
+			pTimings[0] = T.GetElapsedMilliseconds();
+			CHECK( IsSortedPermutation( pArray, Count ), "Bubble sort failed!" );
+		}
+
+		// List::Sort() with a virtual comparer
+		{
+			List<SortElement>	L( Count );
+			L.SetCount( Count );
+			memcpy( L.Ptr(), pSource, Count*sizeof(SortElement) );
+			T.Start();
+			L.Sort( SortElementComparer() );
+			pTimings[1] = T.GetElapsedMilliseconds();
+			CHECK( IsSortedPermutation( L.Ptr(), Count ), "List::Sort() failed!" );
+		}
+
+		// CRT qsort
+		memcpy( pArray, pSource, Count*sizeof(SortElement) );
+		T.Start();
+		qsort( pArray, Count, sizeof(SortElement), CompareSortElements );
+		pTimings[2] = T.GetElapsedMilliseconds();
+		CHECK( IsSortedPermutation( pArray, Count ), "qsort() failed!" );
+
+		// IntroSort with an inlined comparator
+		memcpy( pArray, pSource, Count*sizeof(SortElement) );
+		T.Start();
+		IntroSort( pArray, Count, SortElementLess() );
+		pTimings[3] = T.GetElapsedMilliseconds();
+		CHECK( IsSortedPermutation( pArray, Count ), "IntroSort() failed!" );
+
+		// Radix sort
+		memcpy( pArray, pSource, Count*sizeof(SortElement) );
+		T.Start();
+		SortElement*	pSorted = RadixSort32( pArray, Count, SortElementKey(), pTemp );
+		pTimings[4] = T.GetElapsedMilliseconds();
+		CHECK( IsSortedPermutation( pSorted, Count ), "RadixSort32() failed!" );
+		bool	Stable = true;	// Values were assigned in increasing order so equal keys must keep them that way
+		for ( U32 i=1; i < Count; i++ )
+			Stable &= pSorted[i].Key != pSorted[i-1].Key || pSorted[i].Value > pSorted[i-1].Value;
+		CHECK( Stable, "RadixSort32() isn't stable!" );
+
+		// Parallel merge sort
+		memcpy( pArray, pSource, Count*sizeof(SortElement) );
+		T.Start();
+		ParallelMergeSort( pArray, Count, SortElementLess(), pTemp );
+		pTimings[5] = T.GetElapsedMilliseconds();
+		CHECK( IsSortedPermutation( pArray, Count ), "ParallelMergeSort() failed!" );
+
+		printf( "%10d", Count );
+		for ( int i=0; i < 6; i++ ) {
+			if ( pTimings[i] < 0.0 )
+				printf( " %12s", "-" );
+			else
+				printf( " %12.3f", pTimings[i] );
+		}
+		printf( "\n" );
+
+		delete[] pTemp;
+		delete[] pArray;
+		delete[] pSource;
+	}
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 2] List growth
+//
+// Builds many small lists in a row, as the probe network build loops do
+static void	BenchmarkListGrowth() {
+	static const U32	LISTS_COUNT = 10000;
+	static const U32	ELEMENTS_COUNT = 1000;
+
+	printf( "List growth, %d lists of %d elements (milliseconds)\n", LISTS_COUNT, ELEMENTS_COUNT );
+
+	Timer	T;
+	U32		CheckSum = 0;
+	bool	Correct = true;
+
+	// Default heap allocator, geometric growth
+	T.Start();
+	for ( U32 ListIndex=0; ListIndex < LISTS_COUNT; ListIndex++ ) {
+		List<U32>	L;
+		for ( U32 i=0; i < ELEMENTS_COUNT; i++ )
+			L.Append( i );
+		CheckSum += L[ListIndex % ELEMENTS_COUNT];
+		Correct &= L.Count() == ELEMENTS_COUNT && L[ELEMENTS_COUNT-1] == ELEMENTS_COUNT-1;
+	}
+	printf( "%20s %12.3f\n", "Append", T.GetElapsedMilliseconds() );
+
+	// Reserved up front
+	T.Start();
+	for ( U32 ListIndex=0; ListIndex < LISTS_COUNT; ListIndex++ ) {
+		List<U32>	L;
+		L.Reserve( ELEMENTS_COUNT );
+		for ( U32 i=0; i < ELEMENTS_COUNT; i++ )
+			L.Append( i );
+		CheckSum += L[ListIndex % ELEMENTS_COUNT];
+		Correct &= L.Count() == ELEMENTS_COUNT && L[ELEMENTS_COUNT-1] == ELEMENTS_COUNT-1;
+	}
+	printf( "%20s %12.3f\n", "Reserve + Append", T.GetElapsedMilliseconds() );
+
+	// Arena allocator, reset after each list
+	ArenaAllocator	Arena( 64*1024 );
+	T.Start();
+	for ( U32 ListIndex=0; ListIndex < LISTS_COUNT; ListIndex++ ) {
+		{
+			List<U32>	L( Arena );
+			for ( U32 i=0; i < ELEMENTS_COUNT; i++ )
+				L.Append( i );
+			CheckSum += L[ListIndex % ELEMENTS_COUNT];
+			Correct &= L.Count() == ELEMENTS_COUNT && L[ELEMENTS_COUNT-1] == ELEMENTS_COUNT-1;
+		}
+		Arena.Reset();
+	}
+	printf( "%20s %12.3f\n", "Arena + Append", T.GetElapsedMilliseconds() );
+
+	// Batch append
+	U32*	pSource = new U32[ELEMENTS_COUNT];
+	for ( U32 i=0; i < ELEMENTS_COUNT; i++ )
+		pSource[i] = i;
+	T.Start();
+	for ( U32 ListIndex=0; ListIndex < LISTS_COUNT; ListIndex++ ) {
+		List<U32>	L;
+		L.Append( pSource, ELEMENTS_COUNT );
+		CheckSum += L[ListIndex % ELEMENTS_COUNT];
+		Correct &= L.Count() == ELEMENTS_COUNT && L[ELEMENTS_COUNT-1] == ELEMENTS_COUNT-1;
+	}
+	printf( "%20s %12.3f\n", "Append( range )", T.GetElapsedMilliseconds() );
+	delete[] pSource;
+
+	// Each of the 4 loops reads back the value it appended at the same index
+	U32	ExpectedCheckSum = 0;
+	for ( U32 ListIndex=0; ListIndex < LISTS_COUNT; ListIndex++ )
+		ExpectedCheckSum += 4 * (ListIndex % ELEMENTS_COUNT);
+	CHECK( Correct, "Lists have wrong counts or contents!" );
+	CHECK( CheckSum == ExpectedCheckSum, "Wrong list checksum!" );
+
+	printf( "(checksum %d)\n\n", CheckSum );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 3] Hash tables
+//
+// The chained dictionary Dictionary<T> used to implement, kept as a reference
+template<typename T> class	LegacyDictionary {
+	struct	Node {
+		Node*	pNext;
+		U32		Key;
+		T		Value;
+	};
+	Node**	m_ppTable;
+	U32		m_POT;
+
+public:
+	LegacyDictionary( U32 _POT ) : m_POT( _POT ) {
+		m_ppTable = new Node*[1 << m_POT];
+		memset( m_ppTable, 0, (1 << m_POT) * sizeof(Node*) );
+	}
+	~LegacyDictionary() {
+		for ( U32 i=0; i < (1U << m_POT); i++ ) {
+			Node*	pNode = m_ppTable[i];
+			while ( pNode != NULL ) {
+				Node*	pOld = pNode;
+				pNode = pNode->pNext;
+				delete pOld;
+			}
+		}
+		delete[] m_ppTable;
+	}
+	T*		Get( U32 _Key ) const {
+		for ( Node* pNode = m_ppTable[Fibonacci32( _Key, m_POT )]; pNode != NULL; pNode = pNode->pNext )
+			if ( pNode->Key == _Key )
+				return &pNode->Value;
+		return NULL;
+	}
+	T&		Add( U32 _Key ) {
+		U32		Index = Fibonacci32( _Key, m_POT );
+		Node*	pNode = new Node();
+		pNode->Key = _Key;
+		pNode->pNext = m_ppTable[Index];
+		m_ppTable[Index] = pNode;
+		return pNode->Value;
+	}
+};
+
+template<typename DICTIONARY> static void	BenchmarkDictionary( DICTIONARY& _Dictionary, const U32* _pKeys, U32 _Count, double _pTimings[3] ) {
+	Timer	T;
+
+	// Insertion
+	T.Start();
+	for ( U32 i=0; i < _Count; i++ )
+		_Dictionary.Add( _pKeys[i] ) = i;
+	_pTimings[0] = T.GetElapsedMilliseconds();
+
+	// Successful lookups in random order
+	BenchmarkRandom	RNG( 2 );
+	U32				Sum = 0;
+	T.Start();
+	for ( U32 i=0; i < _Count; i++ ) {
+		U32*	pValue = _Dictionary.Get( _pKeys[RNG.Next() % _Count] );
+		Sum += *pValue;
+	}
+	_pTimings[1] = T.GetElapsedMilliseconds();
+
+	// Failed lookups (keys are all even)
+	U32		FoundCount = 0;
+	T.Start();
+	for ( U32 i=0; i < _Count; i++ )
+		FoundCount += _Dictionary.Get( 2*RNG.Next() + 1 ) != NULL ? 1 : 0;
+	_pTimings[2] = T.GetElapsedMilliseconds();
+
+	CHECK( FoundCount == 0, "Found keys that were never added!" );
+	gs_BenchmarkSink += Sum;	// Don't let the compiler optimize lookups away
+
+	// Every key must map to the value it was added with
+	U32		WrongCount = 0;
+	for ( U32 i=0; i < _Count; i++ ) {
+		U32*	pValue = _Dictionary.Get( _pKeys[i] );
+		WrongCount += pValue == NULL || *pValue != i ? 1 : 0;
+	}
+	CHECK( WrongCount == 0, "Keys map to wrong values!" );
+}
+
+static void	BenchmarkHashTables() {
+#ifdef _WIN64
+	static const U32	pCounts[] = { 1000, 1000000, 100000000 };
+#else
+	static const U32	pCounts[] = { 1000, 1000000 };	// 100M entries won't fit in 32-bits address space
+#endif
+	static const U32	MAX_LEGACY_COUNT = 10000000;
+
+	printf( "Hash tables U32 -> U32 (milliseconds)\n" );
+	printf( "%10s %12s %12s %12s %12s %12s %12s\n", "Count", "Legacy Add", "Legacy Get", "Legacy Miss", "Add", "Get", "Miss" );
+
+	for ( U32 CountIndex=0; CountIndex < sizeof(pCounts)/sizeof(pCounts[0]); CountIndex++ ) {
+		U32		Count = pCounts[CountIndex];
+
+		// Unique even keys
+		U32*	pKeys = new U32[Count];
+		BenchmarkRandom	RNG( 1 );
+		{
+			Dictionary<U32>	Unique;
+			Unique.Reserve( Count );
+			for ( U32 i=0; i < Count; ) {
+				U32	Key = 2 * RNG.Next();
+				if ( Unique.Get( Key ) != NULL )
+					continue;
+				Unique.Add( Key );
+				pKeys[i++] = Key;
+			}
+		}
+
+		double	pTimings[6] = { -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 };
+
+		// Legacy chained dictionary, sized to the amount of entries since it can't grow
+		if ( Count <= MAX_LEGACY_COUNT ) {
+			U32	POT = 4;
+			while ( (1U << POT) < Count )
+				POT++;
+			LegacyDictionary<U32>	Legacy( POT );
+			BenchmarkDictionary( Legacy, pKeys, Count, pTimings );
+		}
+
+		// Open-addressing dictionary, growing from the default size
+		{
+			Dictionary<U32>	D;
+			BenchmarkDictionary( D, pKeys, Count, pTimings+3 );
+			CHECK( D.GetEntriesCount() == int(Count), "Wrong amount of entries!" );
+
+			// Remove half the keys, the others must still be found (i.e. no broken probe sequence)
+			U32		WrongCount = 0;
+			for ( U32 i=0; i < Count; i+=2 )
+				WrongCount += D.Remove( pKeys[i] ) ? 0 : 1;
+			for ( U32 i=0; i < Count; i++ ) {
+				U32*	pValue = D.Get( pKeys[i] );
+				WrongCount += (i & 1) == 0 ? (pValue != NULL ? 1 : 0) : (pValue == NULL || *pValue != i ? 1 : 0);
+			}
+			CHECK( WrongCount == 0 && D.GetEntriesCount() == int(Count/2), "Removal failed!" );
+		}
+
+		printf( "%10d", Count );
+		for ( int i=0; i < 6; i++ ) {
+			if ( pTimings[i] < 0.0 )
+				printf( " %12s", "-" );
+			else
+				printf( " %12.3f", pTimings[i] );
+		}
+		printf( "\n" );
+
+		delete[] pKeys;
+	}
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 4] Spatial hashing
+//
+// Random points in a cube with an average of 1 point per cell, queried with a radius of 1 cell and for the 8 nearest neighbors
+static void	BenchmarkSpatialHashing() {
+#ifdef _WIN64
+	static const U32	pCounts[] = { 100000, 1000000, 10000000 };
+#else
+	static const U32	pCounts[] = { 100000, 1000000 };
+#endif
+	static const U32	MAX_LEGACY_COUNT = 1000000;
+	static const U32	QUERIES_COUNT = 100000;
+	static const U32	K = 8;
+
+	printf( "Spatial hashing, %d queries (milliseconds)\n", QUERIES_COUNT );
+	printf( "%10s %12s %12s %12s %12s %12s\n", "Count", "Legacy Add", "Build", "Radius", "k-NN", "Neighbors" );
+
+	for ( U32 CountIndex=0; CountIndex < sizeof(pCounts)/sizeof(pCounts[0]); CountIndex++ ) {
+		U32		Count = pCounts[CountIndex];
+		float	Size = powf( float(Count), 1.0f / 3.0f );
+
+		BenchmarkRandom	RNG( 1 );
+		bfloat3*	pPositions = new bfloat3[Count];
+		U32*		pValues = new U32[Count];
+		for ( U32 i=0; i < Count; i++ ) {
+			pPositions[i].Set( Size * (RNG.Next() & 0xFFFF) / 65536.0f, Size * (RNG.Next() & 0xFFFF) / 65536.0f, Size * (RNG.Next() & 0xFFFF) / 65536.0f );
+			pValues[i] = i;
+		}
+
+		double	pTimings[4] = { -1.0, -1.0, -1.0, -1.0 };
+		Timer	T;
+
+		// Legacy linked-list table, one entry at a time
+		if ( Count <= MAX_LEGACY_COUNT ) {
+			SpatialHashing<U32>	Legacy;
+			T.Start();
+			Legacy.Init( Count );
+			for ( U32 i=0; i < Count; i++ )
+				Legacy.Add( pPositions[i], pValues[i] );
+			pTimings[0] = T.GetElapsedMilliseconds();
+		}
+
+		// Bulk build
+		StaticSpatialHashing<U32>	Table;
+		T.Start();
+		Table.Build( pPositions, pValues, Count, bfloat3::One );
+		pTimings[1] = T.GetElapsedMilliseconds();
+
+		// Radius queries
+		List<U32>	Results( 64 );
+		U32			NeighborsCount = 0;
+		T.Start();
+		for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+			Results.Clear();
+			Table.FindAllInRadius( pPositions[RNG.Next() % Count], 1.0f, Results );
+			NeighborsCount += Results.Count();
+		}
+		pTimings[2] = T.GetElapsedMilliseconds();
+
+		// k-NN queries
+		U32		pNearest[K];
+		float	pSqDistances[K];
+		U32		Sum = 0;
+		T.Start();
+		for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+			U32	FoundCount = Table.FindNearest( pPositions[RNG.Next() % Count], K, pNearest, pSqDistances );
+			Sum += pNearest[FoundCount-1];
+		}
+		pTimings[3] = T.GetElapsedMilliseconds();
+		gs_BenchmarkSink += Sum;
+
+		// Compare a few queries against brute force
+		U32		WrongCount = 0;
+		for ( U32 QueryIndex=0; QueryIndex < 16; QueryIndex++ ) {
+			bfloat3	Position = pPositions[RNG.Next() % Count];
+			Results.Clear();
+			Table.FindAllInRadius( Position, 1.0f, Results );
+			U32		FoundCount = Table.FindNearest( Position, K, pNearest, pSqDistances );
+
+			U32		InRadiusCount = 0;
+			float	pBestSqDistances[K];
+			for ( U32 k=0; k < K; k++ )
+				pBestSqDistances[k] = FLT_MAX;
+			for ( U32 i=0; i < Count; i++ ) {
+				float	SqDistance = (pPositions[i] - Position).LengthSq();
+				InRadiusCount += SqDistance <= 1.0f ? 1 : 0;
+				for ( U32 k=0; k < K; k++ )
+					if ( SqDistance < pBestSqDistances[k] ) {
+						for ( U32 l=K-1; l > k; l-- )
+							pBestSqDistances[l] = pBestSqDistances[l-1];
+						pBestSqDistances[k] = SqDistance;
+						break;
+					}
+			}
+
+			WrongCount += Results.Count() != InRadiusCount ? 1 : 0;
+			WrongCount += FoundCount != K ? 1 : 0;
+			for ( U32 k=0; k < FoundCount; k++ )
+				WrongCount += pSqDistances[k] != pBestSqDistances[k] ? 1 : 0;
+		}
+		CHECK( WrongCount == 0, "Spatial queries differ from brute force!" );
+
+		printf( "%10d", Count );
+		for ( int i=0; i < 4; i++ ) {
+			if ( pTimings[i] < 0.0 )
+				printf( " %12s", "-" );
+			else
+				printf( " %12.3f", pTimings[i] );
+		}
+		printf( " %12.2f\n", float(NeighborsCount) / QUERIES_COUNT );
+
+		delete[] pValues;
+		delete[] pPositions;
+	}
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 5] Math
+//
+// The scalar matrix product and vertex transform Math.cpp used to implement, kept as a reference
+static float4x4	ScalarMul( const float4x4& a, const float4x4& b ) {
+	float4x4	R;
+	for ( int i=0; i < 4; i++ ) {
+		R.r[i].x = a.r[i].x * b.r[0].x + a.r[i].y * b.r[1].x + a.r[i].z * b.r[2].x + a.r[i].w * b.r[3].x;
+		R.r[i].y = a.r[i].x * b.r[0].y + a.r[i].y * b.r[1].y + a.r[i].z * b.r[2].y + a.r[i].w * b.r[3].y;
+		R.r[i].z = a.r[i].x * b.r[0].z + a.r[i].y * b.r[1].z + a.r[i].z * b.r[2].z + a.r[i].w * b.r[3].z;
+		R.r[i].w = a.r[i].x * b.r[0].w + a.r[i].y * b.r[1].w + a.r[i].z * b.r[2].w + a.r[i].w * b.r[3].w;
+	}
+	return R;
+}
+
+static bfloat3	ScalarTransformPosition( const bfloat3& a, const float4x4& b ) {
+	return bfloat3(	a.x * b.r[0].x + a.y * b.r[1].x + a.z * b.r[2].x + b.r[3].x,
+					a.x * b.r[0].y + a.y * b.r[1].y + a.z * b.r[2].y + b.r[3].y,
+					a.x * b.r[0].z + a.y * b.r[1].z + a.z * b.r[2].z + b.r[3].z );
+}
+
+static void	BenchmarkMath() {
+	static const U32	MATRICES_COUNT = 1 << 16;
+	static const U32	VERTICES_COUNT = 1 << 20;
+
+	BenchmarkRandom	RNG( 1 );
+	float4x4*	pMatrices = new float4x4[MATRICES_COUNT];
+	float4x4*	pResults = new float4x4[MATRICES_COUNT];
+	float4x4*	pReferences = new float4x4[MATRICES_COUNT];
+	for ( U32 i=0; i < MATRICES_COUNT; i++ ) {
+		pMatrices[i].BuildPRS( bfloat3( (RNG.Next() & 0xFF) / 16.0f, (RNG.Next() & 0xFF) / 16.0f, (RNG.Next() & 0xFF) / 16.0f ), bfloat4::QuatFromAngleAxis( (RNG.Next() & 0xFFFF) / 10000.0f, bfloat3( 1, 2, 3 ).Normalize() ) );
+	}
+
+	bfloat3*	pPositions = new bfloat3[VERTICES_COUNT];
+	bfloat3*	pTransformed = new bfloat3[VERTICES_COUNT];
+	bfloat3*	pReferencePositions = new bfloat3[VERTICES_COUNT];
+	for ( U32 i=0; i < VERTICES_COUNT; i++ )
+		pPositions[i].Set( (RNG.Next() & 0xFFFF) / 65536.0f, (RNG.Next() & 0xFFFF) / 65536.0f, (RNG.Next() & 0xFFFF) / 65536.0f );
+	memset( pReferences, 0, MATRICES_COUNT * sizeof(float4x4) );	// Make sure the pages are committed before timing
+	memset( pReferencePositions, 0, VERTICES_COUNT * sizeof(bfloat3) );
+
+	printf( "Math, %d matrices, %d vertices (milliseconds)\n", MATRICES_COUNT, VERTICES_COUNT );
+	printf( "%20s %12s %12s\n", "", "Scalar", "Math.h" );
+
+	Timer	T;
+	double	pTimings[2];
+
+	// Matrix products
+	T.Start();
+	for ( U32 i=1; i < MATRICES_COUNT; i++ )
+		pReferences[i] = ScalarMul( pMatrices[i-1], pMatrices[i] );
+	pTimings[0] = T.GetElapsedMilliseconds();
+	T.Start();
+	for ( U32 i=1; i < MATRICES_COUNT; i++ )
+		pResults[i] = pMatrices[i-1] * pMatrices[i];
+	pTimings[1] = T.GetElapsedMilliseconds();
+	printf( "%20s %12.3f %12.3f\n", "Matrix x Matrix", pTimings[0], pTimings[1] );
+
+	float	MaxError = 0.0f;	// Entries are at most 16 * 16
+	for ( U32 i=1; i < MATRICES_COUNT; i++ )
+		for ( U32 j=0; j < 16; j++ )
+			MaxError = MAX( MaxError, fabsf( (&pResults[i].r[0].x)[j] - (&pReferences[i].r[0].x)[j] ) );
+	CHECK( MaxError < 1e-3f, "Matrix products differ from the scalar reference!" );
+
+	// Inverses (the scalar reference is the co-factors version, still available with MATH_SCALAR)
+	T.Start();
+	for ( U32 i=0; i < MATRICES_COUNT; i++ )
+		pResults[i] = pMatrices[i].Inverse();
+	pTimings[1] = T.GetElapsedMilliseconds();
+	printf( "%20s %12s %12.3f\n", "Inverse", "-", pTimings[1] );
+
+	MaxError = 0.0f;
+	for ( U32 i=0; i < MATRICES_COUNT; i++ ) {
+		float4x4	Identity = ScalarMul( pMatrices[i], pResults[i] );
+		for ( U32 j=0; j < 16; j++ )
+			MaxError = MAX( MaxError, fabsf( (&Identity.r[0].x)[j] - ((j % 5) == 0 ? 1.0f : 0.0f) ) );
+	}
+	CHECK( MaxError < 1e-4f, "M.M^-1 isn't the identity!" );
+
+	// Vertex transforms
+	T.Start();
+	for ( U32 i=0; i < VERTICES_COUNT; i++ )
+		pReferencePositions[i] = ScalarTransformPosition( pPositions[i], pMatrices[1] );
+	pTimings[0] = T.GetElapsedMilliseconds();
+	T.Start();
+	TransformPositions( pMatrices[1], pPositions, pTransformed, VERTICES_COUNT );
+	pTimings[1] = T.GetElapsedMilliseconds();
+	printf( "%20s %12.3f %12.3f\n", "Transform positions", pTimings[0], pTimings[1] );
+
+	MaxError = 0.0f;
+	for ( U32 i=0; i < VERTICES_COUNT; i++ )
+		MaxError = MAX( MaxError, (pTransformed[i] - pReferencePositions[i]).Length() );
+	CHECK( MaxError < 1e-4f, "Transformed positions differ from the scalar reference!" );
+
+	T.Start();
+	TransformNormals( pMatrices[1], pPositions, pTransformed, VERTICES_COUNT );
+	pTimings[1] = T.GetElapsedMilliseconds();
+	printf( "%20s %12s %12.3f\n", "Transform normals", "-", pTimings[1] );
+
+	// Rotations only (the matrices have no scaling) so normals are the translated-back positions, renormalized
+	MaxError = 0.0f;
+	for ( U32 i=0; i < VERTICES_COUNT; i++ ) {
+		bfloat3	Reference = pReferencePositions[i] - bfloat3( pMatrices[1].r[3].x, pMatrices[1].r[3].y, pMatrices[1].r[3].z );
+		if ( Reference.LengthSq() > 1e-6f )
+			MaxError = MAX( MaxError, (pTransformed[i] - Reference.Normalize()).Length() );
+	}
+	CHECK( MaxError < 1e-3f, "Transformed normals differ from the scalar reference!" );
+
+	gs_BenchmarkSink += U32( pResults[MATRICES_COUNT-1].r[0].x + pTransformed[VERTICES_COUNT-1].x );
+
+	delete[] pReferencePositions;
+	delete[] pTransformed;
+	delete[] pPositions;
+	delete[] pReferences;
+	delete[] pResults;
+	delete[] pMatrices;
+	printf( "\n" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 6] Half floats
+//
+// Round-trips a 1024x1024 RGBA16F cube map, a plain memcpy() of the half floats gives the memory-bound reference
+static void	BenchmarkHalfFloats() {
+	static const U32	VALUES_COUNT = 6 * 1024 * 1024 * 4;
+
+	BenchmarkRandom	RNG( 1 );
+	float*	pFloats = new float[VALUES_COUNT];
+	half*	pHalves = new half[VALUES_COUNT];
+	half*	pCopy = new half[VALUES_COUNT];
+	float*	pReferences = new float[VALUES_COUNT];
+	for ( U32 i=0; i < VALUES_COUNT; i++ )
+		pFloats[i] = (RNG.Next() & 0xFFFFF) / 4096.0f;
+	memset( pHalves, 0, VALUES_COUNT * sizeof(half) );	// Make sure the pages are committed before timing
+	memset( pCopy, 0, VALUES_COUNT * sizeof(half) );
+	memset( pReferences, 0, VALUES_COUNT * sizeof(float) );
+
+	printf( "Half floats, %d values (milliseconds)\n", VALUES_COUNT );
+	printf( "%20s %12s %12s %12s\n", "", "Per value", "Batched", "memcpy" );
+
+	Timer	T;
+	double	pTimings[3];
+
+	T.Start();
+	for ( U32 i=0; i < VALUES_COUNT; i++ )
+		pHalves[i] = pFloats[i];
+	pTimings[0] = T.GetElapsedMilliseconds();
+	memcpy( pCopy, pHalves, VALUES_COUNT * sizeof(half) );
+	T.Start();
+	FloatToHalf( pFloats, pHalves, VALUES_COUNT );
+	pTimings[1] = T.GetElapsedMilliseconds();
+	CHECK( memcmp( pCopy, pHalves, VALUES_COUNT * sizeof(half) ) == 0, "Batched FloatToHalf() differs from per value conversions!" );
+	T.Start();
+	memcpy( pCopy, pHalves, VALUES_COUNT * sizeof(half) );
+	pTimings[2] = T.GetElapsedMilliseconds();
+	printf( "%20s %12.3f %12.3f %12.3f\n", "Float -> Half", pTimings[0], pTimings[1], pTimings[2] );
+
+	T.Start();
+	for ( U32 i=0; i < VALUES_COUNT; i++ )
+		pReferences[i] = pHalves[i];
+	pTimings[0] = T.GetElapsedMilliseconds();
+	T.Start();
+	HalfToFloat( pHalves, pFloats, VALUES_COUNT );
+	pTimings[1] = T.GetElapsedMilliseconds();
+	CHECK( memcmp( pReferences, pFloats, VALUES_COUNT * sizeof(float) ) == 0, "Batched HalfToFloat() differs from per value conversions!" );
+
+	// Values are below 256 with 12 bits of fraction so the round-trip must be within half a half-float ULP
+	float	MaxRelativeError = 0.0f;
+	BenchmarkRandom	RNGCheck( 1 );
+	for ( U32 i=0; i < VALUES_COUNT; i++ ) {
+		float	Source = (RNGCheck.Next() & 0xFFFFF) / 4096.0f;
+		if ( Source >= 1e-3f )
+			MaxRelativeError = MAX( MaxRelativeError, fabsf( pFloats[i] - Source ) / Source );
+	}
+	CHECK( MaxRelativeError <= 1.0f / 2048.0f, "Half float round-trip error is too large!" );
+	printf( "%20s %12.3f %12.3f %12.3f\n", "Half -> Float", pTimings[0], pTimings[1], pTimings[2] );
+
+	gs_BenchmarkSink += U32( pFloats[VALUES_COUNT-1] ) + pCopy[VALUES_COUNT-1].raw;
+
+	delete[] pReferences;
+	delete[] pCopy;
+	delete[] pHalves;
+	delete[] pFloats;
+	printf( "\n" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 7] Random numbers
+//
+// Each item draws from its own PCG32 stream so the result doesn't depend on the amount of threads
+struct	RandomItemsJob {
+	float*	m_pResults;
+	U32		m_SamplesCount;
+	void	operator()( U32 _Index ) {
+		PCG32	RNG( 1, _Index );
+		float	Sum = 0.0f;
+		for ( U32 i=0; i < m_SamplesCount; i++ )
+			Sum += RNG.NextFloat() * Sobol::OwenScrambled( i, 0, _Index );
+		m_pResults[_Index] = Sum;
+	}
+};
+
+static bool	IsInUnitRange( const float* _pValues, U32 _Count ) {
+	for ( U32 i=0; i < _Count; i++ )
+		if ( _pValues[i] < 0.0f || _pValues[i] >= 1.0f )
+			return false;
+	return true;
+}
+
+static void	BenchmarkRandomNumbers() {
+	static const U32	VALUES_COUNT = 1 << 24;
+	static const U32	ITEMS_COUNT = 1 << 12;
+
+	float*	pValues = new float[VALUES_COUNT];
+	memset( pValues, 0, VALUES_COUNT * sizeof(float) );
+
+	printf( "Random numbers, %d floats (milliseconds)\n", VALUES_COUNT );
+
+	Timer	T;
+	T.Start();
+	for ( U32 i=0; i < VALUES_COUNT; i++ )
+		pValues[i] = _frand();
+	printf( "%20s %12.3f\n", "_frand()", T.GetElapsedMilliseconds() );
+
+	PCG32	PCG( 1 );
+	T.Start();
+	PCG.Fill( pValues, VALUES_COUNT );
+	printf( "%20s %12.3f\n", "PCG32", T.GetElapsedMilliseconds() );
+	CHECK( IsInUnitRange( pValues, VALUES_COUNT ), "PCG32 values out of [0,1)!" );
+
+	Xoshiro128	Xoshiro( 1 );
+	T.Start();
+	Xoshiro.Fill( pValues, VALUES_COUNT );
+	printf( "%20s %12.3f\n", "Xoshiro128**", T.GetElapsedMilliseconds() );
+	CHECK( IsInUnitRange( pValues, VALUES_COUNT ), "Xoshiro128** values out of [0,1)!" );
+
+	T.Start();
+	for ( U32 i=0; i < VALUES_COUNT; i++ )
+		pValues[i] = Sobol::OwenScrambled( i, 1, 1 );
+	printf( "%20s %12.3f\n", "Owen-scrambled Sobol", T.GetElapsedMilliseconds() );
+	CHECK( IsInUnitRange( pValues, VALUES_COUNT ), "Sobol values out of [0,1)!" );
+
+	// Any power of 2 prefix of a (0,1)-sequence has exactly one point in each of the strata
+	U32		pStrata[1024];
+	memset( pStrata, 0, sizeof(pStrata) );
+	for ( U32 i=0; i < 1024; i++ )
+		pStrata[MIN( 1023U, U32( 1024.0f * pValues[i] ) )]++;
+	bool	Stratified = true;
+	for ( U32 i=0; i < 1024; i++ )
+		Stratified &= pStrata[i] == 1;
+	CHECK( Stratified, "Owen-scrambled Sobol isn't stratified!" );
+
+	// Parallel determinism
+	RandomItemsJob	Job;
+	Job.m_SamplesCount = 1024;
+	Job.m_pResults = pValues;
+	T.Start();
+	ParallelFor( ITEMS_COUNT, Job, 16 );
+	double	Timing = T.GetElapsedMilliseconds();
+	Job.m_pResults = pValues + ITEMS_COUNT;
+	ParallelFor( ITEMS_COUNT, Job, 16, 1 );
+	bool	Deterministic = memcmp( pValues, pValues + ITEMS_COUNT, ITEMS_COUNT * sizeof(float) ) == 0;
+	printf( "%20s %12.3f (%s with 1 thread)\n", "Parallel streams", Timing, Deterministic ? "same results" : "DIFFERENT RESULTS" );
+	CHECK( Deterministic, "Parallel streams depend on the amount of threads!" );
+
+	gs_BenchmarkSink += U32( pValues[VALUES_COUNT-1] * 1000.0f );
+
+	delete[] pValues;
+	printf( "\n" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 8] Allocators
+//
+// Temporary lists built for each item of a loop, then linked nodes allocated and freed in random order
+struct	AllocatorNode {
+	AllocatorNode*	pNext;
+	U32				Value;
+	bfloat3			Position;
+};
+
+template<typename T> static U32	FillTemporaryLists( IAllocator& _Allocator, U32 _ItemsCount, BenchmarkRandom& _Random ) {
+	U32	Sum = 0;
+	for ( U32 i=0; i < _ItemsCount; i++ ) {
+		List<T>	Temp( _Allocator, 0 );
+		U32	Count = 1 + (_Random.Next() & 255);
+		for ( U32 j=0; j < Count; j++ )
+			Temp.Append( T( j ) );
+		Sum += Temp.Count();
+	}
+	return Sum;
+}
+
+static void	BenchmarkAllocators() {
+	static const U32	ITEMS_COUNT = 1 << 16;
+	static const U32	NODES_COUNT = 1 << 16;
+	static const U32	NODES_ITERATIONS = 16;
+
+	printf( "Allocators (milliseconds)\n" );
+
+	// Temporary lists
+	BenchmarkRandom	R0( 1 );
+	Timer	T;
+	T.Start();
+	U32		HeapSum = FillTemporaryLists<U32>( GetDefaultAllocator(), ITEMS_COUNT, R0 );
+	printf( "%20s %12.3f\n", "Temp lists heap", T.GetElapsedMilliseconds() );
+
+	BenchmarkRandom	R1( 1 );
+	U32		ArenaSum = 0;
+	T.Start();
+	{
+		ArenaScope	Scope( GetThreadArena() );
+		for ( U32 i=0; i < ITEMS_COUNT; i+=256 ) {
+			ArenaScope	ItemScope( GetThreadArena() );	// Rewinds the arena every 256 items so it stays in the same pages
+			ArenaSum += FillTemporaryLists<U32>( GetThreadArena(), 256, R1 );
+		}
+	}
+	printf( "%20s %12.3f\n", "Temp lists arena", T.GetElapsedMilliseconds() );
+	CHECK( HeapSum == ArenaSum, "Arena lists differ from heap lists!" );
+	gs_BenchmarkSink += HeapSum;
+
+	// Nodes
+	AllocatorNode**	ppNodes = new AllocatorNode*[NODES_COUNT];
+	U32*			pOrder = new U32[NODES_COUNT];
+	BenchmarkRandom	R2( 2 );
+	for ( U32 i=0; i < NODES_COUNT; i++ )
+		pOrder[i] = i;
+	for ( U32 i=NODES_COUNT-1; i > 0; i-- )
+		Swap( pOrder[i], pOrder[R2.Next() % (i+1)] );
+
+	T.Start();
+	for ( U32 Iteration=0; Iteration < NODES_ITERATIONS; Iteration++ ) {
+		for ( U32 i=0; i < NODES_COUNT; i++ )
+			ppNodes[i] = new AllocatorNode();
+		for ( U32 i=0; i < NODES_COUNT; i++ )
+			delete ppNodes[pOrder[i]];
+	}
+	printf( "%20s %12.3f\n", "Nodes new/delete", T.GetElapsedMilliseconds() );
+
+	ObjectPool<AllocatorNode>	Pool( 1024 );
+	T.Start();
+	for ( U32 Iteration=0; Iteration < NODES_ITERATIONS; Iteration++ ) {
+		for ( U32 i=0; i < NODES_COUNT; i++ )
+			ppNodes[i] = Pool.New();
+		for ( U32 i=0; i < NODES_COUNT; i++ )
+			Pool.Delete( ppNodes[pOrder[i]] );
+	}
+	printf( "%20s %12.3f\n", "Nodes pool", T.GetElapsedMilliseconds() );
+
+	// Live pool nodes must never overlap
+	for ( U32 i=0; i < NODES_COUNT; i++ ) {
+		ppNodes[i] = Pool.New();
+		ppNodes[i]->Value = i;
+	}
+	bool	Distinct = true;
+	for ( U32 i=0; i < NODES_COUNT; i++ ) {
+		Distinct &= ppNodes[i]->Value == i;
+		Pool.Delete( ppNodes[i] );
+	}
+	CHECK( Distinct, "Pool returned overlapping nodes!" );
+
+	delete[] pOrder;
+	delete[] ppNodes;
+	printf( "\n" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 9] Streams
+//
+// Writes then reads back a 64MB array of floats, one scalar at a time or as a whole array
+static void	BenchmarkStreams() {
+	static const U32	VALUES_COUNT = 1 << 24;
+	static const char*	FILE_NAME = "BenchmarkStream.bin";
+
+	float*	pValues = new float[VALUES_COUNT];
+	float*	pResults = new float[VALUES_COUNT];
+	for ( U32 i=0; i < VALUES_COUNT; i++ )
+		pValues[i] = float( i & 0xFFF );
+	memset( pResults, 0, VALUES_COUNT * sizeof(float) );
+
+	printf( "Streams, %d floats (milliseconds)\n", VALUES_COUNT );
+
+	Timer	T;
+	T.Start();
+	{
+		FileStream		File( FILE_NAME, FileStream::WRITE );
+		BinaryWriter	W( File );
+		for ( U32 i=0; i < VALUES_COUNT; i++ )
+			W.Write( pValues[i] );
+	}
+	printf( "%20s %12.3f\n", "Write scalars", T.GetElapsedMilliseconds() );
+
+	T.Start();
+	{
+		FileStream		File( FILE_NAME, FileStream::WRITE );
+		BinaryWriter	W( File );
+		W.WriteArray( pValues, VALUES_COUNT );
+	}
+	printf( "%20s %12.3f\n", "Write array", T.GetElapsedMilliseconds() );
+
+	T.Start();
+	{
+		FileStream		File( FILE_NAME, FileStream::READ );
+		BinaryReader	R( File );
+		for ( U32 i=0; i < VALUES_COUNT; i++ )
+			pResults[i] = R.ReadSingle();
+	}
+	printf( "%20s %12.3f\n", "Read scalars", T.GetElapsedMilliseconds() );
+
+	T.Start();
+	{
+		FileStream		File( FILE_NAME, FileStream::READ );
+		BinaryReader	R( File );
+		R.ReadArray( pResults, VALUES_COUNT );
+	}
+	printf( "%20s %12.3f\n", "Read array", T.GetElapsedMilliseconds() );
+
+	float	MappedSum = 0.0f;
+	T.Start();
+	{
+		MappedFileStream	File( FILE_NAME );
+		const float*		pMapped = (const float*) File.Map( VALUES_COUNT * sizeof(float) );
+		float				Sum = 0.0f;
+		for ( U32 i=0; i < VALUES_COUNT; i+=1024 )	// Touch every page
+			Sum += pMapped[i];
+		gs_BenchmarkSink += U32( Sum );
+		MappedSum = Sum;
+	}
+	printf( "%20s %12.3f\n", "Mapped", T.GetElapsedMilliseconds() );
+	float	ExpectedSum = 0.0f;
+	for ( U32 i=0; i < VALUES_COUNT; i+=1024 )
+		ExpectedSum += pValues[i];
+	CHECK( MappedSum == ExpectedSum, "Mapped file content differs!" );
+	DeleteFileA( FILE_NAME );
+
+	bool	Correct = memcmp( pValues, pResults, VALUES_COUNT * sizeof(float) ) == 0;
+	CHECK( Correct, "Read values differ from written values!" );
+
+	// LZ4
+	U32	RawSize = VALUES_COUNT * sizeof(float);
+	U8*	pCompressed = new U8[LZ4CompressBound( RawSize )];
+	T.Start();
+	U32	CompressedSize = LZ4Compress( pValues, RawSize, pCompressed, LZ4CompressBound( RawSize ) );
+	double	CompressionTime = T.GetElapsedMilliseconds();
+	T.Start();
+	Correct &= LZ4Decompress( pCompressed, CompressedSize, pResults, RawSize ) == RawSize;
+	double	DecompressionTime = T.GetElapsedMilliseconds();
+	Correct &= memcmp( pValues, pResults, RawSize ) == 0;
+	printf( "%20s %12.3f (%.1f%% of raw size)\n", "LZ4 compression", CompressionTime, 100.0 * CompressedSize / RawSize );
+	printf( "%20s %12.3f\n", "LZ4 decompression", DecompressionTime );
+	printf( "%20s %s\n", "Results", Correct ? "identical" : "DIFFERENT" );
+	CHECK( Correct, "LZ4 round-trip failed!" );
+
+	delete[] pCompressed;
+	delete[] pResults;
+	delete[] pValues;
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 10] Vertex compression
+//
+// Quantizes and compresses a tessellated sphere, then measures the decoding and its errors
+static void	BenchmarkVertexCompression() {
+	static const U32	SIZE_U = 512;
+	static const U32	SIZE_V = 256;
+	static const U32	VERTICES_COUNT = SIZE_U * SIZE_V;
+	static const U32	INDICES_COUNT = 6 * (SIZE_U-1) * (SIZE_V-1);
+
+	VertexP3N3G3B3T2*	pVertices = new VertexP3N3G3B3T2[VERTICES_COUNT];
+	bfloat3				BBoxMin( -10, -10, -10 ), BBoxMax( 10, 10, 10 );
+	for ( U32 Y=0; Y < SIZE_V; Y++ )
+		for ( U32 X=0; X < SIZE_U; X++ ) {
+			float	Theta = PI * Y / (SIZE_V-1);
+			float	Phi = TWOPI * X / SIZE_U;
+			VertexP3N3G3B3T2&	V = pVertices[SIZE_U*Y+X];
+			V.Normal.Set( sinf( Theta ) * cosf( Phi ), cosf( Theta ), sinf( Theta ) * sinf( Phi ) );
+			V.Position = 10.0f * V.Normal;
+			V.Tangent.Set( -sinf( Phi ), 0, cosf( Phi ) );
+			V.BiTangent = V.Normal.Cross( V.Tangent );
+			V.UV.Set( float(X) / SIZE_U, float(Y) / SIZE_V );
+		}
+
+	U32*	pIndices = new U32[INDICES_COUNT];
+	U32*	pIndex = pIndices;
+	for ( U32 Y=0; Y < SIZE_V-1; Y++ )
+		for ( U32 X=0; X < SIZE_U-1; X++ ) {
+			U32	V0 = SIZE_U*Y+X;
+			*pIndex++ = V0;	*pIndex++ = V0+SIZE_U;	*pIndex++ = V0+1;
+			*pIndex++ = V0+1;	*pIndex++ = V0+SIZE_U;	*pIndex++ = V0+SIZE_U+1;
+		}
+
+	printf( "Vertex compression, %d vertices, %d triangles (milliseconds)\n", VERTICES_COUNT, INDICES_COUNT / 3 );
+
+	// Quantization
+	QuantizedVertex*	pQuantized = new QuantizedVertex[VERTICES_COUNT];
+	VertexP3N3G3B3T2*	pDecoded = new VertexP3N3G3B3T2[VERTICES_COUNT];
+	Timer	T;
+	T.Start();
+	QuantizeVertices( pVertices, VERTICES_COUNT, BBoxMin, BBoxMax, pQuantized );
+	printf( "%20s %12.3f\n", "Quantize", T.GetElapsedMilliseconds() );
+	T.Start();
+	DequantizeVertices( pQuantized, VERTICES_COUNT, BBoxMin, BBoxMax, pDecoded );
+	printf( "%20s %12.3f\n", "Dequantize", T.GetElapsedMilliseconds() );
+
+	float	MaxPositionError = 0.0f, MaxNormalError = 0.0f, MaxUVError = 0.0f;
+	for ( U32 i=0; i < VERTICES_COUNT; i++ ) {
+		MaxPositionError = MAX( MaxPositionError, (pDecoded[i].Position - pVertices[i].Position).Length() );
+		MaxNormalError = MAX( MaxNormalError, pDecoded[i].Normal.Cross( pVertices[i].Normal ).Length() );
+		MaxUVError = MAX( MaxUVError, MAX( fabsf( pDecoded[i].UV.x - pVertices[i].UV.x ), fabsf( pDecoded[i].UV.y - pVertices[i].UV.y ) ) );
+	}
+	printf( "%20s position %g, normal %g radians, UV %g\n", "Max errors", MaxPositionError, asinf( MaxNormalError ), MaxUVError );
+	CHECK( MaxPositionError <= 0.5f * sqrtf( 3.0f ) * (BBoxMax.x - BBoxMin.x) / 65535.0f * 1.01f, "Position error exceeds half a 16-bits quantization step!" );
+	CHECK( asinf( MaxNormalError ) <= 1e-3f, "Normal error is too large!" );
+	CHECK( MaxUVError <= 1.0f / 4096.0f, "UV error exceeds half a half-float ULP!" );
+
+	// Codecs
+	U32		Capacity = EncodeVertexBufferBound( VERTICES_COUNT, sizeof(VertexP3N3G3B3T2) );
+	U8*		pEncoded = new U8[Capacity];
+	T.Start();
+	U32		EncodedSize = EncodeVertexBuffer( pQuantized, VERTICES_COUNT, sizeof(QuantizedVertex), pEncoded, Capacity );
+	double	EncodingTime = T.GetElapsedMilliseconds();
+	QuantizedVertex*	pQuantizedResults = new QuantizedVertex[VERTICES_COUNT];
+	T.Start();
+	bool	Correct = DecodeVertexBuffer( pEncoded, EncodedSize, pQuantizedResults, VERTICES_COUNT, sizeof(QuantizedVertex) );
+	double	DecodingTime = T.GetElapsedMilliseconds();
+	Correct &= memcmp( pQuantized, pQuantizedResults, VERTICES_COUNT * sizeof(QuantizedVertex) ) == 0;
+	CHECK( Correct, "Vertex codec round-trip failed!" );
+	printf( "%20s %12.3f (%.1f bytes per vertex)\n", "Encode vertices", EncodingTime, float(EncodedSize) / VERTICES_COUNT );
+	printf( "%20s %12.3f\n", "Decode vertices", DecodingTime );
+
+	U32*	pIndicesResults = new U32[INDICES_COUNT];
+	T.Start();
+	EncodedSize = EncodeIndexBuffer( pIndices, INDICES_COUNT, pEncoded, Capacity );
+	EncodingTime = T.GetElapsedMilliseconds();
+	T.Start();
+	Correct &= DecodeIndexBuffer( pEncoded, EncodedSize, pIndicesResults, INDICES_COUNT );
+	DecodingTime = T.GetElapsedMilliseconds();
+	Correct &= memcmp( pIndices, pIndicesResults, INDICES_COUNT * sizeof(U32) ) == 0;
+	CHECK( Correct, "Index codec round-trip failed!" );
+	printf( "%20s %12.3f (%.2f bits per triangle)\n", "Encode indices", EncodingTime, 8.0f * EncodedSize / (INDICES_COUNT / 3) );
+	printf( "%20s %12.3f\n", "Decode indices", DecodingTime );
+	printf( "%20s %s\n", "Results", Correct ? "identical" : "DIFFERENT" );
+
+	delete[] pIndicesResults;
+	delete[] pQuantizedResults;
+	delete[] pEncoded;
+	delete[] pDecoded;
+	delete[] pQuantized;
+	delete[] pIndices;
+	delete[] pVertices;
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 11] Mesh optimization
+//
+// Optimizes a tessellated sphere whose triangles were shuffled, as exporters often output them, and reports the vertex cache efficiency
+// Order-independent signature of a triangle list: its signed volume and the sum of its triangle centers, invariant to
+//	triangle reordering, corner rotation and vertex reordering but not to flipped or missing triangles
+static void	ComputeMeshSignature( const U32* _pIndices, U32 _IndicesCount, const VertexP3N3G3B3T2* _pVertices, double _pSignature[2] ) {
+	_pSignature[0] = _pSignature[1] = 0.0;
+	for ( U32 i=0; i < _IndicesCount; i+=3 ) {
+		const bfloat3&	P0 = _pVertices[_pIndices[i+0]].Position;
+		const bfloat3&	P1 = _pVertices[_pIndices[i+1]].Position;
+		const bfloat3&	P2 = _pVertices[_pIndices[i+2]].Position;
+		_pSignature[0] += P0.Dot( P1.Cross( P2 ) );
+		_pSignature[1] += (P0 + P1 + P2).Dot( bfloat3( 1, 3, 7 ) );
+	}
+}
+
+static bool	IsSameMesh( const U32* _pIndices, U32 _IndicesCount, const VertexP3N3G3B3T2* _pVertices, const double _pSignature[2] ) {
+	double	pSignature[2];
+	ComputeMeshSignature( _pIndices, _IndicesCount, _pVertices, pSignature );
+	return fabs( pSignature[0] - _pSignature[0] ) <= 1e-4 * fabs( _pSignature[0] ) && fabs( pSignature[1] - _pSignature[1] ) <= 1e-4 * (1.0 + fabs( _pSignature[1] ));
+}
+
+static void	BenchmarkMeshOptimization() {
+	static const U32	SIZE_U = 256;
+	static const U32	SIZE_V = 128;
+	static const U32	VERTICES_COUNT = (SIZE_U+1) * (SIZE_V+1);
+	static const U32	TRIANGLES_COUNT = 2 * SIZE_U * SIZE_V;
+
+	VertexP3N3G3B3T2*	pVertices = new VertexP3N3G3B3T2[VERTICES_COUNT];
+	for ( U32 Y=0; Y <= SIZE_V; Y++ )
+		for ( U32 X=0; X <= SIZE_U; X++ ) {
+			float	Theta = PI * Y / SIZE_V;
+			float	Phi = TWOPI * X / SIZE_U;
+			VertexP3N3G3B3T2&	V = pVertices[(SIZE_U+1)*Y+X];
+			V.Normal.Set( sinf( Theta ) * cosf( Phi ), cosf( Theta ), sinf( Theta ) * sinf( Phi ) );
+			V.Position = V.Normal;
+			V.Tangent.Set( -sinf( Phi ), 0, cosf( Phi ) );
+			V.BiTangent = V.Normal.Cross( V.Tangent );
+			V.UV.Set( float(X) / SIZE_U, float(Y) / SIZE_V );
+		}
+
+	U32*	pIndices = new U32[3*TRIANGLES_COUNT];
+	U32*	pIndex = pIndices;
+	for ( U32 Y=0; Y < SIZE_V; Y++ )
+		for ( U32 X=0; X < SIZE_U; X++ ) {
+			U32	V0 = (SIZE_U+1)*Y+X;
+			*pIndex++ = V0;	*pIndex++ = V0+SIZE_U+1;	*pIndex++ = V0+1;
+			*pIndex++ = V0+1;	*pIndex++ = V0+SIZE_U+1;	*pIndex++ = V0+SIZE_U+2;
+		}
+
+	BenchmarkRandom	Random( 1 );
+	for ( U32 i=TRIANGLES_COUNT-1; i > 0; i-- ) {
+		U32	j = Random.Next() % (i+1);
+		for ( U32 Corner=0; Corner < 3; Corner++ ) {
+			U32	Temp = pIndices[3*i+Corner];
+			pIndices[3*i+Corner] = pIndices[3*j+Corner];
+			pIndices[3*j+Corner] = Temp;
+		}
+	}
+
+	printf( "Mesh optimization, %d vertices, %d triangles (milliseconds)\n", VERTICES_COUNT, TRIANGLES_COUNT );
+
+	VertexCacheStatistics	Statistics = AnalyzeVertexCache( pIndices, 3*TRIANGLES_COUNT, VERTICES_COUNT );
+	printf( "%20s ACMR %.3f, ATVR %.3f\n", "Shuffled", Statistics.ACMR, Statistics.ATVR );
+	float	ShuffledACMR = Statistics.ACMR;
+	double	pSignature[2];
+	ComputeMeshSignature( pIndices, 3*TRIANGLES_COUNT, pVertices, pSignature );
+
+	Timer	T;
+	T.Start();
+	U32		ClustersCount = OptimizeVertexCache( pIndices, 3*TRIANGLES_COUNT, VERTICES_COUNT );
+	double	Time = T.GetElapsedMilliseconds();
+	Statistics = AnalyzeVertexCache( pIndices, 3*TRIANGLES_COUNT, VERTICES_COUNT );
+	printf( "%20s %12.3f ACMR %.3f, ATVR %.3f (%d clusters)\n", "Vertex cache", Time, Statistics.ACMR, Statistics.ATVR, ClustersCount );
+	CHECK( Statistics.ACMR < 0.8f * ShuffledACMR, "Vertex cache optimization didn't improve the ACMR!" );
+	CHECK( IsSameMesh( pIndices, 3*TRIANGLES_COUNT, pVertices, pSignature ), "Vertex cache optimization changed the mesh!" );
+	float	OptimizedACMR = Statistics.ACMR;
+
+	T.Start();
+	OptimizeOverdraw( pIndices, 3*TRIANGLES_COUNT, &pVertices[0].Position, VERTICES_COUNT, sizeof(VertexP3N3G3B3T2) );
+	Time = T.GetElapsedMilliseconds();
+	Statistics = AnalyzeVertexCache( pIndices, 3*TRIANGLES_COUNT, VERTICES_COUNT );
+	printf( "%20s %12.3f ACMR %.3f, ATVR %.3f\n", "Overdraw", Time, Statistics.ACMR, Statistics.ATVR );
+	CHECK( Statistics.ACMR <= 1.05f * OptimizedACMR, "Overdraw optimization ruined the ACMR!" );
+	CHECK( IsSameMesh( pIndices, 3*TRIANGLES_COUNT, pVertices, pSignature ), "Overdraw optimization changed the mesh!" );
+
+	T.Start();
+	U32		NewVerticesCount = OptimizeVertexFetch( pIndices, 3*TRIANGLES_COUNT, pVertices, VERTICES_COUNT, sizeof(VertexP3N3G3B3T2) );
+	printf( "%20s %12.3f (%d vertices)\n", "Vertex fetch", T.GetElapsedMilliseconds(), NewVerticesCount );
+	U32		MaxIndex = 0;
+	for ( U32 i=0; i < 3*TRIANGLES_COUNT; i++ )
+		MaxIndex = MAX( MaxIndex, pIndices[i] );
+	CHECK( NewVerticesCount <= VERTICES_COUNT && MaxIndex < NewVerticesCount, "Vertex fetch optimization output out of range indices!" );
+	CHECK( IsSameMesh( pIndices, 3*TRIANGLES_COUNT, pVertices, pSignature ), "Vertex fetch optimization changed the mesh!" );
+
+	List<Meshlet>	Meshlets;
+	List<U32>		MeshletVertices;
+	List<U8>		MeshletTriangles;
+	T.Start();
+	BuildMeshlets( pIndices, 3*TRIANGLES_COUNT, &pVertices[0].Position, NewVerticesCount, sizeof(VertexP3N3G3B3T2), Meshlets, MeshletVertices, MeshletTriangles );
+	Time = T.GetElapsedMilliseconds();
+
+	// Count the meshlets culled by their normal cone when seen from a point on the X axis (at best, the half of the sphere facing away)
+	U32		CulledCount = 0;
+	bfloat3	CameraPosition( 10, 0, 0 );
+	for ( U32 i=0; i < Meshlets.Count(); i++ ) {
+		const Meshlet&	M = Meshlets[i];
+		bfloat3	View = M.ConeApex - CameraPosition;
+		View.Normalize();
+		if ( View.Dot( M.ConeAxis ) >= M.ConeCutoff )
+			CulledCount++;
+	}
+	printf( "%20s %12.3f (%d meshlets, %.1f vertices per meshlet, %.1f%% culled)\n", "Meshlets", Time, Meshlets.Count(), float(MeshletVertices.Count()) / Meshlets.Count(), 100.0f * CulledCount / Meshlets.Count() );
+
+	// Meshlets must cover all the triangles once, within the limits, and rebuild the original mesh
+	U32*	pMeshletIndices = new U32[3*TRIANGLES_COUNT];
+	U32		MeshletIndicesCount = 0;
+	bool	Valid = true;
+	for ( U32 i=0; i < Meshlets.Count(); i++ ) {
+		const Meshlet&	M = Meshlets[i];
+		Valid &= M.VerticesCount <= MESHLET_MAX_VERTICES && M.TrianglesCount <= MESHLET_MAX_TRIANGLES;
+		for ( U32 j=0; j < 3*M.TrianglesCount && Valid && MeshletIndicesCount < 3*TRIANGLES_COUNT; j++ ) {
+			U8	LocalIndex = MeshletTriangles[M.TrianglesOffset+j];
+			Valid &= LocalIndex < M.VerticesCount;
+			pMeshletIndices[MeshletIndicesCount++] = MeshletVertices[M.VerticesOffset+LocalIndex];
+		}
+	}
+	CHECK( Valid && MeshletIndicesCount == 3*TRIANGLES_COUNT && IsSameMesh( pMeshletIndices, MeshletIndicesCount, pVertices, pSignature ), "Meshlets don't match the mesh!" );
+	delete[] pMeshletIndices;
+
+	delete[] pIndices;
+	delete[] pVertices;
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 12] Mesh simplification
+//
+// Builds the LOD chain of a bumpy sphere with a UV seam, as GeometryBuilder outputs it, and reports the error of each LOD
+static bool	AreIndicesValid( const U32* _pIndices, U32 _IndicesCount, U32 _VerticesCount ) {
+	if ( _IndicesCount % 3 != 0 )
+		return false;
+	for ( U32 i=0; i < _IndicesCount; i+=3 )
+		if ( _pIndices[i] >= _VerticesCount || _pIndices[i+1] >= _VerticesCount || _pIndices[i+2] >= _VerticesCount
+			|| _pIndices[i] == _pIndices[i+1] || _pIndices[i+1] == _pIndices[i+2] || _pIndices[i+2] == _pIndices[i] )
+			return false;
+	return true;
+}
+
+static void	BenchmarkMeshSimplification() {
+	static const U32	SIZE_U = 256;
+	static const U32	SIZE_V = 128;
+	static const U32	VERTICES_COUNT = (SIZE_U+1) * (SIZE_V+1);
+
+	VertexP3N3G3B3T2*	pVertices = new VertexP3N3G3B3T2[VERTICES_COUNT];
+	for ( U32 Y=0; Y <= SIZE_V; Y++ )
+		for ( U32 X=0; X <= SIZE_U; X++ ) {
+			float	Theta = PI * Y / SIZE_V;
+			float	Phi = TWOPI * (X % SIZE_U) / SIZE_U;	// The last column shares the positions of the first one
+			float	Radius = 1.0f + 0.1f * sinf( 5.0f * Phi ) * sinf( 4.0f * Theta );
+			VertexP3N3G3B3T2&	V = pVertices[(SIZE_U+1)*Y+X];
+			V.Normal.Set( sinf( Theta ) * cosf( Phi ), cosf( Theta ), sinf( Theta ) * sinf( Phi ) );
+			V.Position = Radius * V.Normal;
+			V.UV.Set( float(X) / SIZE_U, float(Y) / SIZE_V );
+		}
+
+	// Skip the degenerate triangles at the poles
+	U32*	pIndices = new U32[6*SIZE_U*SIZE_V];
+	U32		IndicesCount = 0;
+	for ( U32 Y=0; Y < SIZE_V; Y++ )
+		for ( U32 X=0; X < SIZE_U; X++ ) {
+			U32	V0 = (SIZE_U+1)*Y+X;
+			if ( Y > 0 ) {
+				pIndices[IndicesCount++] = V0;	pIndices[IndicesCount++] = V0+SIZE_U+1;	pIndices[IndicesCount++] = V0+1;
+			}
+			if ( Y < SIZE_V-1 ) {
+				pIndices[IndicesCount++] = V0+1;	pIndices[IndicesCount++] = V0+SIZE_U+1;	pIndices[IndicesCount++] = V0+SIZE_U+2;
+			}
+		}
+	OptimizeVertexCache( pIndices, IndicesCount, VERTICES_COUNT );
+
+	printf( "Mesh simplification, %d vertices, %d triangles (milliseconds)\n", VERTICES_COUNT, IndicesCount / 3 );
+
+	U32*	pSimplified = new U32[IndicesCount];
+	Timer	T;
+	for ( U32 Percent=50; Percent >= 5; Percent /= 3 ) {
+		float	Error, DistanceBound;
+		T.Start();
+		U32		SimplifiedCount = SimplifyMesh( pIndices, IndicesCount, &pVertices[0].Position, VERTICES_COUNT, sizeof(VertexP3N3G3B3T2), 3 * (IndicesCount / 300 * Percent), FLT_MAX, pSimplified, &Error, &DistanceBound );
+		printf( "%17s%2d%% %12.3f %d triangles, error %.5f, bound %.5f\n", "Simplify to ", Percent, T.GetElapsedMilliseconds(), SimplifiedCount / 3, Error, DistanceBound );
+		CHECK( SimplifiedCount <= 3 * (IndicesCount / 300 * Percent) && SimplifiedCount % 3 == 0, "Simplification exceeded the target triangles count!" );
+		CHECK( AreIndicesValid( pSimplified, SimplifiedCount, VERTICES_COUNT ), "Simplification output invalid triangles!" );
+		CHECK( DistanceBound >= Error, "Simplification distance bound is below the RMS error!" );
+	}
+
+	// Error bounded simplification must stop before exceeding the requested error
+	static const float	pTargetErrors[] = { 1e-3f, 1e-2f, 1e-1f };
+	for ( U32 ErrorIndex=0; ErrorIndex < sizeof(pTargetErrors)/sizeof(pTargetErrors[0]); ErrorIndex++ ) {
+		float	TargetError = pTargetErrors[ErrorIndex];
+		float	Error;
+		T.Start();
+		U32		SimplifiedCount = SimplifyMesh( pIndices, IndicesCount, &pVertices[0].Position, VERTICES_COUNT, sizeof(VertexP3N3G3B3T2), 0, TargetError, pSimplified, &Error );
+		printf( "%14s %.3f %12.3f %d triangles, error %.5f\n", "Error bound", TargetError, T.GetElapsedMilliseconds(), SimplifiedCount / 3, Error );
+		CHECK( Error <= TargetError, "Simplification error exceeds the requested bound!" );
+		CHECK( SimplifiedCount < IndicesCount && AreIndicesValid( pSimplified, SimplifiedCount, VERTICES_COUNT ), "Error bounded simplification failed!" );
+	}
+
+	List<U32>		LODIndices;
+	List<MeshLOD>	LODs;
+	T.Start();
+	BuildLODChain( pIndices, IndicesCount, &pVertices[0].Position, VERTICES_COUNT, sizeof(VertexP3N3G3B3T2), LODIndices, LODs );
+	printf( "%20s %12.3f (%d LODs)\n", "LOD chain", T.GetElapsedMilliseconds(), LODs.Count() );
+	for ( U32 i=0; i < LODs.Count(); i++ )
+		printf( "%20s %d: %d triangles, error %.5f\n", "LOD", i+1, LODs[i].IndicesCount / 3, LODs[i].Error );
+
+	bool	ValidChain = LODs.Count() > 0;
+	for ( U32 i=0; i < LODs.Count(); i++ ) {
+		ValidChain &= LODs[i].IndicesOffset + LODs[i].IndicesCount <= LODIndices.Count() && AreIndicesValid( LODIndices.Ptr() + LODs[i].IndicesOffset, LODs[i].IndicesCount, VERTICES_COUNT );
+		if ( i > 0 )
+			ValidChain &= LODs[i].IndicesCount < LODs[i-1].IndicesCount && LODs[i].Error >= LODs[i-1].Error;
+	}
+	CHECK( ValidChain, "LOD chain isn't decreasing in triangles and increasing in error!" );
+
+	// LODs selected for a 1080p viewport with a 60 degrees vertical FOV and 1 pixel of error
+	float	ProjectionScale = ComputeLODProjectionScale( 1080.0f, PI / 3.0f );
+	U32		PreviousLOD = 0;
+	for ( float Distance=1.0f; Distance <= 1000.0f; Distance *= 10.0f ) {
+		U32	LOD = SelectLOD( LODs.Ptr(), LODs.Count(), Distance, ProjectionScale, 1.0f );
+		printf( "%20s %.0f: LOD %d\n", "Distance", Distance, LOD );
+		CHECK( LOD >= PreviousLOD && LOD <= LODs.Count(), "LOD selection isn't monotonic with distance!" );
+		PreviousLOD = LOD;
+	}
+
+	delete[] pSimplified;
+	delete[] pIndices;
+	delete[] pVertices;
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 13] Minimization
+//
+// Fits the cubic polynomial of Bitmap::FilterCameraResponseCurve() to a noisy 256 entries response curve with each solver,
+//	then compares BFGS and L-BFGS on a large smooth model where the dense inverse Hessian of BFGS becomes the bottleneck
+class	PolynomialFitModel : public BFGS::IModel, public LevenbergMarquardt::IModel {
+	List< float >	m_Curve;
+	double			m_TentCenter;
+	VectorD			m_Parameters;
+	bool			m_Analytic;
+	bool			m_ThreadSafe;
+
+public:
+	PolynomialFitModel( const List< float >& _Curve, bool _Analytic, bool _ThreadSafe ) : m_Curve( _Curve ), m_TentCenter( 0.5 * _Curve.Count() ), m_Parameters( 4 ), m_Analytic( _Analytic ), m_ThreadSafe( _ThreadSafe ) { Reset(); }
+
+	void				Reset() {
+		m_Parameters[0] = 0.0;
+		m_Parameters[1] = 1.0;
+		m_Parameters[2] = 0.0;
+		m_Parameters[3] = 0.0;
+	}
+
+	static double		EvalModel( double x, const VectorD& _Parameters ) {
+		return _Parameters[0] + x * (_Parameters[1] + x * (_Parameters[2] + x * _Parameters[3]));
+	}
+	double				TentFilter( double x ) const	{ return 1.0 - abs( x - m_TentCenter ) / m_TentCenter; }
+
+	// Shared IModel Implementation
+	virtual VectorD&	getParameters() override						{ return m_Parameters; }
+	virtual void		setParameters( const VectorD& value ) override	{ value.CopyTo( m_Parameters ); }
+	virtual void		Constrain( VectorD& _Parameters ) override		{}
+	virtual bool		IsThreadSafe() const override					{ return m_ThreadSafe; }
+
+	// BFGS::IModel Implementation (same as Bitmap's BFGSModel_polynomial)
+	virtual double		Eval( const VectorD& _Parameters ) override {
+		double	SumSqDiff = 0.0;
+		for ( U32 i=0; i < m_Curve.Count(); i++ ) {
+			double	Diff = TentFilter( i ) * (EvalModel( i, _Parameters ) - m_Curve[i]);
+			SumSqDiff += Diff * Diff;
+		}
+		return SumSqDiff / (m_Curve.Count()*m_Curve.Count());
+	}
+	virtual bool		EvalGradient( const VectorD& _Parameters, VectorD& _Gradient ) override {
+		if ( !m_Analytic )
+			return false;
+		_Gradient.Clear();
+		for ( U32 i=0; i < m_Curve.Count(); i++ ) {
+			double	Weight = TentFilter( i );
+			double	x = 2.0 * Weight * Weight * (EvalModel( i, _Parameters ) - m_Curve[i]) / (m_Curve.Count()*m_Curve.Count());
+			for ( U32 k=0; k < 4; k++, x *= i )
+				_Gradient[k] += x;
+		}
+		return true;
+	}
+
+	// LevenbergMarquardt::IModel Implementation (the residuals are scaled so their sum of squares matches Eval())
+	virtual U32			getResidualsCount() override	{ return m_Curve.Count(); }
+	virtual void		EvalResiduals( const VectorD& _Parameters, VectorD& _Residuals ) override {
+		for ( U32 i=0; i < m_Curve.Count(); i++ )
+			_Residuals[i] = TentFilter( i ) * (EvalModel( i, _Parameters ) - m_Curve[i]) / m_Curve.Count();
+	}
+	virtual bool		EvalJacobian( const VectorD& _Parameters, MatrixD& _JacobianT ) override {
+		if ( !m_Analytic )
+			return false;
+		for ( U32 i=0; i < m_Curve.Count(); i++ ) {
+			double	x = TentFilter( i ) / m_Curve.Count();
+			for ( U32 k=0; k < 4; k++, x *= i )
+				_JacobianT[k][i] = x;
+		}
+		return true;
+	}
+};
+
+// Sum of weighted squared distances to targets plus a smoothness term coupling neighbor parameters
+class	SmoothChainModel : public BFGS::IModel {
+	VectorD		m_Parameters;
+
+public:
+	SmoothChainModel( U32 _ParametersCount ) : m_Parameters( _ParametersCount ) { m_Parameters.Clear(); }
+
+	virtual VectorD&	getParameters() override						{ return m_Parameters; }
+	virtual void		setParameters( const VectorD& value ) override	{ value.CopyTo( m_Parameters ); }
+	virtual void		Constrain( VectorD& _Parameters ) override		{}
+	virtual double		Eval( const VectorD& _Parameters ) override {
+		double	Sum = 0.0;
+		for ( U32 i=0; i < _Parameters.length; i++ ) {
+			double	Diff = _Parameters[i] - sin( 0.01 * i );
+			Sum += (1 + i % 7) * Diff * Diff;
+			if ( i > 0 ) {
+				double	Slope = _Parameters[i] - _Parameters[i-1];
+				Sum += 0.5 * Slope * Slope;
+			}
+		}
+		return Sum;
+	}
+	virtual bool		EvalGradient( const VectorD& _Parameters, VectorD& _Gradient ) override {
+		U32	Count = _Parameters.length;
+		for ( U32 i=0; i < Count; i++ ) {
+			_Gradient[i] = 2.0 * (1 + i % 7) * (_Parameters[i] - sin( 0.01 * i ));
+			if ( i > 0 )
+				_Gradient[i] += _Parameters[i] - _Parameters[i-1];
+			if ( i < Count-1 )
+				_Gradient[i] -= _Parameters[i+1] - _Parameters[i];
+		}
+		return true;
+	}
+};
+
+static const double	SOLVER_TOLERANCE = 1e-3;	// Relative to the exact minimum
+
+// Exact minimum of PolynomialFitModel::Eval() given by the normal equations of the weighted least-squares problem,
+//	solved in double precision over x/(N-1) to keep them well conditioned (the minimum doesn't depend on the basis)
+static double	ComputeLeastSquaresMinimum( const List< float >& _Curve ) {
+	U32		N = _Curve.Count();
+	double	Center = 0.5 * N;
+	double	M[4][5];
+	memset( M, 0, sizeof(M) );
+	for ( U32 i=0; i < N; i++ ) {
+		double	Weight = 1.0 - fabs( i - Center ) / Center;
+		double	u = i / (N - 1.0);
+		double	pBasis[4] = { 1.0, u, u*u, u*u*u };
+		for ( U32 Row=0; Row < 4; Row++ ) {
+			for ( U32 Column=0; Column < 4; Column++ )
+				M[Row][Column] += Weight * Weight * pBasis[Row] * pBasis[Column];
+			M[Row][4] += Weight * Weight * pBasis[Row] * _Curve[i];
+		}
+	}
+
+	// Gauss-Jordan elimination (the matrix is symmetric positive definite so no pivoting is required)
+	for ( U32 Pivot=0; Pivot < 4; Pivot++ )
+		for ( U32 Row=0; Row < 4; Row++ ) {
+			if ( Row == Pivot )
+				continue;
+			double	Factor = M[Row][Pivot] / M[Pivot][Pivot];
+			for ( U32 Column=Pivot; Column < 5; Column++ )
+				M[Row][Column] -= Factor * M[Pivot][Column];
+		}
+
+	double	SumSqDiff = 0.0;
+	for ( U32 i=0; i < N; i++ ) {
+		double	Weight = 1.0 - fabs( i - Center ) / Center;
+		double	u = i / (N - 1.0);
+		double	Value = M[0][4] / M[0][0] + u * (M[1][4] / M[1][1] + u * (M[2][4] / M[2][2] + u * M[3][4] / M[3][3]));
+		double	Diff = Weight * (Value - _Curve[i]);
+		SumSqDiff += Diff * Diff;
+	}
+	return SumSqDiff / (N*N);
+}
+
+template< typename SOLVER > static void	BenchmarkSolver( const char* _Name, SOLVER& _Solver, PolynomialFitModel& _Model, U32 _RunsCount, double _ExactMinimum ) {
+	Timer	T;
+	for ( U32 Run=0; Run < _RunsCount; Run++ ) {
+		_Model.Reset();
+		_Solver.Minimize( _Model );
+	}
+	printf( "%28s %12.3f %6d %8d   %.6g\n", _Name, T.GetElapsedMilliseconds() / _RunsCount, _Solver.getIterationsCount(), _Solver.getEvalCallsCount(), _Solver.getFunctionMinimum() );
+	CHECK( _Solver.getFunctionMinimum() <= _ExactMinimum * (1.0 + SOLVER_TOLERANCE), "Solver didn't reach the least-squares minimum!" );
+	CHECK( fabs( _Model.Eval( _Model.getParameters() ) - _Solver.getFunctionMinimum() ) <= 1e-9 + 1e-6 * _Solver.getFunctionMinimum(), "Solver's minimum doesn't match its parameters!" );
+}
+
+static void	BenchmarkMinimization() {
+	static const U32	CURVE_SIZE = 256;
+	static const U32	RUNS_COUNT = 100;
+
+	// Camera response curve with a 1/2.2 gamma and some noise, as Bitmap::ComputeCameraResponseCurve() would output it
+	BenchmarkRandom	Random( 1 );
+	List< float >	Curve( CURVE_SIZE );
+	for ( U32 i=0; i < CURVE_SIZE; i++ )
+		Curve.Append( 255.0f * powf( i / 255.0f, 1.0f / 2.2f ) + 2.0f * ((Random.Next() & 0xFFFF) / 65535.0f - 0.5f) );
+
+	double	ExactMinimum = ComputeLeastSquaresMinimum( Curve );
+	printf( "Polynomial response curve fit (milliseconds per fit, iterations, evaluations, minimum %.6g)\n", ExactMinimum );
+
+	PolynomialFitModel	FiniteDifferences( Curve, false, false );
+	PolynomialFitModel	ParallelFiniteDifferences( Curve, false, true );
+	PolynomialFitModel	Analytic( Curve, true, false );
+
+	BFGS	SolverBFGS;
+	BenchmarkSolver( "BFGS finite differences", SolverBFGS, FiniteDifferences, RUNS_COUNT, ExactMinimum );
+	BenchmarkSolver( "BFGS parallel differences", SolverBFGS, ParallelFiniteDifferences, RUNS_COUNT, ExactMinimum );
+	BenchmarkSolver( "BFGS analytic", SolverBFGS, Analytic, RUNS_COUNT, ExactMinimum );
+
+	LBFGS	SolverLBFGS;
+	BenchmarkSolver( "L-BFGS finite differences", SolverLBFGS, FiniteDifferences, RUNS_COUNT, ExactMinimum );
+	BenchmarkSolver( "L-BFGS analytic", SolverLBFGS, Analytic, RUNS_COUNT, ExactMinimum );
+
+	LevenbergMarquardt	SolverLM;
+	BenchmarkSolver( "LM finite differences", SolverLM, FiniteDifferences, RUNS_COUNT, ExactMinimum );
+	BenchmarkSolver( "LM parallel differences", SolverLM, ParallelFiniteDifferences, RUNS_COUNT, ExactMinimum );
+	BenchmarkSolver( "LM analytic", SolverLM, Analytic, RUNS_COUNT, ExactMinimum );
+
+	printf( "Smooth chain model, analytic gradient (milliseconds, iterations, evaluations, minimum)\n" );
+	for ( U32 ParametersCount=100; ParametersCount <= 1600; ParametersCount *= 4 ) {
+		char	Name[64];
+
+		SmoothChainModel	Model( ParametersCount );
+		BFGS	ChainBFGS;
+		ChainBFGS.setMaxIterations( 1000 );
+		sprintf_s( Name, "BFGS N=%d", ParametersCount );
+
+		Timer	T;
+		ChainBFGS.Minimize( Model );
+		printf( "%28s %12.3f %6d %8d   %.6g\n", Name, T.GetElapsedMilliseconds(), ChainBFGS.getIterationsCount(), ChainBFGS.getEvalCallsCount(), ChainBFGS.getFunctionMinimum() );
+		CHECK( ChainBFGS.getIterationsCount() < 1000, "BFGS didn't converge on the chain model!" );
+
+		for ( int HistorySize=4; HistorySize <= 16; HistorySize *= 2 ) {
+			LBFGS	ChainLBFGS;
+			ChainLBFGS.setMaxIterations( 1000 );
+			ChainLBFGS.setHistorySize( HistorySize );
+			sprintf_s( Name, "L-BFGS N=%d history %d", ParametersCount, HistorySize );
+
+			T.Start();
+			Model.getParameters().Clear();
+			ChainLBFGS.Minimize( Model );
+			printf( "%28s %12.3f %6d %8d   %.6g\n", Name, T.GetElapsedMilliseconds(), ChainLBFGS.getIterationsCount(), ChainLBFGS.getEvalCallsCount(), ChainLBFGS.getFunctionMinimum() );
+			CHECK( fabs( ChainLBFGS.getFunctionMinimum() - ChainBFGS.getFunctionMinimum() ) <= SOLVER_TOLERANCE * ChainBFGS.getFunctionMinimum(), "L-BFGS and BFGS minima differ!" );
+		}
+	}
+
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 14] Dense linear algebra
+//
+// Compares the blocked SIMD matrix products to a naive triple loop, and measures the SVD on a system the size of
+//	the one solved by Bitmap::ComputeCameraResponseCurve() for 3 images
+// Compares a few random entries of A.B^T with double precision dot products
+static bool	CheckProductTransposed( const MatrixF& A, const MatrixF& B, const MatrixF& C, BenchmarkRandom& _Random ) {
+	for ( U32 SampleIndex=0; SampleIndex < 1024; SampleIndex++ ) {
+		U32		Row = _Random.Next() % A.rows;
+		U32		Column = _Random.Next() % B.rows;
+		double	Sum = 0.0;
+		for ( U32 i=0; i < A.columns; i++ )
+			Sum += double( A[Row][i] ) * B[Column][i];
+		if ( fabs( C[Row][Column] - Sum ) > 1e-3 )
+			return false;
+	}
+	return true;
+}
+
+static void	BenchmarkLinearAlgebra() {
+	static const U32	SIZE = 512;
+
+	BenchmarkRandom	Random( 1 );
+	MatrixF	A( SIZE, SIZE ), B( SIZE, SIZE ), C;
+	for ( U32 i=0; i < SIZE*SIZE; i++ ) {
+		A.m_raw[i] = (Random.Next() & 0xFFFF) / 65535.0f - 0.5f;
+		B.m_raw[i] = (Random.Next() & 0xFFFF) / 65535.0f - 0.5f;
+	}
+
+	printf( "Matrix products %dx%d (milliseconds)\n", SIZE, SIZE );
+
+	Timer	T;
+	C.Init( SIZE, SIZE );
+	for ( U32 Row=0; Row < SIZE; Row++ )
+		for ( U32 Column=0; Column < SIZE; Column++ ) {
+			float	Sum = 0.0f;
+			for ( U32 i=0; i < SIZE; i++ )
+				Sum += A[Row][i] * B[i][Column];
+			C[Row][Column] = Sum;
+		}
+	printf( "%20s %12.3f\n", "Naive A.B", T.GetElapsedMilliseconds() );
+	List< float >	Reference( SIZE*SIZE );
+	Reference.Append( C.m_raw, SIZE*SIZE );
+
+	T.Start();
+	Multiply( A, B, C );
+	printf( "%20s %12.3f\n", "A.B", T.GetElapsedMilliseconds() );
+	float	MaxError = 0.0f;
+	for ( U32 i=0; i < SIZE*SIZE; i++ )
+		MaxError = MAX( MaxError, fabsf( C.m_raw[i] - Reference[i] ) );
+	CHECK( MaxError < 1e-3f, "A.B differs from the naive product!" );
+
+	T.Start();
+	MultiplyTransposed( A, B, C );
+	printf( "%20s %12.3f\n", "A.B^T", T.GetElapsedMilliseconds() );
+	CHECK( CheckProductTransposed( A, B, C, Random ), "A.B^T differs from the naive product!" );
+
+	T.Start();
+	MultiplyTransposed( A, A, C );
+	printf( "%20s %12.3f\n", "A.A^T", T.GetElapsedMilliseconds() );
+	CHECK( CheckProductTransposed( A, A, C, Random ), "A.A^T differs from the naive product!" );
+
+	VectorF	x( SIZE ), y;
+	x.Clear( 1.0f );
+	T.Start();
+	for ( U32 i=0; i < 100; i++ )
+		Multiply( A, x, y );
+	printf( "%20s %12.3f\n", "A.x", T.GetElapsedMilliseconds() / 100 );
+	MaxError = 0.0f;
+	for ( U32 Row=0; Row < SIZE; Row++ ) {
+		double	Sum = 0.0;
+		for ( U32 i=0; i < SIZE; i++ )
+			Sum += A[Row][i];
+		MaxError = MAX( MaxError, fabsf( y[Row] - float(Sum) ) );
+	}
+	CHECK( MaxError < 1e-3f, "A.x differs from the naive product!" );
+
+	T.Start();
+	for ( U32 i=0; i < 100; i++ )
+		MultiplyTransposed( A, x, y );
+	printf( "%20s %12.3f\n", "A^T.x", T.GetElapsedMilliseconds() / 100 );
+	MaxError = 0.0f;
+	for ( U32 Column=0; Column < SIZE; Column++ ) {
+		double	Sum = 0.0;
+		for ( U32 i=0; i < SIZE; i++ )
+			Sum += A[i][Column];
+		MaxError = MAX( MaxError, fabsf( y[Column] - float(Sum) ) );
+	}
+	CHECK( MaxError < 1e-3f, "A^T.x differs from the naive product!" );
+
+	// 3 images of 171 pixels give 770 equations for 427 unknowns
+	static const U32	EQUATIONS_COUNT = 770;
+	static const U32	UNKNOWNS_COUNT = 427;
+	SVD		Decomposition( EQUATIONS_COUNT, UNKNOWNS_COUNT );
+	for ( U32 i=0; i < EQUATIONS_COUNT*UNKNOWNS_COUNT; i++ )
+		Decomposition.A.m_raw[i] = (Random.Next() & 0xFFFF) / 65535.0f - 0.5f;
+
+	VectorF	b( EQUATIONS_COUNT ), Solution( UNKNOWNS_COUNT );
+	b.Clear( 1.0f );
+
+	T.Start();
+	Decomposition.Decompose();
+	Decomposition.Solve( b, Solution );
+	printf( "%11s %dx%d %12.3f (%d sweeps)\n", "SVD", EQUATIONS_COUNT, UNKNOWNS_COUNT, T.GetElapsedMilliseconds(), Decomposition.getSweepsCount() );
+
+	// The least-squares solution must satisfy the normal equations A^T.(A.x - b) = 0
+	const MatrixF&	M = Decomposition.A;
+	List< double >	Residual( EQUATIONS_COUNT );
+	double			SqResidualNorm = 0.0, SqMatrixNorm = 0.0;
+	for ( U32 Row=0; Row < EQUATIONS_COUNT; Row++ ) {
+		double	Sum = -b[Row];
+		for ( U32 i=0; i < UNKNOWNS_COUNT; i++ ) {
+			Sum += double( M[Row][i] ) * Solution[i];
+			SqMatrixNorm += double( M[Row][i] ) * M[Row][i];
+		}
+		Residual.Append( Sum );
+		SqResidualNorm += Sum * Sum;
+	}
+	double	SqGradientNorm = 0.0;
+	for ( U32 Column=0; Column < UNKNOWNS_COUNT; Column++ ) {
+		double	Sum = 0.0;
+		for ( U32 Row=0; Row < EQUATIONS_COUNT; Row++ )
+			Sum += M[Row][Column] * Residual[Row];
+		SqGradientNorm += Sum * Sum;
+	}
+	double	RelativeResidual = sqrt( SqGradientNorm / (SqMatrixNorm * SqResidualNorm) );
+	printf( "%20s %.3g\n", "Normal residual", RelativeResidual );
+	CHECK( RelativeResidual < 1e-4, "SVD solution doesn't solve the least-squares problem!" );
+
+	printf( "\n" );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// 15] Octree
+//
+struct	OctreeQuery {
+	bfloat3	Position;
+	bfloat3	Direction;		// Not normalized
+	float	Extent;
+	bfloat4	pPlanes[6];		// Oriented box around the position, with scaled inward normals
+};
+
+static bool	AreSameValues( List<U32>& _A, List<U32>& _B ) {
+	if ( _A.Count() != _B.Count() )
+		return false;
+	_A.SortBy( Less<U32>() );
+	_B.SortBy( Less<U32>() );
+	return _A.Count() == 0 || memcmp( _A.Ptr(), _B.Ptr(), _A.Count() * sizeof(U32) ) == 0;
+}
+
+// Same test as the octree's contents, so the brute force results match exactly
+static float	IntersectSphere( const bfloat3& _Center, float _Radius, const bfloat3& _Origin, const bfloat3& _Direction ) {
+	bfloat3	Origin2Center = _Center - _Origin;
+	float	c = Origin2Center.LengthSq() - _Radius*_Radius;
+	if ( c <= 0.0f )
+		return 0.0f;
+	float	b = Origin2Center.x * _Direction.x + Origin2Center.y * _Direction.y + Origin2Center.z * _Direction.z;
+	float	Delta = b*b - c;
+	if ( b < 0.0f || Delta < 0.0f )
+		return -1.0f;
+	return b - sqrtf( Delta );
+}
+
+static void	BenchmarkOctree() {
+	static const U32	COUNT = 100000;
+	static const U32	QUERIES_COUNT = 10000;
+	static const U32	CHECKED_QUERIES_COUNT = 64;
+	static const float	SIZE = 100.0f;
+	static const float	RAY_LENGTH = 50.0f;
+
+	printf( "Octree, %d spheres, %d queries (milliseconds)\n", COUNT, QUERIES_COUNT );
+
+	// Random spheres, some of them outside the octree's bounds so the border cells are exercised
+	BenchmarkRandom	RNG( 1 );
+	bfloat3*	pPositions = new bfloat3[COUNT];
+	float*		pRadii = new float[COUNT];
+	U32*		pValues = new U32[COUNT];
+	for ( U32 i=0; i < COUNT; i++ ) {
+		pPositions[i].Set( (SIZE + 10.0f) * (RNG.Next() & 0xFFFF) / 65536.0f - 5.0f, (SIZE + 10.0f) * (RNG.Next() & 0xFFFF) / 65536.0f - 5.0f, (SIZE + 10.0f) * (RNG.Next() & 0xFFFF) / 65536.0f - 5.0f );
+		pRadii[i] = 0.05f + 2.0f * (RNG.Next() & 0xFFFF) / 65536.0f;
+		pValues[i] = i;
+	}
+
+	OctreeQuery*	pQueries = new OctreeQuery[QUERIES_COUNT];
+	for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+		OctreeQuery&	Q = pQueries[QueryIndex];
+		Q.Position.Set( (SIZE + 20.0f) * (RNG.Next() & 0xFFFF) / 65536.0f - 10.0f, (SIZE + 20.0f) * (RNG.Next() & 0xFFFF) / 65536.0f - 10.0f, (SIZE + 20.0f) * (RNG.Next() & 0xFFFF) / 65536.0f - 10.0f );
+		Q.Direction.Set( (RNG.Next() & 0xFFFF) / 32768.0f - 1.0f, (RNG.Next() & 0xFFFF) / 32768.0f - 1.0f, (RNG.Next() & 0xFFFF) / 32768.0f - 1.0f );
+		if ( Q.Direction.LengthSq() < 1e-4f )
+			Q.Direction = bfloat3::UnitZ;
+		Q.Extent = 0.5f + 10.0f * (RNG.Next() & 0xFFFF) / 65536.0f;
+
+		bfloat3	pAxes[3];
+		pAxes[0] = Q.Direction;
+		pAxes[0].Normalize();
+		pAxes[1] = pAxes[0].Cross( fabsf( pAxes[0].x ) < 0.9f ? bfloat3::UnitX : bfloat3::UnitY );
+		pAxes[1].Normalize();
+		pAxes[2] = pAxes[0].Cross( pAxes[1] );
+		for ( int AxisIndex=0; AxisIndex < 3; AxisIndex++ ) {
+			float	Center = pAxes[AxisIndex].Dot( Q.Position );
+			Q.pPlanes[2*AxisIndex+0].Set( 2.0f * pAxes[AxisIndex], 2.0f * (Q.Extent - Center) );
+			Q.pPlanes[2*AxisIndex+1].Set( -2.0f * pAxes[AxisIndex], 2.0f * (Q.Extent + Center) );
+		}
+	}
+
+	Timer	T;
+	Octree<U32>	Appended;
+	T.Start();
+	Appended.Init( bfloat3::Zero, SIZE, 1.0f, COUNT );
+	for ( U32 i=0; i < COUNT; i++ )
+		Appended.Append( pPositions[i], pRadii[i], pValues[i] );
+	printf( "%20s %12.3f\n", "Append", T.GetElapsedMilliseconds() );
+
+	Octree<U32>	Built;
+	T.Start();
+	Built.Init( bfloat3::Zero, SIZE, 1.0f );
+	Built.Build( pPositions, pRadii, pValues, COUNT );
+	printf( "%20s %12.3f (%d nodes, %d references)\n", "Build", T.GetElapsedMilliseconds(), Built.GetNodesCount(), Built.GetContentRefsCount() );
+	CHECK( Built.GetNodesCount() == Appended.GetNodesCount() && Built.GetContentRefsCount() == Appended.GetContentRefsCount() && Built.GetNodeLevelsCount() == Appended.GetNodeLevelsCount(), "Bulk built octree differs from the appended one!" );
+
+	// Timings
+	List<U32>	Results( 1024 );
+	U32			Sum = 0;
+	float		Distance;
+	T.Start();
+	for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+		Results.Clear();
+		Built.Fetch( pQueries[QueryIndex].Position, Results );
+		Sum += Results.Count();
+	}
+	printf( "%20s %12.3f\n", "Point", T.GetElapsedMilliseconds() );
+
+	T.Start();
+	for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+		const U32*	pNearest = Built.FetchNearest( pQueries[QueryIndex].Position, Distance );
+		Sum += pNearest != NULL ? *pNearest : 0;
+	}
+	printf( "%20s %12.3f\n", "Nearest", T.GetElapsedMilliseconds() );
+
+	T.Start();
+	for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+		const OctreeQuery&	Q = pQueries[QueryIndex];
+		Results.Clear();
+		Built.FetchInAABB( Q.Position - Q.Extent * bfloat3::One, Q.Position + Q.Extent * bfloat3::One, Results );
+		Sum += Results.Count();
+	}
+	printf( "%20s %12.3f\n", "AABB", T.GetElapsedMilliseconds() );
+
+	T.Start();
+	for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+		Results.Clear();
+		Built.FetchInFrustum( pQueries[QueryIndex].pPlanes, Results );
+		Sum += Results.Count();
+	}
+	printf( "%20s %12.3f\n", "Frustum", T.GetElapsedMilliseconds() );
+
+	T.Start();
+	for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+		Results.Clear();
+		Built.FetchAlongRay( pQueries[QueryIndex].Position, pQueries[QueryIndex].Direction, RAY_LENGTH, Results );
+		Sum += Results.Count();
+	}
+	printf( "%20s %12.3f\n", "Ray", T.GetElapsedMilliseconds() );
+
+	T.Start();
+	for ( U32 QueryIndex=0; QueryIndex < QUERIES_COUNT; QueryIndex++ ) {
+		const U32*	pHit = Built.FetchFirstHit( pQueries[QueryIndex].Position, pQueries[QueryIndex].Direction, Distance, RAY_LENGTH );
+		Sum += pHit != NULL ? *pHit : 0;
+	}
+	printf( "%20s %12.3f\n", "First hit", T.GetElapsedMilliseconds() );
+	gs_BenchmarkSink += Sum;
+
+	// Compare a few queries of each kind against brute force
+	List<U32>	Expected( 1024 );
+	U32			WrongCount = 0;
+	for ( U32 QueryIndex=0; QueryIndex < CHECKED_QUERIES_COUNT; QueryIndex++ ) {
+		const OctreeQuery&	Q = pQueries[QueryIndex];
+
+		// Point
+		Results.Clear();
+		Built.Fetch( Q.Position, Results );
+		Expected.Clear();
+		for ( U32 i=0; i < COUNT; i++ )
+			if ( (pPositions[i] - Q.Position).LengthSq() <= pRadii[i]*pRadii[i] )
+				Expected.Append( pValues[i] );
+		WrongCount += AreSameValues( Results, Expected ) ? 0 : 1;
+
+		// Nearest
+		float	BestSqDistance = FLT_MAX;
+		for ( U32 i=0; i < COUNT; i++ )
+			BestSqDistance = MIN( BestSqDistance, (pPositions[i] - Q.Position).LengthSq() );
+		const U32*	pNearest = Built.FetchNearest( Q.Position, Distance );
+		WrongCount += pNearest != NULL && (pPositions[*pNearest] - Q.Position).LengthSq() == BestSqDistance && Distance == sqrtf( BestSqDistance ) ? 0 : 1;
+
+		// AABB
+		bfloat3	Min = Q.Position - Q.Extent * bfloat3::One;
+		bfloat3	Max = Q.Position + Q.Extent * bfloat3::One;
+		Results.Clear();
+		Built.FetchInAABB( Min, Max, Results );
+		Expected.Clear();
+		for ( U32 i=0; i < COUNT; i++ ) {
+			bfloat3	BBoxMin = pPositions[i] - pRadii[i] * bfloat3::One;
+			bfloat3	BBoxMax = pPositions[i] + pRadii[i] * bfloat3::One;
+			if (	BBoxMax.x >= Min.x && BBoxMin.x <= Max.x
+				&&	BBoxMax.y >= Min.y && BBoxMin.y <= Max.y
+				&&	BBoxMax.z >= Min.z && BBoxMin.z <= Max.z )
+				Expected.Append( pValues[i] );
+		}
+		WrongCount += AreSameValues( Results, Expected ) ? 0 : 1;
+
+		// Frustum
+		Results.Clear();
+		Built.FetchInFrustum( Q.pPlanes, Results );
+		Expected.Clear();
+		for ( U32 i=0; i < COUNT; i++ ) {
+			bool	Inside = true;
+			for ( int PlaneIndex=0; PlaneIndex < 6; PlaneIndex++ ) {
+				const bfloat4&	Plane = Q.pPlanes[PlaneIndex];
+				float	NormalLength = sqrtf( Plane.x*Plane.x + Plane.y*Plane.y + Plane.z*Plane.z );
+				Inside &= pPositions[i].x * Plane.x + pPositions[i].y * Plane.y + pPositions[i].z * Plane.z + Plane.w >= -pRadii[i] * NormalLength;
+			}
+			if ( Inside )
+				Expected.Append( pValues[i] );
+		}
+		WrongCount += AreSameValues( Results, Expected ) ? 0 : 1;
+
+		// Ray & first hit
+		bfloat3	Direction = Q.Direction * (1.0f / Q.Direction.Length());
+		Results.Clear();
+		Built.FetchAlongRay( Q.Position, Q.Direction, RAY_LENGTH, Results );
+		Expected.Clear();
+		float	BestDistance = RAY_LENGTH;
+		bool	Hit = false;
+		for ( U32 i=0; i < COUNT; i++ ) {
+			float	HitDistance = IntersectSphere( pPositions[i], pRadii[i], Q.Position, Direction );
+			if ( HitDistance < 0.0f || HitDistance > RAY_LENGTH )
+				continue;
+			Expected.Append( pValues[i] );
+			if ( HitDistance < BestDistance ) {
+				BestDistance = HitDistance;
+				Hit = true;
+			}
+		}
+		WrongCount += AreSameValues( Results, Expected ) ? 0 : 1;
+
+		const U32*	pHit = Built.FetchFirstHit( Q.Position, Q.Direction, Distance, RAY_LENGTH );
+		WrongCount += (pHit != NULL) == Hit && (!Hit || Distance == BestDistance) ? 0 : 1;
+	}
+	CHECK( WrongCount == 0, "Octree queries differ from brute force!" );
+
+	delete[] pQueries;
+	delete[] pValues;
+	delete[] pRadii;
+	delete[] pPositions;
+
+	printf( "\n" );
+}
+
+
+int _tmain( int argc, _TCHAR* argv[] ) {
+	BenchmarkSort();
+	BenchmarkListGrowth();
+	BenchmarkHashTables();
+	BenchmarkSpatialHashing();
+	BenchmarkMath();
+	BenchmarkHalfFloats();
+	BenchmarkRandomNumbers();
+	BenchmarkAllocators();
+	BenchmarkStreams();
+	BenchmarkVertexCompression();
+	BenchmarkMeshOptimization();
+	BenchmarkMeshSimplification();
+	BenchmarkMinimization();
+	BenchmarkLinearAlgebra();
+	BenchmarkOctree();
+
+	if ( gs_FailedChecksCount > 0 ) {
+		printf( "%d CHECKS FAILED!\n", gs_FailedChecksCount );
+		return 1;
+	}
+	printf( "All checks passed.\n" );
+	return 0;
+}
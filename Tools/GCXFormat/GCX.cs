@@ -198,6 +198,7 @@ namespace GCXFormat
 						case TYPE.MESH:		Child = new Mesh( _Owner, this, _R ); break;
 						default: throw new Exception( "Unsupported node type!" );
 					}
+					Child.m_Type = ChildType;
 					m_Children[ChildIndex] = Child;
 				}
 			}
@@ -434,6 +435,7 @@ namespace GCXFormat
 			public enum	VERTEX_FORMAT
 			{
 				P3N3G3B3T2 = 0,
+				QUANTIZED = 1,	// GCX2 only: U16 position relative to the bounding box, S16 quaternion tangent frame, half UV (cf. BaseLib/Utility/VertexCompression.h)
 			}
 
 			public class	Primitive
@@ -541,9 +543,9 @@ namespace GCXFormat
 					if ( Format != VERTEX_FORMAT.P3N3G3B3T2 )
 						throw new Exception( "Unsupported vertex format!" );
 
-					// Read vertices
-					foreach ( Vertex V in m_Vertices )
-						V.Load( _R );
+					// Read vertices (Vertex is a struct so we can't load through the foreach iteration variable)
+					for ( int VertexIndex=0; VertexIndex < m_Vertices.Length; VertexIndex++ )
+						m_Vertices[VertexIndex].Load( _R );
 
 					// Store absolute vertex offset
 					m_VertexOffset = _Owner.m_Owner.m_TotalVerticesCount;
@@ -970,6 +972,358 @@ namespace GCXFormat
 			m_RootNode.Save( _W );
 		}
 
+		/// <summary>
+		/// Saves the scene in the GCX2 format (cf. Scene/Scene.h for the binary layout)
+		/// The runtime uses GCX2 data in place, so all tables and arrays are 16-bytes aligned and addressed by their offset from the start of the file
+		/// </summary>
+		/// <param name="_W"></param>
+		/// <param name="_QuantizeVertices">True to store 20-bytes quantized vertices instead of 56-bytes P3N3G3B3T2 vertices (this only reduces the file size, the runtime dequantizes them at load time)</param>
+		public void	SaveGCX2( BinaryWriter _W, bool _QuantizeVertices )
+		{
+			const uint	GCX2_VERSION = 2;	// Must match Scene::GCX2_VERSION, the runtime rejects any other version
+
+			// Flatten nodes in breadth-first order so the children of any node are contiguous in the table
+			List<Node>				Nodes = new List<Node>();
+			Dictionary<Node,int>	NodeIndices = new Dictionary<Node,int>();
+			Dictionary<Node,float4x4>	Local2Worlds = new Dictionary<Node,float4x4>();
+			Nodes.Add( m_RootNode );
+			for ( int NodeIndex=0; NodeIndex < Nodes.Count; NodeIndex++ ) {
+				Node	N = Nodes[NodeIndex];
+				NodeIndices[N] = NodeIndex;
+				Local2Worlds[N] = N.m_Parent != null ? N.m_Local2Parent * Local2Worlds[N.m_Parent] : N.m_Local2Parent;
+				Nodes.AddRange( N.m_Children );
+			}
+
+			// Flatten primitives so the primitives of any mesh are contiguous in the table
+			List<Mesh.Primitive>	Primitives = new List<Mesh.Primitive>();
+			Dictionary<Node,int>	FirstPrimitiveIndices = new Dictionary<Node,int>();
+			foreach ( Node N in Nodes ) {
+				Mesh	M = N as Mesh;
+				if ( M == null )
+					continue;
+				FirstPrimitiveIndices[M] = Primitives.Count;
+				Primitives.AddRange( M.m_Primitives );
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// Compute the layout
+			const uint	HEADER_SIZE = 36;
+			const uint	MATERIAL_SIZE = 64;
+			const uint	NODE_SIZE = 112;
+			const uint	PRIMITIVE_SIZE = 96;
+			uint		VERTEX_SIZE = _QuantizeVertices ? 20U : 14U * 4;	// QUANTIZED or P3N3G3B3T2
+
+			uint	Offset = HEADER_SIZE;
+			uint	MaterialsOffset = Align16( Offset );
+			Offset = MaterialsOffset + (uint) m_Materials.Count * MATERIAL_SIZE;
+			uint	NodesOffset = Align16( Offset );
+			Offset = NodesOffset + (uint) Nodes.Count * NODE_SIZE;
+			uint	PrimitivesOffset = Align16( Offset );
+			Offset = PrimitivesOffset + (uint) Primitives.Count * PRIMITIVE_SIZE;
+
+			uint[]	IndicesOffsets = new uint[Primitives.Count];
+			uint[]	VerticesOffsets = new uint[Primitives.Count];
+			for ( int PrimitiveIndex=0; PrimitiveIndex < Primitives.Count; PrimitiveIndex++ ) {
+				IndicesOffsets[PrimitiveIndex] = Align16( Offset );
+				Offset = IndicesOffsets[PrimitiveIndex] + (uint) Primitives[PrimitiveIndex].m_Faces.Length * 3 * 4;
+				VerticesOffsets[PrimitiveIndex] = Align16( Offset );
+				Offset = VerticesOffsets[PrimitiveIndex] + (uint) Primitives[PrimitiveIndex].m_Vertices.Length * VERTEX_SIZE;
+			}
+			uint	TotalSize = Align16( Offset );
+
+			long	StartPosition = _W.BaseStream.Position;
+
+			//////////////////////////////////////////////////////////////////////////
+			// Write header
+			_W.Write( (UInt32) 0x32584347L );	// "GCX2"
+			_W.Write( GCX2_VERSION );
+			_W.Write( TotalSize );
+			_W.Write( (UInt32) m_Materials.Count );
+			_W.Write( MaterialsOffset );
+			_W.Write( (UInt32) Nodes.Count );
+			_W.Write( NodesOffset );
+			_W.Write( (UInt32) Primitives.Count );
+			_W.Write( PrimitivesOffset );
+
+			//////////////////////////////////////////////////////////////////////////
+			// Write materials
+			WritePadding( _W, StartPosition + MaterialsOffset );
+			foreach ( Material M in m_Materials ) {
+				_W.Write( ConvertID( M.m_ID ) );
+				Write( _W, M.m_DiffuseColor );
+				_W.Write( ConvertID( M.m_DiffuseTextureID ) );
+				Write( _W, M.m_SpecularColor );
+				_W.Write( ConvertID( M.m_SpecularTextureID ) );
+				Write( _W, M.m_SpecularExponent );
+				_W.Write( ConvertID( M.m_NormalTextureID ) );
+				Write( _W, M.m_EmissiveColor );
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// Write nodes
+			WritePadding( _W, StartPosition + NodesOffset );
+			foreach ( Node N in Nodes ) {
+				Write( _W, N.m_Local2Parent.r0 );
+				Write( _W, N.m_Local2Parent.r1 );
+				Write( _W, N.m_Local2Parent.r2 );
+				Write( _W, N.m_Local2Parent.r3 );
+				_W.Write( (UInt32) N.m_Type );
+				_W.Write( N.m_Parent != null ? (UInt32) NodeIndices[N.m_Parent] : 0xFFFFFFFFU );
+				_W.Write( N.m_Children.Length > 0 ? (UInt32) NodeIndices[N.m_Children[0]] : 0U );
+				_W.Write( (UInt32) N.m_Children.Length );
+
+				// Write the 32 bytes of specialized infos
+				int	SpecializedSize = 0;
+				if ( N is Mesh ) {
+					_W.Write( (UInt32) FirstPrimitiveIndices[N] );
+					_W.Write( (UInt32) (N as Mesh).m_Primitives.Length );
+					SpecializedSize = 2 * 4;
+				} else if ( N is Light ) {
+					Light	L = N as Light;
+					_W.Write( (UInt32) L.m_LightType );
+					Write( _W, L.m_Color );
+					_W.Write( L.m_Intensity );
+					_W.Write( L.m_HotSpot );
+					_W.Write( L.m_ConeAngle );
+					SpecializedSize = 7 * 4;
+				} else if ( N is Camera ) {
+					_W.Write( (N as Camera).m_FOV );
+					SpecializedSize = 4;
+				}
+				for ( ; SpecializedSize < 32; SpecializedSize++ )
+					_W.Write( (byte) 0 );
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// Write primitives
+			WritePadding( _W, StartPosition + PrimitivesOffset );
+			float3[]	LocalBBoxMins = new float3[Primitives.Count];
+			float3[]	LocalBBoxMaxs = new float3[Primitives.Count];
+			for ( int PrimitiveIndex=0; PrimitiveIndex < Primitives.Count; PrimitiveIndex++ ) {
+				Mesh.Primitive	P = Primitives[PrimitiveIndex];
+
+				// Quantized positions are relative to the local bounding box so it must be exact
+				LocalBBoxMins[PrimitiveIndex] = P.m_BBoxMin;
+				LocalBBoxMaxs[PrimitiveIndex] = P.m_BBoxMax;
+				if ( _QuantizeVertices ) {
+					LocalBBoxMins[PrimitiveIndex] = float.MaxValue * float3.One;
+					LocalBBoxMaxs[PrimitiveIndex] = -float.MaxValue * float3.One;
+					foreach ( Mesh.Primitive.Vertex V in P.m_Vertices ) {
+						LocalBBoxMins[PrimitiveIndex].Min( V.P );
+						LocalBBoxMaxs[PrimitiveIndex].Max( V.P );
+					}
+				}
+
+				// Compute world bounding box from transformed vertices
+				float4x4	Local2World = Local2Worlds[P.m_Owner];
+				float3		GlobalBBoxMin = float.MaxValue * float3.One;
+				float3		GlobalBBoxMax = -float.MaxValue * float3.One;
+				foreach ( Mesh.Primitive.Vertex V in P.m_Vertices ) {
+					float3	WorldPosition = (float3) (new float4( V.P, 1.0f ) * Local2World);
+					GlobalBBoxMin.Min( WorldPosition );
+					GlobalBBoxMax.Max( WorldPosition );
+				}
+
+				_W.Write( ConvertID( P.m_MaterialID ) );
+				_W.Write( (UInt32) P.m_Faces.Length );
+				_W.Write( (UInt32) P.m_Vertices.Length );
+				_W.Write( (UInt32) (_QuantizeVertices ? Mesh.VERTEX_FORMAT.QUANTIZED : Mesh.VERTEX_FORMAT.P3N3G3B3T2) );
+				_W.Write( IndicesOffsets[PrimitiveIndex] );
+				_W.Write( VerticesOffsets[PrimitiveIndex] );
+				_W.Write( 0U );	// Indices are not compressed (use the native Scene::SaveGCX2() with SAVE_COMPRESS)
+				_W.Write( 0U );	// Vertices are not compressed
+				Write( _W, LocalBBoxMins[PrimitiveIndex] );
+				Write( _W, LocalBBoxMaxs[PrimitiveIndex] );
+				Write( _W, GlobalBBoxMin );
+				Write( _W, GlobalBBoxMax );
+				_W.Write( 0U );	// No LODs: bake them with the native Scene::SaveGCX2() (cf. BAKE_SCENE in EffectGlobalIllum2.cpp), otherwise the runtime builds them at load time
+				_W.Write( 0U );
+				_W.Write( 0U );	// Padding
+				_W.Write( 0U );
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			// Write indices and vertices (indices are always 32-bits as the renderer only supports 32-bits index buffers)
+			for ( int PrimitiveIndex=0; PrimitiveIndex < Primitives.Count; PrimitiveIndex++ ) {
+				Mesh.Primitive	P = Primitives[PrimitiveIndex];
+
+				WritePadding( _W, StartPosition + IndicesOffsets[PrimitiveIndex] );
+				foreach ( Mesh.Primitive.Face F in P.m_Faces ) {
+					_W.Write( (UInt32) F.V0 );
+					_W.Write( (UInt32) F.V1 );
+					_W.Write( (UInt32) F.V2 );
+				}
+
+				WritePadding( _W, StartPosition + VerticesOffsets[PrimitiveIndex] );
+				foreach ( Mesh.Primitive.Vertex V in P.m_Vertices )
+					if ( _QuantizeVertices )
+						WriteQuantizedVertex( _W, V, LocalBBoxMins[PrimitiveIndex], LocalBBoxMaxs[PrimitiveIndex] );
+					else
+						V.Save( _W );
+			}
+
+			WritePadding( _W, StartPosition + TotalSize );
+		}
+
+		/// <summary>
+		/// Converts a GCX1 scene file into a GCX2 scene file
+		/// </summary>
+		/// <param name="_Source"></param>
+		/// <param name="_Target"></param>
+		/// <param name="_QuantizeVertices">True to store quantized vertices</param>
+		public static void	ConvertGCX1ToGCX2( FileInfo _Source, FileInfo _Target, bool _QuantizeVertices )
+		{
+			Scene	S = null;
+			using ( FileStream Stream = _Source.OpenRead() )
+				using ( BinaryReader R = new BinaryReader( Stream ) )
+					S = new Scene( R );
+
+			using ( FileStream Stream = _Target.Create() )
+				using ( BinaryWriter W = new BinaryWriter( Stream ) )
+					S.SaveGCX2( W, _QuantizeVertices );
+		}
+
+		private static uint	Align16( uint _Offset )
+		{
+			return (_Offset + 15U) & ~15U;
+		}
+
+		private static void	WritePadding( BinaryWriter _W, long _Position )
+		{
+			while ( _W.BaseStream.Position < _Position )
+				_W.Write( (byte) 0 );
+		}
+
+		private static uint	ConvertID( ushort _ID )
+		{
+			return _ID != 0xFFFF ? _ID : 0xFFFFFFFFU;
+		}
+
+		private static void	Write( BinaryWriter _W, float3 _Value )
+		{
+			_W.Write( _Value.x );
+			_W.Write( _Value.y );
+			_W.Write( _Value.z );
+		}
+
+		private static void	Write( BinaryWriter _W, float4 _Value )
+		{
+			_W.Write( _Value.x );
+			_W.Write( _Value.y );
+			_W.Write( _Value.z );
+			_W.Write( _Value.w );
+		}
+
+		#region Vertex Quantization (must match BaseLib/Utility/VertexCompression.cpp)
+
+		private static void	WriteQuantizedVertex( BinaryWriter _W, Mesh.Primitive.Vertex _V, float3 _BBoxMin, float3 _BBoxMax )
+		{
+			// Write position relative to the bounding box
+			float3	Extent = _BBoxMax - _BBoxMin;
+			for ( int ComponentIndex=0; ComponentIndex < 3; ComponentIndex++ ) {
+				float	E = Extent[ComponentIndex];
+				double	Q = E > 0.0f ? Math.Floor( 65535.0 * (_V.P[ComponentIndex] - _BBoxMin[ComponentIndex]) / E + 0.5 ) : 0.0;
+				_W.Write( (ushort) Math.Max( 0.0, Math.Min( 65535.0, Q ) ) );
+			}
+			_W.Write( (ushort) 0 );
+
+			// Write tangent frame
+			short[]	Quaternion = EncodeTangentFrame( _V.N, _V.G, _V.B );
+			foreach ( short C in Quaternion )
+				_W.Write( C );
+
+			// Write UVs
+			_W.Write( FloatToHalf( _V.T.x ) );
+			_W.Write( FloatToHalf( _V.T.y ) );
+		}
+
+		/// <summary>
+		/// Encodes the tangent frame as a quaternion whose w sign is the handedness of the bitangent
+		/// </summary>
+		private static short[]	EncodeTangentFrame( float3 _Normal, float3 _Tangent, float3 _BiTangent )
+		{
+			// Orthonormalize the frame
+			float3	N = _Normal.LengthSquared > 1e-12f ? _Normal.Normalized : new float3( 0, 0, 1 );
+			float3	T = _Tangent - N.Dot( _Tangent ) * N;
+			if ( T.LengthSquared < 1e-12f )
+				T = Math.Abs( N.x ) < 0.9f ? new float3( 1, 0, 0 ) - N.x * N : new float3( 0, 1, 0 ) - N.y * N;
+			T.Normalize();
+
+			float3	B = N.Cross( T );
+			bool	LeftHanded = B.Dot( _BiTangent ) < 0.0f;
+
+			// Convert the rotation matrix whose columns are (T, B, N) into a quaternion
+			double	x, y, z, w;
+			double	Trace = T.x + B.y + N.z;
+			if ( Trace > 0.0 ) {
+				double	s = 0.5 / Math.Sqrt( Trace + 1.0 );
+				w = 0.25 / s;
+				x = (B.z - N.y) * s;
+				y = (N.x - T.z) * s;
+				z = (T.y - B.x) * s;
+			} else if ( T.x > B.y && T.x > N.z ) {
+				double	s = 2.0 * Math.Sqrt( 1.0 + T.x - B.y - N.z );
+				w = (B.z - N.y) / s;
+				x = 0.25 * s;
+				y = (B.x + T.y) / s;
+				z = (N.x + T.z) / s;
+			} else if ( B.y > N.z ) {
+				double	s = 2.0 * Math.Sqrt( 1.0 + B.y - T.x - N.z );
+				w = (N.x - T.z) / s;
+				x = (B.x + T.y) / s;
+				y = 0.25 * s;
+				z = (N.y + B.z) / s;
+			} else {
+				double	s = 2.0 * Math.Sqrt( 1.0 + N.z - T.x - B.y );
+				w = (T.y - B.x) / s;
+				x = (N.x + T.z) / s;
+				y = (N.y + B.z) / s;
+				z = 0.25 * s;
+			}
+
+			// Make w positive but not 0 so it can carry the handedness
+			double	InvLength = 1.0 / Math.Sqrt( x*x + y*y + z*z + w*w );
+			if ( w < 0.0 )
+				InvLength = -InvLength;
+			x *= InvLength; y *= InvLength; z *= InvLength; w *= InvLength;
+
+			const double	MinW = 1.0 / 32767.0;
+			if ( w < MinW ) {
+				double	Scale = Math.Sqrt( 1.0 - MinW*MinW );
+				x *= Scale; y *= Scale; z *= Scale;
+				w = MinW;
+			}
+			double	Sign = LeftHanded ? -32767.0 : 32767.0;
+
+			return new short[] {
+				(short) Math.Round( Sign * x, MidpointRounding.AwayFromZero ),
+				(short) Math.Round( Sign * y, MidpointRounding.AwayFromZero ),
+				(short) Math.Round( Sign * z, MidpointRounding.AwayFromZero ),
+				(short) Math.Round( Sign * w, MidpointRounding.AwayFromZero ),
+			};
+		}
+
+		/// <summary>
+		/// Converts a float into a half float, rounding to nearest even
+		/// </summary>
+		private static ushort	FloatToHalf( float _Value )
+		{
+			uint	Bits = BitConverter.ToUInt32( BitConverter.GetBytes( _Value ), 0 );
+			uint	Sign = (Bits >> 16) & 0x8000U;
+			uint	Abs = Bits & 0x7FFFFFFFU;
+			if ( Abs >= 0x7F800000U )
+				return (ushort) (Sign | 0x7C00U | (Abs > 0x7F800000U ? 0x200U : 0U));	// Infinity or NaN
+			if ( Abs >= 0x477FF000U )
+				return (ushort) (Sign | 0x7C00U);										// Overflow
+			if ( Abs < 0x38800000U )
+				return (ushort) (Sign | (uint) Math.Round( BitConverter.ToSingle( BitConverter.GetBytes( Abs ), 0 ) * 16777216.0, MidpointRounding.ToEven ));	// Denormal
+
+			uint	Rounded = Abs + 0xFFFU + ((Abs >> 13) & 1U);
+			return (ushort) (Sign | ((Rounded - 0x38000000U) >> 13));
+		}
+
+		#endregion
+
 		private ushort	MapMaterial( FBX.Scene.Materials.MaterialParameters.ParameterTexture2D _Texture )
 		{
 			if ( _Texture == null )
@@ -3,6 +3,10 @@
 
 #include "stdafx.h"
 
+#define NOMINMAX
+#include <windows.h>
+#include <emmintrin.h>
+
 
 // fitLTC.cpp : Defines the entry point for the console application.
 //
@@ -130,10 +134,229 @@ float computeError(const LTC& ltc, const Brdf& brdf, const vec3& V, const float
 	return (float) error;
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Batched error evaluation
+//
+// While the simplex explores the parameter space, computeError() keeps sampling and evaluating the BRDF at the very same
+//	BRDF importance samples: they only depend on the cell being fitted so they're computed once per cell,
+//	and the LTC is then evaluated 4 samples at a time with SSE.
+// The SSE code performs the same correctly-rounded operations as the scalar glm code, in the same order, and the error terms
+//	are accumulated in the same order as computeError(), so the fitted tables are identical to the ones of the original fit.
+//
+const int SAMPLES_COUNT = Nsample*Nsample;
+
+// Directions of the clamped cosine lobe sampled by LTC::sample(), before they're transformed by the LTC matrix
+float	cosineLobeX[SAMPLES_COUNT];
+float	cosineLobeY[SAMPLES_COUNT];
+float	cosineLobeZ[SAMPLES_COUNT];
+
+void initCosineLobeSamples()
+{
+    for (int j = 0; j < Nsample; ++j)
+    for (int i = 0; i < Nsample; ++i)
+    {
+        const float U1 = (i + 0.5f)/Nsample;
+        const float U2 = (j + 0.5f)/Nsample;
+
+        // Same as LTC::sample()
+        const float theta = asinf(sqrtf(U1));
+        const float phi = 2.0f*3.14159f * U2;
+
+        cosineLobeX[i + j*Nsample] = sinf(theta)*cosf(phi);
+        cosineLobeY[i + j*Nsample] = sinf(theta)*sinf(phi);
+        cosineLobeZ[i + j*Nsample] = cosf(theta);
+    }
+}
+
+// Samples used to evaluate the fitting error of a single cell
+struct FitSamples
+{
+    // BRDF importance samples (fixed for the cell)
+    float brdfLx[SAMPLES_COUNT], brdfLy[SAMPLES_COUNT], brdfLz[SAMPLES_COUNT];
+    float brdfEval[SAMPLES_COUNT], brdfPdf[SAMPLES_COUNT];
+
+    // LTC importance samples (updated at each evaluation)
+    float ltcLx[SAMPLES_COUNT], ltcLy[SAMPLES_COUNT], ltcLz[SAMPLES_COUNT];
+    float ltcBrdfEval[SAMPLES_COUNT], ltcBrdfPdf[SAMPLES_COUNT];
+
+    // LTC evaluated at both sets of samples
+    float ltcEvalAtLTC[SAMPLES_COUNT], ltcEvalAtBRDF[SAMPLES_COUNT];
+
+    // MIS-weighted error terms of both sets of samples
+    double errorLTC[SAMPLES_COUNT], errorBRDF[SAMPLES_COUNT];
+};
+
+// Returns M * v for 4 vectors (same operations order as glm)
+inline void transformSSE(const mat3& M, __m128 x, __m128 y, __m128 z, __m128& rx, __m128& ry, __m128& rz)
+{
+    rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(M[0][0]), x), _mm_mul_ps(_mm_set1_ps(M[1][0]), y)), _mm_mul_ps(_mm_set1_ps(M[2][0]), z));
+    ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(M[0][1]), x), _mm_mul_ps(_mm_set1_ps(M[1][1]), y)), _mm_mul_ps(_mm_set1_ps(M[2][1]), z));
+    rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(M[0][2]), x), _mm_mul_ps(_mm_set1_ps(M[1][2]), y)), _mm_mul_ps(_mm_set1_ps(M[2][2]), z));
+}
+
+// Returns the length of 4 vectors (same operations order as glm)
+inline __m128 lengthSSE(__m128 x, __m128 y, __m128 z)
+{
+    return _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+}
+
+// Normalizes 4 vectors (same operations as glm::normalize())
+inline void normalizeSSE(__m128& x, __m128& y, __m128& z)
+{
+    __m128 f = _mm_div_ps(_mm_set1_ps(1.0f), lengthSSE(x, y, z));
+    x = _mm_mul_ps(x, f);
+    y = _mm_mul_ps(y, f);
+    z = _mm_mul_ps(z, f);
+}
+
+// Same as LTC::sample() for all the samples
+void sampleLTC(const LTC& ltc, FitSamples& samples)
+{
+    for (int i = 0; i < SAMPLES_COUNT; i += 4)
+    {
+        __m128 x, y, z;
+        transformSSE(ltc.M, _mm_loadu_ps(cosineLobeX + i), _mm_loadu_ps(cosineLobeY + i), _mm_loadu_ps(cosineLobeZ + i), x, y, z);
+        normalizeSSE(x, y, z);
+        _mm_storeu_ps(samples.ltcLx + i, x);
+        _mm_storeu_ps(samples.ltcLy + i, y);
+        _mm_storeu_ps(samples.ltcLz + i, z);
+    }
+}
+
+// Same as LTC::eval() for all the samples
+void evalLTC(const LTC& ltc, const float* Lx, const float* Ly, const float* Lz, float* result)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 invPi = _mm_set1_ps(1.0f / 3.14159f);
+    const __m128 detM = _mm_set1_ps(ltc.detM);
+    const __m128 magnitude = _mm_set1_ps(ltc.magnitude);
+
+    for (int i = 0; i < SAMPLES_COUNT; i += 4)
+    {
+        __m128 ox, oy, oz;
+        transformSSE(ltc.invM, _mm_loadu_ps(Lx + i), _mm_loadu_ps(Ly + i), _mm_loadu_ps(Lz + i), ox, oy, oz);
+        normalizeSSE(ox, oy, oz);
+
+        __m128 x, y, z;
+        transformSSE(ltc.M, ox, oy, oz, x, y, z);
+
+        __m128 l = lengthSSE(x, y, z);
+        __m128 Jacobian = _mm_div_ps(detM, _mm_mul_ps(_mm_mul_ps(l, l), l));
+
+        // max(0, z) returns 0 for NaNs, and so does maxps which returns its second operand whenever one is a NaN
+        __m128 D = _mm_mul_ps(invPi, _mm_max_ps(oz, zero));
+
+        _mm_storeu_ps(result + i, _mm_div_ps(_mm_mul_ps(magnitude, D), Jacobian));
+    }
+}
+
+// Computes the MIS-weighted error terms |eval_brdf - eval_ltc|^3 / (pdf_ltc + pdf_brdf) in double precision, 2 samples at a time
+void computeErrorTerms(const float* evalBrdf, const float* pdfBrdf, const float* evalLTC, const float magnitude, double* result)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 mag = _mm_set1_ps(magnitude);
+
+    for (int i = 0; i < SAMPLES_COUNT; i += 4)
+    {
+        __m128 eval_brdf = _mm_loadu_ps(evalBrdf + i);
+        __m128 eval_ltc = _mm_loadu_ps(evalLTC + i);
+        __m128 pdf_ltc = _mm_div_ps(eval_ltc, mag);
+        __m128 error = _mm_and_ps(_mm_sub_ps(eval_brdf, eval_ltc), absMask);
+        __m128 pdfSum = _mm_add_ps(pdf_ltc, _mm_loadu_ps(pdfBrdf + i));
+
+        __m128d errorLo = _mm_cvtps_pd(error);
+        __m128d errorHi = _mm_cvtps_pd(_mm_movehl_ps(error, error));
+        __m128d pdfSumLo = _mm_cvtps_pd(pdfSum);
+        __m128d pdfSumHi = _mm_cvtps_pd(_mm_movehl_ps(pdfSum, pdfSum));
+
+        _mm_storeu_pd(result + i, _mm_div_pd(_mm_mul_pd(_mm_mul_pd(errorLo, errorLo), errorLo), pdfSumLo));
+        _mm_storeu_pd(result + i + 2, _mm_div_pd(_mm_mul_pd(_mm_mul_pd(errorHi, errorHi), errorHi), pdfSumHi));
+    }
+}
+
+// Same as computeAvgTerms(), also caching the BRDF importance samples of the cell
+void computeAvgTerms(const Brdf& brdf, const vec3& V, const float alpha,
+    float& norm, float& fresnel, vec3& averageDir, FitSamples& samples)
+{
+    norm = 0.0f;
+    fresnel = 0.0f;
+    averageDir = vec3(0, 0, 0);
+
+    for (int j = 0; j < Nsample; ++j)
+    for (int i = 0; i < Nsample; ++i)
+    {
+        const float U1 = (i + 0.5f)/Nsample;
+        const float U2 = (j + 0.5f)/Nsample;
+        const int sampleIndex = i + j*Nsample;
+
+        // sample
+        const vec3 L = brdf.sample(V, alpha, U1, U2);
+
+        // eval
+        float pdf;
+        float eval = brdf.eval(V, L, alpha, pdf);
+
+        samples.brdfLx[sampleIndex] = L.x;
+        samples.brdfLy[sampleIndex] = L.y;
+        samples.brdfLz[sampleIndex] = L.z;
+        samples.brdfEval[sampleIndex] = eval;
+        samples.brdfPdf[sampleIndex] = pdf;
+
+        if (pdf > 0)
+        {
+            float weight = eval / pdf;
+
+            vec3 H = normalize(V+L);
+
+            // accumulate
+            norm       += weight;
+            fresnel    += weight * pow( 1.0f - max( dot(V, H), 0.0f ), 5.0f);
+            averageDir = averageDir + weight * L;
+        }
+    }
+
+    norm    /= (float)(Nsample*Nsample);
+    fresnel /= (float)(Nsample*Nsample);
+
+    // clear y component, which should be zero with isotropic BRDFs
+    averageDir.y = 0.0f;
+
+    averageDir = normalize(averageDir);
+}
+
+// Same as computeError(), using the cached BRDF samples of the cell
+float computeError(const LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, FitSamples& samples)
+{
+    // importance sample LTC (the BRDF is virtual so it's still evaluated one sample at a time)
+    sampleLTC(ltc, samples);
+    for (int i = 0; i < SAMPLES_COUNT; ++i)
+    {
+        const vec3 L(samples.ltcLx[i], samples.ltcLy[i], samples.ltcLz[i]);
+        samples.ltcBrdfEval[i] = brdf.eval(V, L, alpha, samples.ltcBrdfPdf[i]);
+    }
+    evalLTC(ltc, samples.ltcLx, samples.ltcLy, samples.ltcLz, samples.ltcEvalAtLTC);
+    computeErrorTerms(samples.ltcBrdfEval, samples.ltcBrdfPdf, samples.ltcEvalAtLTC, ltc.magnitude, samples.errorLTC);
+
+    // importance sample BRDF
+    evalLTC(ltc, samples.brdfLx, samples.brdfLy, samples.brdfLz, samples.ltcEvalAtBRDF);
+    computeErrorTerms(samples.brdfEval, samples.brdfPdf, samples.ltcEvalAtBRDF, ltc.magnitude, samples.errorBRDF);
+
+    // accumulate in the same order as computeError()
+    double error = 0.0;
+    for (int i = 0; i < SAMPLES_COUNT; ++i)
+    {
+        error += samples.errorLTC[i];
+        error += samples.errorBRDF[i];
+    }
+
+    error /= Nsample*Nsample;
+	return (float) error;
+}
+
 struct FitLTC
 {
-    FitLTC(LTC& ltc_, const Brdf& brdf, bool isotropic_, const vec3& V_, float alpha_) :
-        ltc(ltc_), brdf(brdf), V(V_), alpha(alpha_), isotropic(isotropic_)
+    FitLTC(LTC& ltc_, const Brdf& brdf, bool isotropic_, const vec3& V_, float alpha_, FitSamples* samples_) :
+        ltc(ltc_), brdf(brdf), V(V_), alpha(alpha_), isotropic(isotropic_), samples(samples_)
     {
     }
 
@@ -161,7 +384,7 @@ struct FitLTC
     float operator()(const float* params)
     {
         update(params);
-        double	error = computeError(ltc, brdf, V, alpha);
+        double	error = samples != NULL ? computeError(ltc, brdf, V, alpha, *samples) : computeError(ltc, brdf, V, alpha);
 		return (float) error;
     }
 
@@ -171,16 +394,18 @@ struct FitLTC
 
     const vec3& V;
     float alpha;
+
+    FitSamples* samples;    // Cached samples of the cell, or NULL to use the reference computeError()
 };
 
 // fit brute force
 // refine first guess by exploring parameter space
-void fit(LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const float epsilon = 0.05f, const bool isotropic = false)
+void fit(LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const float epsilon = 0.05f, const bool isotropic = false, FitSamples* samples = NULL)
 {
     float startFit[3] = { ltc.m11, ltc.m22, ltc.m13 };
     float resultFit[3];
 
-    FitLTC fitter(ltc, brdf, isotropic, V, alpha);
+    FitLTC fitter(ltc, brdf, isotropic, V, alpha, samples);
 
     // Find best-fit LTC lobe (scale, alphax, alphay)
     float error = NelderMead<3>(resultFit, startFit, epsilon, 1e-5f, 100, fitter);
@@ -189,18 +414,11 @@ void fit(LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const flo
     fitter.update(resultFit);
 }
 
-// fit data
-void fitTab(mat3* tab, vec3* tabMagFresnel, const int N, const Brdf& brdf)
+// fit a single cell of the table
+// ltc holds the result of the previous fit, used as first guess when t > 0
+// if theta == 0 the first guess is the fit of the cell with the next roughness, which must have been fitted already
+void fitCell(LTC& ltc, mat3* tab, vec3* tabMagFresnel, const int N, const int a, const int t, const Brdf& brdf, FitSamples* samples = NULL)
 {
-    LTC ltc;
-
-    // loop over theta and alpha
-//     for (int a = N - 1; a >=     0; --a)
-//     for (int t =     0; t <= N - 1; ++t)
-
-int	a = 24;
-int	t = 56;
-
     {
         // parameterised by sqrt(1 - cos(theta))
         float x = t/float(N - 1);
@@ -212,12 +430,11 @@ int	t = 56;
         float roughness = a/float(N - 1);
         float alpha = std::max<float>(roughness*roughness, MIN_ALPHA);
 
-        cout << "a = " << a << "\t t = " << t  << endl;
-        cout << "alpha = " << alpha << "\t theta = " << theta << endl;
-        cout << endl;
-
         vec3 averageDir;
-        computeAvgTerms(brdf, V, alpha, ltc.magnitude, ltc.fresnel, averageDir);
+        if (samples != NULL)
+            computeAvgTerms(brdf, V, alpha, ltc.magnitude, ltc.fresnel, averageDir, *samples);
+        else
+            computeAvgTerms(brdf, V, alpha, ltc.magnitude, ltc.fresnel, averageDir);
 
         bool isotropic;
 
@@ -262,14 +479,14 @@ int	t = 56;
         }
 
 
-logFile << "LTC m11 = " << ltc.m11 << ", m22 = " << ltc.m22  << ", m13 = " << ltc.m13 << endl;
-logFile << "LTC Z = { " << averageDir.x << ", " << averageDir.y << ", " << averageDir.z << " }" << endl;
-logFile << "LTC mag = " << ltc.magnitude << ", fresnel = " << ltc.fresnel << endl;
-logFile << endl;
+LOG_FIT( "LTC m11 = " << ltc.m11 << ", m22 = " << ltc.m22  << ", m13 = " << ltc.m13 );
+LOG_FIT( "LTC Z = { " << averageDir.x << ", " << averageDir.y << ", " << averageDir.z << " }" );
+LOG_FIT( "LTC mag = " << ltc.magnitude << ", fresnel = " << ltc.fresnel );
+LOG_FIT( "" );
 
         // 2. fit (explore parameter space and refine first guess)
         float epsilon = 0.05f;
-        fit(ltc, brdf, V, alpha, epsilon, isotropic);
+        fit(ltc, brdf, V, alpha, epsilon, isotropic, samples);
 
         // copy data
         tab[a + t*N] = ltc.M;
@@ -281,7 +498,21 @@ logFile << endl;
         tab[a+t*N][1][0] = 0;
         tab[a+t*N][2][1] = 0;
         tab[a+t*N][1][2] = 0;
+    }
+}
+
+// fit data
+void fitTab(mat3* tab, vec3* tabMagFresnel, const int N, const Brdf& brdf)
+{
+    LTC ltc;
 
+    // loop over theta and alpha
+    for (int a = N - 1; a >=     0; --a)
+    for (int t =     0; t <= N - 1; ++t)
+    {
+        fitCell(ltc, tab, tabMagFresnel, N, a, t, brdf);
+
+        cout << "a = " << a << "\t t = " << t  << endl;
         cout << tab[a+t*N][0][0] << "\t " << tab[a+t*N][1][0] << "\t " << tab[a+t*N][2][0] << endl;
         cout << tab[a+t*N][0][1] << "\t " << tab[a+t*N][1][1] << "\t " << tab[a+t*N][2][1] << endl;
         cout << tab[a+t*N][0][2] << "\t " << tab[a+t*N][1][2] << "\t " << tab[a+t*N][2][2] << endl;
@@ -289,6 +520,113 @@ logFile << endl;
     }
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Parallel fit
+//
+// The serial fit warm-starts each cell from the previous one: cell (a, t) starts from the fit of (a, t-1),
+//	and the first cell (a, 0) of each roughness column starts from (a+1, 0).
+// All the cells on a wavefront (N-1-a) + t = constant only depend on cells of the previous wavefront,
+//	so the wavefronts are fitted one after another with all the cells of a wavefront fitted in parallel.
+// Each cell starts from the exact same first guess as in the serial fit, so the tables are identical.
+//
+struct WavefrontJob
+{
+    mat3* tab;
+    vec3* tabMagFresnel;
+    float (*columnFits)[3];     // m11, m22, m13 of the last cell fitted in each roughness column
+    const Brdf* brdf;
+    int N;
+
+    int firstA;                 // Roughness index of the first cell of the wavefront
+    int wavefront;              // (N-1-a) + t
+    int cellsCount;
+    volatile LONG nextCell;
+
+    void fitWavefrontCell(int cellIndex, FitSamples& samples)
+    {
+        const int a = firstA + cellIndex;
+        const int t = wavefront - (N - 1 - a);
+
+        // restore the state left by the previous cell of the column in the serial fit
+        LTC ltc;
+        if (t > 0)
+        {
+            ltc.m11 = columnFits[a][0];
+            ltc.m22 = columnFits[a][1];
+            ltc.m13 = columnFits[a][2];
+        }
+
+        fitCell(ltc, tab, tabMagFresnel, N, a, t, *brdf, &samples);
+
+        columnFits[a][0] = ltc.m11;
+        columnFits[a][1] = ltc.m22;
+        columnFits[a][2] = ltc.m13;
+    }
+
+    void run()
+    {
+        FitSamples* samples = new FitSamples;
+        while (true)
+        {
+            const int cellIndex = InterlockedIncrement(&nextCell) - 1;
+            if (cellIndex >= cellsCount)
+                break;
+            fitWavefrontCell(cellIndex, *samples);
+        }
+        delete samples;
+    }
+
+    static DWORD WINAPI threadProc(LPVOID job)
+    {
+        ((WavefrontJob*) job)->run();
+        return 0;
+    }
+};
+
+// fit data on all the hardware threads
+void fitTabParallel(mat3* tab, vec3* tabMagFresnel, const int N, const Brdf& brdf)
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    const int threadsCount = std::min<int>(std::max<int>(systemInfo.dwNumberOfProcessors, 1), MAXIMUM_WAIT_OBJECTS);
+
+    float (*columnFits)[3] = new float[N][3];
+    HANDLE* threads = new HANDLE[threadsCount];
+
+    WavefrontJob job;
+    job.tab = tab;
+    job.tabMagFresnel = tabMagFresnel;
+    job.columnFits = columnFits;
+    job.brdf = &brdf;
+    job.N = N;
+
+    const DWORD startTime = GetTickCount();
+    for (int wavefront = 0; wavefront < 2*N-1; ++wavefront)
+    {
+        job.wavefront = wavefront;
+        job.firstA = std::max<int>(0, N-1 - wavefront);
+        job.cellsCount = std::min<int>(N-1, 2*N-2 - wavefront) - job.firstA + 1;
+        job.nextCell = 0;
+
+        // the calling thread takes part in the work
+        const int workersCount = std::min<int>(threadsCount, job.cellsCount) - 1;
+        for (int i = 0; i < workersCount; ++i)
+            threads[i] = CreateThread(NULL, 0, WavefrontJob::threadProc, &job, 0, NULL);
+        job.run();
+        if (workersCount > 0)
+        {
+            WaitForMultipleObjects(workersCount, threads, TRUE, INFINITE);
+            for (int i = 0; i < workersCount; ++i)
+                CloseHandle(threads[i]);
+        }
+
+        cout << "wavefront " << wavefront+1 << "/" << 2*N-1 << " (" << job.cellsCount << " cells)\t " << (GetTickCount() - startTime) / 1000 << "s" << endl;
+    }
+
+    delete[] threads;
+    delete[] columnFits;
+}
+
 float sqr(float x)
 {
     return x*x;
@@ -438,7 +776,13 @@ void writeTabC( mat3* tab, vec3* tabMagFresnel, int N ) {
 }
 
 
+// Usage: DemoCode [-serial | -check]
+//	-serial fits the table with the original serial code
+//	-check fits the table with both the parallel and the serial code and compares the results
 int _tmain(int argc, _TCHAR* argv[]) {
+	bool	serial = argc > 1 && _tcscmp( argv[1], _T("-serial") ) == 0;
+	bool	check = argc > 1 && _tcscmp( argv[1], _T("-check") ) == 0;
+
 	// BRDF to fit
 	BrdfGGX brdf;
 	//BrdfBeckmann brdf;
@@ -450,7 +794,31 @@ int _tmain(int argc, _TCHAR* argv[]) {
 	float* tabSphere = new float[N*N];
 
 	// fit
-	fitTab(tab, tabMagFresnel, N, brdf);
+	if ( serial ) {
+		fitTab(tab, tabMagFresnel, N, brdf);
+	} else {
+		initCosineLobeSamples();
+		fitTabParallel(tab, tabMagFresnel, N, brdf);
+	}
+
+	if ( check ) {
+		mat3*  serialTab = new mat3[N*N];
+		vec3*  serialTabMagFresnel = new vec3[N*N];
+		fitTab(serialTab, serialTabMagFresnel, N, brdf);
+
+		int	mismatchesCount = 0;
+		for ( int i=0; i < N*N; i++ )
+			if (   memcmp( &tab[i], &serialTab[i], sizeof(mat3) ) != 0
+				|| tabMagFresnel[i].x != serialTabMagFresnel[i].x
+				|| tabMagFresnel[i].y != serialTabMagFresnel[i].y ) {
+				cout << "Mismatch at a = " << i%N << "\t t = " << i/N << endl;
+				mismatchesCount++;
+			}
+		cout << mismatchesCount << " mismatching cells out of " << N*N << endl;
+
+		delete[] serialTab;
+		delete[] serialTabMagFresnel;
+	}
 
 // 	// projected solid angle of a spherical cap, clipped to the horizon
 // 	genSphereTab(tabSphere, N);
@@ -22,7 +22,13 @@ void add(float* r, const float* v, int dim)
 // Downhill simplex solver:
 // http://en.wikipedia.org/wiki/Nelder%E2%80%93Mead_method#One_possible_variation_of_the_NM_algorithm
 // using the termination criterion from Numerical Recipes in C++ (3rd Ed.)
+// Define LOG_NELDER_MEAD to trace the iterations into log.txt (serial fits only, the log is shared by all the fits)
+#ifdef LOG_NELDER_MEAD
 ofstream logFile( "log.txt" );
+#define LOG_FIT( x )	logFile << x << endl
+#else
+#define LOG_FIT( x )
+#endif
 
 template<int DIM, typename FUNC>
 float NelderMead(
@@ -49,10 +55,10 @@ float NelderMead(
     }
 
     // evaluate function at each point on simplex
-logFile << "Init" << endl;
+LOG_FIT( "Init" );
     for (int i = 0; i < NB_POINTS; i++) {
         f[i] = objectiveFn(s[i]);
-logFile << "f[" << i << "] = " << f[i] << endl;
+LOG_FIT( "f[" << i << "] = " << f[i] );
 	}
 
     int lo = 0, hi, nh;
@@ -60,9 +66,9 @@ logFile << "f[" << i << "] = " << f[i] << endl;
 	int	iterationsCount = 0;
     for (; iterationsCount < maxIters; iterationsCount++)
     {
-logFile << endl;
-logFile << "===================================" << endl;
-logFile << "Iteration #" << iterationsCount << endl;
+LOG_FIT( "" );
+LOG_FIT( "===================================" );
+LOG_FIT( "Iteration #" << iterationsCount );
 
         // find lowest, highest and next highest
         lo = hi = nh = 0;
@@ -78,7 +84,7 @@ logFile << "Iteration #" << iterationsCount << endl;
             else if (f[i] > f[nh])
                 nh = i;
 
-logFile << "f[" << i << "] = " << f[i] << endl;
+LOG_FIT( "f[" << i << "] = " << f[i] );
         }
 
         // stop if we've reached the required tolerance level
@@ -99,7 +105,7 @@ logFile << "f[" << i << "] = " << f[i] << endl;
         for (int i = 0; i < DIM; i++)
             o[i] /= DIM;
 
-logFile << "centroid = {" << o[0] << ", " << o[1] << ", " << o[2] << "}" << endl;
+LOG_FIT( "centroid = {" << o[0] << ", " << o[1] << ", " << o[2] << "}" );
 
         // reflection
         point r;
@@ -108,8 +114,8 @@ logFile << "centroid = {" << o[0] << ", " << o[1] << ", " << o[2] << "}" << endl
 
         float fr = objectiveFn(r);
 
-logFile << "reflection = {" << r[0] << ", " << r[1] << ", " << r[2] << "}" << endl;
-logFile << "reflection error = " << fr << endl;
+LOG_FIT( "reflection = {" << r[0] << ", " << r[1] << ", " << r[2] << "}" );
+LOG_FIT( "reflection error = " << fr );
 
         if (fr < f[nh])
         {
@@ -121,14 +127,14 @@ logFile << "reflection error = " << fr << endl;
                     e[i] = o[i] + expand*(o[i] - s[hi][i]);
                 float fe = objectiveFn(e);
 
-logFile << "expansion = {" << e[0] << ", " << e[1] << ", " << e[2] << "}" << endl;
-logFile << "expansion error = " << fe << endl;
+LOG_FIT( "expansion = {" << e[0] << ", " << e[1] << ", " << e[2] << "}" );
+LOG_FIT( "expansion error = " << fe );
 
                 if (fe < fr)
                 {
                     mov(s[hi], e, DIM);
                     f[hi] = fe;
-logFile << "CHOSE EXPANSION" << endl;
+LOG_FIT( "CHOSE EXPANSION" );
                     continue;
                 }
             }
@@ -136,7 +142,7 @@ logFile << "CHOSE EXPANSION" << endl;
             mov(s[hi], r, DIM);
             f[hi] = fr;
 
-logFile << "CHOSE REFLECTION" << endl;
+LOG_FIT( "CHOSE REFLECTION" );
             continue;
         }
 
@@ -147,14 +153,14 @@ logFile << "CHOSE REFLECTION" << endl;
 
         float fc = objectiveFn(c);
 
-logFile << "contraction = {" << c[0] << ", " << c[1] << ", " << c[2] << "}" << endl;
-logFile << "contraction error = " << fc << endl;
+LOG_FIT( "contraction = {" << c[0] << ", " << c[1] << ", " << c[2] << "}" );
+LOG_FIT( "contraction error = " << fc );
 
         if (fc < f[hi])
         {
             mov(s[hi], c, DIM);
             f[hi] = fc;
-logFile << "CHOSE CONTRACTION" << endl;
+LOG_FIT( "CHOSE CONTRACTION" );
             continue;
         }
 
@@ -166,18 +172,18 @@ logFile << "CHOSE CONTRACTION" << endl;
                 s[k][i] = s[lo][i] + shrink*(s[k][i] - s[lo][i]);
             f[k] = objectiveFn(s[k]);
         }
-logFile << "CHOSE REDUCTION" << endl;
+LOG_FIT( "CHOSE REDUCTION" );
     }
 
     // return best point and its value
     mov(pmin, s[lo], DIM);
 
-logFile << endl;
-logFile << endl;
-logFile << "===================================" << endl;
-logFile << "Exiting after " << iterationsCount << " iterations" << endl;
-logFile << "Result = {" << pmin[0] << ", " << pmin[1] << ", " << pmin[2] << "}" << endl;
-logFile << "Error = " << f[lo] << endl;
+LOG_FIT( "" );
+LOG_FIT( "" );
+LOG_FIT( "===================================" );
+LOG_FIT( "Exiting after " << iterationsCount << " iterations" );
+LOG_FIT( "Result = {" << pmin[0] << ", " << pmin[1] << ", " << pmin[2] << "}" );
+LOG_FIT( "Error = " << f[lo] );
 
 	return f[lo];
 }
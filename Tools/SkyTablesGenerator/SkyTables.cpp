@@ -0,0 +1,919 @@
+#include "stdafx.h"
+#include "SkyTables.h"
+#include "../../BaseLib/Utility/Parallel.h"
+
+#include <float.h>
+
+namespace {
+	// Same as Inc/Atmosphere.hlsl
+	const float	ATMOSPHERE_THICKNESS_KM = 60.0f;
+	const float	GROUND_RADIUS_KM = 6360.0f;
+	const float	ATMOSPHERE_RADIUS_KM = GROUND_RADIUS_KM + ATMOSPHERE_THICKNESS_KM;
+	const float	CAMERA_RADIUS_KM = GROUND_RADIUS_KM + 4.0f;	// MAX_CAMERA_ALTITUDE, used to normalize the altitude in GetIrradiance()
+
+	// Upper bound on the integration steps along a view ray, so the per-scanline quantities fit on the stack
+	const int	MAX_RAY_STEPS_COUNT = 512;
+
+	const U32	TRANSMITTANCE_SIZE = SkyTables::TRANSMITTANCE_W * SkyTables::TRANSMITTANCE_H;
+	const U32	IRRADIANCE_SIZE = SkyTables::IRRADIANCE_W * SkyTables::IRRADIANCE_H;
+	const U32	SCATTERING_SIZE = SkyTables::RES_3D_U * SkyTables::RES_3D_COS_THETA_VIEW * SkyTables::RES_3D_ALTITUDE;
+	const U32	SCATTERING_ROWS_COUNT = SkyTables::RES_3D_COS_THETA_VIEW * SkyTables::RES_3D_ALTITUDE;
+
+	inline __m128	SigmaScatteringRayleigh()	{ return _mm_set_ps( 0.0f, 0.0331f, 0.0135f, 0.0058f ); }	// For lambdas (680,550,440) nm
+	inline __m128	MaskXYZ()					{ return _mm_castsi128_ps( _mm_set_epi32( 0, -1, -1, -1 ) ); }
+
+	inline __m128	Lerp( __m128 a, __m128 b, float t )	{ return _mm_add_ps( a, _mm_mul_ps( _mm_sub_ps( b, a ), _mm_set1_ps( t ) ) ); }
+	inline __m128	Scale( __m128 a, float s )				{ return _mm_mul_ps( a, _mm_set1_ps( s ) ); }
+	inline __m128	Fetch( const float* _pTexel )			{ return _mm_load_ps( _pTexel ); }
+
+	inline float	Pow1_5( float x )	{ return x * sqrtf( x ); }
+
+	float*	AllocateTable( U32 _TexelsCount )	{ return (float*) BaseLib::GetDefaultAllocator().Allocate( 4 * _TexelsCount * sizeof(float), 16 ); }
+	void	FreeTable( float*& _pTable, U32 _TexelsCount ) {
+		BaseLib::GetDefaultAllocator().Free( _pTable, 4 * _TexelsCount * sizeof(float), 16 );
+		_pTable = NULL;
+	}
+
+	// Distance from a point at the given altitude to the exit of a sphere centered on the Earth
+	float	SphereIntersectionExit( float _AltitudeKm, float _CosTheta, float _SphereAltitudeKm ) {
+		float	R = _SphereAltitudeKm + GROUND_RADIUS_KM;
+		float	Dy = _AltitudeKm + GROUND_RADIUS_KM;
+		float	c = Dy*Dy - R*R;
+		float	b = Dy * _CosTheta;
+		float	Delta = b*b - c;
+		return Delta > 0.0f ? -b + sqrtf( Delta ) : -FLT_MAX;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// 0] Transmittance table for all possible altitudes and zenith angles
+	struct	TransmittanceJob {
+		const SkyTables::Parameters*	pParams;
+		float*							pTarget;
+
+		void	operator()( U32 _Y ) {
+			const float	TAN_1_5 = tanf( 1.5f );
+			const float	InvHrefAir = -0.5f / pParams->AirReferenceAltitudeKm;
+			const float	InvHrefFog = -0.5f / pParams->FogReferenceAltitudeKm;
+			const int	StepsCount = pParams->StepsCountTransmittance;
+			const __m128	SigmaAir = Scale( SigmaScatteringRayleigh(), pParams->AirAmount );
+			const __m128	SigmaFog = _mm_and_ps( _mm_set1_ps( pParams->FogExtinction ), MaskXYZ() );
+
+			float	V = float(_Y) / SkyTables::TRANSMITTANCE_H;
+			float	AltitudeKm = V*V * ATMOSPHERE_THICKNESS_KM;	// Grow quadratically to have more precision near the ground
+
+			float*	pTexel = pTarget + 4 * SkyTables::TRANSMITTANCE_W * _Y;
+			for ( int X=0; X < SkyTables::TRANSMITTANCE_W; X++, pTexel+=4 ) {
+				float	U = float(X) / SkyTables::TRANSMITTANCE_W;
+				float	CosTheta = -0.15f + tanf( 1.5f * U ) / TAN_1_5 * (1.0f + 0.15f);	// Grow tangentially to have more precision horizontally
+				float	SinTheta = sqrtf( 1.0f - CosTheta*CosTheta );
+
+				// Integrate Rayleigh & Mie optical depth to the top of atmosphere, using the integral of a linear interpolation in altitude on each step
+				float	TraceDistanceKm = SphereIntersectionExit( AltitudeKm, CosTheta, ATMOSPHERE_THICKNESS_KM );
+				float	StepSizeKm = TraceDistanceKm / StepsCount;
+				float	StepX = StepSizeKm * SinTheta;
+				float	StepY = StepSizeKm * CosTheta;
+
+				float	PositionX = 0.0f, PositionY = AltitudeKm;
+				float	PreviousAltitudeKm = AltitudeKm;
+				float	DepthAir = 0.0f, DepthFog = 0.0f;
+				for ( int StepIndex=0; StepIndex < StepsCount; StepIndex++ ) {
+					PositionX += StepX;
+					PositionY += StepY;
+					float	Radius = PositionY + GROUND_RADIUS_KM;
+					float	CurrentAltitudeKm = sqrtf( PositionX*PositionX + Radius*Radius ) - GROUND_RADIUS_KM;
+					float	SumAltitudesKm = MAX( 0.0f, PreviousAltitudeKm + CurrentAltitudeKm );
+					DepthAir += expf( SumAltitudesKm * InvHrefAir );
+					DepthFog += expf( SumAltitudesKm * InvHrefFog );
+					PreviousAltitudeKm = CurrentAltitudeKm;
+				}
+
+				__m128	OpticalDepth = _mm_add_ps( Scale( SigmaAir, StepSizeKm * DepthAir ), Scale( SigmaFog, StepSizeKm * DepthFog ) );
+				float	Depth[4];
+				_mm_storeu_ps( Depth, OpticalDepth );
+				pTexel[0] = expf( -Depth[0] );
+				pTexel[1] = expf( -Depth[1] );
+				pTexel[2] = expf( -Depth[2] );
+				pTexel[3] = 0.0f;
+			}
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// 1] Ground irradiance table accounting for direct lighting only
+	struct	IrradianceSingleJob {
+		const SkyTables*	pOwner;
+		float*				pTarget;
+
+		void	operator()( U32 _Y ) {
+			float	AltitudeKm = float(_Y) / SkyTables::IRRADIANCE_H * ATMOSPHERE_THICKNESS_KM;
+			float*	pTexel = pTarget + 4 * SkyTables::IRRADIANCE_W * _Y;
+			for ( int X=0; X < SkyTables::IRRADIANCE_W; X++, pTexel+=4 ) {
+				float	CosThetaSun = LERP( -0.2f, 1.0f, float(X) / SkyTables::IRRADIANCE_W );
+				float	Reflectance = SATURATE( CosThetaSun );
+				_mm_store_ps( pTexel, _mm_and_ps( Scale( pOwner->GetTransmittance( AltitudeKm, CosThetaSun ), Reflectance ), MaskXYZ() ) );
+			}
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// 2] Single scattering table, Rayleigh and Mie stored separately WITHOUT the phase function factor
+	// The view ray only depends on the scanline so the view transmittance and the altitude along the ray are computed once for all the texels
+	struct	InScatteringSingleJob {
+		const SkyTables*	pOwner;
+		float*				pTargetRayleigh;
+		float*				pTargetMie;
+
+		void	operator()( U32 _RowIndex ) {
+			const SkyTables::Parameters&	Params = pOwner->GetParameters();
+			const int	StepsCount = Params.StepsCountSingleScattering;
+			int		Y = _RowIndex % SkyTables::RES_3D_COS_THETA_VIEW;
+			int		Z = _RowIndex / SkyTables::RES_3D_COS_THETA_VIEW;
+
+			float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+			SkyTables::GetSliceData( 0, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+			float	RadiusKm = GROUND_RADIUS_KM + AltitudeKm;
+			float	StartAltitudeKm = RadiusKm - GROUND_RADIUS_KM;
+			bool	GroundHit;
+			float	TraceDistanceKm = SkyTables::ComputeNearestHit( AltitudeKm, CosThetaView, GroundHit );
+			float	StepSizeKm = TraceDistanceKm / StepsCount;
+
+			// Quantities along the view ray
+			float	DistanceKm[MAX_RAY_STEPS_COUNT+1];
+			float	InvRadiusKm[MAX_RAY_STEPS_COUNT+1];			// 1/CurrentRadius, before clamping to the ground
+			float	CosThetaHorizon[MAX_RAY_STEPS_COUNT+1];		// Sun below that angle is hidden by the ground
+			float	CurrentAltitudeKm[MAX_RAY_STEPS_COUNT+1];
+			__m128	DensityRayleigh[MAX_RAY_STEPS_COUNT+1];		// Air density * view transmittance
+			__m128	DensityMie[MAX_RAY_STEPS_COUNT+1];			// Fog density * view transmittance
+
+			float	Distance = 0.0f;
+			for ( int StepIndex=0; StepIndex <= StepsCount; StepIndex++ ) {
+				DistanceKm[StepIndex] = Distance;
+
+				float	CurrentRadiusKm = sqrtf( RadiusKm * RadiusKm + Distance * Distance + 2.0f * RadiusKm * CosThetaView * Distance );
+				InvRadiusKm[StepIndex] = 1.0f / CurrentRadiusKm;
+				CurrentRadiusKm = MAX( GROUND_RADIUS_KM, CurrentRadiusKm );
+				CosThetaHorizon[StepIndex] = -sqrtf( MAX( 0.0f, 1.0f - GROUND_RADIUS_KM * GROUND_RADIUS_KM / (CurrentRadiusKm * CurrentRadiusKm) ) );
+				CurrentAltitudeKm[StepIndex] = CurrentRadiusKm - GROUND_RADIUS_KM;
+
+				__m128	ViewTransmittance = pOwner->GetTransmittance( StartAltitudeKm, CosThetaView, Distance );
+				DensityRayleigh[StepIndex] = Scale( ViewTransmittance, expf( -CurrentAltitudeKm[StepIndex] / Params.AirReferenceAltitudeKm ) );
+				DensityMie[StepIndex] = Scale( ViewTransmittance, expf( -CurrentAltitudeKm[StepIndex] / Params.FogReferenceAltitudeKm ) );
+
+				Distance = StepIndex == 0 ? StepSizeKm : Distance + StepSizeKm;
+			}
+
+			const __m128	Half = _mm_set1_ps( 0.5f );
+			const __m128	ScaleRayleigh = _mm_and_ps( Scale( SigmaScatteringRayleigh(), Params.AirAmount * StepSizeKm ), MaskXYZ() );
+			const __m128	ScaleMie = _mm_and_ps( _mm_set1_ps( Params.FogScattering * StepSizeKm ), MaskXYZ() );
+
+			U32		TexelOffset = 4 * SkyTables::RES_3D_U * _RowIndex;
+			float*	pRayleigh = pTargetRayleigh + TexelOffset;
+			float*	pMie = pTargetMie + TexelOffset;
+			for ( int X=0; X < SkyTables::RES_3D_U; X++, pRayleigh+=4, pMie+=4 ) {
+				SkyTables::GetSliceData( X, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+				__m128	Rayleigh = _mm_setzero_ps();
+				__m128	Mie = _mm_setzero_ps();
+				__m128	PreviousRayleigh = _mm_setzero_ps();
+				__m128	PreviousMie = _mm_setzero_ps();
+				for ( int StepIndex=0; StepIndex <= StepsCount; StepIndex++ ) {
+					__m128	CurrentRayleigh = _mm_setzero_ps();
+					__m128	CurrentMie = _mm_setzero_ps();
+
+					float	CurrentCosThetaSun = (RadiusKm * CosThetaSun + CosGamma * DistanceKm[StepIndex]) * InvRadiusKm[StepIndex];
+					if ( CurrentCosThetaSun >= CosThetaHorizon[StepIndex] ) {
+						__m128	SunTransmittance = pOwner->GetTransmittance( CurrentAltitudeKm[StepIndex], CurrentCosThetaSun );
+						CurrentRayleigh = _mm_mul_ps( DensityRayleigh[StepIndex], SunTransmittance );
+						CurrentMie = _mm_mul_ps( DensityMie[StepIndex], SunTransmittance );
+					}	// Otherwise we're hitting the ground in that direction, ignore contribution...
+
+					if ( StepIndex > 0 ) {
+						Rayleigh = _mm_add_ps( Rayleigh, _mm_mul_ps( Half, _mm_add_ps( PreviousRayleigh, CurrentRayleigh ) ) );
+						Mie = _mm_add_ps( Mie, _mm_mul_ps( Half, _mm_add_ps( PreviousMie, CurrentMie ) ) );
+					}
+					PreviousRayleigh = CurrentRayleigh;
+					PreviousMie = CurrentMie;
+				}
+
+				_mm_store_ps( pRayleigh, _mm_mul_ps( Rayleigh, ScaleRayleigh ) );
+				_mm_store_ps( pMie, _mm_mul_ps( Mie, ScaleMie ) );
+			}
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// 3] Delta scattering table J, the light scattered toward the view from all the directions around each point
+	//
+	// For a given altitude slice, the Sun angle and the sampling direction theta fully determine the (U,V,W) coordinates of the
+	//	lookups in the deltaS tables: only the cos(gamma) slab varies with the phi direction.
+	// So for each slice we fetch the trilinear samples of all the slabs once, and texels only interpolate between 2 of them.
+	//
+	const int	GAMMA_SLABS_COUNT = SkyTables::RES_3D_COS_GAMMA + 3;	// Slabs -1 to RES_3D_COS_GAMMA+1 (coordinates outside [0,1] are clamped)
+
+	struct	SliceSamples {
+		float	AltitudeKm;
+		float	RadiusKm;					// Clamped radius
+		float	CosThetaGround;
+		__m128*	pRayleigh;					// [SunIndex][ThetaIndex][Slab]
+		__m128*	pMie;
+	};
+
+	struct	InScatteringDeltaSliceJob {
+		const SkyTables*	pOwner;
+		const float*		pDeltaScatteringRayleigh;
+		const float*		pDeltaScatteringMie;
+		SliceSamples*		pSlices;
+		bool				FirstPass;
+
+		void	operator()( U32 _Z ) {
+			const int	StepsCount = pOwner->GetParameters().StepsCountDeltaScattering;
+			const float	dTheta = PI / StepsCount;
+
+			float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+			SkyTables::GetSliceData( 0, 0, _Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+			SliceSamples&	Slice = pSlices[_Z];
+			Slice.AltitudeKm = AltitudeKm;
+			Slice.RadiusKm = GROUND_RADIUS_KM + CLAMP( AltitudeKm, 0.0f, ATMOSPHERE_THICKNESS_KM );
+			Slice.CosThetaGround = -sqrtf( 1.0f - (GROUND_RADIUS_KM / Slice.RadiusKm) * (GROUND_RADIUS_KM / Slice.RadiusKm) );
+
+			__m128*	pRayleigh = Slice.pRayleigh;
+			__m128*	pMie = Slice.pMie;
+			for ( int SunIndex=0; SunIndex < SkyTables::RES_3D_COS_THETA_SUN; SunIndex++ ) {
+				SkyTables::GetSliceData( SunIndex, 0, _Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+				CosThetaSun = CLAMP( CosThetaSun, -1.0f, 1.0f );
+				float	uCosThetaSun = SkyTables::GetScatteringCoordinateSun( CosThetaSun );
+
+				for ( int ThetaIndex=0; ThetaIndex < StepsCount; ThetaIndex++ ) {
+					float	CosTheta = cosf( (ThetaIndex + 0.5f) * dTheta );
+					float	uCosThetaView, uAltitude;
+					SkyTables::GetScatteringCoordinates( Slice.AltitudeKm, CosTheta, uCosThetaView, uAltitude );
+
+					for ( int SlabIndex=0; SlabIndex < GAMMA_SLABS_COUNT; SlabIndex++ ) {
+						float	U = (SlabIndex - 1 + uCosThetaSun) / SkyTables::RES_3D_COS_GAMMA;
+						*pRayleigh++ = SkyTables::Sample3D( pDeltaScatteringRayleigh, SkyTables::RES_3D_U, SkyTables::RES_3D_COS_THETA_VIEW, SkyTables::RES_3D_ALTITUDE, U, uCosThetaView, uAltitude );
+						if ( FirstPass )
+							*pMie++ = SkyTables::Sample3D( pDeltaScatteringMie, SkyTables::RES_3D_U, SkyTables::RES_3D_COS_THETA_VIEW, SkyTables::RES_3D_ALTITUDE, U, uCosThetaView, uAltitude );
+					}
+				}
+			}
+		}
+	};
+
+	struct	InScatteringDeltaJob {
+		const SkyTables*	pOwner;
+		const float*		pDeltaIrradiance;
+		const SliceSamples*	pSlices;
+		float*				pTarget;
+		bool				FirstPass;
+
+		void	operator()( U32 _RowIndex ) {
+			const SkyTables::Parameters&	Params = pOwner->GetParameters();
+			const int	StepsCount = Params.StepsCountDeltaScattering;
+			const float	dPhi = PI / StepsCount;
+			const float	dTheta = PI / StepsCount;
+			int		Y = _RowIndex % SkyTables::RES_3D_COS_THETA_VIEW;
+			int		Z = _RowIndex / SkyTables::RES_3D_COS_THETA_VIEW;
+
+			const SliceSamples&	Slice = pSlices[Z];
+			const float	r = Slice.RadiusKm;
+			const __m128	SigmaAir = Scale( SigmaScatteringRayleigh(), Params.AirAmount * expf( -Slice.AltitudeKm / Params.AirReferenceAltitudeKm ) );
+			const float		SigmaFog = Params.FogScattering * expf( -Slice.AltitudeKm / Params.FogReferenceAltitudeKm );
+
+			BaseLib::ArenaAllocator&	Arena = BaseLib::GetThreadArena();
+			BaseLib::ArenaScope			Scope( Arena );
+
+			// Sampling directions, and light scattered toward the view from each of them (the view only depends on the scanline)
+			float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+			SkyTables::GetSliceData( 0, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+			CosThetaView = CLAMP( CosThetaView, -1.0f, 1.0f );
+			float	SinThetaView = sqrtf( 1.0f - CosThetaView * CosThetaView );
+
+			float*	pCosPhi = (float*) Arena.Allocate( 2 * StepsCount * sizeof(float), 16 );
+			float*	pSinPhi = (float*) Arena.Allocate( 2 * StepsCount * sizeof(float), 16 );
+			for ( int PhiIndex=0; PhiIndex < 2 * StepsCount; PhiIndex++ ) {
+				float	Phi = (PhiIndex + 0.5f) * dPhi;
+				pCosPhi[PhiIndex] = cosf( Phi );
+				pSinPhi[PhiIndex] = sinf( Phi );
+			}
+
+			float*	pCosTheta = (float*) Arena.Allocate( StepsCount * sizeof(float), 16 );
+			float*	pSinTheta = (float*) Arena.Allocate( StepsCount * sizeof(float), 16 );
+			float*	pDistance2Ground = (float*) Arena.Allocate( StepsCount * sizeof(float), 16 );
+			__m128*	pGroundReflectance = (__m128*) Arena.Allocate( StepsCount * sizeof(__m128), 16 );
+			__m128*	pViewScattering = (__m128*) Arena.Allocate( 2 * StepsCount * StepsCount * sizeof(__m128), 16 );
+			__m128*	pViewScatteringPhi = pViewScattering;
+			for ( int ThetaIndex=0; ThetaIndex < StepsCount; ThetaIndex++ ) {
+				float	Theta = (ThetaIndex + 0.5f) * dTheta;
+				float	stheta = sinf( Theta ), ctheta = cosf( Theta );
+				pCosTheta[ThetaIndex] = ctheta;
+				pSinTheta[ThetaIndex] = stheta;
+
+				// Transmittance between x and the ground, if the ground is visible in that direction
+				pDistance2Ground[ThetaIndex] = -1.0f;
+				pGroundReflectance[ThetaIndex] = _mm_setzero_ps();
+				if ( ctheta < Slice.CosThetaGround ) {
+					float	Distance2Ground = -r * ctheta - sqrtf( r * r * (ctheta * ctheta - 1.0f) + GROUND_RADIUS_KM * GROUND_RADIUS_KM );
+					pDistance2Ground[ThetaIndex] = Distance2Ground;
+					pGroundReflectance[ThetaIndex] = Scale( pOwner->GetTransmittance( 0.0f, -(r * ctheta + Distance2Ground) / GROUND_RADIUS_KM, Distance2Ground ), Params.AverageGroundReflectance / PI );
+				}
+
+				float	dw = stheta * dTheta * dPhi;
+				for ( int PhiIndex=0; PhiIndex < 2 * StepsCount; PhiIndex++ ) {
+					float	CosPhaseAngleView = SinThetaView * pCosPhi[PhiIndex] * stheta + CosThetaView * ctheta;
+					*pViewScatteringPhi++ = Scale( _mm_add_ps( Scale( SigmaAir, pOwner->PhaseFunctionRayleigh( CosPhaseAngleView ) ), _mm_set1_ps( SigmaFog * pOwner->PhaseFunctionMie( CosPhaseAngleView ) ) ), dw );
+				}
+			}
+
+			float*	pTexel = pTarget + 4 * SkyTables::RES_3D_U * _RowIndex;
+			for ( int X=0; X < SkyTables::RES_3D_U; X++, pTexel+=4 ) {
+				SkyTables::GetSliceData( X, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+				CosThetaView = CLAMP( CosThetaView, -1.0f, 1.0f );
+				CosThetaSun = CLAMP( CosThetaSun, -1.0f, 1.0f );
+
+				float	var = sqrtf( 1.0f - CosThetaView*CosThetaView ) * sqrtf( 1.0f - CosThetaSun*CosThetaSun );
+				CosGamma = CLAMP( CosGamma, CosThetaSun * CosThetaView - var, CosThetaSun * CosThetaView + var );
+
+				// Deduce the Sun vector from the azimuth between Sun & View (cf. PreComputeInScattering_Delta())
+				float	SunX = SinThetaView == 0.0f ? 0.0f : (CosGamma - CosThetaSun * CosThetaView) / SinThetaView;
+				float	SunY = CosThetaSun;
+				float	SunZ = sqrtf( MAX( 0.0f, 1.0f - SunX * SunX - SunY * SunY ) );
+
+				const int		SunIndex = X % SkyTables::RES_3D_COS_THETA_SUN;
+				const __m128*	pSlabsRayleigh = Slice.pRayleigh + SunIndex * StepsCount * GAMMA_SLABS_COUNT;
+				const __m128*	pSlabsMie = FirstPass ? Slice.pMie + SunIndex * StepsCount * GAMMA_SLABS_COUNT : NULL;
+
+				__m128	Scattering = _mm_setzero_ps();
+				pViewScatteringPhi = pViewScattering;
+				for ( int ThetaIndex=0; ThetaIndex < StepsCount; ThetaIndex++, pSlabsRayleigh+=GAMMA_SLABS_COUNT ) {
+					float	ctheta = pCosTheta[ThetaIndex];
+					float	stheta = pSinTheta[ThetaIndex];
+					float	Distance2Ground = pDistance2Ground[ThetaIndex];
+
+					for ( int PhiIndex=0; PhiIndex < 2 * StepsCount; PhiIndex++ ) {
+						float	wx = pCosPhi[PhiIndex] * stheta;
+						float	wz = pSinPhi[PhiIndex] * stheta;
+
+						__m128	dScattering = _mm_setzero_ps();
+
+						// First term = light reflected from the ground and attenuated before reaching x = (Rho/PI).deltaE
+						if ( Distance2Ground > 0.0f ) {
+							float	CosThetaGroundSun = (Distance2Ground * wx * SunX + (r + Distance2Ground * ctheta) * SunY + Distance2Ground * wz * SunZ) / GROUND_RADIUS_KM;
+							dScattering = _mm_mul_ps( pGroundReflectance[ThetaIndex], pOwner->GetIrradiance( pDeltaIrradiance, 0.0f, CosThetaGroundSun ) );
+						}
+
+						// Second term = inscattered light = deltaS
+						float	CosPhaseAngleSun = SunX * wx + SunY * ctheta + SunZ * wz;
+						float	t;
+						int		Slab = int( SkyTables::GetScatteringCoordinateGamma( CosPhaseAngleSun, t ) );
+								Slab = CLAMP( Slab, -1, SkyTables::RES_3D_COS_GAMMA ) + 1;
+
+						__m128	InScattered = Lerp( pSlabsRayleigh[Slab], pSlabsRayleigh[Slab+1], t );
+						if ( FirstPass ) {
+							// Rayleigh and Mie were stored separately, without the phase functions factors; they must be reintroduced here
+							__m128	InScatteredMie = Lerp( pSlabsMie[Slab], pSlabsMie[Slab+1], t );
+							InScattered = _mm_add_ps( Scale( InScattered, pOwner->PhaseFunctionRayleigh( CosPhaseAngleSun ) ), Scale( InScatteredMie, pOwner->PhaseFunctionMie( CosPhaseAngleSun ) ) );
+						}
+						dScattering = _mm_add_ps( dScattering, InScattered );
+
+						// Light coming from direction w and scattered in view direction
+						Scattering = _mm_add_ps( Scattering, _mm_mul_ps( dScattering, *pViewScatteringPhi++ ) );
+					}
+					if ( FirstPass )
+						pSlabsMie += GAMMA_SLABS_COUNT;
+				}
+
+				_mm_store_ps( pTexel, _mm_and_ps( Scattering, MaskXYZ() ) );
+			}
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// 4] Irradiance delta table accounting for the light scattered by the previous order
+	struct	IrradianceDeltaJob {
+		const SkyTables*	pOwner;
+		const float*		pDeltaScatteringRayleigh;
+		const float*		pDeltaScatteringMie;
+		float*				pTarget;
+		bool				FirstPass;
+
+		void	operator()( U32 _Y ) {
+			const int	StepsCount = pOwner->GetParameters().StepsCountDeltaIrradiance;
+			const float	dPhi = PI / StepsCount;
+			const float	dTheta = PI / StepsCount;
+
+			float	AltitudeKm = float(_Y) / SkyTables::IRRADIANCE_H * ATMOSPHERE_THICKNESS_KM;
+			float*	pTexel = pTarget + 4 * SkyTables::IRRADIANCE_W * _Y;
+			for ( int X=0; X < SkyTables::IRRADIANCE_W; X++, pTexel+=4 ) {
+				float	CosThetaSun = LERP( -0.2f, 1.0f, float(X) / SkyTables::IRRADIANCE_W );
+				float	SunX = sqrtf( 1.0f - SATURATE( CosThetaSun * CosThetaSun ) );
+				float	SunY = CosThetaSun;
+
+				// Integral over 2.PI around x with two nested loops over w directions (theta,phi) -- Eq (15)
+				__m128	Result = _mm_setzero_ps();
+				for ( int PhiIndex=0; PhiIndex < 2 * StepsCount; PhiIndex++ ) {
+					float	cphi = cosf( (PhiIndex + 0.5f) * dPhi );
+					for ( int ThetaIndex=0; ThetaIndex < StepsCount / 2; ThetaIndex++ ) {
+						float	Theta = (ThetaIndex + 0.5f) * dTheta;
+						float	stheta = sinf( Theta ), ctheta = cosf( Theta );
+						float	dw = stheta * dTheta * dPhi;
+
+						float	CosPhaseAngleSun = SunX * cphi * stheta + SunY * ctheta;
+						__m128	InScattering = pOwner->Sample4DScatteringTable( pDeltaScatteringRayleigh, AltitudeKm, ctheta, CosThetaSun, CosPhaseAngleSun );
+						if ( FirstPass ) {
+							__m128	InScatteringMie = pOwner->Sample4DScatteringTable( pDeltaScatteringMie, AltitudeKm, ctheta, CosThetaSun, CosPhaseAngleSun );
+							InScattering = _mm_add_ps( Scale( InScattering, pOwner->PhaseFunctionRayleigh( CosPhaseAngleSun ) ), Scale( InScatteringMie, pOwner->PhaseFunctionMie( CosPhaseAngleSun ) ) );
+						}
+
+						Result = _mm_add_ps( Result, Scale( InScattering, ctheta * dw ) );	// InScattering * (w.n) * dw
+					}
+				}
+
+				_mm_store_ps( pTexel, _mm_and_ps( Result, MaskXYZ() ) );
+			}
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// 5] Multiple scattering table, integrating J along the view ray
+	struct	InScatteringMultipleJob {
+		const SkyTables*	pOwner;
+		const float*		pDeltaScattering;
+		float*				pTarget;
+
+		void	operator()( U32 _RowIndex ) {
+			const int	StepsCount = pOwner->GetParameters().StepsCountMultipleScattering;
+			int		Y = _RowIndex % SkyTables::RES_3D_COS_THETA_VIEW;
+			int		Z = _RowIndex / SkyTables::RES_3D_COS_THETA_VIEW;
+
+			float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+			SkyTables::GetSliceData( 0, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+			float	RadiusKm = GROUND_RADIUS_KM + AltitudeKm;
+			float	StartAltitudeKm = RadiusKm - GROUND_RADIUS_KM;
+			bool	GroundHit;
+			float	TraceDistanceKm = SkyTables::ComputeNearestHit( AltitudeKm, CosThetaView, GroundHit );
+			float	StepSizeKm = TraceDistanceKm / StepsCount;
+
+			// Quantities along the view ray
+			float	DistanceKm[MAX_RAY_STEPS_COUNT+1];
+			float	InvRadiusKm[MAX_RAY_STEPS_COUNT+1];
+			float	uCosThetaView[MAX_RAY_STEPS_COUNT+1];
+			float	uAltitude[MAX_RAY_STEPS_COUNT+1];
+			__m128	ViewTransmittance[MAX_RAY_STEPS_COUNT+1];
+
+			float	Distance = 0.0f;
+			for ( int StepIndex=0; StepIndex <= StepsCount; StepIndex++ ) {
+				DistanceKm[StepIndex] = Distance;
+
+				float	CurrentRadiusKm = sqrtf( RadiusKm * RadiusKm + Distance * Distance + 2.0f * RadiusKm * CosThetaView * Distance );
+				float	CurrentCosThetaView = (RadiusKm * CosThetaView + Distance) / CurrentRadiusKm;
+				InvRadiusKm[StepIndex] = 1.0f / CurrentRadiusKm;
+				SkyTables::GetScatteringCoordinates( CurrentRadiusKm - GROUND_RADIUS_KM, CurrentCosThetaView, uCosThetaView[StepIndex], uAltitude[StepIndex] );
+				ViewTransmittance[StepIndex] = pOwner->GetTransmittance( StartAltitudeKm, CosThetaView, Distance );
+
+				Distance = StepIndex == 0 ? StepSizeKm : Distance + StepSizeKm;
+			}
+
+			const __m128	Half = _mm_set1_ps( 0.5f );
+
+			float*	pTexel = pTarget + 4 * SkyTables::RES_3D_U * _RowIndex;
+			for ( int X=0; X < SkyTables::RES_3D_U; X++, pTexel+=4 ) {
+				SkyTables::GetSliceData( X, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+				float	t;
+				float	uGamma = SkyTables::GetScatteringCoordinateGamma( CosGamma, t );
+
+				__m128	Result = _mm_setzero_ps();
+				__m128	Previous = _mm_setzero_ps();
+				for ( int StepIndex=0; StepIndex <= StepsCount; StepIndex++ ) {
+					float	CurrentCosThetaSun = (RadiusKm * CosThetaSun + CosGamma * DistanceKm[StepIndex]) * InvRadiusKm[StepIndex];
+					float	uCosThetaSun = SkyTables::GetScatteringCoordinateSun( CurrentCosThetaSun );
+
+					__m128	V0 = SkyTables::Sample3D( pDeltaScattering, SkyTables::RES_3D_U, SkyTables::RES_3D_COS_THETA_VIEW, SkyTables::RES_3D_ALTITUDE, (uGamma + uCosThetaSun) / SkyTables::RES_3D_COS_GAMMA, uCosThetaView[StepIndex], uAltitude[StepIndex] );
+					__m128	V1 = SkyTables::Sample3D( pDeltaScattering, SkyTables::RES_3D_U, SkyTables::RES_3D_COS_THETA_VIEW, SkyTables::RES_3D_ALTITUDE, (uGamma + uCosThetaSun + 1.0f) / SkyTables::RES_3D_COS_GAMMA, uCosThetaView[StepIndex], uAltitude[StepIndex] );
+					__m128	Current = _mm_mul_ps( ViewTransmittance[StepIndex], Lerp( V0, V1, t ) );
+
+					if ( StepIndex > 0 )
+						Result = _mm_add_ps( Result, _mm_mul_ps( Half, _mm_add_ps( Previous, Current ) ) );
+					Previous = Current;
+				}
+
+				_mm_store_ps( pTexel, _mm_and_ps( Scale( Result, StepSizeKm ), MaskXYZ() ) );
+			}
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// Accumulates delta in-scattering into the final scattering table, divided by the Rayleigh phase function
+	struct	AccumulateInScatteringJob {
+		const SkyTables*	pOwner;
+		const float*		pDeltaScattering;
+		float*				pTarget;
+
+		void	operator()( U32 _RowIndex ) {
+			int		Y = _RowIndex % SkyTables::RES_3D_COS_THETA_VIEW;
+			int		Z = _RowIndex / SkyTables::RES_3D_COS_THETA_VIEW;
+
+			U32		TexelOffset = 4 * SkyTables::RES_3D_U * _RowIndex;
+			const float*	pSource = pDeltaScattering + TexelOffset;
+			float*			pTexel = pTarget + TexelOffset;
+			for ( int X=0; X < SkyTables::RES_3D_U; X++, pSource+=4, pTexel+=4 ) {
+				float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+				SkyTables::GetSliceData( X, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+				__m128	Rayleigh = _mm_and_ps( Scale( Fetch( pSource ), 1.0f / pOwner->PhaseFunctionRayleigh( CosGamma ) ), MaskXYZ() );
+				_mm_store_ps( pTexel, _mm_add_ps( Fetch( pTexel ), Rayleigh ) );
+			}
+		}
+	};
+}
+
+SkyTables::Parameters::Parameters()
+	: AirAmount( 1.0f )
+	, AirReferenceAltitudeKm( 8.0f )
+	, FogScattering( 0.004f )
+	, FogExtinction( 0.004f / 0.9f )
+	, FogReferenceAltitudeKm( 1.2f )
+	, FogAnisotropy( 0.76f )
+	, AverageGroundReflectance( 0.1f )
+	, MaxScatteringOrder( 4 )
+	, StepsCountTransmittance( 500 )
+	, StepsCountSingleScattering( 50 )
+	, StepsCountDeltaScattering( 16 )
+	, StepsCountDeltaIrradiance( 32 )
+	, StepsCountMultipleScattering( 50 ) {
+}
+
+SkyTables::SkyTables()
+	: m_MaxThreadsCount( 0 )
+	, m_pTransmittance( NULL )
+	, m_pIrradiance( NULL )
+	, m_pScattering( NULL )
+	, m_pDeltaIrradiance( NULL )
+	, m_pDeltaScatteringRayleigh( NULL )
+	, m_pDeltaScatteringMie( NULL )
+	, m_pDeltaScattering( NULL ) {
+}
+
+SkyTables::~SkyTables() {
+	Release();
+}
+
+void	SkyTables::Release() {
+	if ( m_pTransmittance == NULL )
+		return;
+
+	FreeTable( m_pTransmittance, TRANSMITTANCE_SIZE );
+	FreeTable( m_pIrradiance, IRRADIANCE_SIZE );
+	FreeTable( m_pScattering, SCATTERING_SIZE );
+	FreeTable( m_pDeltaIrradiance, IRRADIANCE_SIZE );
+	FreeTable( m_pDeltaScatteringRayleigh, SCATTERING_SIZE );
+	FreeTable( m_pDeltaScatteringMie, SCATTERING_SIZE );
+	FreeTable( m_pDeltaScattering, SCATTERING_SIZE );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Same sequence as EffectVolumetric::UpdateSkyTables()
+void	SkyTables::Build( const Parameters& _Params, U32 _MaxThreadsCount ) {
+	Initialize( _Params, _MaxThreadsCount );
+
+	// Single scattering
+	ComputeTransmittance();
+	ComputeIrradiance_Single();
+	ComputeInScattering_Single();
+	MergeInitialScattering();
+
+	if ( m_Params.MaxScatteringOrder < 2 ) {
+		AccumulateIrradiance();	// Special case when we want to stop at order 1 scattering
+		return;
+	}
+
+	// Multiple scattering
+	for ( int Order=2; Order <= m_Params.MaxScatteringOrder; Order++ ) {
+		ComputeInScattering_Delta( Order == 2 );
+		ComputeIrradiance_Delta( Order == 2 );
+		ComputeInScattering_Multiple();
+		AccumulateIrradiance();
+		AccumulateInScattering();
+	}
+}
+
+void	SkyTables::Initialize( const Parameters& _Params, U32 _MaxThreadsCount ) {
+	ASSERT( _Params.StepsCountSingleScattering > 0 && _Params.StepsCountSingleScattering <= MAX_RAY_STEPS_COUNT, "Invalid single scattering steps count!" );
+	ASSERT( _Params.StepsCountMultipleScattering > 0 && _Params.StepsCountMultipleScattering <= MAX_RAY_STEPS_COUNT, "Invalid multiple scattering steps count!" );
+
+	m_Params = _Params;
+	m_MaxThreadsCount = _MaxThreadsCount;
+
+	if ( m_pTransmittance == NULL ) {
+		m_pTransmittance = AllocateTable( TRANSMITTANCE_SIZE );
+		m_pIrradiance = AllocateTable( IRRADIANCE_SIZE );
+		m_pScattering = AllocateTable( SCATTERING_SIZE );
+		m_pDeltaIrradiance = AllocateTable( IRRADIANCE_SIZE );
+		m_pDeltaScatteringRayleigh = AllocateTable( SCATTERING_SIZE );
+		m_pDeltaScatteringMie = AllocateTable( SCATTERING_SIZE );
+		m_pDeltaScattering = AllocateTable( SCATTERING_SIZE );
+	}
+}
+
+void	SkyTables::ComputeTransmittance() {
+	TransmittanceJob	Job;
+	Job.pParams = &m_Params;
+	Job.pTarget = m_pTransmittance;
+	BaseLib::ParallelFor( TRANSMITTANCE_H, Job, 1, m_MaxThreadsCount );
+}
+
+void	SkyTables::ComputeIrradiance_Single() {
+	IrradianceSingleJob	Job;
+	Job.pOwner = this;
+	Job.pTarget = m_pDeltaIrradiance;
+	BaseLib::ParallelFor( IRRADIANCE_H, Job, 1, m_MaxThreadsCount );
+
+	// The final irradiance only accumulates the next orders (or the single scattering irradiance when stopping at order 1)
+	memset( m_pIrradiance, 0, 4 * IRRADIANCE_SIZE * sizeof(float) );
+}
+
+void	SkyTables::ComputeInScattering_Single() {
+	InScatteringSingleJob	Job;
+	Job.pOwner = this;
+	Job.pTargetRayleigh = m_pDeltaScatteringRayleigh;
+	Job.pTargetMie = m_pDeltaScatteringMie;
+	BaseLib::ParallelFor( SCATTERING_ROWS_COUNT, Job, 4, m_MaxThreadsCount );
+}
+
+void	SkyTables::MergeInitialScattering() {
+	// Store only red component of single Mie scattering (cf. "Angular precision")
+	for ( U32 TexelIndex=0; TexelIndex < SCATTERING_SIZE; TexelIndex++ ) {
+		m_pScattering[4*TexelIndex+0] = m_pDeltaScatteringRayleigh[4*TexelIndex+0];
+		m_pScattering[4*TexelIndex+1] = m_pDeltaScatteringRayleigh[4*TexelIndex+1];
+		m_pScattering[4*TexelIndex+2] = m_pDeltaScatteringRayleigh[4*TexelIndex+2];
+		m_pScattering[4*TexelIndex+3] = m_pDeltaScatteringMie[4*TexelIndex+0];
+	}
+}
+
+void	SkyTables::ComputeInScattering_Delta( bool _FirstPass ) {
+	const int	StepsCount = m_Params.StepsCountDeltaScattering;
+	const U32	SamplesCount = RES_3D_COS_THETA_SUN * StepsCount * GAMMA_SLABS_COUNT;
+
+	// Fetch the deltaS samples of each slice
+	BaseLib::IAllocator&	Allocator = BaseLib::GetDefaultAllocator();
+	SliceSamples	Slices[RES_3D_ALTITUDE];
+	for ( int Z=0; Z < RES_3D_ALTITUDE; Z++ ) {
+		Slices[Z].pRayleigh = (__m128*) Allocator.Allocate( SamplesCount * sizeof(__m128), 16 );
+		Slices[Z].pMie = _FirstPass ? (__m128*) Allocator.Allocate( SamplesCount * sizeof(__m128), 16 ) : NULL;
+	}
+
+	InScatteringDeltaSliceJob	SliceJob;
+	SliceJob.pOwner = this;
+	SliceJob.pDeltaScatteringRayleigh = m_pDeltaScatteringRayleigh;
+	SliceJob.pDeltaScatteringMie = m_pDeltaScatteringMie;
+	SliceJob.pSlices = Slices;
+	SliceJob.FirstPass = _FirstPass;
+	BaseLib::ParallelFor( RES_3D_ALTITUDE, SliceJob, 1, m_MaxThreadsCount );
+
+	// Integrate the light scattered toward the view
+	InScatteringDeltaJob	Job;
+	Job.pOwner = this;
+	Job.pDeltaIrradiance = m_pDeltaIrradiance;
+	Job.pSlices = Slices;
+	Job.pTarget = m_pDeltaScattering;
+	Job.FirstPass = _FirstPass;
+	BaseLib::ParallelFor( SCATTERING_ROWS_COUNT, Job, 1, m_MaxThreadsCount );
+
+	for ( int Z=0; Z < RES_3D_ALTITUDE; Z++ ) {
+		Allocator.Free( Slices[Z].pRayleigh, SamplesCount * sizeof(__m128), 16 );
+		Allocator.Free( Slices[Z].pMie, SamplesCount * sizeof(__m128), 16 );
+	}
+}
+
+void	SkyTables::ComputeIrradiance_Delta( bool _FirstPass ) {
+	IrradianceDeltaJob	Job;
+	Job.pOwner = this;
+	Job.pDeltaScatteringRayleigh = m_pDeltaScatteringRayleigh;
+	Job.pDeltaScatteringMie = m_pDeltaScatteringMie;
+	Job.pTarget = m_pDeltaIrradiance;
+	Job.FirstPass = _FirstPass;
+	BaseLib::ParallelFor( IRRADIANCE_H, Job, 1, m_MaxThreadsCount );
+}
+
+void	SkyTables::ComputeInScattering_Multiple() {
+	// The result goes to deltaSR that is not needed anymore by the next orders
+	InScatteringMultipleJob	Job;
+	Job.pOwner = this;
+	Job.pDeltaScattering = m_pDeltaScattering;
+	Job.pTarget = m_pDeltaScatteringRayleigh;
+	BaseLib::ParallelFor( SCATTERING_ROWS_COUNT, Job, 4, m_MaxThreadsCount );
+}
+
+void	SkyTables::AccumulateIrradiance() {
+	for ( U32 TexelIndex=0; TexelIndex < IRRADIANCE_SIZE; TexelIndex++ )
+		_mm_store_ps( m_pIrradiance + 4*TexelIndex, _mm_add_ps( Fetch( m_pIrradiance + 4*TexelIndex ), Fetch( m_pDeltaIrradiance + 4*TexelIndex ) ) );
+}
+
+void	SkyTables::AccumulateInScattering() {
+	AccumulateInScatteringJob	Job;
+	Job.pOwner = this;
+	Job.pDeltaScattering = m_pDeltaScatteringRayleigh;
+	Job.pTarget = m_pScattering;
+	BaseLib::ParallelFor( SCATTERING_ROWS_COUNT, Job, 16, m_MaxThreadsCount );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Table access
+__m128	SkyTables::GetTransmittance( float _AltitudeKm, float _CosTheta ) const {
+	static const float	TAN_1_5 = tanf( 1.5f );
+
+	float	NormalizedAltitude = sqrtf( SATURATE( (_AltitudeKm-0.001f) / (ATMOSPHERE_THICKNESS_KM-2.0f-0.001f) ) );
+	float	NormalizedCosTheta = atanf( (_CosTheta + 0.15f) / (1.0f + 0.15f) * TAN_1_5 ) / 1.5f;
+
+	return Sample2D( m_pTransmittance, TRANSMITTANCE_W, TRANSMITTANCE_H, NormalizedCosTheta, NormalizedAltitude );
+}
+
+// Transmittance of atmosphere up to a given distance (we assume the segment is not intersecting ground)
+__m128	SkyTables::GetTransmittance( float _AltitudeKm, float _CosTheta, float _DistanceKm ) const {
+	float	RadiusKm = GROUND_RADIUS_KM + _AltitudeKm;
+	float	RadiusKm2 = sqrtf( RadiusKm*RadiusKm + _DistanceKm*_DistanceKm + 2.0f * RadiusKm * _CosTheta * _DistanceKm );
+	float	CosTheta2 = (RadiusKm * _CosTheta + _DistanceKm) / RadiusKm2;
+	float	AltitudeKm2 = RadiusKm2 - GROUND_RADIUS_KM;
+
+	__m128	Numerator, Denominator;
+	if ( _CosTheta > 0.0f ) {
+		Numerator = GetTransmittance( _AltitudeKm, _CosTheta );
+		Denominator = GetTransmittance( AltitudeKm2, CosTheta2 );
+	} else {
+		Numerator = GetTransmittance( AltitudeKm2, -CosTheta2 );
+		Denominator = GetTransmittance( _AltitudeKm, -_CosTheta );
+	}
+
+	// Dense atmospheres make the table underflow to 0 along grazing rays near the ground: the ratio is then 0/0 and the NaN spreads to all the tables.
+	// Segments whose end point can't see the top of the atmosphere are considered opaque instead.
+	__m128	Visible = _mm_cmpgt_ps( Denominator, _mm_setzero_ps() );
+	return _mm_and_ps( _mm_div_ps( Numerator, Denominator ), Visible );
+}
+
+__m128	SkyTables::GetIrradiance( const float* _pTable, float _AltitudeKm, float _CosThetaSun ) const {
+	float	NormalizedAltitude = _AltitudeKm / CAMERA_RADIUS_KM;
+	float	NormalizedCosThetaSun = (_CosThetaSun + 0.2f) / (1.0f + 0.2f);
+	return Sample2D( _pTable, IRRADIANCE_W, IRRADIANCE_H, NormalizedCosThetaSun, NormalizedAltitude );
+}
+
+__m128	SkyTables::Sample4DScatteringTable( const float* _pTable, float _AltitudeKm, float _CosThetaView, float _CosThetaSun, float _CosGamma ) const {
+	float	uCosThetaView, uAltitude;
+	GetScatteringCoordinates( _AltitudeKm, _CosThetaView, uCosThetaView, uAltitude );
+	float	uCosThetaSun = GetScatteringCoordinateSun( _CosThetaSun );
+	float	t;
+	float	uGamma = GetScatteringCoordinateGamma( _CosGamma, t );
+
+	__m128	V0 = Sample3D( _pTable, RES_3D_U, RES_3D_COS_THETA_VIEW, RES_3D_ALTITUDE, (uGamma + uCosThetaSun) / RES_3D_COS_GAMMA, uCosThetaView, uAltitude );
+	__m128	V1 = Sample3D( _pTable, RES_3D_U, RES_3D_COS_THETA_VIEW, RES_3D_ALTITUDE, (uGamma + uCosThetaSun + 1.0f) / RES_3D_COS_GAMMA, uCosThetaView, uAltitude );
+	return Lerp( V0, V1, t );
+}
+
+void	SkyTables::GetScatteringCoordinates( float _AltitudeKm, float _CosThetaView, float& _uCosThetaView, float& _uAltitude ) {
+	static const float	H = sqrtf( ATMOSPHERE_RADIUS_KM * ATMOSPHERE_RADIUS_KM - GROUND_RADIUS_KM * GROUND_RADIUS_KM );
+
+	float	r = GROUND_RADIUS_KM + MAX( 0.0f, _AltitudeKm );
+	float	h = sqrtf( r * r - GROUND_RADIUS_KM * GROUND_RADIUS_KM );
+
+	_uAltitude = LERP( 0.5f / RES_3D_ALTITUDE, 1.0f - 0.5f / RES_3D_ALTITUDE, h / H );
+
+	float	r_cosTheta = r * _CosThetaView;
+	float	Delta = r_cosTheta * r_cosTheta + GROUND_RADIUS_KM * GROUND_RADIUS_KM - r * r;
+	if ( _CosThetaView <= 0.0f && Delta >= 0.0f ) {
+		// Hitting the ground: V = distance to ground / distance to horizon, mapped to [0.5-e,0]
+		// (both distances tend to 0 on the ground where the ratio is 0, instead of the 0/0 of the shader that would spread NaNs in the tables)
+		float	GroundHitDistanceKm = -r_cosTheta - sqrtf( Delta );
+		_uCosThetaView = LERP( 0.5f - 0.5f / RES_3D_COS_THETA_VIEW, 0.5f / RES_3D_COS_THETA_VIEW, h > 0.0f ? GroundHitDistanceKm / h : 0.0f );
+	} else {
+		// Hitting the atmosphere: V = distance to atmosphere / distance to atmosphere following the horizon, mapped to [0.5+e,1]
+		Delta = r_cosTheta * r_cosTheta + ATMOSPHERE_RADIUS_KM * ATMOSPHERE_RADIUS_KM - r * r;
+		float	AtmosphereHitDistanceKm = -r_cosTheta + sqrtf( Delta );
+		_uCosThetaView = LERP( 0.5f + 0.5f / RES_3D_COS_THETA_VIEW, 1.0f - 0.5f / RES_3D_COS_THETA_VIEW, AtmosphereHitDistanceKm / (h + H) );
+	}
+}
+
+float	SkyTables::GetScatteringCoordinateSun( float _CosThetaSun ) {
+	static const float	TAN_1_386 = tanf( 1.26f * 1.1f );
+	return 0.5f / RES_3D_COS_THETA_SUN + (atanf( MAX( _CosThetaSun, -0.1975f ) * TAN_1_386 ) / 1.1f + (1.0f - 0.26f)) * 0.5f * (1.0f - 1.0f / RES_3D_COS_THETA_SUN);
+}
+
+float	SkyTables::GetScatteringCoordinateGamma( float _CosGamma, float& _t ) {
+	float	t = 0.5f * (_CosGamma + 1.0f) * (RES_3D_COS_GAMMA - 1.0f);
+	float	uGamma = floorf( t );
+	_t = t - uGamma;
+	return uGamma;
+}
+
+float	SkyTables::PhaseFunctionRayleigh( float _CosPhaseAngle ) const {
+	return (3.0f / (16.0f * PI)) * (1.0f + _CosPhaseAngle * _CosPhaseAngle);
+}
+
+float	SkyTables::PhaseFunctionMie( float _CosPhaseAngle ) const {
+	float	g = m_Params.FogAnisotropy;
+	float	Base = MAX( 0.0f, 1.0f + g*g - 2.0f*g*_CosPhaseAngle );
+	return 1.5f / (4.0f * PI) * (1.0f - g*g) / Pow1_5( Base ) * (1.0f + _CosPhaseAngle * _CosPhaseAngle) / (2.0f + g*g);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Gets the altitude, zenith/view angle (cos theta), zenith/Sun angle (cos theta Sun) and azimuth Sun angle (cos gamma) of a texel of the 3D tables
+// (cf. VolumetricPreComputeAtmospherePS.hlsl for the derivation of the non-linear view parametrization)
+void	SkyTables::GetSliceData( int _X, int _Y, int _Z, float& _AltitudeKm, float& _CosThetaView, float& _CosThetaSun, float& _CosGamma ) {
+	// Altitude grows quadratically to have more precision near the ground
+	float	RadiusKm = _Z / (RES_3D_ALTITUDE - 1.0f);
+	RadiusKm = RadiusKm * RadiusKm;
+	RadiusKm = sqrtf( LERP( GROUND_RADIUS_KM * GROUND_RADIUS_KM, ATMOSPHERE_RADIUS_KM * ATMOSPHERE_RADIUS_KM, RadiusKm ) );
+	if ( _Z == 0 )
+		RadiusKm += 0.001f;		// Never completely ground
+	else if ( _Z == RES_3D_ALTITUDE-1 )
+		RadiusKm -= 0.001f;		// Never completely top of atmosphere
+
+	_AltitudeKm = RadiusKm - GROUND_RADIUS_KM;
+
+	// Sun angle
+	_CosThetaSun = float( _X % RES_3D_COS_THETA_SUN ) / (RES_3D_COS_THETA_SUN-1);
+	_CosThetaSun = tanf( (2.0f * _CosThetaSun - 1.0f + 0.26f) * 1.1f ) * 0.18692904279186995490534690217449f;	// / tan( 1.26 * 1.1 );
+
+	// View/Sun phase angle
+	_CosGamma = 2.0f * (_X / RES_3D_COS_THETA_SUN) / (RES_3D_COS_GAMMA-1.0f) - 1.0f;
+
+	// View angle, from the ratio of distances encoded in V
+	float	r = RadiusKm;
+	if ( _Y < RES_3D_COS_THETA_VIEW / 2 ) {
+		// Viewing toward the ground
+		float	d_ground = r - GROUND_RADIUS_KM;
+		float	d_horizon = sqrtf( r*r - GROUND_RADIUS_KM*GROUND_RADIUS_KM );
+		float	d = 1.0f - _Y / (RES_3D_COS_THETA_VIEW / 2.0f - 1.0f);
+				d = CLAMP( d*d_horizon, d_ground, 0.999f * d_horizon );
+
+		_CosThetaView = (GROUND_RADIUS_KM * GROUND_RADIUS_KM - r * r - d * d) / (2.0f * r * d);
+		_CosThetaView = MIN( _CosThetaView, -sqrtf( 1.0f - (GROUND_RADIUS_KM*GROUND_RADIUS_KM) / (r*r) ) - 0.001f );	// Make sure we're always slightly below the horizon angle Theta_H
+	} else {
+		// Viewing toward the sky
+		float	d_atmosphere = ATMOSPHERE_RADIUS_KM - r;
+		float	d_horizon = sqrtf( r*r - GROUND_RADIUS_KM*GROUND_RADIUS_KM ) + sqrtf( ATMOSPHERE_RADIUS_KM*ATMOSPHERE_RADIUS_KM - GROUND_RADIUS_KM*GROUND_RADIUS_KM );
+		float	d = (_Y - RES_3D_COS_THETA_VIEW/2.0f) / (RES_3D_COS_THETA_VIEW/2.0f - 1.0f);
+				d = CLAMP( d*d_horizon, d_atmosphere, 0.999f * d_horizon );
+
+		_CosThetaView = MAX( 0.0f, (ATMOSPHERE_RADIUS_KM * ATMOSPHERE_RADIUS_KM - r * r - d * d) / (2.0f * r * d) );
+	}
+}
+
+// Computes the distance to the top of the atmosphere or to the ground, whichever comes first
+float	SkyTables::ComputeNearestHit( float _AltitudeKm, float _CosTheta, bool& _IsGround ) {
+	float	Dy = _AltitudeKm + GROUND_RADIUS_KM;
+	float	b = Dy * _CosTheta;
+
+	float	DeltaGround = b*b - (Dy*Dy - GROUND_RADIUS_KM*GROUND_RADIUS_KM);
+	float	GroundHit = DeltaGround >= 0.0f ? -b - sqrtf( DeltaGround ) : -FLT_MAX;
+	float	SphereHit = SphereIntersectionExit( _AltitudeKm, _CosTheta, ATMOSPHERE_THICKNESS_KM );
+
+	_IsGround = false;
+	if ( GroundHit < 0.0f || SphereHit < GroundHit )
+		return SphereHit;	// We hit the top of the atmosphere...
+
+	// We hit the ground first
+	_IsGround = true;
+	return GroundHit;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// LinearClamp sampling of RGBA tables
+__m128	SkyTables::Sample2D( const float* _pTable, int _Width, int _Height, float _U, float _V ) {
+	float	X = _U * _Width - 0.5f;
+	float	Y = _V * _Height - 0.5f;
+	float	X0f = floorf( X ), Y0f = floorf( Y );
+	float	x = X - X0f, y = Y - Y0f;
+
+	int		X0 = CLAMP( int(X0f), 0, _Width-1 ), X1 = CLAMP( int(X0f)+1, 0, _Width-1 );
+	int		Y0 = CLAMP( int(Y0f), 0, _Height-1 ), Y1 = CLAMP( int(Y0f)+1, 0, _Height-1 );
+
+	const float*	pRow0 = _pTable + 4 * _Width * Y0;
+	const float*	pRow1 = _pTable + 4 * _Width * Y1;
+	__m128	V0 = Lerp( Fetch( pRow0 + 4*X0 ), Fetch( pRow0 + 4*X1 ), x );
+	__m128	V1 = Lerp( Fetch( pRow1 + 4*X0 ), Fetch( pRow1 + 4*X1 ), x );
+	return Lerp( V0, V1, y );
+}
+
+__m128	SkyTables::Sample3D( const float* _pTable, int _Width, int _Height, int _Depth, float _U, float _V, float _W ) {
+	float	X = _U * _Width - 0.5f;
+	float	Y = _V * _Height - 0.5f;
+	float	Z = _W * _Depth - 0.5f;
+	float	X0f = floorf( X ), Y0f = floorf( Y ), Z0f = floorf( Z );
+	float	x = X - X0f, y = Y - Y0f, z = Z - Z0f;
+
+	int		X0 = CLAMP( int(X0f), 0, _Width-1 ), X1 = CLAMP( int(X0f)+1, 0, _Width-1 );
+	int		Y0 = CLAMP( int(Y0f), 0, _Height-1 ), Y1 = CLAMP( int(Y0f)+1, 0, _Height-1 );
+	int		Z0 = CLAMP( int(Z0f), 0, _Depth-1 ), Z1 = CLAMP( int(Z0f)+1, 0, _Depth-1 );
+
+	const float*	pRow00 = _pTable + 4 * _Width * (_Height * Z0 + Y0);
+	const float*	pRow01 = _pTable + 4 * _Width * (_Height * Z0 + Y1);
+	const float*	pRow10 = _pTable + 4 * _Width * (_Height * Z1 + Y0);
+	const float*	pRow11 = _pTable + 4 * _Width * (_Height * Z1 + Y1);
+	__m128	V00 = Lerp( Fetch( pRow00 + 4*X0 ), Fetch( pRow00 + 4*X1 ), x );
+	__m128	V01 = Lerp( Fetch( pRow01 + 4*X0 ), Fetch( pRow01 + 4*X1 ), x );
+	__m128	V10 = Lerp( Fetch( pRow10 + 4*X0 ), Fetch( pRow10 + 4*X1 ), x );
+	__m128	V11 = Lerp( Fetch( pRow11 + 4*X0 ), Fetch( pRow11 + 4*X1 ), x );
+	return Lerp( Lerp( V00, V01, y ), Lerp( V10, V11, y ), z );
+}
@@ -0,0 +1,134 @@
+//////////////////////////////////////////////////////////////////////////
+// CPU implementation of the atmospheric scattering tables pre-computation
+// From http://www-ljk.imag.fr/Publications/Basilic/com.lmc.publi.PUBLI_Article@11e7cdda2f7_f64b69/article.pdf
+//
+// This is a port of Resources/Shaders/VolumetricPreComputeAtmospherePS.hlsl following the stages of EffectVolumetric::UpdateSkyTables():
+//	the tables have the same resolutions, parametrizations and RGBA32F layouts as the render targets of EffectVolumetric
+//	and the lookups reproduce the LinearClamp sampling of the shaders, so the tables can be saved as POM files and loaded in place of the GPU results.
+//
+// Each stage is split into scanlines distributed over all the hardware threads, texels are processed as SSE vectors.
+// Quantities that only depend on the altitude slice or on the view scanline are computed once instead of once per texel.
+//
+#pragma once
+
+#include <emmintrin.h>
+
+class	SkyTables {
+public:		// CONSTANTS
+
+	// Table sizes (same as EffectVolumetric.h)
+	static const int	TRANSMITTANCE_W = 256;			// cos(theta)
+	static const int	TRANSMITTANCE_H = 64;			// Altitude
+
+	static const int	IRRADIANCE_W = 64;				// cos(theta_sun)
+	static const int	IRRADIANCE_H = 16;				// Altitude
+
+	static const int	RES_3D_ALTITUDE = 32;
+	static const int	RES_3D_COS_THETA_VIEW = 128;
+	static const int	RES_3D_COS_THETA_SUN = 32;
+	static const int	RES_3D_COS_GAMMA = 8;
+	static const int	RES_3D_U = RES_3D_COS_THETA_SUN * RES_3D_COS_GAMMA;
+
+public:		// NESTED TYPES
+
+	// Atmosphere parameters (same as EffectVolumetric::ParametersBlock) and integration steps (same as EffectVolumetric::UpdateSkyTables())
+	struct	Parameters {
+		float	AirAmount;					// Multiplier of the default Rayleigh scattering coefficients
+		float	AirReferenceAltitudeKm;
+		float	FogScattering;
+		float	FogExtinction;
+		float	FogReferenceAltitudeKm;
+		float	FogAnisotropy;
+		float	AverageGroundReflectance;
+
+		int		MaxScatteringOrder;
+
+		int		StepsCountTransmittance;
+		int		StepsCountSingleScattering;
+		int		StepsCountDeltaScattering;
+		int		StepsCountDeltaIrradiance;
+		int		StepsCountMultipleScattering;
+
+		Parameters();
+	};
+
+private:	// FIELDS
+
+	Parameters	m_Params;
+	U32			m_MaxThreadsCount;
+
+	// Final tables
+	float*		m_pTransmittance;				// T
+	float*		m_pIrradiance;					// E
+	float*		m_pScattering;					// S (XYZ=Rayleigh, W=Mie red)
+
+	// Temporary tables
+	float*		m_pDeltaIrradiance;				// deltaE
+	float*		m_pDeltaScatteringRayleigh;		// deltaSR, then deltaS for orders > 2
+	float*		m_pDeltaScatteringMie;			// deltaSM
+	float*		m_pDeltaScattering;				// deltaJ
+
+public:		// PROPERTIES
+
+	const Parameters&	GetParameters() const	{ return m_Params; }
+
+	// Tables are arrays of RGBA floats stored in scanline order
+	const float*	GetTransmittance() const	{ return m_pTransmittance; }
+	const float*	GetIrradiance() const		{ return m_pIrradiance; }
+	const float*	GetScattering() const		{ return m_pScattering; }
+
+	// Temporary tables, as left by the last stage that wrote them
+	const float*	GetDeltaIrradiance() const			{ return m_pDeltaIrradiance; }
+	const float*	GetDeltaScatteringRayleigh() const	{ return m_pDeltaScatteringRayleigh; }
+	const float*	GetDeltaScatteringMie() const		{ return m_pDeltaScatteringMie; }
+	const float*	GetDeltaScattering() const			{ return m_pDeltaScattering; }
+
+public:		// METHODS
+
+	SkyTables();
+	~SkyTables();
+
+	// Computes all the tables
+	//	_MaxThreadsCount, the maximum amount of threads to use (0 to use all hardware threads)
+	void	Build( const Parameters& _Params, U32 _MaxThreadsCount=0 );
+
+	// Sets the parameters and allocates the tables before calling the individual stages
+	void	Initialize( const Parameters& _Params, U32 _MaxThreadsCount=0 );
+
+	// Individual stages, in the order they must be called (cf. Build())
+	void	ComputeTransmittance();
+	void	ComputeIrradiance_Single();
+	void	ComputeInScattering_Single();
+	void	MergeInitialScattering();
+	void	ComputeInScattering_Delta( bool _FirstPass );
+	void	ComputeIrradiance_Delta( bool _FirstPass );
+	void	ComputeInScattering_Multiple();
+	void	AccumulateIrradiance();
+	void	AccumulateInScattering();
+
+public:		// Table access (HLSL equivalents from Atmosphere.hlsl)
+
+	__m128	GetTransmittance( float _AltitudeKm, float _CosTheta ) const;
+	__m128	GetTransmittance( float _AltitudeKm, float _CosTheta, float _DistanceKm ) const;
+	__m128	GetIrradiance( const float* _pTable, float _AltitudeKm, float _CosThetaSun ) const;
+	__m128	Sample4DScatteringTable( const float* _pTable, float _AltitudeKm, float _CosThetaView, float _CosThetaSun, float _CosGamma ) const;
+
+	float	PhaseFunctionRayleigh( float _CosPhaseAngle ) const;
+	float	PhaseFunctionMie( float _CosPhaseAngle ) const;
+
+	static void	GetSliceData( int _X, int _Y, int _Z, float& _AltitudeKm, float& _CosThetaView, float& _CosThetaSun, float& _CosGamma );
+	static float	ComputeNearestHit( float _AltitudeKm, float _CosTheta, bool& _IsGround );
+
+	// Splits the 4D scattering table parametrization of Sample4DScatteringTable() so the lookups can be shared across texels
+	static void		GetScatteringCoordinates( float _AltitudeKm, float _CosThetaView, float& _uCosThetaView, float& _uAltitude );
+	static float	GetScatteringCoordinateSun( float _CosThetaSun );
+	static float	GetScatteringCoordinateGamma( float _CosGamma, float& _t );
+
+	// LinearClamp sampling
+	static __m128	Sample2D( const float* _pTable, int _Width, int _Height, float _U, float _V );
+	static __m128	Sample3D( const float* _pTable, int _Width, int _Height, int _Depth, float _U, float _V, float _W );
+
+private:
+
+	void	Release();
+};
@@ -0,0 +1,242 @@
+// SkyTablesGenerator.cpp : Builds the atmospheric scattering tables of EffectVolumetric on the CPU and saves them as POM files
+//
+// Usage: SkyTablesGenerator [options]
+//	-air <amount>			Multiplier of the default Rayleigh scattering coefficients (default 1)
+//	-airref <km>			Reference altitude of the air density (default 8)
+//	-fog <scattering>		Fog scattering coefficient, the extinction is set to scattering/0.9 as in the control panel (default 0.004)
+//	-fogext <extinction>	Fog extinction coefficient, overrides the one deduced from -fog
+//	-fogref <km>			Reference altitude of the fog density (default 1.2)
+//	-anisotropy <g>			Fog anisotropy (default 0.76)
+//	-reflectance <rho>		Average ground reflectance (default 0.1)
+//	-orders <count>			Maximum scattering order (default 4)
+//	-threads <count>		Maximum amount of threads to use (default 0 = all hardware threads)
+//	-out <directory>		Directory where the tables are saved (default current directory)
+//	-nosave					Don't save the tables
+//	-check <directory>		Compares the tables with the ones found in the given directory (transmittance & irradiance, and scattering if present),
+//							fails if the errors exceed the tolerances of each table
+//	-validate				Validates each stage of the computation against a reference implementation (cf. SkyTablesValidation.h)
+//
+// The pre-baked TexTransmittance_256x64.pom & TexIrradiance_64x16.pom were saved by EffectVolumetric::UpdateSkyTables() (pixel shader path of
+//	EffectVolumetricComputeSkyTablesPS.cpp, 4 scattering orders) with fog scattering 0.08, fog reference altitude 20 km and fog anisotropy 0.7,
+//	the other parameters being the defaults. They are reproduced with "-fog 0.08 -fogref 20 -anisotropy 0.7 -check <directory>":
+//	transmittance within 0.001% RMS (0.03% max relative error), irradiance within 0.04% RMS (0.5% max relative error).
+//
+#include "stdafx.h"
+#include "SkyTables.h"
+#include "SkyTablesValidation.h"
+#include "../../BaseLib/Utility/Parallel.h"
+
+namespace {
+	const _TCHAR*	FILENAME_TRANSMITTANCE = _T("TexTransmittance_256x64.pom");
+	const _TCHAR*	FILENAME_IRRADIANCE = _T("TexIrradiance_64x16.pom");
+	const _TCHAR*	FILENAME_SCATTERING = _T("TexScattering_256x128x32.pom");
+
+	// Same as TextureFilePOM
+	const U8	POM_TEX_2D = 0;
+	const U8	POM_TEX_3D = 2;
+	const U8	POM_FORMAT_RGBA32F = 2;	// DXGI_FORMAT_R32G32B32A32_FLOAT
+
+	// Simple high-resolution timer
+	class	Timer {
+		LARGE_INTEGER	m_Frequency;
+		LARGE_INTEGER	m_Start;
+
+	public:
+		Timer()							{ QueryPerformanceFrequency( &m_Frequency ); Start(); }
+		void	Start()					{ QueryPerformanceCounter( &m_Start ); }
+		double	GetElapsedMilliseconds() const {
+			LARGE_INTEGER	Now;
+			QueryPerformanceCounter( &Now );
+			return 1000.0 * double(Now.QuadPart - m_Start.QuadPart) / double(m_Frequency.QuadPart);
+		}
+	};
+
+	void	BuildPath( const _TCHAR* _pDirectory, const _TCHAR* _pFileName, _TCHAR _pPath[MAX_PATH] ) {
+		if ( _pDirectory == NULL || _pDirectory[0] == _T('\0') )
+			_stprintf_s( _pPath, MAX_PATH, _T("%s"), _pFileName );
+		else
+			_stprintf_s( _pPath, MAX_PATH, _T("%s\\%s"), _pDirectory, _pFileName );
+	}
+
+	// Saves a single-mip RGBA32F table with the TextureFilePOM layout
+	bool	SavePOM( const _TCHAR* _pFileName, bool _Is3D, U32 _Width, U32 _Height, U32 _Depth, const float* _pTexels ) {
+		FILE*	pFile = NULL;
+		_tfopen_s( &pFile, _pFileName, _T("wb") );
+		if ( pFile == NULL )
+			return false;
+
+		U8	Type = _Is3D ? POM_TEX_3D : POM_TEX_2D;
+		U8	Format = POM_FORMAT_RGBA32F;
+		U32	MipsCount = 1;
+		U32	RowPitch = 4 * sizeof(float) * _Width;
+		U32	DepthPitch = RowPitch * _Height;
+		fwrite( &Type, sizeof(U8), 1, pFile );
+		fwrite( &Format, sizeof(U8), 1, pFile );
+		fwrite( &_Width, sizeof(U32), 1, pFile );
+		fwrite( &_Height, sizeof(U32), 1, pFile );
+		fwrite( &_Depth, sizeof(U32), 1, pFile );
+		fwrite( &MipsCount, sizeof(U32), 1, pFile );
+		fwrite( &RowPitch, sizeof(U32), 1, pFile );
+		fwrite( &DepthPitch, sizeof(U32), 1, pFile );
+		fwrite( _pTexels, DepthPitch, _Depth, pFile );
+		fclose( pFile );
+		return true;
+	}
+
+	// Loads the first mip of a RGBA32F table saved with the TextureFilePOM layout, the dimensions must match the expected ones
+	bool	LoadPOM( const _TCHAR* _pFileName, U32 _Width, U32 _Height, U32 _Depth, float* _pTexels ) {
+		FILE*	pFile = NULL;
+		_tfopen_s( &pFile, _pFileName, _T("rb") );
+		if ( pFile == NULL )
+			return false;
+
+		U8	Type = 0, Format = 0;
+		U32	Width = 0, Height = 0, Depth = 0, MipsCount = 0, RowPitch = 0, DepthPitch = 0;
+		fread_s( &Type, sizeof(U8), sizeof(U8), 1, pFile );
+		fread_s( &Format, sizeof(U8), sizeof(U8), 1, pFile );
+		fread_s( &Width, sizeof(U32), sizeof(U32), 1, pFile );
+		fread_s( &Height, sizeof(U32), sizeof(U32), 1, pFile );
+		fread_s( &Depth, sizeof(U32), sizeof(U32), 1, pFile );
+		fread_s( &MipsCount, sizeof(U32), sizeof(U32), 1, pFile );
+		fread_s( &RowPitch, sizeof(U32), sizeof(U32), 1, pFile );
+		fread_s( &DepthPitch, sizeof(U32), sizeof(U32), 1, pFile );
+
+		bool	Valid = Format == POM_FORMAT_RGBA32F && Width == _Width && Height == _Height && Depth == _Depth && MipsCount > 0
+					 && RowPitch == 4 * sizeof(float) * _Width && DepthPitch == RowPitch * _Height;
+		if ( Valid ) {
+			U32	Size = DepthPitch * _Depth;
+			Valid = fread_s( _pTexels, Size, Size, 1, pFile ) == 1;
+		}
+		fclose( pFile );
+		return Valid;
+	}
+
+	// Compares the RGB components of 2 tables, returns false if the tolerances are exceeded
+	bool	CompareTables( const char* _pName, U32 _Width, U32 _Height, U32 _Depth, const float* _pTexels, const float* _pReference, double _MaxRelativeRMS, float _MaxRelativeDifference ) {
+		ErrorStats	Stats;
+		U32			TexelsCount = _Width * _Height * _Depth;
+		for ( U32 TexelIndex=0; TexelIndex < TexelsCount; TexelIndex++ )
+			Stats.Accumulate( TexelIndex, _pTexels + 4*TexelIndex, _pReference + 4*TexelIndex );
+
+		return Stats.Check( _pName, _Width, _Height, _MaxRelativeRMS, _MaxRelativeDifference );
+	}
+
+	// Compares the tables with the ones found in the given directory
+	// The tolerances cover the differences with the GPU tables: the transmittance is a plain integral,
+	//	the irradiance & scattering tables accumulate the interpolation errors of the 4D table lookups made by each order
+	bool	CheckTables( const SkyTables& _Tables, const _TCHAR* _pDirectory ) {
+		struct	TableDesc {
+			const char*		pName;
+			const _TCHAR*	pFileName;
+			U32				Width, Height, Depth;
+			const float*	pTexels;
+			bool			Required;
+			double			MaxRelativeRMS;
+			float			MaxRelativeDifference;
+		}	pTables[] = {
+			{ "Transmittance", FILENAME_TRANSMITTANCE, SkyTables::TRANSMITTANCE_W, SkyTables::TRANSMITTANCE_H, 1, _Tables.GetTransmittance(), true, 1e-4, 1e-3f },
+			{ "Irradiance", FILENAME_IRRADIANCE, SkyTables::IRRADIANCE_W, SkyTables::IRRADIANCE_H, 1, _Tables.GetIrradiance(), true, 1e-3, 1e-2f },
+			{ "Scattering", FILENAME_SCATTERING, SkyTables::RES_3D_U, SkyTables::RES_3D_COS_THETA_VIEW, SkyTables::RES_3D_ALTITUDE, _Tables.GetScattering(), false, 1e-3, 1e-2f },
+		};
+
+		bool	Success = true;
+		for ( int TableIndex=0; TableIndex < sizeof(pTables) / sizeof(pTables[0]); TableIndex++ ) {
+			const TableDesc&	Table = pTables[TableIndex];
+
+			_TCHAR	pPath[MAX_PATH];
+			BuildPath( _pDirectory, Table.pFileName, pPath );
+
+			float*	pReference = new float[4 * Table.Width * Table.Height * Table.Depth];
+			if ( LoadPOM( pPath, Table.Width, Table.Height, Table.Depth, pReference ) )
+				Success &= CompareTables( Table.pName, Table.Width, Table.Height, Table.Depth, Table.pTexels, pReference, Table.MaxRelativeRMS, Table.MaxRelativeDifference );
+			else if ( Table.Required ) {
+				_tprintf( _T("Failed to load reference table \"%s\"!\n"), pPath );
+				Success = false;
+			}
+			delete[] pReference;
+		}
+		return Success;
+	}
+
+	bool	SaveTables( const SkyTables& _Tables, const _TCHAR* _pDirectory ) {
+		_TCHAR	pPath[MAX_PATH];
+		bool	Success = true;
+
+		BuildPath( _pDirectory, FILENAME_TRANSMITTANCE, pPath );
+		Success &= SavePOM( pPath, false, SkyTables::TRANSMITTANCE_W, SkyTables::TRANSMITTANCE_H, 1, _Tables.GetTransmittance() );
+		BuildPath( _pDirectory, FILENAME_IRRADIANCE, pPath );
+		Success &= SavePOM( pPath, false, SkyTables::IRRADIANCE_W, SkyTables::IRRADIANCE_H, 1, _Tables.GetIrradiance() );
+		BuildPath( _pDirectory, FILENAME_SCATTERING, pPath );
+		Success &= SavePOM( pPath, true, SkyTables::RES_3D_U, SkyTables::RES_3D_COS_THETA_VIEW, SkyTables::RES_3D_ALTITUDE, _Tables.GetScattering() );
+		return Success;
+	}
+}
+
+int _tmain( int argc, _TCHAR* argv[] ) {
+	SkyTables::Parameters	Params;
+	U32				MaxThreadsCount = 0;
+	const _TCHAR*	pOutputDirectory = NULL;
+	const _TCHAR*	pCheckDirectory = NULL;
+	bool			Save = true;
+	bool			Validate = false;
+	bool			FogExtinctionOverride = false;
+
+	for ( int ArgIndex=1; ArgIndex < argc; ArgIndex++ ) {
+		const _TCHAR*	pArg = argv[ArgIndex];
+		const _TCHAR*	pValue = ArgIndex+1 < argc ? argv[ArgIndex+1] : NULL;
+		if ( !_tcscmp( pArg, _T("-nosave") ) ) {
+			Save = false;
+			continue;
+		}
+		if ( !_tcscmp( pArg, _T("-validate") ) ) {
+			Validate = true;
+			continue;
+		}
+		if ( pValue == NULL ) {
+			_tprintf( _T("Missing value for argument \"%s\"!\n"), pArg );
+			return -1;
+		}
+		ArgIndex++;
+
+		if ( !_tcscmp( pArg, _T("-air") ) )					Params.AirAmount = float( _tstof( pValue ) );
+		else if ( !_tcscmp( pArg, _T("-airref") ) )			Params.AirReferenceAltitudeKm = float( _tstof( pValue ) );
+		else if ( !_tcscmp( pArg, _T("-fog") ) )			Params.FogScattering = float( _tstof( pValue ) );
+		else if ( !_tcscmp( pArg, _T("-fogext") ) )			{ Params.FogExtinction = float( _tstof( pValue ) ); FogExtinctionOverride = true; }
+		else if ( !_tcscmp( pArg, _T("-fogref") ) )			Params.FogReferenceAltitudeKm = float( _tstof( pValue ) );
+		else if ( !_tcscmp( pArg, _T("-anisotropy") ) )		Params.FogAnisotropy = float( _tstof( pValue ) );
+		else if ( !_tcscmp( pArg, _T("-reflectance") ) )	Params.AverageGroundReflectance = float( _tstof( pValue ) );
+		else if ( !_tcscmp( pArg, _T("-orders") ) )			Params.MaxScatteringOrder = _tstoi( pValue );
+		else if ( !_tcscmp( pArg, _T("-threads") ) )		MaxThreadsCount = U32( MAX( 0, _tstoi( pValue ) ) );
+		else if ( !_tcscmp( pArg, _T("-out") ) )			pOutputDirectory = pValue;
+		else if ( !_tcscmp( pArg, _T("-check") ) )			pCheckDirectory = pValue;
+		else {
+			_tprintf( _T("Unknown argument \"%s\"!\n"), pArg );
+			return -1;
+		}
+	}
+	if ( !FogExtinctionOverride )
+		Params.FogExtinction = Params.FogScattering / 0.9f;
+
+	printf( "Air %g (reference altitude %g km), Fog scattering %g extinction %g (reference altitude %g km), Anisotropy %g, Ground reflectance %g, %d scattering orders\n",
+		Params.AirAmount, Params.AirReferenceAltitudeKm, Params.FogScattering, Params.FogExtinction, Params.FogReferenceAltitudeKm, Params.FogAnisotropy, Params.AverageGroundReflectance, Params.MaxScatteringOrder );
+	printf( "Building sky tables using %d threads...\n", MaxThreadsCount > 0 ? MIN( MaxThreadsCount, BaseLib::GetHardwareThreadsCount() ) : BaseLib::GetHardwareThreadsCount() );
+
+	int			Result = 0;
+	SkyTables	Tables;
+	Timer		BuildTimer;
+	if ( Validate ) {
+		if ( !BuildAndValidate( Tables, Params, MaxThreadsCount ) )
+			Result = -1;
+	} else
+		Tables.Build( Params, MaxThreadsCount );
+	printf( "Built in %.1f ms\n", BuildTimer.GetElapsedMilliseconds() );
+
+	if ( Save && !SaveTables( Tables, pOutputDirectory ) ) {
+		printf( "Failed to save the tables!\n" );
+		Result = -1;
+	}
+	if ( pCheckDirectory != NULL && !CheckTables( Tables, pCheckDirectory ) )
+		Result = -1;
+
+	return Result;
+}
@@ -0,0 +1,569 @@
+#include "stdafx.h"
+#include "SkyTablesValidation.h"
+
+namespace {
+	// Same as Inc/Atmosphere.hlsl
+	const double	GROUND_RADIUS_KM = 6360.0;
+	const double	ATMOSPHERE_THICKNESS_KM = 60.0;
+
+	const U32	IRRADIANCE_SIZE = SkyTables::IRRADIANCE_W * SkyTables::IRRADIANCE_H;
+	const U32	SCATTERING_SIZE = SkyTables::RES_3D_U * SkyTables::RES_3D_COS_THETA_VIEW * SkyTables::RES_3D_ALTITUDE;
+
+	// Tolerances of the comparisons with the reference ports, that only differ by the floating-point precision and evaluation order
+	const double	STAGE_MAX_RELATIVE_RMS = 5e-4;
+	const float		STAGE_MAX_RELATIVE_ERROR = 1e-3f;
+
+	// Subset of the 3D tables texels compared with the reference ports: all the U texels of these view & altitude slices
+	// (the view slices cover both sides of the ground/sky discontinuity at V=0.5, the altitude slices cover the ground & top of the atmosphere)
+	const int	CHECKED_SLICES_Y[] = { 0, 1, 16, 32, 48, 62, 63, 64, 65, 80, 96, 112, 126, 127 };
+	const int	CHECKED_SLICES_Z[] = { 0, 1, 4, 12, 31 };
+	const int	CHECKED_SLICES_Y_COUNT = sizeof(CHECKED_SLICES_Y) / sizeof(CHECKED_SLICES_Y[0]);
+	const int	CHECKED_SLICES_Z_COUNT = sizeof(CHECKED_SLICES_Z) / sizeof(CHECKED_SLICES_Z[0]);
+
+	// Double-precision RGB
+	struct	Color {
+		double	r, g, b;
+
+		Color() : r( 0.0 ), g( 0.0 ), b( 0.0 ) {}
+		Color( double _r, double _g, double _b ) : r( _r ), g( _g ), b( _b ) {}
+		explicit Color( __m128 _Value ) {
+			float	pValue[4];
+			_mm_storeu_ps( pValue, _Value );
+			r = pValue[0]; g = pValue[1]; b = pValue[2];
+		}
+
+		Color	operator+( const Color& _Other ) const	{ return Color( r + _Other.r, g + _Other.g, b + _Other.b ); }
+		Color	operator*( const Color& _Other ) const	{ return Color( r * _Other.r, g * _Other.g, b * _Other.b ); }
+		Color	operator*( double _Factor ) const		{ return Color( r * _Factor, g * _Factor, b * _Factor ); }
+		Color&	operator+=( const Color& _Other )		{ r += _Other.r; g += _Other.g; b += _Other.b; return *this; }
+
+		void	Store( float* _pTexel ) const			{ _pTexel[0] = float(r); _pTexel[1] = float(g); _pTexel[2] = float(b); _pTexel[3] = 0.0f; }
+	};
+
+	Color	SigmaScatteringRayleigh()	{ return Color( 0.0058, 0.0135, 0.0331 ); }
+
+	float*	CopyTable( const float* _pTable, U32 _TexelsCount ) {
+		float*	pCopy = new float[4 * _TexelsCount];
+		memcpy( pCopy, _pTable, 4 * _TexelsCount * sizeof(float) );
+		return pCopy;
+	}
+
+	// Sum of the squared RGB components, used to compare the energy of successive scattering orders
+	double	ComputeEnergy( const float* _pTable, U32 _TexelsCount ) {
+		double	Sum = 0.0;
+		for ( U32 ComponentIndex=0; ComponentIndex < 4 * _TexelsCount; ComponentIndex++ )
+			if ( (ComponentIndex & 3) != 3 )
+				Sum += double(_pTable[ComponentIndex]) * _pTable[ComponentIndex];
+		return Sum;
+	}
+
+	// Checks all the RGB components are finite and non-negative
+	bool	CheckTexels( const char* _pName, const float* _pTable, U32 _TexelsCount ) {
+		U32	InvalidCount = 0, NegativeCount = 0;
+		for ( U32 ComponentIndex=0; ComponentIndex < 4 * _TexelsCount; ComponentIndex++ ) {
+			if ( (ComponentIndex & 3) == 3 )
+				continue;
+			if ( !ISVALID( _pTable[ComponentIndex] ) )
+				InvalidCount++;
+			else if ( _pTable[ComponentIndex] < 0.0f )
+				NegativeCount++;
+		}
+		if ( InvalidCount == 0 && NegativeCount == 0 )
+			return true;
+
+		printf( "%s: %d invalid and %d negative values! FAILED\n", _pName, InvalidCount, NegativeCount );
+		return false;
+	}
+
+	// Relative errors are computed against a floor that ignores the texels that are negligible in the table
+	float	ComputeRelativeFloor( const float* _pTable, U32 _TexelsCount ) {
+		return MAX( 1e-12f, 1e-3f * float( sqrt( ComputeEnergy( _pTable, _TexelsCount ) / (3 * _TexelsCount) ) ) );
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Reference ports of VolumetricPreComputeAtmospherePS.hlsl, one texel at a time
+
+	// PreComputeIrradiance_Single()
+	Color	ReferenceIrradianceSingle( const SkyTables& _Tables, int _X, int _Y ) {
+		float	AltitudeKm = float(_Y) / SkyTables::IRRADIANCE_H * float(ATMOSPHERE_THICKNESS_KM);
+		float	CosThetaSun = LERP( -0.2f, 1.0f, float(_X) / SkyTables::IRRADIANCE_W );
+		return Color( _Tables.GetTransmittance( AltitudeKm, CosThetaSun ) ) * SATURATE( CosThetaSun );
+	}
+
+	// PreComputeInScattering_Single() & Integrand_Single()
+	void	ReferenceInScatteringSingle( const SkyTables& _Tables, int _X, int _Y, int _Z, Color& _Rayleigh, Color& _Mie ) {
+		const SkyTables::Parameters&	Params = _Tables.GetParameters();
+		const int	StepsCount = Params.StepsCountSingleScattering;
+
+		float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+		SkyTables::GetSliceData( _X, _Y, _Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+		bool	GroundHit;
+		double	StepSizeKm = SkyTables::ComputeNearestHit( AltitudeKm, CosThetaView, GroundHit ) / StepsCount;
+		double	RadiusKm = GROUND_RADIUS_KM + AltitudeKm;
+
+		Color	Rayleigh, Mie, PreviousRayleigh, PreviousMie;
+		for ( int StepIndex=0; StepIndex <= StepsCount; StepIndex++ ) {
+			double	DistanceKm = StepIndex * StepSizeKm;
+			double	CurrentRadiusKm = sqrt( RadiusKm * RadiusKm + DistanceKm * DistanceKm + 2.0 * RadiusKm * CosThetaView * DistanceKm );
+			double	CurrentCosThetaSun = (RadiusKm * CosThetaSun + CosGamma * DistanceKm) / CurrentRadiusKm;
+					CurrentRadiusKm = MAX( GROUND_RADIUS_KM, CurrentRadiusKm );
+
+			Color	CurrentRayleigh, CurrentMie;
+			if ( CurrentCosThetaSun >= -sqrt( MAX( 0.0, 1.0 - GROUND_RADIUS_KM * GROUND_RADIUS_KM / (CurrentRadiusKm * CurrentRadiusKm) ) ) ) {
+				double	CurrentAltitudeKm = CurrentRadiusKm - GROUND_RADIUS_KM;
+				Color	ViewTransmittance( _Tables.GetTransmittance( AltitudeKm, CosThetaView, float(DistanceKm) ) );
+				Color	SunTransmittance( _Tables.GetTransmittance( float(CurrentAltitudeKm), float(CurrentCosThetaSun) ) );
+				CurrentRayleigh = ViewTransmittance * SunTransmittance * exp( -CurrentAltitudeKm / Params.AirReferenceAltitudeKm );
+				CurrentMie = ViewTransmittance * SunTransmittance * exp( -CurrentAltitudeKm / Params.FogReferenceAltitudeKm );
+			}	// Otherwise we're hitting the ground in that direction, ignore contribution...
+
+			if ( StepIndex > 0 ) {
+				Rayleigh += (PreviousRayleigh + CurrentRayleigh) * 0.5;
+				Mie += (PreviousMie + CurrentMie) * 0.5;
+			}
+			PreviousRayleigh = CurrentRayleigh;
+			PreviousMie = CurrentMie;
+		}
+
+		_Rayleigh = Rayleigh * SigmaScatteringRayleigh() * (Params.AirAmount * StepSizeKm);
+		_Mie = Mie * (Params.FogScattering * StepSizeKm);
+	}
+
+	// PreComputeInScattering_Delta()
+	Color	ReferenceInScatteringDelta( const SkyTables& _Tables, int _X, int _Y, int _Z, bool _FirstPass ) {
+		const SkyTables::Parameters&	Params = _Tables.GetParameters();
+		const int		StepsCount = Params.StepsCountDeltaScattering;
+		const double	dPhi = PI / StepsCount;
+		const double	dTheta = PI / StepsCount;
+
+		float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+		SkyTables::GetSliceData( _X, _Y, _Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+		double	r = GROUND_RADIUS_KM + CLAMP( double(AltitudeKm), 0.0, ATMOSPHERE_THICKNESS_KM );
+		double	ViewY = CLAMP( double(CosThetaView), -1.0, 1.0 );
+		double	SunY = CLAMP( double(CosThetaSun), -1.0, 1.0 );
+		double	var = sqrt( 1.0 - ViewY * ViewY ) * sqrt( 1.0 - SunY * SunY );
+		double	CosGammaClamped = CLAMP( double(CosGamma), SunY * ViewY - var, SunY * ViewY + var );
+		double	CosThetaGround = -sqrt( 1.0 - (GROUND_RADIUS_KM / r) * (GROUND_RADIUS_KM / r) );
+
+		double	ViewX = sqrt( 1.0 - ViewY * ViewY );
+		double	SunX = ViewX == 0.0 ? 0.0 : (CosGammaClamped - SunY * ViewY) / ViewX;
+		double	SunZ = sqrt( MAX( 0.0, 1.0 - SunX * SunX - SunY * SunY ) );
+
+		Color	SigmaAir = SigmaScatteringRayleigh() * (Params.AirAmount * exp( -AltitudeKm / Params.AirReferenceAltitudeKm ));
+		double	SigmaFog = Params.FogScattering * exp( -AltitudeKm / Params.FogReferenceAltitudeKm );
+
+		Color	Scattering;
+		for ( int ThetaIndex=0; ThetaIndex < StepsCount; ThetaIndex++ ) {
+			double	Theta = (ThetaIndex + 0.5) * dTheta;
+			double	stheta = sin( Theta ), ctheta = cos( Theta );
+
+			Color	GroundReflectance;
+			double	Distance2Ground = -1.0;
+			if ( ctheta < CosThetaGround ) {
+				Distance2Ground = -r * ctheta - sqrt( r * r * (ctheta * ctheta - 1.0) + GROUND_RADIUS_KM * GROUND_RADIUS_KM );
+				GroundReflectance = Color( _Tables.GetTransmittance( 0.0f, float( -(r * ctheta + Distance2Ground) / GROUND_RADIUS_KM ), float(Distance2Ground) ) ) * (Params.AverageGroundReflectance / PI);
+			}
+
+			for ( int PhiIndex=0; PhiIndex < 2 * StepsCount; PhiIndex++ ) {
+				double	Phi = (PhiIndex + 0.5) * dPhi;
+				double	wx = cos( Phi ) * stheta, wy = ctheta, wz = sin( Phi ) * stheta;
+				double	dw = stheta * dTheta * dPhi;
+
+				// Light reflected by the ground
+				Color	dScattering;
+				if ( Distance2Ground > 0.0 ) {
+					double	CosThetaGroundSun = (Distance2Ground * wx * SunX + (r + Distance2Ground * wy) * SunY + Distance2Ground * wz * SunZ) / GROUND_RADIUS_KM;
+					dScattering = GroundReflectance * Color( _Tables.GetIrradiance( _Tables.GetDeltaIrradiance(), 0.0f, float(CosThetaGroundSun) ) );
+				}
+
+				// Light in-scattered by the previous order
+				float	CosPhaseAngleSun = float( SunX * wx + SunY * wy + SunZ * wz );
+				Color	InScattered( _Tables.Sample4DScatteringTable( _Tables.GetDeltaScatteringRayleigh(), AltitudeKm, float(wy), CosThetaSun, CosPhaseAngleSun ) );
+				if ( _FirstPass ) {
+					Color	InScatteredMie( _Tables.Sample4DScatteringTable( _Tables.GetDeltaScatteringMie(), AltitudeKm, float(wy), CosThetaSun, CosPhaseAngleSun ) );
+					InScattered = InScattered * _Tables.PhaseFunctionRayleigh( CosPhaseAngleSun ) + InScatteredMie * _Tables.PhaseFunctionMie( CosPhaseAngleSun );
+				}
+				dScattering += InScattered;
+
+				// Scattered toward the view
+				float	CosPhaseAngleView = float( ViewX * wx + ViewY * wy );
+				Color	Phase = SigmaAir * _Tables.PhaseFunctionRayleigh( CosPhaseAngleView ) + Color( 1.0, 1.0, 1.0 ) * (SigmaFog * _Tables.PhaseFunctionMie( CosPhaseAngleView ));
+				Scattering += dScattering * Phase * dw;
+			}
+		}
+
+		return Scattering;
+	}
+
+	// PreComputeIrradiance_Delta()
+	Color	ReferenceIrradianceDelta( const SkyTables& _Tables, int _X, int _Y, bool _FirstPass ) {
+		const int		StepsCount = _Tables.GetParameters().StepsCountDeltaIrradiance;
+		const double	dPhi = PI / StepsCount;
+		const double	dTheta = PI / StepsCount;
+
+		float	AltitudeKm = float(_Y) / SkyTables::IRRADIANCE_H * float(ATMOSPHERE_THICKNESS_KM);
+		float	CosThetaSun = LERP( -0.2f, 1.0f, float(_X) / SkyTables::IRRADIANCE_W );
+		double	SunX = sqrt( 1.0 - SATURATE( double(CosThetaSun) * CosThetaSun ) );
+		double	SunY = CosThetaSun;
+
+		Color	Result;
+		for ( int PhiIndex=0; PhiIndex < 2 * StepsCount; PhiIndex++ ) {
+			double	cphi = cos( (PhiIndex + 0.5) * dPhi );
+			for ( int ThetaIndex=0; ThetaIndex < StepsCount / 2; ThetaIndex++ ) {
+				double	Theta = (ThetaIndex + 0.5) * dTheta;
+				double	stheta = sin( Theta ), ctheta = cos( Theta );
+				double	dw = stheta * dTheta * dPhi;
+
+				float	CosPhaseAngleSun = float( SunX * cphi * stheta + SunY * ctheta );
+				Color	InScattering( _Tables.Sample4DScatteringTable( _Tables.GetDeltaScatteringRayleigh(), AltitudeKm, float(ctheta), CosThetaSun, CosPhaseAngleSun ) );
+				if ( _FirstPass ) {
+					Color	InScatteringMie( _Tables.Sample4DScatteringTable( _Tables.GetDeltaScatteringMie(), AltitudeKm, float(ctheta), CosThetaSun, CosPhaseAngleSun ) );
+					InScattering = InScattering * _Tables.PhaseFunctionRayleigh( CosPhaseAngleSun ) + InScatteringMie * _Tables.PhaseFunctionMie( CosPhaseAngleSun );
+				}
+				Result += InScattering * (ctheta * dw);
+			}
+		}
+
+		return Result;
+	}
+
+	// PreComputeInScattering_Multiple() & Integrand_Multiple()
+	Color	ReferenceInScatteringMultiple( const SkyTables& _Tables, const float* _pDeltaScattering, int _X, int _Y, int _Z ) {
+		const int	StepsCount = _Tables.GetParameters().StepsCountMultipleScattering;
+
+		float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+		SkyTables::GetSliceData( _X, _Y, _Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+		// The geometry along the ray is evaluated in single precision like the shader: near the ground, the view coordinate of the deltaJ lookups
+		//	is so sensitive to the altitude that the rounding of the radius alone moves it by several texels
+		bool	GroundHit;
+		float	StepSizeKm = SkyTables::ComputeNearestHit( AltitudeKm, CosThetaView, GroundHit ) / StepsCount;
+		float	RadiusKm = float(GROUND_RADIUS_KM) + AltitudeKm;
+
+		Color	Result, Previous;
+		for ( int StepIndex=0; StepIndex <= StepsCount; StepIndex++ ) {
+			float	DistanceKm = StepIndex * StepSizeKm;
+			float	CurrentRadiusKm = sqrtf( RadiusKm * RadiusKm + DistanceKm * DistanceKm + 2.0f * RadiusKm * CosThetaView * DistanceKm );
+			float	CurrentCosThetaSun = (RadiusKm * CosThetaSun + CosGamma * DistanceKm) / CurrentRadiusKm;
+			float	CurrentCosThetaView = (RadiusKm * CosThetaView + DistanceKm) / CurrentRadiusKm;
+
+			Color	ViewTransmittance( _Tables.GetTransmittance( AltitudeKm, CosThetaView, DistanceKm ) );
+			Color	InScattering( _Tables.Sample4DScatteringTable( _pDeltaScattering, CurrentRadiusKm - float(GROUND_RADIUS_KM), CurrentCosThetaView, CurrentCosThetaSun, CosGamma ) );
+			Color	Current = ViewTransmittance * InScattering;
+
+			if ( StepIndex > 0 )
+				Result += (Previous + Current) * 0.5;
+			Previous = Current;
+		}
+
+		return Result * double(StepSizeKm);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Stage checks
+
+	bool	CheckIrradianceSingle( const SkyTables& _Tables ) {
+		ErrorStats	Stats( ComputeRelativeFloor( _Tables.GetDeltaIrradiance(), IRRADIANCE_SIZE ) );
+		for ( int Y=0; Y < SkyTables::IRRADIANCE_H; Y++ )
+			for ( int X=0; X < SkyTables::IRRADIANCE_W; X++ ) {
+				U32		TexelIndex = SkyTables::IRRADIANCE_W * Y + X;
+				float	pReference[4];
+				ReferenceIrradianceSingle( _Tables, X, Y ).Store( pReference );
+				Stats.Accumulate( TexelIndex, _Tables.GetDeltaIrradiance() + 4 * TexelIndex, pReference );
+			}
+
+		bool	Success = CheckTexels( "deltaE (order 1)", _Tables.GetDeltaIrradiance(), IRRADIANCE_SIZE );
+		Success &= Stats.Check( "deltaE (order 1)", SkyTables::IRRADIANCE_W, SkyTables::IRRADIANCE_H, STAGE_MAX_RELATIVE_RMS, STAGE_MAX_RELATIVE_ERROR );
+		return Success;
+	}
+
+	bool	CheckIrradianceDelta( const SkyTables& _Tables, int _Order ) {
+		// deltaE was overwritten by the stage, the reference only depends on deltaS that is still untouched
+		ErrorStats	Stats( ComputeRelativeFloor( _Tables.GetDeltaIrradiance(), IRRADIANCE_SIZE ) );
+		for ( int Y=0; Y < SkyTables::IRRADIANCE_H; Y++ )
+			for ( int X=0; X < SkyTables::IRRADIANCE_W; X++ ) {
+				U32		TexelIndex = SkyTables::IRRADIANCE_W * Y + X;
+				float	pReference[4];
+				ReferenceIrradianceDelta( _Tables, X, Y, _Order == 2 ).Store( pReference );
+				Stats.Accumulate( TexelIndex, _Tables.GetDeltaIrradiance() + 4 * TexelIndex, pReference );
+			}
+
+		char	pName[64];
+		sprintf_s( pName, 64, "deltaE (order %d)", _Order );
+		bool	Success = CheckTexels( pName, _Tables.GetDeltaIrradiance(), IRRADIANCE_SIZE );
+		Success &= Stats.Check( pName, SkyTables::IRRADIANCE_W, SkyTables::IRRADIANCE_H, STAGE_MAX_RELATIVE_RMS, STAGE_MAX_RELATIVE_ERROR );
+		return Success;
+	}
+
+	// Compares a 3D table computed by a stage with its reference on the checked slices
+	enum	SCATTERING_STAGE {
+		SINGLE_RAYLEIGH,
+		SINGLE_MIE,
+		DELTA,				// J
+		MULTIPLE,
+	};
+
+	bool	CheckScatteringStage( const SkyTables& _Tables, SCATTERING_STAGE _Stage, const float* _pTable, const float* _pDeltaScattering, const char* _pName, bool _FirstPass ) {
+		ErrorStats	Stats( ComputeRelativeFloor( _pTable, SCATTERING_SIZE ) );
+		for ( int SliceZ=0; SliceZ < CHECKED_SLICES_Z_COUNT; SliceZ++ ) {
+			int	Z = CHECKED_SLICES_Z[SliceZ];
+			for ( int SliceY=0; SliceY < CHECKED_SLICES_Y_COUNT; SliceY++ ) {
+				int	Y = CHECKED_SLICES_Y[SliceY];
+				for ( int X=0; X < SkyTables::RES_3D_U; X++ ) {
+					Color	Reference, Mie;
+					switch ( _Stage ) {
+					case SINGLE_RAYLEIGH:	ReferenceInScatteringSingle( _Tables, X, Y, Z, Reference, Mie ); break;
+					case SINGLE_MIE:		ReferenceInScatteringSingle( _Tables, X, Y, Z, Mie, Reference ); break;
+					case DELTA:				Reference = ReferenceInScatteringDelta( _Tables, X, Y, Z, _FirstPass ); break;
+					case MULTIPLE:			Reference = ReferenceInScatteringMultiple( _Tables, _pDeltaScattering, X, Y, Z ); break;
+					}
+
+					U32		TexelIndex = SkyTables::RES_3D_U * (SkyTables::RES_3D_COS_THETA_VIEW * Z + Y) + X;
+					float	pReference[4];
+					Reference.Store( pReference );
+					Stats.Accumulate( TexelIndex, _pTable + 4 * TexelIndex, pReference );
+				}
+			}
+		}
+
+		bool	Success = CheckTexels( _pName, _pTable, SCATTERING_SIZE );
+		Success &= Stats.Check( _pName, SkyTables::RES_3D_U, SkyTables::RES_3D_COS_THETA_VIEW, STAGE_MAX_RELATIVE_RMS, STAGE_MAX_RELATIVE_ERROR );
+		return Success;
+	}
+
+	// Checks that each order carries less energy than the previous one
+	bool	CheckEnergyDecrease( const char* _pName, int _Order, double _Energy, double _PreviousEnergy ) {
+		if ( _Energy < _PreviousEnergy )
+			return true;
+
+		printf( "%s: order %d has more energy than order %d (%g >= %g)! FAILED\n", _pName, _Order, _Order-1, _Energy, _PreviousEnergy );
+		return false;
+	}
+
+	// Checks that the coordinates computed by Sample4DScatteringTable() for the angles given by GetSliceData() fall on the texel centers
+	// The texels whose angles are clamped by GetSliceData() (as in the shader) are skipped, they are only counted:
+	//	. The 1st Sun angle is below the -0.1975 clamp of the Sun coordinate
+	//	. The 1st & last altitudes are moved 1 m inside the atmosphere
+	//	. The view angles are clamped between the nearest ground (or atmosphere) distance and 0.999 times the distance to the horizon,
+	//		view angles toward the ground stay 0.001 below the horizon and view angles toward the sky stay above the horizontal
+	//	. The view coordinate is not checked in the 1st slice where the altitude is too small for r^2-Rg^2 to be accurate in single precision
+	bool	CheckScatteringParametrization() {
+		const float	MAX_ERROR = 0.01f;			// In texels
+		const float	MAX_VIEW_ERROR = 0.1f;		// The view coordinate loses precision near the ground
+
+		float	pMaxErrors[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		U32		ClampedRowsCount = 0;
+		for ( int Z=1; Z < SkyTables::RES_3D_ALTITUDE-1; Z++ )
+			for ( int Y=0; Y < SkyTables::RES_3D_COS_THETA_VIEW; Y++ ) {
+				float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+				SkyTables::GetSliceData( 0, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+				// Unclamped view angle
+				double	r = GROUND_RADIUS_KM + AltitudeKm;
+				double	DistanceHorizonKm = sqrt( r * r - GROUND_RADIUS_KM * GROUND_RADIUS_KM );
+				bool	Clamped;
+				if ( Y < SkyTables::RES_3D_COS_THETA_VIEW / 2 ) {
+					double	d = (1.0 - Y / (SkyTables::RES_3D_COS_THETA_VIEW / 2.0 - 1.0)) * DistanceHorizonKm;
+					Clamped = d < r - GROUND_RADIUS_KM || d > 0.999 * DistanceHorizonKm
+						   || (GROUND_RADIUS_KM * GROUND_RADIUS_KM - r * r - d * d) / (2.0 * r * d) > -DistanceHorizonKm / r - 0.001;
+				} else {
+					const double	ATMOSPHERE_RADIUS_KM = GROUND_RADIUS_KM + ATMOSPHERE_THICKNESS_KM;
+					DistanceHorizonKm += sqrt( ATMOSPHERE_RADIUS_KM * ATMOSPHERE_RADIUS_KM - GROUND_RADIUS_KM * GROUND_RADIUS_KM );
+					double	d = (Y - SkyTables::RES_3D_COS_THETA_VIEW / 2.0) / (SkyTables::RES_3D_COS_THETA_VIEW / 2.0 - 1.0) * DistanceHorizonKm;
+					Clamped = d < ATMOSPHERE_RADIUS_KM - r || d > 0.999 * DistanceHorizonKm
+						   || ATMOSPHERE_RADIUS_KM * ATMOSPHERE_RADIUS_KM - r * r - d * d < 0.0;
+				}
+				if ( Clamped ) {
+					ClampedRowsCount++;
+					continue;
+				}
+
+				for ( int X=0; X < SkyTables::RES_3D_U; X++ ) {
+					SkyTables::GetSliceData( X, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+
+					float	uCosThetaView, uAltitude, t;
+					SkyTables::GetScatteringCoordinates( AltitudeKm, CosThetaView, uCosThetaView, uAltitude );
+					float	uCosThetaSun = SkyTables::GetScatteringCoordinateSun( CosThetaSun );
+					float	uGamma = SkyTables::GetScatteringCoordinateGamma( CosGamma, t );
+
+					float	pErrors[4] = {
+						fabs( uAltitude * SkyTables::RES_3D_ALTITUDE - 0.5f - Z ),
+						fabs( uCosThetaView * SkyTables::RES_3D_COS_THETA_VIEW - 0.5f - Y ),
+						X % SkyTables::RES_3D_COS_THETA_SUN == 0 ? 0.0f : fabs( uCosThetaSun * SkyTables::RES_3D_COS_THETA_SUN - 0.5f - X % SkyTables::RES_3D_COS_THETA_SUN ),
+						fabs( uGamma + t - X / SkyTables::RES_3D_COS_THETA_SUN ),
+					};
+					for ( int CoordinateIndex=0; CoordinateIndex < 4; CoordinateIndex++ )
+						pMaxErrors[CoordinateIndex] = MAX( pMaxErrors[CoordinateIndex], pErrors[CoordinateIndex] );
+				}
+			}
+
+		bool	Success = pMaxErrors[0] <= MAX_ERROR && pMaxErrors[1] <= MAX_VIEW_ERROR && pMaxErrors[2] <= MAX_ERROR && pMaxErrors[3] <= MAX_ERROR;
+		printf( "Scattering coordinates: max error in texels altitude %g, view %g, Sun %g, gamma %g (tolerance %g, %g for view), %d clamped rows out of %d%s\n",
+			pMaxErrors[0], pMaxErrors[1], pMaxErrors[2], pMaxErrors[3], MAX_ERROR, MAX_VIEW_ERROR,
+			ClampedRowsCount, (SkyTables::RES_3D_ALTITUDE-2) * SkyTables::RES_3D_COS_THETA_VIEW, Success ? "" : " FAILED" );
+		return Success;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// ErrorStats
+ErrorStats::ErrorStats( float _RelativeFloor )
+	: m_SumSqDifference( 0.0 )
+	, m_SumSqReference( 0.0 )
+	, m_MaxDifference( 0.0f )
+	, m_MaxRelativeDifference( 0.0f )
+	, m_MaxDifferenceTexel( 0 )
+	, m_MaxRelativeDifferenceTexel( 0 )
+	, m_ComponentsCount( 0 )
+	, m_InvalidCount( 0 )
+	, m_RelativeFloor( _RelativeFloor ) {
+}
+
+void	ErrorStats::Accumulate( U32 _TexelIndex, const float* _pValue, const float* _pReference ) {
+	for ( int ComponentIndex=0; ComponentIndex < 3; ComponentIndex++ ) {
+		float	Value = _pValue[ComponentIndex];
+		float	Reference = _pReference[ComponentIndex];
+		if ( !ISVALID( Value ) ) {
+			m_InvalidCount++;
+			continue;
+		}
+
+		float	Difference = fabs( Value - Reference );
+		float	RelativeDifference = Difference / MAX( m_RelativeFloor, fabs( Reference ) );	// Don't blow up near 0
+		if ( Difference > m_MaxDifference ) {
+			m_MaxDifference = Difference;
+			m_MaxDifferenceTexel = _TexelIndex;
+		}
+		if ( RelativeDifference > m_MaxRelativeDifference ) {
+			m_MaxRelativeDifference = RelativeDifference;
+			m_MaxRelativeDifferenceTexel = _TexelIndex;
+		}
+		m_SumSqDifference += double(Difference) * Difference;
+		m_SumSqReference += double(Reference) * Reference;
+		m_ComponentsCount++;
+	}
+}
+
+double	ErrorStats::GetRelativeRMS() const {
+	return sqrt( m_SumSqDifference / MAX( 1e-24, m_SumSqReference ) );
+}
+
+bool	ErrorStats::Check( const char* _pName, U32 _Width, U32 _Height, double _MaxRelativeRMS, float _MaxRelativeDifference ) const {
+	double	RMS = sqrt( m_SumSqDifference / MAX( 1U, m_ComponentsCount ) );
+	double	RelativeRMS = GetRelativeRMS();
+	bool	Success = m_InvalidCount == 0 && RelativeRMS <= _MaxRelativeRMS && m_MaxRelativeDifference <= _MaxRelativeDifference;
+
+	printf( "%s: RMS error %g (%.3f%% of RMS value, tolerance %.3f%%), max error %g at (%d,%d,%d), max relative error %.3f%% at (%d,%d,%d) (tolerance %.3f%%)%s\n",
+		_pName, RMS, 100.0 * RelativeRMS, 100.0 * _MaxRelativeRMS,
+		m_MaxDifference, m_MaxDifferenceTexel % _Width, (m_MaxDifferenceTexel / _Width) % _Height, m_MaxDifferenceTexel / (_Width * _Height),
+		100.0f * m_MaxRelativeDifference, m_MaxRelativeDifferenceTexel % _Width, (m_MaxRelativeDifferenceTexel / _Width) % _Height, m_MaxRelativeDifferenceTexel / (_Width * _Height),
+		100.0f * _MaxRelativeDifference, Success ? "" : " FAILED" );
+	if ( m_InvalidCount > 0 )
+		printf( "%s: %d invalid values!\n", _pName, m_InvalidCount );
+
+	return Success;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Same sequence as SkyTables::Build()
+bool	BuildAndValidate( SkyTables& _Tables, const SkyTables::Parameters& _Params, U32 _MaxThreadsCount ) {
+	_Tables.Initialize( _Params, _MaxThreadsCount );
+
+	// Single scattering
+	_Tables.ComputeTransmittance();
+	bool	Success = CheckTexels( "Transmittance", _Tables.GetTransmittance(), SkyTables::TRANSMITTANCE_W * SkyTables::TRANSMITTANCE_H );
+
+	_Tables.ComputeIrradiance_Single();
+	Success &= CheckIrradianceSingle( _Tables );
+
+	_Tables.ComputeInScattering_Single();
+	Success &= CheckScatteringStage( _Tables, SINGLE_RAYLEIGH, _Tables.GetDeltaScatteringRayleigh(), NULL, "deltaSR (order 1)", false );
+	Success &= CheckScatteringStage( _Tables, SINGLE_MIE, _Tables.GetDeltaScatteringMie(), NULL, "deltaSM (order 1)", false );
+
+	_Tables.MergeInitialScattering();
+
+	// Expected final tables, accumulated separately
+	float*	pExpectedIrradiance = new float[4 * IRRADIANCE_SIZE];
+	memset( pExpectedIrradiance, 0, 4 * IRRADIANCE_SIZE * sizeof(float) );
+	float*	pExpectedScattering = CopyTable( _Tables.GetScattering(), SCATTERING_SIZE );
+
+	if ( _Params.MaxScatteringOrder < 2 ) {
+		memcpy( pExpectedIrradiance, _Tables.GetDeltaIrradiance(), 4 * IRRADIANCE_SIZE * sizeof(float) );
+		_Tables.AccumulateIrradiance();
+	}
+
+	// Multiple scattering
+	double	PreviousIrradianceEnergy = 0.0, PreviousScatteringEnergy = 0.0;
+	for ( int Order=2; Order <= _Params.MaxScatteringOrder; Order++ ) {
+		char	pName[64];
+
+		_Tables.ComputeInScattering_Delta( Order == 2 );
+		sprintf_s( pName, 64, "deltaJ (order %d)", Order );
+		Success &= CheckScatteringStage( _Tables, DELTA, _Tables.GetDeltaScattering(), NULL, pName, Order == 2 );
+
+		_Tables.ComputeIrradiance_Delta( Order == 2 );
+		Success &= CheckIrradianceDelta( _Tables, Order );
+
+		// The stage overwrites deltaSR with deltaS
+		float*	pDeltaScattering = CopyTable( _Tables.GetDeltaScattering(), SCATTERING_SIZE );
+		_Tables.ComputeInScattering_Multiple();
+		sprintf_s( pName, 64, "deltaS (order %d)", Order );
+		Success &= CheckScatteringStage( _Tables, MULTIPLE, _Tables.GetDeltaScatteringRayleigh(), pDeltaScattering, pName, false );
+		delete[] pDeltaScattering;
+
+		double	IrradianceEnergy = ComputeEnergy( _Tables.GetDeltaIrradiance(), IRRADIANCE_SIZE );
+		double	ScatteringEnergy = ComputeEnergy( _Tables.GetDeltaScatteringRayleigh(), SCATTERING_SIZE );
+		if ( Order > 2 ) {
+			Success &= CheckEnergyDecrease( "deltaE", Order, IrradianceEnergy, PreviousIrradianceEnergy );
+			Success &= CheckEnergyDecrease( "deltaS", Order, ScatteringEnergy, PreviousScatteringEnergy );
+		}
+		PreviousIrradianceEnergy = IrradianceEnergy;
+		PreviousScatteringEnergy = ScatteringEnergy;
+
+		// Accumulate the expected tables
+		const float*	pDeltaIrradiance = _Tables.GetDeltaIrradiance();
+		for ( U32 ComponentIndex=0; ComponentIndex < 4 * IRRADIANCE_SIZE; ComponentIndex++ )
+			pExpectedIrradiance[ComponentIndex] += pDeltaIrradiance[ComponentIndex];
+
+		const float*	pDeltaScatteringMultiple = _Tables.GetDeltaScatteringRayleigh();
+		for ( int Z=0; Z < SkyTables::RES_3D_ALTITUDE; Z++ )
+			for ( int Y=0; Y < SkyTables::RES_3D_COS_THETA_VIEW; Y++ )
+				for ( int X=0; X < SkyTables::RES_3D_U; X++ ) {
+					float	AltitudeKm, CosThetaView, CosThetaSun, CosGamma;
+					SkyTables::GetSliceData( X, Y, Z, AltitudeKm, CosThetaView, CosThetaSun, CosGamma );
+					float	InvPhase = 1.0f / _Tables.PhaseFunctionRayleigh( CosGamma );
+
+					U32	ComponentIndex = 4 * (SkyTables::RES_3D_U * (SkyTables::RES_3D_COS_THETA_VIEW * Z + Y) + X);
+					pExpectedScattering[ComponentIndex+0] += pDeltaScatteringMultiple[ComponentIndex+0] * InvPhase;
+					pExpectedScattering[ComponentIndex+1] += pDeltaScatteringMultiple[ComponentIndex+1] * InvPhase;
+					pExpectedScattering[ComponentIndex+2] += pDeltaScatteringMultiple[ComponentIndex+2] * InvPhase;
+				}
+
+		_Tables.AccumulateIrradiance();
+		_Tables.AccumulateInScattering();
+	}
+
+	// Final tables must be the sum of all the orders
+	ErrorStats	IrradianceStats( ComputeRelativeFloor( pExpectedIrradiance, IRRADIANCE_SIZE ) );
+	for ( U32 TexelIndex=0; TexelIndex < IRRADIANCE_SIZE; TexelIndex++ )
+		IrradianceStats.Accumulate( TexelIndex, _Tables.GetIrradiance() + 4 * TexelIndex, pExpectedIrradiance + 4 * TexelIndex );
+	Success &= CheckTexels( "Irradiance", _Tables.GetIrradiance(), IRRADIANCE_SIZE );
+	Success &= IrradianceStats.Check( "Irradiance (sum of orders)", SkyTables::IRRADIANCE_W, SkyTables::IRRADIANCE_H, STAGE_MAX_RELATIVE_RMS, STAGE_MAX_RELATIVE_ERROR );
+
+	ErrorStats	ScatteringStats( ComputeRelativeFloor( pExpectedScattering, SCATTERING_SIZE ) );
+	for ( U32 TexelIndex=0; TexelIndex < SCATTERING_SIZE; TexelIndex++ )
+		ScatteringStats.Accumulate( TexelIndex, _Tables.GetScattering() + 4 * TexelIndex, pExpectedScattering + 4 * TexelIndex );
+	Success &= CheckTexels( "Scattering", _Tables.GetScattering(), SCATTERING_SIZE );
+	Success &= ScatteringStats.Check( "Scattering (sum of orders)", SkyTables::RES_3D_U, SkyTables::RES_3D_COS_THETA_VIEW, STAGE_MAX_RELATIVE_RMS, STAGE_MAX_RELATIVE_ERROR );
+
+	delete[] pExpectedIrradiance;
+	delete[] pExpectedScattering;
+
+	// 4D table parametrization
+	Success &= CheckScatteringParametrization();
+
+	printf( Success ? "All the stages passed validation.\n" : "Validation FAILED!\n" );
+	return Success;
+}
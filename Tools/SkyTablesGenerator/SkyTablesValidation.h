@@ -0,0 +1,47 @@
+//////////////////////////////////////////////////////////////////////////
+// Validation of the sky tables computation
+//
+// BuildAndValidate() runs the stages of SkyTables::Build() one at a time and checks the output of each stage:
+//	. Single scattering (deltaSR & deltaSM), delta scattering J (deltaJ), delta irradiance (deltaE) and multiple scattering (deltaS)
+//		are compared on a subset of texels with a straightforward double-precision port of the matching functions of
+//		VolumetricPreComputeAtmospherePS.hlsl, computing each texel on its own (i.e. without the per-scanline quantities,
+//		the cached deltaS slabs and the SSE code of SkyTables)
+//	. All the texels must be finite and non-negative
+//	. The energy of deltaE and deltaS must decrease with each scattering order
+//	. The final irradiance & scattering tables must be the sum of all the orders
+//	. The 4D scattering table coordinates computed by Sample4DScatteringTable() for the angles given by GetSliceData() must fall on the texel centers
+//		(except where GetSliceData() clamps the angles)
+//
+#pragma once
+
+#include "SkyTables.h"
+
+// Accumulates the differences between the RGB components of computed texels and their reference
+class	ErrorStats {
+	double	m_SumSqDifference;
+	double	m_SumSqReference;
+	float	m_MaxDifference;
+	float	m_MaxRelativeDifference;
+	U32		m_MaxDifferenceTexel;
+	U32		m_MaxRelativeDifferenceTexel;
+	U32		m_ComponentsCount;
+	U32		m_InvalidCount;
+	float	m_RelativeFloor;			// Reference values below that floor are considered equal to the floor when computing relative errors
+
+public:
+
+	explicit ErrorStats( float _RelativeFloor=1e-4f );
+
+	void	Accumulate( U32 _TexelIndex, const float* _pValue, const float* _pReference );
+
+	double	GetRelativeRMS() const;		// RMS error, relative to the RMS reference value
+
+	// Prints the statistics and returns false if any value was not finite or if the tolerances are exceeded
+	//	_MaxRelativeRMS, the tolerance on the RMS error relative to the RMS reference value
+	//	_MaxRelativeDifference, the tolerance on the relative error of each component
+	bool	Check( const char* _pName, U32 _Width, U32 _Height, double _MaxRelativeRMS, float _MaxRelativeDifference ) const;
+};
+
+// Builds the tables stage by stage, validating each stage
+// Returns false if any check failed (the tables are built anyway)
+bool	BuildAndValidate( SkyTables& _Tables, const SkyTables::Parameters& _Params, U32 _MaxThreadsCount=0 );
@@ -6,10 +6,11 @@ static size_t	gs_MemoryOffset = 0;
 
 void	AllocateMemoryPool()
 {
-	gs_pMemoryBuffer = (U8*) GlobalAlloc( GMEM_ZEROINIT, MEMORY_POOL_SIZE );
+	gs_pMemoryBuffer = (U8*) GlobalAlloc( GMEM_ZEROINIT, MEMORY_POOL_SIZE+31 );
 	ASSERT( gs_pMemoryBuffer != NULL, "Failed to allocate giant memory octop... never mind... POOL !" );
 
-	gs_pMemoryBufferAligned = (U8*) (U32(gs_pMemoryBuffer+31) & (~31));
+	gs_pMemoryBufferAligned = (U8*) ((size_t(gs_pMemoryBuffer)+31) & ~size_t(31));
+	gs_MemoryOffset = 0;
 }
 
 void	FreeMemoryPool()
@@ -22,8 +23,11 @@ void*	Alloc( size_t _Size )
 {
 	ASSERT( gs_pMemoryBuffer != NULL, "Alloc() called whereas memory pool is not initialized !	Did you forget to call AllocateMemoryPool() ?" );
 
-	void*	pResult = gs_pMemoryBufferAligned;
-	gs_pMemoryBufferAligned += gs_MemoryOffset;
+	_Size = (_Size + 15) & ~size_t(15);	// Keep all the buffers 16-bytes aligned
+	ASSERT( gs_MemoryOffset + _Size <= MEMORY_POOL_SIZE, "Memory pool is full !" );
+
+	void*	pResult = gs_pMemoryBufferAligned + gs_MemoryOffset;
+	gs_MemoryOffset += _Size;
 
 	return pResult;
 }
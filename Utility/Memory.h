@@ -9,5 +9,6 @@ void	AllocateMemoryPool();	// Allocates a big chunck of memory that will be used
 void	FreeMemoryPool();		// Frees a big chunk of memory
 void*	Alloc( size_t _Size );	// Allocates a small buffer (AllocateMemoryPool must have been called first !)
 
-inline void* __cdecl	operator new( size_t _Size )	{ return GlobalAlloc( GMEM_ZEROINIT, _Size ); }
-inline void  __cdecl	operator delete( void* p )		{ GlobalFree( p ); }
+// Objects are still zeroed on allocation as the intro code relies on it
+inline void* __cdecl	operator new( size_t _Size )	{ return HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, _Size ); }
+inline void  __cdecl	operator delete( void* p )		{ if ( p != NULL ) HeapFree( GetProcessHeap(), 0, p ); }
@@ -32,3 +32,67 @@ bool		MemoryMappedFile::CheckForChange()
 	m_Checksum = Checksum;
 	return true;
 }
+
+//////////////////////////////////////////////////////////////////////////
+// Read-only file view
+//
+MappedFileView::MappedFileView()
+	: m_hFile( INVALID_HANDLE_VALUE )
+	, m_hMapping( NULL )
+	, m_pView( NULL )
+	, m_Size( 0 )
+{
+}
+
+MappedFileView::~MappedFileView()
+{
+	Close();
+}
+
+bool		MappedFileView::Open( const char* _pFileName )
+{
+	Close();
+
+	m_hFile = CreateFileA( _pFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if ( m_hFile == INVALID_HANDLE_VALUE )
+		return false;	// Not found...
+
+	LARGE_INTEGER	FileSize;
+	if ( !GetFileSizeEx( m_hFile, &FileSize ) || FileSize.QuadPart == 0 || FileSize.HighPart != 0 )
+	{	// Empty or larger than 4GB
+		Close();
+		return false;
+	}
+	m_Size = FileSize.LowPart;
+
+	m_hMapping = CreateFileMappingA( m_hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( m_hMapping == NULL )
+	{
+		Close();
+		return false;
+	}
+
+	m_pView = (const U8*) MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( m_pView == NULL )
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void		MappedFileView::Close()
+{
+	if ( m_pView != NULL )
+		UnmapViewOfFile( m_pView );
+	if ( m_hMapping != NULL )
+		CloseHandle( m_hMapping );
+	if ( m_hFile != INVALID_HANDLE_VALUE )
+		CloseHandle( m_hFile );
+
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+	m_pView = NULL;
+	m_Size = 0;
+}
@@ -31,4 +31,37 @@ public:
 
 	T&		GetMappedMemory()	{ return MemoryMappedFile::GetMappedMemory<T>(); }
 	bool	CheckForChange()	{ return MemoryMappedFile::CheckForChange(); }
+};
+
+// Read-only view of an existing file on disk
+// The whole file is mapped at once so data can be accessed in place without any intermediate read
+class MappedFileView
+{
+private:
+
+	HANDLE			m_hFile;
+	HANDLE			m_hMapping;
+	const U8*		m_pView;
+	U32				m_Size;
+
+public:
+
+	MappedFileView();
+	~MappedFileView();
+
+	// Maps the entire file, returns false if the file doesn't exist or can't be mapped
+	bool			Open( const char* _pFileName );
+	void			Close();
+
+	bool			IsOpen() const			{ return m_pView != NULL; }
+	U32				GetSize() const			{ return m_Size; }
+	const void*		GetMappedMemory() const	{ return m_pView; }
+
+	// Returns a typed pointer at the specified offset in the file (NULL if out of range)
+	// (the test is written so neither the offset nor the count can overflow)
+	template<typename T> const T*	GetMappedMemory( U32 _Offset, U64 _Count=1 ) const {
+		if ( m_pView == NULL || _Offset > m_Size || _Count > (m_Size - _Offset) / sizeof(T) )
+			return NULL;
+		return (const T*) (m_pView + _Offset);
+	}
 };
\ No newline at end of file
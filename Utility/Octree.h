@@ -1,14 +1,26 @@
 //////////////////////////////////////////////////////////////////////////
 // Octree helper
 //
+// Nodes and contents are pooled in contiguous arrays and reference each other by index:
+//	. Each node stores the indices of its 8 children and the index of its first content reference
+//	. Content references form a singly-linked list per node, they are stored contiguously when the octree is bulk-built
+//	. A content whose bounding box straddles several cells is referenced by all the cells it overlaps (at the same level)
+//
+// The octree can either be filled incrementally with Append(), or bulk-built top-down from a whole array of contents with Build()
+//	(the 8 sub-trees of the root are built in parallel).
+// Queries are const and can safely be issued from several threads at once.
+//
 #pragma once
 
 #include "../BaseLib/Containers/List.h"
+#include "../BaseLib/Utility/Parallel.h"
 
 template<typename T> class	Octree
 {
 private:	// NESTED TYPES
 
+	static const U32	INVALID_INDEX = ~0U;
+
 	struct	Content
 	{
 		float3	Position;
@@ -16,8 +28,20 @@ private:	// NESTED TYPES
 		float	SqRadius;
 		float3	BBoxMin;
 		float3	BBoxMax;
+		U32		RefsCount;		// Amount of nodes referencing that content
 		T		Value;
 
+		void	Set( const float3& _Position, float _Radius, const T& _Value )
+		{
+			Position = _Position;
+			Radius = _Radius;
+			SqRadius = _Radius*_Radius;
+			BBoxMin = _Position - _Radius * float3::One;
+			BBoxMax = _Position + _Radius * float3::One;
+			RefsCount = 0;
+			Value = _Value;
+		}
+
 		bool	Contains( const float3& _Position ) const
 		{
 			float3	Center2Position = Position - _Position;
@@ -35,32 +59,66 @@ private:	// NESTED TYPES
 			_SqDistance = SqDistanceFromCenter;
 			return true;
 		}
-	};
 
-public:
+		// Returns the distance along the (normalized) ray where it enters the sphere (0 if the origin is inside the sphere), or -1 if the ray misses the sphere
+		float	Intersect( const float3& _Origin, const float3& _Direction ) const
+		{
+			float3	Origin2Center = Position - _Origin;
+			float	c = Origin2Center.LengthSq() - SqRadius;
+			if ( c <= 0.0f )
+				return 0.0f;
+			float	b = Origin2Center.x * _Direction.x + Origin2Center.y * _Direction.y + Origin2Center.z * _Direction.z;
+			float	Delta = b*b - c;
+			if ( b < 0.0f || Delta < 0.0f )
+				return -1.0f;
+
+			return b - sqrtf( Delta );
+		}
+	};
 
-	class	Node
+	struct	ContentRef
 	{
-	public:	// FIELDS
+		U32		ContentIndex;
+		U32		NextRef;		// Index of the next reference for the same node, INVALID_INDEX for the last one
+	};
 
-		Octree&			m_Owner;
-		Node*			m_pParent;
-		Node*			m_ppCells[8];
+	struct	Node
+	{
+		U32		pChildren[8];	// Indices of child nodes in the pool (INVALID_INDEX if the child doesn't exist), child index is X | (Y << 1) | (Z << 2)
+		U32		FirstRef;		// Index of the first content reference, INVALID_INDEX if the node doesn't contain anything
 
-		List<const Content*>	m_Content;
+		void	Reset()
+		{
+			for ( int i=0; i < 8; i++ )
+				pChildren[i] = INVALID_INDEX;
+			FirstRef = INVALID_INDEX;
+		}
+	};
 
-	public:	// METHODS
+	// Content being partitioned during Build(), bounds are copied along so partitioning only streams through the stack
+	struct	BuildItem
+	{
+		float3	BBoxMin;
+		float3	BBoxMax;
+		float	Radius;
+		U32		ContentIndex;
+	};
 
-		Node( Octree& _Owner, Node* _pParent );
-		~Node();
+	// Nodes and references of a sub-tree during Build()
+	struct	BuildContext
+	{
+		BaseLib::List<Node>			Nodes;
+		BaseLib::List<ContentRef>	Refs;
+		BaseLib::List<BuildItem>	Stack;		// Each node's contents are followed by the contents of its children while they're being built
+		U32							LevelsCount;
+	};
 
-		int			Append( const Content& _Content, const float3& _Min, float _Size, U32 _Level );
-		void		Fetch( const float3& _Position, List<T>& _Result, const float3& _Min, float _Size ) const;
-		const T*	FetchNearest( const float3& _Position, const float3& _Min, float _Size, float& _SqDistance ) const;
+	struct	BuildSubTreeJob;
 
-	private:
-		Node&		GetOrCreateChildNode( U32 _X, U32 _Y, U32 _Z );
-	};
+	// Query tests
+	struct	AABBQuery;
+	struct	FrustumQuery;
+	struct	RayQuery;
 
 private:	// FIELDS
 
@@ -68,18 +126,20 @@ private:	// FIELDS
 	float3			m_Max;
 	float			m_Size;
 	float			m_MinCellSize;
-	Node*			m_pROOT;
 
-	List<Content>	m_ContentPool;
+	BaseLib::List<Node>			m_Nodes;			// Root is always node 0
+	BaseLib::List<ContentRef>	m_ContentRefs;
+	BaseLib::List<Content>		m_ContentPool;
 
-#ifdef _DEBUG
-	U32				m_NodesCount;
 	U32				m_NodeLevelsCount;
-#endif
-
 
 public:		// PROPERTIES
 
+	U32				GetNodesCount() const			{ return m_Nodes.Count(); }
+	U32				GetNodeLevelsCount() const		{ return m_NodeLevelsCount; }
+	U32				GetContentsCount() const		{ return m_ContentPool.Count(); }
+	U32				GetContentRefsCount() const		{ return m_ContentRefs.Count(); }
+
 public:		// METHODS
 
 	Octree();
@@ -88,7 +148,8 @@ public:		// METHODS
 	// Initialize the root node of the octree with global scene diemensions
 	//	_MinCellSize, the minimum authorized cell size in the octree
 	//	_MaxElementsInOctree, if known, initializes the pool of values to the specified maximum. Leave to default if to be dynamically resized.
-	Node&		Init( const float3& _BoundMin, float _Size, float _MinCellSize, U32 _MaxElementsInOctree=0 );
+	// NOTE: Contents outside of the bounds are stored in the border cells so they are still found by the queries
+	void		Init( const float3& _BoundMin, float _Size, float _MinCellSize, U32 _MaxElementsInOctree=0 );
 
 	// Appends a value to the octree
 	//	_Position, the position of the sphere containing the value
@@ -97,14 +158,76 @@ public:		// METHODS
 	// Returns the amount of nodes the value was added to
 	int			Append( const float3& _Position, float _Radius, T _Value );
 
+	// Replaces the entire content of the octree by the provided array of spheres, building the tree top-down
+	// This is much faster than appending the values one by one as all the contents of a node are partitioned at once,
+	//	and the 8 sub-trees of the root are built in parallel
+	// NOTE: Init() must have been called first to setup the octree's bounds
+	void		Build( const float3* _pPositions, const float* _pRadii, const T* _pValues, U32 _Count );
+
 	// Fetches the values overlapping the provided position
 	//	_Position, the position to find overlapping values for
 	//	_Result, the list that will be populated with values overlapping the provided position
-	void		Fetch( const float3& _Position, List<T>& _Result ) const;
+	void		Fetch( const float3& _Position, BaseLib::List<T>& _Result ) const;
 
 	// Fetches the value closest to the provided position
 	//	_Distance, the distance to the retrieved value
 	const T*	FetchNearest( const float3& _Position, float& _Distance ) const;
+
+	// Fetches the values whose bounding box overlaps the provided box (each value is returned only once)
+	void		FetchInAABB( const float3& _Min, const float3& _Max, BaseLib::List<T>& _Result ) const;
+
+	// Fetches the values overlapping the provided frustum (each value is returned only once)
+	//	_pPlanes, the 6 frustum planes with their normals pointing inside the frustum (i.e. a point P is inside if dot( Plane.xyz, P ) + Plane.w >= 0)
+	void		FetchInFrustum( const float4 _pPlanes[6], BaseLib::List<T>& _Result ) const;
+
+	// Fetches the values intersected by the provided ray (each value is returned only once, in no particular order)
+	//	_Direction, the ray's direction (doesn't need to be normalized)
+	//	_MaxDistance, the maximum distance along the ray
+	void		FetchAlongRay( const float3& _Origin, const float3& _Direction, float _MaxDistance, BaseLib::List<T>& _Result ) const;
+
+	// Fetches the first value hit by the provided ray
+	//	_Direction, the ray's direction (doesn't need to be normalized)
+	//	_Distance, the distance along the ray to the hit value
+	const T*	FetchFirstHit( const float3& _Origin, const float3& _Direction, float& _Distance, float _MaxDistance=MAX_FLOAT ) const;
+
+private:
+	U32			GetOrCreateChildNode( U32 _NodeIndex, U32 _ChildIndex );
+	int			Append( U32 _NodeIndex, U32 _ContentIndex, const float3& _Min, float _Size, U32 _Level );
+
+	static void	BuildNode( const Octree& _Owner, BuildContext& _Context, U32 _NodeIndex, const float3& _Min, float _Size, U32 _Level, U32 _StackStart, U32 _StackCount, U32 _pChildStackStart[8], U32 _pChildStackCount[8] );
+	static void	BuildSubTree( const Octree& _Owner, BuildContext& _Context, U32 _NodeIndex, const float3& _Min, float _Size, U32 _Level, U32 _StackStart, U32 _StackCount );
+	void		CountContentRefs();
+
+	template<typename QUERY>
+	void		Query( const QUERY& _Query, U32 _NodeIndex, const float3& _Min, float _Size, U32 _BorderMask, bool _FullyInside, BaseLib::List<T>& _Result, BaseLib::List<U32>& _SharedContents ) const;
+	template<typename QUERY>
+	void		Query( const QUERY& _Query, BaseLib::List<T>& _Result ) const;
+
+	const T*	FetchNearest( U32 _NodeIndex, const float3& _Position, const float3& _Min, float _Size, U32 _BorderMask, float& _SqDistance ) const;
+	const T*	FetchFirstHit( U32 _NodeIndex, const RayQuery& _Ray, const float3& _Min, float _Size, U32 _BorderMask, float& _Distance ) const;
+
+	static float3	GetChildMin( const float3& _Min, float _HalfSize, U32 _ChildIndex )
+	{
+		return float3(	_ChildIndex & 1 ? _Min.x + _HalfSize : _Min.x,
+						_ChildIndex & 2 ? _Min.y + _HalfSize : _Min.y,
+						_ChildIndex & 4 ? _Min.z + _HalfSize : _Min.z );
+	}
+
+	// Contents outside of the octree's bounds are stored in the border cells, so border cells actually extend to infinity
+	//	on the sides that touch the octree's bounds. The border mask tells which sides of a cell are on the border: bits are -X, +X, -Y, +Y, -Z, +Z
+	static U32		GetChildBorderMask( U32 _BorderMask, U32 _ChildIndex )
+	{
+		return _BorderMask & ((_ChildIndex & 1 ? 0x02 : 0x01) | (_ChildIndex & 2 ? 0x08 : 0x04) | (_ChildIndex & 4 ? 0x20 : 0x10));
+	}
+	static void		GetCellBounds( const float3& _Min, float _Size, U32 _BorderMask, float3& _BoundMin, float3& _BoundMax )
+	{
+		_BoundMin.Set(	_BorderMask & 0x01 ? -MAX_FLOAT : _Min.x,
+						_BorderMask & 0x04 ? -MAX_FLOAT : _Min.y,
+						_BorderMask & 0x10 ? -MAX_FLOAT : _Min.z );
+		_BoundMax.Set(	_BorderMask & 0x02 ? MAX_FLOAT : _Min.x + _Size,
+						_BorderMask & 0x08 ? MAX_FLOAT : _Min.y + _Size,
+						_BorderMask & 0x20 ? MAX_FLOAT : _Min.z + _Size );
+	}
 };
 
-#include "Octree.inl"
\ No newline at end of file
+#include "Octree.inl"
@@ -1,214 +1,735 @@
-template<typename T> Octree<T>::Octree()
-	: m_pROOT( NULL )
+//////////////////////////////////////////////////////////////////////////
+// Query tests
+//	TestCell() returns 0 if the cell is outside the query, 1 if it intersects the query and 2 if it's entirely inside the query
+//	Test() returns true if the content overlaps the query
+//
+template<typename T> struct	Octree<T>::AABBQuery
 {
-}
+	float3	Min;
+	float3	Max;
 
-template<typename T> Octree<T>::~Octree()
+	int		TestCell( const float3& _Min, const float3& _Max ) const
+	{
+		if (	_Max.x < Min.x || _Min.x > Max.x
+			||	_Max.y < Min.y || _Min.y > Max.y
+			||	_Max.z < Min.z || _Min.z > Max.z )
+			return 0;
+
+		return		_Min.x >= Min.x && _Max.x <= Max.x
+				&&	_Min.y >= Min.y && _Max.y <= Max.y
+				&&	_Min.z >= Min.z && _Max.z <= Max.z ? 2 : 1;
+	}
+
+	bool	Test( const Content& _Content ) const
+	{
+		return	_Content.BBoxMax.x >= Min.x && _Content.BBoxMin.x <= Max.x
+			&&	_Content.BBoxMax.y >= Min.y && _Content.BBoxMin.y <= Max.y
+			&&	_Content.BBoxMax.z >= Min.z && _Content.BBoxMin.z <= Max.z;
+	}
+};
+
+template<typename T> struct	Octree<T>::FrustumQuery
 {
-	delete m_pROOT;
-}
+	float4	pPlanes[6];
+	float	pNormalLengths[6];
+
+	int		TestCell( const float3& _Min, const float3& _Max ) const
+	{
+		int	Result = 2;
+		for ( int PlaneIndex=0; PlaneIndex < 6; PlaneIndex++ )
+		{
+			const float4&	Plane = pPlanes[PlaneIndex];
+
+			// The "positive vertex" is the box corner furthest along the plane's normal, if it's outside then the entire box is outside
+			float	PositiveDistance = Plane.x * (Plane.x >= 0.0f ? _Max.x : _Min.x)
+									 + Plane.y * (Plane.y >= 0.0f ? _Max.y : _Min.y)
+									 + Plane.z * (Plane.z >= 0.0f ? _Max.z : _Min.z)
+									 + Plane.w;
+			if ( PositiveDistance < 0.0f )
+				return 0;
+
+			// The "negative vertex" is the opposite corner, if it's inside then the entire box is inside that plane
+			float	NegativeDistance = Plane.x * (Plane.x >= 0.0f ? _Min.x : _Max.x)
+									 + Plane.y * (Plane.y >= 0.0f ? _Min.y : _Max.y)
+									 + Plane.z * (Plane.z >= 0.0f ? _Min.z : _Max.z)
+									 + Plane.w;
+			if ( NegativeDistance < 0.0f )
+				Result = 1;
+		}
 
-template<typename T> typename Octree<T>::Node&	Octree<T>::Init( const float3& _BoundMin, float _Size, float _MinCellSize, U32 _MaxElementsInOctree )
+		return Result;
+	}
+
+	bool	Test( const Content& _Content ) const
+	{
+		for ( int PlaneIndex=0; PlaneIndex < 6; PlaneIndex++ )
+		{
+			const float4&	Plane = pPlanes[PlaneIndex];
+			float	Distance = _Content.Position.x * Plane.x + _Content.Position.y * Plane.y + _Content.Position.z * Plane.z + Plane.w;
+			if ( Distance < -_Content.Radius * pNormalLengths[PlaneIndex] )
+				return false;
+		}
+		return true;
+	}
+};
+
+template<typename T> struct	Octree<T>::RayQuery
 {
-	delete m_pROOT;
+	float3	Origin;
+	float3	Direction;		// Normalized
+	float3	InvDirection;
+	float	MaxDistance;
 
-	m_Min = _BoundMin;
-	m_Size = _Size;
-	m_Max = _BoundMin + _Size * float3::One;
-	m_MinCellSize = _MinCellSize;
+	void	Init( const float3& _Origin, const float3& _Direction, float _MaxDistance )
+	{
+		float	Length = _Direction.Length();
+		Origin = _Origin;
+		Direction = _Direction * (1.0f / Length);
+		MaxDistance = _MaxDistance;
 
-	m_pROOT = new Node( *this, NULL );
+		// Use a large value instead of infinity for axis-aligned rays so we never multiply 0 by infinity in the slab test
+		InvDirection.x = fabs( Direction.x ) > 1e-20f ? 1.0f / Direction.x : (Direction.x >= 0.0f ? 1e20f : -1e20f);
+		InvDirection.y = fabs( Direction.y ) > 1e-20f ? 1.0f / Direction.y : (Direction.y >= 0.0f ? 1e20f : -1e20f);
+		InvDirection.z = fabs( Direction.z ) > 1e-20f ? 1.0f / Direction.z : (Direction.z >= 0.0f ? 1e20f : -1e20f);
+	}
 
-	if ( _MaxElementsInOctree > 0 )
-		m_ContentPool.Init( _MaxElementsInOctree );
+	// Slab test, returns the distance where the ray enters the box (clamped to 0) or -1 if it misses the box
+	float	IntersectCell( const float3& _Min, const float3& _Max, float _MaxDistance ) const
+	{
+		float	t0x = (_Min.x - Origin.x) * InvDirection.x;
+		float	t1x = (_Max.x - Origin.x) * InvDirection.x;
+		float	t0y = (_Min.y - Origin.y) * InvDirection.y;
+		float	t1y = (_Max.y - Origin.y) * InvDirection.y;
+		float	t0z = (_Min.z - Origin.z) * InvDirection.z;
+		float	t1z = (_Max.z - Origin.z) * InvDirection.z;
+		float	tEnter = MAX( MAX( MIN( t0x, t1x ), MIN( t0y, t1y ) ), MAX( MIN( t0z, t1z ), 0.0f ) );
+		float	tExit = MIN( MIN( MAX( t0x, t1x ), MAX( t0y, t1y ) ), MIN( MAX( t0z, t1z ), _MaxDistance ) );
+		return tEnter <= tExit ? tEnter : -1.0f;
+	}
 
-#ifdef _DEBUG
-	m_NodesCount = 1;
-	m_NodeLevelsCount = 1;
-#endif
+	int		TestCell( const float3& _Min, const float3& _Max ) const
+	{
+		return IntersectCell( _Min, _Max, MaxDistance ) >= 0.0f ? 1 : 0;
+	}
+
+	bool	Test( const Content& _Content ) const
+	{
+		float	Distance = _Content.Intersect( Origin, Direction );
+		return Distance >= 0.0f && Distance <= MaxDistance;
+	}
+};
 
-	return *m_pROOT;
+//////////////////////////////////////////////////////////////////////////
+// Parallel sub-tree build
+//
+
+// Sets the count of a list used as a stack, growing its storage geometrically so pushes don't reallocate every time
+template<typename U> static void	SetStackCount( BaseLib::List<U>& _List, U32 _Count )
+{
+	if ( _Count > _List.GetAllocatedSize() )
+		_List.Reserve( MAX( _Count, 2 * _List.GetAllocatedSize() ) );
+	_List.SetCount( _Count );
 }
 
-template<typename T> int	Octree<T>::Append( const float3& _Position, float _Radius, T _Value )
+template<typename T> struct	Octree<T>::BuildSubTreeJob
 {
-	Content&	NewContent = m_ContentPool.Append();
-	NewContent.Position = _Position;
-	NewContent.Radius = _Radius;
-	NewContent.SqRadius = _Radius*_Radius;
-	NewContent.BBoxMin = _Position - _Radius * float3::One;
-	NewContent.BBoxMax = _Position + _Radius * float3::One;
-	NewContent.Value = _Value;
+	const Octree*	pOwner;
+	BuildContext*	pContexts;		// 1 context per child of the root
+	float3			RootMin;
+	float			HalfSize;
 
-	return m_pROOT->Append( NewContent, m_Min, m_Size, 0 );
-}
+	void	operator()( U32 _ChildIndex )
+	{
+		BuildContext&	Context = pContexts[_ChildIndex];
+		if ( Context.Stack.Count() == 0 )
+			return;
+
+		Context.Nodes.Append().Reset();
+		BuildSubTree( *pOwner, Context, 0, GetChildMin( RootMin, HalfSize, _ChildIndex ), HalfSize, 1, 0, Context.Stack.Count() );
+	}
+};
 
-template<typename T> void	Octree<T>::Fetch( const float3& _Position, List<T>& _Result ) const
+//////////////////////////////////////////////////////////////////////////
+//
+template<typename T> Octree<T>::Octree()
+	: m_Size( 0.0f )
+	, m_MinCellSize( 0.0f )
+	, m_NodeLevelsCount( 0 )
 {
-	m_pROOT->Fetch( _Position, _Result, m_Min, m_Size );
 }
 
-template<typename T> const T*	Octree<T>::FetchNearest( const float3& _Position, float& _Distance ) const
+template<typename T> Octree<T>::~Octree()
 {
-	float		SqDistance = MAX_FLOAT;
-	const T*	pResult = m_pROOT->FetchNearest( _Position, m_Min, m_Size, SqDistance );
-	if ( pResult == NULL )
-		return NULL;
-
-	_Distance = sqrtf( SqDistance );
-	return pResult;
 }
 
-template<typename T> Octree<T>::Node::Node( Octree& _Owner, Node* _pParent )
-	: m_Owner( _Owner )
-	, m_pParent( _pParent )
+template<typename T> void	Octree<T>::Init( const float3& _BoundMin, float _Size, float _MinCellSize, U32 _MaxElementsInOctree )
 {
-	for ( int i=0; i < 8; i++ )
-		m_ppCells[i] = NULL;
+	m_Min = _BoundMin;
+	m_Size = _Size;
+	m_Max = _BoundMin + _Size * float3::One;
+	m_MinCellSize = _MinCellSize;
+
+	m_ContentPool.Clear();
+	m_ContentRefs.Clear();
+	m_Nodes.Clear();
+	m_Nodes.Append().Reset();
+	m_NodeLevelsCount = 1;
+
+	if ( _MaxElementsInOctree > 0 )
+	{
+		m_ContentPool.Reserve( _MaxElementsInOctree );
+		m_ContentRefs.Reserve( _MaxElementsInOctree );
+	}
 }
 
-template<typename T> Octree<T>::Node::~Node()
+template<typename T> int	Octree<T>::Append( const float3& _Position, float _Radius, T _Value )
 {
-	for ( int i=0; i < 8; i++ )
-		delete m_ppCells[i];
+	ASSERT( m_Nodes.Count() > 0, "Octree is not initialized!" );
+
+	U32	ContentIndex = m_ContentPool.Count();
+	m_ContentPool.Append().Set( _Position, _Radius, _Value );
+
+	return Append( 0, ContentIndex, m_Min, m_Size, 0 );
 }
 
-template<typename T> int	Octree<T>::Node::Append( const Content& _Content, const float3& _Min, float _Size, U32 _Level )
+template<typename T> int	Octree<T>::Append( U32 _NodeIndex, U32 _ContentIndex, const float3& _Min, float _Size, U32 _Level )
 {
-#ifdef _DEBUG
-	m_Owner.m_NodeLevelsCount = MAX( m_Owner.m_NodeLevelsCount, _Level+1 );
-#endif
+	m_NodeLevelsCount = MAX( m_NodeLevelsCount, _Level+1 );
+
+	Content&	C = m_ContentPool[_ContentIndex];
 
 	float	HalfSize = 0.5f * _Size;
-	if (	_Content.Radius >= HalfSize			// Either the content is big enough for that cell
-		||	HalfSize <= m_Owner.m_MinCellSize )	// Or we reached the smallest possible cell size
+	if (	C.Radius >= HalfSize			// Either the content is big enough for that cell
+		||	HalfSize <= m_MinCellSize )		// Or we reached the smallest possible cell size
 	{	// Store in that node and don't go any further...
-		const Content*	PHUCK = &_Content;
-		m_Content.Append( PHUCK );
+		U32			RefIndex = m_ContentRefs.Count();
+		ContentRef&	Ref = m_ContentRefs.Append();
+		Ref.ContentIndex = _ContentIndex;
+		Ref.NextRef = m_Nodes[_NodeIndex].FirstRef;
+		m_Nodes[_NodeIndex].FirstRef = RefIndex;
+		C.RefsCount++;
 		return 1;
 	}
 
 	// Append content to child nodes overlapped by content
 	float3	CellCenter = _Min + HalfSize * float3::One;
-	U32		XStart = _Content.BBoxMin.x < CellCenter.x ? 0 : 1;
-	U32		XEnd = _Content.BBoxMax.x < CellCenter.x ? 1 : 2;
-	U32		YStart = _Content.BBoxMin.y < CellCenter.y ? 0 : 1;
-	U32		YEnd = _Content.BBoxMax.y < CellCenter.y ? 1 : 2;
-	U32		ZStart = _Content.BBoxMin.z < CellCenter.z ? 0 : 1;
-	U32		ZEnd = _Content.BBoxMax.z < CellCenter.z ? 1 : 2;
+	U32		XStart = C.BBoxMin.x < CellCenter.x ? 0 : 1;
+	U32		XEnd = C.BBoxMax.x < CellCenter.x ? 1 : 2;
+	U32		YStart = C.BBoxMin.y < CellCenter.y ? 0 : 1;
+	U32		YEnd = C.BBoxMax.y < CellCenter.y ? 1 : 2;
+	U32		ZStart = C.BBoxMin.z < CellCenter.z ? 0 : 1;
+	U32		ZEnd = C.BBoxMax.z < CellCenter.z ? 1 : 2;
 	ASSERT( XEnd > XStart, "Invalid cell span on X!" );
 	ASSERT( YEnd > YStart, "Invalid cell span on Y!" );
 	ASSERT( ZEnd > ZStart, "Invalid cell span on Z!" );
 
 	int		NodesCount = 0;
-	float3	CellMin;
-	CellMin.z = _Min.z;
-	for ( U32 Z=ZStart; Z < ZEnd; Z++, CellMin.z=CellCenter.z )
-	{
-		CellMin.y = _Min.y;
-		for ( U32 Y=YStart; Y < YEnd; Y++, CellMin.y=CellCenter.y )
-		{
-			CellMin.x = _Min.x;
-			for ( U32 X=XStart; X < XEnd; X++, CellMin.x=CellCenter.x )
+	for ( U32 Z=ZStart; Z < ZEnd; Z++ )
+		for ( U32 Y=YStart; Y < YEnd; Y++ )
+			for ( U32 X=XStart; X < XEnd; X++ )
 			{
-				NodesCount += GetOrCreateChildNode( X, Y, Z ).Append( _Content, CellMin, HalfSize, _Level+1 );
+				U32	ChildIndex = X | (Y << 1) | (Z << 2);
+				U32	ChildNodeIndex = GetOrCreateChildNode( _NodeIndex, ChildIndex );
+				NodesCount += Append( ChildNodeIndex, _ContentIndex, GetChildMin( _Min, HalfSize, ChildIndex ), HalfSize, _Level+1 );
 			}
-		}
-	}
 
 	return NodesCount;
 }
 
-template<typename T> void	Octree<T>::Node::Fetch( const float3& _Position, List<T>& _Result, const float3& _Min, float _Size ) const
+template<typename T> U32	Octree<T>::GetOrCreateChildNode( U32 _NodeIndex, U32 _ChildIndex )
 {
-	// Collect this node's values
-	int	ContentsCount = m_Content.GetCount();
-	for ( int ContentIndex=0; ContentIndex < ContentsCount; ContentIndex++ )
+	U32	ChildNodeIndex = m_Nodes[_NodeIndex].pChildren[_ChildIndex];
+	if ( ChildNodeIndex == INVALID_INDEX )
 	{
-		Content&	C = *m_Content[ContentIndex];
-		if ( C.Contains( _Position ) )
-			_Result.Append( C.Value );
+		ChildNodeIndex = m_Nodes.Count();
+		m_Nodes.Append().Reset();	// WARNING: May relocate the nodes
+		m_Nodes[_NodeIndex].pChildren[_ChildIndex] = ChildNodeIndex;
 	}
 
-	// Collect child nodes' values
+	return ChildNodeIndex;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Bulk build
+//
+template<typename T> void	Octree<T>::Build( const float3* _pPositions, const float* _pRadii, const T* _pValues, U32 _Count )
+{
+	ASSERT( m_Size > 0.0f, "Octree is not initialized!" );
+
+	m_ContentPool.Clear();
+	m_ContentPool.SetCount( _Count );
+	for ( U32 ContentIndex=0; ContentIndex < _Count; ContentIndex++ )
+		m_ContentPool[ContentIndex].Set( _pPositions[ContentIndex], _pRadii[ContentIndex], _pValues[ContentIndex] );
+
+	// Split the root's contents into its 8 children
+	BuildContext	RootContext;
+	RootContext.LevelsCount = 1;
+	RootContext.Nodes.Append().Reset();
+	RootContext.Stack.SetCount( _Count );
+	for ( U32 ContentIndex=0; ContentIndex < _Count; ContentIndex++ )
+	{
+		const Content&	C = m_ContentPool[ContentIndex];
+		BuildItem&		Item = RootContext.Stack[ContentIndex];
+		Item.BBoxMin = C.BBoxMin;
+		Item.BBoxMax = C.BBoxMax;
+		Item.Radius = C.Radius;
+		Item.ContentIndex = ContentIndex;
+	}
+
+	if ( _Count < 4096 || BaseLib::GetHardwareThreadsCount() < 2 )
+	{	// Not worth going parallel: build the entire tree in place
+		BuildSubTree( *this, RootContext, 0, m_Min, m_Size, 0, 0, _Count );
+		m_Nodes = BaseLib::Move( RootContext.Nodes );
+		m_ContentRefs = BaseLib::Move( RootContext.Refs );
+		m_NodeLevelsCount = RootContext.LevelsCount;
+		CountContentRefs();
+		return;
+	}
+
+	U32	pChildStackStart[8];
+	U32	pChildStackCount[8];
+	BuildNode( *this, RootContext, 0, m_Min, m_Size, 0, 0, _Count, pChildStackStart, pChildStackCount );
+
+	// Build the 8 sub-trees independently
+	BuildContext	pContexts[8];
+	for ( U32 ChildIndex=0; ChildIndex < 8; ChildIndex++ )
+	{
+		pContexts[ChildIndex].LevelsCount = 0;
+		pContexts[ChildIndex].Stack.Append( RootContext.Stack.Ptr() + pChildStackStart[ChildIndex], pChildStackCount[ChildIndex] );
+	}
+	RootContext.Stack.Clear();
+
+	BuildSubTreeJob	Job;
+	Job.pOwner = this;
+	Job.pContexts = pContexts;
+	Job.RootMin = m_Min;
+	Job.HalfSize = 0.5f * m_Size;
+	BaseLib::ParallelFor( 8, Job );
+
+	// Concatenate the sub-trees after the root, offsetting their indices
+	U32	NodesCount = 1;
+	U32	RefsCount = RootContext.Refs.Count();
+	for ( U32 ChildIndex=0; ChildIndex < 8; ChildIndex++ )
+	{
+		NodesCount += pContexts[ChildIndex].Nodes.Count();
+		RefsCount += pContexts[ChildIndex].Refs.Count();
+	}
+
+	m_Nodes.Clear();
+	m_Nodes.Reserve( NodesCount );
+	m_ContentRefs.Clear();
+	m_ContentRefs.Reserve( RefsCount );
+	m_Nodes.Append( RootContext.Nodes[0] );
+	m_ContentRefs.Append( RootContext.Refs.Ptr(), RootContext.Refs.Count() );
+	m_NodeLevelsCount = 1;
+
+	for ( U32 ChildIndex=0; ChildIndex < 8; ChildIndex++ )
+	{
+		const BuildContext&	Context = pContexts[ChildIndex];
+		if ( Context.Nodes.Count() == 0 )
+			continue;
+
+		U32	NodeOffset = m_Nodes.Count();
+		U32	RefOffset = m_ContentRefs.Count();
+		m_Nodes[0].pChildren[ChildIndex] = NodeOffset;
+		m_NodeLevelsCount = MAX( m_NodeLevelsCount, Context.LevelsCount );
+
+		m_Nodes.Append( Context.Nodes.Ptr(), Context.Nodes.Count() );
+		Node*	pNodes = m_Nodes.Ptr() + NodeOffset;
+		for ( U32 NodeIndex=0; NodeIndex < Context.Nodes.Count(); NodeIndex++ )
+		{
+			Node&	N = pNodes[NodeIndex];
+			for ( int i=0; i < 8; i++ )
+				if ( N.pChildren[i] != INVALID_INDEX )
+					N.pChildren[i] += NodeOffset;
+			if ( N.FirstRef != INVALID_INDEX )
+				N.FirstRef += RefOffset;
+		}
+
+		m_ContentRefs.Append( Context.Refs.Ptr(), Context.Refs.Count() );
+		ContentRef*	pRefs = m_ContentRefs.Ptr() + RefOffset;
+		for ( U32 RefIndex=0; RefIndex < Context.Refs.Count(); RefIndex++ )
+			if ( pRefs[RefIndex].NextRef != INVALID_INDEX )
+				pRefs[RefIndex].NextRef += RefOffset;
+	}
+
+	CountContentRefs();
+}
+
+// Counts references per content (done once all threads are finished since a content can be shared by several sub-trees)
+template<typename T> void	Octree<T>::CountContentRefs()
+{
+	for ( U32 RefIndex=0; RefIndex < m_ContentRefs.Count(); RefIndex++ )
+		m_ContentPool[m_ContentRefs[RefIndex].ContentIndex].RefsCount++;
+}
+
+// Stores the contents that must stay in the node and pushes the contents of each child on the stack
+// The contents of child i are then found at [_pChildStackStart[i], _pChildStackStart[i] + _pChildStackCount[i]) in the stack
+template<typename T> void	Octree<T>::BuildNode( const Octree& _Owner, BuildContext& _Context, U32 _NodeIndex, const float3& _Min, float _Size, U32 _Level, U32 _StackStart, U32 _StackCount, U32 _pChildStackStart[8], U32 _pChildStackCount[8] )
+{
+	_Context.LevelsCount = MAX( _Context.LevelsCount, _Level+1 );
+
 	float	HalfSize = 0.5f * _Size;
+	bool	IsLeaf = HalfSize <= _Owner.m_MinCellSize;
 	float3	CellCenter = _Min + HalfSize * float3::One;
 
-	U32		ChildIndex = 0;
-	float3	CellMin = _Min;
-	if ( _Position.x >= CellCenter.x )
+	// Count contents per child
+	U32	pCounts[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	U32	StoredCount = 0;
+	for ( U32 i=0; i < _StackCount; i++ )
+	{
+		const BuildItem&	C = _Context.Stack[_StackStart+i];
+		if ( IsLeaf || C.Radius >= HalfSize )
+		{
+			StoredCount++;
+			continue;
+		}
+
+		U32	XStart = C.BBoxMin.x < CellCenter.x ? 0 : 1;
+		U32	XEnd = C.BBoxMax.x < CellCenter.x ? 1 : 2;
+		U32	YStart = C.BBoxMin.y < CellCenter.y ? 0 : 1;
+		U32	YEnd = C.BBoxMax.y < CellCenter.y ? 1 : 2;
+		U32	ZStart = C.BBoxMin.z < CellCenter.z ? 0 : 1;
+		U32	ZEnd = C.BBoxMax.z < CellCenter.z ? 1 : 2;
+		for ( U32 Z=ZStart; Z < ZEnd; Z++ )
+			for ( U32 Y=YStart; Y < YEnd; Y++ )
+				for ( U32 X=XStart; X < XEnd; X++ )
+					pCounts[X | (Y << 1) | (Z << 2)]++;
+	}
+
+	// Allocate the children's ranges at the top of the stack
+	U32	TotalCount = _Context.Stack.Count();
+	for ( U32 ChildIndex=0; ChildIndex < 8; ChildIndex++ )
+	{
+		_pChildStackStart[ChildIndex] = TotalCount;
+		_pChildStackCount[ChildIndex] = 0;
+		TotalCount += pCounts[ChildIndex];
+	}
+	SetStackCount( _Context.Stack, TotalCount );	// WARNING: May relocate the stack
+
+	// Store the node's references contiguously
+	U32	RefIndex = _Context.Refs.Count();
+	if ( StoredCount > 0 )
 	{
-		ChildIndex = 1;
-		CellMin.x = CellCenter.x;
+		SetStackCount( _Context.Refs, RefIndex + StoredCount );
+		_Context.Nodes[_NodeIndex].FirstRef = RefIndex;
 	}
-	if ( _Position.y >= CellCenter.y )
+
+	// Dispatch contents
+	BuildItem*	pStack = _Context.Stack.Ptr();
+	for ( U32 i=0; i < _StackCount; i++ )
 	{
-		ChildIndex |= 2;
-		CellMin.y = CellCenter.y;
+		const BuildItem&	C = pStack[_StackStart+i];
+		if ( IsLeaf || C.Radius >= HalfSize )
+		{
+			ContentRef&	Ref = _Context.Refs[RefIndex];
+			Ref.ContentIndex = C.ContentIndex;
+			Ref.NextRef = --StoredCount > 0 ? RefIndex+1 : INVALID_INDEX;
+			RefIndex++;
+			continue;
+		}
+
+		U32	XStart = C.BBoxMin.x < CellCenter.x ? 0 : 1;
+		U32	XEnd = C.BBoxMax.x < CellCenter.x ? 1 : 2;
+		U32	YStart = C.BBoxMin.y < CellCenter.y ? 0 : 1;
+		U32	YEnd = C.BBoxMax.y < CellCenter.y ? 1 : 2;
+		U32	ZStart = C.BBoxMin.z < CellCenter.z ? 0 : 1;
+		U32	ZEnd = C.BBoxMax.z < CellCenter.z ? 1 : 2;
+		for ( U32 Z=ZStart; Z < ZEnd; Z++ )
+			for ( U32 Y=YStart; Y < YEnd; Y++ )
+				for ( U32 X=XStart; X < XEnd; X++ )
+				{
+					U32	ChildIndex = X | (Y << 1) | (Z << 2);
+					pStack[_pChildStackStart[ChildIndex] + _pChildStackCount[ChildIndex]++] = C;
+				}
+	}
+}
+
+template<typename T> void	Octree<T>::BuildSubTree( const Octree& _Owner, BuildContext& _Context, U32 _NodeIndex, const float3& _Min, float _Size, U32 _Level, U32 _StackStart, U32 _StackCount )
+{
+	float3	Min = _Min;
+	if ( _StackCount == 1 )
+	{	// Fast path for a single content (very common in the deepest levels): walk down the chain of nodes as long as it fits in a single child
+		const BuildItem	C = _Context.Stack[_StackStart];
+		while ( true )
+		{
+			float	HalfSize = 0.5f * _Size;
+			if ( C.Radius >= HalfSize || HalfSize <= _Owner.m_MinCellSize )
+				break;	// Let BuildNode() store it
+
+			float3	CellCenter = Min + HalfSize * float3::One;
+			U32		X = C.BBoxMin.x < CellCenter.x ? 0 : 1;
+			U32		Y = C.BBoxMin.y < CellCenter.y ? 0 : 1;
+			U32		Z = C.BBoxMin.z < CellCenter.z ? 0 : 1;
+			if (	(C.BBoxMax.x < CellCenter.x ? 0U : 1U) != X
+				||	(C.BBoxMax.y < CellCenter.y ? 0U : 1U) != Y
+				||	(C.BBoxMax.z < CellCenter.z ? 0U : 1U) != Z )
+				break;	// Straddles several children
+
+			U32	ChildIndex = X | (Y << 1) | (Z << 2);
+			U32	ChildNodeIndex = _Context.Nodes.Count();
+			_Context.Nodes.Append().Reset();	// WARNING: May relocate the nodes
+			_Context.Nodes[_NodeIndex].pChildren[ChildIndex] = ChildNodeIndex;
+
+			_NodeIndex = ChildNodeIndex;
+			Min = GetChildMin( Min, HalfSize, ChildIndex );
+			_Size = HalfSize;
+			_Level++;
+		}
 	}
-	if ( _Position.z >= CellCenter.z )
+
+	U32	StackTop = _Context.Stack.Count();
+
+	U32	pChildStackStart[8];
+	U32	pChildStackCount[8];
+	BuildNode( _Owner, _Context, _NodeIndex, Min, _Size, _Level, _StackStart, _StackCount, pChildStackStart, pChildStackCount );
+
+	float	HalfSize = 0.5f * _Size;
+	for ( U32 ChildIndex=0; ChildIndex < 8; ChildIndex++ )
 	{
-		ChildIndex |= 4;
-		CellMin.z = CellCenter.z;
+		if ( pChildStackCount[ChildIndex] == 0 )
+			continue;
+
+		U32	ChildNodeIndex = _Context.Nodes.Count();
+		_Context.Nodes.Append().Reset();	// WARNING: May relocate the nodes
+		_Context.Nodes[_NodeIndex].pChildren[ChildIndex] = ChildNodeIndex;
+
+		BuildSubTree( _Owner, _Context, ChildNodeIndex, GetChildMin( Min, HalfSize, ChildIndex ), HalfSize, _Level+1, pChildStackStart[ChildIndex], pChildStackCount[ChildIndex] );
 	}
 
-	Node*	pChild = m_ppCells[ChildIndex];
-	if ( pChild != NULL )
-		pChild->Fetch( _Position, _Result, CellMin, HalfSize );
+	// Pop the children's contents
+	_Context.Stack.SetCount( StackTop );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Queries
+//
+template<typename T> void	Octree<T>::Fetch( const float3& _Position, BaseLib::List<T>& _Result ) const
+{
+	float3	CellMin = m_Min;
+	float	Size = m_Size;
+	U32		NodeIndex = 0;
+	while ( NodeIndex != INVALID_INDEX )
+	{
+		// Collect this node's values
+		const Node&	N = m_Nodes[NodeIndex];
+		for ( U32 RefIndex=N.FirstRef; RefIndex != INVALID_INDEX; RefIndex=m_ContentRefs[RefIndex].NextRef )
+		{
+			const Content&	C = m_ContentPool[m_ContentRefs[RefIndex].ContentIndex];
+			if ( C.Contains( _Position ) )
+				_Result.Append( C.Value );
+		}
+
+		// Walk down to the child containing the position
+		float	HalfSize = 0.5f * Size;
+		float3	CellCenter = CellMin + HalfSize * float3::One;
+		U32		ChildIndex = (_Position.x >= CellCenter.x ? 1 : 0) | (_Position.y >= CellCenter.y ? 2 : 0) | (_Position.z >= CellCenter.z ? 4 : 0);
+		CellMin = GetChildMin( CellMin, HalfSize, ChildIndex );
+		Size = HalfSize;
+		NodeIndex = N.pChildren[ChildIndex];
+	}
 }
 
-template<typename T> const T*	Octree<T>::Node::FetchNearest( const float3& _Position, const float3& _Min, float _Size, float& _SqDistance ) const
+template<typename T> const T*	Octree<T>::FetchNearest( const float3& _Position, float& _Distance ) const
+{
+	if ( m_Nodes.Count() == 0 )
+		return NULL;
+
+	float		SqDistance = MAX_FLOAT;
+	const T*	pResult = FetchNearest( 0, _Position, m_Min, m_Size, 0x3F, SqDistance );
+	if ( pResult == NULL )
+		return NULL;
+
+	_Distance = sqrtf( SqDistance );
+	return pResult;
+}
+
+template<typename T> const T*	Octree<T>::FetchNearest( U32 _NodeIndex, const float3& _Position, const float3& _Min, float _Size, U32 _BorderMask, float& _SqDistance ) const
 {
 	// Search this node's values
+	const Node&	N = m_Nodes[_NodeIndex];
 	const T*	pResult = NULL;
-	int	ContentsCount = m_Content.GetCount();
-	for ( int ContentIndex=0; ContentIndex < ContentsCount; ContentIndex++ )
+	for ( U32 RefIndex=N.FirstRef; RefIndex != INVALID_INDEX; RefIndex=m_ContentRefs[RefIndex].NextRef )
 	{
-		const Content&	C = *m_Content[ContentIndex];
+		const Content&	C = m_ContentPool[m_ContentRefs[RefIndex].ContentIndex];
 		if ( C.IsCloser( _Position, _SqDistance ) )
 			pResult = &C.Value;
 	}
 
-	// Search child nodes' values
+	// Search child nodes' values, starting with the child containing the position
 	float	HalfSize = 0.5f * _Size;
 	float3	CellCenter = _Min + HalfSize * float3::One;
+	U32		NearestChildIndex = (_Position.x >= CellCenter.x ? 1 : 0) | (_Position.y >= CellCenter.y ? 2 : 0) | (_Position.z >= CellCenter.z ? 4 : 0);
+	for ( U32 i=0; i < 8; i++ )
+	{
+		U32	ChildIndex = NearestChildIndex ^ i;
+		U32	ChildNodeIndex = N.pChildren[ChildIndex];
+		if ( ChildNodeIndex == INVALID_INDEX )
+			continue;
+
+		// Skip children that can't contain anything closer
+		float3	ChildMin = GetChildMin( _Min, HalfSize, ChildIndex );
+		U32		ChildBorderMask = GetChildBorderMask( _BorderMask, ChildIndex );
+		float3	BoundMin, BoundMax;
+		GetCellBounds( ChildMin, HalfSize, ChildBorderMask, BoundMin, BoundMax );
+		float3	Delta(	MAX( MAX( BoundMin.x - _Position.x, _Position.x - BoundMax.x ), 0.0f ),
+						MAX( MAX( BoundMin.y - _Position.y, _Position.y - BoundMax.y ), 0.0f ),
+						MAX( MAX( BoundMin.z - _Position.z, _Position.z - BoundMax.z ), 0.0f ) );
+		if ( Delta.LengthSq() >= _SqDistance )
+			continue;
 
-	U32		ChildIndex = 0;
-	float3	CellMin = _Min;
-	if ( _Position.x >= CellCenter.x )
+		const T*	pResultChild = FetchNearest( ChildNodeIndex, _Position, ChildMin, HalfSize, ChildBorderMask, _SqDistance );
+		if ( pResultChild != NULL )
+			pResult = pResultChild;
+	}
+
+	return pResult;
+}
+
+template<typename T> void	Octree<T>::FetchInAABB( const float3& _Min, const float3& _Max, BaseLib::List<T>& _Result ) const
+{
+	AABBQuery	Q;
+	Q.Min = _Min;
+	Q.Max = _Max;
+	Query( Q, _Result );
+}
+
+template<typename T> void	Octree<T>::FetchInFrustum( const float4 _pPlanes[6], BaseLib::List<T>& _Result ) const
+{
+	FrustumQuery	Q;
+	for ( int PlaneIndex=0; PlaneIndex < 6; PlaneIndex++ )
 	{
-		ChildIndex = 1;
-		CellMin.x = CellCenter.x;
+		const float4&	Plane = _pPlanes[PlaneIndex];
+		Q.pPlanes[PlaneIndex] = Plane;
+		Q.pNormalLengths[PlaneIndex] = sqrtf( Plane.x*Plane.x + Plane.y*Plane.y + Plane.z*Plane.z );
 	}
-	if ( _Position.y >= CellCenter.y )
+	Query( Q, _Result );
+}
+
+template<typename T> void	Octree<T>::FetchAlongRay( const float3& _Origin, const float3& _Direction, float _MaxDistance, BaseLib::List<T>& _Result ) const
+{
+	RayQuery	Q;
+	Q.Init( _Origin, _Direction, _MaxDistance );
+	Query( Q, _Result );
+}
+
+template<typename T> const T*	Octree<T>::FetchFirstHit( const float3& _Origin, const float3& _Direction, float& _Distance, float _MaxDistance ) const
+{
+	if ( m_Nodes.Count() == 0 )
+		return NULL;
+
+	RayQuery	Q;
+	Q.Init( _Origin, _Direction, _MaxDistance );
+
+	float		Distance = _MaxDistance;
+	const T*	pResult = FetchFirstHit( 0, Q, m_Min, m_Size, 0x3F, Distance );
+	if ( pResult != NULL )
+		_Distance = Distance;
+
+	return pResult;
+}
+
+template<typename T> const T*	Octree<T>::FetchFirstHit( U32 _NodeIndex, const RayQuery& _Ray, const float3& _Min, float _Size, U32 _BorderMask, float& _Distance ) const
+{
+	// Test this node's values
+	const Node&	N = m_Nodes[_NodeIndex];
+	const T*	pResult = NULL;
+	for ( U32 RefIndex=N.FirstRef; RefIndex != INVALID_INDEX; RefIndex=m_ContentRefs[RefIndex].NextRef )
 	{
-		ChildIndex |= 2;
-		CellMin.y = CellCenter.y;
+		const Content&	C = m_ContentPool[m_ContentRefs[RefIndex].ContentIndex];
+		float			Distance = C.Intersect( _Ray.Origin, _Ray.Direction );
+		if ( Distance >= 0.0f && Distance < _Distance )
+		{
+			_Distance = Distance;
+			pResult = &C.Value;
+		}
 	}
-	if ( _Position.z >= CellCenter.z )
+
+	// Visit children from front to back, skipping the ones that start beyond the closest hit so far
+	float	HalfSize = 0.5f * _Size;
+	U32		FirstChildIndex = (_Ray.Direction.x < 0.0f ? 1 : 0) | (_Ray.Direction.y < 0.0f ? 2 : 0) | (_Ray.Direction.z < 0.0f ? 4 : 0);
+	for ( U32 i=0; i < 8; i++ )
 	{
-		ChildIndex |= 4;
-		CellMin.z = CellCenter.z;
+		U32	ChildIndex = FirstChildIndex ^ i;
+		U32	ChildNodeIndex = N.pChildren[ChildIndex];
+		if ( ChildNodeIndex == INVALID_INDEX )
+			continue;
+
+		float3	ChildMin = GetChildMin( _Min, HalfSize, ChildIndex );
+		U32		ChildBorderMask = GetChildBorderMask( _BorderMask, ChildIndex );
+		float3	BoundMin, BoundMax;
+		GetCellBounds( ChildMin, HalfSize, ChildBorderMask, BoundMin, BoundMax );
+		if ( _Ray.IntersectCell( BoundMin, BoundMax, _Distance ) < 0.0f )
+			continue;
+
+		const T*	pResultChild = FetchFirstHit( ChildNodeIndex, _Ray, ChildMin, HalfSize, ChildBorderMask, _Distance );
+		if ( pResultChild != NULL )
+			pResult = pResultChild;
 	}
 
-	const T*	pResultChild = NULL;
-	Node*		pChild = m_ppCells[ChildIndex];
-	if ( pChild != NULL )
-		pResultChild = pChild->FetchNearest( _Position, CellMin, HalfSize, _SqDistance );
+	return pResult;
+}
+
+template<typename T> template<typename QUERY> void	Octree<T>::Query( const QUERY& _Query, BaseLib::List<T>& _Result ) const
+{
+	if ( m_Nodes.Count() == 0 )
+		return;
 
-	return pResultChild != NULL ? pResultChild : pResult;
+	// Contents referenced by several nodes are collected separately so we can remove duplicates
+	BaseLib::List<U32>	SharedContents;
+	Query( _Query, 0, m_Min, m_Size, 0x3F, false, _Result, SharedContents );
+	if ( SharedContents.Count() == 0 )
+		return;
+
+	SharedContents.SortBy( BaseLib::Less<U32>() );
+	U32	PreviousContentIndex = INVALID_INDEX;
+	for ( U32 i=0; i < SharedContents.Count(); i++ )
+	{
+		U32	ContentIndex = SharedContents[i];
+		if ( ContentIndex != PreviousContentIndex )
+			_Result.Append( m_ContentPool[ContentIndex].Value );
+		PreviousContentIndex = ContentIndex;
+	}
 }
 
-template<typename T> typename Octree<T>::Node&	Octree<T>::Node::GetOrCreateChildNode( U32 _X, U32 _Y, U32 _Z )
+template<typename T> template<typename QUERY> void	Octree<T>::Query( const QUERY& _Query, U32 _NodeIndex, const float3& _Min, float _Size, U32 _BorderMask, bool _FullyInside, BaseLib::List<T>& _Result, BaseLib::List<U32>& _SharedContents ) const
 {
-	U32	ChildIndex = _X | (_Y << 1) | (_Z << 2);
-	if ( m_ppCells[ChildIndex] == NULL )
+	// Test this node's values
+	const Node&	N = m_Nodes[_NodeIndex];
+	for ( U32 RefIndex=N.FirstRef; RefIndex != INVALID_INDEX; RefIndex=m_ContentRefs[RefIndex].NextRef )
 	{
-		m_ppCells[ChildIndex] = new Node( m_Owner, this );
-#ifdef _DEBUG
-		m_Owner.m_NodesCount++;
-#endif
+		U32				ContentIndex = m_ContentRefs[RefIndex].ContentIndex;
+		const Content&	C = m_ContentPool[ContentIndex];
+		if ( !_Query.Test( C ) )
+			continue;
+
+		if ( C.RefsCount > 1 )
+			_SharedContents.Append( ContentIndex );
+		else
+			_Result.Append( C.Value );
 	}
 
-	return *m_ppCells[ChildIndex];
+	// Recurse into children overlapping the query (no need to test the cells anymore once a cell is entirely inside the query)
+	float	HalfSize = 0.5f * _Size;
+	for ( U32 ChildIndex=0; ChildIndex < 8; ChildIndex++ )
+	{
+		U32	ChildNodeIndex = N.pChildren[ChildIndex];
+		if ( ChildNodeIndex == INVALID_INDEX )
+			continue;
+
+		float3	ChildMin = GetChildMin( _Min, HalfSize, ChildIndex );
+		U32		ChildBorderMask = GetChildBorderMask( _BorderMask, ChildIndex );
+		bool	ChildFullyInside = _FullyInside;
+		if ( !_FullyInside )
+		{
+			float3	BoundMin, BoundMax;
+			GetCellBounds( ChildMin, HalfSize, ChildBorderMask, BoundMin, BoundMax );
+			int	Test = _Query.TestCell( BoundMin, BoundMax );
+			if ( Test == 0 )
+				continue;
+			ChildFullyInside = Test == 2;
+		}
+
+		Query( _Query, ChildNodeIndex, ChildMin, HalfSize, ChildBorderMask, ChildFullyInside, _Result, _SharedContents );
+	}
 }
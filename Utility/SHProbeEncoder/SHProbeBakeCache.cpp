@@ -0,0 +1,323 @@
+#include "../../GodComplex.h"
+#include "SHProbeBakeCache.h"
+#include "../../BaseLib/Utility/Allocator.h"
+
+//////////////////////////////////////////////////////////////////////////
+// FNV-1a 64-bits hashing
+static const U64	FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const U64	FNV_PRIME = 1099511628211ULL;
+
+const float	SHProbeBakeCache::LIGHT_INFLUENCE_THRESHOLD = 1e-3f;
+
+static U64	HashBytes( U64 _Hash, const void* _pData, size_t _Size ) {
+	const U8*	pData = (const U8*) _pData;
+	for ( size_t i=0; i < _Size; i++ )
+		_Hash = (_Hash ^ pData[i]) * FNV_PRIME;
+	return _Hash;
+}
+template< typename T > U64	HashValue( U64 _Hash, const T& _Value ) {
+	return HashBytes( _Hash, &_Value, sizeof(T) );
+}
+
+// Hashes every parameter of the material, not just its textures, so tweaking a color invalidates the probes seeing it
+static U64	HashMaterial( U64 _Hash, const Scene::Material& _Material ) {
+	_Hash = HashValue( _Hash, _Material.m_ID );
+	_Hash = HashValue( _Hash, _Material.m_Ambient );
+	_Hash = HashValue( _Hash, _Material.m_DiffuseAlbedo );
+	_Hash = HashValue( _Hash, _Material.m_TexDiffuseAlbedo.m_ID );
+	_Hash = HashValue( _Hash, _Material.m_SpecularAlbedo );
+	_Hash = HashValue( _Hash, _Material.m_TexSpecularAlbedo.m_ID );
+	_Hash = HashValue( _Hash, _Material.m_SpecularExponent );
+	_Hash = HashValue( _Hash, _Material.m_TexNormal.m_ID );
+	_Hash = HashValue( _Hash, _Material.m_EmissiveColor );
+	return _Hash;
+}
+
+SHProbeBakeCache::SHProbeBakeCache()
+	: m_TotalFacesCount( 0 )
+	, m_LayoutHash( FNV_OFFSET_BASIS )
+	, m_ProbesCount( 0 )
+	, m_pRecords( NULL )
+	, m_bValid( false ) {
+}
+
+SHProbeBakeCache::~SHProbeBakeCache() {
+	SAFE_DELETE_ARRAY( m_pRecords );
+}
+
+void	SHProbeBakeCache::ScanScene( Scene& _Scene, U32 _ProbesCount ) {
+	class SceneHasher : public Scene::IVisitor {
+	public:
+		SHProbeBakeCache&	m_Owner;
+
+		SceneHasher( SHProbeBakeCache& _Owner ) : m_Owner( _Owner ) {}
+		virtual void	HandleNode( Scene::Node& _Node ) override {
+			if ( _Node.m_Type == Scene::Node::LIGHT ) {
+				const Scene::Light&	L = (const Scene::Light&) _Node;
+				U64	Hash = FNV_OFFSET_BASIS;
+				Hash = HashValue( Hash, L.m_LightType );
+				Hash = HashValue( Hash, L.m_Color );
+				Hash = HashValue( Hash, L.m_Intensity );
+				Hash = HashValue( Hash, L.m_HotSpot );
+				Hash = HashValue( Hash, L.m_Falloff );
+				Hash = HashValue( Hash, L.m_Local2World );
+
+				// Lighting falls off as 1/d^2, so the light stops mattering at d = sqrt( I / threshold )
+				LightInfo&	Info = m_Owner.m_Lights.Append();
+				Info.Hash = Hash;
+				Info.Position = L.m_Local2World.GetRow( 3 );
+				Info.InfluenceRadius = FLT_MAX;
+				if ( L.m_LightType != Scene::Light::DIRECTIONAL ) {
+					float	MaxIntensity = L.m_Intensity * MAX( MAX( L.m_Color.x, L.m_Color.y ), L.m_Color.z );
+					Info.InfluenceRadius = sqrtf( MAX( 0.0f, MaxIntensity ) / LIGHT_INFLUENCE_THRESHOLD );
+				}
+				return;
+			}
+			if ( _Node.m_Type != Scene::Node::MESH )
+				return;
+
+			const Scene::Mesh&	M = (const Scene::Mesh&) _Node;
+			for ( int PrimitiveIndex=0; PrimitiveIndex < M.m_PrimitivesCount; PrimitiveIndex++ ) {
+				const Scene::Mesh::Primitive&	P = M.m_pPrimitives[PrimitiveIndex];
+
+				// Layout only depends on the counts
+				m_Owner.m_LayoutHash = HashValue( m_Owner.m_LayoutHash, P.m_FacesCount );
+				m_Owner.m_LayoutHash = HashValue( m_Owner.m_LayoutHash, P.m_VerticesCount );
+
+				// Content depends on everything that can be rendered into the probe's cube map
+				U64	Hash = FNV_OFFSET_BASIS;
+				Hash = HashValue( Hash, M.m_Local2World );
+				Hash = HashBytes( Hash, P.m_pFaces, 3 * P.m_FacesCount * sizeof(U32) );
+				Hash = HashBytes( Hash, P.m_pVertices, P.m_VerticesCount * sizeof(Scene::Mesh::Primitive::VF_P3N3G3B3T2) );
+				if ( P.m_pMaterial != NULL )
+					Hash = HashMaterial( Hash, *P.m_pMaterial );
+
+				PrimitiveInfo&	Info = m_Owner.m_Primitives.Append();
+				Info.Hash = Hash;
+				Info.FaceStart = m_Owner.m_TotalFacesCount;
+				Info.FacesCount = P.m_FacesCount;
+				Info.GlobalBBoxMin = P.m_GlobalBBoxMin;
+				Info.GlobalBBoxMax = P.m_GlobalBBoxMax;
+
+				m_Owner.m_TotalFacesCount += P.m_FacesCount;
+			}
+		}
+	} visitor( *this );
+
+	m_Primitives.Clear();
+	m_TotalFacesCount = 0;
+	m_LayoutHash = FNV_OFFSET_BASIS;
+	m_Lights.Clear();
+	_Scene.ForEach( visitor );
+
+	m_LayoutHash = HashValue( m_LayoutHash, _ProbesCount );
+
+	// Reset records
+	SAFE_DELETE_ARRAY( m_pRecords );
+	m_ProbesCount = _ProbesCount;
+	m_pRecords = new ProbeRecord[m_ProbesCount];
+	m_bValid = false;
+}
+
+bool	SHProbeBakeCache::Load( const char* _pFileName ) {
+	m_bValid = false;
+
+	FILE*	pFile = NULL;
+	fopen_s( &pFile, _pFileName, "rb" );
+	if ( pFile == NULL )
+		return false;
+
+	U32	pHeader[4];
+	U64	LayoutHash;
+	if (	fread_s( pHeader, sizeof(pHeader), sizeof(U32), 4, pFile ) != 4
+		||	fread_s( &LayoutHash, sizeof(U64), sizeof(U64), 1, pFile ) != 1
+		||	pHeader[0] != MAGIC
+		||	pHeader[1] != VERSION
+		||	pHeader[2] != m_ProbesCount
+		||	pHeader[3] != m_TotalFacesCount
+		||	LayoutHash != m_LayoutHash ) {
+		fclose( pFile );
+		return false;	// Scene layout changed, everything must be rebaked
+	}
+
+	bool	Success = true;
+	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount && Success; ProbeIndex++ ) {
+		ProbeRecord&	R = m_pRecords[ProbeIndex];
+
+		U32	pCounts[2];
+		Success &= fread_s( &R.Hash, sizeof(U64), sizeof(U64), 1, pFile ) == 1;
+		Success &= fread_s( &R.wsBBoxMin, sizeof(float3), sizeof(float3), 1, pFile ) == 1;
+		Success &= fread_s( &R.wsBBoxMax, sizeof(float3), sizeof(float3), 1, pFile ) == 1;
+		Success &= fread_s( pCounts, sizeof(pCounts), sizeof(U32), 2, pFile ) == 2;
+		if ( !Success )
+			break;
+
+		R.NeighborProbeIDs.SetCount( pCounts[0] );
+		if ( pCounts[0] > 0 )
+			Success &= fread_s( &R.NeighborProbeIDs[0], pCounts[0]*sizeof(U32), sizeof(U32), pCounts[0], pFile ) == pCounts[0];
+
+		R.FaceInfluences.SetCount( pCounts[1] );
+		if ( pCounts[1] > 0 )
+			Success &= fread_s( &R.FaceInfluences[0], pCounts[1]*sizeof(FaceInfluence), sizeof(FaceInfluence), pCounts[1], pFile ) == pCounts[1];
+	}
+
+	fclose( pFile );
+
+	if ( !Success ) {
+		// Corrupt cache, reset all records
+		for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ )
+			m_pRecords[ProbeIndex].Hash = 0;
+		return false;
+	}
+
+	m_bValid = true;
+	return true;
+}
+
+bool	SHProbeBakeCache::Save( const char* _pFileName ) const {
+	FILE*	pFile = NULL;
+	fopen_s( &pFile, _pFileName, "wb" );
+	if ( pFile == NULL )
+		return false;
+
+	U32	pHeader[4] = { MAGIC, VERSION, m_ProbesCount, m_TotalFacesCount };
+	fwrite( pHeader, sizeof(U32), 4, pFile );
+	fwrite( &m_LayoutHash, sizeof(U64), 1, pFile );
+
+	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
+		const ProbeRecord&	R = m_pRecords[ProbeIndex];
+
+		U32	pCounts[2] = { R.NeighborProbeIDs.Count(), R.FaceInfluences.Count() };
+		fwrite( &R.Hash, sizeof(U64), 1, pFile );
+		fwrite( &R.wsBBoxMin, sizeof(float3), 1, pFile );
+		fwrite( &R.wsBBoxMax, sizeof(float3), 1, pFile );
+		fwrite( pCounts, sizeof(U32), 2, pFile );
+		if ( pCounts[0] > 0 )
+			fwrite( &R.NeighborProbeIDs[0], sizeof(U32), pCounts[0], pFile );
+		if ( pCounts[1] > 0 )
+			fwrite( &R.FaceInfluences[0], sizeof(FaceInfluence), pCounts[1], pFile );
+	}
+
+	fclose( pFile );
+	return true;
+}
+
+bool	SHProbeBakeCache::IsProbeUpToDate( U32 _ProbeIndex, const SHProbe* _pProbes ) const {
+	ASSERT( _ProbeIndex < m_ProbesCount, "Probe index out of range!" );
+	if ( !m_bValid )
+		return false;
+
+	const ProbeRecord&	R = m_pRecords[_ProbeIndex];
+	if ( R.Hash == 0 )
+		return false;	// Never baked
+
+	return ComputeProbeHash( _ProbeIndex, _pProbes, R ) == R.Hash;
+}
+
+void	SHProbeBakeCache::UpdateRecord( U32 _ProbeIndex, const SHProbe* _pProbes, const double* _pFaceInfluences ) {
+	ASSERT( _ProbeIndex < m_ProbesCount, "Probe index out of range!" );
+
+	const SHProbe&	Probe = _pProbes[_ProbeIndex];
+	ProbeRecord&	R = m_pRecords[_ProbeIndex];
+
+	R.wsBBoxMin = Probe.m_wsPosition + Probe.m_lsBBoxMin;
+	R.wsBBoxMax = Probe.m_wsPosition + Probe.m_lsBBoxMax;
+
+	R.NeighborProbeIDs.Clear();
+	R.NeighborProbeIDs.Reserve( Probe.m_NeighborProbes.Count() );
+	for ( U32 NeighborIndex=0; NeighborIndex < Probe.m_NeighborProbes.Count(); NeighborIndex++ )
+		R.NeighborProbeIDs.Append( Probe.m_NeighborProbes[NeighborIndex].ProbeID );
+
+	R.FaceInfluences.Clear();
+	R.FaceInfluences.Reserve( 256 );
+	for ( U32 FaceIndex=0; FaceIndex < m_TotalFacesCount; FaceIndex++ ) {
+		if ( _pFaceInfluences[FaceIndex] <= 0.0 )
+			continue;
+
+		FaceInfluence&	FI = R.FaceInfluences.Append();
+		FI.FaceIndex = FaceIndex;
+		FI.Influence = _pFaceInfluences[FaceIndex];
+	}
+
+	R.Hash = ComputeProbeHash( _ProbeIndex, _pProbes, R );
+	if ( R.Hash == 0 )
+		R.Hash = 1;	// 0 is reserved for "never baked"
+}
+
+U64	SHProbeBakeCache::ComputeProbeHash( U32 _ProbeIndex, const SHProbe* _pProbes, const ProbeRecord& _Record ) const {
+	const SHProbe&	Probe = _pProbes[_ProbeIndex];
+
+	U64	Hash = FNV_OFFSET_BASIS;
+
+	// Lights reaching what the probe saw (a light moving in or out of range changes the set, hence the hash)
+	for ( U32 LightIndex=0; LightIndex < m_Lights.Count(); LightIndex++ ) {
+		const LightInfo&	L = m_Lights[LightIndex];
+		if ( L.InfluenceRadius < FLT_MAX ) {
+			float3	Delta;
+			Delta.x = MAX( 0.0f, MAX( _Record.wsBBoxMin.x - L.Position.x, L.Position.x - _Record.wsBBoxMax.x ) );
+			Delta.y = MAX( 0.0f, MAX( _Record.wsBBoxMin.y - L.Position.y, L.Position.y - _Record.wsBBoxMax.y ) );
+			Delta.z = MAX( 0.0f, MAX( _Record.wsBBoxMin.z - L.Position.z, L.Position.z - _Record.wsBBoxMax.z ) );
+			if ( Delta.LengthSq() > L.InfluenceRadius * L.InfluenceRadius )
+				continue;
+		}
+		Hash = HashValue( Hash, LightIndex );
+		Hash = HashValue( Hash, L.Hash );
+	}
+
+	// Probe & neighbors positions
+	Hash = HashValue( Hash, Probe.m_wsPosition );
+	for ( U32 NeighborIndex=0; NeighborIndex < _Record.NeighborProbeIDs.Count(); NeighborIndex++ ) {
+		U32	NeighborProbeID = _Record.NeighborProbeIDs[NeighborIndex];
+		if ( NeighborProbeID >= m_ProbesCount )
+			continue;
+		Hash = HashValue( Hash, NeighborProbeID );
+		Hash = HashValue( Hash, _pProbes[NeighborProbeID].m_wsPosition );
+	}
+
+	// Flag primitives seen by the probe or overlapping what the probe saw (flags are temporary so they live in the thread arena)
+	BaseLib::ArenaScope	Scope( BaseLib::GetThreadArena() );
+	U32		PrimitivesCount = m_Primitives.Count();
+	bool*	pAffecting = (bool*) BaseLib::GetThreadArena().Allocate( PrimitivesCount+1, 1 );
+	memset( pAffecting, 0, PrimitivesCount*sizeof(bool) );
+
+	for ( U32 InfluenceIndex=0; InfluenceIndex < _Record.FaceInfluences.Count(); InfluenceIndex++ ) {
+		U32	PrimitiveIndex = FindPrimitiveIndex( _Record.FaceInfluences[InfluenceIndex].FaceIndex );
+		if ( PrimitiveIndex != ~0U )
+			pAffecting[PrimitiveIndex] = true;
+	}
+
+	for ( U32 PrimitiveIndex=0; PrimitiveIndex < PrimitivesCount; PrimitiveIndex++ ) {
+		const PrimitiveInfo&	P = m_Primitives[PrimitiveIndex];
+		if (	P.GlobalBBoxMax.x >= _Record.wsBBoxMin.x && P.GlobalBBoxMin.x <= _Record.wsBBoxMax.x
+			&&	P.GlobalBBoxMax.y >= _Record.wsBBoxMin.y && P.GlobalBBoxMin.y <= _Record.wsBBoxMax.y
+			&&	P.GlobalBBoxMax.z >= _Record.wsBBoxMin.z && P.GlobalBBoxMin.z <= _Record.wsBBoxMax.z )
+			pAffecting[PrimitiveIndex] = true;
+	}
+
+	// Accumulate affecting primitives' hashes in order
+	for ( U32 PrimitiveIndex=0; PrimitiveIndex < PrimitivesCount; PrimitiveIndex++ ) {
+		if ( !pAffecting[PrimitiveIndex] )
+			continue;
+		Hash = HashValue( Hash, PrimitiveIndex );
+		Hash = HashValue( Hash, m_Primitives[PrimitiveIndex].Hash );
+	}
+
+	return Hash;
+}
+
+// Binary search of the primitive containing the face
+U32	SHProbeBakeCache::FindPrimitiveIndex( U32 _FaceIndex ) const {
+	int	Min = 0;
+	int	Max = int(m_Primitives.Count()) - 1;
+	while ( Min <= Max ) {
+		int						Mid = (Min + Max) >> 1;
+		const PrimitiveInfo&	P = m_Primitives[Mid];
+		if ( _FaceIndex < P.FaceStart )
+			Max = Mid - 1;
+		else if ( _FaceIndex >= P.FaceStart + P.FacesCount )
+			Min = Mid + 1;
+		else
+			return Mid;
+	}
+	return ~0U;
+}
@@ -0,0 +1,104 @@
+//////////////////////////////////////////////////////////////////////////
+// SH Probe Bake Cache
+//
+// Keeps track of what affected each probe during its last bake so the next bake can skip probes whose environment didn't change.
+//
+// For each probe, we record a content hash of:
+//	. The primitives seen in its cube map (i.e. faces with a non-zero influence) and the primitives overlapping the world-space
+//		bounding box of what the probe saw (so geometry moving into view is detected). A primitive's hash covers its vertices,
+//		faces, mesh transform and all the material parameters.
+//	. The scene lights reaching the bounding box of what the probe saw (static lighting is baked into the probes). Directional lights
+//		reach everything, point & spot lights reach as far as their irradiance stays above LIGHT_INFLUENCE_THRESHOLD.
+//	. The probe's own position and the positions of its neighbor probes (neighbors & Vorono cell depend on them)
+//
+// We also keep the probe's per-face influences so the probe influence vertex stream can be rebuilt without re-rendering the probe.
+//
+// NOTE: Face indices are only meaningful as long as the scene's primitive layout (amount of primitives and their face/vertex counts)
+//	is unchanged, so any change in the layout or in the amount of probes invalidates the entire cache and triggers a full rebake.
+//
+#pragma once
+
+#include "SHProbe.h"
+
+class	SHProbeBakeCache {
+public:		// CONSTANTS
+
+	static const U32		MAGIC = 0x43425053;		// "SPBC"
+	static const U32		VERSION = 2;
+	static const float		LIGHT_INFLUENCE_THRESHOLD;	// Irradiance below which a light is considered to have no influence
+
+public:		// NESTED TYPES
+
+	struct	FaceInfluence {
+		U32		FaceIndex;
+		double	Influence;
+	};
+
+	struct	ProbeRecord {
+		U64						Hash;				// Content hash of everything that affected the probe during its last bake (0 if never baked)
+		float3					wsBBoxMin;			// World-space bounding box of the scene pixels seen by the probe
+		float3					wsBBoxMax;
+		List< U32 >				NeighborProbeIDs;	// IDs of the neighbor probes found during the bake
+		List< FaceInfluence >	FaceInfluences;		// Faces seen by the probe with a non-zero influence
+
+		ProbeRecord() : Hash( 0 ) {}
+	};
+
+private:
+
+	struct	PrimitiveInfo {
+		U64		Hash;
+		U32		FaceStart;
+		U32		FacesCount;
+		float3	GlobalBBoxMin;
+		float3	GlobalBBoxMax;
+	};
+
+	struct	LightInfo {
+		U64		Hash;
+		float3	Position;
+		float	InfluenceRadius;	// FLT_MAX for directional lights
+	};
+
+private:	// FIELDS
+
+	// Current scene state
+	List< PrimitiveInfo >	m_Primitives;			// Primitives in scene traversal order (i.e. the same order used to index faces)
+	U32						m_TotalFacesCount;
+	U64						m_LayoutHash;			// Hash of the primitives layout
+	List< LightInfo >		m_Lights;				// Lights in scene traversal order
+
+	// Per-probe records
+	U32						m_ProbesCount;
+	ProbeRecord*			m_pRecords;
+	bool					m_bValid;				// True if the records were loaded from a cache matching the current scene layout
+
+public:		// PROPERTIES
+
+	bool					IsValid() const							{ return m_bValid; }
+	const ProbeRecord&		GetRecord( U32 _ProbeIndex ) const		{ return m_pRecords[_ProbeIndex]; }
+
+public:		// METHODS
+
+	SHProbeBakeCache();
+	~SHProbeBakeCache();
+
+	// Computes the hashes of the current scene content (must be called first)
+	void	ScanScene( Scene& _Scene, U32 _ProbesCount );
+
+	// Loads the cache of a previous bake, returns false (and invalidates all probes) if the file doesn't exist or doesn't match the scanned scene
+	bool	Load( const char* _pFileName );
+	bool	Save( const char* _pFileName ) const;
+
+	// Tells if the probe's recorded hash still matches the current scene
+	bool	IsProbeUpToDate( U32 _ProbeIndex, const SHProbe* _pProbes ) const;
+
+	// Updates the record of a freshly baked probe
+	//	_pFaceInfluences, the influence of the probe on each face of the scene
+	void	UpdateRecord( U32 _ProbeIndex, const SHProbe* _pProbes, const double* _pFaceInfluences );
+
+private:
+
+	U64		ComputeProbeHash( U32 _ProbeIndex, const SHProbe* _pProbes, const ProbeRecord& _Record ) const;
+	U32		FindPrimitiveIndex( U32 _FaceIndex ) const;
+};
@@ -0,0 +1,363 @@
+#include "../../GodComplex.h"
+#include "SHProbeDatabase.h"
+
+static U32	Align16( U32 _Offset )	{ return (_Offset + 15) & ~15U; }
+
+SHProbeDatabase::SHProbeDatabase()
+	: m_pHeader( NULL )
+	, m_pProbes( NULL )
+	, m_pSH( NULL )
+	, m_pSamples( NULL )
+	, m_pEmissiveSurfaces( NULL )
+	, m_pNeighborProbes( NULL )
+	, m_pVoronoiProbes( NULL ) {
+}
+
+SHProbeDatabase::~SHProbeDatabase() {
+	Close();
+}
+
+bool	SHProbeDatabase::Open( const char* _pFileName ) {
+	Close();
+	if ( !m_File.Open( _pFileName ) )
+		return false;
+
+	const Header*	pHeader = m_File.GetMappedMemory<Header>( 0 );
+	if (	pHeader == NULL
+		||	pHeader->Magic != MAGIC
+		||	pHeader->Version != VERSION
+		||	pHeader->FileSize != m_File.GetSize() ) {
+		Close();
+		return false;	// Not a database or wrong version
+	}
+
+	// Resolve the offset table (each fetch is range-checked against the file size)
+	U32		ProbesCount = pHeader->ProbesCount;
+	U64		SamplesCount = U64(ProbesCount) * SHProbe::SAMPLES_COUNT;
+	bool	Half = (pHeader->Flags & FLAG_HALF_PRECISION) != 0;
+	m_pProbes = m_File.GetMappedMemory<ProbeEntry>( pHeader->ProbesOffset, ProbesCount );
+	m_pSH = Half ? (const void*) m_File.GetMappedMemory<SHHalf>( pHeader->SHOffset, ProbesCount )
+				 : (const void*) m_File.GetMappedMemory<SHFull>( pHeader->SHOffset, ProbesCount );
+	m_pSamples = Half ? (const void*) m_File.GetMappedMemory<SampleHalf>( pHeader->SamplesOffset, SamplesCount )
+					  : (const void*) m_File.GetMappedMemory<SampleFull>( pHeader->SamplesOffset, SamplesCount );
+	m_pEmissiveSurfaces = m_File.GetMappedMemory<EmissiveSurface>( pHeader->EmissiveSurfacesOffset, pHeader->EmissiveSurfacesCount );
+	m_pNeighborProbes = m_File.GetMappedMemory<NeighborProbe>( pHeader->NeighborProbesOffset, pHeader->NeighborProbesCount );
+	m_pVoronoiProbes = m_File.GetMappedMemory<VoronoiProbe>( pHeader->VoronoiProbesOffset, pHeader->VoronoiProbesCount );
+
+	if (	m_pProbes == NULL || m_pSH == NULL || m_pSamples == NULL
+		||	m_pEmissiveSurfaces == NULL || m_pNeighborProbes == NULL || m_pVoronoiProbes == NULL ) {
+		Close();
+		return false;	// Corrupt offset table
+	}
+
+	// Each probe's ranges and probe IDs must stay within the shared arrays
+	for ( U32 ProbeIndex=0; ProbeIndex < ProbesCount; ProbeIndex++ ) {
+		const ProbeEntry&	Entry = m_pProbes[ProbeIndex];
+		if (	U64(Entry.EmissiveSurfacesStart) + Entry.EmissiveSurfacesCount > pHeader->EmissiveSurfacesCount
+			||	U64(Entry.NeighborProbesStart) + Entry.NeighborProbesCount > pHeader->NeighborProbesCount
+			||	U64(Entry.VoronoiProbesStart) + Entry.VoronoiProbesCount > pHeader->VoronoiProbesCount ) {
+			Close();
+			return false;	// Corrupt probe entry
+		}
+	}
+	for ( U32 NeighborIndex=0; NeighborIndex < pHeader->NeighborProbesCount; NeighborIndex++ )
+		if ( m_pNeighborProbes[NeighborIndex].ProbeID >= ProbesCount ) {
+			Close();
+			return false;	// Corrupt neighbor probe
+		}
+	for ( U32 VoronoiIndex=0; VoronoiIndex < pHeader->VoronoiProbesCount; VoronoiIndex++ )
+		if ( m_pVoronoiProbes[VoronoiIndex].ProbeID >= ProbesCount ) {
+			Close();
+			return false;	// Corrupt Voronoi probe
+		}
+
+	m_pHeader = pHeader;
+	return true;
+}
+
+void	SHProbeDatabase::Close() {
+	m_File.Close();
+	m_pHeader = NULL;
+	m_pProbes = NULL;
+	m_pSH = NULL;
+	m_pSamples = NULL;
+	m_pEmissiveSurfaces = NULL;
+	m_pNeighborProbes = NULL;
+	m_pVoronoiProbes = NULL;
+}
+
+void	SHProbeDatabase::ReadProbe( U32 _ProbeIndex, SHProbe& _Probe, bool _PrepareForRuntime ) const {
+	ASSERT( m_pHeader != NULL, "Database is not open!" );
+	ASSERT( _ProbeIndex < m_pHeader->ProbesCount, "Probe index out of range!" );
+
+	const ProbeEntry&	Entry = m_pProbes[_ProbeIndex];
+
+	const float3	Origin = _PrepareForRuntime ? _Probe.m_wsPosition : float3::Zero;
+	const float		AlbedoFactor = _PrepareForRuntime ? INVPI : 1.0f;
+
+	_Probe.m_MeanDistance = Entry.MeanDistance;
+	_Probe.m_MeanHarmonicDistance = Entry.MeanHarmonicDistance;
+	_Probe.m_MinDistance = Entry.MinDistance;
+	_Probe.m_MaxDistance = Entry.MaxDistance;
+	_Probe.m_lsBBoxMin = Entry.lsBBoxMin;
+	_Probe.m_lsBBoxMax = Entry.lsBBoxMax;
+	_Probe.m_NearestNeighborProbeDistance = Entry.NearestNeighborProbeDistance;
+	_Probe.m_FarthestNeighborProbeDistance = Entry.FarthestNeighborProbeDistance;
+
+	// SH & samples
+	if ( IsHalfPrecision() ) {
+		const SHHalf&	SH = *GetSHHalf( _ProbeIndex );
+		for ( int i=0; i < 9; i++ ) {
+			_Probe.m_pSHStaticLighting[i].Set( SH.StaticLighting[3*i+0], SH.StaticLighting[3*i+1], SH.StaticLighting[3*i+2] );
+			_Probe.m_pSHOcclusion[i] = SH.Occlusion[i];
+		}
+
+		const SampleHalf*	pSource = GetSamplesHalf( _ProbeIndex );
+		SHProbe::Sample*	pTarget = _Probe.m_pSamples;
+		for ( U32 SampleIndex=0; SampleIndex < SHProbe::SAMPLES_COUNT; SampleIndex++, pSource++, pTarget++ ) {
+			pTarget->Position = Origin + float3( pSource->Position[0], pSource->Position[1], pSource->Position[2] );
+			pTarget->Normal.Set( pSource->Normal[0], pSource->Normal[1], pSource->Normal[2] );
+			pTarget->Tangent.Set( pSource->Tangent[0], pSource->Tangent[1], pSource->Tangent[2] );
+			pTarget->BiTangent.Set( pSource->BiTangent[0], pSource->BiTangent[1], pSource->BiTangent[2] );
+			pTarget->Albedo = AlbedoFactor * float3( pSource->Albedo[0], pSource->Albedo[1], pSource->Albedo[2] );	// Ready for upload!
+			pTarget->F0.Set( pSource->F0[0], pSource->F0[1], pSource->F0[2] );
+			pTarget->Radius = pSource->Radius;
+			pTarget->SHFactor = pSource->SHFactor;
+		}
+	} else {
+		const SHFull&	SH = *GetSHFull( _ProbeIndex );
+		memcpy_s( _Probe.m_pSHStaticLighting, sizeof(_Probe.m_pSHStaticLighting), SH.StaticLighting, sizeof(SH.StaticLighting) );
+		memcpy_s( _Probe.m_pSHOcclusion, sizeof(_Probe.m_pSHOcclusion), SH.Occlusion, sizeof(SH.Occlusion) );
+
+		const SampleFull*	pSource = GetSamplesFull( _ProbeIndex );
+		SHProbe::Sample*	pTarget = _Probe.m_pSamples;
+		for ( U32 SampleIndex=0; SampleIndex < SHProbe::SAMPLES_COUNT; SampleIndex++, pSource++, pTarget++ ) {
+			pTarget->Position = Origin + pSource->Position;
+			pTarget->Normal = pSource->Normal;
+			pTarget->Tangent = pSource->Tangent;
+			pTarget->BiTangent = pSource->BiTangent;
+			pTarget->Albedo = AlbedoFactor * pSource->Albedo;	// Ready for upload!
+			pTarget->F0 = pSource->F0;
+			pTarget->Radius = pSource->Radius;
+			pTarget->SHFactor = pSource->SHFactor;
+		}
+	}
+
+	// Emissive surfaces
+	_Probe.m_EmissiveSurfacesCount = MIN( SHProbe::MAX_EMISSIVE_SURFACES, Entry.EmissiveSurfacesCount );	// Don't read more than we can chew!
+	memcpy_s( _Probe.m_pEmissiveSurfaces, sizeof(_Probe.m_pEmissiveSurfaces), GetEmissiveSurfaces( _ProbeIndex ), _Probe.m_EmissiveSurfacesCount * sizeof(EmissiveSurface) );
+
+	// Neighbor probes
+	const NeighborProbe*	pNeighbor = GetNeighborProbes( _ProbeIndex );
+	_Probe.m_NeighborProbes.Clear();
+	_Probe.m_NeighborProbes.Reserve( Entry.NeighborProbesCount );
+	for ( U32 NeighborProbeIndex=0; NeighborProbeIndex < Entry.NeighborProbesCount; NeighborProbeIndex++, pNeighbor++ ) {
+		SHProbe::NeighborProbeInfo&	NP = _Probe.m_NeighborProbes.Append();
+		NP.ProbeID = pNeighbor->ProbeID;
+		NP.DirectlyVisible = pNeighbor->DirectlyVisible != 0;
+		NP.Distance = pNeighbor->Distance;
+		NP.SolidAngle = pNeighbor->SolidAngle;
+		NP.Direction = pNeighbor->Direction;
+		memcpy_s( NP.SH, sizeof(NP.SH), pNeighbor->SH, sizeof(pNeighbor->SH) );
+	}
+
+	// Vorono probes
+	const VoronoiProbe*	pVoronoi = GetVoronoiProbes( _ProbeIndex );
+	_Probe.m_VoronoiProbes.Clear();
+	_Probe.m_VoronoiProbes.Reserve( Entry.VoronoiProbesCount );
+	for ( U32 VoronoiProbeIndex=0; VoronoiProbeIndex < Entry.VoronoiProbesCount; VoronoiProbeIndex++, pVoronoi++ ) {
+		SHProbe::VoronoiProbeInfo&	VP = _Probe.m_VoronoiProbes.Append();
+		VP.ProbeID = pVoronoi->ProbeID;
+		VP.PlanePosition = pVoronoi->PlanePosition;
+		VP.PlaneNormal = pVoronoi->PlaneNormal;
+	}
+}
+
+bool	SHProbeDatabase::Write( const char* _pFileName, const SHProbe* _pProbes, U32 _ProbesCount, bool _HalfPrecision ) {
+
+	//////////////////////////////////////////////////////////////////////////
+	// Count variable-size arrays and build the offset table
+	U32	EmissiveSurfacesCount = 0;
+	U32	NeighborProbesCount = 0;
+	U32	VoronoiProbesCount = 0;
+	for ( U32 ProbeIndex=0; ProbeIndex < _ProbesCount; ProbeIndex++ ) {
+		const SHProbe&	Probe = _pProbes[ProbeIndex];
+		EmissiveSurfacesCount += MIN( SHProbe::MAX_EMISSIVE_SURFACES, Probe.m_EmissiveSurfacesCount );
+		NeighborProbesCount += Probe.m_NeighborProbes.Count();
+		VoronoiProbesCount += Probe.m_VoronoiProbes.Count();
+	}
+
+	U32		SHSize = _HalfPrecision ? sizeof(SHHalf) : sizeof(SHFull);
+	U32		SampleSize = _HalfPrecision ? sizeof(SampleHalf) : sizeof(SampleFull);
+
+	Header	H;
+	memset( &H, 0, sizeof(Header) );
+	H.Magic = MAGIC;
+	H.Version = VERSION;
+	H.Flags = _HalfPrecision ? FLAG_HALF_PRECISION : 0;
+	H.ProbesCount = _ProbesCount;
+	H.ProbesOffset = Align16( sizeof(Header) );
+	H.SHOffset = Align16( H.ProbesOffset + _ProbesCount * sizeof(ProbeEntry) );
+	H.SamplesOffset = Align16( H.SHOffset + _ProbesCount * SHSize );
+	H.EmissiveSurfacesOffset = Align16( H.SamplesOffset + _ProbesCount * SHProbe::SAMPLES_COUNT * SampleSize );
+	H.EmissiveSurfacesCount = EmissiveSurfacesCount;
+	H.NeighborProbesOffset = Align16( H.EmissiveSurfacesOffset + EmissiveSurfacesCount * sizeof(EmissiveSurface) );
+	H.NeighborProbesCount = NeighborProbesCount;
+	H.VoronoiProbesOffset = Align16( H.NeighborProbesOffset + NeighborProbesCount * sizeof(NeighborProbe) );
+	H.VoronoiProbesCount = VoronoiProbesCount;
+	H.FileSize = Align16( H.VoronoiProbesOffset + VoronoiProbesCount * sizeof(VoronoiProbe) );
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build the entire file in memory so it's written in a single call
+	U8*		pBuffer = new U8[H.FileSize];
+	memset( pBuffer, 0, H.FileSize );
+	memcpy_s( pBuffer, H.FileSize, &H, sizeof(Header) );
+
+	ProbeEntry*			pEntry = (ProbeEntry*) (pBuffer + H.ProbesOffset);
+	EmissiveSurface*	pEmissive = (EmissiveSurface*) (pBuffer + H.EmissiveSurfacesOffset);
+	NeighborProbe*		pNeighbor = (NeighborProbe*) (pBuffer + H.NeighborProbesOffset);
+	VoronoiProbe*		pVoronoi = (VoronoiProbe*) (pBuffer + H.VoronoiProbesOffset);
+
+	U32	EmissiveSurfacesStart = 0;
+	U32	NeighborProbesStart = 0;
+	U32	VoronoiProbesStart = 0;
+	for ( U32 ProbeIndex=0; ProbeIndex < _ProbesCount; ProbeIndex++, pEntry++ ) {
+		const SHProbe&	Probe = _pProbes[ProbeIndex];
+
+		pEntry->MeanDistance = Probe.m_MeanDistance;
+		pEntry->MeanHarmonicDistance = Probe.m_MeanHarmonicDistance;
+		pEntry->MinDistance = Probe.m_MinDistance;
+		pEntry->MaxDistance = Probe.m_MaxDistance;
+		pEntry->lsBBoxMin = Probe.m_lsBBoxMin;
+		pEntry->lsBBoxMax = Probe.m_lsBBoxMax;
+		pEntry->NearestNeighborProbeDistance = Probe.m_NearestNeighborProbeDistance;
+		pEntry->FarthestNeighborProbeDistance = Probe.m_FarthestNeighborProbeDistance;
+
+		// SH & samples
+		if ( _HalfPrecision ) {
+			SHHalf&	SH = ((SHHalf*) (pBuffer + H.SHOffset))[ProbeIndex];
+			for ( int i=0; i < 9; i++ ) {
+				SH.StaticLighting[3*i+0] = Probe.m_pSHStaticLighting[i].x;
+				SH.StaticLighting[3*i+1] = Probe.m_pSHStaticLighting[i].y;
+				SH.StaticLighting[3*i+2] = Probe.m_pSHStaticLighting[i].z;
+				SH.Occlusion[i] = Probe.m_pSHOcclusion[i];
+			}
+
+			SampleHalf*	pTarget = (SampleHalf*) (pBuffer + H.SamplesOffset) + ProbeIndex * SHProbe::SAMPLES_COUNT;
+			for ( U32 SampleIndex=0; SampleIndex < SHProbe::SAMPLES_COUNT; SampleIndex++, pTarget++ ) {
+				const SHProbe::Sample&	S = Probe.m_pSamples[SampleIndex];
+				for ( int i=0; i < 3; i++ ) {
+					pTarget->Position[i] = S.Position[i];
+					pTarget->Normal[i] = S.Normal[i];
+					pTarget->Tangent[i] = S.Tangent[i];
+					pTarget->BiTangent[i] = S.BiTangent[i];
+					pTarget->Albedo[i] = S.Albedo[i];
+					pTarget->F0[i] = S.F0[i];
+				}
+				pTarget->Radius = S.Radius;
+				pTarget->SHFactor = S.SHFactor;
+			}
+		} else {
+			SHFull&	SH = ((SHFull*) (pBuffer + H.SHOffset))[ProbeIndex];
+			memcpy_s( SH.StaticLighting, sizeof(SH.StaticLighting), Probe.m_pSHStaticLighting, sizeof(Probe.m_pSHStaticLighting) );
+			memcpy_s( SH.Occlusion, sizeof(SH.Occlusion), Probe.m_pSHOcclusion, sizeof(Probe.m_pSHOcclusion) );
+
+			SampleFull*	pTarget = (SampleFull*) (pBuffer + H.SamplesOffset) + ProbeIndex * SHProbe::SAMPLES_COUNT;
+			for ( U32 SampleIndex=0; SampleIndex < SHProbe::SAMPLES_COUNT; SampleIndex++, pTarget++ ) {
+				const SHProbe::Sample&	S = Probe.m_pSamples[SampleIndex];
+				pTarget->Position = S.Position;
+				pTarget->Normal = S.Normal;
+				pTarget->Tangent = S.Tangent;
+				pTarget->BiTangent = S.BiTangent;
+				pTarget->Albedo = S.Albedo;
+				pTarget->F0 = S.F0;
+				pTarget->Radius = S.Radius;
+				pTarget->SHFactor = S.SHFactor;
+			}
+		}
+
+		// Emissive surfaces
+		U32	ProbeEmissiveSurfacesCount = MIN( SHProbe::MAX_EMISSIVE_SURFACES, Probe.m_EmissiveSurfacesCount );
+		pEntry->EmissiveSurfacesStart = EmissiveSurfacesStart;
+		pEntry->EmissiveSurfacesCount = ProbeEmissiveSurfacesCount;
+		for ( U32 i=0; i < ProbeEmissiveSurfacesCount; i++, pEmissive++ ) {
+			pEmissive->MaterialID = Probe.m_pEmissiveSurfaces[i].MaterialID;
+			memcpy_s( pEmissive->SH, sizeof(pEmissive->SH), Probe.m_pEmissiveSurfaces[i].pSH, 9*sizeof(float) );
+		}
+		EmissiveSurfacesStart += ProbeEmissiveSurfacesCount;
+
+		// Neighbor probes
+		U32	ProbeNeighborsCount = Probe.m_NeighborProbes.Count();
+		pEntry->NeighborProbesStart = NeighborProbesStart;
+		pEntry->NeighborProbesCount = ProbeNeighborsCount;
+		for ( U32 i=0; i < ProbeNeighborsCount; i++, pNeighbor++ ) {
+			const SHProbe::NeighborProbeInfo&	NP = Probe.m_NeighborProbes[i];
+			pNeighbor->ProbeID = NP.ProbeID;
+			pNeighbor->DirectlyVisible = NP.DirectlyVisible ? 1 : 0;
+			pNeighbor->Distance = NP.Distance;
+			pNeighbor->SolidAngle = NP.SolidAngle;
+			pNeighbor->Direction = NP.Direction;
+			memcpy_s( pNeighbor->SH, sizeof(pNeighbor->SH), NP.SH, sizeof(NP.SH) );
+		}
+		NeighborProbesStart += ProbeNeighborsCount;
+
+		// Vorono probes
+		U32	ProbeVoronoiCount = Probe.m_VoronoiProbes.Count();
+		pEntry->VoronoiProbesStart = VoronoiProbesStart;
+		pEntry->VoronoiProbesCount = ProbeVoronoiCount;
+		for ( U32 i=0; i < ProbeVoronoiCount; i++, pVoronoi++ ) {
+			const SHProbe::VoronoiProbeInfo&	VP = Probe.m_VoronoiProbes[i];
+			pVoronoi->ProbeID = VP.ProbeID;
+			pVoronoi->PlanePosition = VP.PlanePosition;
+			pVoronoi->PlaneNormal = VP.PlaneNormal;
+		}
+		VoronoiProbesStart += ProbeVoronoiCount;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Write
+	FILE*	pFile = NULL;
+	fopen_s( &pFile, _pFileName, "wb" );
+	if ( pFile == NULL ) {
+		delete[] pBuffer;
+		return false;
+	}
+
+	size_t	WrittenSize = fwrite( pBuffer, 1, H.FileSize, pFile );
+	fclose( pFile );
+	delete[] pBuffer;
+
+	return WrittenSize == H.FileSize;
+}
+
+bool	SHProbeDatabase::ConvertFromProbeSets( const char* _pPathToProbes, U32 _ProbesCount, const char* _pFileName, bool _HalfPrecision ) {
+	SHProbe*	pProbes = new SHProbe[_ProbesCount];
+
+	char	pTemp[1024];
+	for ( U32 ProbeIndex=0; ProbeIndex < _ProbesCount; ProbeIndex++ ) {
+		SHProbe&	Probe = pProbes[ProbeIndex];
+		Probe.m_ProbeID = ProbeIndex;
+		Probe.m_pSceneProbe = NULL;
+		Probe.m_wsPosition = float3::Zero;	// So samples stay relative to the probe when loading
+
+		sprintf_s( pTemp, "%sProbe%02d.probeset", _pPathToProbes, ProbeIndex );
+		FILE*	pFile = NULL;
+		fopen_s( &pFile, pTemp, "rb" );
+		if ( pFile == NULL ) {
+			delete[] pProbes;
+			return false;	// Incomplete probe set
+		}
+
+		Probe.Load( pFile );
+		fclose( pFile );
+
+		// Undo the runtime albedo pre-scaling performed by Load() so we store the same values as the probeset files
+		for ( U32 SampleIndex=0; SampleIndex < SHProbe::SAMPLES_COUNT; SampleIndex++ )
+			Probe.m_pSamples[SampleIndex].Albedo = PI * Probe.m_pSamples[SampleIndex].Albedo;
+	}
+
+	bool	Result = Write( _pFileName, pProbes, _ProbesCount, _HalfPrecision );
+
+	delete[] pProbes;
+	return Result;
+}
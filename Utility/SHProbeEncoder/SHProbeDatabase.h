@@ -0,0 +1,171 @@
+//////////////////////////////////////////////////////////////////////////
+// SH Probe Database
+//
+// A single versioned file containing all the probes of a scene, replacing the per-probe ".probeset" files.
+// The file is made of a header, an offset table and contiguous arrays of fixed-size records so it can be
+//	memory-mapped and used in place without any parsing:
+//
+//	Header
+//	ProbeEntry[ProbesCount]						Fixed-size infos for each probe + ranges into the arrays below
+//	SH[ProbesCount]								Static lighting (RGB) + occlusion SH coefficients (float or half)
+//	Sample[ProbesCount*SAMPLES_COUNT]			Probe samples (float or half)
+//	EmissiveSurface[EmissiveSurfacesCount]
+//	NeighborProbe[NeighborProbesCount]
+//	VoronoiProbe[VoronoiProbesCount]
+//
+// All arrays are 16-bytes aligned. Samples positions are stored relative to the probe, just like in the probeset files.
+//
+#pragma once
+
+#include "SHProbe.h"
+
+class	SHProbeDatabase {
+public:		// CONSTANTS
+
+	static const U32		MAGIC = 0x42445053;			// "SPDB"
+	static const U32		VERSION = 1;
+
+	enum FLAGS {
+		FLAG_HALF_PRECISION = 1,						// Samples and SH coefficients are stored as half floats
+	};
+
+public:		// NESTED TYPES
+
+#pragma pack( push, 4 )
+
+	struct	Header {
+		U32		Magic;
+		U32		Version;
+		U32		Flags;
+		U32		ProbesCount;
+		U32		FileSize;
+
+		U32		ProbesOffset;
+		U32		SHOffset;
+		U32		SamplesOffset;
+		U32		EmissiveSurfacesOffset;
+		U32		EmissiveSurfacesCount;
+		U32		NeighborProbesOffset;
+		U32		NeighborProbesCount;
+		U32		VoronoiProbesOffset;
+		U32		VoronoiProbesCount;
+	};
+
+	struct	ProbeEntry {
+		float	MeanDistance;
+		float	MeanHarmonicDistance;
+		float	MinDistance;
+		float	MaxDistance;
+		float3	lsBBoxMin;
+		float3	lsBBoxMax;
+		float	NearestNeighborProbeDistance;
+		float	FarthestNeighborProbeDistance;
+
+		U32		EmissiveSurfacesStart;
+		U32		EmissiveSurfacesCount;
+		U32		NeighborProbesStart;
+		U32		NeighborProbesCount;
+		U32		VoronoiProbesStart;
+		U32		VoronoiProbesCount;
+	};
+
+	struct	SHFull {
+		float3	StaticLighting[9];
+		float	Occlusion[9];
+	};
+	struct	SHHalf {
+		half	StaticLighting[3*9];
+		half	Occlusion[9];
+	};
+
+	struct	SampleFull {
+		float3	Position;
+		float3	Normal;
+		float3	Tangent;
+		float3	BiTangent;
+		float3	Albedo;
+		float3	F0;
+		float	Radius;
+		float	SHFactor;
+	};
+	struct	SampleHalf {
+		half	Position[3];
+		half	Normal[3];
+		half	Tangent[3];
+		half	BiTangent[3];
+		half	Albedo[3];
+		half	F0[3];
+		half	Radius;
+		half	SHFactor;
+	};
+
+	struct	EmissiveSurface {
+		U32		MaterialID;
+		float	SH[9];
+	};
+
+	struct	NeighborProbe {
+		U32		ProbeID;
+		U32		DirectlyVisible;
+		float	Distance;
+		float	SolidAngle;
+		float3	Direction;
+		float	SH[9];
+	};
+
+	struct	VoronoiProbe {
+		U32		ProbeID;
+		float3	PlanePosition;
+		float3	PlaneNormal;
+	};
+
+#pragma pack( pop )
+
+private:	// FIELDS
+
+	MappedFileView			m_File;
+	const Header*			m_pHeader;
+	const ProbeEntry*		m_pProbes;
+	const void*				m_pSH;
+	const void*				m_pSamples;
+	const EmissiveSurface*	m_pEmissiveSurfaces;
+	const NeighborProbe*	m_pNeighborProbes;
+	const VoronoiProbe*		m_pVoronoiProbes;
+
+public:		// PROPERTIES
+
+	bool					IsOpen() const			{ return m_pHeader != NULL; }
+	bool					IsHalfPrecision() const	{ return m_pHeader != NULL && (m_pHeader->Flags & FLAG_HALF_PRECISION) != 0; }
+	U32						GetProbesCount() const	{ return m_pHeader != NULL ? m_pHeader->ProbesCount : 0; }
+
+	// Zero-copy views over the mapped records, the amount of records of each array is given by the probe entry
+	const ProbeEntry&		GetProbeEntry( U32 _ProbeIndex ) const						{ return m_pProbes[_ProbeIndex]; }
+	const SHFull*			GetSHFull( U32 _ProbeIndex ) const							{ return (const SHFull*) m_pSH + _ProbeIndex; }
+	const SHHalf*			GetSHHalf( U32 _ProbeIndex ) const							{ return (const SHHalf*) m_pSH + _ProbeIndex; }
+	const SampleFull*		GetSamplesFull( U32 _ProbeIndex ) const						{ return (const SampleFull*) m_pSamples + _ProbeIndex * SHProbe::SAMPLES_COUNT; }
+	const SampleHalf*		GetSamplesHalf( U32 _ProbeIndex ) const						{ return (const SampleHalf*) m_pSamples + _ProbeIndex * SHProbe::SAMPLES_COUNT; }
+	const EmissiveSurface*	GetEmissiveSurfaces( U32 _ProbeIndex ) const				{ return m_pEmissiveSurfaces + m_pProbes[_ProbeIndex].EmissiveSurfacesStart; }
+	const NeighborProbe*	GetNeighborProbes( U32 _ProbeIndex ) const					{ return m_pNeighborProbes + m_pProbes[_ProbeIndex].NeighborProbesStart; }
+	const VoronoiProbe*		GetVoronoiProbes( U32 _ProbeIndex ) const					{ return m_pVoronoiProbes + m_pProbes[_ProbeIndex].VoronoiProbesStart; }
+
+public:		// METHODS
+
+	SHProbeDatabase();
+	~SHProbeDatabase();
+
+	// Maps the database file in memory and validates its header & offset table
+	bool		Open( const char* _pFileName );
+	void		Close();
+
+	// Fills the runtime probe with the database content (same post-processing as SHProbe::Load(), i.e. world-space samples & albedo/PI)
+	//	_PrepareForRuntime, if false the probe is left in the state it was when written (i.e. relative samples & raw albedo) so it can be written again
+	// NOTE: This copies and converts every field into the SHProbe structure used by the encoder and the network.
+	//	Code that only reads the probes should rather use the Get*() accessors above that point straight into the mapped file.
+	void		ReadProbe( U32 _ProbeIndex, SHProbe& _Probe, bool _PrepareForRuntime=true ) const;
+
+	// Writes the database from an array of freshly encoded probes (i.e. probes in the state they are when saved to a probeset file)
+	static bool	Write( const char* _pFileName, const SHProbe* _pProbes, U32 _ProbesCount, bool _HalfPrecision );
+
+	// Converts the "ProbeXX.probeset" files found in the specified path into a single database file
+	static bool	ConvertFromProbeSets( const char* _pPathToProbes, U32 _ProbesCount, const char* _pFileName, bool _HalfPrecision );
+};
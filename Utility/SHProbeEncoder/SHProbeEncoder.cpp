@@ -1290,12 +1290,12 @@ void	SHProbeEncoder::Pixel::Sort( Pixel*& _pList, ISortKeyProvider& _KeyProvider
 	}
 
 	// Sort
-	Sort( ElementsCount, ms_RadixNodes[0], ms_RadixNodes[1] );
+	RadixNode_t*	pSorted = Sort( ElementsCount, ms_RadixNodes[0], ms_RadixNodes[1] );
 
 	// Rebuild sorted linked-list
 	if ( _ReverseSortOnExit ) {
 		// Reversed, largest to smallest sort
-		RadixNode_t*	pNode = ms_RadixNodes[1];
+		RadixNode_t*	pNode = pSorted;
 		_pList = NULL;
 		for ( U32 i=0; i < ElementsCount; i++, pNode++ ) {
 			pNode->pPixel->pNext = _pList;
@@ -1303,91 +1303,20 @@ void	SHProbeEncoder::Pixel::Sort( Pixel*& _pList, ISortKeyProvider& _KeyProvider
 		}
 	} else {
 		// Standard, smallest to largest sort
-		RadixNode_t*	pNode = ms_RadixNodes[1];
+		RadixNode_t*	pNode = pSorted;
 		for ( U32 i=0; i < ElementsCount-1; i++, pNode++ ) {
 			pNode->pPixel->pNext = pNode[1].pPixel;
 		}
 		pNode->pPixel->pNext = NULL;
-		_pList = ms_RadixNodes[1]->pPixel;
+		_pList = pSorted->pPixel;
 	}
 }
 
-//////////////////////////////////////////////////////////////////////////
-// 11-bits Radix sort from Michael Herf (http://stereopsis.com/radix.html)
-// (without the floating-point sign flipping because we don't care about that here)
-//
-
-// ---- utils for accessing 11-bit quantities
-#define _0(x)	(x & 0x7FF)
-#define _1(x)	(x >> 11 & 0x7FF)
-#define _2(x)	(x >> 22 )
-
-void	SHProbeEncoder::Pixel::Sort( U32 _ElementsCount, RadixNode_t* _pList, RadixNode_t* _pSorted ) {
-	U32		i;
-
-	// 3 histograms on the stack:
-	const U32	kHist = 2048;		// 11 bits
-	U32			b0[kHist * 3];
-	U32*		b1 = b0 + kHist;
-	U32*		b2 = b1 + kHist;
-
-	for ( i = 0; i < kHist * 3; i++ ) {
-		b0[i] = 0;
-	}
-	//memset(b0, 0, kHist * 12);
-
-	// 1. parallel histogramming pass
-	//
-	RadixNode_t*	pNode = _pList;
-	for ( i=0; i < _ElementsCount; i++, pNode++ ) {
-		U32	fi = pNode->Key;
-		b0[_0(fi)]++;
-		b1[_1(fi)]++;
-		b2[_2(fi)]++;
-	}
-	
-	// 2. Sum the histograms -- each histogram entry records the number of values preceding itself.
-	{
-		U32 sum0 = 0, sum1 = 0, sum2 = 0;
-		U32 tsum;
-		for ( i=0; i < kHist; i++ ) {
-
-			tsum = b0[i] + sum0;
-			b0[i] = sum0 - 1;
-			sum0 = tsum;
-
-			tsum = b1[i] + sum1;
-			b1[i] = sum1 - 1;
-			sum1 = tsum;
-
-			tsum = b2[i] + sum2;
-			b2[i] = sum2 - 1;
-			sum2 = tsum;
-		}
-	}
-
-	// byte 0: read/write histogram, write out to sorted
-	pNode = _pList;
-	for ( i=0; i < _ElementsCount; i++, pNode++ ) {
-		U32 fi = pNode->Key;
-		U32 pos = _0(fi);
-		_pSorted[++b0[pos]] = *pNode;
-	}
-
-	// byte 1: read/write histogram, copy sorted -> original
-	pNode = _pSorted;
-	for ( i=0; i < _ElementsCount; i++, pNode++ ) {
-		U32	si = pNode->Key;
-		U32	pos = _1(si);
-		_pList[++b1[pos]] = *pNode;
-	}
-
-	// byte 2: read/write histogram, copy original -> sorted
-	pNode = _pList;
-	for ( i=0; i < _ElementsCount; i++, pNode++ ) {
-		U32 ai = pNode->Key;
-		U32 pos = _2(ai);
-		_pSorted[++b2[pos]] = *pNode;
-	}
+// Radix sort on the 32-bits keys, returns either _pList or _pSorted depending on where the sorted elements ended up
+SHProbeEncoder::Pixel::RadixNode_t*	SHProbeEncoder::Pixel::Sort( U32 _ElementsCount, RadixNode_t* _pList, RadixNode_t* _pSorted ) {
+	struct	NodeKey {
+		U32	operator()( const RadixNode_t& _Node ) const	{ return _Node.Key; }
+	};
+	return BaseLib::RadixSort32( _pList, _ElementsCount, NodeKey(), _pSorted );
 }
 
@@ -189,7 +189,7 @@ private:	// NESTED TYPES
 		};
 		static RadixNode_t*	ms_RadixNodes[2];
 		static void	Sort( Pixel*& _pList, ISortKeyProvider& _KeyProvider, bool _ReverseSortOnExit );	// Directly takes a linked list and builds a sortable list. If reverse is used, list is rebuilt from largest to lowest key.
-		static void	Sort( U32 _ElementsCount, RadixNode_t* _pList, RadixNode_t* _pSorted );				// Takes a sortable list and a temp buffer
+		static RadixNode_t*	Sort( U32 _ElementsCount, RadixNode_t* _pList, RadixNode_t* _pSorted );		// Takes a sortable list and a temp buffer, returns the buffer containing the sorted list
 	};
 
 	// A sample is a collection of pixels averaged as a single position, direction and a set of SH coefficients representing its contribution
@@ -0,0 +1,245 @@
+#include "../../GodComplex.h"
+#include "SHProbeIndex.h"
+
+SHProbeIndex::SHProbeIndex()
+	: m_GridMin( float3::Zero )
+	, m_CellSize( 1.0f )
+	, m_InvCellSize( 1.0f )
+	, m_GridSize( 0 )
+	, m_ProbesCount( 0 )
+	, m_pPositions( NULL )
+	, m_pProbeIDs( NULL )
+	, m_pCellStart( NULL ) {
+}
+
+SHProbeIndex::~SHProbeIndex() {
+	Exit();
+}
+
+void	SHProbeIndex::Exit() {
+	SAFE_DELETE_ARRAY( m_pCellStart );
+	SAFE_DELETE_ARRAY( m_pProbeIDs );
+	SAFE_DELETE_ARRAY( m_pPositions );
+	m_ProbesCount = 0;
+	m_GridSize = 0;
+}
+
+void	SHProbeIndex::Build( const SHProbe* _pProbes, U32 _ProbesCount ) {
+	Exit();
+	if ( _ProbesCount == 0 )
+		return;
+
+	//////////////////////////////////////////////////////////////////////////
+	// 1] Compute the grid dimensions
+	float3	BBoxMin = _pProbes[0].m_wsPosition;
+	float3	BBoxMax = _pProbes[0].m_wsPosition;
+	for ( U32 ProbeIndex=1; ProbeIndex < _ProbesCount; ProbeIndex++ ) {
+		const float3&	Position = _pProbes[ProbeIndex].m_wsPosition;
+		BBoxMin.x = MIN( BBoxMin.x, Position.x );	BBoxMax.x = MAX( BBoxMax.x, Position.x );
+		BBoxMin.y = MIN( BBoxMin.y, Position.y );	BBoxMax.y = MAX( BBoxMax.y, Position.y );
+		BBoxMin.z = MIN( BBoxMin.z, Position.z );	BBoxMax.z = MAX( BBoxMax.z, Position.z );
+	}
+
+	// Choose the largest grid giving at least TARGET_PROBES_PER_CELL probes per cell on average
+	U32	TargetCellsCount = _ProbesCount / TARGET_PROBES_PER_CELL;
+	U32	GridBits = 0;
+	while ( GridBits < MAX_GRID_SUBDIVISION_BITS && (1U << (3*(GridBits+1))) <= TargetCellsCount )
+		GridBits++;
+
+	float	Extent = MAX( 1e-3f, MAX( MAX( BBoxMax.x - BBoxMin.x, BBoxMax.y - BBoxMin.y ), BBoxMax.z - BBoxMin.z ) );
+
+	m_GridMin = BBoxMin;
+	m_GridSize = 1 << GridBits;
+	m_CellSize = 1.001f * Extent / m_GridSize;	// Slightly enlarge so the farthest probes don't end up right on the grid's upper boundary
+	m_InvCellSize = 1.0f / m_CellSize;
+
+	//////////////////////////////////////////////////////////////////////////
+	// 2] Counting sort of the probes by cell
+	U32		CellsCount = m_GridSize * m_GridSize * m_GridSize;
+	m_pCellStart = new U32[CellsCount+1];
+	memset( m_pCellStart, 0, (CellsCount+1)*sizeof(U32) );
+
+	U32*	pProbeCellCodes = new U32[_ProbesCount];
+	for ( U32 ProbeIndex=0; ProbeIndex < _ProbesCount; ProbeIndex++ ) {
+		U32	pCell[3];
+		GetCellCoordinates( _pProbes[ProbeIndex].m_wsPosition, pCell );
+		pProbeCellCodes[ProbeIndex] = MortonCode( pCell[0], pCell[1], pCell[2] );
+		m_pCellStart[pProbeCellCodes[ProbeIndex]+1]++;
+	}
+
+	for ( U32 CellIndex=0; CellIndex < CellsCount; CellIndex++ )
+		m_pCellStart[CellIndex+1] += m_pCellStart[CellIndex];
+
+	m_ProbesCount = _ProbesCount;
+	m_pPositions = new float3[m_ProbesCount];
+	m_pProbeIDs = new U32[m_ProbesCount];
+
+	U32*	pCellCursor = new U32[CellsCount];
+	memcpy( pCellCursor, m_pCellStart, CellsCount*sizeof(U32) );
+	for ( U32 ProbeIndex=0; ProbeIndex < _ProbesCount; ProbeIndex++ ) {
+		U32	SortedIndex = pCellCursor[pProbeCellCodes[ProbeIndex]]++;
+		m_pPositions[SortedIndex] = _pProbes[ProbeIndex].m_wsPosition;
+		m_pProbeIDs[SortedIndex] = _pProbes[ProbeIndex].m_ProbeID;
+	}
+
+	delete[] pCellCursor;
+	delete[] pProbeCellCodes;
+}
+
+U32	SHProbeIndex::FetchNearest( const float3& _Position, float* _pSqDistance ) const {
+	float	SqDistance;
+	U32		SortedIndex = FindNearest( _Position, ~0U, SqDistance );
+	if ( SortedIndex == ~0U )
+		return ~0U;
+
+	if ( _pSqDistance != NULL )
+		*_pSqDistance = SqDistance;
+	return m_pProbeIDs[SortedIndex];
+}
+
+void	SHProbeIndex::FetchNearest( U32 _PositionsCount, const float3* _pPositions, U32* _pProbeIDs ) const {
+	// Batched positions are usually coherent so the previous result is used as a first guess, which gives a tight initial
+	//	search radius and lets us skip most of the cells
+	U32		SortedIndex = ~0U;
+	float	SqDistance;
+	for ( U32 PositionIndex=0; PositionIndex < _PositionsCount; PositionIndex++ ) {
+		SortedIndex = FindNearest( _pPositions[PositionIndex], SortedIndex, SqDistance );
+		_pProbeIDs[PositionIndex] = SortedIndex != ~0U ? m_pProbeIDs[SortedIndex] : ~0U;
+	}
+}
+
+U32	SHProbeIndex::FetchInRadius( const float3& _Position, float _Radius, U32 _MaxProbesCount, U32* _pProbeIDs ) const {
+	if ( m_ProbesCount == 0 )
+		return 0;
+
+	// Compute the range of overlapped cells
+	float	pMin[3] = { (_Position.x - _Radius - m_GridMin.x) * m_InvCellSize, (_Position.y - _Radius - m_GridMin.y) * m_InvCellSize, (_Position.z - _Radius - m_GridMin.z) * m_InvCellSize };
+	float	pMax[3] = { (_Position.x + _Radius - m_GridMin.x) * m_InvCellSize, (_Position.y + _Radius - m_GridMin.y) * m_InvCellSize, (_Position.z + _Radius - m_GridMin.z) * m_InvCellSize };
+	int		pCellMin[3], pCellMax[3];
+	for ( int Axis=0; Axis < 3; Axis++ ) {
+		if ( pMax[Axis] < 0.0f || pMin[Axis] >= float(m_GridSize) )
+			return 0;	// Entirely outside the grid
+		pCellMin[Axis] = MAX( 0, int( floorf( pMin[Axis] ) ) );
+		pCellMax[Axis] = MIN( int(m_GridSize)-1, int( floorf( pMax[Axis] ) ) );
+	}
+
+	// Gather the probes within radius from these cells
+	float	SqRadius = _Radius * _Radius;
+	U32		ProbesCount = 0;
+	for ( int Z=pCellMin[2]; Z <= pCellMax[2]; Z++ )
+		for ( int Y=pCellMin[1]; Y <= pCellMax[1]; Y++ )
+			for ( int X=pCellMin[0]; X <= pCellMax[0]; X++ ) {
+				U32	CellCode = MortonCode( X, Y, Z );
+				U32	End = m_pCellStart[CellCode+1];
+				for ( U32 SortedIndex=m_pCellStart[CellCode]; SortedIndex < End; SortedIndex++ ) {
+					if ( (m_pPositions[SortedIndex] - _Position).LengthSq() > SqRadius )
+						continue;
+					if ( ProbesCount < _MaxProbesCount )
+						_pProbeIDs[ProbesCount] = m_pProbeIDs[SortedIndex];
+					ProbesCount++;
+				}
+			}
+
+	return ProbesCount;
+}
+
+void	SHProbeIndex::FetchInRadius( U32 _PositionsCount, const float3* _pPositions, float _Radius, List< U32 >& _ProbeIDs, U32* _pRangeStart ) const {
+	static const U32	MAX_PROBES_PER_QUERY = 256;
+	U32		pProbeIDs[MAX_PROBES_PER_QUERY];
+
+	_ProbeIDs.Clear();
+	for ( U32 PositionIndex=0; PositionIndex < _PositionsCount; PositionIndex++ ) {
+		_pRangeStart[PositionIndex] = _ProbeIDs.Count();
+
+		U32	ProbesCount = FetchInRadius( _pPositions[PositionIndex], _Radius, MAX_PROBES_PER_QUERY, pProbeIDs );
+		ASSERT( ProbesCount <= MAX_PROBES_PER_QUERY, "Too many probes within radius! Results have been truncated..." );
+		ProbesCount = MIN( ProbesCount, MAX_PROBES_PER_QUERY );
+		for ( U32 ProbeIndex=0; ProbeIndex < ProbesCount; ProbeIndex++ )
+			_ProbeIDs.Append( pProbeIDs[ProbeIndex] );
+	}
+	_pRangeStart[_PositionsCount] = _ProbeIDs.Count();
+}
+
+// Searches the cells in growing rings around the position's cell, until the next ring is guaranteed to be farther than the best probe found so far
+//	_HintIndex, the sorted index of a probe to use as a first guess (or ~0U)
+// Returns the sorted index of the nearest probe
+U32	SHProbeIndex::FindNearest( const float3& _Position, U32 _HintIndex, float& _SqDistance ) const {
+	if ( m_ProbesCount == 0 )
+		return ~0U;
+
+	U32		BestIndex = ~0U;
+	float	BestSqDistance = MAX_FLOAT;
+	if ( _HintIndex != ~0U ) {
+		BestIndex = _HintIndex;
+		BestSqDistance = (m_pPositions[_HintIndex] - _Position).LengthSq();
+	}
+
+	U32		pCell[3];
+	GetCellCoordinates( _Position, pCell );
+	float	pGridPosition[3] = { (_Position.x - m_GridMin.x) * m_InvCellSize, (_Position.y - m_GridMin.y) * m_InvCellSize, (_Position.z - m_GridMin.z) * m_InvCellSize };
+
+	int		GridSize = int(m_GridSize);
+	int		MaxRing = 0;
+	for ( int Axis=0; Axis < 3; Axis++ )
+		MaxRing = MAX( MaxRing, MAX( int(pCell[Axis]), GridSize-1-int(pCell[Axis]) ) );
+
+	int		CX = int(pCell[0]), CY = int(pCell[1]), CZ = int(pCell[2]);
+	for ( int Ring=0; Ring <= MaxRing; Ring++ ) {
+		if ( Ring > 0 ) {
+			// All the cells of that ring lie outside the box of cells of the previous rings so the distance to that box is a lower bound
+			float	Bound = MAX_FLOAT;
+			for ( int Axis=0; Axis < 3; Axis++ ) {
+				float	BoxMin = float(int(pCell[Axis]) - (Ring-1));
+				float	BoxMax = float(int(pCell[Axis]) + Ring);
+				float	P = pGridPosition[Axis];
+				if ( P < BoxMin || P > BoxMax ) {
+					Bound = 0.0f;	// Position is outside the grid, no bound
+					break;
+				}
+				Bound = MIN( Bound, MIN( P - BoxMin, BoxMax - P ) );
+			}
+			Bound *= m_CellSize;
+			if ( Bound * Bound >= BestSqDistance )
+				break;	// No closer probe can be found
+		}
+
+		// Search the cells of the ring
+		for ( int Z=MAX( 0, CZ-Ring ); Z <= MIN( GridSize-1, CZ+Ring ); Z++ ) {
+			bool	OnShellZ = Z == CZ-Ring || Z == CZ+Ring;
+			for ( int Y=MAX( 0, CY-Ring ); Y <= MIN( GridSize-1, CY+Ring ); Y++ ) {
+				bool	OnShell = OnShellZ || Y == CY-Ring || Y == CY+Ring;
+				int		StepX = OnShell ? 1 : 2*Ring;	// Inside the shell, only the 2 extreme cells on X belong to the ring
+				for ( int X=CX-Ring; X <= CX+Ring; X+=StepX ) {
+					if ( X < 0 || X >= GridSize )
+						continue;
+
+					U32	CellCode = MortonCode( X, Y, Z );
+					U32	End = m_pCellStart[CellCode+1];
+					for ( U32 SortedIndex=m_pCellStart[CellCode]; SortedIndex < End; SortedIndex++ ) {
+						float	SqDistance = (m_pPositions[SortedIndex] - _Position).LengthSq();
+						if ( SqDistance < BestSqDistance ) {
+							BestSqDistance = SqDistance;
+							BestIndex = SortedIndex;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	_SqDistance = BestSqDistance;
+	return BestIndex;
+}
+
+void	SHProbeIndex::GetCellCoordinates( const float3& _Position, U32 _pCell[3] ) const {
+	float	pGridPosition[3] = { (_Position.x - m_GridMin.x) * m_InvCellSize, (_Position.y - m_GridMin.y) * m_InvCellSize, (_Position.z - m_GridMin.z) * m_InvCellSize };
+	for ( int Axis=0; Axis < 3; Axis++ )
+		_pCell[Axis] = U32( MIN( float(m_GridSize-1), MAX( 0.0f, floorf( pGridPosition[Axis] ) ) ) );
+}
+
+U32	SHProbeIndex::MortonCode( U32 _X, U32 _Y, U32 _Z ) {
+	U32	Code = 0;
+	for ( U32 Bit=0; Bit < MAX_GRID_SUBDIVISION_BITS; Bit++ )
+		Code |= (((_X >> Bit) & 1) << (3*Bit)) | (((_Y >> Bit) & 1) << (3*Bit+1)) | (((_Z >> Bit) & 1) << (3*Bit+2));
+	return Code;
+}
@@ -0,0 +1,74 @@
+//////////////////////////////////////////////////////////////////////////
+// SH Probe Spatial Index
+//
+// Flat spatial index of the probes, queried by dynamic objects to find the probe(s) they should use.
+//
+// Probes are bucketed into a cubic uniform grid of 2^N cells per axis whose cells are numbered by their Morton code.
+// Probes are then counting-sorted by cell so each cell is a compact range [CellStart[Code], CellStart[Code+1]) into a single
+//	array of positions and IDs, and cells that are close in space are also close in memory.
+//
+// Compared to the octree we used before, a query doesn't chase any pointer: it only reads a handful of contiguous cell
+//	ranges around the query position. Rebuilding the index is O(ProbesCount + CellsCount) and takes well under a millisecond
+//	for a few thousand probes.
+//
+#pragma once
+
+#include "SHProbe.h"
+
+class	SHProbeIndex {
+public:		// CONSTANTS
+
+	static const U32		MAX_GRID_SUBDIVISION_BITS = 6;		// At most 64x64x64 cells
+	static const U32		TARGET_PROBES_PER_CELL = 2;
+
+private:	// FIELDS
+
+	float3			m_GridMin;
+	float			m_CellSize;
+	float			m_InvCellSize;
+	U32				m_GridSize;					// Amount of cells on each axis (a power of 2)
+
+	U32				m_ProbesCount;
+	float3*			m_pPositions;				// Probe positions, sorted by cell
+	U32*			m_pProbeIDs;				// Probe IDs, sorted by cell
+
+	U32*			m_pCellStart;				// Start index of each cell's probes, indexed by the cell's Morton code (CellsCount+1 entries)
+
+public:		// PROPERTIES
+
+	U32				GetProbesCount() const	{ return m_ProbesCount; }
+
+public:		// METHODS
+
+	SHProbeIndex();
+	~SHProbeIndex();
+
+	// (Re)Builds the index from the current probe positions
+	void	Build( const SHProbe* _pProbes, U32 _ProbesCount );
+	void	Exit();
+
+	// Finds the probe nearest to the provided position
+	//	_pSqDistance, an optional pointer receiving the square distance to the nearest probe
+	// Returns the ID of the nearest probe or ~0U if the index is empty
+	U32		FetchNearest( const float3& _Position, float* _pSqDistance=NULL ) const;
+
+	// Finds the probes nearest to a batch of positions
+	//	_pProbeIDs, an array of _PositionsCount entries receiving the ID of the nearest probe for each position
+	void	FetchNearest( U32 _PositionsCount, const float3* _pPositions, U32* _pProbeIDs ) const;
+
+	// Finds all the probes within the provided radius of a position
+	//	_pProbeIDs, an array of _MaxProbesCount entries receiving the IDs of the probes within radius
+	// Returns the total amount of probes within radius (which can be larger than _MaxProbesCount, only the first _MaxProbesCount are written)
+	U32		FetchInRadius( const float3& _Position, float _Radius, U32 _MaxProbesCount, U32* _pProbeIDs ) const;
+
+	// Finds all the probes within the provided radius of a batch of positions
+	//	_ProbeIDs, the list receiving the IDs of the probes within radius of each position, one range after another
+	//	_pRangeStart, an array of _PositionsCount+1 entries receiving the start of each position's range in _ProbeIDs
+	void	FetchInRadius( U32 _PositionsCount, const float3* _pPositions, float _Radius, List< U32 >& _ProbeIDs, U32* _pRangeStart ) const;
+
+private:
+
+	U32		FindNearest( const float3& _Position, U32 _HintIndex, float& _SqDistance ) const;
+	void	GetCellCoordinates( const float3& _Position, U32 _pCell[3] ) const;
+	static U32	MortonCode( U32 _X, U32 _Y, U32 _Z );
+};
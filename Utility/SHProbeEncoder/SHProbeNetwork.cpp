@@ -1,4 +1,6 @@
 #include "../../GodComplex.h"
+#include "../../BaseLib/Utility/Parallel.h"
+#include <xmmintrin.h>
 
 #define CHECK_MATERIAL( pMaterial, ErrorCode )		if ( (pMaterial)->HasErrors() ) m_ErrorCode = ErrorCode;
 
@@ -8,15 +10,14 @@ SHProbeNetwork::SHProbeNetwork()
 	, m_ProbesCount( 0 )
 	, m_MaxProbesCount( 0 )
 	, m_pProbes( NULL )
-	, m_pPrimProbeIDs( NULL )
-	, m_ProbeUpdateIndex( 0 ) {
+	, m_pPrimProbeIDs( NULL ) {
 }
 
 SHProbeNetwork::~SHProbeNetwork() {
 	Exit();
 }
 
-void	SHProbeNetwork::Init( Device& _Device, Primitive& _ScreenQuad ) {
+void	SHProbeNetwork::Init( Device& _Device, Primitive& _ScreenQuad, const IVertexFormatDescriptor& _SceneVertexFormat, D3D_SHADER_MACRO* _pSceneMacros ) {
 	m_ProbeEncoder.m_pOwner = this;
 
 	m_pDevice = &_Device;
@@ -46,6 +47,13 @@ void	SHProbeNetwork::Init( Device& _Device, Primitive& _ScreenQuad ) {
 	}
 	m_pSB_RuntimeProbeSamplesSH->Write();
 
+	// Also keep them as SoA for the CPU update
+	for ( int SampleIndex=0; SampleIndex < SHProbe::SAMPLES_COUNT; SampleIndex++ ) {
+		const double*	SH = m_ProbeEncoder.GetSampleSHCoefficients( SampleIndex );
+		for ( int SHCoeffIndex=0; SHCoeffIndex < 9; SHCoeffIndex++ )
+			m_pSampleSHSoA[SHCoeffIndex*SHProbe::SAMPLES_COUNT+SampleIndex] = float( SH[SHCoeffIndex] );
+	}
+
 	m_ppSB_RuntimeSHStatic[0] = NULL;
 	m_ppSB_RuntimeSHStatic[1] = NULL;
 	m_pSB_RuntimeSHAmbient = NULL;
@@ -56,10 +64,12 @@ void	SHProbeNetwork::Init( Device& _Device, Primitive& _ScreenQuad ) {
 
 	//////////////////////////////////////////////////////////////////////////
 	// Create shaders
+	// The cube map material depends on the scene vertex format so it's not reloaded from binary
+	CHECK_MATERIAL( m_pMatRenderCubeMap = CreateMaterial( IDR_SHADER_GI_RENDER_CUBEMAP, "./Resources/Shaders/GIRenderCubeMap.hlsl", _SceneVertexFormat, "VS", NULL, "PS", _pSceneMacros ), 0 );
+
 	{
 ScopedForceMaterialsLoadFromBinary		bisou;
 
-		CHECK_MATERIAL( m_pMatRenderCubeMap = CreateMaterial( IDR_SHADER_GI_RENDER_CUBEMAP, "./Resources/Shaders/GIRenderCubeMap.hlsl", VertexFormatP3N3G3B3T2::DESCRIPTOR, "VS", NULL, "PS" ), 0 );
  		CHECK_MATERIAL( m_pMatRenderNeighborProbe = CreateMaterial( IDR_SHADER_GI_RENDER_NEIGHBOR_PROBE, "./Resources/Shaders/GIRenderNeighborProbe.hlsl", VertexFormatPt4::DESCRIPTOR, "VS", NULL, "PS" ), 1 );
 	}
 
@@ -78,6 +88,9 @@ ScopedForceMaterialsLoadFromBinary	bisou;
 }
 
 void	SHProbeNetwork::Exit() {
+	m_UpdateScheduler.Exit();
+	m_ProbeIndex.Exit();
+
 	m_ProbesCount = 0;
 	SAFE_DELETE_ARRAY( m_pProbes );
 
@@ -122,10 +135,6 @@ void	SHProbeNetwork::AddProbe( Scene::Probe& _Probe ) {
 }
 
 void	SHProbeNetwork::UpdateDynamicProbes( DynamicUpdateParms& _Parms ) {
-//	ASSERT( m_ProbesCount <= MAX_PROBE_UPDATES_PER_FRAME, "Increase max probes update per frame! Or write the time-sliced updater you promised!" );
-
-	U32		ProbeUpdatesCount = MIN( _Parms.MaxProbeUpdatesPerFrame, U32(m_ProbesCount) );
-
 	// Prepare constant buffer for update
 	m_pCB_UpdateProbes->m.SunBoost = _Parms.BounceFactorSun;
 	m_pCB_UpdateProbes->m.SkyBoost = _Parms.BounceFactorSky;
@@ -138,8 +147,29 @@ void	SHProbeNetwork::UpdateDynamicProbes( DynamicUpdateParms& _Parms ) {
 
 	m_pCB_UpdateProbes->UpdateData();
 
+	// Ask the scheduler for the most important probes to update this frame
+	SHProbeUpdateScheduler::ScheduleParms	ScheduleParms;
+	ScheduleParms.wsCameraPosition = _Parms.wsCameraPosition;
+	ScheduleParms.World2Proj = _Parms.World2Proj;
+	ScheduleParms.DynamicLightsCount = _Parms.DynamicLightsCount;
+	ScheduleParms.pDynamicLights = _Parms.pDynamicLights;
+
+	U32		pProbeIndices[MAX_PROBE_UPDATES_PER_FRAME];
+	U32		ProbeUpdatesCount = m_UpdateScheduler.Schedule( m_pProbes, ScheduleParms, MIN( _Parms.MaxProbeUpdatesPerFrame, MAX_PROBE_UPDATES_PER_FRAME ), pProbeIndices );
+
+	if ( _Parms.UseCPUUpdate )
+		UpdateDynamicProbesCPU( _Parms, ProbeUpdatesCount, pProbeIndices );
+	else
+		UpdateDynamicProbesGPU( _Parms, ProbeUpdatesCount, pProbeIndices );
 
-#if 1	// Hardware update
+	// =========================================================
+	// Setup the input buffers for scene rendering
+	m_pSB_RuntimeProbes->SetInput( 7, true );
+	m_pSB_RuntimeSHFinal->SetInput( 8, true );
+	m_pSB_ProbeNeighbors->SetInput( 9, true );
+}
+
+void	SHProbeNetwork::UpdateDynamicProbesGPU( const DynamicUpdateParms& _Parms, U32 _ProbeUpdatesCount, const U32* _pProbeIndices ) {
 	// We prepare the update structures for each probe and send them to the compute shader
 	// . The compute shader will then evaluate lighting for all the samples of each probe, use their contribution to weight
 	//		each sample's SH coefficients that will be added together to form the indirect lighting SH coefficients.
@@ -150,18 +180,12 @@ void	SHProbeNetwork::UpdateDynamicProbes( DynamicUpdateParms& _Parms ) {
 	//
 	// Basically for every probe update, we perform 1(sky)+4(neighbor) expensive SH products and compute lighting for at most 128 samples in the scene
 	//
-//TODO: Handle a proper stack of probes to update
 
 	// Prepare the buffer of probe update infos and sampling point infos
 	RuntimeProbeUpdateSampleInfo*	pSampleUpdateInfos = m_pSB_RuntimeProbeSamples->m;
 	int		TotalEmissiveSurfacesCount = 0;
-	for ( U32 ProbeUpdateIndex=0; ProbeUpdateIndex < ProbeUpdatesCount; ProbeUpdateIndex++ ) {
-		// Simple at the moment, when we have the update stack we'll have to fetch the index from it...
-//		int			ProbeIndex = ProbeUpdateIndex;
-
-		// Still simple: we update N probes each frame in sequence, next frame we'll update the next N ones...
-		int			ProbeIndex = (m_ProbeUpdateIndex + ProbeUpdateIndex) % m_ProbesCount;
-
+	for ( U32 ProbeUpdateIndex=0; ProbeUpdateIndex < _ProbeUpdatesCount; ProbeUpdateIndex++ ) {
+		U32			ProbeIndex = _pProbeIndices[ProbeUpdateIndex];
 		SHProbe&	Probe = m_pProbes[ProbeIndex];
 
 		// Fill the probe update infos
@@ -210,15 +234,15 @@ void	SHProbeNetwork::UpdateDynamicProbes( DynamicUpdateParms& _Parms ) {
 
 	// =========================================================
 	// Do the update!
-	{
+	if ( _ProbeUpdatesCount > 0 ) {
 		USING_COMPUTESHADER_START( *m_pCSUpdateProbeDynamicSH )
 
 		m_pSB_RuntimeSHFinal->SetInput( 8, true );	// Feed last frame's SH for neighbor bounce
 
-		m_pSB_RuntimeProbeUpdateInfos->Write( ProbeUpdatesCount );
+		m_pSB_RuntimeProbeUpdateInfos->Write( _ProbeUpdatesCount );
 		m_pSB_RuntimeProbeUpdateInfos->SetInput( 10 );
 
-		m_pSB_RuntimeProbeSamples->Write( ProbeUpdatesCount * SHProbe::SAMPLES_COUNT );
+		m_pSB_RuntimeProbeSamples->Write( _ProbeUpdatesCount * SHProbe::SAMPLES_COUNT );
 		m_pSB_RuntimeProbeSamples->SetInput( 11 );
 
 		m_pSB_RuntimeProbeEmissiveSurfaces->Write( TotalEmissiveSurfacesCount );
@@ -229,118 +253,261 @@ void	SHProbeNetwork::UpdateDynamicProbes( DynamicUpdateParms& _Parms ) {
 		m_pSB_RuntimeSHDynamic->SetOutput( 0 );
 		m_pSB_RuntimeSHDynamicSun->SetOutput( 1 );
 
-		M.Dispatch( ProbeUpdatesCount, 1, 1 );
+		M.Dispatch( _ProbeUpdatesCount, 1, 1 );
 
 		m_pSB_RuntimeSHFinal->RemoveFromLastAssignedSlots();	// So we can bind it as output later
 
 		USING_COMPUTE_SHADER_END
 	}
 
-	// Advance probe update index
-	if ( m_ProbesCount > 0 )
-		m_ProbeUpdateIndex = (m_ProbeUpdateIndex + ProbeUpdatesCount) % m_ProbesCount;
-
-#else
-	// Software update (no shadows!)
-	for ( int ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ )
+	// =========================================================
+	// Perform the final accumulation of all the SH sources
 	{
-		SHProbe&	Probe = m_pProbes[ProbeIndex];
+		USING_COMPUTESHADER_START( *m_pCSAccumulateProbeSH )
 
-		// Clear light accumulation for the probe
-		Probe.ClearLightBounce( pSHAmbient );
+		m_ppSB_RuntimeSHStatic[0]->SetInput( 10 );
+		m_pSB_RuntimeSHAmbient->SetInput( 11 );
+		m_pSB_RuntimeSHDynamic->SetInput( 12 );
+		m_pSB_RuntimeSHDynamicSun->SetInput( 13 );
 
-		// Iterate on each patch and compute energy level
-		for ( U32 SetIndex=0; SetIndex < Probe.SurfacesCount; SetIndex++ )
-		{
-			const SHProbe::Surface&	Set = Probe.pSurfaces[SetIndex];
+		m_pSB_RuntimeSHFinal->SetOutput( 0 );
 
-			// Compute irradiance for every sample
-			float3	SetIrradiance = float3::Zero;
-			for ( U32 SampleIndex=0; SampleIndex < Set.SamplesCount; SampleIndex++ )
-			{
-				const SHProbe::Surface::Sample&	Sample = Set.pSamples[SampleIndex];
+		int	GroupsCount = (m_ProbesCount + 0xFF) >> 8;	// 256 threads per group
+		M.Dispatch( GroupsCount, 1, 1 );
 
-				// Compute irradiance from every light
-				for ( int LightIndex=0; LightIndex < m_pCB_Scene->m.DynamicLightsCount; LightIndex++ )
-				{
-					const LightStruct&	Light = m_pSB_LightsDynamic->m[LightIndex];
+		m_pSB_RuntimeSHDynamic->RemoveFromLastAssignedSlots();	// So we can bind them as output for next frame update
+		m_pSB_RuntimeSHDynamicSun->RemoveFromLastAssignedSlots();
 
-					// Compute light vector
-					float3	Set2Light = Light.Position - Sample.Position;
-					float		DistanceProbe2Light = Set2Light.Length();
-					float		InvDistance = 1.0f / DistanceProbe2Light;
-					Set2Light = Set2Light * InvDistance;
+		USING_COMPUTE_SHADER_END
+	}
+}
 
-					float		NdotL = MAX( 0.0f, Set2Light | Sample.Normal );
-					float3	LightIrradiance = Light.Color * NdotL * InvDistance * InvDistance;	// I=E.(N.L)/r
+//////////////////////////////////////////////////////////////////////////
+// CPU update
+// Mirrors the GIUpdateProbe.hlsl compute shaders so the dynamic update can run and be validated without them:
+//	1] Light the samples of each probe and accumulate their radiance into SH (SSE, 4 samples at a time)
+//	2] Add emissive surfaces and neighbor probes contributions, then filter
+//	3] Accumulate static + sky + dynamic + sun SH into the final SH
+//
+// NOTE: Shadow maps are not available on the CPU so lights are not shadowed.
+//
+namespace {
+
+	// Samples of a single probe in SoA form
+	struct	SamplesSoA {
+		__m128	pPositionX[SHProbe::SAMPLES_COUNT/4];
+		__m128	pPositionY[SHProbe::SAMPLES_COUNT/4];
+		__m128	pPositionZ[SHProbe::SAMPLES_COUNT/4];
+		__m128	pNormalX[SHProbe::SAMPLES_COUNT/4];
+		__m128	pNormalY[SHProbe::SAMPLES_COUNT/4];
+		__m128	pNormalZ[SHProbe::SAMPLES_COUNT/4];
+		__m128	pAlbedoR[SHProbe::SAMPLES_COUNT/4];
+		__m128	pAlbedoG[SHProbe::SAMPLES_COUNT/4];
+		__m128	pAlbedoB[SHProbe::SAMPLES_COUNT/4];
+		__m128	pValid[SHProbe::SAMPLES_COUNT/4];		// All bits set for samples with a non-zero radius
+	};
 
-					SetIrradiance = SetIrradiance + LightIrradiance;
-				}
+	inline __m128	Saturate_SSE( __m128 _Value ) {
+		return _mm_min_ps( _mm_max_ps( _Value, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+	}
+
+	inline float	HorizontalSum_SSE( __m128 _Value ) {
+		__m128	Temp = _mm_add_ps( _Value, _mm_movehl_ps( _Value, _Value ) );
+		Temp = _mm_add_ss( Temp, _mm_shuffle_ps( Temp, Temp, 1 ) );
+		return _mm_cvtss_f32( Temp );
+	}
+
+	// Lights the samples and accumulates their radiance, weighted by each sample direction's SH, into _pSH (dynamic lights) and _pSHSun (directional lights)
+	void	AccumulateSamplesSH_SSE( const SamplesSoA& _Samples, const float* _pSampleSHSoA, U32 _LightsCount, const SHProbeUpdateScheduler::DynamicLight* _pLights, float3 _pSH[9], float3 _pSHSun[9] ) {
+		const __m128	Zero = _mm_setzero_ps();
+		const __m128	One = _mm_set1_ps( 1.0f );
+		const __m128	Half = _mm_set1_ps( 0.5f );
+
+		__m128	pAccum[9][3];
+		__m128	pAccumSun[9][3];
+		for ( int i=0; i < 9; i++ )
+			for ( int c=0; c < 3; c++ ) {
+				pAccum[i][c] = Zero;
+				pAccumSun[i][c] = Zero;
 			}
 
-			// Average lighting
-			SetIrradiance = SetIrradiance / float(Set.SamplesCount);
+		for ( U32 BlockIndex=0; BlockIndex < SHProbe::SAMPLES_COUNT/4; BlockIndex++ ) {
+			__m128	Px = _Samples.pPositionX[BlockIndex];
+			__m128	Py = _Samples.pPositionY[BlockIndex];
+			__m128	Pz = _Samples.pPositionZ[BlockIndex];
+			__m128	Nx = _Samples.pNormalX[BlockIndex];
+			__m128	Ny = _Samples.pNormalY[BlockIndex];
+			__m128	Nz = _Samples.pNormalZ[BlockIndex];
+
+			__m128	Er = Zero, Eg = Zero, Eb = Zero;
+			__m128	ESunr = Zero, ESung = Zero, ESunb = Zero;
+			for ( U32 LightIndex=0; LightIndex < _LightsCount; LightIndex++ ) {
+				const SHProbeUpdateScheduler::DynamicLight&	Light = _pLights[LightIndex];
+
+				if ( Light.Type == Scene::Light::DIRECTIONAL ) {
+					__m128	NdotL = Saturate_SSE( _mm_add_ps( _mm_add_ps( _mm_mul_ps( Nx, _mm_set1_ps( Light.Direction.x ) ), _mm_mul_ps( Ny, _mm_set1_ps( Light.Direction.y ) ) ), _mm_mul_ps( Nz, _mm_set1_ps( Light.Direction.z ) ) ) );
+					ESunr = _mm_add_ps( ESunr, _mm_mul_ps( NdotL, _mm_set1_ps( Light.Color.x ) ) );
+					ESung = _mm_add_ps( ESung, _mm_mul_ps( NdotL, _mm_set1_ps( Light.Color.y ) ) );
+					ESunb = _mm_add_ps( ESunb, _mm_mul_ps( NdotL, _mm_set1_ps( Light.Color.z ) ) );
+					continue;
+				}
 
-			// Transform this into SH
-			float3	pSetSH[9];
-			for ( int i=0; i < 9; i++ )
-				pSetSH[i] = SetIrradiance * Set.pSHBounce[i];	// Simply irradiance * (Rho/PI) encoded as SH
+				// Point or spot light
+				__m128	Lx = _mm_sub_ps( _mm_set1_ps( Light.Position.x ), Px );
+				__m128	Ly = _mm_sub_ps( _mm_set1_ps( Light.Position.y ), Py );
+				__m128	Lz = _mm_sub_ps( _mm_set1_ps( Light.Position.z ), Pz );
+				__m128	Distance = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( Lx, Lx ), _mm_mul_ps( Ly, Ly ) ), _mm_mul_ps( Lz, Lz ) ) );
+				__m128	InvDistance = _mm_div_ps( One, _mm_max_ps( Distance, _mm_set1_ps( 1e-6f ) ) );
+				Lx = _mm_mul_ps( Lx, InvDistance );
+				Ly = _mm_mul_ps( Ly, InvDistance );
+				Lz = _mm_mul_ps( Lz, InvDistance );
+
+				__m128	NdotL = Saturate_SSE( _mm_add_ps( _mm_add_ps( _mm_mul_ps( Nx, Lx ), _mm_mul_ps( Ny, Ly ) ), _mm_mul_ps( Nz, Lz ) ) );
+				__m128	InvDistance2Light = _mm_div_ps( One, _mm_max_ps( Half, Distance ) );	// Try and avoid highlights when lights get too close to the sample
+				__m128	Factor = _mm_mul_ps( NdotL, _mm_mul_ps( InvDistance2Light, InvDistance2Light ) );
+
+				if ( Light.Type == Scene::Light::SPOT ) {
+					// Account for spots' angular falloff (smoothstep)
+					__m128	LdotD = _mm_sub_ps( Zero, _mm_add_ps( _mm_add_ps( _mm_mul_ps( Lx, _mm_set1_ps( Light.Direction.x ) ), _mm_mul_ps( Ly, _mm_set1_ps( Light.Direction.y ) ) ), _mm_mul_ps( Lz, _mm_set1_ps( Light.Direction.z ) ) ) );
+					__m128	t = Saturate_SSE( _mm_mul_ps( _mm_sub_ps( LdotD, _mm_set1_ps( Light.Parms.w ) ), _mm_set1_ps( 1.0f / MAX( 1e-6f, Light.Parms.z - Light.Parms.w ) ) ) );
+					Factor = _mm_mul_ps( Factor, _mm_mul_ps( _mm_mul_ps( t, t ), _mm_sub_ps( _mm_set1_ps( 3.0f ), _mm_add_ps( t, t ) ) ) );
+				}
+
+				Er = _mm_add_ps( Er, _mm_mul_ps( Factor, _mm_set1_ps( Light.Color.x ) ) );
+				Eg = _mm_add_ps( Eg, _mm_mul_ps( Factor, _mm_set1_ps( Light.Color.y ) ) );
+				Eb = _mm_add_ps( Eb, _mm_mul_ps( Factor, _mm_set1_ps( Light.Color.z ) ) );
+			}
 
-			// Accumulate to total SH for the probe
-			Probe.AccumulateLightBounce( pSetSH );
+			// Radiance = Irradiance * Albedo, discarding invalid samples
+			__m128	Valid = _Samples.pValid[BlockIndex];
+			__m128	Ar = _mm_and_ps( Valid, _Samples.pAlbedoR[BlockIndex] );
+			__m128	Ag = _mm_and_ps( Valid, _Samples.pAlbedoG[BlockIndex] );
+			__m128	Ab = _mm_and_ps( Valid, _Samples.pAlbedoB[BlockIndex] );
+			__m128	Rr = _mm_mul_ps( Er, Ar ), Rg = _mm_mul_ps( Eg, Ag ), Rb = _mm_mul_ps( Eb, Ab );
+			__m128	RSunr = _mm_mul_ps( ESunr, Ar ), RSung = _mm_mul_ps( ESung, Ag ), RSunb = _mm_mul_ps( ESunb, Ab );
+
+			// Accumulate into SH
+			for ( int i=0; i < 9; i++ ) {
+				__m128	SH = _mm_loadu_ps( _pSampleSHSoA + i*SHProbe::SAMPLES_COUNT + 4*BlockIndex );
+				pAccum[i][0] = _mm_add_ps( pAccum[i][0], _mm_mul_ps( Rr, SH ) );
+				pAccum[i][1] = _mm_add_ps( pAccum[i][1], _mm_mul_ps( Rg, SH ) );
+				pAccum[i][2] = _mm_add_ps( pAccum[i][2], _mm_mul_ps( Rb, SH ) );
+				pAccumSun[i][0] = _mm_add_ps( pAccumSun[i][0], _mm_mul_ps( RSunr, SH ) );
+				pAccumSun[i][1] = _mm_add_ps( pAccumSun[i][1], _mm_mul_ps( RSung, SH ) );
+				pAccumSun[i][2] = _mm_add_ps( pAccumSun[i][2], _mm_mul_ps( RSunb, SH ) );
+			}
+		}
+
+		for ( int i=0; i < 9; i++ ) {
+			_pSH[i].Set( HorizontalSum_SSE( pAccum[i][0] ), HorizontalSum_SSE( pAccum[i][1] ), HorizontalSum_SSE( pAccum[i][2] ) );
+			_pSHSun[i].Set( HorizontalSum_SSE( pAccumSun[i][0] ), HorizontalSum_SSE( pAccumSun[i][1] ), HorizontalSum_SSE( pAccumSun[i][2] ) );
 		}
 	}
+}
 
-	// Write to the runtime structured buffer
-	for ( int ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ )
-	{
+void	SHProbeNetwork::UpdateDynamicProbesCPU( const DynamicUpdateParms& _Parms, U32 _ProbeUpdatesCount, const U32* _pProbeIndices ) {
+	SamplesSoA	Samples;
+	for ( U32 ProbeUpdateIndex=0; ProbeUpdateIndex < _ProbeUpdatesCount; ProbeUpdateIndex++ ) {
+		U32			ProbeIndex = _pProbeIndices[ProbeUpdateIndex];
 		SHProbe&	Probe = m_pProbes[ProbeIndex];
-		RuntimeProbe&	Runtime = m_pSB_RuntimeProbes->m[ProbeIndex];
 
-		// Write the result to the probe structured buffer
-		memcpy( Runtime.pSHBounce, Probe.pSHBouncedLight, 9*sizeof(float3) );
-	}
+		//////////////////////////////////////////////////////////////////////////
+		// 1] Light the samples
+		float*	pPositionX = (float*) Samples.pPositionX;
+		float*	pPositionY = (float*) Samples.pPositionY;
+		float*	pPositionZ = (float*) Samples.pPositionZ;
+		float*	pNormalX = (float*) Samples.pNormalX;
+		float*	pNormalY = (float*) Samples.pNormalY;
+		float*	pNormalZ = (float*) Samples.pNormalZ;
+		float*	pAlbedoR = (float*) Samples.pAlbedoR;
+		float*	pAlbedoG = (float*) Samples.pAlbedoG;
+		float*	pAlbedoB = (float*) Samples.pAlbedoB;
+		U32*	pValid = (U32*) Samples.pValid;
+
+		const SHProbe::Sample*	pSample = Probe.m_pSamples;
+		for ( U32 SampleIndex=0; SampleIndex < SHProbe::SAMPLES_COUNT; SampleIndex++, pSample++ ) {
+			pPositionX[SampleIndex] = pSample->Position.x;
+			pPositionY[SampleIndex] = pSample->Position.y;
+			pPositionZ[SampleIndex] = pSample->Position.z;
+			pNormalX[SampleIndex] = pSample->Normal.x;
+			pNormalY[SampleIndex] = pSample->Normal.y;
+			pNormalZ[SampleIndex] = pSample->Normal.z;
+			pAlbedoR[SampleIndex] = pSample->SHFactor * pSample->Albedo.x;
+			pAlbedoG[SampleIndex] = pSample->SHFactor * pSample->Albedo.y;
+			pAlbedoB[SampleIndex] = pSample->SHFactor * pSample->Albedo.z;
+			pValid[SampleIndex] = pSample->Radius > 0.0f ? ~0U : 0U;
+		}
 
-	m_pSB_RuntimeProbes->Write();
+		float3	pSHDynamic[9];
+		float3	pSHDynamicSun[9];
+		AccumulateSamplesSH_SSE( Samples, m_pSampleSHSoA, _Parms.DynamicLightsCount, _Parms.pDynamicLights, pSHDynamic, pSHDynamicSun );
 
-#endif
+		//////////////////////////////////////////////////////////////////////////
+		// 2] Add emissive surfaces
+		for ( U32 EmissiveSurfaceIndex=0; EmissiveSurfaceIndex < Probe.m_EmissiveSurfacesCount; EmissiveSurfaceIndex++ ) {
+			const SHProbe::EmissiveSurface&	EmissiveSurface = Probe.m_pEmissiveSurfaces[EmissiveSurfaceIndex];
 
-	// =========================================================
-	// Perform the final accumulation of all the SH sources
-	{
-		USING_COMPUTESHADER_START( *m_pCSAccumulateProbeSH )
+			ASSERT( _Parms.pQueryMaterial != NULL, "Invalid material query functor!" );
+			Scene::Material*	pEmissiveMaterial = (*_Parms.pQueryMaterial)( EmissiveSurface.MaterialID );
+			ASSERT( pEmissiveMaterial != NULL, "Invalid emissive material!" );
 
-		m_ppSB_RuntimeSHStatic[0]->SetInput( 10 );
-		m_pSB_RuntimeSHAmbient->SetInput( 11 );
-		m_pSB_RuntimeSHDynamic->SetInput( 12 );
-		m_pSB_RuntimeSHDynamicSun->SetInput( 13 );
+			float3	EmissiveColor = _Parms.BounceFactorEmissive * pEmissiveMaterial->m_EmissiveColor;
+			for ( int i=0; i < 9; i++ )
+				pSHDynamic[i] = pSHDynamic[i] + EmissiveSurface.pSH[i] * EmissiveColor;
+		}
 
-		m_pSB_RuntimeSHFinal->SetOutput( 0 );
+		// Add neighbor probes' contribution using last frame's final SH
+		U32	NeighborsCount = MIN( MAX_PROBE_NEIGHBORS, Probe.m_NeighborProbes.Count() );
+		for ( U32 NeighborIndex=0; NeighborIndex < NeighborsCount; NeighborIndex++ ) {
+			const SHProbe::NeighborProbeInfo&	Neighbor = Probe.m_NeighborProbes[NeighborIndex];
+			if ( Neighbor.ProbeID >= m_ProbesCount )
+				continue;
 
-		int	GroupsCount = (m_ProbesCount + 0xFF) >> 8;	// 256 threads per group
-		M.Dispatch( GroupsCount, 1, 1 );
+			float3	pPerceivedNeighborSH[9];
+			SH::Product3( m_pSB_RuntimeSHFinal->m[Neighbor.ProbeID].pSH, Neighbor.SH, pPerceivedNeighborSH );	// This is the SH this probe can see from its neighbor
+			for ( int i=0; i < 9; i++ )
+				pSHDynamic[i] = pSHDynamic[i] + _Parms.BounceFactorNeighbors * pPerceivedNeighborSH[i];
+		}
 
-		m_pSB_RuntimeSHDynamic->RemoveFromLastAssignedSlots();	// So we can bind them as output for next frame update
-		m_pSB_RuntimeSHDynamicSun->RemoveFromLastAssignedSlots();
+		// Filter & store
+		SH::FilterLanczos( pSHDynamic, 3.0f );
+		SH::FilterLanczos( pSHDynamicSun, 2.0f );
 
-		USING_COMPUTE_SHADER_END
+		memcpy_s( m_pSB_RuntimeSHDynamic->m[ProbeIndex].pSH, sizeof(SHCoeffs3), pSHDynamic, 9*sizeof(float3) );
+		memcpy_s( m_pSB_RuntimeSHDynamicSun->m[ProbeIndex].pSH, sizeof(SHCoeffs3), pSHDynamicSun, 9*sizeof(float3) );
 	}
 
-	// =========================================================
-	// Setup the input buffers for scene rendering
-	m_pSB_RuntimeProbes->SetInput( 7, true );
-	m_pSB_RuntimeSHFinal->SetInput( 8, true );
-	m_pSB_ProbeNeighbors->SetInput( 9, true );
+	//////////////////////////////////////////////////////////////////////////
+	// 3] Perform the final accumulation of all the SH sources
+	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
+		const SHCoeffs3&	SHStatic = m_ppSB_RuntimeSHStatic[0]->m[ProbeIndex];
+		const SHCoeffs1&	SHSky = m_pSB_RuntimeSHAmbient->m[ProbeIndex];
+		const SHCoeffs3&	SHDynamic = m_pSB_RuntimeSHDynamic->m[ProbeIndex];
+		const SHCoeffs3&	SHDynamicSun = m_pSB_RuntimeSHDynamicSun->m[ProbeIndex];
+		SHCoeffs3&			Result = m_pSB_RuntimeSHFinal->m[ProbeIndex];
+
+		for ( int i=0; i < 9; i++ )
+			Result.pSH[i] = _Parms.BounceFactorStatic * SHStatic.pSH[i] + SHSky.pSH[i] * _Parms.BounceFactorSky + _Parms.BounceFactorDynamic * SHDynamic.pSH[i] + _Parms.BounceFactorSun * SHDynamicSun.pSH[i];
+	}
+
+	m_pSB_RuntimeSHDynamic->Write();
+	m_pSB_RuntimeSHDynamicSun->Write();
+	m_pSB_RuntimeSHFinal->Write();
 }
 
 U32	SHProbeNetwork::GetNearestProbe( const float3& _wsPosition ) const {
-	float					ProbeDistance;
-	const SHProbe* const*	ppNearestProbe = m_ProbeOctree.FetchNearest( _wsPosition, ProbeDistance );
-	U32						probeID = ppNearestProbe != NULL ? (*ppNearestProbe)->m_ProbeID : 0xFFFFFFFFU;
-	return probeID;
+	return m_ProbeIndex.FetchNearest( _wsPosition );
 }
 
-void	SHProbeNetwork::PreComputeProbes( const char* _pPathToProbes, IRenderSceneDelegate& _RenderScene, Scene& _Scene, U32 _TotalFacesCount ) {
+void	SHProbeNetwork::GetNearestProbes( U32 _PositionsCount, const float3* _pwsPositions, U32* _pProbeIDs ) const {
+	m_ProbeIndex.FetchNearest( _PositionsCount, _pwsPositions, _pProbeIDs );
+}
+
+U32	SHProbeNetwork::GetProbesInRadius( const float3& _wsPosition, float _Radius, U32 _MaxProbesCount, U32* _pProbeIDs ) const {
+	return m_ProbeIndex.FetchInRadius( _wsPosition, _Radius, _MaxProbesCount, _pProbeIDs );
+}
+
+void	SHProbeNetwork::PreComputeProbes( const char* _pPathToProbes, IRenderSceneDelegate& _RenderScene, Scene& _Scene, U32 _TotalFacesCount, bool _ForceFullRebake ) {
 
 	const float		Z_INFINITY = 1e6f;
 	const float		Z_INFINITY_TEST = 0.99f * Z_INFINITY;
@@ -393,6 +560,7 @@ void	SHProbeNetwork::PreComputeProbes( const char* _pPathToProbes, IRenderSceneD
 	float4x4	SideWorld2Proj[6];
 	float4x4	Side2Local[6];
 	float4x4	Camera2Proj = float4x4::ProjectionPerspective( 0.5f * PI, 1.0f, 0.01f, 1000.0f );
+	float		LODProjectionScale = BaseLib::ComputeLODProjectionScale( float(SHProbeEncoder::CUBE_MAP_SIZE), 0.5f * PI );
 	for ( int CubeFaceIndex=0; CubeFaceIndex < 6; CubeFaceIndex++ )
 	{
 		float4x4	Camera2Local;
@@ -419,7 +587,6 @@ void	SHProbeNetwork::PreComputeProbes( const char* _pPathToProbes, IRenderSceneD
 
 	//////////////////////////////////////////////////////////////////////////
 	// Initialize probe influences for each face
-	m_ProbeInfluencePerFace.Init( _TotalFacesCount );
 	m_ProbeInfluencePerFace.SetCount( _TotalFacesCount );
 	ProbeInfluence*	pInfluence = &m_ProbeInfluencePerFace[0];
 	for ( U32 FaceIndex=0; FaceIndex < _TotalFacesCount; FaceIndex++, pInfluence++ ) {
@@ -433,9 +600,41 @@ void	SHProbeNetwork::PreComputeProbes( const char* _pPathToProbes, IRenderSceneD
 	//
 	char	pTemp[1024];
 
+	// Hash the current scene and load the results of the previous bake
+	// Probes whose recorded hash still matches the scene are read back from the previous database instead of being rendered again
+	SHProbeBakeCache	BakeCache;
+	BakeCache.ScanScene( _Scene, m_ProbesCount );
+
+	SHProbeDatabase		PreviousDatabase;
+	bool				Incremental = false;
+	if ( !_ForceFullRebake ) {
+		sprintf_s( pTemp, "%sProbes.bakecache", _pPathToProbes );
+		Incremental = BakeCache.Load( pTemp );
+
+		sprintf_s( pTemp, "%sProbes.probedb", _pPathToProbes );
+		Incremental = Incremental && PreviousDatabase.Open( pTemp ) && PreviousDatabase.GetProbesCount() == m_ProbesCount;
+	}
+
 	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
 		SHProbe&	Probe = m_pProbes[ProbeIndex];
 
+		if ( Incremental && BakeCache.IsProbeUpToDate( ProbeIndex, m_pProbes ) ) {
+			// Nothing changed around that probe: reuse previous results as they were saved
+			PreviousDatabase.ReadProbe( ProbeIndex, Probe, false );
+
+			// Collate the recorded per-face probe influence
+			const SHProbeBakeCache::ProbeRecord&	Record = BakeCache.GetRecord( ProbeIndex );
+			for ( U32 InfluenceIndex=0; InfluenceIndex < Record.FaceInfluences.Count(); InfluenceIndex++ ) {
+				const SHProbeBakeCache::FaceInfluence&	FI = Record.FaceInfluences[InfluenceIndex];
+				ProbeInfluence&							CurrentInfluence = m_ProbeInfluencePerFace[FI.FaceIndex];
+				if ( FI.Influence > CurrentInfluence.Influence ) {
+					CurrentInfluence.Influence = FI.Influence;
+					CurrentInfluence.ProbeID = Probe.m_ProbeID;
+				}
+			}
+			continue;
+		}
+
 		m_pCB_Probe->m.CurrentProbePosition = Probe.m_wsPosition;
 
 		// Clear cube maps
@@ -476,7 +675,7 @@ void	SHProbeNetwork::PreComputeProbes( const char* _pPathToProbes, IRenderSceneD
 			m_pDevice->SetRenderTargets( SHProbeEncoder::CUBE_MAP_SIZE, SHProbeEncoder::CUBE_MAP_SIZE, 3, ppViews, pDSV );
 
 			// Render scene
-			_RenderScene( *m_pMatRenderCubeMap );
+			_RenderScene( *m_pMatRenderCubeMap, Probe.m_wsPosition, LODProjectionScale );
 		}
 
 		//////////////////////////////////////////////////////////////////////////
@@ -558,7 +757,7 @@ void	SHProbeNetwork::PreComputeProbes( const char* _pPathToProbes, IRenderSceneD
 
 			USING_MATERIAL_START( *m_pMatRenderNeighborProbe )
 
-			for ( U32 NeighborProbeIndex=0; NeighborProbeIndex < U32(Probe.m_NeighborProbes.GetCount()); NeighborProbeIndex++ ) {
+			for ( U32 NeighborProbeIndex=0; NeighborProbeIndex < Probe.m_NeighborProbes.Count(); NeighborProbeIndex++ ) {
 				const SHProbe::NeighborProbeInfo&	NP = Probe.m_NeighborProbes[NeighborProbeIndex];
 				if ( NP.DirectlyVisible ) {
 					const float3&	NeighborProbePosition = m_pProbes[NP.ProbeID].m_wsPosition;
@@ -623,10 +822,24 @@ void	SHProbeNetwork::PreComputeProbes( const char* _pPathToProbes, IRenderSceneD
 				pCurrentInfluence->ProbeID = Probe.m_ProbeID;
 			}
 		}
+
+		// Record what affected the probe for the next bake
+		BakeCache.UpdateRecord( ProbeIndex, m_pProbes, &m_ProbeEncoder.GetProbeInfluences()[0] );
 	}
 
 	delete pCBCubeMapCamera;
 
+	PreviousDatabase.Close();	// Must be closed before we can overwrite it
+
+	//////////////////////////////////////////////////////////////////////////
+	// Save all the probes into a single database for fast loading
+	sprintf_s( pTemp, "%sProbes.probedb", _pPathToProbes );
+	bool	DatabaseWritten = SHProbeDatabase::Write( pTemp, m_pProbes, m_ProbesCount, false );
+	ASSERT( DatabaseWritten, "Failed to write probes database!" );
+
+	sprintf_s( pTemp, "%sProbes.bakecache", _pPathToProbes );
+	BakeCache.Save( pTemp );
+
 	//////////////////////////////////////////////////////////////////////////
 	// Save the final probe influences
 	BuildProbeInfluenceVertexStream( _Scene, _pPathToProbes );
@@ -649,51 +862,66 @@ m_pRTCubeMap->SetPS( 64 );
 // 	delete m_pRTCubeMap;
 }
 
-void	SHProbeNetwork::MeshWithAdjacency::Build( SHProbeNetwork& _Owner, const Scene::Mesh& _Mesh, ProbeInfluence* _pProbeInfluencePerFace ) {
+void	SHProbeNetwork::MeshWithAdjacency::Init( const Scene::Mesh& _Mesh ) {
 
 	m_Local2World = _Mesh.m_Local2World;
 	m_World2Local = _Mesh.m_Local2World.Inverse();
 
 	m_PrimitivesCount = _Mesh.m_PrimitivesCount;
 	m_pPrimitives = new Primitive[_Mesh.m_PrimitivesCount];
-
-	int	FaceOffset = 0;
-	for ( int PrimitiveIndex=0; PrimitiveIndex < _Mesh.m_PrimitivesCount; PrimitiveIndex++ ) {
-		const Scene::Mesh::Primitive&	SourcePrim = _Mesh.m_pPrimitives[PrimitiveIndex];
-		m_pPrimitives[PrimitiveIndex].Build( _Owner, m_Local2World, SourcePrim, _pProbeInfluencePerFace + FaceOffset );
-		FaceOffset += SourcePrim.m_FacesCount;
-	}
 }
 
-U32	SHProbeNetwork::MeshWithAdjacency::PropagateProbeInfluences( SHProbeNetwork& _Owner ) {
-	U32	spreadsCount = false;
+void	SHProbeNetwork::MeshWithAdjacency::RedistributeProbeIDs2Vertices( ProbeInfluence const**& _ppProbeInfluences ) const {
 	for ( int PrimitiveIndex=0; PrimitiveIndex < m_PrimitivesCount; PrimitiveIndex++ ) {
 		Primitive&	P = m_pPrimitives[PrimitiveIndex];
-		spreadsCount += P.PropagateProbeInfluences( _Owner );
+		P.RedistributeProbeIDs2Vertices( _ppProbeInfluences );
+		_ppProbeInfluences += P.m_Vertices.Count();	// Make the pointer advance as we're done with that primitive
 	}
-
-	return spreadsCount;
 }
 
-U32	SHProbeNetwork::MeshWithAdjacency::AssignNearestProbe( SHProbeNetwork& _Owner ) {
-	U32	isolatedVerticesCount = 0;
-	for ( int PrimitiveIndex=0; PrimitiveIndex < m_PrimitivesCount; PrimitiveIndex++ ) {
-		Primitive&	P = m_pPrimitives[PrimitiveIndex];
-		isolatedVerticesCount += P.AssignNearestProbe( _Owner );
+namespace {
+
+	static const U32	WELD_CELL_BITS = 21;							// 3*21 bits fit into a U64 Morton code
+	static const U32	WELD_CELL_MAX = (1 << WELD_CELL_BITS) - 1;
+	static const float	WELD_DISTANCE = 0.01f;							// Vertices less than 1cm appart are welded together
+
+	// Interleaves the lower 21 bits of the value with 2 zero bits
+	U64	SpreadBits21( U32 _Value ) {
+		U64	x = _Value & WELD_CELL_MAX;
+		x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+		x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+		x = (x | (x <<  8)) & 0x100F00F00F00F00FULL;
+		x = (x | (x <<  4)) & 0x10C30C30C30C30C3ULL;
+		x = (x | (x <<  2)) & 0x1249249249249249ULL;
+		return x;
 	}
 
-	return isolatedVerticesCount;
-}
+	U64	MortonCode( U32 _X, U32 _Y, U32 _Z ) {
+		return SpreadBits21( _X ) | (SpreadBits21( _Y ) << 1) | (SpreadBits21( _Z ) << 2);
+	}
 
-void	SHProbeNetwork::MeshWithAdjacency::RedistributeProbeIDs2Vertices( ProbeInfluence const**& _ppProbeInfluences ) const {
-	for ( int PrimitiveIndex=0; PrimitiveIndex < m_PrimitivesCount; PrimitiveIndex++ ) {
-		Primitive&	P = m_pPrimitives[PrimitiveIndex];
-		P.RedistributeProbeIDs2Vertices( _ppProbeInfluences );
-		_ppProbeInfluences += P.m_Vertices.GetCount();	// Make the pointer advance as we're done with that primitive
+	int	CompareCellVertices( const void* _pA, const void* _pB ) {
+		const SHProbeNetwork::MeshWithAdjacency::Primitive::CellVertex&	A = *((const SHProbeNetwork::MeshWithAdjacency::Primitive::CellVertex*) _pA);
+		const SHProbeNetwork::MeshWithAdjacency::Primitive::CellVertex&	B = *((const SHProbeNetwork::MeshWithAdjacency::Primitive::CellVertex*) _pB);
+		if ( A.CellKey != B.CellKey )
+			return A.CellKey < B.CellKey ? -1 : 1;
+		return A.V < B.V ? -1 : (A.V > B.V ? 1 : 0);
 	}
-}
 
-SHProbeNetwork::MeshWithAdjacency::Primitive::VertexLink*	SHProbeNetwork::MeshWithAdjacency::Primitive::ms_ppCells[64*64*64];
+	// Returns the index of the first sorted vertex whose cell key is >= _CellKey
+	U32	LowerBoundCellKey( const SHProbeNetwork::MeshWithAdjacency::Primitive::CellVertex* _pSortedVertices, U32 _VerticesCount, U64 _CellKey ) {
+		U32	Min = 0;
+		U32	Max = _VerticesCount;
+		while ( Min < Max ) {
+			U32	Mid = (Min + Max) >> 1;
+			if ( _pSortedVertices[Mid].CellKey < _CellKey )
+				Min = Mid + 1;
+			else
+				Max = Mid;
+		}
+		return Min;
+	}
+}
 
 void	SHProbeNetwork::MeshWithAdjacency::Primitive::Build( SHProbeNetwork& _Owner, const float4x4& _Local2World, const Scene::Mesh::Primitive& _SourcePrimitive, ProbeInfluence* _pProbeInfluencePerFace ) {
 
@@ -702,43 +930,48 @@ void	SHProbeNetwork::MeshWithAdjacency::Primitive::Build( SHProbeNetwork& _Owner
 	Scene::Mesh::Primitive::VF_P3N3G3B3T2*	pSourceVertices = (Scene::Mesh::Primitive::VF_P3N3G3B3T2*) _SourcePrimitive.m_pVertices;
 
 	//////////////////////////////////////////////////////////////////////////
-	// Create vertices world space positions and build the linked-list of vertices located in a 64x64x64 grid subdividing the local BBox of the primitive
-	// (this will be used to quickly weld vertices together)
-	m_Vertices.Init( VerticesCount );
+	// Create vertices world space positions and sort the vertices by the Morton code of the weld cell they belong to
+	// Weld cells are at least as large as the weld distance so we only need to examine the 3x3x3 neighborhood of a vertex's cell to find
+	//	all the vertices it can be welded to. Cells are found by binary search in the sorted array, which keeps memory proportional to
+	//	the amount of vertices whatever the extent of the primitive (this used to be a fixed static 64x64x64 grid)
 	m_Vertices.SetCount( VerticesCount );
 
-	float3	BBoxCellSize = _SourcePrimitive.m_LocalBBoxMax - _SourcePrimitive.m_LocalBBoxMin;
-			BBoxCellSize = 1.01f * BBoxCellSize / 64.0f;
-	float3	BBoxMin = 0.5f * (_SourcePrimitive.m_LocalBBoxMax + _SourcePrimitive.m_LocalBBoxMin)
-					- 32.0f * BBoxCellSize;
+	float3	BBoxMin = _SourcePrimitive.m_LocalBBoxMin;
+	float3	BBoxSize = _SourcePrimitive.m_LocalBBoxMax - _SourcePrimitive.m_LocalBBoxMin;
+	float	CellSize = MAX( WELD_DISTANCE, MAX( MAX( BBoxSize.x, BBoxSize.y ), BBoxSize.z ) / WELD_CELL_MAX );
+	float	InvCellSize = 1.0f / CellSize;
 
 	// Create free vertex cells
-	m_VertexCells.Init( VerticesCount );
 	m_VertexCells.SetCount( VerticesCount );
 
-	// Fill up the 64x64x64 cells with lists of vertices inside each cell
-	memset( ms_ppCells, 0, 64*64*64*sizeof(VertexLink*) );
+	List< CellVertex >	SortedVertices( VerticesCount );
+	SortedVertices.SetCount( VerticesCount );
+
+	U32*	pVertexCells = new U32[3*VerticesCount];	// Integer cell coordinates of each vertex
 
 	VertexLink*	pFreeCell = &m_VertexCells[0];
 	Scene::Mesh::Primitive::VF_P3N3G3B3T2*	pSourceVertex = pSourceVertices;
-	Vertex*									pTargetVertex = &m_Vertices[0];;
+	Vertex*									pTargetVertex = &m_Vertices[0];
 	for ( U32 VertexIndex=0; VertexIndex < VerticesCount; VertexIndex++, pSourceVertex++, pTargetVertex++, pFreeCell++ ) {
-		float3&	Position = pSourceVertex->P;
-		float3	CellPosition = (Position - BBoxMin) / BBoxCellSize;
-		U32		iCellPositionX = U32( floorf( CellPosition.x ) );
-		U32		iCellPositionY = U32( floorf( CellPosition.y ) );
-		U32		iCellPositionZ = U32( floorf( CellPosition.z ) );
+		float3	CellPosition = InvCellSize * (pSourceVertex->P - BBoxMin);
+		U32*	pCell = &pVertexCells[3*VertexIndex];
+		pCell[0] = U32( MIN( float(WELD_CELL_MAX), MAX( 0.0f, floorf( CellPosition.x ) ) ) );
+		pCell[1] = U32( MIN( float(WELD_CELL_MAX), MAX( 0.0f, floorf( CellPosition.y ) ) ) );
+		pCell[2] = U32( MIN( float(WELD_CELL_MAX), MAX( 0.0f, floorf( CellPosition.z ) ) ) );
 
-		// Link it into its nearest integer cell
-		pFreeCell->pNext = ms_ppCells[iCellPositionX+64*(iCellPositionY+64*iCellPositionZ)];
-		ms_ppCells[iCellPositionX+64*(iCellPositionY+64*iCellPositionZ)] = pFreeCell;
+		SortedVertices[VertexIndex].CellKey = MortonCode( pCell[0], pCell[1], pCell[2] );
+		SortedVertices[VertexIndex].V = VertexIndex;
 
+		pFreeCell->pNext = NULL;
 		pFreeCell->V = VertexIndex;
 
 		// Build world space position to interrogate probes's Vorono cells
 		pTargetVertex->wsPosition = float4( pSourceVertex->P, 1.0f ) * _Local2World;
 	}
 
+	if ( VerticesCount > 0 )
+		qsort( &SortedVertices[0], VerticesCount, sizeof(CellVertex), CompareCellVertices );
+
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build faces and assign seed per-vertex probe influences
@@ -776,8 +1009,8 @@ void	SHProbeNetwork::MeshWithAdjacency::Primitive::Build( SHProbeNetwork& _Owner
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build welded vertices structure and gather largest probe influences
-	m_WeldedVertices.Init( VerticesCount );
 	m_WeldedVertices.Clear();
+	m_WeldedVertices.Reserve( VerticesCount );	// NOTE: Must never grow as adjacent vertices keep pointers to the welded vertices
 
 	List<bool>	WeldedState( VerticesCount );
 	WeldedState.SetCount( VerticesCount );
@@ -785,12 +1018,12 @@ void	SHProbeNetwork::MeshWithAdjacency::Primitive::Build( SHProbeNetwork& _Owner
 
 	pSourceVertex = pSourceVertices;
 	pTargetVertex = &m_Vertices[0];
-	for ( U32 VertexIndex=0; VertexIndex < VerticesCount; VertexIndex++, pSourceVertex++, pTargetVertex++, pFreeCell++ ) {
+	for ( U32 VertexIndex=0; VertexIndex < VerticesCount; VertexIndex++, pSourceVertex++, pTargetVertex++ ) {
 		if ( WeldedState[VertexIndex] )
 			continue;	// Already welded
 
 		// Found a new vertex to weld
-		U32				WeldedVertexIndex = m_WeldedVertices.GetCount();
+		U32				WeldedVertexIndex = m_WeldedVertices.Count();
 		WeldedVertex&	NewWeldedVertex = m_WeldedVertices.Append();
 		NewWeldedVertex.lsPosition = pSourceVertex->P;
 		NewWeldedVertex.wsPosition = pTargetVertex->wsPosition;
@@ -800,46 +1033,34 @@ void	SHProbeNetwork::MeshWithAdjacency::Primitive::Build( SHProbeNetwork& _Owner
 		NewWeldedVertex.Influence.Influence = 0.0;
 		NewWeldedVertex.Influence.ProbeID = ~0UL;	// No valid influence at the moment...
 
-		float3	CellPosition = (pSourceVertex->P - BBoxMin) / BBoxCellSize;
-		int		iCellPositionX = int( floorf( CellPosition.x ) );
-		int		iCellPositionY = int( floorf( CellPosition.y ) );
-		int		iCellPositionZ = int( floorf( CellPosition.z ) );
+		const U32*	pCell = &pVertexCells[3*VertexIndex];
 
-		// Examine neighbor cells as well (TODO: examine only if the vertex position is close to the cell's edge)
+		// Examine neighbor cells as well
 		for ( int Z=-1; Z <= 1; Z++ ) {
-			int	iNeighborCellPositionZ = iCellPositionZ+Z;
-			if ( iNeighborCellPositionZ < 0 || iNeighborCellPositionZ >= 64 )
+			S64	iNeighborCellPositionZ = S64(pCell[2])+Z;
+			if ( iNeighborCellPositionZ < 0 || iNeighborCellPositionZ > WELD_CELL_MAX )
 				continue;
 			for ( int Y=-1; Y <= 1; Y++ ) {
-				int	iNeighborCellPositionY = iCellPositionY+Y;
-				if ( iNeighborCellPositionY < 0 || iNeighborCellPositionY >= 64 )
+				S64	iNeighborCellPositionY = S64(pCell[1])+Y;
+				if ( iNeighborCellPositionY < 0 || iNeighborCellPositionY > WELD_CELL_MAX )
 					continue;
 				for ( int X=-1; X <= 1; X++ ) {
-					int	iNeighborCellPositionX = iCellPositionX+X;
-					if ( iNeighborCellPositionX < 0 || iNeighborCellPositionX >= 64 )
+					S64	iNeighborCellPositionX = S64(pCell[0])+X;
+					if ( iNeighborCellPositionX < 0 || iNeighborCellPositionX > WELD_CELL_MAX )
 						continue;
 
-					U32			NeighborCellOffset = iNeighborCellPositionX+64*(iNeighborCellPositionY+64*iNeighborCellPositionZ);
-					VertexLink*	pPreviousNeighborCell = NULL;
-					VertexLink*	pNeighborCell = ms_ppCells[NeighborCellOffset];
-					while ( pNeighborCell != NULL ) {
-						float	SqDistance = (pSourceVertices[pNeighborCell->V].P - NewWeldedVertex.lsPosition).LengthSq();
-						if ( SqDistance > 0.0001f ) {
-							// More than 1cm appart... 
-							pPreviousNeighborCell = pNeighborCell;
-							pNeighborCell = pNeighborCell->pNext;
-							continue;
-						}
+					U64	NeighborCellKey = MortonCode( U32(iNeighborCellPositionX), U32(iNeighborCellPositionY), U32(iNeighborCellPositionZ) );
+					for ( U32 SortedIndex=LowerBoundCellKey( &SortedVertices[0], VerticesCount, NeighborCellKey ); SortedIndex < VerticesCount && SortedVertices[SortedIndex].CellKey == NeighborCellKey; SortedIndex++ ) {
+						U32	NeighborVertexIndex = SortedVertices[SortedIndex].V;
+						if ( WeldedState[NeighborVertexIndex] )
+							continue;	// Already welded to another vertex
 
-						// New vertex to weld! (NOTE: it's okay to weld ourselves)
-						VertexLink*	pWeldedCell = pNeighborCell;
+						float	SqDistance = (pSourceVertices[NeighborVertexIndex].P - NewWeldedVertex.lsPosition).LengthSq();
+						if ( SqDistance > WELD_DISTANCE*WELD_DISTANCE )
+							continue;	// More than 1cm appart... 
 
-						// Link over that vertex: it's no longer part of the set of unwelded vertices
-						pNeighborCell = pNeighborCell->pNext;
-						if ( pPreviousNeighborCell != NULL )
-							pPreviousNeighborCell->pNext = pNeighborCell;
-						else 
-							ms_ppCells[NeighborCellOffset] = pNeighborCell;
+						// New vertex to weld! (NOTE: it's okay to weld ourselves)
+						VertexLink*	pWeldedCell = &m_VertexCells[NeighborVertexIndex];
 
 						// Link-in this vertex as a new welded vertex
 						pWeldedCell->pNext = NewWeldedVertex.pSharingVertices;
@@ -865,9 +1086,11 @@ void	SHProbeNetwork::MeshWithAdjacency::Primitive::Build( SHProbeNetwork& _Owner
 		}
 	}
 
+	delete[] pVertexCells;
+
 	// Normalize normals
 	WeldedVertex*	pWeldedVertex = &m_WeldedVertices[0];
-	for ( U32 WeldedVertexIndex=0; WeldedVertexIndex < U32(m_WeldedVertices.GetCount()); WeldedVertexIndex++, pWeldedVertex++ ) {
+	for ( U32 WeldedVertexIndex=0; WeldedVertexIndex < m_WeldedVertices.Count(); WeldedVertexIndex++, pWeldedVertex++ ) {
 		pWeldedVertex->lsNormal.Normalize();
 	}
 
@@ -901,7 +1124,7 @@ void	SHProbeNetwork::MeshWithAdjacency::Primitive::Build( SHProbeNetwork& _Owner
 U32	SHProbeNetwork::MeshWithAdjacency::Primitive::PropagateProbeInfluences( SHProbeNetwork& _Owner ) {
 	U32				spreadsCount = 0;
 	WeldedVertex*	pVertex = &m_WeldedVertices[0];
-	int				VerticesCount = m_WeldedVertices.GetCount();
+	int				VerticesCount = int(m_WeldedVertices.Count());
 	for ( int VertexIndex=0; VertexIndex < VerticesCount; VertexIndex++, pVertex++ ) {
 		spreadsCount += pVertex->PropagateProbeInfluencesBetweenVertices( _Owner ) ? 1 : 0;
 	}
@@ -913,7 +1136,7 @@ U32	SHProbeNetwork::MeshWithAdjacency::Primitive::PropagateProbeInfluences( SHPr
 U32	SHProbeNetwork::MeshWithAdjacency::Primitive::AssignNearestProbe( SHProbeNetwork& _Owner ) {
 	U32				isolatedVerticesCount = 0;
 	WeldedVertex*	pWeldedVertex = &m_WeldedVertices[0];
-	int				VerticesCount = m_WeldedVertices.GetCount();
+	int				VerticesCount = int(m_WeldedVertices.Count());
 	for ( int VertexIndex=0; VertexIndex < VerticesCount; VertexIndex++, pWeldedVertex++ ) {
 		if ( pWeldedVertex->Influence.ProbeID != ~0U )
 			continue;
@@ -937,7 +1160,7 @@ U32	SHProbeNetwork::MeshWithAdjacency::Primitive::AssignNearestProbe( SHProbeNet
 // Redistributes the probe influences from welded vertices to original vertices
 void	SHProbeNetwork::MeshWithAdjacency::Primitive::RedistributeProbeIDs2Vertices( ProbeInfluence const** _ppProbeInfluences ) const {
 	const WeldedVertex*	pWeldedVertex = &m_WeldedVertices[0];
-	int					VerticesCount = m_WeldedVertices.GetCount();
+	int					VerticesCount = int(m_WeldedVertices.Count());
 	for ( int VertexIndex=0; VertexIndex < VerticesCount; VertexIndex++, pWeldedVertex++ ) {
 		VertexLink*	pOriginalVertex = pWeldedVertex->pSharingVertices;
 		ASSERT( pOriginalVertex != NULL, "How come a welded vertex exists without any original vertex as a source?!" );
@@ -957,7 +1180,7 @@ bool	SHProbeNetwork::MeshWithAdjacency::Primitive::WeldedVertex::PropagateProbeI
 
 	bool			spreading = false;
 	WeldedVertex**	ppAdjacentVertex = &AdjacentVertices[0];
-	for ( U32 AdjacentVertexIndex=0; AdjacentVertexIndex < U32(AdjacentVertices.GetCount()); AdjacentVertexIndex++, ppAdjacentVertex++ ) {
+	for ( U32 AdjacentVertexIndex=0; AdjacentVertexIndex < AdjacentVertices.Count(); AdjacentVertexIndex++, ppAdjacentVertex++ ) {
 		WeldedVertex&	AdjacentVertex = **ppAdjacentVertex;
 		if ( AdjacentVertex.Influence.ProbeID == Influence.ProbeID )
 			continue;	// Both vertices are influenced by the same probe so our work is done here...
@@ -1000,13 +1223,21 @@ void	SHProbeNetwork::BuildProbeInfluenceVertexStream( Scene& _Scene, const char*
 	//////////////////////////////////////////////////////////////////////////
 	// Start by building adjacency structures between primitives' faces
 	List< MeshWithAdjacency >	Meshes;
-	Meshes.Init( _Scene.m_MeshesCount );
+	Meshes.Reserve( _Scene.m_MeshesCount );	// NOTE: Must never grow as build jobs keep pointers to the meshes
+
+	struct	PrimitiveJob {
+		MeshWithAdjacency*					pMesh;
+		const Scene::Mesh::Primitive*		pSourcePrimitive;
+		MeshWithAdjacency::Primitive*		pTargetPrimitive;
+		ProbeInfluence*						pProbeInfluencePerFace;
+	};
 
 	class MeshVisitor : public Scene::IVisitor {
 	public:
 		SHProbeNetwork&				m_Owner;
 		List< MeshWithAdjacency >*	m_Meshes;
 		ProbeInfluence*				m_ProbeInfluencePerFace;
+		List< PrimitiveJob >		m_Jobs;
 		U32							m_TotalFacesCount;
 		U32							m_TotalVerticesCount;
 
@@ -1017,11 +1248,18 @@ void	SHProbeNetwork::BuildProbeInfluenceVertexStream( Scene& _Scene, const char*
 			
 			Scene::Mesh&		SourceMesh = (Scene::Mesh&) _Node;
 			MeshWithAdjacency&	TargetMesh = m_Meshes->Append();
-			TargetMesh.Build( m_Owner, SourceMesh, m_ProbeInfluencePerFace + m_TotalFacesCount );
+			TargetMesh.Init( SourceMesh );
 
-			// Accumulate vertices/faces count
+			// Register primitive build jobs & accumulate vertices/faces count
 			for ( int PrimitiveIndex=0; PrimitiveIndex < SourceMesh.m_PrimitivesCount; PrimitiveIndex++ ) {
 				Scene::Mesh::Primitive&	P = SourceMesh.m_pPrimitives[PrimitiveIndex];
+
+				PrimitiveJob&	Job = m_Jobs.Append();
+				Job.pMesh = &TargetMesh;
+				Job.pSourcePrimitive = &P;
+				Job.pTargetPrimitive = &TargetMesh.m_pPrimitives[PrimitiveIndex];
+				Job.pProbeInfluencePerFace = m_ProbeInfluencePerFace + m_TotalFacesCount;
+
 				m_TotalFacesCount += P.m_FacesCount;
 				m_TotalVerticesCount += P.m_VerticesCount;
 			}
@@ -1033,30 +1271,48 @@ void	SHProbeNetwork::BuildProbeInfluenceVertexStream( Scene& _Scene, const char*
 	visitor.m_ProbeInfluencePerFace = &m_ProbeInfluencePerFace[0];
 	_Scene.ForEach( visitor );
 
-	//////////////////////////////////////////////////////////////////////////
-	// Propagate best probe indices by adjacency
-	U32		passesCount = 0;
-	U32		spreadsCount = 1;
-	U32		averageSpreadsCount = 0;
-	while ( spreadsCount > 0 ) {
-		passesCount++;
-
-		spreadsCount = 0;
-		for ( int MeshIndex=0; MeshIndex < Meshes.GetCount(); MeshIndex++ ) {
-			MeshWithAdjacency&	M = Meshes[MeshIndex];
-			spreadsCount += M.PropagateProbeInfluences( *this );
+	// Primitives don't share any data so we can build them, propagate their influences and assign their isolated vertices concurrently
+	class	PrimitiveProcessor {
+	public:
+		SHProbeNetwork&			m_Owner;
+		List< PrimitiveJob >&	m_Jobs;
+		volatile LONG			m_SpreadsCount;
+		volatile LONG			m_MaxPassesCount;
+		volatile LONG			m_IsolatedVerticesCount;
+
+		PrimitiveProcessor( SHProbeNetwork& _Owner, List< PrimitiveJob >& _Jobs ) : m_Owner( _Owner ), m_Jobs( _Jobs ), m_SpreadsCount( 0 ), m_MaxPassesCount( 0 ), m_IsolatedVerticesCount( 0 ) {}
+		void	operator()( U32 _JobIndex ) {
+			PrimitiveJob&					Job = m_Jobs[_JobIndex];
+			MeshWithAdjacency::Primitive&	P = *Job.pTargetPrimitive;
+
+			// Build welded vertices & adjacency
+			P.Build( m_Owner, Job.pMesh->m_Local2World, *Job.pSourcePrimitive, Job.pProbeInfluencePerFace );
+
+			// Propagate best probe indices by adjacency
+			// Adjacency never crosses primitives so each primitive can be iterated to convergence on its own
+			U32	PassesCount = 0;
+			U32	SpreadsCount = 0;
+			while ( true ) {
+				U32	PassSpreadsCount = P.PropagateProbeInfluences( m_Owner );
+				if ( PassSpreadsCount == 0 )
+					break;
+				SpreadsCount += PassSpreadsCount;
+				PassesCount++;
+			}
+			InterlockedExchangeAdd( &m_SpreadsCount, LONG(SpreadsCount) );
+			LONG	MaxPassesCount = m_MaxPassesCount;
+			while ( LONG(PassesCount) > MaxPassesCount && InterlockedCompareExchange( &m_MaxPassesCount, LONG(PassesCount), MaxPassesCount ) != MaxPassesCount )
+				MaxPassesCount = m_MaxPassesCount;
+
+			// Assign nearest probes to vertices without influence (isolated vertices)
+			InterlockedExchangeAdd( &m_IsolatedVerticesCount, LONG(P.AssignNearestProbe( m_Owner )) );
 		}
-		averageSpreadsCount += spreadsCount;
-	}
-	averageSpreadsCount /= (passesCount-1);
+	} processor( *this, visitor.m_Jobs );
+	BaseLib::ParallelFor( visitor.m_Jobs.Count(), processor );
 
-	//////////////////////////////////////////////////////////////////////////
-	// Assign nearest probes to vertices without influence (isolated vertices)
-	U32	isolatedVerticesCount = 0;
-	for ( int MeshIndex=0; MeshIndex < Meshes.GetCount(); MeshIndex++ ) {
-		MeshWithAdjacency&	M = Meshes[MeshIndex];
-		isolatedVerticesCount += M.AssignNearestProbe( *this );
-	}
+	U32		passesCount = U32(processor.m_MaxPassesCount);
+	U32		averageSpreadsCount = passesCount > 0 ? U32(processor.m_SpreadsCount) / passesCount : 0;
+	U32		isolatedVerticesCount = U32(processor.m_IsolatedVerticesCount);
 
 	//////////////////////////////////////////////////////////////////////////
 	// Redistribute to vertices, choosing the best probe influence each time
@@ -1065,7 +1321,7 @@ void	SHProbeNetwork::BuildProbeInfluenceVertexStream( Scene& _Scene, const char*
 
 	{
 		ProbeInfluence const**	ppInfluence = pProbeInfluencePerVertex;
-		for ( int MeshIndex=0; MeshIndex < Meshes.GetCount(); MeshIndex++ ) {
+		for ( U32 MeshIndex=0; MeshIndex < Meshes.Count(); MeshIndex++ ) {
 			MeshWithAdjacency&	M = Meshes[MeshIndex];
 			M.RedistributeProbeIDs2Vertices( ppInfluence );
 		}
@@ -1102,10 +1358,20 @@ void	SHProbeNetwork::LoadProbes( const char* _pPathToProbes, const float3& _Scen
 	FILE*	pFile = NULL;
 	char	pTemp[1024];
 
+	// Attempt to read the probes from the database first
+	SHProbeDatabase	Database;
+	sprintf_s( pTemp, "%sProbes.probedb", _pPathToProbes );
+	bool	UseDatabase = Database.Open( pTemp ) && Database.GetProbesCount() == m_ProbesCount;
+
 	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
 		SHProbe&	Probe = m_pProbes[ProbeIndex];
 
-		// Read numbered probe
+		if ( UseDatabase ) {
+			Database.ReadProbe( ProbeIndex, Probe );
+			continue;
+		}
+
+		// Fallback to reading the numbered probe
 		sprintf_s( pTemp, "%sProbe%02d.probeset", _pPathToProbes, ProbeIndex );
 		fopen_s( &pFile, pTemp, "rb" );
 		if ( pFile == NULL ) {
@@ -1121,6 +1387,8 @@ void	SHProbeNetwork::LoadProbes( const char* _pPathToProbes, const float3& _Scen
 		fclose( pFile );
 	}
 
+	Database.Close();
+
 
 	//////////////////////////////////////////////////////////////////////////
 	// Count total number of neighbors
@@ -1129,7 +1397,7 @@ void	SHProbeNetwork::LoadProbes( const char* _pPathToProbes, const float3& _Scen
 	U32		MaxNeighborsCount = 0;
 	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
 		SHProbe&	Probe = m_pProbes[ProbeIndex];
-		U32			NeighborsCount = Probe.m_VoronoiProbes.GetCount();
+		U32			NeighborsCount = Probe.m_VoronoiProbes.Count();
 
 		TotalNeighborsCount += NeighborsCount;
 		MinNeighborsCount = MIN( MinNeighborsCount, NeighborsCount );
@@ -1148,7 +1416,7 @@ void	SHProbeNetwork::LoadProbes( const char* _pPathToProbes, const float3& _Scen
 	TotalNeighborsCount = 0;
 	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
 		SHProbe&	Probe = m_pProbes[ProbeIndex];
-		U32			NeighborsCount = Probe.m_VoronoiProbes.GetCount();
+		U32			NeighborsCount = Probe.m_VoronoiProbes.Count();
 
 		m_pSB_RuntimeProbes->m[ProbeIndex].Position = Probe.m_wsPosition;
 		m_pSB_RuntimeProbes->m[ProbeIndex].Radius = Probe.m_MaxDistance;
@@ -1175,9 +1443,16 @@ void	SHProbeNetwork::LoadProbes( const char* _pPathToProbes, const float3& _Scen
 	m_ppSB_RuntimeSHStatic[0] = new SB<SHCoeffs3>( *m_pDevice, m_ProbesCount, true );
 	m_ppSB_RuntimeSHStatic[1] = new SB<SHCoeffs3>( *m_pDevice, m_ProbesCount, true );
 	m_pSB_RuntimeSHAmbient = new SB<SHCoeffs1>( *m_pDevice, m_ProbesCount, true );
-	m_pSB_RuntimeSHDynamic = new SB<SHCoeffs3>( *m_pDevice, m_ProbesCount, false );
-	m_pSB_RuntimeSHDynamicSun = new SB<SHCoeffs3>( *m_pDevice, m_ProbesCount, false );
-	m_pSB_RuntimeSHFinal = new SB<SHCoeffs3>( *m_pDevice, m_ProbesCount, false );
+	m_pSB_RuntimeSHDynamic = new SB<SHCoeffs3>( *m_pDevice, m_ProbesCount, true );		// Writeable so the CPU update can upload them
+	m_pSB_RuntimeSHDynamicSun = new SB<SHCoeffs3>( *m_pDevice, m_ProbesCount, true );
+	m_pSB_RuntimeSHFinal = new SB<SHCoeffs3>( *m_pDevice, m_ProbesCount, true );
+
+	// Clear the CPU copies of the dynamic SH (only used by the CPU update)
+	memset( m_pSB_RuntimeSHDynamic->m, 0, m_ProbesCount*sizeof(SHCoeffs3) );
+	memset( m_pSB_RuntimeSHDynamicSun->m, 0, m_ProbesCount*sizeof(SHCoeffs3) );
+	memset( m_pSB_RuntimeSHFinal->m, 0, m_ProbesCount*sizeof(SHCoeffs3) );
+
+	m_UpdateScheduler.Init( m_ProbesCount );
 
 	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
 		SHProbe&	Probe = m_pProbes[ProbeIndex];
@@ -1226,26 +1501,8 @@ void	SHProbeNetwork::LoadProbes( const char* _pPathToProbes, const float3& _Scen
 
 
 	//////////////////////////////////////////////////////////////////////////
-	// Build the probes' octree
-	float	MaxDimension = (_SceneBBoxMax - _SceneBBoxMin).Max();
-
-	m_ProbeOctree.Init( _SceneBBoxMin, MaxDimension, 4.0f, m_ProbesCount );
-	int		MaxNodesCount = 0;
-	int		TotalNodesCount = 0;
-	U32		MaxNodesProbeIndex = ~0;
-	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
-		SHProbe&	Probe = m_pProbes[ProbeIndex];
-
-		int	NodesCount = m_ProbeOctree.Append( Probe.m_wsPosition, Probe.m_MaxDistance, &Probe );
-		TotalNodesCount += NodesCount;
-		if ( NodesCount > MaxNodesCount )
-		{	// New probe with more octree nodes
-			MaxNodesCount = NodesCount;
-			MaxNodesProbeIndex = ProbeIndex;
-		}
-	}
-
-	float	AverageNodesCount = float(TotalNodesCount) / m_ProbesCount;
+	// Build the probes' spatial index
+	m_ProbeIndex.Build( m_pProbes, m_ProbesCount );
 
 
 	//////////////////////////////////////////////////////////////////////////
@@ -7,6 +7,10 @@
 #pragma once
 
 #include "SHProbeEncoder.h"
+#include "SHProbeDatabase.h"
+#include "SHProbeBakeCache.h"
+#include "SHProbeUpdateScheduler.h"
+#include "SHProbeIndex.h"
 
 class	SHProbeNetwork
 {
@@ -24,10 +28,18 @@ public:		// NESTED TYPES
 		public: virtual Scene::Material*	operator()( U32 _MaterialID ) = 0;
 		};
 
+		typedef SHProbeUpdateScheduler::DynamicLight	DynamicLight;
+
 		U32				MaxProbeUpdatesPerFrame;// Maximum amount of probes we can update each frame
 
 		IQueryMaterial*	pQueryMaterial;
 
+		float3			wsCameraPosition;		// Camera position & transform used to prioritize probe updates
+		float4x4		World2Proj;
+		U32				DynamicLightsCount;		// Dynamic lights used to prioritize probe updates and to light the samples in the CPU update
+		const DynamicLight*	pDynamicLights;
+		bool			UseCPUUpdate;			// Updates the probes on the CPU instead of using the compute shaders (WARNING: no shadows!)
+
 //		float3			AmbientSkySH[9];		// The SH coefficients used for the ambient sky term
 		float3			BounceFactorSun;		// Bounce factor for the Sun
 		float3			BounceFactorSky;		// Bounce factor for the sky
@@ -37,8 +49,11 @@ public:		// NESTED TYPES
 		float			BounceFactorNeighbors;	// Bounce factor for neighbor probes
 	};
 
+	// Renders the scene from a cube map face
+	//	_wsCameraPosition, the position of the probe, so the delegate can select the LOD of each mesh
+	//	_LODProjectionScale, the factor converting an error at a distance of 1 into cube map pixels (cf. BaseLib::ComputeLODProjectionScale())
 	class IRenderSceneDelegate {
-	public: virtual void	operator()( Shader& _Material ) = 0;
+	public: virtual void	operator()( Shader& _Material, const float3& _wsCameraPosition, float _LODProjectionScale ) = 0;
 	};
 
 private:	// RUNTIME STRUCTURES
@@ -152,7 +167,12 @@ private:	// BUILD TIME STRUCTURES
 				VertexLink*		pNext;
 				U32				V;						// Original vertex index
 			};
-			static VertexLink*		ms_ppCells[64*64*64];
+
+			// Vertex sorted by weld cell
+			struct CellVertex {
+				U64				CellKey;				// Morton code of the cell containing the vertex
+				U32				V;						// Original vertex index
+			};
 
 			// Welded vertex structure
 			struct WeldedVertex {
@@ -173,6 +193,7 @@ private:	// BUILD TIME STRUCTURES
 			List< VertexLink >		m_VertexCells;
 			List< WeldedVertex >	m_WeldedVertices;		
 
+			// NOTE: Primitives don't share any state so they can all be built and processed concurrently
 			void	Build( SHProbeNetwork& _Owner, const float4x4& _Local2World, const Scene::Mesh::Primitive& _SourcePrimitive, ProbeInfluence* _pProbeInfluencePerFace );
 			U32		PropagateProbeInfluences( SHProbeNetwork& _Owner );
 			U32		AssignNearestProbe( SHProbeNetwork& _Owner );
@@ -187,9 +208,8 @@ private:	// BUILD TIME STRUCTURES
 
 		~MeshWithAdjacency() { SAFE_DELETE_ARRAY( m_pPrimitives ); }
 
-		void	Build( SHProbeNetwork& _Owner, const Scene::Mesh& _Mesh, ProbeInfluence* _pProbeInfluencePerFace );
-		U32		PropagateProbeInfluences( SHProbeNetwork& _Owner );
-		U32		AssignNearestProbe( SHProbeNetwork& _Owner );
+		// Allocates the primitives, they're built later on (in parallel) by calling Primitive::Build()
+		void	Init( const Scene::Mesh& _Mesh );
 		void	RedistributeProbeIDs2Vertices( ProbeInfluence const**& _ppProbeInfluences ) const;
 	};
 
@@ -213,7 +233,7 @@ private:	// FIELDS
 	ComputeShader*			m_pCSUpdateProbeDynamicSH;	// Dynamically update probes (spread across several frames)
 	ComputeShader*			m_pCSAccumulateProbeSH;		// Dynamically update probes' SH by accumulating static + sky + dynamic SH (done each frame)
 
-	Octree<const SHProbe*>	m_ProbeOctree;				// Scene octree containing probes, queried by dynamic objects
+	SHProbeIndex			m_ProbeIndex;				// Flat spatial index of the probes, queried by dynamic objects
 
 	// Constant buffers
  	CB<CBProbe>*			m_pCB_Probe;
@@ -243,9 +263,11 @@ private:	// FIELDS
 	// Probes network debug
 	SB<RuntimeProbeNetworkInfos>*	m_pSB_RuntimeProbeNetworkInfos;
 
-	// Queue of probe indices to update each frame
-	// TODO! I'm only storing the index of the sequence of probes I'll update each frame
-	int						m_ProbeUpdateIndex;
+	// Decides which probes to update each frame
+	SHProbeUpdateScheduler	m_UpdateScheduler;
+
+	// SH coefficients of each sample direction, stored as 9 arrays of SAMPLES_COUNT coefficients for the CPU update
+	float					m_pSampleSHSoA[9*SHProbe::SAMPLES_COUNT];
 
 	// The encoder that will render cube maps and process them to generate runtime probe data
 	SHProbeEncoder			m_ProbeEncoder;
@@ -259,7 +281,8 @@ public:
 	SHProbeNetwork();
 	~SHProbeNetwork();
 
-	void			Init( Device& _Device, Primitive& _ScreenQuad );
+	// _SceneVertexFormat, _pSceneMacros, the vertex format of the scene primitives and the macros to compile the cube map material with (e.g. QUANTIZED_VERTICES)
+	void			Init( Device& _Device, Primitive& _ScreenQuad, const IVertexFormatDescriptor& _SceneVertexFormat=VertexFormatP3N3G3B3T2::DESCRIPTOR, D3D_SHADER_MACRO* _pSceneMacros=NULL );
 	void			Exit();
 
 	void			PreAllocateProbes( int _ProbesCount );
@@ -273,15 +296,22 @@ public:
 	// Runtime use
 	void			UpdateDynamicProbes( DynamicUpdateParms& _Parms );
 	U32				GetNearestProbe( const float3& _wsPosition ) const;
+	void			GetNearestProbes( U32 _PositionsCount, const float3* _pwsPositions, U32* _pProbeIDs ) const;
+	U32				GetProbesInRadius( const float3& _wsPosition, float _Radius, U32 _MaxProbesCount, U32* _pProbeIDs ) const;
 
 	// Build/Load/Save
-	void			PreComputeProbes( const char* _pPathToProbes, IRenderSceneDelegate& _RenderScene, Scene& _Scene, U32 _TotalFacesCount );
+	// NOTE: Probes are saved both as individual "ProbeXX.probeset" files and as a single "Probes.probedb" database that is used in priority when loading
+	// Only rebakes the probes whose environment changed since the last bake, unless _ForceFullRebake is true
+	void			PreComputeProbes( const char* _pPathToProbes, IRenderSceneDelegate& _RenderScene, Scene& _Scene, U32 _TotalFacesCount, bool _ForceFullRebake=false );
 	void			LoadProbes( const char* _pPathToProbes, const float3& _SceneBBoxMin, const float3& _SceneBBoxMax );
 
 private:
 
 	void			BuildProbeInfluenceVertexStream( Scene& _Scene, const char* _pPathToStreamFile );
 
+	void			UpdateDynamicProbesGPU( const DynamicUpdateParms& _Parms, U32 _ProbeUpdatesCount, const U32* _pProbeIndices );
+	void			UpdateDynamicProbesCPU( const DynamicUpdateParms& _Parms, U32 _ProbeUpdatesCount, const U32* _pProbeIndices );
+
 friend class SHProbeEncoder;
 friend static void	CopyProbeNetworkConnection( int _EntryIndex, SHProbeNetwork::RuntimeProbeNetworkInfos& _Value, void* _pUserData );
 
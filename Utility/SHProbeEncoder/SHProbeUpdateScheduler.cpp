@@ -0,0 +1,203 @@
+#include "../../GodComplex.h"
+#include "SHProbeUpdateScheduler.h"
+
+static const float	AGE_WEIGHT = 1.0f;				// Priority gained each frame a probe is not updated
+static const float	LIGHT_CHANGE_WEIGHT = 64.0f;	// Priority of a probe whose lighting totally changed (i.e. equivalent to 64 frames of waiting)
+static const float	DISTANCE_REFERENCE = 8.0f;		// Importance is halved for probes at that distance from the camera
+static const float	INVISIBLE_IMPORTANCE = 0.25f;	// Importance factor for probes outside of the camera frustum
+static const float	NEVER_UPDATED_AGE = 1e4f;		// Age given to probes that were never updated so they are processed first
+
+SHProbeUpdateScheduler::SHProbeUpdateScheduler()
+	: m_ProbesCount( 0 )
+	, m_pStates( NULL )
+	, m_pCurrentSignatures( NULL )
+	, m_pHeap( NULL )
+	, m_HeapSize( 0 ) {
+}
+
+SHProbeUpdateScheduler::~SHProbeUpdateScheduler() {
+	Exit();
+}
+
+void	SHProbeUpdateScheduler::Init( U32 _ProbesCount ) {
+	Exit();
+
+	m_ProbesCount = _ProbesCount;
+	m_pStates = new ProbeState[m_ProbesCount];
+	m_pCurrentSignatures = new float4[m_ProbesCount];
+	m_pHeap = new Candidate[m_ProbesCount];
+
+	Reset();
+}
+
+void	SHProbeUpdateScheduler::Exit() {
+	SAFE_DELETE_ARRAY( m_pHeap );
+	SAFE_DELETE_ARRAY( m_pCurrentSignatures );
+	SAFE_DELETE_ARRAY( m_pStates );
+	m_ProbesCount = 0;
+}
+
+void	SHProbeUpdateScheduler::Reset() {
+	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
+		m_pStates[ProbeIndex].Age = NEVER_UPDATED_AGE;
+		m_pStates[ProbeIndex].LightSignature = float4::Zero;
+	}
+}
+
+U32	SHProbeUpdateScheduler::Schedule( const SHProbe* _pProbes, const ScheduleParms& _Parms, U32 _MaxUpdatesCount, U32* _pProbeIndices ) {
+	_MaxUpdatesCount = MIN( _MaxUpdatesCount, m_ProbesCount );
+	if ( _MaxUpdatesCount == 0 )
+		return 0;
+
+	//////////////////////////////////////////////////////////////////////////
+	// 1] Extract the frustum planes from the camera's WORLD -> PROJ transform (planes point inside the frustum)
+	float4	pRows[4] = { _Parms.World2Proj.GetRow( 0 ), _Parms.World2Proj.GetRow( 1 ), _Parms.World2Proj.GetRow( 2 ), _Parms.World2Proj.GetRow( 3 ) };
+	float4	C0( pRows[0].x, pRows[1].x, pRows[2].x, pRows[3].x );
+	float4	C1( pRows[0].y, pRows[1].y, pRows[2].y, pRows[3].y );
+	float4	C2( pRows[0].z, pRows[1].z, pRows[2].z, pRows[3].z );
+	float4	C3( pRows[0].w, pRows[1].w, pRows[2].w, pRows[3].w );
+
+	float4	pFrustumPlanes[6] = {
+		C3 + C0,	// Left
+		C3 - C0,	// Right
+		C3 + C1,	// Bottom
+		C3 - C1,	// Top
+		C2,			// Near (Z in [0,W])
+		C3 - C2,	// Far
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// 2] Compute each probe's priority and keep the best ones
+	m_HeapSize = 0;
+	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ ) {
+		const SHProbe&		Probe = _pProbes[ProbeIndex];
+		const ProbeState&	State = m_pStates[ProbeIndex];
+
+		// Estimate lighting change since last update
+		float4	Signature = ComputeLightSignature( Probe.m_wsPosition, _Parms.DynamicLightsCount, _Parms.pDynamicLights );
+		m_pCurrentSignatures[ProbeIndex] = Signature;
+
+		float4	Delta = Signature - State.LightSignature;
+		float	DeltaLength = sqrtf( Delta.x*Delta.x + Delta.y*Delta.y + Delta.z*Delta.z + Delta.w*Delta.w );
+		float	Reference = MAX( Signature.w, State.LightSignature.w );
+		float	LightChange = Reference > 1e-6f ? MIN( 1.0f, DeltaLength / Reference ) : 0.0f;
+
+		// Estimate importance
+		float	Distance = (Probe.m_wsPosition - _Parms.wsCameraPosition).Length();
+		float	Importance = 1.0f / (1.0f + Distance / DISTANCE_REFERENCE);
+		if ( !IsProbeVisible( Probe, pFrustumPlanes ) )
+			Importance *= INVISIBLE_IMPORTANCE;
+
+		float	Priority = (AGE_WEIGHT * State.Age + LIGHT_CHANGE_WEIGHT * LightChange) * Importance;
+
+		HeapPush( Priority, ProbeIndex, _MaxUpdatesCount );
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// 3] Age all probes then reset the ones we selected
+	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ )
+		m_pStates[ProbeIndex].Age += 1.0f;
+
+	for ( U32 UpdateIndex=0; UpdateIndex < m_HeapSize; UpdateIndex++ ) {
+		U32			ProbeIndex = m_pHeap[UpdateIndex].ProbeIndex;
+		ProbeState&	State = m_pStates[ProbeIndex];
+		State.Age = 0.0f;
+		State.LightSignature = m_pCurrentSignatures[ProbeIndex];
+
+		_pProbeIndices[UpdateIndex] = ProbeIndex;
+	}
+
+	return m_HeapSize;
+}
+
+// The light signature is the irradiance-weighted direction to the lights (XYZ) and the total irradiance (W), as perceived at the probe's position
+// Shadowing is ignored so this is only an estimate of what the samples of the probe will receive
+float4	SHProbeUpdateScheduler::ComputeLightSignature( const float3& _wsPosition, U32 _LightsCount, const DynamicLight* _pLights ) {
+	float4	Signature = float4::Zero;
+	for ( U32 LightIndex=0; LightIndex < _LightsCount; LightIndex++ ) {
+		const DynamicLight&	Light = _pLights[LightIndex];
+
+		float	Luminance = 0.2126f * Light.Color.x + 0.7152f * Light.Color.y + 0.0722f * Light.Color.z;
+		float3	Direction;
+		float	Irradiance;
+		if ( Light.Type == Scene::Light::DIRECTIONAL ) {
+			Direction = Light.Direction;
+			Irradiance = Luminance;
+		} else {
+			Direction = Light.Position - _wsPosition;
+			float	Distance = Direction.Length();
+			Direction = Direction / MAX( 1e-4f, Distance );
+
+			float	InvDistance = 1.0f / MAX( 0.5f, Distance );	// Same clamping as the update shader
+			Irradiance = Luminance * InvDistance * InvDistance;
+
+			if ( Light.Type == Scene::Light::SPOT ) {
+				float	LdotD = -(Direction | Light.Direction);
+				float	t = SATURATE( (LdotD - Light.Parms.w) / MAX( 1e-4f, Light.Parms.z - Light.Parms.w ) );
+				Irradiance *= t * t * (3.0f - 2.0f * t);
+			}
+		}
+
+		Signature = Signature + float4( Irradiance * Direction, Irradiance );
+	}
+
+	return Signature;
+}
+
+// Tests the bounding sphere of the scene pixels perceived by the probe against the frustum planes
+bool	SHProbeUpdateScheduler::IsProbeVisible( const SHProbe& _Probe, const float4 _pFrustumPlanes[6] ) {
+	float3	Center = _Probe.m_wsPosition + 0.5f * (_Probe.m_lsBBoxMin + _Probe.m_lsBBoxMax);
+	float	Radius = 0.5f * (_Probe.m_lsBBoxMax - _Probe.m_lsBBoxMin).Length();
+
+	for ( int PlaneIndex=0; PlaneIndex < 6; PlaneIndex++ ) {
+		const float4&	Plane = _pFrustumPlanes[PlaneIndex];
+		float	NormalLength = sqrtf( Plane.x*Plane.x + Plane.y*Plane.y + Plane.z*Plane.z );
+		float	Distance = Plane.x * Center.x + Plane.y * Center.y + Plane.z * Center.z + Plane.w;
+		if ( Distance < -Radius * NormalLength )
+			return false;
+	}
+
+	return true;
+}
+
+// Min-heap on priority: the root is the worst of the best candidates found so far
+void	SHProbeUpdateScheduler::HeapPush( float _Priority, U32 _ProbeIndex, U32 _MaxSize ) {
+	if ( m_HeapSize < _MaxSize ) {
+		// Sift up
+		U32	Index = m_HeapSize++;
+		while ( Index > 0 ) {
+			U32	ParentIndex = (Index - 1) >> 1;
+			if ( m_pHeap[ParentIndex].Priority <= _Priority )
+				break;
+			m_pHeap[Index] = m_pHeap[ParentIndex];
+			Index = ParentIndex;
+		}
+		m_pHeap[Index].Priority = _Priority;
+		m_pHeap[Index].ProbeIndex = _ProbeIndex;
+		return;
+	}
+
+	if ( _Priority <= m_pHeap[0].Priority )
+		return;	// Not better than our worst candidate
+
+	// Replace the worst candidate
+	m_pHeap[0].Priority = _Priority;
+	m_pHeap[0].ProbeIndex = _ProbeIndex;
+	HeapSiftDown( 0 );
+}
+
+void	SHProbeUpdateScheduler::HeapSiftDown( U32 _Index ) {
+	Candidate	Temp = m_pHeap[_Index];
+	while ( true ) {
+		U32	ChildIndex = 2 * _Index + 1;
+		if ( ChildIndex >= m_HeapSize )
+			break;
+		if ( ChildIndex+1 < m_HeapSize && m_pHeap[ChildIndex+1].Priority < m_pHeap[ChildIndex].Priority )
+			ChildIndex++;
+		if ( Temp.Priority <= m_pHeap[ChildIndex].Priority )
+			break;
+		m_pHeap[_Index] = m_pHeap[ChildIndex];
+		_Index = ChildIndex;
+	}
+	m_pHeap[_Index] = Temp;
+}
@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////
+// SH Probe Update Scheduler
+//
+// Decides which probes get their dynamic lighting updated each frame, within a fixed budget of probe updates.
+//
+// Each probe is given a priority every frame:
+//	Priority = (AGE_WEIGHT * FramesSinceLastUpdate + LIGHT_CHANGE_WEIGHT * LightChange) * Importance
+//
+//	. FramesSinceLastUpdate keeps growing for probes that are not updated so every probe is eventually updated (no starvation)
+//	. LightChange measures how much the dynamic lighting perceived at the probe changed since its last update, in [0,1].
+//		We compare the current "light signature" of the probe (i.e. irradiance-weighted direction to the lights + total irradiance)
+//		with the one recorded at the time of its last update, so moving, dimming or appearing lights are all detected.
+//	. Importance favors probes close to the camera and probes whose region of influence is visible in the camera frustum.
+//
+// The N probes with the highest priority are then selected using a min-heap in O(ProbesCount * log(N)).
+//
+#pragma once
+
+#include "SHProbe.h"
+
+class	SHProbeUpdateScheduler {
+public:		// NESTED TYPES
+
+#pragma pack( push, 4 )
+
+	// Dynamic light description (same layout as the lights structured buffer used by the shaders)
+	struct	DynamicLight {
+		Scene::Light::LIGHT_TYPE	Type;
+		float3		Position;
+		float3		Direction;
+		float3		Color;
+		float4		Parms;						// X=Falloff radius, Y=Cutoff radius, Z=Cos(Falloff angle), W=Cos(Cutoff angle)
+	};
+
+#pragma pack( pop )
+
+	struct	ScheduleParms {
+		float3					wsCameraPosition;	// Camera position, used to favor nearby probes
+		float4x4				World2Proj;			// Camera transform, used to favor visible probes
+		U32						DynamicLightsCount;
+		const DynamicLight*		pDynamicLights;		// Dynamic lights, used to detect lighting changes
+	};
+
+private:
+
+	struct	ProbeState {
+		float	Age;							// Amount of frames since the probe was last updated
+		float4	LightSignature;					// Light signature recorded when the probe was last updated
+	};
+
+	struct	Candidate {
+		float	Priority;
+		U32		ProbeIndex;
+	};
+
+private:	// FIELDS
+
+	U32				m_ProbesCount;
+	ProbeState*		m_pStates;
+	float4*			m_pCurrentSignatures;		// Light signatures for the current frame
+	Candidate*		m_pHeap;					// Min-heap of the best candidates for the current frame
+	U32				m_HeapSize;
+
+public:		// METHODS
+
+	SHProbeUpdateScheduler();
+	~SHProbeUpdateScheduler();
+
+	void	Init( U32 _ProbesCount );
+	void	Exit();
+
+	// Forces all probes to be considered as never updated
+	void	Reset();
+
+	// Selects the probes to update this frame and marks them as updated
+	//	_pProbeIndices, an array of at least _MaxUpdatesCount entries that will receive the indices of the probes to update
+	// Returns the amount of selected probes
+	U32		Schedule( const SHProbe* _pProbes, const ScheduleParms& _Parms, U32 _MaxUpdatesCount, U32* _pProbeIndices );
+
+private:
+
+	static float4	ComputeLightSignature( const float3& _wsPosition, U32 _LightsCount, const DynamicLight* _pLights );
+	static bool		IsProbeVisible( const SHProbe& _Probe, const float4 _pFrustumPlanes[6] );
+
+	void	HeapPush( float _Priority, U32 _ProbeIndex, U32 _MaxSize );
+	void	HeapSiftDown( U32 _Index );
+};